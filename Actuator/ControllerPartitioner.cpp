@@ -0,0 +1,718 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "ControllerPartitioner.h"
+#include "Frame.h"
+#include "Hash.h"
+#include "PreciseDelay.h"
+#include "ThreadPool.h"
+#include "SimpleDesignByContract.h"
+
+using namespace hdsim;
+using namespace std;
+
+/**
+ * Get the largest code of the wire format
+ */
+static float getMaxCode(int bitsPerValue)
+{
+   return (float)((1 << bitsPerValue) - 1);
+}
+
+/**
+ * Quantize values to the codes of the wire format. Branch free, so that it is vectorized
+ */
+static void quantize(const float *values, int numValues, float minValue, float scale, float maxCode, uint16_t *out)
+{
+   for (int i = 0; i < numValues; i++)
+   {
+      float code = (values[i] - minValue) * scale;
+      code = code < 0 ? 0 : code;
+      code = code > maxCode ? maxCode : code;
+      
+      out[i] = (uint16_t)(code + 0.5f);
+   }
+}
+
+/**
+ * Write value as numBytes big endian bytes
+ *
+ * @return Position after the written bytes
+ */
+static unsigned char *putBigEndian(uint64_t value, int numBytes, unsigned char *out)
+{
+   for (int i = numBytes - 1; i >= 0; i--, value >>= 8)
+      out[i] = value & 0xFF;
+   
+   return out + numBytes;
+}
+
+/**
+ * Read numBytes big endian bytes
+ *
+ * @param in (IN/OUT) Position to read from, moved after the read bytes
+ */
+static uint64_t getBigEndian(const unsigned char **in, int numBytes)
+{
+   uint64_t value = 0;
+   
+   for (int i = 0; i < numBytes; i++)
+      value = (value << 8) | (*in)[i];
+   
+   *in += numBytes;
+   return value;
+}
+
+/**
+ * Pack codes to the wire format
+ */
+static void packCodes(const uint16_t *codes, int numValues, int bitsPerValue, unsigned char *out)
+{
+   // Big endian, so that the wire format doesn't depend on the sender
+   if (bitsPerValue == 16)
+   {
+      for (int i = 0; i < numValues; i++, out += 2)
+      {
+         out[0] = codes[i] >> 8;
+         out[1] = codes[i] & 0xFF;
+      }
+      
+      return;
+   }
+   
+   // Two 12 bit values in three bytes
+   int i = 0;
+   for (; i + 1 < numValues; i += 2, out += 3)
+   {
+      out[0] = codes[i] >> 4;
+      out[1] = ((codes[i] & 0xF) << 4) | (codes[i + 1] >> 8);
+      out[2] = codes[i + 1] & 0xFF;
+   }
+   
+   if (i < numValues)
+   {
+      out[0] = codes[i] >> 4;
+      out[1] = (codes[i] & 0xF) << 4;
+   }
+}
+
+/**
+ * Checksum of the payload
+ */
+static uint32_t getChecksum(const unsigned char *payload, size_t size)
+{
+   return (uint32_t)fnv1aHash(payload, size);
+}
+
+ControllerTransport::~ControllerTransport()
+{
+}
+
+UDPControllerTransport::UDPControllerTransport()
+{
+   socket_ = socket(AF_INET, SOCK_DGRAM, 0);
+   pthread_mutex_init(&mutex_, NULL);
+}
+
+UDPControllerTransport::~UDPControllerTransport()
+{
+   if (socket_ != -1)
+      close(socket_);
+   
+   pthread_mutex_destroy(&mutex_);
+}
+
+bool UDPControllerTransport::send(const ControllerRegion &region, const void *packet, size_t size)
+{
+   if (socket_ == -1)
+      return false;
+   
+   pthread_mutex_lock(&mutex_);
+   
+   map<string, vector<char> >::iterator found = addresses_.find(region.address);
+   if (found == addresses_.end())
+   {
+      // Resolved once per controller, failures are not cached so that controller that comes up later is found
+      string::size_type colon = region.address.rfind(':');
+      
+      addrinfo hints;
+      memset(&hints, 0, sizeof(hints));
+      hints.ai_family = AF_INET;
+      hints.ai_socktype = SOCK_DGRAM;
+      
+      addrinfo *result = NULL;
+      if (colon != string::npos  &&  !getaddrinfo(region.address.substr(0, colon).c_str(), region.address.substr(colon + 1).c_str(), &hints, &result))
+      {
+         const char *address = reinterpret_cast<const char *>(result->ai_addr);
+         found = addresses_.insert(make_pair(region.address, vector<char>(address, address + result->ai_addrlen))).first;
+         freeaddrinfo(result);
+      }
+   }
+   
+   vector<char> address;
+   if (found != addresses_.end())
+      address = found->second;
+   
+   pthread_mutex_unlock(&mutex_);
+   
+   if (address.empty())
+      return false;
+   
+   return sendto(socket_, packet, size, 0, reinterpret_cast<const sockaddr *>(&address[0]), address.size()) == (ssize_t)size;
+}
+
+namespace hdsim {
+   
+   /**
+    * Packs and sends region of the single controller
+    */
+   class ControllerPackTask : public Task {
+      
+   public:
+      
+      ControllerPackTask() : partitioner_(0), regionIndex_(0), values_(0), sizeX_(0), frameSequence_(0)
+      {
+      }
+      
+      void set(ControllerPartitioner *partitioner, int regionIndex, const float *values, int sizeX, uint32_t frameSequence)
+      {
+         partitioner_ = partitioner;
+         regionIndex_ = regionIndex;
+         values_ = values;
+         sizeX_ = sizeX;
+         frameSequence_ = frameSequence;
+      }
+      
+      virtual void run()
+      {
+         partitioner_->sendRegion(regionIndex_, values_, sizeX_, frameSequence_);
+      }
+      
+   private:
+      
+      ControllerPartitioner *partitioner_;
+      int regionIndex_;
+      const float *values_;
+      int sizeX_;
+      uint32_t frameSequence_;
+   };
+   
+} // namespace
+
+ControllerPartitioner::ControllerPartitioner(ControllerTransport *transport, double minValue, double maxValue, int maxPacketSize, ThreadPool *pool) : 
+                                             transport_(transport), minValue_(minValue), maxValue_(maxValue), maxPacketSize_(maxPacketSize), 
+                                             pool_(pool ? pool : ThreadPool::getSharedPool()), frameSequence_(0), numPacketsSent_(0), numSendFailures_(0),
+                                             numBytesSent_(0), lastPartitionTimeInMicroSeconds_(0)
+{
+   PRECONDITION(transport  &&  maxValue > minValue  &&  maxPacketSize >= (int)sizeof(ControllerPacketHeader) + 3);
+}
+
+ControllerPartitioner::~ControllerPartitioner()
+{
+}
+
+void ControllerPartitioner::addRegion(const ControllerRegion &region)
+{
+   PRECONDITION(region.x >= 0  &&  region.y >= 0  &&  region.sizeX > 0  &&  region.sizeY > 0  &&  region.sizeX <= 65535  &&  region.sizeY <= 65535);
+   PRECONDITION(region.bitsPerValue == 12  ||  region.bitsPerValue == 16);
+   
+   int maxValues = (maxPacketSize_ - sizeof(ControllerPacketHeader)) * 8 / region.bitsPerValue;
+   
+   regions_.push_back(region);
+   packets_.push_back(vector<unsigned char>(maxPacketSize_));
+   scratch_.push_back(vector<uint16_t>(maxValues));
+}
+
+bool ControllerPartitioner::readRegionMap(const string &fileName)
+{
+   ifstream file(fileName.c_str());
+   if (!file)
+      return false;
+   
+   string line;
+   while (getline(file, line))
+   {
+      if (line.empty()  ||  line[0] == '#')
+         continue;
+      
+      istringstream fields(line);
+      ControllerRegion region;
+      
+      if (!(fields >> region.controllerId >> region.x >> region.y >> region.sizeX >> region.sizeY >> region.bitsPerValue >> region.address))
+         return false;
+      
+      if (region.x < 0  ||  region.y < 0  ||  region.sizeX <= 0  ||  region.sizeY <= 0  ||  region.sizeX > 65535  ||  region.sizeY > 65535  ||  
+          (region.bitsPerValue != 12  &&  region.bitsPerValue != 16))
+         return false;
+      
+      addRegion(region);
+   }
+   
+   return true;
+}
+
+void ControllerPartitioner::sendRegion(int regionIndex, const float *values, int sizeX, uint32_t frameSequence)
+{
+   const ControllerRegion &region = regions_[regionIndex];
+   unsigned char *packet = &packets_[regionIndex][0];
+   uint16_t *codes = &scratch_[regionIndex][0];
+   
+   const int bits = region.bitsPerValue;
+   const float maxCode = getMaxCode(bits);
+   const float scale = maxCode / (maxValue_ - minValue_);
+   
+   // Packet is a rectangle of whole rows if they fit, otherwise a part of the single row
+   const int maxValues = scratch_[regionIndex].size();
+   const int chunkSizeX = min(region.sizeX, maxValues);
+   const int chunkSizeY = min(region.sizeY, maxValues / chunkSizeX);
+   const int numChunksX = (region.sizeX + chunkSizeX - 1) / chunkSizeX;
+   const int numPackets = numChunksX * ((region.sizeY + chunkSizeY - 1) / chunkSizeY);
+   
+   CHECK(numPackets <= 65535, "Region needs too many packets");
+   
+   ControllerPacketHeader header;
+   memset(&header, 0, sizeof(header));
+   header.magic = CONTROLLER_PACKET_MAGIC;
+   header.controllerId = region.controllerId;
+   header.bitsPerValue = bits;
+   header.frameSequence = frameSequence;
+   header.numPackets = numPackets;
+   
+   long numSent = 0, numFailed = 0;
+   long long numBytes = 0;
+   
+   for (int chunkY = 0; chunkY < region.sizeY; chunkY += chunkSizeY)
+      for (int chunkX = 0; chunkX < region.sizeX; chunkX += chunkSizeX)
+      {
+         int width = min(chunkSizeX, region.sizeX - chunkX);
+         int height = min(chunkSizeY, region.sizeY - chunkY);
+         
+         // Every moxel of the region is read exactly once, here
+         for (int y = 0; y < height; y++)
+            quantize(values + (region.y + chunkY + y) * sizeX + region.x + chunkX, width, minValue_, scale, maxCode, codes + y * width);
+         
+         unsigned char *payload = packet + sizeof(header);
+         packCodes(codes, width * height, bits, payload);
+         
+         header.x = chunkX;
+         header.y = chunkY;
+         header.sizeX = width;
+         header.sizeY = height;
+         header.payloadSize = getPackedSize(width * height, bits);
+         header.checksum = getChecksum(payload, header.payloadSize);
+         header.sendTimeInMicroSeconds = getMonotonicTimeInMicroSeconds();
+         writeHeader(header, packet);
+         
+         size_t size = sizeof(header) + header.payloadSize;
+         if (transport_->send(region, packet, size))
+         {
+            numSent++;
+            numBytes += size;
+         }
+         else
+         {
+            numFailed++;
+         }
+         
+         header.packetIndex++;
+      }
+   
+   __sync_fetch_and_add(&numPacketsSent_, numSent);
+   __sync_fetch_and_add(&numSendFailures_, numFailed);
+   __sync_fetch_and_add(&numBytesSent_, numBytes);
+}
+
+bool ControllerPartitioner::partition(const float *values, int sizeX, int sizeY)
+{
+   PRECONDITION(sizeX >= 0  &&  sizeY >= 0  &&  (values  ||  sizeX * sizeY == 0));
+   
+   long long startTime = getMonotonicTimeInMicroSeconds();
+   long numFailuresBefore = numSendFailures_;
+   bool allInside = true;
+   
+   frameSequence_++;
+   
+   vector<ControllerPackTask> tasks(regions_.size());
+   TaskGroup group(pool_);
+   
+   for (int i = 0; i < regions_.size(); i++)
+   {
+      const ControllerRegion &region = regions_[i];
+      
+      if (region.x + region.sizeX > sizeX  ||  region.y + region.sizeY > sizeY)
+      {
+         allInside = false;
+         continue;
+      }
+      
+      tasks[i].set(this, i, values, sizeX, frameSequence_);
+      group.spawn(&tasks[i]);
+   }
+   
+   group.wait();
+   
+   lastPartitionTimeInMicroSeconds_ = getMonotonicTimeInMicroSeconds() - startTime;
+   
+   return allInside  &&  numSendFailures_ == numFailuresBefore;
+}
+
+bool ControllerPartitioner::partitionModel(const AbstractModel *model)
+{
+   PRECONDITION(model);
+   
+   int sizeX = model->getSizeX();
+   int sizeY = model->getSizeY();
+   
+   if (!strcmp(model->getModelName(), FRAME_MODEL_NAME))
+      return partition(static_cast<const Frame *>(model)->getValues(), sizeX, sizeY);
+   
+   modelValues_.resize(sizeX * sizeY);
+   
+   for (int y = 0; y < sizeY; y++)
+      for (int x = 0; x < sizeX; x++)
+         modelValues_[y * sizeX + x] = model->getAt(x, y);
+   
+   return partition(modelValues_.empty() ? NULL : &modelValues_[0], sizeX, sizeY);
+}
+
+void ControllerPartitioner::frameReady(const AbstractModel *frame, const ScheduledFrameTiming &timing)
+{
+   partitionModel(frame);
+}
+
+void ControllerPartitioner::packValues(const float *values, int numValues, int bitsPerValue, float minValue, float maxValue, uint16_t *scratch, 
+                                       unsigned char *out)
+{
+   PRECONDITION((bitsPerValue == 12  ||  bitsPerValue == 16)  &&  maxValue > minValue);
+   
+   float maxCode = getMaxCode(bitsPerValue);
+   
+   quantize(values, numValues, minValue, maxCode / (maxValue - minValue), maxCode, scratch);
+   packCodes(scratch, numValues, bitsPerValue, out);
+}
+
+void ControllerPartitioner::unpackValues(const unsigned char *packed, int numValues, int bitsPerValue, float minValue, float maxValue, float *out)
+{
+   PRECONDITION((bitsPerValue == 12  ||  bitsPerValue == 16)  &&  maxValue > minValue);
+   
+   float step = (maxValue - minValue) / getMaxCode(bitsPerValue);
+   
+   for (int i = 0; i < numValues; i++)
+   {
+      int code;
+      
+      if (bitsPerValue == 16)
+         code = (packed[2 * i] << 8) | packed[2 * i + 1];
+      else
+      {
+         const unsigned char *pair = packed + i / 2 * 3;
+         code = i % 2 ? ((pair[1] & 0xF) << 8) | pair[2] : (pair[0] << 4) | (pair[1] >> 4);
+      }
+      
+      out[i] = minValue + code * step;
+   }
+}
+
+void ControllerPartitioner::writeHeader(const ControllerPacketHeader &header, unsigned char *out)
+{
+   out = putBigEndian(header.magic, 4, out);
+   out = putBigEndian(header.controllerId, 2, out);
+   out = putBigEndian(header.bitsPerValue, 2, out);
+   out = putBigEndian(header.frameSequence, 4, out);
+   out = putBigEndian(header.packetIndex, 2, out);
+   out = putBigEndian(header.numPackets, 2, out);
+   out = putBigEndian(header.x, 2, out);
+   out = putBigEndian(header.y, 2, out);
+   out = putBigEndian(header.sizeX, 2, out);
+   out = putBigEndian(header.sizeY, 2, out);
+   out = putBigEndian(header.sendTimeInMicroSeconds, 8, out);
+   out = putBigEndian(header.payloadSize, 4, out);
+   putBigEndian(header.checksum, 4, out);
+}
+
+void ControllerPartitioner::readHeader(const unsigned char *packet, ControllerPacketHeader *header)
+{
+   PRECONDITION(header);
+   
+   header->magic = getBigEndian(&packet, 4);
+   header->controllerId = getBigEndian(&packet, 2);
+   header->bitsPerValue = getBigEndian(&packet, 2);
+   header->frameSequence = getBigEndian(&packet, 4);
+   header->packetIndex = getBigEndian(&packet, 2);
+   header->numPackets = getBigEndian(&packet, 2);
+   header->x = getBigEndian(&packet, 2);
+   header->y = getBigEndian(&packet, 2);
+   header->sizeX = getBigEndian(&packet, 2);
+   header->sizeY = getBigEndian(&packet, 2);
+   header->sendTimeInMicroSeconds = getBigEndian(&packet, 8);
+   header->payloadSize = getBigEndian(&packet, 4);
+   header->checksum = getBigEndian(&packet, 4);
+}
+
+StandInController::StandInController(const ControllerRegion &region, double minValue, double maxValue) : region_(region), minValue_(minValue), 
+                                     maxValue_(maxValue), socket_(-1), port_(0), stopRequested_(false), board_(region.sizeX * region.sizeY), 
+                                     currentFrame_(0), numCurrentFramePackets_(0), numPackets_(0), numInvalidPackets_(0), numFrames_(0), totalLatency_(0),
+                                     maxLatency_(0)
+{
+   PRECONDITION(maxValue > minValue);
+   
+   pthread_mutex_init(&mutex_, NULL);
+   pthread_cond_init(&frameReceived_, NULL);
+}
+
+StandInController::~StandInController()
+{
+   stop();
+   
+   pthread_cond_destroy(&frameReceived_);
+   pthread_mutex_destroy(&mutex_);
+}
+
+bool StandInController::start(int port)
+{
+   stop();
+   
+   socket_ = socket(AF_INET, SOCK_DGRAM, 0);
+   if (socket_ == -1)
+      return false;
+   
+   // Whole frame could arrive at once, so give it room
+   int bufferSize = 4 * 1024 * 1024;
+   setsockopt(socket_, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+   
+   sockaddr_in address;
+   memset(&address, 0, sizeof(address));
+   address.sin_family = AF_INET;
+   address.sin_port = htons(port);
+   address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   
+   socklen_t length = sizeof(address);
+   stopRequested_ = false;
+   
+   if (bind(socket_, reinterpret_cast<sockaddr *>(&address), sizeof(address))  ||  getsockname(socket_, reinterpret_cast<sockaddr *>(&address), &length)  ||
+       pthread_create(&thread_, NULL, receiveThread, this))
+   {
+      close(socket_);
+      socket_ = -1;
+      
+      return false;
+   }
+   
+   port_ = ntohs(address.sin_port);
+   return true;
+}
+
+void StandInController::stop()
+{
+   if (socket_ == -1)
+      return;
+   
+   stopRequested_ = true;
+   pthread_join(thread_, NULL);
+   
+   close(socket_);
+   socket_ = -1;
+   port_ = 0;
+}
+
+string StandInController::getAddress() const
+{
+   char address[32];
+   snprintf(address, sizeof(address), "127.0.0.1:%d", port_);
+   
+   return address;
+}
+
+void *StandInController::receiveThread(void *argument)
+{
+   StandInController *controller = static_cast<StandInController *>(argument);
+   vector<unsigned char> packet(65536);
+   
+   while (!controller->stopRequested_)
+   {
+      pollfd fd;
+      fd.fd = controller->socket_;
+      fd.events = POLLIN;
+      fd.revents = 0;
+      
+      // Wake up now and then to check should we stop
+      if (poll(&fd, 1, 50) <= 0)
+         continue;
+      
+      ssize_t size = recv(controller->socket_, &packet[0], packet.size(), 0);
+      if (size > 0)
+         controller->receivePacket(&packet[0], size);
+   }
+   
+   return NULL;
+}
+
+void StandInController::receivePacket(const unsigned char *packet, size_t size)
+{
+   long long now = getMonotonicTimeInMicroSeconds();
+   
+   ControllerPacketHeader header;
+   bool valid = size >= sizeof(header);
+   
+   if (valid)
+   {
+      ControllerPartitioner::readHeader(packet, &header);
+      
+      valid = header.magic == CONTROLLER_PACKET_MAGIC  &&  header.controllerId == region_.controllerId  &&  header.bitsPerValue == region_.bitsPerValue  &&
+              header.packetIndex < header.numPackets  &&  header.x + header.sizeX <= region_.sizeX  &&  header.y + header.sizeY <= region_.sizeY  &&
+              header.payloadSize == size - sizeof(header)  &&  header.payloadSize == ControllerPartitioner::getPackedSize(header.sizeX * header.sizeY, header.bitsPerValue)  &&
+              header.checksum == getChecksum(packet + sizeof(header), header.payloadSize);
+   }
+   
+   if (!valid)
+   {
+      pthread_mutex_lock(&mutex_);
+      numInvalidPackets_++;
+      pthread_mutex_unlock(&mutex_);
+      
+      return;
+   }
+   
+   vector<float> values(header.sizeX * header.sizeY);
+   if (!values.empty())
+      ControllerPartitioner::unpackValues(packet + sizeof(header), values.size(), header.bitsPerValue, minValue_, maxValue_, &values[0]);
+   
+   pthread_mutex_lock(&mutex_);
+   
+   for (int y = 0; y < header.sizeY; y++)
+      copy(values.begin() + y * header.sizeX, values.begin() + (y + 1) * header.sizeX, board_.begin() + (header.y + y) * region_.sizeX + header.x);
+   
+   long long latency = now - header.sendTimeInMicroSeconds;
+   numPackets_++;
+   totalLatency_ += latency;
+   maxLatency_ = max(maxLatency_, latency);
+   
+   if (header.frameSequence != currentFrame_)
+   {
+      currentFrame_ = header.frameSequence;
+      numCurrentFramePackets_ = 0;
+   }
+   
+   if (++numCurrentFramePackets_ == header.numPackets)
+   {
+      numFrames_++;
+      pthread_cond_broadcast(&frameReceived_);
+   }
+   
+   pthread_mutex_unlock(&mutex_);
+}
+
+bool StandInController::waitForFrames(long numFrames, long long timeoutInMicroSeconds)
+{
+   long long deadline = getMonotonicTimeInMicroSeconds() + timeoutInMicroSeconds;
+   
+   pthread_mutex_lock(&mutex_);
+   
+   while (numFrames_ < numFrames)
+   {
+      long long remaining = deadline - getMonotonicTimeInMicroSeconds();
+      if (remaining <= 0)
+         break;
+      
+      // Condition variables wait for the wall clock time
+      timeval now;
+      gettimeofday(&now, NULL);
+      
+      long long nanoSeconds = (now.tv_usec + min(remaining, 10000LL)) * 1000;
+      
+      timespec timeout;
+      timeout.tv_sec = now.tv_sec + nanoSeconds / 1000000000;
+      timeout.tv_nsec = nanoSeconds % 1000000000;
+      
+      pthread_cond_timedwait(&frameReceived_, &mutex_, &timeout);
+   }
+   
+   bool received = numFrames_ >= numFrames;
+   pthread_mutex_unlock(&mutex_);
+   
+   return received;
+}
+
+vector<float> StandInController::getBoard() const
+{
+   pthread_mutex_lock(&mutex_);
+   vector<float> board = board_;
+   pthread_mutex_unlock(&mutex_);
+   
+   return board;
+}
+
+long StandInController::getNumPackets() const
+{
+   pthread_mutex_lock(&mutex_);
+   long result = numPackets_;
+   pthread_mutex_unlock(&mutex_);
+   
+   return result;
+}
+
+long StandInController::getNumInvalidPackets() const
+{
+   pthread_mutex_lock(&mutex_);
+   long result = numInvalidPackets_;
+   pthread_mutex_unlock(&mutex_);
+   
+   return result;
+}
+
+long StandInController::getNumFrames() const
+{
+   pthread_mutex_lock(&mutex_);
+   long result = numFrames_;
+   pthread_mutex_unlock(&mutex_);
+   
+   return result;
+}
+
+double StandInController::getMeanLatencyInMicroSeconds() const
+{
+   pthread_mutex_lock(&mutex_);
+   double result = numPackets_ ? (double)totalLatency_ / numPackets_ : 0;
+   pthread_mutex_unlock(&mutex_);
+   
+   return result;
+}
+
+long long StandInController::getMaxLatencyInMicroSeconds() const
+{
+   pthread_mutex_lock(&mutex_);
+   long long result = maxLatency_;
+   pthread_mutex_unlock(&mutex_);
+   
+   return result;
+}
@@ -0,0 +1,577 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONTROLLER_PARTITIONER_H_
+#define CONTROLLER_PARTITIONER_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "FrameScheduler.h"
+
+namespace hdsim {
+   
+   class ThreadPool;
+   
+   /**
+    * Magic at the start of every controller packet ("HDCP")
+    */
+   static const uint32_t CONTROLLER_PACKET_MAGIC = 0x48444350u;
+   
+   /**
+    * Part of the board owned by the single controller board
+    */
+   struct ControllerRegion {
+      /**
+       * Id of the controller
+       */
+      int controllerId;
+      
+      /**
+       * Rectangle of the board owned by the controller
+       */
+      int x, y, sizeX, sizeY;
+      
+      /**
+       * Bits per value in the controller's wire format, 12 (two values packed in three bytes, most significant bits first) or 16
+       */
+      int bitsPerValue;
+      
+      /**
+       * Address of the controller, interpreted by the transport (e.g. "127.0.0.1:9000" for UDPControllerTransport)
+       */
+      std::string address;
+   };
+   
+   /**
+    * Header of the controller packet. Packet carries a rectangle of the controller's region, values follow the header row by row. On the wire, header
+    * fields follow each other in the order below without padding, and they and the 16 bit values are big endian (network byte order). 12 bit values
+    * are packed two in three bytes, most significant bits first. Use ControllerPartitioner::writeHeader() and readHeader() to convert the header
+    */
+   struct ControllerPacketHeader {
+      uint32_t magic;
+      uint16_t controllerId;
+      uint16_t bitsPerValue;
+      
+      /**
+       * Sequence number of the frame
+       */
+      uint32_t frameSequence;
+      
+      /**
+       * Index of the packet in the frame, and number of packets controller receives for the frame
+       */
+      uint16_t packetIndex, numPackets;
+      
+      /**
+       * Rectangle carried by the packet, relative to the controller's region
+       */
+      uint16_t x, y, sizeX, sizeY;
+      
+      /**
+       * When packet was sent, from getMonotonicTimeInMicroSeconds()
+       */
+      int64_t sendTimeInMicroSeconds;
+      
+      /**
+       * Size of the payload, and low 32 bits of its FNV-1a hash
+       */
+      uint32_t payloadSize;
+      uint32_t checksum;
+   };
+   
+   /**
+    * Sends packets to the controllers. Send is called concurrently for the different controllers, so transport must be thread safe
+    */
+   class ControllerTransport {
+      
+   public:
+      
+      /**
+       * Destructor
+       */
+      virtual ~ControllerTransport();
+      
+      /**
+       * Send packet to the controller
+       *
+       * @param region Controller to send to
+       * @param packet Packet
+       * @param size Size of the packet
+       *
+       * @return Was packet sent
+       */
+      virtual bool send(const ControllerRegion &region, const void *packet, size_t size) = 0;
+   };
+   
+   /**
+    * Sends packets as UDP datagrams to the "host:port" address of the controller
+    */
+   class UDPControllerTransport : public ControllerTransport {
+      
+   public:
+      
+      /**
+       * Constructor
+       */
+      UDPControllerTransport();
+      
+      /**
+       * Destructor
+       */
+      virtual ~UDPControllerTransport();
+      
+      // Overriden methods
+      virtual bool send(const ControllerRegion &region, const void *packet, size_t size);
+      
+   private:
+      
+      // copying is not supported
+      UDPControllerTransport(const UDPControllerTransport &rhs);
+      UDPControllerTransport &operator=(const UDPControllerTransport &rhs);
+      
+      /**
+       * Socket used for all controllers
+       */
+      int socket_;
+      
+      /**
+       * Resolved addresses of the controllers (struct sockaddr_in), guarded by mutex
+       */
+      std::map<std::string, std::vector<char> > addresses_;
+      pthread_mutex_t mutex_;
+   };
+   
+   /**
+    * Slices every frame in per-controller packets. Large walls are driven by many controller boards, each owning a rectangle of the board (region map).
+    * Every controller's region is quantized to its wire format, split in packets no larger than the max packet size, and sent through the transport. 
+    * Controllers are packed and sent in parallel, each reading only its own region, so the frame is read once no matter how many controllers there are.
+    */
+   class ControllerPartitioner : public FrameSink {
+      
+   public:
+      
+      /**
+       * Default max size of the packet, so that it fits in the single Ethernet frame
+       */
+      static const int DEFAULT_MAX_PACKET_SIZE = 1472;
+      
+      /**
+       * Constructor
+       *
+       * @param transport Transport used to send packets. Partitioner doesn't own it
+       * @param minValue Value sent as 0
+       * @param maxValue Value sent as the max value of the wire format
+       * @param maxPacketSize Max size of the packet, including the header
+       * @param pool Pool used for packing, or 0 for the shared pool
+       */
+      ControllerPartitioner(ControllerTransport *transport, double minValue = 0, double maxValue = 1, int maxPacketSize = DEFAULT_MAX_PACKET_SIZE, 
+                            ThreadPool *pool = 0);
+      
+      /**
+       * Destructor
+       */
+      virtual ~ControllerPartitioner();
+      
+      /**
+       * Add controller
+       *
+       * @param region Controller's region and wire format
+       */
+      virtual void addRegion(const ControllerRegion &region);
+      
+      /**
+       * Read region map. Every line is "controllerId x y sizeX sizeY bitsPerValue address", lines starting with # are comments
+       *
+       * @param fileName File to read
+       *
+       * @return Was map read. Regions read before error are kept
+       */
+      virtual bool readRegionMap(const std::string &fileName);
+      
+      /**
+       * Get regions of all controllers
+       *
+       * @return Regions
+       */
+      virtual const std::vector<ControllerRegion> &getRegions() const
+      {
+         return regions_;
+      }
+      
+      /**
+       * Send frame to all controllers
+       *
+       * @param values Values of the frame, stored so that [x][y] corresponds to [y * sizeX + x]
+       * @param sizeX Size of the frame in X direction
+       * @param sizeY Size of the frame in Y direction
+       *
+       * @return Were all packets sent. Regions outside of the frame are not sent
+       */
+      virtual bool partition(const float *values, int sizeX, int sizeY);
+      
+      /**
+       * Send model to all controllers. Frame values are used directly, other models are read moxel by moxel
+       *
+       * @param model Model to send
+       *
+       * @return Were all packets sent
+       */
+      virtual bool partitionModel(const AbstractModel *model);
+      
+      /**
+       * Get number of packets sent
+       *
+       * @return Number of packets sent
+       */
+      virtual long getNumPacketsSent() const
+      {
+         return numPacketsSent_;
+      }
+      
+      /**
+       * Get number of bytes sent, including headers
+       *
+       * @return Number of bytes sent
+       */
+      virtual long long getNumBytesSent() const
+      {
+         return numBytesSent_;
+      }
+      
+      /**
+       * Get number of packets transport failed to send
+       *
+       * @return Number of failed packets
+       */
+      virtual long getNumSendFailures() const
+      {
+         return numSendFailures_;
+      }
+      
+      /**
+       * Get time the last partition() took
+       *
+       * @return Time in microseconds
+       */
+      virtual long long getLastPartitionTimeInMicroSeconds() const
+      {
+         return lastPartitionTimeInMicroSeconds_;
+      }
+      
+      /**
+       * Quantize values to the wire format and pack them
+       *
+       * @param values Values to pack
+       * @param numValues Number of values
+       * @param bitsPerValue 12 or 16
+       * @param minValue Value packed as 0
+       * @param maxValue Value packed as the max value of the format
+       * @param scratch Scratch buffer of at least numValues elements
+       * @param out (OUT) Packed values, getPackedSize() bytes
+       */
+      static void packValues(const float *values, int numValues, int bitsPerValue, float minValue, float maxValue, uint16_t *scratch, unsigned char *out);
+      
+      /**
+       * Unpack values packed with packValues()
+       *
+       * @param packed Packed values
+       * @param numValues Number of values
+       * @param bitsPerValue 12 or 16
+       * @param minValue Value packed as 0
+       * @param maxValue Value packed as the max value of the format
+       * @param out (OUT) Unpacked values
+       */
+      static void unpackValues(const unsigned char *packed, int numValues, int bitsPerValue, float minValue, float maxValue, float *out);
+      
+      /**
+       * Get size of the packed values
+       *
+       * @param numValues Number of values
+       * @param bitsPerValue 12 or 16
+       *
+       * @return Size in bytes
+       */
+      static size_t getPackedSize(int numValues, int bitsPerValue)
+      {
+         return ((size_t)numValues * bitsPerValue + 7) / 8;
+      }
+      
+      /**
+       * Write header in the wire format
+       *
+       * @param header Header to write
+       * @param out (OUT) sizeof(ControllerPacketHeader) bytes of the packet
+       */
+      static void writeHeader(const ControllerPacketHeader &header, unsigned char *out);
+      
+      /**
+       * Read header from the wire format
+       *
+       * @param packet Packet, at least sizeof(ControllerPacketHeader) bytes
+       * @param header (OUT) Header read
+       */
+      static void readHeader(const unsigned char *packet, ControllerPacketHeader *header);
+      
+      // Overriden methods
+      virtual void frameReady(const AbstractModel *frame, const ScheduledFrameTiming &timing);
+      
+   private:
+      
+      // copying is not supported
+      ControllerPartitioner(const ControllerPartitioner &rhs);
+      ControllerPartitioner &operator=(const ControllerPartitioner &rhs);
+      
+      friend class ControllerPackTask;
+      
+      /**
+       * Pack and send region of the single controller
+       */
+      void sendRegion(int regionIndex, const float *values, int sizeX, uint32_t frameSequence);
+      
+      /**
+       * Transport used to send packets
+       */
+      ControllerTransport *transport_;
+      
+      /**
+       * Range of the values
+       */
+      float minValue_, maxValue_;
+      
+      /**
+       * Max size of the packet
+       */
+      int maxPacketSize_;
+      
+      /**
+       * Pool used for packing
+       */
+      ThreadPool *pool_;
+      
+      /**
+       * Controllers
+       */
+      std::vector<ControllerRegion> regions_;
+      
+      /**
+       * Per controller packet and quantization buffers, so that controllers could be packed in parallel
+       */
+      std::vector<std::vector<unsigned char> > packets_;
+      std::vector<std::vector<uint16_t> > scratch_;
+      
+      /**
+       * Scratch copy of the models that are not frames
+       */
+      std::vector<float> modelValues_;
+      
+      /**
+       * Sequence number of the last frame
+       */
+      uint32_t frameSequence_;
+      
+      /**
+       * Statistics, updated atomically from the packing tasks
+       */
+      volatile long numPacketsSent_, numSendFailures_;
+      volatile long long numBytesSent_;
+      long long lastPartitionTimeInMicroSeconds_;
+   };
+   
+   /**
+    * Local stand-in for the controller board. Receives packets of the single controller over UDP on the loopback interface, validates them, keeps the 
+    * board they describe and times their delivery
+    */
+   class StandInController {
+      
+   public:
+      
+      /**
+       * Constructor
+       *
+       * @param region Region of the controller whose packets are expected
+       * @param minValue Value sent as 0
+       * @param maxValue Value sent as the max value of the wire format
+       */
+      StandInController(const ControllerRegion &region, double minValue = 0, double maxValue = 1);
+      
+      /**
+       * Destructor. Stops the controller
+       */
+      virtual ~StandInController();
+      
+      /**
+       * Start receiving
+       *
+       * @param port Port to receive on, or 0 to pick any free port
+       *
+       * @return Was controller started
+       */
+      virtual bool start(int port = 0);
+      
+      /**
+       * Stop receiving
+       */
+      virtual void stop();
+      
+      /**
+       * Get port controller receives on
+       *
+       * @return Port
+       */
+      virtual int getPort() const
+      {
+         return port_;
+      }
+      
+      /**
+       * Get address of the controller, as expected by UDPControllerTransport
+       *
+       * @return Address of the controller
+       */
+      virtual std::string getAddress() const;
+      
+      /**
+       * Wait until given number of frames is completely received
+       *
+       * @param numFrames Number of frames
+       * @param timeoutInMicroSeconds Max time to wait
+       *
+       * @return Were frames received in time
+       */
+      virtual bool waitForFrames(long numFrames, long long timeoutInMicroSeconds);
+      
+      /**
+       * Get controller's region as it was received
+       *
+       * @return Values of the region, stored so that [x][y] corresponds to [y * sizeX + x]
+       */
+      virtual std::vector<float> getBoard() const;
+      
+      /**
+       * Get number of valid packets received
+       *
+       * @return Number of valid packets
+       */
+      virtual long getNumPackets() const;
+      
+      /**
+       * Get number of packets rejected by validation
+       *
+       * @return Number of invalid packets
+       */
+      virtual long getNumInvalidPackets() const;
+      
+      /**
+       * Get number of frames whose all packets were received
+       *
+       * @return Number of complete frames
+       */
+      virtual long getNumFrames() const;
+      
+      /**
+       * Get mean time from sending to receiving of the packet
+       *
+       * @return Mean latency in microseconds
+       */
+      virtual double getMeanLatencyInMicroSeconds() const;
+      
+      /**
+       * Get max time from sending to receiving of the packet
+       *
+       * @return Max latency in microseconds
+       */
+      virtual long long getMaxLatencyInMicroSeconds() const;
+      
+   private:
+      
+      // copying is not supported
+      StandInController(const StandInController &rhs);
+      StandInController &operator=(const StandInController &rhs);
+      
+      /**
+       * Receiving thread
+       */
+      static void *receiveThread(void *argument);
+      
+      /**
+       * Validate and apply single packet
+       */
+      void receivePacket(const unsigned char *packet, size_t size);
+      
+      /**
+       * Expected region
+       */
+      ControllerRegion region_;
+      
+      /**
+       * Range of the values
+       */
+      float minValue_, maxValue_;
+      
+      /**
+       * Socket, or -1
+       */
+      int socket_;
+      
+      /**
+       * Port
+       */
+      int port_;
+      
+      /**
+       * Receiving thread
+       */
+      pthread_t thread_;
+      
+      /**
+       * Should receiving thread stop
+       */
+      volatile bool stopRequested_;
+      
+      /**
+       * Received board
+       */
+      std::vector<float> board_;
+      
+      /**
+       * Frame being received, and number of its packets received so far
+       */
+      uint32_t currentFrame_;
+      int numCurrentFramePackets_;
+      
+      /**
+       * Statistics
+       */
+      long numPackets_, numInvalidPackets_, numFrames_;
+      long long totalLatency_, maxLatency_;
+      
+      /**
+       * Guards board and statistics
+       */
+      mutable pthread_mutex_t mutex_;
+      pthread_cond_t frameReceived_;
+   };
+   
+} // namespace
+
+#endif
@@ -0,0 +1,240 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "DeltaUpdateStage.h"
+#include "Frame.h"
+#include "PreciseDelay.h"
+#include "SimpleDesignByContract.h"
+
+using namespace hdsim;
+using namespace std;
+
+ActuatorUpdateSink::~ActuatorUpdateSink()
+{
+}
+
+DeltaUpdateStage::DeltaUpdateStage(double epsilon, int maxDriftFrames, int tileSize) : epsilon_(epsilon), maxDriftFrames_(maxDriftFrames), tileSize_(tileSize), 
+                                                                                      sizeX_(0), sizeY_(0), rowFlags_(tileSize)
+{
+   PRECONDITION(epsilon >= 0  &&  maxDriftFrames > 0  &&  maxDriftFrames < 65535  &&  tileSize > 0);
+   
+   reset();
+}
+
+DeltaUpdateStage::~DeltaUpdateStage()
+{
+}
+
+void DeltaUpdateStage::setEpsilon(double epsilon)
+{
+   PRECONDITION(epsilon >= 0);
+   
+   epsilon_ = epsilon;
+}
+
+void DeltaUpdateStage::reset()
+{
+   committed_.clear();
+   driftAge_.clear();
+   updates_.clear();
+   batches_.clear();
+   
+   sizeX_ = sizeY_ = 0;
+   
+   numFrames_ = numMeasuredFrames_ = 0;
+   numUpdates_ = numMeasuredUpdates_ = numDriftUpdates_ = 0;
+   updateRatioSum_ = 0;
+   firstFrameTimeInMicroSeconds_ = lastFrameTimeInMicroSeconds_ = 0;
+}
+
+void DeltaUpdateStage::addSink(ActuatorUpdateSink *sink)
+{
+   PRECONDITION(sink);
+   
+   sinks_.push_back(sink);
+}
+
+void DeltaUpdateStage::removeSink(ActuatorUpdateSink *sink)
+{
+   sinks_.erase(remove(sinks_.begin(), sinks_.end(), sink), sinks_.end());
+}
+
+void DeltaUpdateStage::processRow(const float *values, int index, int width)
+{
+   float *committed = &committed_[index];
+   unsigned short *driftAge = &driftAge_[index];
+   unsigned char *flags = &rowFlags_[0];
+   
+   const float epsilon = epsilon_;
+   const unsigned short maxDriftFrames = maxDriftFrames_;
+   
+   // Branch free, so that it is vectorized. Most rows don't change at all, and they end here
+   int numFlagged = 0;
+   for (int x = 0; x < width; x++)
+   {
+      float difference = fabsf(values[x] - committed[x]);
+      unsigned short age = difference != 0.0f ? driftAge[x] + 1 : 0;
+      unsigned char flag = (difference > epsilon) | (age >= maxDriftFrames);
+      
+      driftAge[x] = age;
+      flags[x] = flag;
+      numFlagged += flag;
+   }
+   
+   if (!numFlagged)
+      return;
+   
+   for (int x = 0; x < width; x++)
+   {
+      if (!flags[x])
+         continue;
+      
+      if (fabsf(values[x] - committed[x]) <= epsilon)
+         numDriftUpdates_++;
+      
+      ActuatorUpdate update;
+      update.index = index + x;
+      update.value = values[x];
+      updates_.push_back(update);
+      
+      committed[x] = values[x];
+      driftAge[x] = 0;
+   }
+}
+
+int DeltaUpdateStage::process(const float *values, int sizeX, int sizeY)
+{
+   PRECONDITION(sizeX >= 0  &&  sizeY >= 0  &&  (values  ||  sizeX * sizeY == 0));
+   
+   long long now = getMonotonicTimeInMicroSeconds();
+   int size = sizeX * sizeY;
+   
+   updates_.clear();
+   batches_.clear();
+   
+   // Nothing is known about the actuators yet, so every one of them is updated
+   bool fullUpdate = committed_.empty()  ||  sizeX != sizeX_  ||  sizeY != sizeY_;
+   if (fullUpdate)
+   {
+      sizeX_ = sizeX;
+      sizeY_ = sizeY;
+      committed_.assign(values, values + size);
+      driftAge_.assign(size, 0);
+   }
+   
+   for (int tileY = 0; tileY < sizeY; tileY += tileSize_)
+      for (int tileX = 0; tileX < sizeX; tileX += tileSize_)
+      {
+         int firstUpdate = updates_.size();
+         int width = min(tileSize_, sizeX - tileX);
+         int height = min(tileSize_, sizeY - tileY);
+         
+         for (int y = tileY; y < tileY + height; y++)
+         {
+            int index = y * sizeX + tileX;
+            
+            if (!fullUpdate)
+            {
+               processRow(values + index, index, width);
+               continue;
+            }
+            
+            for (int x = 0; x < width; x++)
+            {
+               ActuatorUpdate update;
+               update.index = index + x;
+               update.value = values[index + x];
+               updates_.push_back(update);
+            }
+         }
+         
+         if ((int)updates_.size() > firstUpdate)
+         {
+            ActuatorUpdateBatch batch;
+            batch.tileX = tileX;
+            batch.tileY = tileY;
+            batch.firstUpdate = firstUpdate;
+            batch.numUpdates = updates_.size() - firstUpdate;
+            batches_.push_back(batch);
+         }
+      }
+   
+   int numUpdates = updates_.size();
+   
+   numFrames_++;
+   numUpdates_ += numUpdates;
+   
+   if (numFrames_ == 1)
+      firstFrameTimeInMicroSeconds_ = now;
+   lastFrameTimeInMicroSeconds_ = now;
+   
+   if (!fullUpdate)
+   {
+      numMeasuredFrames_++;
+      numMeasuredUpdates_ += numUpdates;
+      updateRatioSum_ += size ? numUpdates / (double)size : 0;
+   }
+   
+   if (numUpdates)
+   {
+      for (int i = 0; i < sinks_.size(); i++)
+         sinks_[i]->updatesReady(updates_, batches_, *this);
+   }
+   
+   return numUpdates;
+}
+
+int DeltaUpdateStage::processModel(const AbstractModel *model)
+{
+   PRECONDITION(model);
+   
+   int sizeX = model->getSizeX();
+   int sizeY = model->getSizeY();
+   
+   if (!strcmp(model->getModelName(), FRAME_MODEL_NAME))
+      return process(static_cast<const Frame *>(model)->getValues(), sizeX, sizeY);
+   
+   modelValues_.resize(sizeX * sizeY);
+   
+   for (int y = 0; y < sizeY; y++)
+      for (int x = 0; x < sizeX; x++)
+         modelValues_[y * sizeX + x] = model->getAt(x, y);
+   
+   return process(modelValues_.empty() ? NULL : &modelValues_[0], sizeX, sizeY);
+}
+
+double DeltaUpdateStage::getUpdateRatio() const
+{
+   return numMeasuredFrames_ ? updateRatioSum_ / numMeasuredFrames_ : 0;
+}
+
+double DeltaUpdateStage::getUpdatesPerSecond() const
+{
+   long long elapsed = lastFrameTimeInMicroSeconds_ - firstFrameTimeInMicroSeconds_;
+   
+   return elapsed > 0 ? numMeasuredUpdates_ * 1000000.0 / elapsed : 0;
+}
+
+void DeltaUpdateStage::frameReady(const AbstractModel *frame, const ScheduledFrameTiming &timing)
+{
+   processModel(frame);
+}
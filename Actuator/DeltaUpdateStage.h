@@ -0,0 +1,338 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DELTA_UPDATE_STAGE_H_
+#define DELTA_UPDATE_STAGE_H_
+
+#include <vector>
+
+#include "FrameScheduler.h"
+
+namespace hdsim {
+   
+   /**
+    * New position of the single actuator (rod)
+    */
+   struct ActuatorUpdate {
+      /**
+       * Index of the moxel, y * sizeX + x
+       */
+      int index;
+      
+      /**
+       * New value of the moxel
+       */
+      float value;
+   };
+   
+   /**
+    * Updates of the single tile of the board. Updates of the batch are consecutive in the update list, sorted by index
+    */
+   struct ActuatorUpdateBatch {
+      /**
+       * Position of the tile's top left moxel
+       */
+      int tileX, tileY;
+      
+      /**
+       * Index of the first update of the batch in the update list
+       */
+      int firstUpdate;
+      
+      /**
+       * Number of updates in the batch
+       */
+      int numUpdates;
+   };
+   
+   class DeltaUpdateStage;
+   
+   /**
+    * Receiver of the updates produced by the DeltaUpdateStage
+    */
+   class ActuatorUpdateSink {
+      
+   public:
+      
+      /**
+       * Destructor
+       */
+      virtual ~ActuatorUpdateSink();
+      
+      /**
+       * Called after every frame that changed at least one actuator
+       *
+       * @param updates Updates, grouped by tiles
+       * @param batches Batches of the updates, one per changed tile, in the order of tiles
+       * @param stage Stage that produced updates
+       */
+      virtual void updatesReady(const std::vector<ActuatorUpdate> &updates, const std::vector<ActuatorUpdateBatch> &batches, const DeltaUpdateStage &stage) = 0;
+   };
+   
+   /**
+    * Output stage that sends to the actuators only moxels that moved. Every frame is compared with the last state committed to the actuators, and only 
+    * moxels that differ by more than the epsilon (usually resolution of the actuator) are updated. Moxels that differ by less than that are not lost: if 
+    * the difference persists for the given number of frames, moxel is updated anyway, so that drift never accumulates on the actuators.
+    *
+    * Board is compared tile by tile, row by row, with the loop written so that compiler could vectorize it, and updates are emitted grouped by tiles, as 
+    * controllers usually own rectangular parts of the board. Stage could be used as the FrameSink of the FrameScheduler, or fed with frames directly.
+    */
+   class DeltaUpdateStage : public FrameSink {
+      
+   public:
+      
+      /**
+       * Default epsilon, under which changes are not sent
+       */
+      static const double DEFAULT_EPSILON = 1.0 / 1024;
+      
+      /**
+       * Default number of frames after which sub-epsilon difference is sent anyway
+       */
+      static const int DEFAULT_MAX_DRIFT_FRAMES = 30;
+      
+      /**
+       * Default size of the tile
+       */
+      static const int DEFAULT_TILE_SIZE = 32;
+      
+      /**
+       * Constructor
+       *
+       * @param epsilon Differences up to this value are not sent immediately
+       * @param maxDriftFrames Number of consecutive frames after which sub-epsilon difference is sent anyway
+       * @param tileSize Size of the tile by which updates are grouped
+       */
+      explicit DeltaUpdateStage(double epsilon = DEFAULT_EPSILON, int maxDriftFrames = DEFAULT_MAX_DRIFT_FRAMES, int tileSize = DEFAULT_TILE_SIZE);
+      
+      /**
+       * Destructor
+       */
+      virtual ~DeltaUpdateStage();
+      
+      /**
+       * Compare frame with the committed state and produce updates
+       *
+       * @param values Values of the frame, stored so that [x][y] corresponds to [y * sizeX + x]
+       * @param sizeX Size of the frame in X direction
+       * @param sizeY Size of the frame in Y direction
+       *
+       * @return Number of updates
+       */
+      virtual int process(const float *values, int sizeX, int sizeY);
+      
+      /**
+       * Compare model with the committed state and produce updates. Frame values are used directly, other models are read moxel by moxel
+       *
+       * @param model Model to compare
+       *
+       * @return Number of updates
+       */
+      virtual int processModel(const AbstractModel *model);
+      
+      /**
+       * Forget committed state, so that the next frame updates every actuator (e.g. after controller was restarted)
+       */
+      virtual void reset();
+      
+      /**
+       * Add sink that receives updates
+       *
+       * @param sink Sink. Stage doesn't own it
+       */
+      virtual void addSink(ActuatorUpdateSink *sink);
+      
+      /**
+       * Remove sink
+       *
+       * @param sink Sink to remove
+       */
+      virtual void removeSink(ActuatorUpdateSink *sink);
+      
+      /**
+       * Get updates of the last frame, grouped by tiles
+       *
+       * @return Updates of the last frame
+       */
+      virtual const std::vector<ActuatorUpdate> &getUpdates() const
+      {
+         return updates_;
+      }
+      
+      /**
+       * Get batches of the last frame, one per changed tile
+       *
+       * @return Batches of the last frame
+       */
+      virtual const std::vector<ActuatorUpdateBatch> &getBatches() const
+      {
+         return batches_;
+      }
+      
+      /**
+       * Get state committed to the actuators
+       *
+       * @return Committed values, stored so that [x][y] corresponds to [y * sizeX + x]
+       */
+      virtual const std::vector<float> &getCommittedState() const
+      {
+         return committed_;
+      }
+      
+      /**
+       * Get epsilon
+       *
+       * @return Epsilon
+       */
+      virtual double getEpsilon() const
+      {
+         return epsilon_;
+      }
+      
+      /**
+       * Set epsilon
+       *
+       * @param epsilon Differences up to this value are not sent immediately
+       */
+      virtual void setEpsilon(double epsilon);
+      
+      /**
+       * Get number of frames processed since construction or last reset
+       *
+       * @return Number of frames
+       */
+      virtual long getNumFrames() const
+      {
+         return numFrames_;
+      }
+      
+      /**
+       * Get number of updates since construction or last reset
+       *
+       * @return Number of updates
+       */
+      virtual long long getNumUpdates() const
+      {
+         return numUpdates_;
+      }
+      
+      /**
+       * Get number of updates that were sent only because sub-epsilon difference persisted
+       *
+       * @return Number of drift updates
+       */
+      virtual long long getNumDriftUpdates() const
+      {
+         return numDriftUpdates_;
+      }
+      
+      /**
+       * Get mean fraction of the board updated per frame. First frame after reset, which updates the whole board, is not counted
+       *
+       * @return Mean fraction of the board updated per frame, from 0 to 1
+       */
+      virtual double getUpdateRatio() const;
+      
+      /**
+       * Get number of updates sent per second, measured from the first to the last processed frame
+       *
+       * @return Updates per second, or 0 if not enough frames were processed
+       */
+      virtual double getUpdatesPerSecond() const;
+      
+      // Overriden methods
+      virtual void frameReady(const AbstractModel *frame, const ScheduledFrameTiming &timing);
+      
+   private:
+      
+      // copying is not supported
+      DeltaUpdateStage(const DeltaUpdateStage &rhs);
+      DeltaUpdateStage &operator=(const DeltaUpdateStage &rhs);
+      
+      /**
+       * Compare one row of the tile and emit its updates
+       */
+      void processRow(const float *values, int index, int width);
+      
+      /**
+       * Differences up to this value are not sent immediately
+       */
+      float epsilon_;
+      
+      /**
+       * Number of frames after which sub-epsilon difference is sent anyway
+       */
+      int maxDriftFrames_;
+      
+      /**
+       * Size of the tile
+       */
+      int tileSize_;
+      
+      /**
+       * Size of the committed board
+       */
+      int sizeX_, sizeY_;
+      
+      /**
+       * State committed to the actuators. Empty if nothing was committed yet
+       */
+      std::vector<float> committed_;
+      
+      /**
+       * Number of consecutive frames for which moxel had sub-epsilon difference
+       */
+      std::vector<unsigned short> driftAge_;
+      
+      /**
+       * Scratch row of update flags
+       */
+      std::vector<unsigned char> rowFlags_;
+      
+      /**
+       * Scratch copy of the models that are not frames
+       */
+      std::vector<float> modelValues_;
+      
+      /**
+       * Updates of the last frame
+       */
+      std::vector<ActuatorUpdate> updates_;
+      
+      /**
+       * Batches of the last frame
+       */
+      std::vector<ActuatorUpdateBatch> batches_;
+      
+      /**
+       * Sinks receiving updates
+       */
+      std::vector<ActuatorUpdateSink *> sinks_;
+      
+      /**
+       * Statistics
+       */
+      long numFrames_, numMeasuredFrames_;
+      long long numUpdates_, numMeasuredUpdates_, numDriftUpdates_;
+      double updateRatioSum_;
+      long long firstFrameTimeInMicroSeconds_, lastFrameTimeInMicroSeconds_;
+   };
+   
+} // namespace
+
+#endif
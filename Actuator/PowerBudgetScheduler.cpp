@@ -0,0 +1,239 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "PowerBudgetScheduler.h"
+#include "SimpleDesignByContract.h"
+
+using namespace hdsim;
+using namespace std;
+
+PowerBudgetScheduler::PowerBudgetScheduler(int sizeX, int sizeY, int maxConcurrentMoves, MovePriority priority, double maxVelocity, double maxAcceleration, 
+                                           double maxError) : sizeX_(sizeX), sizeY_(sizeY), maxConcurrentMoves_(maxConcurrentMoves), priority_(priority), 
+                                           maxVelocity_(maxVelocity), maxAcceleration_(maxAcceleration), maxError_(maxError), position_(sizeX * sizeY), 
+                                           target_(sizeX * sizeY), pendingFrame_(sizeX * sizeY, -1), stamp_(sizeX * sizeY), 
+                                           buckets_(priority == MOVE_LARGEST_ERROR_FIRST ? NUM_ERROR_BUCKETS : 1), highestBucket_(-1), numPendingMoves_(0), 
+                                           nextFrameIndex_(0), time_(0), numWaves_(0)
+{
+   PRECONDITION(sizeX >= 0  &&  sizeY >= 0  &&  maxConcurrentMoves > 0  &&  maxVelocity > 0  &&  maxAcceleration > 0  &&  maxError > 0);
+}
+
+PowerBudgetScheduler::~PowerBudgetScheduler()
+{
+}
+
+int PowerBudgetScheduler::getBucket(float error) const
+{
+   if (priority_ == MOVE_OLDEST_FIRST)
+      return 0;
+   
+   return min((int)(error / maxError_ * NUM_ERROR_BUCKETS), NUM_ERROR_BUCKETS - 1);
+}
+
+void PowerBudgetScheduler::submit(const ActuatorUpdate *updates, int numUpdates)
+{
+   PRECONDITION(numUpdates >= 0  &&  (updates  ||  !numUpdates));
+   
+   long frameIndex = nextFrameIndex_++;
+   
+   PendingFrame frame;
+   frame.convergence.frameIndex = frameIndex;
+   frame.convergence.numMoves = 0;
+   frame.convergence.submitTime = time_;
+   frame.convergence.convergedTime = time_;
+   frame.numOutstanding = 0;
+   pendingFrames_.push_back(frame);
+   
+   for (int i = 0; i < numUpdates; i++)
+   {
+      int index = updates[i].index;
+      CHECK(index >= 0  &&  index < sizeX_ * sizeY_, "Update outside of the board");
+      
+      // Newer command supersedes the pending one, whatever frame it came from
+      if (pendingFrame_[index] >= 0)
+      {
+         numPendingMoves_--;
+         moveDone(pendingFrame_[index]);
+         pendingFrame_[index] = -1;
+      }
+      
+      float error = fabsf(updates[i].value - position_[index]);
+      if (error == 0)
+         continue;
+      
+      target_[index] = updates[i].value;
+      pendingFrame_[index] = frameIndex;
+      
+      BucketEntry entry;
+      entry.index = index;
+      entry.stamp = ++stamp_[index];
+      
+      int bucket = getBucket(error);
+      buckets_[bucket].push_back(entry);
+      highestBucket_ = max(highestBucket_, bucket);
+      
+      numPendingMoves_++;
+      
+      PendingFrame &pending = pendingFrames_.back();
+      pending.numOutstanding++;
+      pending.convergence.numMoves++;
+   }
+   
+   collectConvergedFrames();
+}
+
+int PowerBudgetScheduler::popMove()
+{
+   while (highestBucket_ >= 0)
+   {
+      deque<BucketEntry> &bucket = buckets_[highestBucket_];
+      
+      while (!bucket.empty())
+      {
+         BucketEntry entry = bucket.front();
+         bucket.pop_front();
+         
+         if (entry.stamp == stamp_[entry.index]  &&  pendingFrame_[entry.index] >= 0)
+            return entry.index;
+      }
+      
+      highestBucket_--;
+   }
+   
+   return -1;
+}
+
+void PowerBudgetScheduler::moveDone(long frameIndex)
+{
+   PendingFrame &frame = pendingFrames_[frameIndex - pendingFrames_.front().convergence.frameIndex];
+   
+   if (--frame.numOutstanding == 0)
+      frame.convergence.convergedTime = time_;
+}
+
+void PowerBudgetScheduler::collectConvergedFrames()
+{
+   while (!pendingFrames_.empty()  &&  pendingFrames_.front().numOutstanding == 0)
+   {
+      convergence_.push_back(pendingFrames_.front().convergence);
+      pendingFrames_.pop_front();
+      
+      if (convergence_.size() > MAX_CONVERGENCE_HISTORY)
+         convergence_.pop_front();
+   }
+}
+
+bool PowerBudgetScheduler::issueWave(vector<ActuatorUpdate> *wave, double *durationInSeconds)
+{
+   if (wave)
+      wave->clear();
+   
+   if (durationInSeconds)
+      *durationInSeconds = 0;
+   
+   if (!numPendingMoves_)
+      return false;
+   
+   vector<long> frames;
+   frames.reserve(min(maxConcurrentMoves_, numPendingMoves_));
+   
+   double duration = 0;
+   
+   for (int i = 0; i < maxConcurrentMoves_; i++)
+   {
+      int index = popMove();
+      if (index < 0)
+         break;
+      
+      duration = max(duration, RodKinematicsSimulator::getMoveTime(target_[index] - position_[index], maxVelocity_, maxAcceleration_));
+      position_[index] = target_[index];
+      
+      frames.push_back(pendingFrame_[index]);
+      pendingFrame_[index] = -1;
+      numPendingMoves_--;
+      
+      if (wave)
+      {
+         ActuatorUpdate update;
+         update.index = index;
+         update.value = target_[index];
+         wave->push_back(update);
+      }
+   }
+   
+   CHECK(!frames.empty(), "Pending moves are out of sync with the buckets");
+   
+   // All moves of the wave are finished once the slowest one is
+   time_ += duration;
+   numWaves_++;
+   
+   for (int i = 0; i < frames.size(); i++)
+      moveDone(frames[i]);
+   
+   collectConvergedFrames();
+   
+   if (durationInSeconds)
+      *durationInSeconds = duration;
+   
+   return true;
+}
+
+int PowerBudgetScheduler::runUntil(double timeInSeconds)
+{
+   int numWaves = 0;
+   
+   while (numPendingMoves_  &&  time_ < timeInSeconds)
+   {
+      issueWave();
+      numWaves++;
+   }
+   
+   time_ = max(time_, timeInSeconds);
+   
+   return numWaves;
+}
+
+double PowerBudgetScheduler::getMeanConvergenceTime() const
+{
+   if (convergence_.empty())
+      return 0;
+   
+   double sum = 0;
+   
+   for (int i = 0; i < convergence_.size(); i++)
+      sum += convergence_[i].convergedTime - convergence_[i].submitTime;
+   
+   return sum / convergence_.size();
+}
+
+double PowerBudgetScheduler::getMaxConvergenceTime() const
+{
+   double maxTime = 0;
+   
+   for (int i = 0; i < convergence_.size(); i++)
+      maxTime = max(maxTime, convergence_[i].convergedTime - convergence_[i].submitTime);
+   
+   return maxTime;
+}
+
+void PowerBudgetScheduler::updatesReady(const vector<ActuatorUpdate> &updates, const vector<ActuatorUpdateBatch> &batches, const DeltaUpdateStage &stage)
+{
+   submit(updates.empty() ? 0 : &updates[0], updates.size());
+}
@@ -0,0 +1,325 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef POWER_BUDGET_SCHEDULER_H_
+#define POWER_BUDGET_SCHEDULER_H_
+
+#include <deque>
+#include <vector>
+
+#include "DeltaUpdateStage.h"
+#include "RodKinematicsSimulator.h"
+
+namespace hdsim {
+   
+   /**
+    * Order in which pending rod moves are issued
+    */
+   enum MovePriority {
+      /**
+       * Rods farthest from their targets move first, so the board looks right as soon as possible
+       */
+      MOVE_LARGEST_ERROR_FIRST = 0,
+      
+      /**
+       * Rods move in the order in which they were commanded, so no rod waits forever
+       */
+      MOVE_OLDEST_FIRST = 1
+   };
+   
+   /**
+    * How long it took to realize the single frame
+    */
+   struct FrameConvergence {
+      /**
+       * Index of the frame, counting from 0
+       */
+      long frameIndex;
+      
+      /**
+       * Number of moves frame commanded
+       */
+      int numMoves;
+      
+      /**
+       * Time when frame was submitted, and when its last move was finished (or superseded by the newer frame)
+       */
+      double submitTime, convergedTime;
+   };
+   
+   /**
+    * Schedules rod moves under the supply current limit. Only maxConcurrentMoves rods may move at once, so pending moves are issued in waves: every wave 
+    * starts the highest priority moves that fit in the budget and lasts until the slowest of them finishes (moves take time given by the rod's velocity
+    * and acceleration limits). Rod commanded again before its move was issued just gets the new target.
+    *
+    * Pending moves are kept in a bucket queue (by quantized error, or in the single FIFO for the oldest first), so submitting and issuing a move is 
+    * constant time, no matter how many moves are pending. Time is simulated, it advances only with the waves and runUntil().
+    */
+   class PowerBudgetScheduler : public ActuatorUpdateSink {
+      
+   public:
+      
+      /**
+       * Number of buckets used for MOVE_LARGEST_ERROR_FIRST
+       */
+      static const int NUM_ERROR_BUCKETS = 256;
+      
+      /**
+       * Max number of converged frames kept for reporting
+       */
+      static const int MAX_CONVERGENCE_HISTORY = 1024;
+      
+      /**
+       * Constructor. All rods start at 0
+       *
+       * @param sizeX Size of the board in X direction
+       * @param sizeY Size of the board in Y direction
+       * @param maxConcurrentMoves Max number of rods moving at once
+       * @param priority Order in which moves are issued
+       * @param maxVelocity Max speed of the rod, in depth units per second
+       * @param maxAcceleration Max acceleration of the rod, in depth units per second squared
+       * @param maxError Errors from this value up share the highest priority bucket
+       */
+      PowerBudgetScheduler(int sizeX, int sizeY, int maxConcurrentMoves, MovePriority priority = MOVE_LARGEST_ERROR_FIRST, 
+                           double maxVelocity = RodKinematicsSimulator::DEFAULT_MAX_VELOCITY, 
+                           double maxAcceleration = RodKinematicsSimulator::DEFAULT_MAX_ACCELERATION, double maxError = 1.0);
+      
+      /**
+       * Destructor
+       */
+      virtual ~PowerBudgetScheduler();
+      
+      /**
+       * Submit moves of the new frame at the current time
+       *
+       * @param updates Moves of the frame
+       * @param numUpdates Number of moves
+       */
+      virtual void submit(const ActuatorUpdate *updates, int numUpdates);
+      
+      /**
+       * Issue the next wave of moves, and advance time until it is finished
+       *
+       * @param wave (OUT) Moves of the wave, or 0 if not needed
+       * @param durationInSeconds (OUT) Duration of the wave, or 0 if not needed
+       *
+       * @return Was there anything to issue
+       */
+      virtual bool issueWave(std::vector<ActuatorUpdate> *wave = 0, double *durationInSeconds = 0);
+      
+      /**
+       * Issue waves until given time, or until nothing is pending. If nothing is pending, time is advanced to the given time
+       *
+       * @param timeInSeconds Time to run until. Wave that starts before it could finish after it
+       *
+       * @return Number of waves issued
+       */
+      virtual int runUntil(double timeInSeconds);
+      
+      /**
+       * Get current time
+       *
+       * @return Time in seconds
+       */
+      virtual double getTime() const
+      {
+         return time_;
+      }
+      
+      /**
+       * Get number of pending moves
+       *
+       * @return Number of pending moves
+       */
+      virtual int getNumPendingMoves() const
+      {
+         return numPendingMoves_;
+      }
+      
+      /**
+       * Get number of waves issued
+       *
+       * @return Number of waves
+       */
+      virtual long getNumWaves() const
+      {
+         return numWaves_;
+      }
+      
+      /**
+       * Get positions of the rods, after all issued waves
+       *
+       * @return Positions, stored so that [x][y] corresponds to [y * sizeX + x]
+       */
+      virtual const std::vector<float> &getPositions() const
+      {
+         return position_;
+      }
+      
+      /**
+       * Get convergence of the recent frames, oldest first
+       *
+       * @return Converged frames
+       */
+      virtual const std::deque<FrameConvergence> &getConvergence() const
+      {
+         return convergence_;
+      }
+      
+      /**
+       * Get mean time from submitting a frame until it converged, over the recent frames
+       *
+       * @return Mean convergence time in seconds
+       */
+      virtual double getMeanConvergenceTime() const;
+      
+      /**
+       * Get max time from submitting a frame until it converged, over the recent frames
+       *
+       * @return Max convergence time in seconds
+       */
+      virtual double getMaxConvergenceTime() const;
+      
+      // Overriden methods
+      virtual void updatesReady(const std::vector<ActuatorUpdate> &updates, const std::vector<ActuatorUpdateBatch> &batches, const DeltaUpdateStage &stage);
+      
+   private:
+      
+      // copying is not supported
+      PowerBudgetScheduler(const PowerBudgetScheduler &rhs);
+      PowerBudgetScheduler &operator=(const PowerBudgetScheduler &rhs);
+      
+      /**
+       * Entry of the bucket. Entry whose stamp differs from the rod's stamp is stale (rod was commanded again or moved) and is skipped
+       */
+      struct BucketEntry {
+         int index;
+         unsigned int stamp;
+      };
+      
+      /**
+       * Frame whose moves are not all finished
+       */
+      struct PendingFrame {
+         FrameConvergence convergence;
+         int numOutstanding;
+      };
+      
+      /**
+       * Get bucket of the move
+       */
+      int getBucket(float error) const;
+      
+      /**
+       * Take the highest priority pending move
+       *
+       * @return Index of the rod, or -1 if nothing is pending
+       */
+      int popMove();
+      
+      /**
+       * One move of the frame is finished or superseded
+       */
+      void moveDone(long frameIndex);
+      
+      /**
+       * Move converged frames from the front of pendingFrames_ to convergence_
+       */
+      void collectConvergedFrames();
+      
+      /**
+       * Size of the board
+       */
+      int sizeX_, sizeY_;
+      
+      /**
+       * Max number of rods moving at once
+       */
+      int maxConcurrentMoves_;
+      
+      /**
+       * Order of moves
+       */
+      MovePriority priority_;
+      
+      /**
+       * Limits of the rods
+       */
+      double maxVelocity_, maxAcceleration_;
+      
+      /**
+       * Errors from this value up share the highest priority bucket
+       */
+      double maxError_;
+      
+      /**
+       * Positions of the rods after all issued waves
+       */
+      std::vector<float> position_;
+      
+      /**
+       * Pending target of every rod, frame that commanded it (-1 if nothing is pending) and stamp of its valid bucket entry
+       */
+      std::vector<float> target_;
+      std::vector<long> pendingFrame_;
+      std::vector<unsigned int> stamp_;
+      
+      /**
+       * Bucket queue. Highest bucket is served first
+       */
+      std::vector<std::deque<BucketEntry> > buckets_;
+      
+      /**
+       * No bucket above this one has entries
+       */
+      int highestBucket_;
+      
+      /**
+       * Number of pending moves
+       */
+      int numPendingMoves_;
+      
+      /**
+       * Frames that are not converged yet, oldest first
+       */
+      std::deque<PendingFrame> pendingFrames_;
+      
+      /**
+       * Converged frames, oldest first
+       */
+      std::deque<FrameConvergence> convergence_;
+      
+      /**
+       * Index of the next frame
+       */
+      long nextFrameIndex_;
+      
+      /**
+       * Current time
+       */
+      double time_;
+      
+      /**
+       * Number of waves issued
+       */
+      long numWaves_;
+   };
+   
+} // namespace
+
+#endif
@@ -0,0 +1,341 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#include "RodKinematicsSimulator.h"
+#include "Frame.h"
+#include "ThreadPool.h"
+#include "SimpleDesignByContract.h"
+
+using namespace hdsim;
+using namespace std;
+
+namespace hdsim {
+   
+   /**
+    * Integrates block of the rows. Every row is owned by exactly one tile, so tiles could run in parallel
+    */
+   class RodStepBody : public TileRangeBody {
+      
+   public:
+      
+      RodStepBody(RodKinematicsSimulator *simulator, float timeInSeconds) : simulator_(simulator), timeInSeconds_(timeInSeconds)
+      {
+      }
+      
+      virtual void processTile(const TileRange &range) const
+      {
+         RodKinematicsSimulator &s = *simulator_;
+         const int sizeX = s.sizeX_;
+         const float dt = timeInSeconds_;
+         const float tolerance = RodKinematicsSimulator::SETTLE_TOLERANCE;
+         
+         for (int y = range.beginY; y < range.endY; y++)
+         {
+            int offset = y * sizeX;
+            
+            float *position = &s.position_[offset];
+            float *velocity = &s.velocity_[offset];
+            const float *target = &s.target_[offset];
+            const float *maxVelocity = &s.maxVelocity_[offset];
+            const float *maxAcceleration = &s.maxAcceleration_[offset];
+            
+            float maxError = 0;
+            int numMoving = 0;
+            int x = 0;
+            
+#ifdef __SSE__
+            const __m128 signMask = _mm_set1_ps(-0.0f);
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 half = _mm_set1_ps(0.5f);
+            const __m128 two = _mm_set1_ps(2.0f);
+            const __m128 dtVector = _mm_set1_ps(dt);
+            const __m128 toleranceVector = _mm_set1_ps(tolerance);
+            __m128 maxErrorVector = zero;
+            
+            // Same as the scalar loop below, four rods at a time
+            for (; x + 4 <= sizeX; x += 4)
+            {
+               __m128 p = _mm_loadu_ps(position + x);
+               __m128 v = _mm_loadu_ps(velocity + x);
+               __m128 t = _mm_loadu_ps(target + x);
+               __m128 a = _mm_loadu_ps(maxAcceleration + x);
+               
+               __m128 error = _mm_sub_ps(t, p);
+               __m128 maxSpeedChange = _mm_mul_ps(a, dtVector);
+               
+               __m128 halfSpeedChange = _mm_mul_ps(half, maxSpeedChange);
+               __m128 approachSpeed = _mm_xor_ps(v, _mm_and_ps(error, signMask));
+               __m128 stoppingSpeedSquared = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(halfSpeedChange, halfSpeedChange), _mm_mul_ps(_mm_mul_ps(two, a), _mm_andnot_ps(signMask, error))), 
+                                                        _mm_mul_ps(maxSpeedChange, approachSpeed));
+               __m128 stoppingSpeed = _mm_max_ps(_mm_sub_ps(_mm_sqrt_ps(_mm_max_ps(stoppingSpeedSquared, zero)), halfSpeedChange), zero);
+               __m128 desiredVelocity = _mm_or_ps(_mm_min_ps(_mm_loadu_ps(maxVelocity + x), stoppingSpeed), _mm_and_ps(error, signMask));
+               
+               __m128 speedChange = _mm_sub_ps(desiredVelocity, v);
+               speedChange = _mm_min_ps(_mm_max_ps(speedChange, _mm_xor_ps(maxSpeedChange, signMask)), maxSpeedChange);
+               
+               __m128 newVelocity = _mm_add_ps(v, speedChange);
+               __m128 newPosition = _mm_add_ps(p, _mm_mul_ps(_mm_mul_ps(_mm_add_ps(v, newVelocity), half), dtVector));
+               __m128 newError = _mm_sub_ps(t, newPosition);
+               
+               __m128 reached = _mm_or_ps(_mm_cmple_ps(_mm_mul_ps(error, newError), zero), _mm_cmple_ps(_mm_andnot_ps(signMask, newError), toleranceVector));
+               __m128 arrived = _mm_and_ps(reached, _mm_cmple_ps(_mm_andnot_ps(signMask, newVelocity), maxSpeedChange));
+               
+               p = _mm_or_ps(_mm_and_ps(arrived, t), _mm_andnot_ps(arrived, newPosition));
+               _mm_storeu_ps(position + x, p);
+               _mm_storeu_ps(velocity + x, _mm_andnot_ps(arrived, newVelocity));
+               
+               numMoving += 4 - __builtin_popcount(_mm_movemask_ps(arrived));
+               maxErrorVector = _mm_max_ps(maxErrorVector, _mm_andnot_ps(signMask, _mm_sub_ps(t, p)));
+            }
+            
+            float maxErrors[4];
+            _mm_storeu_ps(maxErrors, maxErrorVector);
+            maxError = max(max(maxErrors[0], maxErrors[1]), max(maxErrors[2], maxErrors[3]));
+#endif
+            
+            for (; x < sizeX; x++)
+            {
+               float error = target[x] - position[x];
+               float maxSpeedChange = maxAcceleration[x] * dt;
+               
+               // Fastest speed from which rod could still stop at the target, taking into account the distance it moves during this step
+               float halfSpeedChange = 0.5f * maxSpeedChange;
+               float approachSpeed = copysignf(1, error) * velocity[x];
+               float stoppingSpeed = max(sqrtf(max(halfSpeedChange * halfSpeedChange + 2 * maxAcceleration[x] * fabsf(error) - maxSpeedChange * approachSpeed, 0.0f)) - halfSpeedChange, 0.0f);
+               float desiredVelocity = copysignf(min(maxVelocity[x], stoppingSpeed), error);
+               
+               float newVelocity = velocity[x] + min(max(desiredVelocity - velocity[x], -maxSpeedChange), maxSpeedChange);
+               float newPosition = position[x] + (velocity[x] + newVelocity) * 0.5f * dt;
+               float newError = target[x] - newPosition;
+               
+               // Rod that crossed or is close to the target is put there if it could stop in one step. Faster rod overshoots, and comes back
+               bool arrived = (error * newError <= 0  ||  fabsf(newError) <= tolerance)  &&  fabsf(newVelocity) <= maxSpeedChange;
+               
+               position[x] = arrived ? target[x] : newPosition;
+               velocity[x] = arrived ? 0 : newVelocity;
+               
+               numMoving += !arrived;
+               maxError = max(maxError, fabsf(target[x] - position[x]));
+            }
+            
+            s.rowMaxValue_[y] = maxError;
+            s.rowNumMoving_[y] = numMoving;
+         }
+      }
+      
+   private:
+      
+      RodKinematicsSimulator *simulator_;
+      float timeInSeconds_;
+   };
+   
+   /**
+    * Estimates settle time of block of the rows
+    */
+   class RodSettleTimeBody : public TileRangeBody {
+      
+   public:
+      
+      RodSettleTimeBody(const RodKinematicsSimulator *simulator) : simulator_(simulator)
+      {
+      }
+      
+      virtual void processTile(const TileRange &range) const
+      {
+         const RodKinematicsSimulator &s = *simulator_;
+         const int sizeX = s.sizeX_;
+         
+         for (int y = range.beginY; y < range.endY; y++)
+         {
+            int offset = y * sizeX;
+            
+            const float *position = &s.position_[offset];
+            const float *velocity = &s.velocity_[offset];
+            const float *target = &s.target_[offset];
+            const float *maxVelocity = &s.maxVelocity_[offset];
+            const float *maxAcceleration = &s.maxAcceleration_[offset];
+            
+            float maxTime = 0;
+            
+            for (int x = 0; x < sizeX; x++)
+            {
+               float a = maxAcceleration[x];
+               float v = maxVelocity[x];
+               
+               // Stop first
+               float stopTime = fabsf(velocity[x]) / a;
+               float stopDistance = velocity[x] * fabsf(velocity[x]) / (2 * a);
+               
+               // Then go from rest to rest, reaching max speed only if distance is long enough
+               float distance = fabsf(target[x] - position[x] - stopDistance);
+               float moveTime = distance <= v * v / a ? 2 * sqrtf(distance / a) : distance / v + v / a;
+               
+               maxTime = max(maxTime, stopTime + moveTime);
+            }
+            
+            s.rowMaxValue_[y] = maxTime;
+         }
+      }
+      
+   private:
+      
+      const RodKinematicsSimulator *simulator_;
+   };
+   
+} // namespace
+
+RodKinematicsSimulator::RodKinematicsSimulator(int sizeX, int sizeY, double maxVelocity, double maxAcceleration, ThreadPool *pool) : 
+                                               sizeX_(sizeX), sizeY_(sizeY), position_(sizeX * sizeY), velocity_(sizeX * sizeY), target_(sizeX * sizeY), 
+                                               maxVelocity_(sizeX * sizeY, maxVelocity), maxAcceleration_(sizeX * sizeY, maxAcceleration), rowMaxValue_(sizeY), 
+                                               rowNumMoving_(sizeY), pool_(pool ? pool : ThreadPool::getSharedPool()), numMovingRods_(0), maxError_(0), 
+                                               stepsSinceCommand_(0), stepsToSettle_(0)
+{
+   PRECONDITION(sizeX >= 0  &&  sizeY >= 0  &&  maxVelocity > 0  &&  maxAcceleration > 0);
+}
+
+RodKinematicsSimulator::~RodKinematicsSimulator()
+{
+}
+
+void RodKinematicsSimulator::setLimits(int index, double maxVelocity, double maxAcceleration)
+{
+   PRECONDITION(index >= 0  &&  index < sizeX_ * sizeY_  &&  maxVelocity > 0  &&  maxAcceleration > 0);
+   
+   maxVelocity_[index] = maxVelocity;
+   maxAcceleration_[index] = maxAcceleration;
+}
+
+void RodKinematicsSimulator::commandChanged()
+{
+   numMovingRods_ = sizeX_ * sizeY_;
+   stepsSinceCommand_ = 0;
+   stepsToSettle_ = -1;
+}
+
+void RodKinematicsSimulator::command(const float *values)
+{
+   PRECONDITION(values  ||  target_.empty());
+   
+   if (!target_.empty())
+      memcpy(&target_[0], values, target_.size() * sizeof(float));
+   
+   commandChanged();
+}
+
+void RodKinematicsSimulator::commandModel(const AbstractModel *model)
+{
+   PRECONDITION(model  &&  model->getSizeX() == sizeX_  &&  model->getSizeY() == sizeY_);
+   
+   if (!strcmp(model->getModelName(), FRAME_MODEL_NAME))
+   {
+      command(static_cast<const Frame *>(model)->getValues());
+      return;
+   }
+   
+   for (int y = 0; y < sizeY_; y++)
+      for (int x = 0; x < sizeX_; x++)
+         target_[y * sizeX_ + x] = model->getAt(x, y);
+   
+   commandChanged();
+}
+
+void RodKinematicsSimulator::command(int index, float value)
+{
+   PRECONDITION(index >= 0  &&  index < sizeX_ * sizeY_);
+   
+   target_[index] = value;
+   commandChanged();
+}
+
+void RodKinematicsSimulator::updatesReady(const vector<ActuatorUpdate> &updates, const vector<ActuatorUpdateBatch> &batches, const DeltaUpdateStage &stage)
+{
+   for (int i = 0; i < updates.size(); i++)
+   {
+      CHECK(updates[i].index >= 0  &&  updates[i].index < sizeX_ * sizeY_, "Update outside of the board");
+      target_[updates[i].index] = updates[i].value;
+   }
+   
+   commandChanged();
+}
+
+void RodKinematicsSimulator::setActual(const float *values)
+{
+   PRECONDITION(values  ||  position_.empty());
+   
+   if (!position_.empty())
+      memcpy(&position_[0], values, position_.size() * sizeof(float));
+   
+   fill(velocity_.begin(), velocity_.end(), 0.0f);
+   commandChanged();
+}
+
+void RodKinematicsSimulator::step(double timeInSeconds)
+{
+   PRECONDITION(timeInSeconds >= 0);
+   
+   if (!position_.empty())
+      parallelFor2D(pool_, sizeX_, sizeY_, sizeX_, ROWS_PER_TASK, RodStepBody(this, timeInSeconds));
+   
+   numMovingRods_ = 0;
+   maxError_ = 0;
+   
+   for (int y = 0; y < sizeY_; y++)
+   {
+      numMovingRods_ += rowNumMoving_[y];
+      maxError_ = max(maxError_, (double)rowMaxValue_[y]);
+   }
+   
+   stepsSinceCommand_++;
+   
+   if (!numMovingRods_  &&  stepsToSettle_ < 0)
+      stepsToSettle_ = stepsSinceCommand_;
+}
+
+double RodKinematicsSimulator::estimateTimeUntilSettled() const
+{
+   if (position_.empty())
+      return 0;
+   
+   parallelFor2D(pool_, sizeX_, sizeY_, sizeX_, ROWS_PER_TASK, RodSettleTimeBody(this));
+   
+   return *max_element(rowMaxValue_.begin(), rowMaxValue_.end());
+}
+
+double RodKinematicsSimulator::getMoveTime(double distance, double maxVelocity, double maxAcceleration)
+{
+   PRECONDITION(maxVelocity > 0  &&  maxAcceleration > 0);
+   
+   distance = fabs(distance);
+   
+   return distance <= maxVelocity * maxVelocity / maxAcceleration ? 2 * sqrt(distance / maxAcceleration) : distance / maxVelocity + maxVelocity / maxAcceleration;
+}
+
+long RodKinematicsSimulator::estimateFramesUntilSettled(double frameDurationInSeconds) const
+{
+   PRECONDITION(frameDurationInSeconds > 0);
+   
+   return (long)ceil(estimateTimeUntilSettled() / frameDurationInSeconds);
+}
@@ -0,0 +1,301 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ROD_KINEMATICS_SIMULATOR_H_
+#define ROD_KINEMATICS_SIMULATOR_H_
+
+#include <vector>
+
+#include "DeltaUpdateStage.h"
+
+namespace hdsim {
+   
+   class ThreadPool;
+   
+   /**
+    * Simulated actuator layer. Calculated frames assume that rods teleport to their positions, while real rods have limited speed and acceleration. This
+    * class moves every rod toward its commanded position under its own velocity and acceleration limits, so that we could see the board as hardware 
+    * would show it, and how long it takes to get there.
+    *
+    * State is kept as separate arrays of positions, velocities, targets and limits, so the integration is a straight, branch free loop over the whole 
+    * board, done with SSE four rods at a time (scalar on the other CPUs) and split in row blocks between the threads of the pool. Simulator could be fed with whole boards, or used as the sink 
+    * of the DeltaUpdateStage.
+    */
+   class RodKinematicsSimulator : public ActuatorUpdateSink {
+      
+   public:
+      
+      /**
+       * Default max speed of the rod, in depth units per second
+       */
+      static const double DEFAULT_MAX_VELOCITY = 0.5;
+      
+      /**
+       * Default max acceleration of the rod, in depth units per second squared
+       */
+      static const double DEFAULT_MAX_ACCELERATION = 5.0;
+      
+      /**
+       * Rod closer than this to its target (and slow enough to stop) is considered settled
+       */
+      static const double SETTLE_TOLERANCE = 1.0 / 4096;
+      
+      /**
+       * Number of rows integrated by the single task
+       */
+      static const int ROWS_PER_TASK = 16;
+      
+      /**
+       * Constructor. All rods start settled at 0
+       *
+       * @param sizeX Size of the board in X direction
+       * @param sizeY Size of the board in Y direction
+       * @param maxVelocity Max speed of every rod
+       * @param maxAcceleration Max acceleration of every rod
+       * @param pool Pool used for the integration, or 0 for the shared pool
+       */
+      RodKinematicsSimulator(int sizeX, int sizeY, double maxVelocity = DEFAULT_MAX_VELOCITY, double maxAcceleration = DEFAULT_MAX_ACCELERATION, 
+                             ThreadPool *pool = 0);
+      
+      /**
+       * Destructor
+       */
+      virtual ~RodKinematicsSimulator();
+      
+      /**
+       * Set limits of the single rod
+       *
+       * @param index Index of the rod, y * sizeX + x
+       * @param maxVelocity Max speed of the rod
+       * @param maxAcceleration Max acceleration of the rod
+       */
+      virtual void setLimits(int index, double maxVelocity, double maxAcceleration);
+      
+      /**
+       * Command all rods
+       *
+       * @param values Commanded positions, stored so that [x][y] corresponds to [y * sizeX + x]
+       */
+      virtual void command(const float *values);
+      
+      /**
+       * Command all rods from the model of the same size
+       *
+       * @param model Model with the commanded positions
+       */
+      virtual void commandModel(const AbstractModel *model);
+      
+      /**
+       * Command single rod
+       *
+       * @param index Index of the rod, y * sizeX + x
+       * @param value Commanded position
+       */
+      virtual void command(int index, float value);
+      
+      /**
+       * Move all rods for the given time
+       *
+       * @param timeInSeconds Time step
+       */
+      virtual void step(double timeInSeconds);
+      
+      /**
+       * Place all rods at the given positions, at rest
+       *
+       * @param values Positions, stored so that [x][y] corresponds to [y * sizeX + x]
+       */
+      virtual void setActual(const float *values);
+      
+      /**
+       * Get actual board, as hardware shows it
+       *
+       * @return Actual positions of the rods
+       */
+      virtual const std::vector<float> &getActual() const
+      {
+         return position_;
+      }
+      
+      /**
+       * Get commanded board
+       *
+       * @return Commanded positions of the rods
+       */
+      virtual const std::vector<float> &getCommanded() const
+      {
+         return target_;
+      }
+      
+      /**
+       * Get velocities of the rods
+       *
+       * @return Velocities of the rods
+       */
+      virtual const std::vector<float> &getVelocities() const
+      {
+         return velocity_;
+      }
+      
+      /**
+       * Get number of rods that were not settled after the last step. After the command, all rods count as moving until the next step
+       *
+       * @return Number of moving rods
+       */
+      virtual int getNumMovingRods() const
+      {
+         return numMovingRods_;
+      }
+      
+      /**
+       * Are all rods settled
+       *
+       * @return Are all rods settled
+       */
+      virtual bool isSettled() const
+      {
+         return numMovingRods_ == 0;
+      }
+      
+      /**
+       * Get largest distance between actual and commanded position after the last step
+       *
+       * @return Largest error
+       */
+      virtual double getMaxError() const
+      {
+         return maxError_;
+      }
+      
+      /**
+       * Estimate time until all rods settle, if commanded positions don't change. Estimate is an upper bound: every rod first stops, then moves to the 
+       * target with the fastest trapezoidal profile
+       *
+       * @return Estimated time until all rods settle, in seconds
+       */
+      virtual double estimateTimeUntilSettled() const;
+      
+      /**
+       * Estimate number of frames until all rods settle
+       *
+       * @param frameDurationInSeconds Duration of the frame
+       *
+       * @return Estimated number of frames until all rods settle
+       */
+      virtual long estimateFramesUntilSettled(double frameDurationInSeconds) const;
+      
+      /**
+       * Get time of the fastest move of the rod from rest to rest, using trapezoidal profile (or triangular one, if distance is too short to reach
+       * max speed)
+       *
+       * @param distance Distance of the move
+       * @param maxVelocity Max speed of the rod
+       * @param maxAcceleration Max acceleration of the rod
+       *
+       * @return Time of the move, in seconds
+       */
+      static double getMoveTime(double distance, double maxVelocity, double maxAcceleration);
+      
+      /**
+       * Get number of steps it took to settle after the last command, as it was measured
+       *
+       * @return Number of steps, or -1 if rods didn't settle since the last command
+       */
+      virtual long getStepsToSettle() const
+      {
+         return stepsToSettle_;
+      }
+      
+      /**
+       * Get size of the board in X direction
+       *
+       * @return Size in X direction
+       */
+      virtual int getSizeX() const
+      {
+         return sizeX_;
+      }
+      
+      /**
+       * Get size of the board in Y direction
+       *
+       * @return Size in Y direction
+       */
+      virtual int getSizeY() const
+      {
+         return sizeY_;
+      }
+      
+      // Overriden methods
+      virtual void updatesReady(const std::vector<ActuatorUpdate> &updates, const std::vector<ActuatorUpdateBatch> &batches, const DeltaUpdateStage &stage);
+      
+   private:
+      
+      // copying is not supported
+      RodKinematicsSimulator(const RodKinematicsSimulator &rhs);
+      RodKinematicsSimulator &operator=(const RodKinematicsSimulator &rhs);
+      
+      friend class RodStepBody;
+      friend class RodSettleTimeBody;
+      
+      /**
+       * Called after commanded positions changed
+       */
+      void commandChanged();
+      
+      /**
+       * Size of the board
+       */
+      int sizeX_, sizeY_;
+      
+      /**
+       * State of the rods
+       */
+      std::vector<float> position_, velocity_, target_;
+      
+      /**
+       * Limits of the rods
+       */
+      std::vector<float> maxVelocity_, maxAcceleration_;
+      
+      /**
+       * Per row results of the last pass, reduced after it
+       */
+      mutable std::vector<float> rowMaxValue_;
+      std::vector<int> rowNumMoving_;
+      
+      /**
+       * Pool used for the integration
+       */
+      ThreadPool *pool_;
+      
+      /**
+       * Results of the last step
+       */
+      int numMovingRods_;
+      double maxError_;
+      
+      /**
+       * Steps since the last command, and steps it took to settle
+       */
+      long stepsSinceCommand_, stepsToSettle_;
+   };
+   
+} // namespace
+
+#endif
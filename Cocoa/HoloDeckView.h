@@ -21,6 +21,9 @@
 
 #import "AbstractDrawingCode.h"
 #import "MouseAdapter.h"
+#import "SessionRecorder.h"
+#import "SharedFrameBus.h"
+#import "FrameServer.h"
 #import "HoloSimDocument.h"
 
 using namespace hdsim;
@@ -145,6 +148,26 @@ using namespace hdsim;
     */
    MouseAdapter *mouseAdapter;
    
+   /**
+    * Records session so that it could be replayed later. Active only if RECORD_SESSION_KEY preference is set
+    */
+   SessionRecorder *sessionRecorder;
+   
+   /**
+    * Publishes calculated frames to other processes. Active only if PUBLISH_FRAME_BUS_KEY preference is set
+    */
+   SharedFrameBus *frameBus;
+   
+   /**
+    * Streams calculated frames to the subscribers over the socket. Active only if SERVE_FRAMES_KEY preference is set
+    */
+   FrameServer *frameServer;
+   
+   /**
+    * Are calculated boards stored as sparse frames. Set from SPARSE_FRAMES_KEY preference
+    */
+   BOOL sparseFrames;
+   
 @private
    
    /**
@@ -265,6 +265,15 @@ static void logPerformance(const AbstractModel *model, double moxelCalcMicroSeco
    // Delete OpenGL context   
    delete drawer;
    drawer = NULL;
+   
+   delete sessionRecorder;
+   sessionRecorder = NULL;
+   
+   delete frameBus;
+   frameBus = NULL;
+   
+   delete frameServer;
+   frameServer = NULL;
 }
 
 /**
@@ -399,6 +408,36 @@ static void logPerformance(const AbstractModel *model, double moxelCalcMicroSeco
    animationRunning = NO;
    openGLAnimationTimer = nil;
    
+   sessionRecorder = new SessionRecorder();
+   if ([[NSUserDefaults standardUserDefaults] boolForKey:RECORD_SESSION_KEY])
+   {
+      AbstractModel *m = [model model];
+      
+      if (!sessionRecorder->open(SESSION_RECORDING_FILE_NAME, m ? m->getFileName() : ""))
+         LOG("Error opening session recording");
+   }
+   
+   // Bus is created on the first frame, once we know the size of the board
+   frameBus = NULL;
+   if ([[NSUserDefaults standardUserDefaults] boolForKey:PUBLISH_FRAME_BUS_KEY])
+      frameBus = new SharedFrameBus();
+   
+   frameServer = NULL;
+   if ([[NSUserDefaults standardUserDefaults] boolForKey:SERVE_FRAMES_KEY])
+   {
+      frameServer = new FrameServer();
+      
+      if (!frameServer->startUnix(DEFAULT_FRAME_SERVER_PATH))
+      {
+         LOG("Error starting frame server");
+         
+         delete frameServer;
+         frameServer = NULL;
+      }
+   }
+   
+   sparseFrames = [[NSUserDefaults standardUserDefaults] boolForKey:SPARSE_FRAMES_KEY];
+   
    [self setupAnimation];
 }
 
@@ -701,8 +740,43 @@ void normalizeBounds(double *minX, double *maxX, double *minY, double *maxY, dou
    m->setOptimizeDrawing([model optimizeDrawing]);
    m->setMoxelThreshold([model optimizeDrawingThreshold]);
    
+   // Drawer draws the sparse frame, if the model stored one
+   m->getGeometryModel()->setSparseFrames(sparseFrames);
+   
+   if (sessionRecorder  &&  sessionRecorder->isRecording())
+   {
+      // Recorder skips values that didn't change, so we could record everything on every frame
+      sessionRecorder->recordRenderedArea(renderMinX, renderMinY, renderMinZ, renderMaxX, renderMaxY, renderMaxZ);
+      sessionRecorder->recordOptimizeDrawing([model optimizeDrawing]);
+      sessionRecorder->recordMoxelThreshold([model optimizeDrawingThreshold]);
+      sessionRecorder->recordInterframeDistance([model interframeDistance]);
+      sessionRecorder->recordTimeSlice(m->getTimeSlice());
+      sessionRecorder->recordRotationAngles(drawer->getRotationAngleX(), drawer->getRotationAngleY(), drawer->getRotationAngleZ());
+      sessionRecorder->recordFOV(drawer->getFOV());
+      sessionRecorder->recordFrame();
+   }
+   
    drawer->draw(m);
    
+   if (frameBus)
+   {
+      // Actuators need the whole board, not the one decimated for drawing
+      GPUGeometryModel *geometryModel = m->getGeometryModel();
+      
+      if (!frameBus->isCreated()  ||  frameBus->getSizeX() != geometryModel->getSizeX()  ||  frameBus->getSizeY() != geometryModel->getSizeY())
+      {
+         if (!frameBus->create(DEFAULT_FRAME_BUS_NAME, geometryModel->getSizeX(), geometryModel->getSizeY()))
+            LOG("Error creating frame bus");
+      }
+      
+      if (frameBus->isCreated())
+         frameBus->publishModel(geometryModel, m->getTimeSlice());
+   }
+   
+   // Frame is copied out of the model only if somebody would receive it
+   if (frameServer  &&  frameServer->getNumSubscribers() > 0)
+      frameServer->publish(Frame::createFromModel(m->getGeometryModel(), m->getTimeSlice()));
+   
    // Get statistics
    Statistics fpsStatistics = drawer->getAllFrameRenderingStatistics();
    Statistics moxelCalculationStatistics = m->getMoxelCalculationStatistics();
@@ -784,17 +858,7 @@ void normalizeBounds(double *minX, double *maxX, double *minY, double *maxY, dou
       if (!m)
          return;
       
-      newTimeslice = m->getTimeSlice() + [model interframeDistance];
-            
-      if ([model loopAnimation])
-      {
-         // Loop at the same place from the beginning as would be if this was circular tape. Helps with avoiding discontinuity at the moment of jump
-         newTimeslice = newTimeslice < GPUInterpolatedModel::MAX_TIME_SLICE ? newTimeslice : (newTimeslice - GPUInterpolatedModel::MAX_TIME_SLICE) + GPUInterpolatedModel::MIN_TIME_SLICE;
-      }
-		else
-      {
-	      newTimeslice = newTimeslice <= GPUInterpolatedModel::MAX_TIME_SLICE ? newTimeslice : GPUInterpolatedModel::MAX_TIME_SLICE;
-      }
+      newTimeslice = GPUInterpolatedModel::getNextTimeSlice(m->getTimeSlice(), [model interframeDistance], [model loopAnimation]);
       
       m->setTimeSlice(newTimeslice);
    }
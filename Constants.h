@@ -97,6 +97,31 @@ static const NSString *OPTIMIZE_THRESHOLD_KEY = @"optimizeThreshold";
  */
 static const NSString *LOG_PERFORMANCE_KEY = @"logPerformance";
 
+/**
+ * Preference key for recording of the session, so that it could be replayed later with HoloSimReplay
+ */
+static const NSString *RECORD_SESSION_KEY = @"recordSession";
+
+/**
+ * Name of the file to which session is recorded
+ */
+static const char *SESSION_RECORDING_FILE_NAME = "session.hsr";
+
+/**
+ * Preference key for publishing of the calculated frames to the shared memory frame bus, so that actuator drivers and monitoring tools could read them
+ */
+static const NSString *PUBLISH_FRAME_BUS_KEY = @"publishFrameBus";
+
+/**
+ * Preference key for streaming of the calculated frames over the DEFAULT_FRAME_SERVER_PATH socket, so that remote visualizers could subscribe to them
+ */
+static const NSString *SERVE_FRAMES_KEY = @"serveFrames";
+
+/**
+ * Preference key for storing of the calculated boards as sparse frames, so that mostly empty scenes are decimated and drawn only where geometry is
+ */
+static const NSString *SPARSE_FRAMES_KEY = @"sparseFrames";
+
 /**
  * Minimum value for optimizing threshold
  */
@@ -0,0 +1,342 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include "FrameScheduler.h"
+#include "GPUInterpolatedModel.h"
+#include "FramePrefetcher.h"
+#include "TemporalFrameInterpolator.h"
+#include "SimpleDesignByContract.h"
+
+using namespace hdsim;
+using namespace std;
+
+FrameSink::~FrameSink()
+{
+}
+
+FrameScheduler::FrameScheduler(GPUInterpolatedModel *model, double framesPerSecond) : model_(model), framesPerSecond_(framesPerSecond), prefetcher_(0),
+                                                                                      interpolator_(0), interframeDistance_(0), loopAnimation_(true), running_(false), 
+                                                                                      stopRequested_(false)
+{
+   PRECONDITION(model);
+   PRECONDITION(framesPerSecond > 0);
+   
+   pthread_mutex_init(&mutex_, 0);
+   resetStatistics();
+}
+
+FrameScheduler::~FrameScheduler()
+{
+   stop();
+   pthread_mutex_destroy(&mutex_);
+}
+
+void FrameScheduler::addSink(FrameSink *sink)
+{
+   PRECONDITION(sink);
+   PRECONDITION(!isRunning());
+   
+   sinks_.push_back(sink);
+}
+
+void FrameScheduler::removeSink(FrameSink *sink)
+{
+   PRECONDITION(!isRunning());
+   
+   sinks_.erase(remove(sinks_.begin(), sinks_.end(), sink), sinks_.end());
+}
+
+void FrameScheduler::setPrefetcher(FramePrefetcher *prefetcher)
+{
+   PRECONDITION(!isRunning());
+   
+   prefetcher_ = prefetcher;
+}
+
+void FrameScheduler::setInterpolator(TemporalFrameInterpolator *interpolator)
+{
+   PRECONDITION(!isRunning());
+   
+   interpolator_ = interpolator;
+}
+
+void FrameScheduler::setInterframeDistance(double distance)
+{
+   pthread_mutex_lock(&mutex_);
+   interframeDistance_ = distance;
+   pthread_mutex_unlock(&mutex_);
+}
+
+double FrameScheduler::getInterframeDistance() const
+{
+   pthread_mutex_lock(&mutex_);
+   double distance = interframeDistance_;
+   pthread_mutex_unlock(&mutex_);
+   
+   return distance;
+}
+
+void FrameScheduler::setLoopAnimation(bool loop)
+{
+   pthread_mutex_lock(&mutex_);
+   loopAnimation_ = loop;
+   pthread_mutex_unlock(&mutex_);
+}
+
+bool FrameScheduler::getLoopAnimation() const
+{
+   pthread_mutex_lock(&mutex_);
+   bool loop = loopAnimation_;
+   pthread_mutex_unlock(&mutex_);
+   
+   return loop;
+}
+
+bool FrameScheduler::start()
+{
+   if (isRunning())
+      return true;
+   
+   pthread_mutex_lock(&mutex_);
+   stopRequested_ = false;
+   pthread_mutex_unlock(&mutex_);
+   
+   if (pthread_create(&thread_, 0, threadMain, this))
+   {
+      LOG("Unable to start frame scheduler thread");
+      return false;
+   }
+   
+   running_ = true;
+   return true;
+}
+
+void FrameScheduler::stop()
+{
+   if (!isRunning())
+      return;
+   
+   pthread_mutex_lock(&mutex_);
+   stopRequested_ = true;
+   pthread_mutex_unlock(&mutex_);
+   
+   pthread_join(thread_, 0);
+   running_ = false;
+}
+
+bool FrameScheduler::isRunning() const
+{
+   return running_;
+}
+
+bool FrameScheduler::isStopRequested() const
+{
+   pthread_mutex_lock(&mutex_);
+   bool stopRequested = stopRequested_;
+   pthread_mutex_unlock(&mutex_);
+   
+   return stopRequested;
+}
+
+void FrameScheduler::runFrames(long numFrames)
+{
+   PRECONDITION(!isRunning());
+   PRECONDITION(numFrames >= 0);
+   
+   pthread_mutex_lock(&mutex_);
+   stopRequested_ = false;
+   pthread_mutex_unlock(&mutex_);
+   
+   runLoop(numFrames);
+}
+
+void *FrameScheduler::threadMain(void *scheduler)
+{
+   static_cast<FrameScheduler *>(scheduler)->runLoop(-1);
+   return 0;
+}
+
+void FrameScheduler::runLoop(long maxFrames)
+{
+   const long long periodInMicroSeconds = (long long)(1000000.0/framesPerSecond_);
+   const long long startTimeInMicroSeconds = getMonotonicTimeInMicroSeconds();
+   
+   long frameIndex = 0;
+   
+   if (interpolator_)
+   {
+      interpolator_->setAnimation(getInterframeDistance(), getLoopAnimation());
+      interpolator_->seek(model_->getTimeSlice());
+   }
+   else if (prefetcher_)
+   {
+      prefetcher_->setAnimation(getInterframeDistance(), getLoopAnimation());
+      prefetcher_->seek(model_->getTimeSlice());
+   }
+   
+   while ((maxFrames < 0  ||  frameIndex < maxFrames)  &&  !isStopRequested())
+   {
+      pthread_mutex_lock(&mutex_);
+      double distance = interframeDistance_;
+      bool loop = loopAnimation_;
+      pthread_mutex_unlock(&mutex_);
+      
+      ScheduledFrameTiming timing;
+      timing.frameIndex = frameIndex;
+      timing.deadlineInMicroSeconds = startTimeInMicroSeconds + (frameIndex + 1) * periodInMicroSeconds;
+      
+      // Calculate frame ahead of its deadline, or just take it if it was prefetched
+      const AbstractModel *frame = model_;
+      FrameHandle prefetchedFrame;
+      
+      timing.calculationStartInMicroSeconds = getMonotonicTimeInMicroSeconds();
+      
+      if (interpolator_)
+      {
+         // Interpolator recalculates key frames only if parameters actually changed
+         interpolator_->setAnimation(distance, loop);
+         
+         prefetchedFrame = interpolator_->popFrame();
+         frame = prefetchedFrame.get();
+         
+         timing.timeSlice = prefetchedFrame->getTimeSlice();
+         model_->setTimeSlice(timing.timeSlice);
+      }
+      else if (prefetcher_)
+      {
+         // Prefetcher invalidates its queue only if parameters actually changed
+         prefetcher_->setAnimation(distance, loop);
+         
+         prefetchedFrame = prefetcher_->popFrame();
+         frame = prefetchedFrame.get();
+         
+         timing.timeSlice = prefetchedFrame->getTimeSlice();
+         model_->setTimeSlice(timing.timeSlice);
+      }
+      else
+      {
+         timing.timeSlice = GPUInterpolatedModel::getNextTimeSlice(model_->getTimeSlice(), distance, loop);
+         
+         model_->setTimeSlice(timing.timeSlice);
+         
+         // With progressive refinement, board is refined until shortly before the deadline, leaving time to read it out and present it
+         model_->getGeometryModel()->setCalculationDeadline(timing.deadlineInMicroSeconds - periodInMicroSeconds / 10);
+         model_->forceModelCalculation();
+      }
+      
+      timing.calculationEndInMicroSeconds = getMonotonicTimeInMicroSeconds();
+      
+      // And present it at the deadline
+      waitUntil(timing.deadlineInMicroSeconds);
+      timing.presentationInMicroSeconds = getMonotonicTimeInMicroSeconds();
+      
+      for (int i = 0; i < sinks_.size(); i++)
+         sinks_[i]->frameReady(frame, timing);
+      
+      accountFrame(timing);
+      frameIndex++;
+      
+      // If deadline of the next slot has already passed, skip slots until we are back on schedule. Timeslice is advanced for the skipped slots, so 
+      // animation keeps wall clock speed
+      long onScheduleIndex = (long)((getMonotonicTimeInMicroSeconds() - startTimeInMicroSeconds)/periodInMicroSeconds);
+      if (maxFrames >= 0)
+         onScheduleIndex = min(onScheduleIndex, maxFrames);
+      
+      if (onScheduleIndex > frameIndex)
+      {
+         double timeSlice = model_->getTimeSlice();
+         for (long i = frameIndex; i < onScheduleIndex; i++)
+            timeSlice = GPUInterpolatedModel::getNextTimeSlice(timeSlice, distance, loop);
+         
+         model_->setTimeSlice(timeSlice);
+         
+         if (interpolator_)
+            interpolator_->skipFrames(onScheduleIndex - frameIndex);
+         else if (prefetcher_)
+            prefetcher_->skipFrames(onScheduleIndex - frameIndex);
+         
+         pthread_mutex_lock(&mutex_);
+         statistics_.numSkippedFrames += onScheduleIndex - frameIndex;
+         pthread_mutex_unlock(&mutex_);
+         
+         frameIndex = onScheduleIndex;
+      }
+   }
+}
+
+void FrameScheduler::accountFrame(const ScheduledFrameTiming &timing)
+{
+   double slack = (double)(timing.deadlineInMicroSeconds - timing.calculationEndInMicroSeconds);
+   double jitter = (double)(timing.presentationInMicroSeconds - timing.deadlineInMicroSeconds);
+   double calculationTime = (double)(timing.calculationEndInMicroSeconds - timing.calculationStartInMicroSeconds);
+   
+   jitter = jitter < 0 ? -jitter : jitter;
+   
+   pthread_mutex_lock(&mutex_);
+   
+   if (statistics_.numFrames == 0)
+      statistics_.minSlackInMicroSeconds = slack;
+   
+   statistics_.numFrames++;
+   
+   if (slack < 0)
+      statistics_.numDeadlineMisses++;
+   
+   // Means are kept as sums, getStatistics() divides them
+   statistics_.meanJitterInMicroSeconds += jitter;
+   statistics_.meanSlackInMicroSeconds += slack;
+   statistics_.meanCalculationTimeInMicroSeconds += calculationTime;
+   
+   statistics_.maxJitterInMicroSeconds = max(statistics_.maxJitterInMicroSeconds, jitter);
+   statistics_.minSlackInMicroSeconds = min(statistics_.minSlackInMicroSeconds, slack);
+   statistics_.maxCalculationTimeInMicroSeconds = max(statistics_.maxCalculationTimeInMicroSeconds, calculationTime);
+   
+   pthread_mutex_unlock(&mutex_);
+}
+
+FrameSchedulerStatistics FrameScheduler::getStatistics() const
+{
+   pthread_mutex_lock(&mutex_);
+   FrameSchedulerStatistics statistics = statistics_;
+   pthread_mutex_unlock(&mutex_);
+   
+   if (statistics.numFrames > 0)
+   {
+      statistics.meanJitterInMicroSeconds /= statistics.numFrames;
+      statistics.meanSlackInMicroSeconds /= statistics.numFrames;
+      statistics.meanCalculationTimeInMicroSeconds /= statistics.numFrames;
+   }
+   
+   return statistics;
+}
+
+void FrameScheduler::resetStatistics()
+{
+   pthread_mutex_lock(&mutex_);
+   
+   statistics_.numFrames = 0;
+   statistics_.numDeadlineMisses = 0;
+   statistics_.numSkippedFrames = 0;
+   statistics_.meanJitterInMicroSeconds = statistics_.maxJitterInMicroSeconds = 0;
+   statistics_.meanSlackInMicroSeconds = statistics_.minSlackInMicroSeconds = 0;
+   statistics_.meanCalculationTimeInMicroSeconds = statistics_.maxCalculationTimeInMicroSeconds = 0;
+   
+   pthread_mutex_unlock(&mutex_);
+}
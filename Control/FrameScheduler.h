@@ -0,0 +1,368 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_SCHEDULER_H_
+#define FRAME_SCHEDULER_H_
+
+#include <vector>
+
+#include <pthread.h>
+
+#include "PreciseDelay.h"
+
+namespace hdsim {
+   
+   class AbstractModel;
+   class GPUInterpolatedModel;
+   class FramePrefetcher;
+   class TemporalFrameInterpolator;
+   
+   /**
+    * Timing of the single frame produced by the FrameScheduler. All times are from getMonotonicTimeInMicroSeconds()
+    */
+   struct ScheduledFrameTiming {
+      /**
+       * Index of the frame slot since scheduler was started. Skipped slots are counted too
+       */
+      long frameIndex;
+      
+      /**
+       * Timeslice at which frame was calculated
+       */
+      double timeSlice;
+      
+      /**
+       * Time at which frame should be presented
+       */
+      long long deadlineInMicroSeconds;
+      
+      /**
+       * Time at which calculation of the frame started
+       */
+      long long calculationStartInMicroSeconds;
+      
+      /**
+       * Time at which calculation of the frame was finished
+       */
+      long long calculationEndInMicroSeconds;
+      
+      /**
+       * Time at which frame was handed to the sinks
+       */
+      long long presentationInMicroSeconds;
+   };
+   
+   /**
+    * Receiver of the frames produced by the FrameScheduler
+    */
+   class FrameSink {
+      
+   public:
+      
+      /**
+       * Destructor
+       */
+      virtual ~FrameSink();
+      
+      /**
+       * Called from the scheduler thread at the deadline of the frame. Frame is calculated for the frame timeslice and would not be changed by the scheduler 
+       * until this call returns, so it is safe to read it here. Time spent here is counted against the next frame
+       *
+       * @param frame Calculated frame. This is the animated model itself, or the prefetched (interpolated) Frame if scheduler uses prefetcher (interpolator)
+       * @param timing Timing of the frame
+       */
+      virtual void frameReady(const AbstractModel *frame, const ScheduledFrameTiming &timing) = 0;
+   };
+   
+   /**
+    * Aggregate deadline accounting of the FrameScheduler
+    */
+   struct FrameSchedulerStatistics {
+      /**
+       * Number of frames presented
+       */
+      long numFrames;
+      
+      /**
+       * Number of frames whose calculation (or wait for the prefetched frame) finished after the deadline
+       */
+      long numDeadlineMisses;
+      
+      /**
+       * Number of frame slots that were skipped because we were late more than a whole frame
+       */
+      long numSkippedFrames;
+      
+      /**
+       * Mean and max absolute difference between the deadline and the actual presentation time
+       */
+      double meanJitterInMicroSeconds, maxJitterInMicroSeconds;
+      
+      /**
+       * Mean and min time between end of calculation and the deadline. Negative slack means that deadline was missed
+       */
+      double meanSlackInMicroSeconds, minSlackInMicroSeconds;
+      
+      /**
+       * Mean and max time needed for calculation of the frame
+       */
+      double meanCalculationTimeInMicroSeconds, maxCalculationTimeInMicroSeconds;
+   };
+   
+   /**
+    * Fixed rate frame loop that doesn't depend on Cocoa. It advances timeslice of the GPUInterpolatedModel by interframe distance on every frame, the same way
+    * as HoloDeckView animation does, calculates the frame ahead of its deadline, waits for the deadline using hybrid sleep-then-spin wait and hands the frame 
+    * to the registered sinks. 
+    *
+    * Frame loop runs on the dedicated thread (start()/stop()) or on the calling thread (runFrames()). While scheduler is running it owns the model - model 
+    * must not be used from other threads except from inside FrameSink::frameReady(). 
+    *
+    * With prefetcher set, frames are calculated ahead by the FramePrefetcher and scheduler only pops them, so "calculation time" becomes the time spent 
+    * waiting for the prefetched frame.
+    *
+    * With interpolator set, only key frames are calculated (ahead, by its prefetcher) and frames between them are interpolated, so scheduler could run at
+    * the rate higher than the rate at which frames could be calculated.
+    *
+    * If we are late more than a whole frame, missed frame slots are skipped (but timeslice is advanced for them) so that animation keeps wall clock speed 
+    * instead of trying to catch up.
+    */
+   class FrameScheduler {
+      
+   public:
+      
+      /**
+       * Constructor
+       *
+       * @param model Model to animate. Scheduler doesn't own model
+       * @param framesPerSecond Rate at which frames should be produced
+       */
+      FrameScheduler(GPUInterpolatedModel *model, double framesPerSecond);
+      
+      /**
+       * Destructor. Stops the scheduler if it is running
+       */
+      virtual ~FrameScheduler();
+      
+      /**
+       * Register sink that would receive frames. Sink is not owned by the scheduler
+       *
+       * PRECONDITION: Scheduler must not be running
+       *
+       * @param sink Sink to add
+       */
+      virtual void addSink(FrameSink *sink);
+      
+      /**
+       * Unregister sink
+       *
+       * PRECONDITION: Scheduler must not be running
+       *
+       * @param sink Sink to remove
+       */
+      virtual void removeSink(FrameSink *sink);
+      
+      /**
+       * Calculate frames ahead using the prefetcher instead of calculating them on the scheduler thread. Prefetcher is not owned by the scheduler and is
+       * seeked to the current timeslice of the model when the frame loop starts
+       *
+       * PRECONDITION: Scheduler must not be running
+       *
+       * @param prefetcher Prefetcher to use, or 0 to calculate frames on the scheduler thread
+       */
+      virtual void setPrefetcher(FramePrefetcher *prefetcher);
+      
+      /**
+       * Produce frames with the interpolator, calculating only its key frames. Interpolator is not owned by the scheduler and is seeked to the current 
+       * timeslice of the model when the frame loop starts. It takes precedence over the prefetcher
+       *
+       * PRECONDITION: Scheduler must not be running
+       *
+       * @param interpolator Interpolator to use, or 0 not to interpolate
+       */
+      virtual void setInterpolator(TemporalFrameInterpolator *interpolator);
+      
+      /**
+       * Set distance between timeslices of two frames. Could be changed while scheduler is running
+       *
+       * @param distance Distance between two frames of animation
+       */
+      virtual void setInterframeDistance(double distance);
+      
+      /**
+       * Get distance between timeslices of two frames
+       *
+       * @return Distance between two frames of animation
+       */
+      virtual double getInterframeDistance() const;
+      
+      /**
+       * Set should animation loop. Could be changed while scheduler is running
+       *
+       * @param loop Should animation loop
+       */
+      virtual void setLoopAnimation(bool loop);
+      
+      /**
+       * Get should animation loop
+       *
+       * @return Should animation loop
+       */
+      virtual bool getLoopAnimation() const;
+      
+      /**
+       * Get rate at which frames are produced
+       *
+       * @return Frames per second
+       */
+      virtual double getFramesPerSecond() const
+      {
+         return framesPerSecond_;
+      }
+      
+      /**
+       * Start frame loop on the dedicated thread
+       *
+       * @return Was thread started
+       */
+      virtual bool start();
+      
+      /**
+       * Stop frame loop and wait for the thread to finish. Does nothing if scheduler is not running
+       */
+      virtual void stop();
+      
+      /**
+       * Is frame loop running on the dedicated thread
+       *
+       * @return Is scheduler running
+       */
+      virtual bool isRunning() const;
+      
+      /**
+       * Run given number of frames on the calling thread. Useful for headless runs and benchmarks
+       *
+       * PRECONDITION: Scheduler must not be running on the dedicated thread
+       *
+       * @param numFrames Number of frame slots to run (skipped slots are included)
+       */
+      virtual void runFrames(long numFrames);
+      
+      /**
+       * Get deadline accounting collected since the last reset
+       *
+       * @return Statistics of the scheduler
+       */
+      virtual FrameSchedulerStatistics getStatistics() const;
+      
+      /**
+       * Reset deadline accounting
+       */
+      virtual void resetStatistics();
+      
+   private:
+      
+      // copying is not supported
+      FrameScheduler(const FrameScheduler &rhs);
+      FrameScheduler &operator=(const FrameScheduler &rhs);
+      
+      /**
+       * Thread entry point
+       *
+       * @param scheduler Scheduler to run
+       */
+      static void *threadMain(void *scheduler);
+      
+      /**
+       * Run frame loop until stop is requested or maxFrames frame slots are processed
+       *
+       * @param maxFrames Max number of frame slots, or -1 for unlimited
+       */
+      void runLoop(long maxFrames);
+      
+      /**
+       * Account timing of the presented frame
+       *
+       * @param timing Timing of the frame
+       */
+      void accountFrame(const ScheduledFrameTiming &timing);
+      
+      /**
+       * Is stop requested
+       */
+      bool isStopRequested() const;
+      
+      /**
+       * Model we animate
+       */
+      GPUInterpolatedModel *model_;
+      
+      /**
+       * Rate at which frames are produced
+       */
+      double framesPerSecond_;
+      
+      /**
+       * Prefetcher calculating frames ahead, or 0
+       */
+      FramePrefetcher *prefetcher_;
+      
+      /**
+       * Interpolator producing frames from the key frames, or 0
+       */
+      TemporalFrameInterpolator *interpolator_;
+      
+      /**
+       * Sinks that receive frames
+       */
+      std::vector<FrameSink *> sinks_;
+      
+      /**
+       * Animation parameters
+       */
+      double interframeDistance_;
+      bool loopAnimation_;
+      
+      /**
+       * Thread on which frame loop runs
+       */
+      pthread_t thread_;
+      
+      /**
+       * Is thread running
+       */
+      bool running_;
+      
+      /**
+       * Should thread stop
+       */
+      bool stopRequested_;
+      
+      /**
+       * Guards parameters, stop flag and statistics
+       */
+      mutable pthread_mutex_t mutex_;
+      
+      /**
+       * Deadline accounting. Means are kept as sums until getStatistics()
+       */
+      FrameSchedulerStatistics statistics_;
+   };
+   
+} // namespace
+
+#endif
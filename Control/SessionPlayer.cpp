@@ -0,0 +1,167 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+
+#include "SessionPlayer.h"
+#include "GPUInterpolatedModel.h"
+#include "AbstractDrawingCode.h"
+#include "PreciseDelay.h"
+#include "Statistics.h"
+#include "SimpleDesignByContract.h"
+
+using namespace hdsim;
+using namespace std;
+
+SessionPlayer::SessionPlayer() : realTime_(false)
+{
+}
+
+SessionPlayer::~SessionPlayer()
+{
+}
+
+bool SessionPlayer::readFromFile(const std::string &fileName)
+{
+   frameTimings_.clear();
+   return readSessionFile(fileName, &modelFileName_, &events_);
+}
+
+int SessionPlayer::getNumFrames() const
+{
+   int numFrames = 0;
+   
+   for (int i = 0; i < events_.size(); i++)
+      if (events_[i].type == SESSION_EVENT_FRAME)
+         numFrames++;
+   
+   return numFrames;
+}
+
+void SessionPlayer::applyEvent(const SessionEvent &event, GPUInterpolatedModel *model, AbstractDrawingCode *drawer)
+{
+   const double *values = event.values;
+   
+   switch (event.type)
+   {
+      case SESSION_EVENT_TIME_SLICE:
+         model->setTimeSlice(values[0]);
+         break;
+         
+      case SESSION_EVENT_OPTIMIZE_DRAWING:
+         model->setOptimizeDrawing(values[0] != 0);
+         break;
+         
+      case SESSION_EVENT_MOXEL_THRESHOLD:
+         model->setMoxelThreshold((int)values[0]);
+         break;
+         
+      case SESSION_EVENT_RENDERED_AREA:
+         model->setRenderedArea(values[0], values[1], values[2], values[3], values[4], values[5]);
+         break;
+         
+      case SESSION_EVENT_ROTATION_ANGLES:
+         if (drawer)
+            drawer->setRotationAngles(values[0], values[1], values[2]);
+         break;
+         
+      case SESSION_EVENT_FOV:
+         if (drawer)
+            drawer->setFOV(values[0]);
+         break;
+         
+      case SESSION_EVENT_INTERFRAME_DISTANCE:
+         // Animation speed is already reflected in the recorded timeslices, nothing to apply
+         break;
+         
+      default:
+         FAIL("Unknown session event");
+   }
+}
+
+void SessionPlayer::play(GPUInterpolatedModel *model, AbstractDrawingCode *drawer)
+{
+   PRECONDITION(model);
+   
+   frameTimings_.clear();
+   
+   long long startTimeInMicroSeconds = getMonotonicTimeInMicroSeconds();
+   
+   int frameIndex = 0;
+   
+   for (int i = 0; i < events_.size(); i++)
+   {
+      const SessionEvent &event = events_[i];
+      
+      if (event.type != SESSION_EVENT_FRAME)
+      {
+         applyEvent(event, model, drawer);
+         continue;
+      }
+      
+      if (isRealTime())
+         waitUntil(startTimeInMicroSeconds + event.timeInMicroSeconds);
+      
+      ReplayedFrameTiming timing;
+      timing.frameIndex = frameIndex++;
+      timing.recordedTimeInMicroSeconds = event.timeInMicroSeconds;
+      timing.timeSlice = model->getTimeSlice();
+      timing.numMoxels = model->getTotalNumMoxels();
+      timing.drawingTimeInMicroSeconds = 0;
+      
+      // Frame is always calculated, as that is what interactive session did on every redraw
+      Statistics calculationStatistics;
+      calculationStatistics.startTimer();
+      model->forceModelCalculation();
+      calculationStatistics.stopTimer();
+      
+      timing.calculationTimeInMicroSeconds = calculationStatistics.getElapsedTimeInMicroSeconds();
+      
+      if (drawer)
+      {
+         Statistics drawingStatistics;
+         drawingStatistics.startTimer();
+         drawer->draw(model);
+         drawingStatistics.stopTimer();
+         
+         timing.drawingTimeInMicroSeconds = drawingStatistics.getElapsedTimeInMicroSeconds();
+      }
+      
+      frameTimings_.push_back(timing);
+   }
+}
+
+bool SessionPlayer::writeFrameTimingsToCSVFile(const char *fileName) const
+{
+   FILE *file = fopen(fileName, "w");
+   if (!file)
+      return false;
+   
+   fprintf(file, "Frame, Recorded_Microseconds, Timeslice, Calculation_Microseconds, Drawing_Microseconds, Num_Moxels, Rate\n");
+   
+   for (int i = 0; i < frameTimings_.size(); i++)
+   {
+      const ReplayedFrameTiming &timing = frameTimings_[i];
+      double rate = timing.calculationTimeInMicroSeconds > 0 ? timing.numMoxels/(timing.calculationTimeInMicroSeconds/1000000.0) : 0;
+      
+      fprintf(file, "%d, %ld, %lf, %lf, %lf, %ld, %lf\n", timing.frameIndex, timing.recordedTimeInMicroSeconds, timing.timeSlice, 
+              timing.calculationTimeInMicroSeconds, timing.drawingTimeInMicroSeconds, timing.numMoxels, rate);
+   }
+   
+   return fclose(file) == 0;
+}
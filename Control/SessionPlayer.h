@@ -0,0 +1,206 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SESSION_PLAYER_H_
+#define SESSION_PLAYER_H_
+
+#include <string>
+#include <vector>
+
+#include "SessionRecorder.h"
+
+namespace hdsim {
+   
+   class GPUInterpolatedModel;
+   class AbstractDrawingCode;
+   
+   /**
+    * Timing of the single replayed frame
+    */
+   struct ReplayedFrameTiming {
+      /**
+       * Index of the frame in the session
+       */
+      int frameIndex;
+      
+      /**
+       * Time at which frame was drawn in the recorded session
+       */
+      long recordedTimeInMicroSeconds;
+      
+      /**
+       * Timeslice of the frame
+       */
+      double timeSlice;
+      
+      /**
+       * Time spent calculating moxels
+       */
+      double calculationTimeInMicroSeconds;
+      
+      /**
+       * Time spent drawing (0 if there was no drawer)
+       */
+      double drawingTimeInMicroSeconds;
+      
+      /**
+       * Number of moxels calculated
+       */
+      long numMoxels;
+   };
+   
+   /**
+    * Replays session recorded by SessionRecorder against the model and (optionally) drawer, measuring how long every frame takes. This makes it possible to turn 
+    * interactive session into the repeatable benchmark.
+    */
+   class SessionPlayer {
+      
+   public:
+      
+      /**
+       * Constructor
+       */
+      SessionPlayer();
+      
+      /**
+       * Destructor
+       */
+      virtual ~SessionPlayer();
+      
+      /**
+       * Load session from the file
+       *
+       * @param fileName File recorded by SessionRecorder
+       *
+       * @return Was load success
+       */
+      virtual bool readFromFile(const std::string &fileName);
+      
+      /**
+       * Get name of the model file used in the recorded session
+       *
+       * @return Name of the model file
+       */
+      virtual const char *getModelFileName() const
+      {
+         return modelFileName_.c_str();
+      }
+      
+      /**
+       * Get number of events in the session
+       *
+       * @return Number of events
+       */
+      virtual int getNumEvents() const
+      {
+         return events_.size();
+      }
+      
+      /**
+       * Get number of frames in the session
+       *
+       * @return Number of frames
+       */
+      virtual int getNumFrames() const;
+      
+      /**
+       * Set should replay follow timing of the recorded session (real time), or should it replay frames as fast as possible (full speed)
+       *
+       * @param realTime Should we replay in real time
+       */
+      virtual void setRealTime(bool realTime)
+      {
+         realTime_ = realTime;
+      }
+      
+      /**
+       * Get is replay in real time
+       *
+       * @return Is replay in real time
+       */
+      virtual bool isRealTime() const
+      {
+         return realTime_;
+      }
+      
+      /**
+       * Replay session. Every change recorded in the session is applied to the model and drawer, and model is calculated (and drawn) for every recorded frame
+       *
+       * @param model Model to drive
+       * @param drawer Drawer to drive. Could be 0, in which case replay is headless
+       */
+      virtual void play(GPUInterpolatedModel *model, AbstractDrawingCode *drawer);
+      
+      /**
+       * Get timings of the frames from the last replay
+       *
+       * @return Timings of the frames
+       */
+      virtual const std::vector<ReplayedFrameTiming> &getFrameTimings() const
+      {
+         return frameTimings_;
+      }
+      
+      /**
+       * Write timings of the frames from the last replay to the CSV file
+       *
+       * @param fileName File to write to
+       *
+       * @return Was write success
+       */
+      virtual bool writeFrameTimingsToCSVFile(const char *fileName) const;
+      
+   private:
+      
+      // copying is not supported
+      SessionPlayer(const SessionPlayer &rhs);
+      SessionPlayer &operator=(const SessionPlayer &rhs);
+      
+      /**
+       * Apply event that is not frame to the model and drawer
+       *
+       * @param event Event to apply
+       * @param model Model to apply to
+       * @param drawer Drawer to apply to, could be 0
+       */
+      void applyEvent(const SessionEvent &event, GPUInterpolatedModel *model, AbstractDrawingCode *drawer);
+      
+      /**
+       * Name of the model file used in the session
+       */
+      std::string modelFileName_;
+      
+      /**
+       * Recorded events
+       */
+      std::vector<SessionEvent> events_;
+      
+      /**
+       * Should replay be in real time
+       */
+      bool realTime_;
+      
+      /**
+       * Timings of the last replay
+       */
+      std::vector<ReplayedFrameTiming> frameTimings_;
+   };
+   
+} // namespace
+
+#endif
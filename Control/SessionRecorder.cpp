@@ -0,0 +1,377 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+
+#include <stdint.h>
+
+#include "SessionRecorder.h"
+#include "MathHelper.h"
+#include "SimpleDesignByContract.h"
+
+using namespace hdsim;
+using namespace std;
+
+int hdsim::getNumSessionEventValues(int type)
+{
+   switch (type)
+   {
+      case SESSION_EVENT_TIME_SLICE:
+      case SESSION_EVENT_FOV:
+      case SESSION_EVENT_OPTIMIZE_DRAWING:
+      case SESSION_EVENT_MOXEL_THRESHOLD:
+      case SESSION_EVENT_INTERFRAME_DISTANCE:
+         return 1;
+         
+      case SESSION_EVENT_ROTATION_ANGLES:
+         return 3;
+         
+      case SESSION_EVENT_RENDERED_AREA:
+         return 6;
+         
+      case SESSION_EVENT_FRAME:
+         return 0;
+   }
+   
+   return -1;
+}
+
+/**
+ * Write value as numBytes little endian bytes
+ *
+ * @return Was write success
+ */
+static bool writeLittleEndian(FILE *file, uint64_t value, int numBytes)
+{
+   unsigned char bytes[sizeof(value)];
+   
+   for (int i = 0; i < numBytes; i++, value >>= 8)
+      bytes[i] = value & 0xFF;
+   
+   return fwrite(bytes, 1, numBytes, file) == (size_t)numBytes;
+}
+
+/**
+ * Read numBytes little endian bytes
+ *
+ * @param value (OUT) Value read
+ *
+ * @return Was read success
+ */
+static bool readLittleEndian(FILE *file, int numBytes, uint64_t *value)
+{
+   unsigned char bytes[sizeof(*value)];
+   
+   if (fread(bytes, 1, numBytes, file) != (size_t)numBytes)
+      return false;
+   
+   *value = 0;
+   
+   for (int i = numBytes - 1; i >= 0; i--)
+      *value = (*value << 8) | bytes[i];
+   
+   return true;
+}
+
+/**
+ * Write values of the event to file, using compact representation for flags and integers
+ *
+ * @param file File to write to
+ * @param type Type of the event
+ * @param values Values to write
+ *
+ * @return Was write success
+ */
+static bool writeEventValues(FILE *file, int type, const double *values)
+{
+   if (type == SESSION_EVENT_OPTIMIZE_DRAWING)
+   {
+      unsigned char flag = values[0] != 0 ? 1 : 0;
+      return fwrite(&flag, sizeof(flag), 1, file) == 1;
+   }
+   
+   if (type == SESSION_EVENT_MOXEL_THRESHOLD)
+   {
+      int32_t threshold = (int32_t)values[0];
+      return writeLittleEndian(file, (uint32_t)threshold, sizeof(threshold));
+   }
+   
+   int numValues = getNumSessionEventValues(type);
+   
+   for (int i = 0; i < numValues; i++)
+   {
+      uint64_t bits;
+      memcpy(&bits, &values[i], sizeof(bits));
+      
+      if (!writeLittleEndian(file, bits, sizeof(bits)))
+         return false;
+   }
+   
+   return true;
+}
+
+/**
+ * Read values of the event from file, see writeEventValues
+ *
+ * @param file File to read from
+ * @param type Type of the event
+ * @param values (OUT) Values read
+ *
+ * @return Was read success
+ */
+static bool readEventValues(FILE *file, int type, double *values)
+{
+   if (type == SESSION_EVENT_OPTIMIZE_DRAWING)
+   {
+      unsigned char flag;
+      if (fread(&flag, sizeof(flag), 1, file) != 1)
+         return false;
+      
+      values[0] = flag;
+      return true;
+   }
+   
+   if (type == SESSION_EVENT_MOXEL_THRESHOLD)
+   {
+      uint64_t threshold;
+      if (!readLittleEndian(file, sizeof(int32_t), &threshold))
+         return false;
+      
+      values[0] = (int32_t)(uint32_t)threshold;
+      return true;
+   }
+   
+   int numValues = getNumSessionEventValues(type);
+   
+   for (int i = 0; i < numValues; i++)
+   {
+      uint64_t bits;
+      
+      if (!readLittleEndian(file, sizeof(bits), &bits))
+         return false;
+      
+      memcpy(&values[i], &bits, sizeof(bits));
+   }
+   
+   return true;
+}
+
+/**
+ * Read line (without new line character) from file
+ *
+ * @param file File to read from
+ * @param line (OUT) Line read
+ *
+ * @return Was read success
+ */
+static bool readLine(FILE *file, string *line)
+{
+   line->clear();
+   
+   int character;
+   while ((character = fgetc(file)) != EOF)
+   {
+      if (character == '\n')
+         return true;
+      
+      line->push_back((char)character);
+   }
+   
+   return false;
+}
+
+bool hdsim::readSessionFile(const std::string &fileName, std::string *modelFileName, std::vector<SessionEvent> *events)
+{
+   PRECONDITION(modelFileName  &&  events);
+   
+   FILE *file = fopen(fileName.c_str(), "rb");
+   if (!file)
+      return false;
+   
+   string line;
+   int version;
+   
+   bool headerRead = readLine(file, &line)  &&  line == SESSION_FILE_MAGIC  &&
+                     readLine(file, &line)  &&  stringToNumber(line, &version)  &&  version == SESSION_FILE_VERSION  &&
+                     readLine(file, modelFileName);
+   
+   if (!headerRead)
+   {
+      fclose(file);
+      return false;
+   }
+   
+   events->clear();
+   
+   long timeInMicroSeconds = 0;
+   unsigned char type;
+   
+   while (fread(&type, sizeof(type), 1, file) == 1)
+   {
+      uint64_t deltaInMicroSeconds;
+      SessionEvent event;
+      
+      memset(&event, 0, sizeof(event));
+      
+      if (getNumSessionEventValues(type) < 0  ||  !readLittleEndian(file, sizeof(uint32_t), &deltaInMicroSeconds)  ||  !readEventValues(file, type, event.values))
+      {
+         fclose(file);
+         return false;
+      }
+      
+      timeInMicroSeconds += deltaInMicroSeconds;
+      
+      event.type = type;
+      event.timeInMicroSeconds = timeInMicroSeconds;
+      events->push_back(event);
+   }
+   
+   fclose(file);
+   return true;
+}
+
+SessionRecorder::SessionRecorder() : file_(0), lastEventTimeInMicroSeconds_(0), numRecordedEvents_(0)
+{
+   memset(wasRecorded_, 0, sizeof(wasRecorded_));
+}
+
+SessionRecorder::~SessionRecorder()
+{
+   close();
+}
+
+bool SessionRecorder::open(const std::string &fileName, const std::string &modelFileName)
+{
+   close();
+   
+   file_ = fopen(fileName.c_str(), "wb");
+   if (!file_)
+      return false;
+   
+   fprintf(file_, "%s\n%d\n%s\n", SESSION_FILE_MAGIC, SESSION_FILE_VERSION, modelFileName.c_str());
+   
+   struct timezone notUsed;
+   gettimeofday(&startTime_, &notUsed);
+   
+   lastEventTimeInMicroSeconds_ = 0;
+   numRecordedEvents_ = 0;
+   memset(wasRecorded_, 0, sizeof(wasRecorded_));
+   
+   return true;
+}
+
+void SessionRecorder::close()
+{
+   if (file_)
+   {
+      fclose(file_);
+      file_ = 0;
+   }
+}
+
+void SessionRecorder::recordEvent(int type, const double *values)
+{
+   PRECONDITION(type > 0  &&  type <= SESSION_EVENT_FRAME);
+   
+   if (!isRecording())
+      return;
+   
+   int numValues = getNumSessionEventValues(type);
+   
+   // Frames are always recorded, all other events only if they change something
+   if (type != SESSION_EVENT_FRAME  &&  wasRecorded_[type])
+   {
+      bool changed = false;
+      for (int i = 0; i < numValues; i++)
+         changed = changed  ||  !areEqual(values[i], lastValues_[type][i]);
+      
+      if (!changed)
+         return;
+   }
+   
+   struct timeval now;
+   struct timezone notUsed;
+   gettimeofday(&now, &notUsed);
+   
+   long timeInMicroSeconds = (now.tv_sec - startTime_.tv_sec) * 1000000 + now.tv_usec - startTime_.tv_usec;
+   uint32_t deltaInMicroSeconds = (uint32_t)(timeInMicroSeconds - lastEventTimeInMicroSeconds_);
+   unsigned char typeToWrite = (unsigned char)type;
+   
+   bool status = fwrite(&typeToWrite, sizeof(typeToWrite), 1, file_) == 1  &&
+                 writeLittleEndian(file_, deltaInMicroSeconds, sizeof(deltaInMicroSeconds))  &&
+                 writeEventValues(file_, type, values);
+   
+   if (!status)
+   {
+      LOG("Error writing session file, recording stopped");
+      close();
+      return;
+   }
+   
+   lastEventTimeInMicroSeconds_ = timeInMicroSeconds;
+   numRecordedEvents_++;
+   
+   for (int i = 0; i < numValues; i++)
+      lastValues_[type][i] = values[i];
+   
+   wasRecorded_[type] = true;
+}
+
+void SessionRecorder::recordTimeSlice(double timeSlice)
+{
+   recordEvent(SESSION_EVENT_TIME_SLICE, &timeSlice);
+}
+
+void SessionRecorder::recordRotationAngles(double x, double y, double z)
+{
+   double values[] = {x, y, z};
+   recordEvent(SESSION_EVENT_ROTATION_ANGLES, values);
+}
+
+void SessionRecorder::recordFOV(double fov)
+{
+   recordEvent(SESSION_EVENT_FOV, &fov);
+}
+
+void SessionRecorder::recordOptimizeDrawing(bool optimize)
+{
+   double value = optimize ? 1 : 0;
+   recordEvent(SESSION_EVENT_OPTIMIZE_DRAWING, &value);
+}
+
+void SessionRecorder::recordMoxelThreshold(int threshold)
+{
+   double value = threshold;
+   recordEvent(SESSION_EVENT_MOXEL_THRESHOLD, &value);
+}
+
+void SessionRecorder::recordRenderedArea(double minX, double minY, double minZ, double maxX, double maxY, double maxZ)
+{
+   double values[] = {minX, minY, minZ, maxX, maxY, maxZ};
+   recordEvent(SESSION_EVENT_RENDERED_AREA, values);
+}
+
+void SessionRecorder::recordInterframeDistance(double distance)
+{
+   recordEvent(SESSION_EVENT_INTERFRAME_DISTANCE, &distance);
+}
+
+void SessionRecorder::recordFrame()
+{
+   recordEvent(SESSION_EVENT_FRAME, 0);
+}
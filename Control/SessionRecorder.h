@@ -0,0 +1,264 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SESSION_RECORDER_H_
+#define SESSION_RECORDER_H_
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <sys/time.h>
+
+namespace hdsim {
+   
+   /**
+    * Magic string that starts every session file
+    */
+   static const char * const SESSION_FILE_MAGIC = "HoloSimSession";
+   
+   /**
+    * Version of the session file format
+    */
+   static const int SESSION_FILE_VERSION = 2;
+   
+   /**
+    * Types of the events that could be recorded in the session. Values are stored in the file, so don't renumber them
+    */
+   enum SessionEventType {
+      SESSION_EVENT_TIME_SLICE = 1,
+      SESSION_EVENT_ROTATION_ANGLES = 2,
+      SESSION_EVENT_FOV = 3,
+      SESSION_EVENT_OPTIMIZE_DRAWING = 4,
+      SESSION_EVENT_MOXEL_THRESHOLD = 5,
+      SESSION_EVENT_RENDERED_AREA = 6,
+      SESSION_EVENT_INTERFRAME_DISTANCE = 7,
+      SESSION_EVENT_FRAME = 8
+   };
+   
+   /**
+    * Max number of values that any event carries (rendered area is the largest with 6 values)
+    */
+   static const int SESSION_EVENT_MAX_VALUES = 6;
+   
+   /**
+    * Get number of values that event of the given type carries
+    *
+    * @param type Type of the event
+    *
+    * @return Number of values stored with the event, or -1 if type is unknown
+    */
+   int getNumSessionEventValues(int type);
+   
+   /**
+    * Single recorded change in the model or drawer parameters
+    */
+   struct SessionEvent {
+      /**
+       * Time since the start of the recording
+       */
+      long timeInMicroSeconds;
+      
+      /**
+       * Type of the event, one of SessionEventType
+       */
+      int type;
+      
+      /**
+       * Values of the event. Only first getNumSessionEventValues(type) values are meaningful
+       */
+      double values[SESSION_EVENT_MAX_VALUES];
+   };
+   
+   /**
+    * Read session recorded by the SessionRecorder
+    *
+    * @param fileName File to read from
+    * @param modelFileName (OUT) Name of the model file used in the session
+    * @param events (OUT) Events recorded in the session, with absolute times since the start of the recording
+    *
+    * @return Was read success
+    */
+   bool readSessionFile(const std::string &fileName, std::string *modelFileName, std::vector<SessionEvent> *events);
+   
+   /**
+    * Records timestamped sequence of changes in the model and drawer parameters made during the interactive session, so that the session could be later replayed
+    * by SessionPlayer. 
+    *
+    * File format is binary and compact. It starts with the text header:
+    *
+    * HoloSimSession\n
+    * version\n
+    * model file name\n
+    *
+    * followed by records of [1 byte event type][4 byte time delta in microseconds from the previous record][values]. Values are stored as doubles, except for 
+    * optimize drawing flag (1 byte) and moxel threshold (4 bytes). Numbers are stored in little endian byte order, so file could be replayed on any architecture.
+    *
+    * Changes that don't change the value of the parameter are not recorded, so it is safe to call record methods on every frame.
+    */
+   class SessionRecorder {
+      
+   public:
+      
+      /**
+       * Constructor
+       */
+      SessionRecorder();
+      
+      /**
+       * Destructor. Closes file if it is open
+       */
+      virtual ~SessionRecorder();
+      
+      /**
+       * Start recording to the file
+       *
+       * @param fileName File to record to. Existing file would be overwritten
+       * @param modelFileName Name of the model file used in the session
+       *
+       * @return Was file opened
+       */
+      virtual bool open(const std::string &fileName, const std::string &modelFileName);
+      
+      /**
+       * Stop recording and close file
+       */
+      virtual void close();
+      
+      /**
+       * Are we recording at the moment
+       *
+       * @return Is recording active
+       */
+      virtual bool isRecording() const
+      {
+         return file_ != 0;
+      }
+      
+      /**
+       * Record change of the timeslice
+       *
+       * @param timeSlice New value of the timeslice
+       */
+      virtual void recordTimeSlice(double timeSlice);
+      
+      /**
+       * Record change of the rotation angles of the drawer
+       *
+       * @param x Rotation around X axis
+       * @param y Rotation around Y axis
+       * @param z Rotation around Z axis
+       */
+      virtual void recordRotationAngles(double x, double y, double z);
+      
+      /**
+       * Record change of the field of view of the drawer
+       *
+       * @param fov New field of view
+       */
+      virtual void recordFOV(double fov);
+      
+      /**
+       * Record change of the drawing optimization
+       *
+       * @param optimize Should drawing be optimized
+       */
+      virtual void recordOptimizeDrawing(bool optimize);
+      
+      /**
+       * Record change of the moxel optimization threshold
+       *
+       * @param threshold New threshold
+       */
+      virtual void recordMoxelThreshold(int threshold);
+      
+      /**
+       * Record change of the rendered area
+       */
+      virtual void recordRenderedArea(double minX, double minY, double minZ, double maxX, double maxY, double maxZ);
+      
+      /**
+       * Record change of the animation speed
+       *
+       * @param distance Distance between two frames of animation
+       */
+      virtual void recordInterframeDistance(double distance);
+      
+      /**
+       * Record that frame was drawn with the current parameters
+       */
+      virtual void recordFrame();
+      
+      /**
+       * Get number of events recorded so far
+       *
+       * @return Number of events recorded
+       */
+      virtual long getNumRecordedEvents() const
+      {
+         return numRecordedEvents_;
+      }
+      
+   private:
+      
+      // copying is not supported
+      SessionRecorder(const SessionRecorder &rhs);
+      SessionRecorder &operator=(const SessionRecorder &rhs);
+      
+      /**
+       * Write event to the file, if it differs from the last event of the same type
+       *
+       * @param type Type of the event
+       * @param values Values of the event
+       */
+      void recordEvent(int type, const double *values);
+      
+      /**
+       * File we are recording to, or 0 if not recording
+       */
+      FILE *file_;
+      
+      /**
+       * Time at which recording started
+       */
+      struct timeval startTime_;
+      
+      /**
+       * Time of the last recorded event, relative to the start of the recording
+       */
+      long lastEventTimeInMicroSeconds_;
+      
+      /**
+       * Number of events recorded
+       */
+      long numRecordedEvents_;
+      
+      /**
+       * Last recorded values for every event type, used to skip events that don't change anything
+       */
+      double lastValues_[SESSION_EVENT_FRAME + 1][SESSION_EVENT_MAX_VALUES];
+      
+      /**
+       * Was event of the given type recorded at least once
+       */
+      bool wasRecorded_[SESSION_EVENT_FRAME + 1];
+   };
+   
+} // namespace
+
+#endif
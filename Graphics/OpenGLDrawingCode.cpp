@@ -26,6 +26,7 @@
 #include <OpenGL/glu.h>
 
 #include "GPUInterpolatedModel.h"
+#include "SparseFrame.h"
 #include "SimpleDesignByContract.h"
 
 using namespace hdsim;
@@ -351,6 +352,50 @@ Statistics OpenGLDrawingCode::getAllFrameRenderingStatistics() const
 	return allFrameRenderingStatistics_;   
 }
 
+/**
+ * Set the properties of the material used for the rods
+ */
+static void setupRodMaterial()
+{
+   float mat[4];
+   char message[4096];
+
+   // Set the properties of the material under ambient light
+   mat[0] = 0.1;
+   mat[1] = 0.1;
+   mat[2] = 0.7;
+   mat[3] = 1.0;
+   glMaterialfv(GL_FRONT, GL_AMBIENT, mat);
+   sprintf(message, "OpenGL returned an error %d", (int)glGetError());
+   CHECK(glGetError() == GL_NO_ERROR, message);
+   
+   // Set the properties of the material under diffuse light
+   mat[0] = 0.2;
+   mat[1] = 0.6;
+   mat[2] = 0.1;
+   mat[3] = 1.0;   
+   glMaterialfv(GL_FRONT, GL_DIFFUSE, mat);	   
+   sprintf(message, "OpenGL returned an error %d", (int)glGetError());
+   CHECK(glGetError() == GL_NO_ERROR, message);
+}
+
+void OpenGLDrawingCode::drawSparseFrameRods(const SparseFrame *frame, double maxRodSize)
+{
+   for (int i = 0; i < frame->getNumOccupiedTiles(); i++)
+   {
+      SparseTile tile = frame->getOccupiedTile(i);
+      int width = tile.range.endX - tile.range.beginX;
+      
+      for (int indexY = tile.range.beginY; indexY < tile.range.endY; indexY++)
+         for (int indexX = tile.range.beginX; indexX < tile.range.endX; indexX++)
+         {
+            // Transform from [0, 1] in Z buffer to the maxZ coordinate, the same way the full board is drawn
+            double value = tile.values ? tile.values[(indexY - tile.range.beginY) * width + indexX - tile.range.beginX] : tile.value;
+            drawRodAt(BASE_SIZE, frame->getSizeX(), ROD_COVERAGE_PERCENTAGE, indexX, indexY, maxRodSize * (1 - value));
+         }
+   }
+}
+
 void OpenGLDrawingCode::draw(const AbstractModel *m)
 {
    // This service knows at the moment only how to draw interpolated models
@@ -375,27 +420,7 @@ void OpenGLDrawingCode::draw(const AbstractModel *m)
    clearScreen();
      
    // And draw models 
-   // Set the properties of the material under ambient light
-   float mat[4];
-   char message[4096];
-
-   // Set the properties of the material under ambient light
-   mat[0] = 0.1;
-   mat[1] = 0.1;
-   mat[2] = 0.7;
-   mat[3] = 1.0;
-   glMaterialfv(GL_FRONT, GL_AMBIENT, mat);
-   sprintf(message, "OpenGL returned an error %d", (int)glGetError());
-   CHECK(glGetError() == GL_NO_ERROR, message);
-   
-   // Set the properties of the material under diffuse light
-   mat[0] = 0.2;
-   mat[1] = 0.6;
-   mat[2] = 0.1;
-   mat[3] = 1.0;   
-   glMaterialfv(GL_FRONT, GL_DIFFUSE, mat);	   
-   sprintf(message, "OpenGL returned an error %d", (int)glGetError());
-   CHECK(glGetError() == GL_NO_ERROR, message);
+   setupRodMaterial();
      
    // Holodeck can't show negative Z offset but we would rescale that minZ iz Z=1. And we would rescale so 
    // that the Z coordinates are proportional to the X and Y axis
@@ -406,14 +431,24 @@ void OpenGLDrawingCode::draw(const AbstractModel *m)
    
    drawModelBase(BASE_SIZE);
    
+   // Sparse frame has the full board, so it is used only if the board is not decimated for drawing. Decimated board is already calculated from it
+   const SparseFrame *sparseFrame = model->isDrawingOptimizationActive() ? 0 : model->getSparseFrame();
+   
    // and draw all the rods
-   for (int indexX = 0; indexX < model->getSizeX(); indexX++)
-      for (int indexY = 0; indexY < model->getSizeY(); indexY++)
-      {
-         // Transform from [0, 1] in Z buffer to the maxZ coordinate
-         double zValue = maxRodSize * (1 - model->getAt(indexX, indexY));
-         drawRodAt(BASE_SIZE, model->getSizeX(), ROD_COVERAGE_PERCENTAGE, indexX, indexY, zValue);
-      }
+   if (sparseFrame)
+   {
+      drawSparseFrameRods(sparseFrame, maxRodSize);
+   }
+   else
+   {
+      for (int indexX = 0; indexX < model->getSizeX(); indexX++)
+         for (int indexY = 0; indexY < model->getSizeY(); indexY++)
+         {
+            // Transform from [0, 1] in Z buffer to the maxZ coordinate
+            double zValue = maxRodSize * (1 - model->getAt(indexX, indexY));
+            drawRodAt(BASE_SIZE, model->getSizeX(), ROD_COVERAGE_PERCENTAGE, indexX, indexY, zValue);
+         }
+   }
    
    swapBuffers();
    
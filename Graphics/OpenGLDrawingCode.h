@@ -29,6 +29,7 @@
 namespace hdsim {
 
    class GPUGeometryModel;
+   class SparseFrame;
 
    /**
     * This is OpenGL based renderer. See DrawingCode for the contract of its methods
@@ -73,6 +74,14 @@ namespace hdsim {
        */
       void setupProjectionAndCoordinateSystem();
       
+      /**
+       * Draw rods of the sparse frame. Only rods of the occupied tiles are drawn, as rods at the background have zero height
+       *
+       * @param frame Frame to draw
+       * @param maxRodSize Height of the rod at depth 0
+       */
+      void drawSparseFrameRods(const SparseFrame *frame, double maxRodSize);
+      
       /**
        * Init frame buffer
        */
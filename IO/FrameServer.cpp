@@ -0,0 +1,753 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cerrno>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "FrameServer.h"
+#include "PreciseDelay.h"
+#include "SimpleDesignByContract.h"
+
+using namespace hdsim;
+using namespace std;
+
+const int FrameServer::DEFAULT_QUEUE_SIZE;
+const int FrameServer::TILE_SIZE;
+const int FrameServer::MAX_BATCH_SIZE;
+
+#ifdef MSG_NOSIGNAL
+static const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+static const int SEND_FLAGS = 0;
+#endif
+
+/**
+ * Max number of buffers passed to single sendmsg() call. Every message needs two (header and payload)
+ */
+static const int MAX_IOVECS = 2 * FrameServer::MAX_BATCH_SIZE;
+
+/**
+ * Make socket non blocking and make sure that writing to the closed socket doesn't raise SIGPIPE
+ */
+static bool prepareSocket(int fd, bool nonBlocking)
+{
+#ifdef SO_NOSIGPIPE
+   int one = 1;
+   setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+   
+   if (!nonBlocking)
+      return true;
+   
+   int flags = fcntl(fd, F_GETFL, 0);
+   return flags != -1  &&  fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
+}
+
+/**
+ * Fill the address of the Unix domain socket
+ */
+static bool makeUnixAddress(const string &path, sockaddr_un *address)
+{
+   memset(address, 0, sizeof(*address));
+   address->sun_family = AF_UNIX;
+   
+   if (path.size() >= sizeof(address->sun_path))
+      return false;
+   
+   strncpy(address->sun_path, path.c_str(), sizeof(address->sun_path) - 1);
+   return true;
+}
+
+/**
+ * Fill the address of the TCP socket on the loopback interface
+ */
+static void makeLoopbackAddress(int port, sockaddr_in *address)
+{
+   memset(address, 0, sizeof(*address));
+   address->sin_family = AF_INET;
+   address->sin_port = htons(port);
+   address->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+}
+
+FrameServer::FrameServer(FrameServerOverflowPolicy policy, int queueSize) : policy_(policy), queueSize_(queueSize), listenSocket_(-1), port_(0),
+                                                                             stopRequested_(false), running_(false), sequence_(0), numFramesSent_(0),
+                                                                             numFramesDropped_(0), numBytesSent_(0)
+{
+   PRECONDITION(queueSize > 0);
+   
+   wakeUpPipe_[0] = wakeUpPipe_[1] = -1;
+   
+   pthread_mutex_init(&mutex_, NULL);
+   pthread_cond_init(&queueSpaceAvailable_, NULL);
+}
+
+FrameServer::~FrameServer()
+{
+   stop();
+   
+   pthread_cond_destroy(&queueSpaceAvailable_);
+   pthread_mutex_destroy(&mutex_);
+}
+
+bool FrameServer::startUnix(const string &path)
+{
+   stop();
+   
+   sockaddr_un address;
+   if (!makeUnixAddress(path, &address))
+      return false;
+   
+   int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+   if (fd == -1)
+      return false;
+   
+   unlink(path.c_str());
+   if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address))  ||  !start(fd))
+   {
+      ::close(fd);
+      return false;
+   }
+   
+   unixPath_ = path;
+   return true;
+}
+
+bool FrameServer::startTCP(int port)
+{
+   stop();
+   
+   int fd = socket(AF_INET, SOCK_STREAM, 0);
+   if (fd == -1)
+      return false;
+   
+   int one = 1;
+   setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+   
+   sockaddr_in address;
+   makeLoopbackAddress(port, &address);
+   
+   socklen_t length = sizeof(address);
+   if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address))  ||  getsockname(fd, reinterpret_cast<sockaddr *>(&address), &length)  ||  !start(fd))
+   {
+      ::close(fd);
+      return false;
+   }
+   
+   port_ = ntohs(address.sin_port);
+   return true;
+}
+
+bool FrameServer::start(int listenSocket)
+{
+   if (listen(listenSocket, SOMAXCONN)  ||  !prepareSocket(listenSocket, true)  ||  pipe(wakeUpPipe_))
+      return false;
+   
+   prepareSocket(wakeUpPipe_[0], true);
+   prepareSocket(wakeUpPipe_[1], true);
+   
+   listenSocket_ = listenSocket;
+   stopRequested_ = false;
+   
+   if (pthread_create(&thread_, NULL, serverThread, this))
+   {
+      ::close(wakeUpPipe_[0]);
+      ::close(wakeUpPipe_[1]);
+      wakeUpPipe_[0] = wakeUpPipe_[1] = -1;
+      listenSocket_ = -1;
+      
+      return false;
+   }
+   
+   running_ = true;
+   return true;
+}
+
+void FrameServer::stop()
+{
+   if (!running_)
+      return;
+   
+   pthread_mutex_lock(&mutex_);
+   stopRequested_ = true;
+   pthread_cond_broadcast(&queueSpaceAvailable_);
+   pthread_mutex_unlock(&mutex_);
+   
+   wakeUp();
+   pthread_join(thread_, NULL);
+   running_ = false;
+   
+   pthread_mutex_lock(&mutex_);
+   while (!subscribers_.empty())
+      removeSubscriber(subscribers_.front());
+   pthread_mutex_unlock(&mutex_);
+   
+   ::close(listenSocket_);
+   ::close(wakeUpPipe_[0]);
+   ::close(wakeUpPipe_[1]);
+   listenSocket_ = wakeUpPipe_[0] = wakeUpPipe_[1] = -1;
+   
+   if (!unixPath_.empty())
+      unlink(unixPath_.c_str());
+   
+   unixPath_.clear();
+   port_ = 0;
+}
+
+bool FrameServer::isRunning() const
+{
+   return running_;
+}
+
+void FrameServer::publish(const FrameHandle &frame)
+{
+   PRECONDITION(frame.get());
+   
+   QueuedFrame queued;
+   queued.frame = frame;
+   queued.publishTimeInMicroSeconds = getMonotonicTimeInMicroSeconds();
+   
+   pthread_mutex_lock(&mutex_);
+   
+   if (policy_ == FRAME_SERVER_BLOCK)
+   {
+      // Wait until every subscriber has space, subscribers that disconnect meanwhile stop counting
+      while (!stopRequested_  &&  !hasSpaceInAllQueues())
+         pthread_cond_wait(&queueSpaceAvailable_, &mutex_);
+   }
+   
+   queued.sequence = ++sequence_;
+   
+   for (list<Subscriber *>::iterator i = subscribers_.begin(); i != subscribers_.end(); i++)
+   {
+      while ((int)(*i)->queue.size() >= queueSize_)
+      {
+         (*i)->queue.pop_front();
+         numFramesDropped_++;
+      }
+      
+      (*i)->queue.push_back(queued);
+   }
+   
+   pthread_mutex_unlock(&mutex_);
+   
+   wakeUp();
+}
+
+bool FrameServer::hasSpaceInAllQueues() const
+{
+   for (list<Subscriber *>::const_iterator i = subscribers_.begin(); i != subscribers_.end(); i++)
+      if ((int)(*i)->queue.size() >= queueSize_)
+         return false;
+   
+   return true;
+}
+
+int FrameServer::getNumSubscribers() const
+{
+   pthread_mutex_lock(&mutex_);
+   int result = subscribers_.size();
+   pthread_mutex_unlock(&mutex_);
+   
+   return result;
+}
+
+long FrameServer::getNumFramesSent() const
+{
+   pthread_mutex_lock(&mutex_);
+   long result = numFramesSent_;
+   pthread_mutex_unlock(&mutex_);
+   
+   return result;
+}
+
+long FrameServer::getNumFramesDropped() const
+{
+   pthread_mutex_lock(&mutex_);
+   long result = numFramesDropped_;
+   pthread_mutex_unlock(&mutex_);
+   
+   return result;
+}
+
+long long FrameServer::getNumBytesSent() const
+{
+   pthread_mutex_lock(&mutex_);
+   long long result = numBytesSent_;
+   pthread_mutex_unlock(&mutex_);
+   
+   return result;
+}
+
+void *FrameServer::serverThread(void *argument)
+{
+   static_cast<FrameServer *>(argument)->serve();
+   return NULL;
+}
+
+void FrameServer::serve()
+{
+   vector<pollfd> fds;
+   vector<Subscriber *> polled;
+   
+   while (!stopRequested_)
+   {
+      fds.clear();
+      polled.clear();
+      
+      pollfd fd;
+      fd.fd = listenSocket_;
+      fd.events = POLLIN;
+      fd.revents = 0;
+      fds.push_back(fd);
+      
+      fd.fd = wakeUpPipe_[0];
+      fds.push_back(fd);
+      
+      // Subscribers are added and removed only by this thread, so list could be walked without lock after poll
+      pthread_mutex_lock(&mutex_);
+      for (list<Subscriber *>::iterator i = subscribers_.begin(); i != subscribers_.end(); i++)
+      {
+         fd.fd = (*i)->socket;
+         fd.events = POLLIN;
+         if (!(*i)->queue.empty()  ||  !(*i)->sending.empty())
+            fd.events |= POLLOUT;
+         
+         fds.push_back(fd);
+         polled.push_back(*i);
+      }
+      pthread_mutex_unlock(&mutex_);
+      
+      if (poll(&fds[0], fds.size(), -1) < 0)
+      {
+         if (errno == EINTR)
+            continue;
+         
+         LOG("FrameServer: poll failed");
+         break;
+      }
+      
+      if (fds[1].revents)
+      {
+         char buffer[64];
+         while (read(wakeUpPipe_[0], buffer, sizeof(buffer)) > 0)
+            ;
+      }
+      
+      for (size_t i = 0; i < polled.size(); i++)
+      {
+         short revents = fds[i + 2].revents;
+         bool connected = true;
+         
+         if (revents & (POLLIN | POLLHUP | POLLERR))
+            connected = readFromSubscriber(polled[i]);
+         
+         if (connected  &&  (revents & POLLOUT))
+            connected = sendToSubscriber(polled[i]);
+         
+         if (!connected)
+         {
+            pthread_mutex_lock(&mutex_);
+            removeSubscriber(polled[i]);
+            pthread_mutex_unlock(&mutex_);
+         }
+      }
+      
+      if (fds[0].revents & POLLIN)
+         acceptSubscriber();
+   }
+}
+
+void FrameServer::acceptSubscriber()
+{
+   int fd;
+   while ((fd = accept(listenSocket_, NULL, NULL)) != -1)
+   {
+      if (!prepareSocket(fd, true))
+      {
+         ::close(fd);
+         continue;
+      }
+      
+      // Frames are written in large chunks, so there is nothing to gain from Nagle's algorithm (fails harmlessly on Unix domain sockets)
+      int one = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      
+      Subscriber *subscriber = new Subscriber();
+      subscriber->socket = fd;
+      subscriber->subscription = FRAME_SERVER_SUBSCRIBE_FULL_FRAMES;
+      subscriber->bytesSent = 0;
+      
+      pthread_mutex_lock(&mutex_);
+      subscribers_.push_back(subscriber);
+      pthread_mutex_unlock(&mutex_);
+   }
+}
+
+bool FrameServer::readFromSubscriber(Subscriber *subscriber)
+{
+   // Only thing subscriber ever sends is its subscription, so the last complete one wins
+   uint32_t subscription[16];
+   ssize_t numRead = recv(subscriber->socket, subscription, sizeof(subscription), 0);
+   
+   if (numRead == 0)
+      return false;
+   
+   if (numRead < 0)
+      return errno == EAGAIN  ||  errno == EWOULDBLOCK  ||  errno == EINTR;
+   
+   if (numRead >= (ssize_t)sizeof(uint32_t))
+   {
+      uint32_t value = subscription[numRead / sizeof(uint32_t) - 1];
+      subscriber->subscription = value == FRAME_SERVER_SUBSCRIBE_DIRTY_TILES ? FRAME_SERVER_SUBSCRIBE_DIRTY_TILES : FRAME_SERVER_SUBSCRIBE_FULL_FRAMES;
+   }
+   
+   return true;
+}
+
+bool FrameServer::sendToSubscriber(Subscriber *subscriber)
+{
+   if (subscriber->sending.empty())
+   {
+      // Take the whole batch under one lock, then encode without it
+      vector<QueuedFrame> batch;
+      
+      pthread_mutex_lock(&mutex_);
+      while (!subscriber->queue.empty()  &&  (int)batch.size() < MAX_BATCH_SIZE)
+      {
+         batch.push_back(subscriber->queue.front());
+         subscriber->queue.pop_front();
+      }
+      
+      if (!batch.empty())
+         pthread_cond_broadcast(&queueSpaceAvailable_);
+      pthread_mutex_unlock(&mutex_);
+      
+      for (size_t i = 0; i < batch.size(); i++)
+      {
+         subscriber->sending.push_back(OutgoingMessage());
+         createMessage(subscriber, batch[i], &subscriber->sending.back());
+      }
+      
+      subscriber->bytesSent = 0;
+   }
+   
+   if (subscriber->sending.empty())
+      return true;
+   
+   iovec iovecs[MAX_IOVECS];
+   int numIovecs = 0;
+   size_t skip = subscriber->bytesSent;
+   
+   for (list<OutgoingMessage>::iterator i = subscriber->sending.begin(); i != subscriber->sending.end()  &&  numIovecs + 1 < MAX_IOVECS; i++)
+   {
+      const char *parts[2];
+      size_t sizes[2];
+      
+      parts[0] = reinterpret_cast<const char *>(&i->header);
+      sizes[0] = sizeof(i->header);
+      
+      if (i->frame.get())
+         parts[1] = reinterpret_cast<const char *>(i->frame->getValues());
+      else
+         parts[1] = i->tiles.empty() ? NULL : &i->tiles[0];
+      sizes[1] = i->header.payloadSize;
+      
+      for (int j = 0; j < 2; j++)
+      {
+         if (skip >= sizes[j])
+         {
+            skip -= sizes[j];
+            continue;
+         }
+         
+         iovecs[numIovecs].iov_base = const_cast<char *>(parts[j] + skip);
+         iovecs[numIovecs].iov_len = sizes[j] - skip;
+         numIovecs++;
+         skip = 0;
+      }
+   }
+   
+   msghdr message;
+   memset(&message, 0, sizeof(message));
+   message.msg_iov = iovecs;
+   message.msg_iovlen = numIovecs;
+   
+   ssize_t numSent = sendmsg(subscriber->socket, &message, SEND_FLAGS);
+   if (numSent < 0)
+      return errno == EAGAIN  ||  errno == EWOULDBLOCK  ||  errno == EINTR;
+   
+   subscriber->bytesSent += numSent;
+   
+   long numFramesSent = 0;
+   while (!subscriber->sending.empty())
+   {
+      size_t size = sizeof(FrameServerMessageHeader) + subscriber->sending.front().header.payloadSize;
+      if (subscriber->bytesSent < size)
+         break;
+      
+      subscriber->bytesSent -= size;
+      subscriber->sending.pop_front();
+      numFramesSent++;
+   }
+   
+   pthread_mutex_lock(&mutex_);
+   numFramesSent_ += numFramesSent;
+   numBytesSent_ += numSent;
+   pthread_mutex_unlock(&mutex_);
+   
+   return true;
+}
+
+void FrameServer::createMessage(Subscriber *subscriber, const QueuedFrame &queued, OutgoingMessage *message)
+{
+   const Frame *frame = queued.frame.get();
+   int sizeX = frame->getSizeX();
+   int sizeY = frame->getSizeY();
+   
+   FrameServerMessageHeader &header = message->header;
+   memset(&header, 0, sizeof(header));
+   header.magic = FRAME_SERVER_MAGIC;
+   header.sequence = queued.sequence;
+   header.timeSlice = frame->getTimeSlice();
+   header.publishTimeInMicroSeconds = queued.publishTimeInMicroSeconds;
+   header.sizeX = sizeX;
+   header.sizeY = sizeY;
+   
+   FrameHandle previousFrame = subscriber->lastSentFrame;
+   const Frame *previous = previousFrame.get();
+   subscriber->lastSentFrame = queued.frame;
+   
+   if (subscriber->subscription != FRAME_SERVER_SUBSCRIBE_DIRTY_TILES  ||  !previous  ||  previous->getSizeX() != sizeX  ||  previous->getSizeY() != sizeY)
+   {
+      // Full frame is sent straight from the frame, handle keeps it alive until it is sent
+      header.type = FRAME_SERVER_FULL_FRAME;
+      header.payloadSize = sizeX * sizeY * sizeof(float);
+      message->frame = queued.frame;
+      
+      return;
+   }
+   
+   header.type = FRAME_SERVER_DIRTY_TILES;
+   
+   const float *values = frame->getValues();
+   const float *previousValues = previous->getValues();
+   
+   for (int tileY = 0; tileY < sizeY; tileY += TILE_SIZE)
+      for (int tileX = 0; tileX < sizeX; tileX += TILE_SIZE)
+      {
+         int tileSizeX = min(TILE_SIZE, sizeX - tileX);
+         int tileSizeY = min(TILE_SIZE, sizeY - tileY);
+         
+         bool dirty = false;
+         for (int y = tileY; y < tileY + tileSizeY  &&  !dirty; y++)
+            dirty = memcmp(values + y * sizeX + tileX, previousValues + y * sizeX + tileX, tileSizeX * sizeof(float)) != 0;
+         
+         if (!dirty)
+            continue;
+         
+         FrameServerTileHeader tile;
+         tile.x = tileX;
+         tile.y = tileY;
+         tile.sizeX = tileSizeX;
+         tile.sizeY = tileSizeY;
+         
+         size_t offset = message->tiles.size();
+         message->tiles.resize(offset + sizeof(tile) + tileSizeX * tileSizeY * sizeof(float));
+         
+         char *out = &message->tiles[offset];
+         memcpy(out, &tile, sizeof(tile));
+         out += sizeof(tile);
+         
+         for (int y = tileY; y < tileY + tileSizeY; y++, out += tileSizeX * sizeof(float))
+            memcpy(out, values + y * sizeX + tileX, tileSizeX * sizeof(float));
+         
+         header.numTiles++;
+      }
+   
+   header.payloadSize = message->tiles.size();
+}
+
+void FrameServer::removeSubscriber(Subscriber *subscriber)
+{
+   subscribers_.remove(subscriber);
+   ::close(subscriber->socket);
+   delete subscriber;
+   
+   // Producer could be waiting for space in this subscriber's queue
+   pthread_cond_broadcast(&queueSpaceAvailable_);
+}
+
+void FrameServer::wakeUp()
+{
+   char byte = 0;
+   if (wakeUpPipe_[1] != -1)
+      write(wakeUpPipe_[1], &byte, 1);
+}
+
+FrameClient::FrameClient() : socket_(-1)
+{
+}
+
+FrameClient::~FrameClient()
+{
+   close();
+}
+
+bool FrameClient::connectUnix(const string &path, FrameServerSubscription subscription)
+{
+   close();
+   
+   sockaddr_un address;
+   if (!makeUnixAddress(path, &address))
+      return false;
+   
+   socket_ = socket(AF_UNIX, SOCK_STREAM, 0);
+   if (socket_ == -1)
+      return false;
+   
+   if (connect(socket_, reinterpret_cast<sockaddr *>(&address), sizeof(address)))
+   {
+      close();
+      return false;
+   }
+   
+   return subscribe(subscription);
+}
+
+bool FrameClient::connectTCP(int port, FrameServerSubscription subscription)
+{
+   close();
+   
+   socket_ = socket(AF_INET, SOCK_STREAM, 0);
+   if (socket_ == -1)
+      return false;
+   
+   sockaddr_in address;
+   makeLoopbackAddress(port, &address);
+   
+   if (connect(socket_, reinterpret_cast<sockaddr *>(&address), sizeof(address)))
+   {
+      close();
+      return false;
+   }
+   
+   int one = 1;
+   setsockopt(socket_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+   
+   return subscribe(subscription);
+}
+
+bool FrameClient::subscribe(FrameServerSubscription subscription)
+{
+   prepareSocket(socket_, false);
+   board_.clear();
+   
+   uint32_t value = subscription;
+   if (send(socket_, &value, sizeof(value), SEND_FLAGS) != sizeof(value))
+   {
+      close();
+      return false;
+   }
+   
+   return true;
+}
+
+void FrameClient::close()
+{
+   if (socket_ != -1)
+      ::close(socket_);
+   
+   socket_ = -1;
+}
+
+bool FrameClient::readFully(void *buffer, size_t size)
+{
+   char *out = static_cast<char *>(buffer);
+   
+   while (size > 0)
+   {
+      ssize_t numRead = recv(socket_, out, size, 0);
+      if (numRead < 0  &&  errno == EINTR)
+         continue;
+      
+      if (numRead <= 0)
+         return false;
+      
+      out += numRead;
+      size -= numRead;
+   }
+   
+   return true;
+}
+
+bool FrameClient::readMessage(FrameServerMessageHeader *header)
+{
+   if (socket_ == -1  ||  !readFully(header, sizeof(*header))  ||  header->magic != FRAME_SERVER_MAGIC)
+      return false;
+   
+   payload_.resize(header->payloadSize);
+   if (header->payloadSize  &&  !readFully(&payload_[0], header->payloadSize))
+      return false;
+   
+   size_t boardSize = (size_t)header->sizeX * header->sizeY;
+   
+   if (header->type == FRAME_SERVER_FULL_FRAME)
+   {
+      if (header->payloadSize != boardSize * sizeof(float))
+         return false;
+      
+      board_.resize(boardSize);
+      if (boardSize)
+         memcpy(&board_[0], &payload_[0], header->payloadSize);
+      
+      return true;
+   }
+   
+   if (header->type != FRAME_SERVER_DIRTY_TILES  ||  board_.size() != boardSize)
+      return false;
+   
+   size_t offset = 0;
+   for (uint32_t i = 0; i < header->numTiles; i++)
+   {
+      FrameServerTileHeader tile;
+      if (offset + sizeof(tile) > payload_.size())
+         return false;
+      
+      memcpy(&tile, &payload_[offset], sizeof(tile));
+      offset += sizeof(tile);
+      
+      size_t rowSize = tile.sizeX * sizeof(float);
+      if (tile.x + tile.sizeX > header->sizeX  ||  tile.y + tile.sizeY > header->sizeY  ||  offset + rowSize * tile.sizeY > payload_.size())
+         return false;
+      
+      for (int y = tile.y; y < tile.y + tile.sizeY; y++, offset += rowSize)
+         memcpy(&board_[y * header->sizeX + tile.x], &payload_[offset], rowSize);
+   }
+   
+   return true;
+}
@@ -0,0 +1,518 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_SERVER_H_
+#define FRAME_SERVER_H_
+
+#include <deque>
+#include <list>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "Frame.h"
+
+namespace hdsim {
+   
+   /**
+    * Default path of the Unix domain socket on which frames are served
+    */
+   static const char * const DEFAULT_FRAME_SERVER_PATH = "/tmp/HoloSimFrames";
+   
+   /**
+    * What server does when subscriber's queue is full
+    */
+   enum FrameServerOverflowPolicy {
+      /**
+       * Drop the oldest queued frame. Slow subscriber sees fewer frames, but never slows down the producer
+       */
+      FRAME_SERVER_DROP_OLDEST = 0,
+      
+      /**
+       * Block the producer until subscriber catches up. Every subscriber gets every frame
+       */
+      FRAME_SERVER_BLOCK = 1
+   };
+   
+   /**
+    * What subscriber wants to receive. Subscriber sends this as uint32_t right after connecting, otherwise it gets full frames
+    */
+   enum FrameServerSubscription {
+      FRAME_SERVER_SUBSCRIBE_FULL_FRAMES = 0,
+      FRAME_SERVER_SUBSCRIBE_DIRTY_TILES = 1
+   };
+   
+   /**
+    * Type of the message sent to the subscriber
+    */
+   enum FrameServerMessageType {
+      /**
+       * Payload is sizeX * sizeY floats
+       */
+      FRAME_SERVER_FULL_FRAME = 1,
+      
+      /**
+       * Payload is numTiles tiles, each FrameServerTileHeader followed by its values. Cells outside of the tiles didn't change since the previous message
+       */
+      FRAME_SERVER_DIRTY_TILES = 2
+   };
+   
+   /**
+    * Magic at the start of every message ("HDFS")
+    */
+   static const uint32_t FRAME_SERVER_MAGIC = 0x48444653u;
+   
+   /**
+    * Header of every message. Messages are in the native byte order, as server is meant for the local machine or machines of the same architecture
+    */
+   struct FrameServerMessageHeader {
+      uint32_t magic;
+      uint32_t type;
+      
+      /**
+       * Sequence number of the frame, increasing by one for every published frame (so gaps are dropped frames)
+       */
+      uint64_t sequence;
+      
+      /**
+       * Timeslice of the frame
+       */
+      double timeSlice;
+      
+      /**
+       * When frame was published, from getMonotonicTimeInMicroSeconds()
+       */
+      int64_t publishTimeInMicroSeconds;
+      
+      /**
+       * Size of the board
+       */
+      uint32_t sizeX, sizeY;
+      
+      /**
+       * Number of tiles in FRAME_SERVER_DIRTY_TILES message
+       */
+      uint32_t numTiles;
+      
+      /**
+       * Size of the payload following the header
+       */
+      uint32_t payloadSize;
+   };
+   
+   /**
+    * Header of the tile in FRAME_SERVER_DIRTY_TILES message, followed by sizeX * sizeY floats
+    */
+   struct FrameServerTileHeader {
+      uint16_t x, y, sizeX, sizeY;
+   };
+   
+   /**
+    * Streams calculated frames to any number of subscribers (remote visualizers, stand-in actuator controllers) over the Unix domain or TCP socket.
+    *
+    * Every subscriber has its own bounded queue, so slow subscriber either loses the oldest frames or blocks the producer (FrameServerOverflowPolicy).
+    * All sockets are served from one thread, which sends queued messages in batches with single sendmsg() call. Full frames are sent directly from the
+    * frame, without copying values. This class is thread safe.
+    */
+   class FrameServer {
+      
+   public:
+      
+      /**
+       * Default number of frames queued per subscriber
+       */
+      static const int DEFAULT_QUEUE_SIZE = 4;
+      
+      /**
+       * Size of the tile in dirty tiles messages
+       */
+      static const int TILE_SIZE = 16;
+      
+      /**
+       * Max number of messages sent with one call
+       */
+      static const int MAX_BATCH_SIZE = 8;
+      
+      /**
+       * Constructor
+       *
+       * @param policy What to do when subscriber's queue is full
+       * @param queueSize Max number of frames queued per subscriber
+       */
+      explicit FrameServer(FrameServerOverflowPolicy policy = FRAME_SERVER_DROP_OLDEST, int queueSize = DEFAULT_QUEUE_SIZE);
+      
+      /**
+       * Destructor. Stops the server
+       */
+      virtual ~FrameServer();
+      
+      /**
+       * Start serving on the Unix domain socket
+       *
+       * @param path Path of the socket. Existing file at that path is removed
+       *
+       * @return Was server started
+       */
+      virtual bool startUnix(const std::string &path);
+      
+      /**
+       * Start serving on the TCP socket bound to the loopback interface
+       *
+       * @param port Port to listen on, or 0 to pick any free port (see getPort())
+       *
+       * @return Was server started
+       */
+      virtual bool startTCP(int port);
+      
+      /**
+       * Stop the server, disconnecting all subscribers
+       */
+      virtual void stop();
+      
+      /**
+       * Is server running
+       *
+       * @return Is server running
+       */
+      virtual bool isRunning() const;
+      
+      /**
+       * Get TCP port server listens on
+       *
+       * @return Port, or 0 if server doesn't listen on TCP
+       */
+      virtual int getPort() const
+      {
+         return port_;
+      }
+      
+      /**
+       * Queue frame for all subscribers. With FRAME_SERVER_BLOCK policy, this waits until every subscriber has space in its queue
+       *
+       * @param frame Frame to send. Frame must not be changed afterwards
+       */
+      virtual void publish(const FrameHandle &frame);
+      
+      /**
+       * Get number of connected subscribers
+       *
+       * @return Number of subscribers
+       */
+      virtual int getNumSubscribers() const;
+      
+      /**
+       * Get number of messages sent to all subscribers
+       *
+       * @return Number of messages sent
+       */
+      virtual long getNumFramesSent() const;
+      
+      /**
+       * Get number of frames dropped because subscriber's queue was full
+       *
+       * @return Number of frames dropped
+       */
+      virtual long getNumFramesDropped() const;
+      
+      /**
+       * Get number of bytes sent to all subscribers
+       *
+       * @return Number of bytes sent
+       */
+      virtual long long getNumBytesSent() const;
+      
+   private:
+      
+      // copying is not supported
+      FrameServer(const FrameServer &rhs);
+      FrameServer &operator=(const FrameServer &rhs);
+      
+      /**
+       * Frame queued for the subscriber
+       */
+      struct QueuedFrame {
+         FrameHandle frame;
+         uint64_t sequence;
+         int64_t publishTimeInMicroSeconds;
+      };
+      
+      /**
+       * Message being sent to the subscriber
+       */
+      struct OutgoingMessage {
+         FrameServerMessageHeader header;
+         
+         /**
+          * Frame whose values are sent (full frames)
+          */
+         FrameHandle frame;
+         
+         /**
+          * Encoded tiles (dirty tiles)
+          */
+         std::vector<char> tiles;
+      };
+      
+      /**
+       * Connected subscriber
+       */
+      struct Subscriber {
+         int socket;
+         FrameServerSubscription subscription;
+         
+         /**
+          * Frames waiting to be sent. Guarded by the mutex
+          */
+         std::deque<QueuedFrame> queue;
+         
+         /**
+          * Messages being sent, and number of their bytes already sent. Used only by the server thread
+          */
+         std::list<OutgoingMessage> sending;
+         size_t bytesSent;
+         
+         /**
+          * Last frame sent, against which dirty tiles are calculated. Used only by the server thread
+          */
+         FrameHandle lastSentFrame;
+      };
+      
+      /**
+       * Start the server thread on the listening socket
+       */
+      bool start(int listenSocket);
+      
+      /**
+       * Server thread
+       */
+      static void *serverThread(void *argument);
+      
+      /**
+       * Serve sockets until stopped
+       */
+      void serve();
+      
+      /**
+       * Accept new subscriber
+       */
+      void acceptSubscriber();
+      
+      /**
+       * Read subscription of the subscriber
+       *
+       * @return Is subscriber still connected
+       */
+      bool readFromSubscriber(Subscriber *subscriber);
+      
+      /**
+       * Send as much of the queued messages as socket accepts
+       *
+       * @return Is subscriber still connected
+       */
+      bool sendToSubscriber(Subscriber *subscriber);
+      
+      /**
+       * Create message for the queued frame
+       */
+      void createMessage(Subscriber *subscriber, const QueuedFrame &queued, OutgoingMessage *message);
+      
+      /**
+       * Disconnect subscriber. Must be called with mutex held
+       */
+      void removeSubscriber(Subscriber *subscriber);
+      
+      /**
+       * Do all subscribers have space in their queues. Must be called with mutex held
+       */
+      bool hasSpaceInAllQueues() const;
+      
+      /**
+       * Wake up the server thread
+       */
+      void wakeUp();
+      
+      /**
+       * What to do when subscriber's queue is full
+       */
+      FrameServerOverflowPolicy policy_;
+      
+      /**
+       * Max number of frames queued per subscriber
+       */
+      int queueSize_;
+      
+      /**
+       * Listening socket, or -1
+       */
+      int listenSocket_;
+      
+      /**
+       * Pipe used to wake up the server thread
+       */
+      int wakeUpPipe_[2];
+      
+      /**
+       * Path of the Unix domain socket, if used
+       */
+      std::string unixPath_;
+      
+      /**
+       * TCP port, if used
+       */
+      int port_;
+      
+      /**
+       * Server thread
+       */
+      pthread_t thread_;
+      
+      /**
+       * Should server thread stop
+       */
+      volatile bool stopRequested_;
+      
+      /**
+       * Is server thread running
+       */
+      bool running_;
+      
+      /**
+       * Subscribers
+       */
+      std::list<Subscriber *> subscribers_;
+      
+      /**
+       * Sequence number of the last published frame
+       */
+      uint64_t sequence_;
+      
+      /**
+       * Statistics
+       */
+      long numFramesSent_, numFramesDropped_;
+      long long numBytesSent_;
+      
+      /**
+       * Guards subscribers' queues and statistics
+       */
+      mutable pthread_mutex_t mutex_;
+      
+      /**
+       * Signaled when space frees up in any queue
+       */
+      pthread_cond_t queueSpaceAvailable_;
+   };
+   
+   /**
+    * Client of the FrameServer, used by tools and tests. Keeps the whole board, so dirty tiles messages are applied to it
+    */
+   class FrameClient {
+      
+   public:
+      
+      /**
+       * Constructor
+       */
+      FrameClient();
+      
+      /**
+       * Destructor. Disconnects
+       */
+      virtual ~FrameClient();
+      
+      /**
+       * Connect to the server on the Unix domain socket
+       *
+       * @param path Path of the socket
+       * @param subscription What to receive
+       *
+       * @return Was connection established
+       */
+      virtual bool connectUnix(const std::string &path, FrameServerSubscription subscription);
+      
+      /**
+       * Connect to the server on the TCP socket on the loopback interface
+       *
+       * @param port Port of the server
+       * @param subscription What to receive
+       *
+       * @return Was connection established
+       */
+      virtual bool connectTCP(int port, FrameServerSubscription subscription);
+      
+      /**
+       * Disconnect
+       */
+      virtual void close();
+      
+      /**
+       * Wait for the next message and apply it to the board
+       *
+       * @param header (OUT) Header of the received message
+       *
+       * @return Was message received
+       */
+      virtual bool readMessage(FrameServerMessageHeader *header);
+      
+      /**
+       * Get board with all received messages applied
+       *
+       * @return Values of the board, stored so that [x][y] corresponds to [y * sizeX + x]
+       */
+      virtual const std::vector<float> &getBoard() const
+      {
+         return board_;
+      }
+      
+   private:
+      
+      // copying is not supported
+      FrameClient(const FrameClient &rhs);
+      FrameClient &operator=(const FrameClient &rhs);
+      
+      /**
+       * Send subscription after connecting
+       */
+      bool subscribe(FrameServerSubscription subscription);
+      
+      /**
+       * Read exactly size bytes
+       */
+      bool readFully(void *buffer, size_t size);
+      
+      /**
+       * Connected socket, or -1
+       */
+      int socket_;
+      
+      /**
+       * Board
+       */
+      std::vector<float> board_;
+      
+      /**
+       * Payload of the last message
+       */
+      std::vector<char> payload_;
+   };
+   
+} // namespace
+
+#endif
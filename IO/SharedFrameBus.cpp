@@ -0,0 +1,466 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "SharedFrameBus.h"
+#include "Frame.h"
+#include "PreciseDelay.h"
+#include "SimpleDesignByContract.h"
+
+using namespace hdsim;
+using namespace std;
+
+/**
+ * Slots are aligned to the cache line, so that writing one slot doesn't disturb readers of the other
+ */
+static const uint32_t SLOT_ALIGNMENT = 64;
+
+static uint32_t alignUp(uint32_t value, uint32_t alignment)
+{
+   return (value + alignment - 1) / alignment * alignment;
+}
+
+/**
+ * Check that shared memory holds a valid bus
+ */
+static bool isValidHeader(const HdsimFrameBusHeader *header, size_t size)
+{
+   if (header->magic != HDSIM_FRAME_BUS_MAGIC  ||  header->version != HDSIM_FRAME_BUS_VERSION  ||  header->numSlots == 0)
+      return false;
+   
+   uint64_t frameBytes = (uint64_t)header->sizeX * header->sizeY * sizeof(float);
+   
+   return header->slotStride >= sizeof(HdsimFrameBusSlot) + frameBytes  &&  header->firstSlotOffset >= sizeof(HdsimFrameBusHeader)  &&
+          header->firstSlotOffset + (uint64_t)header->numSlots * header->slotStride <= size;
+}
+
+SharedFrameBus::SharedFrameBus() : header_(0), size_(0), writtenSequence_(0)
+{
+}
+
+SharedFrameBus::~SharedFrameBus()
+{
+   destroy();
+}
+
+bool SharedFrameBus::create(const string &name, int sizeX, int sizeY, int numSlots)
+{
+   PRECONDITION(sizeX >= 0  &&  sizeY >= 0  &&  numSlots > 1);
+   
+   destroy();
+   
+   // Readers attached to the previous bus keep their mapping, new readers get the new bus
+   shm_unlink(name.c_str());
+   
+   int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+   if (fd == -1)
+      return false;
+   
+   uint32_t firstSlotOffset = alignUp(sizeof(HdsimFrameBusHeader), SLOT_ALIGNMENT);
+   uint32_t slotStride = alignUp(sizeof(HdsimFrameBusSlot) + sizeX * sizeY * sizeof(float), SLOT_ALIGNMENT);
+   size_t size = firstSlotOffset + (size_t)numSlots * slotStride;
+   
+   void *data = MAP_FAILED;
+   if (!ftruncate(fd, size))
+      data = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   
+   ::close(fd);
+   
+   if (data == MAP_FAILED)
+   {
+      shm_unlink(name.c_str());
+      return false;
+   }
+   
+   // Memory is zeroed, so all slots are even (not being written) and hold no frame
+   header_ = static_cast<HdsimFrameBusHeader *>(data);
+   header_->version = HDSIM_FRAME_BUS_VERSION;
+   header_->numSlots = numSlots;
+   header_->sizeX = sizeX;
+   header_->sizeY = sizeY;
+   header_->slotStride = slotStride;
+   header_->firstSlotOffset = firstSlotOffset;
+   header_->latestSequence = 0;
+   
+   // Magic goes last, readers that see it could rely on the rest of the header
+   __sync_synchronize();
+   header_->magic = HDSIM_FRAME_BUS_MAGIC;
+   
+   name_ = name;
+   size_ = size;
+   writtenSequence_ = 0;
+   
+   return true;
+}
+
+void SharedFrameBus::destroy()
+{
+   if (!header_)
+      return;
+   
+   munmap(header_, size_);
+   shm_unlink(name_.c_str());
+   
+   header_ = 0;
+   size_ = 0;
+   name_.clear();
+}
+
+int SharedFrameBus::getSizeX() const
+{
+   PRECONDITION(isCreated());
+   return header_->sizeX;
+}
+
+int SharedFrameBus::getSizeY() const
+{
+   PRECONDITION(isCreated());
+   return header_->sizeY;
+}
+
+HdsimFrameBusSlot *SharedFrameBus::getSlot(uint64_t sequence) const
+{
+   char *slot = reinterpret_cast<char *>(header_) + header_->firstSlotOffset + ((sequence - 1) % header_->numSlots) * header_->slotStride;
+   return reinterpret_cast<HdsimFrameBusSlot *>(slot);
+}
+
+uint64_t SharedFrameBus::getLatestSequence() const
+{
+   return isCreated() ? header_->latestSequence : 0;
+}
+
+float *SharedFrameBus::beginFrame(double timeSlice)
+{
+   PRECONDITION(isCreated());
+   PRECONDITION(!writtenSequence_);
+   
+   writtenSequence_ = header_->latestSequence + 1;
+   HdsimFrameBusSlot *slot = getSlot(writtenSequence_);
+   
+   // Odd seqlock tells readers that slot is being written
+   __sync_fetch_and_add(&slot->seqlock, 1);
+   __sync_synchronize();
+   
+   slot->frameSequence = writtenSequence_;
+   slot->timeSlice = timeSlice;
+   
+   return reinterpret_cast<float *>(slot + 1);
+}
+
+void SharedFrameBus::commitFrame()
+{
+   PRECONDITION(isCreated());
+   PRECONDITION(writtenSequence_);
+   
+   HdsimFrameBusSlot *slot = getSlot(writtenSequence_);
+   slot->publishTimeInMicroSeconds = getMonotonicTimeInMicroSeconds();
+   
+   __sync_synchronize();
+   __sync_fetch_and_add(&slot->seqlock, 1);
+   __sync_synchronize();
+   
+   header_->latestSequence = writtenSequence_;
+   writtenSequence_ = 0;
+}
+
+void SharedFrameBus::publishFrame(const float *values, double timeSlice)
+{
+   float *slotValues = beginFrame(timeSlice);
+   memcpy(slotValues, values, header_->sizeX * header_->sizeY * sizeof(float));
+   commitFrame();
+}
+
+bool SharedFrameBus::publishModel(const AbstractModel *model, double timeSlice)
+{
+   PRECONDITION(model);
+   
+   int sizeX = getSizeX(), sizeY = getSizeY();
+   if (model->getSizeX() != sizeX  ||  model->getSizeY() != sizeY)
+      return false;
+   
+   // Frames are copied in one go, everything else value by value
+   const Frame *frame = dynamic_cast<const Frame *>(model);
+   if (frame)
+   {
+      publishFrame(frame->getValues(), timeSlice);
+      return true;
+   }
+   
+   float *values = beginFrame(timeSlice);
+   
+   for (int y = 0; y < sizeY; y++)
+      for (int x = 0; x < sizeX; x++)
+         values[y * sizeX + x] = model->getAt(x, y);
+   
+   commitFrame();
+   
+   return true;
+}
+
+SharedFrameBusReader::SharedFrameBusReader() : header_(0), size_(0)
+{
+}
+
+SharedFrameBusReader::~SharedFrameBusReader()
+{
+   close();
+}
+
+bool SharedFrameBusReader::open(const string &name)
+{
+   close();
+   
+   int fd = shm_open(name.c_str(), O_RDONLY, 0);
+   if (fd == -1)
+      return false;
+   
+   struct stat sharedMemoryStat;
+   void *data = MAP_FAILED;
+   
+   if (!fstat(fd, &sharedMemoryStat)  &&  sharedMemoryStat.st_size >= sizeof(HdsimFrameBusHeader))
+      data = mmap(0, sharedMemoryStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   
+   ::close(fd);
+   
+   if (data == MAP_FAILED)
+      return false;
+   
+   const HdsimFrameBusHeader *header = static_cast<const HdsimFrameBusHeader *>(data);
+   
+   __sync_synchronize();
+   if (!isValidHeader(header, sharedMemoryStat.st_size))
+   {
+      munmap(data, sharedMemoryStat.st_size);
+      return false;
+   }
+   
+   header_ = header;
+   size_ = sharedMemoryStat.st_size;
+   
+   return true;
+}
+
+void SharedFrameBusReader::close()
+{
+   if (header_)
+      munmap(const_cast<HdsimFrameBusHeader *>(header_), size_);
+   
+   header_ = 0;
+   size_ = 0;
+}
+
+int SharedFrameBusReader::getSizeX() const
+{
+   PRECONDITION(isOpen());
+   return header_->sizeX;
+}
+
+int SharedFrameBusReader::getSizeY() const
+{
+   PRECONDITION(isOpen());
+   return header_->sizeY;
+}
+
+const HdsimFrameBusSlot *SharedFrameBusReader::getSlot(uint64_t sequence) const
+{
+   const char *slot = reinterpret_cast<const char *>(header_) + header_->firstSlotOffset + ((sequence - 1) % header_->numSlots) * header_->slotStride;
+   return reinterpret_cast<const HdsimFrameBusSlot *>(slot);
+}
+
+uint64_t SharedFrameBusReader::getLatestSequence() const
+{
+   PRECONDITION(isOpen());
+   
+   uint64_t sequence = header_->latestSequence;
+   __sync_synchronize();
+   
+   return sequence;
+}
+
+bool SharedFrameBusReader::waitForFrame(uint64_t afterSequence, long timeoutInMicroSeconds, uint64_t *sequence) const
+{
+   PRECONDITION(sequence);
+   
+   long long deadline = getMonotonicTimeInMicroSeconds() + timeoutInMicroSeconds;
+   
+   for (int spin = 0; ; spin++)
+   {
+      *sequence = getLatestSequence();
+      if (*sequence > afterSequence)
+         return true;
+      
+      // Spinning gives the lowest latency while frames are coming, sleeping keeps idle readers from burning the core
+      if (spin < NUM_SPINS_BEFORE_SLEEP)
+      {
+         if (spin % 100 == 99)
+            sched_yield();
+      }
+      else
+      {
+         if (getMonotonicTimeInMicroSeconds() >= deadline)
+            return false;
+         
+         usleep(SLEEP_IN_MICROSECONDS);
+      }
+   }
+}
+
+bool SharedFrameBusReader::beginRead(uint64_t sequence, HdsimFrameBusFrame *frame) const
+{
+   PRECONDITION(isOpen());
+   PRECONDITION(frame);
+   
+   if (sequence == 0)
+      return false;
+   
+   const HdsimFrameBusSlot *slot = getSlot(sequence);
+   
+   frame->seqlock = slot->seqlock;
+   __sync_synchronize();
+   
+   if ((frame->seqlock & 1)  ||  slot->frameSequence != sequence)
+      return false;
+   
+   frame->sequence = sequence;
+   frame->timeSlice = slot->timeSlice;
+   frame->publishTimeInMicroSeconds = slot->publishTimeInMicroSeconds;
+   frame->values = reinterpret_cast<const float *>(slot + 1);
+   
+   return true;
+}
+
+bool SharedFrameBusReader::endRead(const HdsimFrameBusFrame *frame) const
+{
+   PRECONDITION(isOpen());
+   PRECONDITION(frame);
+   
+   __sync_synchronize();
+   
+   const HdsimFrameBusSlot *slot = getSlot(frame->sequence);
+   return slot->seqlock == frame->seqlock;
+}
+
+bool SharedFrameBusReader::readLatest(float *values, HdsimFrameBusFrame *frame, long timeoutInMicroSeconds) const
+{
+   PRECONDITION(values);
+   
+   long long deadline = getMonotonicTimeInMicroSeconds() + timeoutInMicroSeconds;
+   
+   for (int spin = 0; ; spin++)
+   {
+      uint64_t sequence = getLatestSequence();
+      if (sequence == 0)
+         return false;
+      
+      if (beginRead(sequence, frame))
+      {
+         memcpy(values, frame->values, header_->sizeX * header_->sizeY * sizeof(float));
+         
+         if (endRead(frame))
+         {
+            frame->values = values;
+            return true;
+         }
+      }
+      
+      // Torn reads normally succeed on the next try. If producer died while writing the slot, they never do, so give up at the timeout
+      if (getMonotonicTimeInMicroSeconds() >= deadline)
+         return false;
+      
+      if (spin < NUM_SPINS_BEFORE_SLEEP)
+      {
+         if (spin % 100 == 99)
+            sched_yield();
+      }
+      else
+      {
+         usleep(SLEEP_IN_MICROSECONDS);
+      }
+   }
+}
+
+//
+// C API
+//
+
+struct HdsimFrameBusReader {
+   SharedFrameBusReader reader;
+};
+
+HdsimFrameBusReader *hdsimFrameBusOpen(const char *name)
+{
+   if (!name)
+      return 0;
+   
+   HdsimFrameBusReader *reader = new HdsimFrameBusReader();
+   if (!reader->reader.open(name))
+   {
+      delete reader;
+      return 0;
+   }
+   
+   return reader;
+}
+
+void hdsimFrameBusClose(HdsimFrameBusReader *reader)
+{
+   delete reader;
+}
+
+void hdsimFrameBusGetSize(const HdsimFrameBusReader *reader, int *sizeX, int *sizeY)
+{
+   *sizeX = reader->reader.getSizeX();
+   *sizeY = reader->reader.getSizeY();
+}
+
+uint64_t hdsimFrameBusGetLatestSequence(const HdsimFrameBusReader *reader)
+{
+   return reader->reader.getLatestSequence();
+}
+
+int hdsimFrameBusWaitForFrame(const HdsimFrameBusReader *reader, uint64_t afterSequence, long timeoutInMicroSeconds, uint64_t *sequence)
+{
+   return reader->reader.waitForFrame(afterSequence, timeoutInMicroSeconds, sequence);
+}
+
+int hdsimFrameBusBeginRead(const HdsimFrameBusReader *reader, uint64_t sequence, HdsimFrameBusFrame *frame)
+{
+   return reader->reader.beginRead(sequence, frame);
+}
+
+int hdsimFrameBusEndRead(const HdsimFrameBusReader *reader, const HdsimFrameBusFrame *frame)
+{
+   return reader->reader.endRead(frame);
+}
+
+int hdsimFrameBusReadLatest(const HdsimFrameBusReader *reader, float *values, HdsimFrameBusFrame *frame, long timeoutInMicroSeconds)
+{
+   return reader->reader.readLatest(values, frame, timeoutInMicroSeconds);
+}
+
+int64_t hdsimFrameBusGetTimeInMicroSeconds(void)
+{
+   return getMonotonicTimeInMicroSeconds();
+}
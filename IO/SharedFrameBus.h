@@ -0,0 +1,314 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SHARED_FRAME_BUS_H_
+#define SHARED_FRAME_BUS_H_
+
+#include <string>
+
+#include "AbstractModel.h"
+#include "SharedFrameBusC.h"
+
+namespace hdsim {
+   
+   /**
+    * Default name of the shared memory used for the frame bus
+    */
+   static const char * const DEFAULT_FRAME_BUS_NAME = "/HoloSimFrames";
+   
+   /**
+    * Producer side of the shared memory frame bus. Bus is a ring of frame slots in the POSIX shared memory, so that separate processes (actuator drivers, 
+    * monitoring tools) could read frames in place, without any copies and without any calls into HoloSim. Every slot is guarded by its own seqlock, so 
+    * producer never waits for the readers and readers detect frames that were overwritten while they were reading them.
+    *
+    * There must be only one producer. Readers use SharedFrameBusReader, or the C API in SharedFrameBusC.h
+    */
+   class SharedFrameBus {
+      
+   public:
+      
+      /**
+       * Default number of slots in the ring. Readers have numSlots - 1 frames of time to finish the read before the slot is reused
+       */
+      static const int DEFAULT_NUM_SLOTS = 4;
+      
+      /**
+       * Constructor
+       */
+      SharedFrameBus();
+      
+      /**
+       * Destructor. Removes the bus
+       */
+      virtual ~SharedFrameBus();
+      
+      /**
+       * Create the bus. Readers that are attached to the old bus with the same name keep reading the old one
+       *
+       * @param name Name of the shared memory
+       * @param sizeX Size of the frames in X direction
+       * @param sizeY Size of the frames in Y direction
+       * @param numSlots Number of slots in the ring
+       *
+       * @return Was bus created
+       */
+      virtual bool create(const std::string &name, int sizeX, int sizeY, int numSlots = DEFAULT_NUM_SLOTS);
+      
+      /**
+       * Remove the bus
+       */
+      virtual void destroy();
+      
+      /**
+       * Was bus created
+       *
+       * @return Is bus created
+       */
+      virtual bool isCreated() const
+      {
+         return header_ != 0;
+      }
+      
+      /**
+       * Get size of the frames in X direction
+       *
+       * @return Size in X direction
+       */
+      virtual int getSizeX() const;
+      
+      /**
+       * Get size of the frames in Y direction
+       *
+       * @return Size in Y direction
+       */
+      virtual int getSizeY() const;
+      
+      /**
+       * Start writing the next frame directly into the shared memory
+       *
+       * @param timeSlice Timeslice of the frame
+       *
+       * @return Values of the frame to fill, stored so that [x][y] corresponds to [y * sizeX + x]
+       */
+      virtual float *beginFrame(double timeSlice);
+      
+      /**
+       * Publish the frame started with beginFrame()
+       */
+      virtual void commitFrame();
+      
+      /**
+       * Publish frame
+       *
+       * @param values Values, stored so that [x][y] corresponds to [y * sizeX + x]
+       * @param timeSlice Timeslice of the frame
+       */
+      virtual void publishFrame(const float *values, double timeSlice);
+      
+      /**
+       * Publish calculated model
+       *
+       * @param model Model to publish
+       * @param timeSlice Timeslice at which model was calculated
+       *
+       * @return Was model published. Model is not published if its size is different from the size of the bus
+       */
+      virtual bool publishModel(const AbstractModel *model, double timeSlice);
+      
+      /**
+       * Get sequence number of the last published frame
+       *
+       * @return Sequence number, or 0 if nothing was published
+       */
+      virtual uint64_t getLatestSequence() const;
+      
+   private:
+      
+      // copying is not supported
+      SharedFrameBus(const SharedFrameBus &rhs);
+      SharedFrameBus &operator=(const SharedFrameBus &rhs);
+      
+      /**
+       * Get slot in which frame with the sequence number lives
+       */
+      HdsimFrameBusSlot *getSlot(uint64_t sequence) const;
+      
+      /**
+       * Name of the shared memory
+       */
+      std::string name_;
+      
+      /**
+       * Mapped shared memory, or 0
+       */
+      HdsimFrameBusHeader *header_;
+      
+      /**
+       * Size of the mapped shared memory
+       */
+      size_t size_;
+      
+      /**
+       * Sequence number of the frame being written, or 0
+       */
+      uint64_t writtenSequence_;
+   };
+   
+   /**
+    * Reader side of the shared memory frame bus. Any number of readers in any number of processes could be attached to the bus
+    */
+   class SharedFrameBusReader {
+      
+   public:
+      
+      /**
+       * Number of checks of the latest sequence before the reader starts to sleep between the checks
+       */
+      static const int NUM_SPINS_BEFORE_SLEEP = 20000;
+      
+      /**
+       * Sleep between the checks, once reader stops spinning
+       */
+      static const long SLEEP_IN_MICROSECONDS = 50;
+      
+      /**
+       * Default time readLatest() keeps retrying the torn reads. Producer that died in the middle of the frame leaves its slot locked forever
+       */
+      static const long DEFAULT_READ_TIMEOUT_IN_MICROSECONDS = 100000;
+      
+      /**
+       * Constructor
+       */
+      SharedFrameBusReader();
+      
+      /**
+       * Destructor. Detaches from the bus
+       */
+      virtual ~SharedFrameBusReader();
+      
+      /**
+       * Attach to the bus
+       *
+       * @param name Name of the shared memory
+       *
+       * @return Was bus found and valid
+       */
+      virtual bool open(const std::string &name);
+      
+      /**
+       * Detach from the bus
+       */
+      virtual void close();
+      
+      /**
+       * Is reader attached
+       *
+       * @return Is reader attached to the bus
+       */
+      virtual bool isOpen() const
+      {
+         return header_ != 0;
+      }
+      
+      /**
+       * Get size of the frames in X direction
+       *
+       * @return Size in X direction
+       */
+      virtual int getSizeX() const;
+      
+      /**
+       * Get size of the frames in Y direction
+       *
+       * @return Size in Y direction
+       */
+      virtual int getSizeY() const;
+      
+      /**
+       * Get sequence number of the latest published frame
+       *
+       * @return Sequence number, or 0 if nothing was published
+       */
+      virtual uint64_t getLatestSequence() const;
+      
+      /**
+       * Wait until frame newer than the given one is published
+       *
+       * @param afterSequence Sequence number of the last frame seen
+       * @param timeoutInMicroSeconds How long to wait
+       * @param sequence (OUT) Sequence number of the latest frame
+       *
+       * @return Is newer frame available
+       */
+      virtual bool waitForFrame(uint64_t afterSequence, long timeoutInMicroSeconds, uint64_t *sequence) const;
+      
+      /**
+       * Start reading the frame in place
+       *
+       * @param sequence Sequence number of the frame
+       * @param frame (OUT) Frame
+       *
+       * @return Could frame be read. Frame can't be read if it is being written or was already overwritten
+       */
+      virtual bool beginRead(uint64_t sequence, HdsimFrameBusFrame *frame) const;
+      
+      /**
+       * Finish reading the frame
+       *
+       * @param frame Frame from beginRead()
+       *
+       * @return Is everything read since beginRead() consistent
+       */
+      virtual bool endRead(const HdsimFrameBusFrame *frame) const;
+      
+      /**
+       * Copy the latest frame. Reads torn by the producer are retried, spinning first and then sleeping between the retries, until the timeout
+       *
+       * @param values (OUT) Values of the frame
+       * @param frame (OUT) Frame, with values pointing to the values argument
+       * @param timeoutInMicroSeconds How long to retry the torn reads
+       *
+       * @return Was frame copied. False if nothing was published, or if no consistent copy was made before the timeout
+       */
+      virtual bool readLatest(float *values, HdsimFrameBusFrame *frame, long timeoutInMicroSeconds = DEFAULT_READ_TIMEOUT_IN_MICROSECONDS) const;
+      
+   private:
+      
+      // copying is not supported
+      SharedFrameBusReader(const SharedFrameBusReader &rhs);
+      SharedFrameBusReader &operator=(const SharedFrameBusReader &rhs);
+      
+      /**
+       * Get slot in which frame with the sequence number lives
+       */
+      const HdsimFrameBusSlot *getSlot(uint64_t sequence) const;
+      
+      /**
+       * Mapped shared memory, or 0
+       */
+      const HdsimFrameBusHeader *header_;
+      
+      /**
+       * Size of the mapped shared memory
+       */
+      size_t size_;
+   };
+   
+} // namespace
+
+#endif
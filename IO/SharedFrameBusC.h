@@ -0,0 +1,249 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SHARED_FRAME_BUS_C_H_
+#define SHARED_FRAME_BUS_C_H_
+
+/*
+ * C API for the processes reading frames from the HoloSim shared memory frame bus (see SharedFrameBus.h). Actuator drivers and monitoring tools link
+ * only against this API, so they could be written in C.
+ *
+ * Typical reader:
+ *
+ *    HdsimFrameBusReader *reader = hdsimFrameBusOpen("/HoloSimFrames");
+ *    uint64_t sequence = 0;
+ *
+ *    while (hdsimFrameBusWaitForFrame(reader, sequence, 1000000, &sequence))
+ *    {
+ *       HdsimFrameBusFrame frame;
+ *       if (!hdsimFrameBusBeginRead(reader, sequence, &frame))
+ *          continue;
+ *
+ *       ... use frame.values in place, without copying ...
+ *
+ *       if (!hdsimFrameBusEndRead(reader, &frame))
+ *          ... producer overwrote the frame while we were reading, discard what was read ...
+ *    }
+ *
+ *    hdsimFrameBusClose(reader);
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+   
+   /**
+    * Magic at the start of the shared memory ("HDFB")
+    */
+#define HDSIM_FRAME_BUS_MAGIC 0x48444642u
+   
+   /**
+    * Version of the shared memory layout
+    */
+#define HDSIM_FRAME_BUS_VERSION 1u
+   
+   /**
+    * Header at the start of the shared memory. Everything except latestSequence is written once, before the bus is visible to the readers
+    */
+   typedef struct HdsimFrameBusHeader {
+      uint32_t magic;
+      uint32_t version;
+      
+      /**
+       * Number of frame slots in the ring
+       */
+      uint32_t numSlots;
+      
+      /**
+       * Size of the board
+       */
+      uint32_t sizeX, sizeY;
+      
+      /**
+       * Distance in bytes between two slots
+       */
+      uint32_t slotStride;
+      
+      /**
+       * Offset in bytes of the first slot from the start of the shared memory
+       */
+      uint32_t firstSlotOffset;
+      
+      uint32_t reserved;
+      
+      /**
+       * Sequence number of the latest published frame, or 0 if nothing was published. Frame n lives in the slot (n - 1) % numSlots
+       */
+      volatile uint64_t latestSequence;
+   } HdsimFrameBusHeader;
+   
+   /**
+    * Header of the slot, followed by sizeX * sizeY floats
+    */
+   typedef struct HdsimFrameBusSlot {
+      /**
+       * Odd while producer writes the slot. Reader's data is consistent only if it was even and unchanged for the whole read
+       */
+      volatile uint64_t seqlock;
+      
+      /**
+       * Sequence number of the frame in the slot
+       */
+      volatile uint64_t frameSequence;
+      
+      /**
+       * Timeslice of the frame
+       */
+      double timeSlice;
+      
+      /**
+       * Time at which frame was published, from the system wide monotonic clock (hdsimFrameBusGetTimeInMicroSeconds())
+       */
+      int64_t publishTimeInMicroSeconds;
+   } HdsimFrameBusSlot;
+   
+   /**
+    * Frame being read
+    */
+   typedef struct HdsimFrameBusFrame {
+      /**
+       * Sequence number of the frame
+       */
+      uint64_t sequence;
+      
+      /**
+       * Timeslice of the frame
+       */
+      double timeSlice;
+      
+      /**
+       * Time at which frame was published
+       */
+      int64_t publishTimeInMicroSeconds;
+      
+      /**
+       * Values of the frame in the shared memory, stored so that [x][y] corresponds to [y * sizeX + x]. Valid only until hdsimFrameBusEndRead()
+       */
+      const float *values;
+      
+      /**
+       * Value of the seqlock at the start of the read
+       */
+      uint64_t seqlock;
+   } HdsimFrameBusFrame;
+   
+   /**
+    * Opaque reader
+    */
+   typedef struct HdsimFrameBusReader HdsimFrameBusReader;
+   
+   /**
+    * Attach to the frame bus
+    *
+    * @param name Name of the shared memory, e.g. "/HoloSimFrames"
+    *
+    * @return Reader, or 0 if bus doesn't exist or is not valid
+    */
+   HdsimFrameBusReader *hdsimFrameBusOpen(const char *name);
+   
+   /**
+    * Detach from the frame bus
+    *
+    * @param reader Reader to close, could be 0
+    */
+   void hdsimFrameBusClose(HdsimFrameBusReader *reader);
+   
+   /**
+    * Get size of the frames
+    *
+    * @param reader Reader
+    * @param sizeX (OUT) Size in X direction
+    * @param sizeY (OUT) Size in Y direction
+    */
+   void hdsimFrameBusGetSize(const HdsimFrameBusReader *reader, int *sizeX, int *sizeY);
+   
+   /**
+    * Get sequence number of the latest published frame
+    *
+    * @param reader Reader
+    *
+    * @return Sequence number, or 0 if nothing was published
+    */
+   uint64_t hdsimFrameBusGetLatestSequence(const HdsimFrameBusReader *reader);
+   
+   /**
+    * Wait until frame newer than the given one is published. Spins for a while before falling back to short sleeps, so new frames are noticed within
+    * microseconds while they are coming fast
+    *
+    * @param reader Reader
+    * @param afterSequence Sequence number of the last frame seen
+    * @param timeoutInMicroSeconds How long to wait
+    * @param sequence (OUT) Sequence number of the latest frame
+    *
+    * @return 1 if newer frame is available, 0 on timeout
+    */
+   int hdsimFrameBusWaitForFrame(const HdsimFrameBusReader *reader, uint64_t afterSequence, long timeoutInMicroSeconds, uint64_t *sequence);
+   
+   /**
+    * Start reading the frame in place
+    *
+    * @param reader Reader
+    * @param sequence Sequence number of the frame
+    * @param frame (OUT) Frame
+    *
+    * @return 1 if frame could be read, 0 if it is being written or was already overwritten
+    */
+   int hdsimFrameBusBeginRead(const HdsimFrameBusReader *reader, uint64_t sequence, HdsimFrameBusFrame *frame);
+   
+   /**
+    * Finish reading the frame
+    *
+    * @param reader Reader
+    * @param frame Frame from hdsimFrameBusBeginRead()
+    *
+    * @return 1 if everything read since hdsimFrameBusBeginRead() is consistent, 0 if producer overwrote the frame in the meantime
+    */
+   int hdsimFrameBusEndRead(const HdsimFrameBusReader *reader, const HdsimFrameBusFrame *frame);
+   
+   /**
+    * Copy the latest frame. Reads torn by the producer are retried until the timeout. If producer process dies while writing the frame, its slot stays
+    * locked, so the timeout is what lets readers survive the producer crash
+    *
+    * @param reader Reader
+    * @param values (OUT) sizeX * sizeY values
+    * @param frame (OUT) Frame, with values pointing to the values argument
+    * @param timeoutInMicroSeconds How long to retry the torn reads
+    *
+    * @return 1 if frame was copied, 0 if nothing was published or no consistent copy was made before the timeout
+    */
+   int hdsimFrameBusReadLatest(const HdsimFrameBusReader *reader, float *values, HdsimFrameBusFrame *frame, long timeoutInMicroSeconds);
+   
+   /**
+    * Get time from the same system wide monotonic clock used for HdsimFrameBusSlot::publishTimeInMicroSeconds
+    *
+    * @return Time in microseconds
+    */
+   int64_t hdsimFrameBusGetTimeInMicroSeconds(void);
+   
+#ifdef __cplusplus
+}
+#endif
+
+#endif
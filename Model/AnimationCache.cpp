@@ -0,0 +1,568 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "AnimationCache.h"
+#include "GPUGeometryModel.h"
+#include "GPUInterpolatedModel.h"
+#include "Hash.h"
+#include "MathHelper.h"
+#include "SimpleDesignByContract.h"
+
+using namespace hdsim;
+using namespace std;
+
+/**
+ * Magic at the start of every cache file
+ */
+static const char ANIMATION_CACHE_MAGIC[8] = {'H', 'D', 'S', 'I', 'M', 'A', 'N', 'I'};
+
+/**
+ * Version of the cache file format
+ */
+static const int ANIMATION_CACHE_VERSION = 1;
+
+/**
+ * Max number of values in the single run length token
+ */
+static const int MAX_RUN_LENGTH = 0x7FFF;
+
+/**
+ * Flag of the token that holds run of the same value (otherwise token holds literal values)
+ */
+static const unsigned short RUN_FLAG = 0x8000;
+
+/**
+ * Runs shorter then this are cheaper to store as literals
+ */
+static const int MIN_RUN_LENGTH = 3;
+
+/**
+ * Frame data is aligned so that floats could be read directly from the mapped file
+ */
+static const long FRAME_ALIGNMENT = 8;
+
+struct AnimationCache::Header {
+   char magic[8];
+   int version;
+   int encoding;
+   AnimationCacheKey key;
+   int numFrames;
+   int keyFrameInterval;
+};
+
+struct AnimationCache::FrameEntry {
+   double timeSlice;
+   long long offset;
+   long long size;
+};
+
+bool hdsim::operator==(const AnimationCacheKey &lhs, const AnimationCacheKey &rhs)
+{
+   if (lhs.geometryHash != rhs.geometryHash  ||  lhs.shaderHash != rhs.shaderHash)
+      return false;
+   
+   if (lhs.sizeX != rhs.sizeX  ||  lhs.sizeY != rhs.sizeY)
+      return false;
+   
+   for (int i = 0; i < 6; i++)
+      if (lhs.renderedArea[i] != rhs.renderedArea[i])
+         return false;
+   
+   return true;
+}
+
+/**
+ * Quantize depth value to 16 bits
+ */
+static unsigned short quantize(float value)
+{
+   value = value < 0 ? 0 : (value > 1 ? 1 : value);
+   return (unsigned short)(value * 65535.0f + 0.5f);
+}
+
+static float dequantize(unsigned short value)
+{
+   return value / 65535.0f;
+}
+
+/**
+ * Run length encode values. Output is sequence of tokens, where token with RUN_FLAG set is followed by the single value repeated (token & ~RUN_FLAG) times, 
+ * and token without it is followed by that many literal values
+ */
+static void runLengthEncode(const unsigned short *values, int numValues, vector<unsigned short> *encoded)
+{
+   int i = 0;
+   
+   while (i < numValues)
+   {
+      int runEnd = i + 1;
+      while (runEnd < numValues  &&  values[runEnd] == values[i]  &&  runEnd - i < MAX_RUN_LENGTH)
+         runEnd++;
+      
+      if (runEnd - i >= MIN_RUN_LENGTH)
+      {
+         encoded->push_back(RUN_FLAG | (runEnd - i));
+         encoded->push_back(values[i]);
+         i = runEnd;
+         continue;
+      }
+      
+      // Literals, until the next run long enough to be worth it
+      int literalStart = i;
+      while (i < numValues  &&  i - literalStart < MAX_RUN_LENGTH)
+      {
+         if (i + 2 < numValues  &&  values[i] == values[i + 1]  &&  values[i] == values[i + 2])
+            break;
+         
+         i++;
+      }
+      
+      encoded->push_back(i - literalStart);
+      encoded->insert(encoded->end(), values + literalStart, values + i);
+   }
+}
+
+/**
+ * Decode values encoded with runLengthEncode()
+ *
+ * @param tokens Encoded values
+ * @param numTokens Number of the encoded values
+ * @param add Should decoded values be added to the output (delta frames) instead of replacing it (key frames)
+ * @param values (OUT) Decoded values
+ * @param numValues Number of values to decode
+ */
+static void runLengthDecode(const unsigned short *tokens, long numTokens, bool add, unsigned short *values, int numValues)
+{
+   int position = 0;
+   long i = 0;
+   
+   while (i < numTokens  &&  position < numValues)
+   {
+      unsigned short token = tokens[i++];
+      int count = token & ~RUN_FLAG;
+      
+      CHECK(position + count <= numValues, "Corrupted animation cache");
+      
+      if (token & RUN_FLAG)
+      {
+         unsigned short value = tokens[i++];
+         for (int j = 0; j < count; j++, position++)
+            values[position] = add ? values[position] + value : value;
+      }
+      else
+      {
+         for (int j = 0; j < count; j++, position++)
+            values[position] = add ? values[position] + tokens[i++] : tokens[i++];
+      }
+   }
+}
+
+AnimationCache::AnimationCache() : data_(0), size_(0), maxTimeSliceError_(0), decodedFrameIndex_(-1)
+{
+   pthread_mutex_init(&mutex_, 0);
+}
+
+AnimationCache::~AnimationCache()
+{
+   close();
+   pthread_mutex_destroy(&mutex_);
+}
+
+string AnimationCache::getCacheFileName(const string &directory, const AnimationCacheKey &key)
+{
+   // Hash field by field, as structure padding is not initialized
+   unsigned long long hash = fnv1aHash(&key.geometryHash, sizeof(key.geometryHash));
+   hash = fnv1aHash(&key.shaderHash, sizeof(key.shaderHash), hash);
+   hash = fnv1aHash(&key.sizeX, sizeof(key.sizeX), hash);
+   hash = fnv1aHash(&key.sizeY, sizeof(key.sizeY), hash);
+   hash = fnv1aHash(key.renderedArea, sizeof(key.renderedArea), hash);
+   
+   char name[64];
+   snprintf(name, sizeof(name), "%016llx.hdcache", hash);
+   
+   if (directory.empty()  ||  directory[directory.size() - 1] == '/')
+      return directory + name;
+   
+   return directory + "/" + name;
+}
+
+bool AnimationCache::build(const string &fileName, GPUGeometryModel *model, double interframeDistance, AnimationCacheEncoding encoding)
+{
+   PRECONDITION(model);
+   PRECONDITION(interframeDistance > 0);
+   
+   // Copied, as push_back() takes reference and the constant has no definition
+   const double maxTimeSlice = GPUInterpolatedModel::MAX_TIME_SLICE;
+   
+   // Timeslices on the grid of the playback, plus the end of the animation
+   vector<double> timeSlices;
+   for (int i = 0; ; i++)
+   {
+      double timeSlice = GPUInterpolatedModel::MIN_TIME_SLICE + i * interframeDistance;
+      if (timeSlice >= maxTimeSlice  ||  areEqual(timeSlice, maxTimeSlice))
+         break;
+      
+      timeSlices.push_back(timeSlice);
+   }
+   
+   timeSlices.push_back(maxTimeSlice);
+   
+   FILE *file = fopen(fileName.c_str(), "wb");
+   if (!file)
+      return false;
+   
+   // We are building the cache, so the model must not read from one
+   const AnimationCache *previousCache = model->getAnimationCache();
+   model->setAnimationCache(0);
+   
+   Header header;
+   memset(&header, 0, sizeof(header));
+   memcpy(header.magic, ANIMATION_CACHE_MAGIC, sizeof(header.magic));
+   header.version = ANIMATION_CACHE_VERSION;
+   header.encoding = encoding;
+   header.key = model->getAnimationCacheKey();
+   header.numFrames = (int)timeSlices.size();
+   header.keyFrameInterval = KEY_FRAME_INTERVAL;
+   
+   vector<FrameEntry> entries(timeSlices.size());
+   
+   bool success = fwrite(&header, sizeof(header), 1, file) == 1  &&  fwrite(&entries[0], sizeof(FrameEntry), entries.size(), file) == entries.size();
+   
+   const int sizeX = header.key.sizeX;
+   const int sizeY = header.key.sizeY;
+   const int numValues = sizeX * sizeY;
+   
+   vector<float> values(numValues);
+   vector<unsigned short> quantized(numValues), previous(numValues), residual(numValues);
+   vector<unsigned short> encoded;
+   
+   long long offset = sizeof(header) + entries.size() * sizeof(FrameEntry);
+   
+   for (int frame = 0; frame < timeSlices.size()  &&  success; frame++)
+   {
+      model->setTimeSlice(timeSlices[frame]);
+      model->forceModelCalculation();
+      
+      for (int y = 0; y < sizeY; y++)
+         for (int x = 0; x < sizeX; x++)
+            values[y * sizeX + x] = model->getAt(x, y);
+      
+      // Align start of the frame
+      static const char padding[FRAME_ALIGNMENT] = {0};
+      long paddingSize = (FRAME_ALIGNMENT - offset % FRAME_ALIGNMENT) % FRAME_ALIGNMENT;
+      success = success  &&  fwrite(padding, 1, paddingSize, file) == paddingSize;
+      offset += paddingSize;
+      
+      const void *frameData;
+      long long frameSize;
+      
+      if (encoding == ANIMATION_CACHE_FLOAT)
+      {
+         frameData = &values[0];
+         frameSize = numValues * sizeof(float);
+      }
+      else
+      {
+         for (int i = 0; i < numValues; i++)
+            quantized[i] = quantize(values[i]);
+         
+         if (encoding == ANIMATION_CACHE_QUANTIZED)
+         {
+            frameData = &quantized[0];
+            frameSize = numValues * sizeof(unsigned short);
+         }
+         else
+         {
+            // Key frames are stored as they are, all others as difference from the previous frame (modulo 2^16)
+            bool isKeyFrame = frame % KEY_FRAME_INTERVAL == 0;
+            for (int i = 0; i < numValues; i++)
+               residual[i] = isKeyFrame ? quantized[i] : (unsigned short)(quantized[i] - previous[i]);
+            
+            encoded.clear();
+            runLengthEncode(&residual[0], numValues, &encoded);
+            
+            previous.swap(quantized);
+            
+            frameData = encoded.empty() ? 0 : &encoded[0];
+            frameSize = encoded.size() * sizeof(unsigned short);
+         }
+      }
+      
+      entries[frame].timeSlice = timeSlices[frame];
+      entries[frame].offset = offset;
+      entries[frame].size = frameSize;
+      
+      success = success  &&  (frameSize == 0  ||  fwrite(frameData, 1, frameSize, file) == frameSize);
+      offset += frameSize;
+   }
+   
+   // And now that we know where the frames are, write the frame table
+   success = success  &&  fseek(file, sizeof(header), SEEK_SET) == 0;
+   success = success  &&  fwrite(&entries[0], sizeof(FrameEntry), entries.size(), file) == entries.size();
+   success = (fclose(file) == 0)  &&  success;
+   
+   model->setAnimationCache(previousCache);
+   
+   if (!success)
+      unlink(fileName.c_str());
+   
+   return success;
+}
+
+bool AnimationCache::open(const string &fileName)
+{
+   close();
+   
+   int fd = ::open(fileName.c_str(), O_RDONLY);
+   if (fd == -1)
+      return false;
+   
+   struct stat fileStat;
+   if (fstat(fd, &fileStat)  ||  fileStat.st_size < sizeof(Header))
+   {
+      ::close(fd);
+      return false;
+   }
+   
+   void *data = mmap(0, fileStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   
+   // Mapping stays valid after the file is closed
+   ::close(fd);
+   
+   if (data == MAP_FAILED)
+      return false;
+   
+   data_ = data;
+   size_ = fileStat.st_size;
+   
+   // Validate everything we would later rely on
+   const Header *header = getHeader();
+   
+   bool valid = !memcmp(header->magic, ANIMATION_CACHE_MAGIC, sizeof(header->magic))  &&  header->version == ANIMATION_CACHE_VERSION  &&
+                header->encoding >= ANIMATION_CACHE_FLOAT  &&  header->encoding <= ANIMATION_CACHE_QUANTIZED_DELTA  &&
+                header->numFrames > 0  &&  header->keyFrameInterval > 0  &&  header->key.sizeX >= 0  &&  header->key.sizeY >= 0  &&
+                sizeof(Header) + header->numFrames * sizeof(FrameEntry) <= size_;
+   
+   long long numValues = (long long)header->key.sizeX * header->key.sizeY;
+   
+   for (int i = 0; i < header->numFrames  &&  valid; i++)
+   {
+      const FrameEntry *entry = getFrameEntry(i);
+      valid = entry->offset >= 0  &&  entry->size >= 0  &&  entry->offset + entry->size <= size_  &&  entry->offset % FRAME_ALIGNMENT == 0;
+      
+      if (header->encoding == ANIMATION_CACHE_FLOAT)
+         valid = valid  &&  entry->size == numValues * sizeof(float);
+      else if (header->encoding == ANIMATION_CACHE_QUANTIZED)
+         valid = valid  &&  entry->size == numValues * sizeof(unsigned short);
+   }
+   
+   if (!valid)
+   {
+      LOG("Invalid animation cache file");
+      close();
+      return false;
+   }
+   
+   // Tell OS that we would read the file mostly sequentially during the playback
+   madvise(data_, size_, MADV_SEQUENTIAL);
+   
+   return true;
+}
+
+void AnimationCache::close()
+{
+   if (data_)
+      munmap(data_, size_);
+   
+   data_ = 0;
+   size_ = 0;
+   
+   pthread_mutex_lock(&mutex_);
+   decodedFrame_.clear();
+   decodedFrameIndex_ = -1;
+   pthread_mutex_unlock(&mutex_);
+}
+
+const AnimationCache::Header *AnimationCache::getHeader() const
+{
+   PRECONDITION(isOpen());
+   return static_cast<const Header *>(data_);
+}
+
+const AnimationCache::FrameEntry *AnimationCache::getFrameEntry(int index) const
+{
+   PRECONDITION(isOpen());
+   return reinterpret_cast<const FrameEntry *>(static_cast<const char *>(data_) + sizeof(Header)) + index;
+}
+
+const AnimationCacheKey &AnimationCache::getKey() const
+{
+   return getHeader()->key;
+}
+
+AnimationCacheEncoding AnimationCache::getEncoding() const
+{
+   return (AnimationCacheEncoding)getHeader()->encoding;
+}
+
+int AnimationCache::getNumFrames() const
+{
+   return isOpen() ? getHeader()->numFrames : 0;
+}
+
+double AnimationCache::getTimeSlice(int index) const
+{
+   PRECONDITION(index >= 0  &&  index < getNumFrames());
+   return getFrameEntry(index)->timeSlice;
+}
+
+int AnimationCache::findFrame(double timeSlice) const
+{
+   int numFrames = getNumFrames();
+   if (numFrames == 0)
+      return -1;
+   
+   // Timeslices are sorted, find the first one that is not smaller
+   int low = 0, high = numFrames - 1;
+   while (low < high)
+   {
+      int middle = (low + high) / 2;
+      
+      if (getTimeSlice(middle) < timeSlice)
+         low = middle + 1;
+      else
+         high = middle;
+   }
+   
+   // Closest is either that one or the one before it
+   int closest = low;
+   if (low > 0  &&  fabs(getTimeSlice(low - 1) - timeSlice) < fabs(getTimeSlice(low) - timeSlice))
+      closest = low - 1;
+   
+   double cachedTimeSlice = getTimeSlice(closest);
+   
+   if (areEqual(cachedTimeSlice, timeSlice)  ||  fabs(cachedTimeSlice - timeSlice) <= maxTimeSliceError_)
+      return closest;
+   
+   return -1;
+}
+
+void AnimationCache::decodeDeltaFrame(int index) const
+{
+   const Header *header = getHeader();
+   const int numValues = header->key.sizeX * header->key.sizeY;
+   
+   if (decodedFrameIndex_ == index)
+      return;
+   
+   // Continue from the frame we decoded last if it is on the way, otherwise from the key frame
+   int keyFrame = index - index % header->keyFrameInterval;
+   int start = (decodedFrameIndex_ >= keyFrame  &&  decodedFrameIndex_ < index) ? decodedFrameIndex_ + 1 : keyFrame;
+   
+   decodedFrame_.resize(numValues);
+   
+   for (int frame = start; frame <= index; frame++)
+   {
+      const FrameEntry *entry = getFrameEntry(frame);
+      const unsigned short *tokens = reinterpret_cast<const unsigned short *>(static_cast<const char *>(data_) + entry->offset);
+      
+      runLengthDecode(tokens, entry->size / sizeof(unsigned short), frame != keyFrame, &decodedFrame_[0], numValues);
+      decodedFrameIndex_ = frame;
+   }
+}
+
+void AnimationCache::readFrame(int index, float *values) const
+{
+   PRECONDITION(index >= 0  &&  index < getNumFrames());
+   PRECONDITION(values);
+   
+   const Header *header = getHeader();
+   const int numValues = header->key.sizeX * header->key.sizeY;
+   const char *frameData = static_cast<const char *>(data_) + getFrameEntry(index)->offset;
+   
+   switch (header->encoding)
+   {
+      case ANIMATION_CACHE_FLOAT:
+         memcpy(values, frameData, numValues * sizeof(float));
+         break;
+         
+      case ANIMATION_CACHE_QUANTIZED:
+      {
+         const unsigned short *quantized = reinterpret_cast<const unsigned short *>(frameData);
+         for (int i = 0; i < numValues; i++)
+            values[i] = dequantize(quantized[i]);
+         break;
+      }
+         
+      default:
+         pthread_mutex_lock(&mutex_);
+         
+         decodeDeltaFrame(index);
+         for (int i = 0; i < numValues; i++)
+            values[i] = dequantize(decodedFrame_[i]);
+         
+         pthread_mutex_unlock(&mutex_);
+   }
+}
+
+FrameHandle AnimationCache::getFrame(int index) const
+{
+   const AnimationCacheKey &key = getKey();
+   
+   FrameHandle frame = Frame::create(key.sizeX, key.sizeY, getTimeSlice(index));
+   readFrame(index, frame->getMutableValues());
+   
+   return frame;
+}
+
+double AnimationCache::getAt(int index, int x, int y) const
+{
+   PRECONDITION(index >= 0  &&  index < getNumFrames());
+   
+   const Header *header = getHeader();
+   const int position = y * header->key.sizeX + x;
+   const char *frameData = static_cast<const char *>(data_) + getFrameEntry(index)->offset;
+   
+   switch (header->encoding)
+   {
+      case ANIMATION_CACHE_FLOAT:
+         return reinterpret_cast<const float *>(frameData)[position];
+         
+      case ANIMATION_CACHE_QUANTIZED:
+         return dequantize(reinterpret_cast<const unsigned short *>(frameData)[position]);
+         
+      default:
+         pthread_mutex_lock(&mutex_);
+         
+         decodeDeltaFrame(index);
+         double value = dequantize(decodedFrame_[position]);
+         
+         pthread_mutex_unlock(&mutex_);
+         
+         return value;
+   }
+}
@@ -0,0 +1,300 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ANIMATION_CACHE_H_
+#define ANIMATION_CACHE_H_
+
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+
+#include "Frame.h"
+
+namespace hdsim {
+   
+   class GPUGeometryModel;
+   
+   /**
+    * Everything that the calculated frames depend on, except for the timeslice. Cache is valid only for the model with the same key
+    */
+   struct AnimationCacheKey {
+      /**
+       * Fingerprint of the points and triangles (GPUGeometryModel::getGeometryFingerprint())
+       */
+      unsigned long long geometryHash;
+      
+      /**
+       * Fingerprint of the shader source (GPUGeometryModel::getShaderFingerprint())
+       */
+      unsigned long long shaderHash;
+      
+      /**
+       * Size of the board
+       */
+      int sizeX, sizeY;
+      
+      /**
+       * Rendered area as minX, minY, minZ, maxX, maxY, maxZ
+       */
+      double renderedArea[6];
+   };
+   
+   /**
+    * Compare two cache keys. Keys are equal only if they are exactly the same
+    */
+   bool operator==(const AnimationCacheKey &lhs, const AnimationCacheKey &rhs);
+   
+   inline bool operator!=(const AnimationCacheKey &lhs, const AnimationCacheKey &rhs)
+   {
+      return !(lhs == rhs);
+   }
+   
+   /**
+    * How frames are stored in the cache file
+    */
+   enum AnimationCacheEncoding {
+      /**
+       * Floats, exactly as calculated
+       */
+      ANIMATION_CACHE_FLOAT = 0,
+      
+      /**
+       * Values quantized to 16 bits. Depth values are in [0, 1], so error is below 1/65535 which is far below precision of any actuator
+       */
+      ANIMATION_CACHE_QUANTIZED = 1,
+      
+      /**
+       * Quantized values, with every frame except the key frames stored as difference from the previous frame, run length encoded. Smallest, but frames
+       * could be decoded only sequentially from the last key frame
+       */
+      ANIMATION_CACHE_QUANTIZED_DELTA = 2
+   };
+   
+   /**
+    * Precalculated animation stored on disk. Installations loop the same scene for hours, so instead of recalculating every frame on every loop, the whole 
+    * timeslice range is calculated once (build()) and later runs memory map the file (open()) and read frames from it.
+    *
+    * Cache is keyed by the AnimationCacheKey, so it is only used for the model it was built from (see GPUGeometryModel::setAnimationCache()). Frames are
+    * stored for the timeslices MIN_TIME_SLICE, MIN_TIME_SLICE + interframeDistance, ... and MAX_TIME_SLICE. 
+    *
+    * Reading is thread safe. File format is native byte order, so cache is meant to be used on the architecture it was built on.
+    */
+   class AnimationCache {
+      
+   public:
+      
+      /**
+       * Number of frames between two key frames in ANIMATION_CACHE_QUANTIZED_DELTA encoding
+       */
+      static const int KEY_FRAME_INTERVAL = 32;
+      
+      /**
+       * Constructor
+       */
+      AnimationCache();
+      
+      /**
+       * Destructor. Unmaps cache file
+       */
+      virtual ~AnimationCache();
+      
+      /**
+       * Calculate all frames of the animation on the model and store them in the cache file
+       *
+       * @param fileName File to write to
+       * @param model Model to calculate. Its timeslice would be changed
+       * @param interframeDistance Distance between two frames of animation, as used during playback
+       * @param encoding How frames should be stored
+       *
+       * @return Was cache built
+       */
+      static bool build(const std::string &fileName, GPUGeometryModel *model, double interframeDistance, AnimationCacheEncoding encoding);
+      
+      /**
+       * Get name of the cache file for the given key, so that caches for different models could live in the same directory
+       *
+       * @param directory Directory of the caches
+       * @param key Key of the model
+       *
+       * @return Name of the cache file
+       */
+      static std::string getCacheFileName(const std::string &directory, const AnimationCacheKey &key);
+      
+      /**
+       * Memory map cache file
+       *
+       * @param fileName File to open
+       *
+       * @return Was file opened and valid
+       */
+      virtual bool open(const std::string &fileName);
+      
+      /**
+       * Unmap cache file
+       */
+      virtual void close();
+      
+      /**
+       * Is cache file opened
+       *
+       * @return Is cache opened
+       */
+      virtual bool isOpen() const
+      {
+         return data_ != 0;
+      }
+      
+      /**
+       * Get key of the model from which cache was built
+       *
+       * @return Key of the cache
+       */
+      virtual const AnimationCacheKey &getKey() const;
+      
+      /**
+       * Get encoding of the frames
+       *
+       * @return Encoding
+       */
+      virtual AnimationCacheEncoding getEncoding() const;
+      
+      /**
+       * Get number of frames in the cache
+       *
+       * @return Number of frames
+       */
+      virtual int getNumFrames() const;
+      
+      /**
+       * Get timeslice of the frame
+       *
+       * @param index Index of the frame
+       *
+       * @return Timeslice of the frame
+       */
+      virtual double getTimeSlice(int index) const;
+      
+      /**
+       * Set how far could timeslice be from the cached one for cached frame to be used. By default, only frames at the same timeslice are used. Looping 
+       * animation whose interframe distance doesn't divide timeslice range would otherwise miss cache after the first loop
+       *
+       * @param maxError Max difference between requested and cached timeslice
+       */
+      virtual void setMaxTimeSliceError(double maxError)
+      {
+         maxTimeSliceError_ = maxError;
+      }
+      
+      /**
+       * Find frame for the timeslice
+       *
+       * @param timeSlice Timeslice to find
+       *
+       * @return Index of the frame, or -1 if there is no frame close enough
+       */
+      virtual int findFrame(double timeSlice) const;
+      
+      /**
+       * Read values of the frame
+       *
+       * @param index Index of the frame
+       * @param values (OUT) Values of the frame, stored so that [x][y] corresponds to [y * sizeX + x]
+       */
+      virtual void readFrame(int index, float *values) const;
+      
+      /**
+       * Get frame
+       *
+       * @param index Index of the frame
+       *
+       * @return Frame
+       */
+      virtual FrameHandle getFrame(int index) const;
+      
+      /**
+       * Get single value of the frame. Doesn't decode the whole frame unless encoding is ANIMATION_CACHE_QUANTIZED_DELTA
+       *
+       * @param index Index of the frame
+       * @param x X position
+       * @param y Y position
+       *
+       * @return Value at the position
+       */
+      virtual double getAt(int index, int x, int y) const;
+      
+   private:
+      
+      // copying is not supported
+      AnimationCache(const AnimationCache &rhs);
+      AnimationCache &operator=(const AnimationCache &rhs);
+      
+      struct Header;
+      struct FrameEntry;
+      
+      /**
+       * Get header of the mapped file
+       */
+      const Header *getHeader() const;
+      
+      /**
+       * Get entry of the frame in the frame table
+       */
+      const FrameEntry *getFrameEntry(int index) const;
+      
+      /**
+       * Decode quantized values of the frame into decodedFrame_. Must be called with mutex held
+       *
+       * @param index Index of the frame
+       */
+      void decodeDeltaFrame(int index) const;
+      
+      /**
+       * Mapped file, or 0
+       */
+      void *data_;
+      
+      /**
+       * Size of the mapped file
+       */
+      size_t size_;
+      
+      /**
+       * Max difference between requested and cached timeslice
+       */
+      double maxTimeSliceError_;
+      
+      /**
+       * Last frame decoded from the delta encoding, so that sequential playback decodes only one frame at the time
+       */
+      mutable std::vector<unsigned short> decodedFrame_;
+      
+      /**
+       * Index of the frame in decodedFrame_, or -1
+       */
+      mutable int decodedFrameIndex_;
+      
+      /**
+       * Guards decoded frame
+       */
+      mutable pthread_mutex_t mutex_;
+   };
+   
+} // namespace
+
+#endif
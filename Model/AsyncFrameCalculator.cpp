@@ -0,0 +1,186 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AsyncFrameCalculator.h"
+#include "GPUInterpolatedModel.h"
+#include "SimpleDesignByContract.h"
+
+using namespace hdsim;
+using namespace std;
+
+AsyncFrameCalculator::AsyncFrameCalculator(const GPUInterpolatedModel &model) : model_(0), pendingModel_(0), shutdown_(false), numSkippedRequests_(0)
+{
+   model_ = new GPUInterpolatedModel(model);
+   
+   pthread_mutex_init(&mutex_, 0);
+   pthread_cond_init(&requestAvailable_, 0);
+   
+   if (pthread_create(&thread_, 0, threadMain, this))
+   {
+      FAIL("Unable to start frame calculation thread");
+   }
+}
+
+AsyncFrameCalculator::~AsyncFrameCalculator()
+{
+   cancelPendingRequests();
+   
+   pthread_mutex_lock(&mutex_);
+   shutdown_ = true;
+   pthread_cond_signal(&requestAvailable_);
+   pthread_mutex_unlock(&mutex_);
+   
+   pthread_join(thread_, 0);
+   
+   delete pendingModel_;
+   delete model_;
+   
+   pthread_cond_destroy(&requestAvailable_);
+   pthread_mutex_destroy(&mutex_);
+}
+
+FrameFuture AsyncFrameCalculator::requestFrame(double timeSlice)
+{
+   FrameRequest request;
+   request.timeSlice = timeSlice;
+   request.future = FrameFuture::create();
+   
+   pthread_mutex_lock(&mutex_);
+   requests_.push_back(request);
+   pthread_cond_signal(&requestAvailable_);
+   pthread_mutex_unlock(&mutex_);
+   
+   return request.future;
+}
+
+int AsyncFrameCalculator::cancelPendingRequests()
+{
+   int numCancelled = 0;
+   
+   pthread_mutex_lock(&mutex_);
+   
+   for (int i = 0; i < requests_.size(); i++)
+   {
+      if (requests_[i].future.cancel())
+         numCancelled++;
+   }
+   
+   pthread_mutex_unlock(&mutex_);
+   
+   return numCancelled;
+}
+
+int AsyncFrameCalculator::getNumPendingRequests() const
+{
+   pthread_mutex_lock(&mutex_);
+   int numPendingRequests = (int)requests_.size();
+   pthread_mutex_unlock(&mutex_);
+   
+   return numPendingRequests;
+}
+
+void AsyncFrameCalculator::setModel(const GPUInterpolatedModel &model)
+{
+   GPUInterpolatedModel *clone = new GPUInterpolatedModel(model);
+   
+   pthread_mutex_lock(&mutex_);
+   delete pendingModel_;
+   pendingModel_ = clone;
+   pthread_mutex_unlock(&mutex_);
+}
+
+Statistics AsyncFrameCalculator::getCalculationStatistics() const
+{
+   pthread_mutex_lock(&mutex_);
+   Statistics statistics = calculationStatistics_;
+   pthread_mutex_unlock(&mutex_);
+   
+   return statistics;
+}
+
+long AsyncFrameCalculator::getNumSkippedRequests() const
+{
+   pthread_mutex_lock(&mutex_);
+   long numSkippedRequests = numSkippedRequests_;
+   pthread_mutex_unlock(&mutex_);
+   
+   return numSkippedRequests;
+}
+
+void *AsyncFrameCalculator::threadMain(void *calculator)
+{
+   static_cast<AsyncFrameCalculator *>(calculator)->computeLoop();
+   return 0;
+}
+
+void AsyncFrameCalculator::computeLoop()
+{
+   while (true)
+   {
+      pthread_mutex_lock(&mutex_);
+      
+      while (!shutdown_  &&  requests_.empty())
+         pthread_cond_wait(&requestAvailable_, &mutex_);
+      
+      if (shutdown_)
+      {
+         pthread_mutex_unlock(&mutex_);
+         return;
+      }
+      
+      FrameRequest request = requests_.front();
+      requests_.pop_front();
+      
+      GPUInterpolatedModel *newModel = pendingModel_;
+      pendingModel_ = 0;
+      
+      pthread_mutex_unlock(&mutex_);
+      
+      // Old model (and its OpenGL context) is destroyed on this thread too
+      if (newModel)
+      {
+         delete model_;
+         model_ = newModel;
+      }
+      
+      if (request.future.isCancelled())
+      {
+         pthread_mutex_lock(&mutex_);
+         numSkippedRequests_++;
+         pthread_mutex_unlock(&mutex_);
+         
+         continue;
+      }
+      
+      pthread_mutex_lock(&mutex_);
+      calculationStatistics_.startTimer();
+      pthread_mutex_unlock(&mutex_);
+      
+      model_->setTimeSlice(request.timeSlice);
+      model_->forceModelCalculation();
+      FrameHandle frame = Frame::createFromModel(model_, request.timeSlice);
+      
+      pthread_mutex_lock(&mutex_);
+      calculationStatistics_.stopTimer();
+      calculationStatistics_.addAggregateStatistics(frame->getSizeX() * frame->getSizeY());
+      pthread_mutex_unlock(&mutex_);
+      
+      // Request could have been cancelled while we were calculating, in which case frame is simply dropped
+      request.future.setValue(frame);
+   }
+}
@@ -0,0 +1,182 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ASYNC_FRAME_CALCULATOR_H_
+#define ASYNC_FRAME_CALCULATOR_H_
+
+#include <deque>
+
+#include <pthread.h>
+
+#include "Frame.h"
+#include "Future.h"
+#include "Statistics.h"
+
+namespace hdsim {
+   
+   class GPUInterpolatedModel;
+   
+   /**
+    * Future of the frame requested from the AsyncFrameCalculator
+    */
+   typedef Future<FrameHandle> FrameFuture;
+   
+   /**
+    * Calculates frames on the dedicated compute thread, so that caller doesn't block for the whole calculation and could overlap calculation of the next 
+    * frame with drawing or transmitting the current one.
+    *
+    * Calculator works on its own clone of the model. GPUCalculationEngine is not thread safe, so clone (together with its OpenGL context) is only ever 
+    * touched by the compute thread. Changes of the model (geometry, rendered area, drawing optimization) are passed with setModel() and are applied before the 
+    * next requested frame is calculated.
+    *
+    * Requests are calculated in the order in which they were made. Requests whose futures are cancelled before calculation starts are skipped, so when the
+    * timeslice moves, caller should cancel stale requests (or use cancelPendingRequests()) instead of waiting for them.
+    */
+   class AsyncFrameCalculator {
+      
+   public:
+      
+      /**
+       * Constructor. Starts compute thread
+       *
+       * @param model Model to calculate. Calculator works on its own clone of it
+       */
+      AsyncFrameCalculator(const GPUInterpolatedModel &model);
+      
+      /**
+       * Destructor. Cancels pending requests and stops compute thread
+       */
+      virtual ~AsyncFrameCalculator();
+      
+      /**
+       * Request frame at the given timeslice. Doesn't block
+       *
+       * @param timeSlice Timeslice of the frame
+       *
+       * @return Future that would hold calculated frame
+       */
+      virtual FrameFuture requestFrame(double timeSlice);
+      
+      /**
+       * Cancel all requests whose calculation has not started yet
+       *
+       * @return Number of cancelled requests
+       */
+      virtual int cancelPendingRequests();
+      
+      /**
+       * Get number of requests waiting for calculation
+       *
+       * @return Number of pending requests
+       */
+      virtual int getNumPendingRequests() const;
+      
+      /**
+       * Replace model used for calculation. Change is applied before the next frame is calculated
+       *
+       * @param model New model. Calculator works on its own clone of it
+       */
+      virtual void setModel(const GPUInterpolatedModel &model);
+      
+      /**
+       * Get statistics of the frame calculation (time spent calculating and number of moxels calculated)
+       *
+       * @return Calculation statistics
+       */
+      virtual Statistics getCalculationStatistics() const;
+      
+      /**
+       * Get number of requests that were skipped because they were cancelled
+       *
+       * @return Number of skipped requests
+       */
+      virtual long getNumSkippedRequests() const;
+      
+   private:
+      
+      // copying is not supported
+      AsyncFrameCalculator(const AsyncFrameCalculator &rhs);
+      AsyncFrameCalculator &operator=(const AsyncFrameCalculator &rhs);
+      
+      /**
+       * Request waiting for calculation
+       */
+      struct FrameRequest {
+         double timeSlice;
+         FrameFuture future;
+      };
+      
+      /**
+       * Thread entry point
+       */
+      static void *threadMain(void *calculator);
+      
+      /**
+       * Main loop of the compute thread
+       */
+      void computeLoop();
+      
+      /**
+       * Model used for calculation. Only compute thread touches it
+       */
+      GPUInterpolatedModel *model_;
+      
+      /**
+       * Model passed with setModel() that compute thread should switch to, or 0
+       */
+      GPUInterpolatedModel *pendingModel_;
+      
+      /**
+       * Requests waiting for calculation
+       */
+      std::deque<FrameRequest> requests_;
+      
+      /**
+       * Compute thread
+       */
+      pthread_t thread_;
+      
+      /**
+       * Should compute thread stop
+       */
+      bool shutdown_;
+      
+      /**
+       * Guards requests, pending model, statistics and shutdown flag
+       */
+      mutable pthread_mutex_t mutex_;
+      
+      /**
+       * Signaled when there is new request or calculator is shutting down
+       */
+      pthread_cond_t requestAvailable_;
+      
+      /**
+       * Calculation statistics
+       */
+      Statistics calculationStatistics_;
+      
+      /**
+       * Number of skipped requests
+       */
+      long numSkippedRequests_;
+   };
+   
+} // namespace
+
+#endif
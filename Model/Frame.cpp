@@ -0,0 +1,70 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+
+#include "Frame.h"
+#include "SimpleDesignByContract.h"
+
+using namespace hdsim;
+using namespace std;
+
+Frame::Frame(int sizeX, int sizeY, double timeSlice) : sizeX_(sizeX), sizeY_(sizeY), timeSlice_(timeSlice), values_(0), refCount_(1)
+{
+   PRECONDITION(sizeX >= 0  &&  sizeY >= 0);
+   
+   values_ = new float[sizeX * sizeY];
+   CHECK(values_, "Memory allocation failure");
+   
+   memset(values_, 0, sizeX * sizeY * sizeof(float));
+}
+
+Frame::~Frame()
+{
+   delete [] values_;
+}
+
+FrameHandle Frame::create(int sizeX, int sizeY, double timeSlice)
+{
+   return FrameHandle(new Frame(sizeX, sizeY, timeSlice));
+}
+
+FrameHandle Frame::createFromModel(const AbstractModel *model, double timeSlice)
+{
+   PRECONDITION(model);
+   
+   int sizeX = model->getSizeX();
+   int sizeY = model->getSizeY();
+   
+   FrameHandle frame = create(sizeX, sizeY, timeSlice);
+   float *values = frame->getMutableValues();
+   
+   for (int y = 0; y < sizeY; y++)
+      for (int x = 0; x < sizeX; x++)
+         values[y * sizeX + x] = model->getAt(x, y);
+   
+   return frame;
+}
+
+AbstractModel *Frame::cloneOrphan() const
+{
+   Frame *clone = new Frame(sizeX_, sizeY_, timeSlice_);
+   memcpy(clone->values_, values_, sizeX_ * sizeY_ * sizeof(float));
+   
+   return clone;
+}
@@ -0,0 +1,295 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_H_
+#define FRAME_H_
+
+#include <string>
+
+#include "AbstractModel.h"
+
+static const char *const FRAME_MODEL_NAME = "Frame";
+
+namespace hdsim {
+   
+   class FrameHandle;
+   
+   /**
+    * Immutable snapshot of the calculated board at some timeslice. Frames are reference counted and are only accessed through the FrameHandle, so they could 
+    * be safely passed between threads and shared by multiple consumers (drawing, actuator output, caches) without copying values.
+    *
+    * Frame is a model itself, so it could be drawn directly by the drawing code.
+    */
+   class Frame : public AbstractModel {
+      
+   public:
+      
+      /**
+       * Create frame with all values set to 0
+       *
+       * @param sizeX Size of the frame in X direction
+       * @param sizeY Size of the frame in Y direction
+       * @param timeSlice Timeslice at which frame was calculated
+       *
+       * @return Handle to the new frame
+       */
+      static FrameHandle create(int sizeX, int sizeY, double timeSlice);
+      
+      /**
+       * Create snapshot of the model. Model would be calculated if it isn't already
+       *
+       * @param model Model to take snapshot of
+       * @param timeSlice Timeslice at which model is calculated
+       *
+       * @return Handle to the new frame
+       */
+      static FrameHandle createFromModel(const AbstractModel *model, double timeSlice);
+      
+      /**
+       * Destructor
+       */
+      virtual ~Frame();
+      
+      // Overriden methods
+      virtual const char *getModelName() const
+      {
+         return FRAME_MODEL_NAME;
+      }
+      
+      virtual double getAt(int x, int y) const
+      {
+         return values_[y * sizeX_ + x];
+      }
+      
+      virtual int getSizeX() const
+      {
+         return sizeX_;
+      }
+      
+      virtual int getSizeY() const
+      {
+         return sizeY_;
+      }
+      
+      virtual AbstractModel *cloneOrphan() const;
+      
+      /**
+       * Frames are not read from the files
+       *
+       * @return false
+       */
+      virtual bool readFromFile(const std::string &fileName)
+      {
+         return false;
+      }
+      
+      virtual const char *getFileName() const
+      {
+         return "";
+      }
+      
+      /**
+       * Get timeslice at which frame was calculated
+       *
+       * @return Timeslice of the frame
+       */
+      virtual double getTimeSlice() const
+      {
+         return timeSlice_;
+      }
+      
+      /**
+       * Get values of the frame, stored so that [x][y] corresponds to [y * getSizeX() + x]
+       *
+       * @return Values of the frame
+       */
+      const float *getValues() const
+      {
+         return values_;
+      }
+      
+      /**
+       * Get writable values of the frame. Only the producer of the frame should write, and only before frame is shared with anyone else
+       *
+       * @return Values of the frame
+       */
+      float *getMutableValues()
+      {
+         return values_;
+      }
+      
+   private:
+      
+      /**
+       * Constructor. Frames are created only through create()
+       */
+      Frame(int sizeX, int sizeY, double timeSlice);
+      
+      // copying is not supported
+      Frame(const Frame &rhs);
+      Frame &operator=(const Frame &rhs);
+      
+      friend class FrameHandle;
+      friend class FramePublisher;
+      
+      /**
+       * Dimensions
+       */
+      int sizeX_, sizeY_;
+      
+      /**
+       * Timeslice of the frame
+       */
+      double timeSlice_;
+      
+      /**
+       * Values of the frame
+       */
+      float *values_;
+      
+      /**
+       * Number of handles referencing this frame
+       */
+      volatile long refCount_;
+   };
+   
+   /**
+    * Reference counted handle to the frame. Copying handle is cheap and thread safe, frame is deleted when the last handle is gone
+    */
+   class FrameHandle {
+      
+   public:
+      
+      /**
+       * Create handle that doesn't reference any frame
+       */
+      FrameHandle() : frame_(0)
+      {
+      }
+      
+      /**
+       * Copy constructor
+       *
+       * @param rhs Handle to copy
+       */
+      FrameHandle(const FrameHandle &rhs) : frame_(rhs.frame_)
+      {
+         retain();
+      }
+      
+      /**
+       * Operator =
+       *
+       * @param rhs Handle to copy
+       */
+      FrameHandle &operator=(const FrameHandle &rhs)
+      {
+         if (rhs.frame_ != frame_)
+         {
+            release();
+            frame_ = rhs.frame_;
+            retain();
+         }
+         
+         return *this;
+      }
+      
+      /**
+       * Destructor
+       */
+      ~FrameHandle()
+      {
+         release();
+      }
+      
+      /**
+       * Does handle reference frame
+       *
+       * @return Is handle valid
+       */
+      bool isValid() const
+      {
+         return frame_ != 0;
+      }
+      
+      /**
+       * Get referenced frame
+       *
+       * @return Frame, or 0 if handle is not valid
+       */
+      Frame *get() const
+      {
+         return frame_;
+      }
+      
+      Frame *operator->() const
+      {
+         return frame_;
+      }
+      
+      Frame &operator*() const
+      {
+         return *frame_;
+      }
+      
+      /**
+       * Get number of handles referencing the same frame
+       *
+       * @return Reference count, or 0 if handle is not valid
+       */
+      long getRefCount() const
+      {
+         return frame_ ? __sync_fetch_and_add(&frame_->refCount_, 0) : 0;
+      }
+      
+   private:
+      
+      friend class Frame;
+      
+      /**
+       * Adopt newly created frame
+       *
+       * @param frame Frame to adopt, with reference count of 1
+       */
+      explicit FrameHandle(Frame *frame) : frame_(frame)
+      {
+      }
+      
+      void retain()
+      {
+         if (frame_)
+            __sync_fetch_and_add(&frame_->refCount_, 1);
+      }
+      
+      void release()
+      {
+         if (frame_  &&  __sync_sub_and_fetch(&frame_->refCount_, 1) == 0)
+            delete frame_;
+         
+         frame_ = 0;
+      }
+      
+      /**
+       * Referenced frame
+       */
+      Frame *frame_;
+   };
+   
+} // namespace
+
+#endif
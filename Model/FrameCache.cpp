@@ -0,0 +1,242 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+
+#include "FrameCache.h"
+#include "SimpleDesignByContract.h"
+
+using namespace hdsim;
+using namespace std;
+
+bool hdsim::operator<(const FrameCacheKey &lhs, const FrameCacheKey &rhs)
+{
+   const AnimationCacheKey &l = lhs.sceneKey, &r = rhs.sceneKey;
+   
+   if (l.geometryHash != r.geometryHash)
+      return l.geometryHash < r.geometryHash;
+   
+   if (l.shaderHash != r.shaderHash)
+      return l.shaderHash < r.shaderHash;
+   
+   if (l.sizeX != r.sizeX)
+      return l.sizeX < r.sizeX;
+   
+   if (l.sizeY != r.sizeY)
+      return l.sizeY < r.sizeY;
+   
+   for (int i = 0; i < 6; i++)
+      if (l.renderedArea[i] != r.renderedArea[i])
+         return l.renderedArea[i] < r.renderedArea[i];
+   
+   return lhs.quantizedTimeSlice < rhs.quantizedTimeSlice;
+}
+
+static pthread_once_t sharedCacheOnce = PTHREAD_ONCE_INIT;
+static FrameCache *sharedCache = 0;
+
+static void createSharedCache()
+{
+   sharedCache = new FrameCache();
+}
+
+FrameCache *FrameCache::getSharedCache()
+{
+   pthread_once(&sharedCacheOnce, createSharedCache);
+   return sharedCache;
+}
+
+FrameCache::FrameCache(size_t byteBudget, double timeSliceQuantum) : byteBudget_(byteBudget), numBytes_(0), timeSliceQuantum_(timeSliceQuantum),
+                                                                     numHits_(0), numMisses_(0), numEvictions_(0)
+{
+   PRECONDITION(timeSliceQuantum > 0);
+   pthread_mutex_init(&mutex_, 0);
+}
+
+FrameCache::~FrameCache()
+{
+   pthread_mutex_destroy(&mutex_);
+}
+
+FrameCacheKey FrameCache::makeKey(const AnimationCacheKey &sceneKey, double timeSlice) const
+{
+   FrameCacheKey key;
+   
+   key.sceneKey = sceneKey;
+   key.quantizedTimeSlice = (long long)floor(timeSlice / timeSliceQuantum_ + 0.5);
+   
+   return key;
+}
+
+size_t FrameCache::getFrameBytes(const FrameHandle &frame)
+{
+   return sizeof(Frame) + (size_t)frame->getSizeX() * frame->getSizeY() * sizeof(float);
+}
+
+FrameHandle FrameCache::find(const FrameCacheKey &key)
+{
+   pthread_mutex_lock(&mutex_);
+   
+   FrameHandle frame;
+   EntryMap::iterator found = index_.find(key);
+   
+   if (found != index_.end())
+   {
+      // Move to the front, iterators stay valid
+      entries_.splice(entries_.begin(), entries_, found->second);
+      frame = found->second->frame;
+      numHits_++;
+   }
+   else
+   {
+      numMisses_++;
+   }
+   
+   pthread_mutex_unlock(&mutex_);
+   
+   return frame;
+}
+
+void FrameCache::insert(const FrameCacheKey &key, const FrameHandle &frame)
+{
+   PRECONDITION(frame.isValid());
+   
+   size_t numBytes = getFrameBytes(frame);
+   
+   pthread_mutex_lock(&mutex_);
+   
+   EntryMap::iterator found = index_.find(key);
+   if (found != index_.end())
+   {
+      numBytes_ -= found->second->numBytes;
+      entries_.erase(found->second);
+      index_.erase(found);
+   }
+   
+   if (numBytes <= byteBudget_)
+   {
+      // Make space first, so that we never go over the budget
+      evictToBudget(byteBudget_ - numBytes);
+      
+      Entry entry;
+      entry.key = key;
+      entry.frame = frame;
+      entry.numBytes = numBytes;
+      
+      entries_.push_front(entry);
+      index_[key] = entries_.begin();
+      numBytes_ += numBytes;
+   }
+   
+   pthread_mutex_unlock(&mutex_);
+}
+
+void FrameCache::evictToBudget(size_t byteBudget)
+{
+   while (numBytes_ > byteBudget  &&  !entries_.empty())
+   {
+      Entry &last = entries_.back();
+      
+      numBytes_ -= last.numBytes;
+      index_.erase(last.key);
+      entries_.pop_back();
+      numEvictions_++;
+   }
+}
+
+void FrameCache::clear()
+{
+   pthread_mutex_lock(&mutex_);
+   
+   entries_.clear();
+   index_.clear();
+   numBytes_ = 0;
+   
+   pthread_mutex_unlock(&mutex_);
+}
+
+void FrameCache::setByteBudget(size_t byteBudget)
+{
+   pthread_mutex_lock(&mutex_);
+   
+   byteBudget_ = byteBudget;
+   evictToBudget(byteBudget_);
+   
+   pthread_mutex_unlock(&mutex_);
+}
+
+size_t FrameCache::getByteBudget() const
+{
+   pthread_mutex_lock(&mutex_);
+   size_t byteBudget = byteBudget_;
+   pthread_mutex_unlock(&mutex_);
+   
+   return byteBudget;
+}
+
+size_t FrameCache::getNumBytes() const
+{
+   pthread_mutex_lock(&mutex_);
+   size_t numBytes = numBytes_;
+   pthread_mutex_unlock(&mutex_);
+   
+   return numBytes;
+}
+
+int FrameCache::getNumFrames() const
+{
+   pthread_mutex_lock(&mutex_);
+   int numFrames = (int)entries_.size();
+   pthread_mutex_unlock(&mutex_);
+   
+   return numFrames;
+}
+
+long FrameCache::getNumHits() const
+{
+   pthread_mutex_lock(&mutex_);
+   long numHits = numHits_;
+   pthread_mutex_unlock(&mutex_);
+   
+   return numHits;
+}
+
+long FrameCache::getNumMisses() const
+{
+   pthread_mutex_lock(&mutex_);
+   long numMisses = numMisses_;
+   pthread_mutex_unlock(&mutex_);
+   
+   return numMisses;
+}
+
+long FrameCache::getNumEvictions() const
+{
+   pthread_mutex_lock(&mutex_);
+   long numEvictions = numEvictions_;
+   pthread_mutex_unlock(&mutex_);
+   
+   return numEvictions;
+}
+
+void FrameCache::resetStatistics()
+{
+   pthread_mutex_lock(&mutex_);
+   numHits_ = numMisses_ = numEvictions_ = 0;
+   pthread_mutex_unlock(&mutex_);
+}
@@ -0,0 +1,244 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_CACHE_H_
+#define FRAME_CACHE_H_
+
+#include <cstddef>
+#include <list>
+#include <map>
+
+#include <pthread.h>
+
+#include "AnimationCache.h"
+#include "Frame.h"
+
+namespace hdsim {
+   
+   /**
+    * Key of the frame in the FrameCache. Scene is identified the same way as in the AnimationCache, and timeslice is quantized so that timeslices differing 
+    * only by the floating point error map to the same frame
+    */
+   struct FrameCacheKey {
+      /**
+       * Everything that the frame depends on, except the timeslice
+       */
+      AnimationCacheKey sceneKey;
+      
+      /**
+       * Timeslice divided by the quantum and rounded
+       */
+      long long quantizedTimeSlice;
+   };
+   
+   /**
+    * Order frame cache keys, so that they could be used in std::map
+    */
+   bool operator<(const FrameCacheKey &lhs, const FrameCacheKey &rhs);
+   
+   /**
+    * Bounded memory cache of the calculated frames, evicting the least recently used frame when over the budget. Scrubbing the timeslice back and forth
+    * would otherwise recalculate frames that were calculated a moment ago.
+    *
+    * Calculation engines use the shared cache (getSharedCache()) by default, so that clones of the model (e.g. in the AsyncFrameCalculator) share
+    * frames too. This class is thread safe.
+    */
+   class FrameCache {
+      
+   public:
+      
+      /**
+       * Default memory budget, enough for a few hundred frames of the 128x128 board
+       */
+      static const size_t DEFAULT_BYTE_BUDGET = 64 * 1024 * 1024;
+      
+      /**
+       * Default timeslice quantum. Small enough that only timeslices that are the same up to floating point error share the frame
+       */
+      static const double DEFAULT_TIME_SLICE_QUANTUM = 1e-6;
+      
+      /**
+       * Constructor
+       *
+       * @param byteBudget Max memory used by the cached frames
+       * @param timeSliceQuantum Timeslices closer then this are considered the same
+       */
+      explicit FrameCache(size_t byteBudget = DEFAULT_BYTE_BUDGET, double timeSliceQuantum = DEFAULT_TIME_SLICE_QUANTUM);
+      
+      /**
+       * Destructor
+       */
+      virtual ~FrameCache();
+      
+      /**
+       * Get cache shared by the whole application, created on the first use with the default budget
+       *
+       * @return Shared cache
+       */
+      static FrameCache *getSharedCache();
+      
+      /**
+       * Create key for the frame
+       *
+       * @param sceneKey Key of the scene (GPUGeometryModel::getAnimationCacheKey())
+       * @param timeSlice Timeslice of the frame
+       *
+       * @return Key of the frame
+       */
+      virtual FrameCacheKey makeKey(const AnimationCacheKey &sceneKey, double timeSlice) const;
+      
+      /**
+       * Find frame in the cache. Found frame becomes most recently used
+       *
+       * @param key Key of the frame
+       *
+       * @return Frame, or invalid handle if frame is not cached
+       */
+      virtual FrameHandle find(const FrameCacheKey &key);
+      
+      /**
+       * Add frame to the cache, evicting least recently used frames if needed. Frames larger then the whole budget are not cached
+       *
+       * @param key Key of the frame
+       * @param frame Frame to add
+       */
+      virtual void insert(const FrameCacheKey &key, const FrameHandle &frame);
+      
+      /**
+       * Remove all frames from the cache
+       */
+      virtual void clear();
+      
+      /**
+       * Set memory budget, evicting frames if cache is over it
+       *
+       * @param byteBudget Max memory used by the cached frames
+       */
+      virtual void setByteBudget(size_t byteBudget);
+      
+      /**
+       * Get memory budget
+       *
+       * @return Max memory used by the cached frames
+       */
+      virtual size_t getByteBudget() const;
+      
+      /**
+       * Get memory used by the cached frames
+       *
+       * @return Memory used
+       */
+      virtual size_t getNumBytes() const;
+      
+      /**
+       * Get number of cached frames
+       *
+       * @return Number of frames
+       */
+      virtual int getNumFrames() const;
+      
+      /**
+       * Get number of find() calls that found the frame since the last reset
+       *
+       * @return Number of hits
+       */
+      virtual long getNumHits() const;
+      
+      /**
+       * Get number of find() calls that didn't find the frame since the last reset
+       *
+       * @return Number of misses
+       */
+      virtual long getNumMisses() const;
+      
+      /**
+       * Get number of frames evicted to stay within the budget since the last reset
+       *
+       * @return Number of evictions
+       */
+      virtual long getNumEvictions() const;
+      
+      /**
+       * Reset hit, miss and eviction counts
+       */
+      virtual void resetStatistics();
+      
+   private:
+      
+      // copying is not supported
+      FrameCache(const FrameCache &rhs);
+      FrameCache &operator=(const FrameCache &rhs);
+      
+      /**
+       * Cached frame
+       */
+      struct Entry {
+         FrameCacheKey key;
+         FrameHandle frame;
+         size_t numBytes;
+      };
+      
+      typedef std::list<Entry> EntryList;
+      typedef std::map<FrameCacheKey, EntryList::iterator> EntryMap;
+      
+      /**
+       * Get memory used by the frame
+       */
+      static size_t getFrameBytes(const FrameHandle &frame);
+      
+      /**
+       * Evict least recently used frames until cache fits into the budget. Must be called with mutex held
+       *
+       * @param byteBudget Budget to fit into
+       */
+      void evictToBudget(size_t byteBudget);
+      
+      /**
+       * Frames, most recently used first
+       */
+      EntryList entries_;
+      
+      /**
+       * Index of the frames by key
+       */
+      EntryMap index_;
+      
+      /**
+       * Memory budget and memory used
+       */
+      size_t byteBudget_, numBytes_;
+      
+      /**
+       * Timeslice quantum
+       */
+      double timeSliceQuantum_;
+      
+      /**
+       * Statistics
+       */
+      long numHits_, numMisses_, numEvictions_;
+      
+      /**
+       * Guards everything above
+       */
+      mutable pthread_mutex_t mutex_;
+   };
+   
+} // namespace
+
+#endif
@@ -0,0 +1,195 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FramePrefetcher.h"
+#include "GPUInterpolatedModel.h"
+#include "MathHelper.h"
+#include "SimpleDesignByContract.h"
+
+using namespace hdsim;
+using namespace std;
+
+FramePrefetcher::FramePrefetcher(const GPUInterpolatedModel &model, int depth) : calculator_(model), depth_(depth), interframeDistance_(0), loop_(true),
+                                                                               lastRequestedTimeSlice_(0), lastPoppedTimeSlice_(0), wasSeeked_(false),
+                                                                               numHits_(0), numMisses_(0), numInvalidations_(0)
+{
+   PRECONDITION(depth > 0);
+   
+   pthread_mutex_init(&mutex_, 0);
+}
+
+FramePrefetcher::~FramePrefetcher()
+{
+   pthread_mutex_lock(&mutex_);
+   
+   for (int i = 0; i < queue_.size(); i++)
+      queue_[i].cancel();
+   
+   queue_.clear();
+   
+   pthread_mutex_unlock(&mutex_);
+   pthread_mutex_destroy(&mutex_);
+}
+
+void FramePrefetcher::setAnimation(double interframeDistance, bool loop)
+{
+   pthread_mutex_lock(&mutex_);
+   
+   if (!areEqual(interframeDistance, interframeDistance_)  ||  loop != loop_)
+   {
+      interframeDistance_ = interframeDistance;
+      loop_ = loop;
+      
+      if (wasSeeked_)
+         refill(lastPoppedTimeSlice_);
+   }
+   
+   pthread_mutex_unlock(&mutex_);
+}
+
+void FramePrefetcher::seek(double currentTimeSlice)
+{
+   pthread_mutex_lock(&mutex_);
+   
+   wasSeeked_ = true;
+   lastPoppedTimeSlice_ = currentTimeSlice;
+   refill(currentTimeSlice);
+   
+   pthread_mutex_unlock(&mutex_);
+}
+
+void FramePrefetcher::setModel(const GPUInterpolatedModel &model)
+{
+   pthread_mutex_lock(&mutex_);
+   
+   // Requests made after this point would be calculated with the new model
+   calculator_.setModel(model);
+   
+   if (wasSeeked_)
+      refill(lastPoppedTimeSlice_);
+   
+   pthread_mutex_unlock(&mutex_);
+}
+
+FrameHandle FramePrefetcher::popFrame()
+{
+   pthread_mutex_lock(&mutex_);
+   
+   CHECK(wasSeeked_, "Prefetcher must be seeked before frames are popped");
+   
+   FrameFuture future = queue_.front();
+   queue_.pop_front();
+   requestNextFrame();
+   
+   if (future.isReady())
+      numHits_++;
+   else
+      numMisses_++;
+   
+   pthread_mutex_unlock(&mutex_);
+   
+   // Wait outside of the lock, so that queue could be invalidated in the meantime
+   FrameHandle frame = future.get();
+   
+   // Frame could be cancelled only if queue was invalidated while we were waiting, in which case the right frame is in the new queue
+   if (!frame.isValid())
+      return popFrame();
+   
+   pthread_mutex_lock(&mutex_);
+   lastPoppedTimeSlice_ = frame->getTimeSlice();
+   pthread_mutex_unlock(&mutex_);
+   
+   return frame;
+}
+
+void FramePrefetcher::skipFrames(int numFrames)
+{
+   pthread_mutex_lock(&mutex_);
+   
+   for (int i = 0; i < numFrames  &&  wasSeeked_; i++)
+   {
+      FrameFuture future = queue_.front();
+      queue_.pop_front();
+      
+      // At the end of the animation that doesn't loop, the same request is queued more than once
+      if (queue_.empty()  ||  !(queue_.front() == future))
+         future.cancel();
+      
+      requestNextFrame();
+   }
+   
+   pthread_mutex_unlock(&mutex_);
+}
+
+long FramePrefetcher::getNumHits() const
+{
+   pthread_mutex_lock(&mutex_);
+   long numHits = numHits_;
+   pthread_mutex_unlock(&mutex_);
+   
+   return numHits;
+}
+
+long FramePrefetcher::getNumMisses() const
+{
+   pthread_mutex_lock(&mutex_);
+   long numMisses = numMisses_;
+   pthread_mutex_unlock(&mutex_);
+   
+   return numMisses;
+}
+
+long FramePrefetcher::getNumInvalidations() const
+{
+   pthread_mutex_lock(&mutex_);
+   long numInvalidations = numInvalidations_;
+   pthread_mutex_unlock(&mutex_);
+   
+   return numInvalidations;
+}
+
+void FramePrefetcher::refill(double currentTimeSlice)
+{
+   if (!queue_.empty())
+      numInvalidations_++;
+   
+   for (int i = 0; i < queue_.size(); i++)
+      queue_[i].cancel();
+   
+   queue_.clear();
+   
+   lastRequestedTimeSlice_ = currentTimeSlice;
+   
+   for (int i = 0; i < depth_; i++)
+      requestNextFrame();
+}
+
+void FramePrefetcher::requestNextFrame()
+{
+   double timeSlice = GPUInterpolatedModel::getNextTimeSlice(lastRequestedTimeSlice_, interframeDistance_, loop_);
+   
+   // Animation that doesn't loop stays at the end, there is no point in calculating the same frame again
+   if (!queue_.empty()  &&  timeSlice == lastRequestedTimeSlice_)
+   {
+      queue_.push_back(queue_.back());
+      return;
+   }
+   
+   queue_.push_back(calculator_.requestFrame(timeSlice));
+   lastRequestedTimeSlice_ = timeSlice;
+}
@@ -0,0 +1,195 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_PREFETCHER_H_
+#define FRAME_PREFETCHER_H_
+
+#include <deque>
+
+#include <pthread.h>
+
+#include "AsyncFrameCalculator.h"
+
+namespace hdsim {
+   
+   class GPUInterpolatedModel;
+   
+   /**
+    * During the animation, timeslice of the next frame is fully predictable (GPUInterpolatedModel::getNextTimeSlice()), so there is no reason to wait for 
+    * the frame to be due before starting to calculate it. Prefetcher keeps bounded queue of the requests for the next frames on the AsyncFrameCalculator, 
+    * so that consumer (display, actuator output) pops frame that is normally already calculated.
+    *
+    * Queue is invalidated (pending requests cancelled and new ones made) whenever prediction is broken: timeslice is changed out of band (seek()), 
+    * animation parameters change (setAnimation()) or model geometry or rendered area change (setModel()). 
+    *
+    * All methods are thread safe, so UI thread could invalidate queue while other thread pops frames.
+    */
+   class FramePrefetcher {
+      
+   public:
+      
+      /**
+       * Constructor. Doesn't request anything until seek() is called
+       *
+       * @param model Model to calculate. Prefetcher works on its own clone of it
+       * @param depth Number of frames to keep requested ahead
+       */
+      FramePrefetcher(const GPUInterpolatedModel &model, int depth);
+      
+      /**
+       * Destructor. Cancels all pending requests
+       */
+      virtual ~FramePrefetcher();
+      
+      /**
+       * Set animation parameters. If they differ from the current ones, queue is invalidated and refilled after the last popped frame
+       *
+       * @param interframeDistance Distance between two frames of animation
+       * @param loop Should animation loop
+       */
+      virtual void setAnimation(double interframeDistance, bool loop);
+      
+      /**
+       * Invalidate queue and refill it so that the next popped frame is the one following currentTimeSlice
+       *
+       * @param currentTimeSlice Timeslice of the current frame
+       */
+      virtual void seek(double currentTimeSlice);
+      
+      /**
+       * Replace model (geometry, rendered area, drawing optimization), invalidating queue
+       *
+       * @param model New model. Prefetcher works on its own clone of it
+       */
+      virtual void setModel(const GPUInterpolatedModel &model);
+      
+      /**
+       * Pop next frame, waiting for it if it is not calculated yet. Request for one more frame is made, keeping queue full
+       *
+       * PRECONDITION: seek() must be called before first frame is popped
+       *
+       * @return Next frame of the animation
+       */
+      virtual FrameHandle popFrame();
+      
+      /**
+       * Drop next numFrames frames without waiting for them. Used when consumer is late and skips frames
+       *
+       * @param numFrames Number of frames to drop
+       */
+      virtual void skipFrames(int numFrames);
+      
+      /**
+       * Get number of frames kept requested ahead
+       *
+       * @return Depth of the queue
+       */
+      virtual int getDepth() const
+      {
+         return depth_;
+      }
+      
+      /**
+       * Get number of popped frames that were ready at the time of pop
+       *
+       * @return Number of hits
+       */
+      virtual long getNumHits() const;
+      
+      /**
+       * Get number of popped frames that consumer had to wait for
+       *
+       * @return Number of misses
+       */
+      virtual long getNumMisses() const;
+      
+      /**
+       * Get number of times queue was invalidated
+       *
+       * @return Number of invalidations
+       */
+      virtual long getNumInvalidations() const;
+      
+   private:
+      
+      // copying is not supported
+      FramePrefetcher(const FramePrefetcher &rhs);
+      FramePrefetcher &operator=(const FramePrefetcher &rhs);
+      
+      /**
+       * Cancel all queued requests and refill queue after currentTimeSlice. Must be called with mutex held
+       *
+       * @param currentTimeSlice Timeslice after which queue should start
+       */
+      void refill(double currentTimeSlice);
+      
+      /**
+       * Request frame following the last requested one. Must be called with mutex held
+       */
+      void requestNextFrame();
+      
+      /**
+       * Calculator doing the actual work
+       */
+      AsyncFrameCalculator calculator_;
+      
+      /**
+       * Number of frames kept requested ahead
+       */
+      int depth_;
+      
+      /**
+       * Animation parameters
+       */
+      double interframeDistance_;
+      bool loop_;
+      
+      /**
+       * Requested frames, in the order of the animation
+       */
+      std::deque<FrameFuture> queue_;
+      
+      /**
+       * Timeslice of the last requested frame
+       */
+      double lastRequestedTimeSlice_;
+      
+      /**
+       * Timeslice of the last popped frame (or of the frame we were seeked to)
+       */
+      double lastPoppedTimeSlice_;
+      
+      /**
+       * Was seek() called
+       */
+      bool wasSeeked_;
+      
+      /**
+       * Accounting
+       */
+      long numHits_, numMisses_, numInvalidations_;
+      
+      /**
+       * Guards all the state
+       */
+      mutable pthread_mutex_t mutex_;
+   };
+   
+} // namespace
+
+#endif
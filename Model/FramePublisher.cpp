@@ -0,0 +1,140 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sched.h>
+
+#include "FramePublisher.h"
+#include "SimpleDesignByContract.h"
+
+using namespace hdsim;
+using namespace std;
+
+FramePublisher::FramePublisher() : currentSlot_(-1), version_(0), numRecycledBuffers_(0)
+{
+   for (int i = 0; i < NUM_SLOTS; i++)
+      slots_[i].numReaders = 0;
+   
+   pthread_mutex_init(&mutex_, 0);
+}
+
+FramePublisher::~FramePublisher()
+{
+   pthread_mutex_destroy(&mutex_);
+}
+
+FrameHandle FramePublisher::getLatestFrame() const
+{
+   for (;;)
+   {
+      int slot = __sync_fetch_and_add(&currentSlot_, 0);
+      if (slot < 0)
+         return FrameHandle();
+      
+      // Announce ourselves, and then check that slot is still current. If it is, producer can't touch it until we are done
+      __sync_fetch_and_add(&slots_[slot].numReaders, 1);
+      
+      if (__sync_fetch_and_add(&currentSlot_, 0) == slot)
+      {
+         FrameHandle frame = slots_[slot].frame;
+         __sync_fetch_and_sub(&slots_[slot].numReaders, 1);
+         
+         return frame;
+      }
+      
+      // Newer frame was published in the meantime, try again with it
+      __sync_fetch_and_sub(&slots_[slot].numReaders, 1);
+   }
+}
+
+FrameHandle FramePublisher::acquireBuffer(int sizeX, int sizeY, double timeSlice)
+{
+   pthread_mutex_lock(&mutex_);
+   
+   FrameHandle frame;
+   int freeBuffer = -1;
+   
+   for (int i = 0; i < buffers_.size()  &&  !frame.isValid(); i++)
+   {
+      // Only we reference it, so nobody could be reading it
+      if (buffers_[i].getRefCount() == 1)
+      {
+         if (buffers_[i]->getSizeX() == sizeX  &&  buffers_[i]->getSizeY() == sizeY)
+            frame = buffers_[i];
+         else
+            freeBuffer = i;
+      }
+   }
+   
+   if (frame.isValid())
+   {
+      frame->timeSlice_ = timeSlice;
+      numRecycledBuffers_++;
+   }
+   else
+   {
+      frame = Frame::create(sizeX, sizeY, timeSlice);
+      
+      if (buffers_.size() < MAX_NUM_BUFFERS)
+         buffers_.push_back(frame);
+      else if (freeBuffer >= 0)
+         buffers_[freeBuffer] = frame;
+   }
+   
+   pthread_mutex_unlock(&mutex_);
+   
+   return frame;
+}
+
+void FramePublisher::publish(const FrameHandle &frame)
+{
+   PRECONDITION(frame.isValid());
+   
+   pthread_mutex_lock(&mutex_);
+   
+   // Find slot that is not current and that no reader is looking at. Readers hold the slot only while they copy the handle, so this wait is short
+   int current = currentSlot_;
+   int slot = -1;
+   
+   while (slot == -1)
+   {
+      for (int i = 0; i < NUM_SLOTS  &&  slot == -1; i++)
+         if (i != current  &&  __sync_fetch_and_add(&slots_[i].numReaders, 0) == 0)
+            slot = i;
+      
+      if (slot == -1)
+         sched_yield();
+   }
+   
+   slots_[slot].frame = frame;
+   
+   // Full barrier, so that frame is in the slot before the slot becomes current
+   __sync_synchronize();
+   __sync_lock_test_and_set(&currentSlot_, slot);
+   __sync_fetch_and_add(&version_, 1);
+   
+   pthread_mutex_unlock(&mutex_);
+}
+
+long FramePublisher::getNumRecycledBuffers() const
+{
+   pthread_mutex_lock(&mutex_);
+   long numRecycledBuffers = numRecycledBuffers_;
+   pthread_mutex_unlock(&mutex_);
+   
+   return numRecycledBuffers;
+}
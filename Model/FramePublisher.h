@@ -0,0 +1,159 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_PUBLISHER_H_
+#define FRAME_PUBLISHER_H_
+
+#include <vector>
+
+#include <pthread.h>
+
+#include "Frame.h"
+
+namespace hdsim {
+   
+   /**
+    * Publishes the latest calculated frame to any number of concurrent readers (drawing, actuator sinks, recorders, validators). Readers get immutable
+    * frame that stays consistent for as long as they hold it, while the producer calculates the next frame into a recycled buffer.
+    *
+    * Reading (getLatestFrame()) takes no locks: published frames live in a small ring of slots, and reader only announces itself on the slot while it copies
+    * the handle. Producer never overwrites the current slot or the slot with announced readers, so readers never see torn frames. Producers serialize on
+    * the mutex, which is never taken by the readers.
+    */
+   class FramePublisher {
+      
+   public:
+      
+      /**
+       * Number of slots in the ring of published frames
+       */
+      static const int NUM_SLOTS = 4;
+      
+      /**
+       * Max number of frames kept for recycling
+       */
+      static const int MAX_NUM_BUFFERS = 8;
+      
+      /**
+       * Constructor
+       */
+      FramePublisher();
+      
+      /**
+       * Destructor
+       */
+      virtual ~FramePublisher();
+      
+      /**
+       * Get latest published frame. Lock free and safe to call from any thread
+       *
+       * @return Latest frame, or invalid handle if nothing was published yet
+       */
+      virtual FrameHandle getLatestFrame() const;
+      
+      /**
+       * Get number of frames published so far. Readers could poll this to find out is there new frame without taking the frame
+       *
+       * @return Number of published frames
+       */
+      virtual long getVersion() const
+      {
+         return __sync_fetch_and_add(&version_, 0);
+      }
+      
+      /**
+       * Get buffer to calculate the next frame into. Buffer is either recycled frame that nobody references any more, or new frame. Values of the 
+       * recycled frame are not cleared
+       *
+       * @param sizeX Size of the frame in X direction
+       * @param sizeY Size of the frame in Y direction
+       * @param timeSlice Timeslice of the frame
+       *
+       * @return Frame that nobody else references
+       */
+      virtual FrameHandle acquireBuffer(int sizeX, int sizeY, double timeSlice);
+      
+      /**
+       * Publish frame. Frame must not be changed after it is published
+       *
+       * @param frame Frame to publish
+       */
+      virtual void publish(const FrameHandle &frame);
+      
+      /**
+       * Get number of buffers that were recycled instead of allocated
+       *
+       * @return Number of recycled buffers
+       */
+      virtual long getNumRecycledBuffers() const;
+      
+   private:
+      
+      // copying is not supported
+      FramePublisher(const FramePublisher &rhs);
+      FramePublisher &operator=(const FramePublisher &rhs);
+      
+      /**
+       * Slot holding one published frame
+       */
+      struct Slot {
+         /**
+          * Published frame
+          */
+         FrameHandle frame;
+         
+         /**
+          * Number of readers that are copying the frame right now
+          */
+         volatile long numReaders;
+      };
+      
+      /**
+       * Ring of the published frames
+       */
+      mutable Slot slots_[NUM_SLOTS];
+      
+      /**
+       * Index of the slot with the latest frame, or -1
+       */
+      mutable volatile int currentSlot_;
+      
+      /**
+       * Number of published frames
+       */
+      mutable volatile long version_;
+      
+      /**
+       * Frames owned by the publisher, recycled once nobody else references them
+       */
+      std::vector<FrameHandle> buffers_;
+      
+      /**
+       * Number of recycled buffers
+       */
+      long numRecycledBuffers_;
+      
+      /**
+       * Serializes producers
+       */
+      mutable pthread_mutex_t mutex_;
+   };
+   
+} // namespace
+
+#endif
@@ -74,6 +74,9 @@
 #include <OpenGL/gl.h>
 #include <OpenGL/glu.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <string>
 #include <iostream>
 #include <fstream>
@@ -92,7 +95,9 @@ using namespace std;
 // Default shader to use if no other is available. It must exist in current working directory
 static const char *NULL_SHADER_NAME = "./NullOpFragmentShader.fs";
 
-GPUCalculationEngine::GPUCalculationEngine() : wasInitialized_(false), width_(0), height_(0), renderedDepth_(0), timeSlice_(0)
+GPUCalculationEngine::GPUCalculationEngine() : wasInitialized_(false), width_(0), height_(0), renderedDepth_(0), timeSlice_(0), 
+                                               frameCache_(FrameCache::getSharedCache()), renderStateValid_(false), numShifts_(0), 
+                                               numEditUpdates_(0)
 {
 }
 
@@ -102,6 +107,11 @@ GPUCalculationEngine::~GPUCalculationEngine()
    {
    	destroyFrameBuffer();
    }
+   else
+   {
+      // Could be allocated for the frame found in the cache
+      delete [] renderedDepth_;
+   }
 }
 
 bool GPUCalculationEngine::getPathToShaderFileAdopt(const GPUGeometryModel *model, std::string *path) const
@@ -127,36 +137,159 @@ bool GPUCalculationEngine::getPathToShaderFileAdopt(const GPUGeometryModel *mode
    return true;
 }
 
-void GPUCalculationEngine::calculateEngine(const AbstractModel *model) 
+void GPUCalculationEngine::readValues(float *values) const
 {
-   PRECONDITION(model);
+   PRECONDITION(renderedDepth_);
+   memcpy(values, renderedDepth_, width_ * height_ * sizeof(GLfloat));
+}
+
+bool GPUCalculationEngine::readFromFrameCache(const GPUGeometryModel *model, const FrameCacheKey &key)
+{
+   FrameHandle frame = frameCache_->find(key);
+   if (!frame.isValid())
+      return false;
    
-   CGLContextObj currenCGLContext;
+   int width = model->getSizeX(), height = model->getSizeY();
+   CHECK(frame->getSizeX() == width  &&  frame->getSizeY() == height, "Cached frame doesn't match the model");
    
-   if (!saveOpenGLState(&currenCGLContext))
+   // Before the first calculation we don't have the buffer yet
+   if (!renderedDepth_  ||  width != width_  ||  height != height_)
    {
-      cerr << "Error saving CGL Context" << endl;
-      return;
+      CHECK(!wasInitialized_, "Model size changed after calculation engine initialization");
+      
+      delete [] renderedDepth_;
+      renderedDepth_ = new GLfloat[width * height];
+      width_ = width;
+      height_ = height;
    }
-     
-   if (!wasInitialized_)
+   
+   memcpy(renderedDepth_, frame->getValues(), width * height * sizeof(GLfloat));
+   
+   return true;
+}
+
+/**
+ * Draw all triangles of the model
+ *
+ * @param geometryModel Model to draw
+ */
+static void drawTriangles(const GPUGeometryModel *geometryModel)
+{
+   // This might benefit from the display list approach
+   // Orientation is counterclockwise here
+   glBegin(GL_TRIANGLES);
+
+   for (int indexTriangle = 0; indexTriangle < geometryModel->getNumTriangles(); indexTriangle++)
    {
-      currenCGLContext = CGLGetCurrentContext();
-      initialize(model);
-	}      
+      TriangleByPointIndexes triangle = geometryModel->getTriangle(indexTriangle);
+      
+      Point point = geometryModel->getPoint(triangle.getIndex1());
+      glVertex3d(point.getX(), point.getY(), point.getZ());
+      
+      point = geometryModel->getPoint(triangle.getIndex2());
+      glVertex3d(point.getX(), point.getY(), point.getZ());
+
+      point = geometryModel->getPoint(triangle.getIndex3());
+      glVertex3d(point.getX(), point.getY(), point.getZ());
+   }
+   glEnd();
+   CHECK(!getAndResetGLErrorStatus(), "Error in glEnd");
+}
+
+GPUCalculationEngine::RenderState GPUCalculationEngine::getRenderState(const GPUGeometryModel *model) const
+{
+   RenderState state;
    
-   const GPUGeometryModel *geometryModel = dynamic_cast<const GPUGeometryModel *>(model);
-   CHECK(geometryModel, "This calculation engine operates only with the geometry model");
+   state.geometryFingerprint = model->getGeometryFingerprint();
+   state.shaderFingerprint = model->getShaderFingerprint();
+   state.timeSlice = getTimeSlice();
+   state.sizeX = model->getSizeX();
+   state.sizeY = model->getSizeY();
+   state.minX = model->getRenderedAreaMinX();
+   state.maxX = model->getRenderedAreaMaxX();
+   state.minY = model->getRenderedAreaMinY();
+   state.maxY = model->getRenderedAreaMaxY();
+   state.minZ = model->getRenderedAreaMinZ();
+   state.maxZ = model->getRenderedAreaMaxZ();
    
-   CGLError error = CGLSetCurrentContext(cglContext_);
-   if (error != kCGLNoError)
+   return state;
+}
+
+bool GPUCalculationEngine::getShift(const RenderState &state, int *shiftX, int *shiftY) const
+{
+   // Tolerance in moxels
+   const double DELTA = 1e-6;
+   
+   // Shader depends only on the timeslice, so the same shader at the same timeslice gives the same values for the same geometry
+   const RenderState &old = renderState_;
+   
+   if (old.geometryFingerprint != state.geometryFingerprint  ||  old.shaderFingerprint != state.shaderFingerprint  ||  old.timeSlice != state.timeSlice  ||
+       old.sizeX != state.sizeX  ||  old.sizeY != state.sizeY  ||  old.minZ != state.minZ  ||  old.maxZ != state.maxZ  ||  !state.sizeX  ||  !state.sizeY)
+      return false;
+   
+   double moxelX = (old.maxX - old.minX) / old.sizeX, moxelY = (old.maxY - old.minY) / old.sizeY;
+   
+   if (fabs((state.maxX - state.minX) / state.sizeX - moxelX) > DELTA * fabs(moxelX)  ||  
+       fabs((state.maxY - state.minY) / state.sizeY - moxelY) > DELTA * fabs(moxelY)  ||  moxelX == 0  ||  moxelY == 0)
+      return false;
+   
+   double x = (state.minX - old.minX) / moxelX, y = (state.minY - old.minY) / moxelY;
+   double roundedX = floor(x + 0.5), roundedY = floor(y + 0.5);
+   
+   if (fabs(x - roundedX) > DELTA  ||  fabs(y - roundedY) > DELTA)
+      return false;
+   
+   *shiftX = (int)roundedX;
+   *shiftY = (int)roundedY;
+   
+   return true;
+}
+
+void GPUCalculationEngine::shift(int shiftX, int shiftY)
+{
+   TileRange all = {0, width_, 0, height_};
+   
+   if (abs(shiftX) >= width_  ||  abs(shiftY) >= height_)
    {
-      stringstream message;
-      message << "Error in setting CGL context " << CGLErrorString(error);
-      LOG(message.str().c_str());
+      regions_.push_back(all);
       return;
    }
+   
+   // Rows are moved in the order that doesn't overwrite rows not moved yet, memmove handles the overlap inside the row
+   int width = width_ - abs(shiftX);
+   int destinationX = max(-shiftX, 0), sourceX = max(shiftX, 0);
+   
+   if (shiftY >= 0)
+   {
+      for (int y = 0; y < height_ - shiftY; y++)
+         memmove(&renderedDepth_[y * width_ + destinationX], &renderedDepth_[(y + shiftY) * width_ + sourceX], width * sizeof(GLfloat));
+   }
+   else
+   {
+      for (int y = height_ - 1; y >= -shiftY; y--)
+         memmove(&renderedDepth_[y * width_ + destinationX], &renderedDepth_[(y + shiftY) * width_ + sourceX], width * sizeof(GLfloat));
+   }
+   
+   // Newly exposed rows over the whole width, and newly exposed columns in the rest of the rows
+   int beginY = max(-shiftY, 0), endY = height_ - max(shiftY, 0);
+   
+   if (shiftY)
+   {
+      TileRange rows = {0, width_, shiftY > 0 ? endY : 0, shiftY > 0 ? height_ : beginY};
+      regions_.push_back(rows);
+   }
+   
+   if (shiftX)
+   {
+      TileRange columns = {shiftX > 0 ? width_ - shiftX : 0, shiftX > 0 ? width_ : -shiftX, beginY, endY};
+      regions_.push_back(columns);
+   }
+   
+   numShifts_++;
+}
 
+bool GPUCalculationEngine::render(const GPUGeometryModel *geometryModel)
+{
    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, frameBufferID_);
    CHECK(!getAndResetGLErrorStatus(), "Error binding frameBuffer");
 
@@ -170,11 +303,10 @@ void GPUCalculationEngine::calculateEngine(const AbstractModel *model)
       
       cerr << "Error in calculateEngine's glCheckFramebufferStatusEXT, FBO status " <<  status << "glError: " << err << " detail: " << reinterpret_cast<const char *>(gluErrorString(err)) << endl;
       
-      // Try to restore everything, and cleanup errors
+      // Try to cleanup errors
       glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
       getAndResetGLErrorStatus();
-      restoreOpenGLState(currenCGLContext);
-      return;
+      return false;
    }
 
    glMatrixMode(GL_PROJECTION);
@@ -198,11 +330,10 @@ void GPUCalculationEngine::calculateEngine(const AbstractModel *model)
 
    if (getAndResetGLErrorStatus())
    {
-      // Try to restore everything, and cleanup errors
+      // Try to cleanup errors
       glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
       getAndResetGLErrorStatus();
-      restoreOpenGLState(currenCGLContext);
-      return;
+      return false;
    }
    
    glMatrixMode(GL_MODELVIEW);
@@ -224,38 +355,142 @@ void GPUCalculationEngine::calculateEngine(const AbstractModel *model)
    glViewport(0, 0, geometryModel->getSizeX(), geometryModel->getSizeY());
    CHECK(!getAndResetGLErrorStatus(), "Failed to setup viewport so that one rod matches one pixel");   
 
-   status = prepareForDepthBufferDrawing();
-   CHECK(status, "Preparation for drawing to depth buffer failed");
+   // Each region is cleared, drawn and read back on its own, straight into its place in the rendered depth buffer
+   glEnable(GL_SCISSOR_TEST);
+   glPixelStorei(GL_PACK_ROW_LENGTH, width_);
+   CHECK(!getAndResetGLErrorStatus(), "Error setting up region rendering");
    
-   // All bound, now lets go ahead and draw
-   // This might benefit from the display list approach
-   // Orientation is counterclockwise here
-   glBegin(GL_TRIANGLES);
-
-   for (int indexTriangle = 0; indexTriangle < geometryModel->getNumTriangles(); indexTriangle++)
+   for (int i = 0; i < regions_.size(); i++)
    {
-      TriangleByPointIndexes triangle = geometryModel->getTriangle(indexTriangle);
+      const TileRange &range = regions_[i];
+      int width = range.endX - range.beginX, height = range.endY - range.beginY;
       
-      Point point = geometryModel->getPoint(triangle.getIndex1());
-      glVertex3d(point.getX(), point.getY(), point.getZ());
+      if (width <= 0  ||  height <= 0)
+         continue;
       
-      point = geometryModel->getPoint(triangle.getIndex2());
-      glVertex3d(point.getX(), point.getY(), point.getZ());
-
-      point = geometryModel->getPoint(triangle.getIndex3());
-      glVertex3d(point.getX(), point.getY(), point.getZ());
+      glScissor(range.beginX, range.beginY, width, height);
+      CHECK(!getAndResetGLErrorStatus(), "Error in glScissor");
+      
+      status = prepareForDepthBufferDrawing();
+      CHECK(status, "Preparation for drawing to depth buffer failed");
+      
+      drawTriangles(geometryModel);
+      
+      glReadPixels(range.beginX, range.beginY, width, height, GL_DEPTH_COMPONENT, GL_FLOAT, renderedDepth_ + range.beginY * width_ + range.beginX);   
+      CHECK(!getAndResetGLErrorStatus(), "Error in glReadPixels");
    }
-   glEnd();
-   CHECK(!getAndResetGLErrorStatus(), "Error in glEnd");
    
-   glReadPixels(0, 0, width_, height_, GL_DEPTH_COMPONENT, GL_FLOAT, renderedDepth_);   
-   CHECK(!getAndResetGLErrorStatus(), "Error in glReadPixels");
+   glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+   glDisable(GL_SCISSOR_TEST);
+   CHECK(!getAndResetGLErrorStatus(), "Error resetting region rendering");
    
    CHECK(shader_.setShaderActive(false), "Can't reset shader");
    
    // Unbind frame buffer so that we could do rendering to different windows
    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
    CHECK(!getAndResetGLErrorStatus(), "Error binding frameBuffer");
+   
+   return true;
+}
+
+void GPUCalculationEngine::getTriangleBounds(const GPUGeometryModel *model, int index, TileRange *bounds) const
+{
+   const RenderState &state = renderState_;
+   
+   if (state.maxX <= state.minX  ||  state.maxY <= state.minY)
+   {
+      TileRange all = {0, width_, 0, height_};
+      *bounds = all;
+      return;
+   }
+   
+   const TriangleByPointIndexes &triangle = model->getTriangle(index);
+   const Point &a = model->getPoint(triangle.getIndex1());
+   const Point &b = model->getPoint(triangle.getIndex2());
+   const Point &c = model->getPoint(triangle.getIndex3());
+   
+   double scaleX = width_ / (state.maxX - state.minX), scaleY = height_ / (state.maxY - state.minY);
+   double minX = (min(a.getX(), min(b.getX(), c.getX())) - state.minX) * scaleX;
+   double maxX = (max(a.getX(), max(b.getX(), c.getX())) - state.minX) * scaleX;
+   double minY = (min(a.getY(), min(b.getY(), c.getY())) - state.minY) * scaleY;
+   double maxY = (max(a.getY(), max(b.getY(), c.getY())) - state.minY) * scaleY;
+   
+   // Moxel is covered if its center is inside the triangle, one more moxel on each side keeps the bounds conservative
+   bounds->beginX = (int)max(0.0, min((double)width_, floor(minX) - 1));
+   bounds->endX = (int)max(0.0, min((double)width_, ceil(maxX) + 1));
+   bounds->beginY = (int)max(0.0, min((double)height_, floor(minY) - 1));
+   bounds->endY = (int)max(0.0, min((double)height_, ceil(maxY) + 1));
+}
+
+void GPUCalculationEngine::updateTriangleBounds(const GPUGeometryModel *model)
+{
+   triangleBounds_.resize(model->getNumTriangles());
+   
+   for (int i = 0; i < triangleBounds_.size(); i++)
+      getTriangleBounds(model, i, &triangleBounds_[i]);
+}
+
+void GPUCalculationEngine::calculateRegions(const GPUGeometryModel *geometryModel, const RenderState &state)
+{
+   // Values are partially rendered until rendering succeeds
+   renderStateValid_ = false;
+   
+   FrameCacheKey frameCacheKey;
+   
+   if (frameCache_)
+   {
+      frameCacheKey = frameCache_->makeKey(geometryModel->getAnimationCacheKey(), getTimeSlice());
+      
+      if (readFromFrameCache(geometryModel, frameCacheKey))
+      {
+         renderState_ = state;
+         renderStateValid_ = true;
+         return;
+      }
+   }
+   
+   CGLContextObj currenCGLContext;
+   
+   if (!saveOpenGLState(&currenCGLContext))
+   {
+      cerr << "Error saving CGL Context" << endl;
+      return;
+   }
+     
+   if (!wasInitialized_)
+   {
+      currenCGLContext = CGLGetCurrentContext();
+      initialize(geometryModel);
+      
+      // Values were in the buffer that was replaced
+      TileRange all = {0, width_, 0, height_};
+      regions_.assign(1, all);
+	}      
+   
+   CGLError error = CGLSetCurrentContext(cglContext_);
+   if (error != kCGLNoError)
+   {
+      stringstream message;
+      message << "Error in setting CGL context " << CGLErrorString(error);
+      LOG(message.str().c_str());
+      return;
+   }
+   
+   if (!render(geometryModel))
+   {
+      restoreOpenGLState(currenCGLContext);
+      return;
+   }
+   
+   renderState_ = state;
+   renderStateValid_ = true;
+   
+   if (frameCache_)
+   {
+      FrameHandle frame = Frame::create(width_, height_, getTimeSlice());
+      memcpy(frame->getMutableValues(), renderedDepth_, width_ * height_ * sizeof(GLfloat));
+      frameCache_->insert(frameCacheKey, frame);
+   }
   
    if (!restoreOpenGLState(currenCGLContext))
    {
@@ -263,6 +498,119 @@ void GPUCalculationEngine::calculateEngine(const AbstractModel *model)
    }
 }
 
+void GPUCalculationEngine::calculateEngine(const AbstractModel *model) 
+{
+   PRECONDITION(model);
+   
+   const GPUGeometryModel *geometryModel = dynamic_cast<const GPUGeometryModel *>(model);
+   CHECK(geometryModel, "This calculation engine operates only with the geometry model");
+   
+   RenderState state = getRenderState(geometryModel);
+   int shiftX = 0, shiftY = 0;
+   bool keepValues = renderStateValid_  &&  getShift(state, &shiftX, &shiftY);
+   
+   // Nothing changed since the last calculation
+   if (keepValues  &&  !shiftX  &&  !shiftY)
+      return;
+   
+   regions_.clear();
+   
+   if (keepValues)
+   {
+      shift(shiftX, shiftY);
+   }
+   else
+   {
+      TileRange all = {0, width_, 0, height_};
+      regions_.push_back(all);
+   }
+   
+   calculateRegions(geometryModel, state);
+   
+   // Bounds are relative to the rendered area, so they are found again even if it only moved
+   renderState_ = state;
+   updateTriangleBounds(geometryModel);
+}
+
+void GPUCalculationEngine::calculateEdits(const AbstractModel *model, const vector<int> &editedPoints, const vector<int> &editedTriangles)
+{
+   PRECONDITION(model);
+   
+   const GPUGeometryModel *geometryModel = dynamic_cast<const GPUGeometryModel *>(model);
+   CHECK(geometryModel, "This calculation engine operates only with the geometry model");
+   
+   // Everything but the geometry has to be the same as in the last calculation
+   RenderState state = getRenderState(geometryModel);
+   RenderState unedited = state;
+   unedited.geometryFingerprint = renderState_.geometryFingerprint;
+   
+   int shiftX = 0, shiftY = 0;
+   int numPoints = geometryModel->getNumPoints(), numTriangles = geometryModel->getNumTriangles(), oldNumTriangles = triangleBounds_.size();
+   
+   if (!wasInitialized_  ||  !renderStateValid_  ||  !getShift(unedited, &shiftX, &shiftY)  ||  shiftX  ||  shiftY  ||  numTriangles < oldNumTriangles)
+   {
+      calculateEngine(model);
+      return;
+   }
+   
+   // Triangles using the edited points, edited themselves or added. Triangles that weren't edited still use the same points
+   pointEdited_.assign(numPoints, 0);
+   for (int i = 0; i < editedPoints.size(); i++)
+      if (editedPoints[i] < numPoints)
+         pointEdited_[editedPoints[i]] = 1;
+   
+   affectedTriangles_.clear();
+   
+   for (int i = 0; i < oldNumTriangles; i++)
+   {
+      const TriangleByPointIndexes &triangle = geometryModel->getTriangle(i);
+      
+      if (pointEdited_[triangle.getIndex1()]  ||  pointEdited_[triangle.getIndex2()]  ||  pointEdited_[triangle.getIndex3()])
+         affectedTriangles_.push_back(i);
+   }
+   
+   for (int i = 0; i < editedTriangles.size(); i++)
+      if (editedTriangles[i] < oldNumTriangles)
+         affectedTriangles_.push_back(editedTriangles[i]);
+   
+   for (int i = oldNumTriangles; i < numTriangles; i++)
+      affectedTriangles_.push_back(i);
+   
+   // Old and new bounding rectangles of the affected triangles
+   triangleBounds_.resize(numTriangles);
+   regions_.clear();
+   
+   for (int i = 0; i < affectedTriangles_.size(); i++)
+   {
+      int index = affectedTriangles_[i];
+      
+      if (index < oldNumTriangles)
+         regions_.push_back(triangleBounds_[index]);
+      
+      getTriangleBounds(geometryModel, index, &triangleBounds_[index]);
+      regions_.push_back(triangleBounds_[index]);
+   }
+   
+   // Every region draws all triangles, so with many of them the one rectangle around all is cheaper
+   if (regions_.size() > MAX_EDIT_REGIONS)
+   {
+      TileRange all = regions_[0];
+      
+      for (int i = 1; i < regions_.size(); i++)
+      {
+         all.beginX = min(all.beginX, regions_[i].beginX);
+         all.endX = max(all.endX, regions_[i].endX);
+         all.beginY = min(all.beginY, regions_[i].beginY);
+         all.endY = max(all.endY, regions_[i].endY);
+      }
+      
+      regions_.assign(1, all);
+   }
+   
+   calculateRegions(geometryModel, state);
+   numEditUpdates_++;
+}
+
 bool GPUCalculationEngine::initFrameBuffer(int width, int height) 
 {
    PRECONDITION(width > 0  &&  height > 0);
@@ -285,6 +633,9 @@ bool GPUCalculationEngine::destroyFrameBuffer()
    PRECONDITION(wasInitialized_);
 
    delete [] renderedDepth_;
+   renderedDepth_ = 0;
+   renderStateValid_ = false;
+   
    return destroyOpenGLOffScreenRender(cglContext_, frameBufferID_, colorBufferID_, depthBufferID_);
 }
 
@@ -299,7 +650,9 @@ void GPUCalculationEngine::initialize(const AbstractModel *model)
    height_ = geometryModel->getSizeY();
    
    // Now we need to extract calculated Z buffer
+   delete [] renderedDepth_;
    renderedDepth_ = new GLfloat[width_ * height_];
+   renderStateValid_ = false;
    
    bool status = initFrameBuffer(geometryModel->getSizeX(), geometryModel->getSizeY());
    CHECK(status, "Can't initialize frame buffer");
@@ -20,19 +20,26 @@
 #define GPU_CALCULATION_ENGINE_H_
 
 #include <string>
+#include <vector>
 
 #include <OpenGL/gl.h>
 #include <OpenGL/glu.h>
 #include <OpenGL/OpenGL.h>
 
 #include "AbstractModel.h"
+#include "FrameCache.h"
 #include "GPUGeometryModel.h"
 #include "Shader.h"
+#include "ThreadPool.h"
 
 namespace hdsim {
 
    /**
     * Uses frame buffer object to perform GPU based calculation
+    *
+    * If the rendered area only moved by whole moxels since the last calculation, with the same geometry, shader and timeslice, calculated values
+    * are shifted with it and only the newly exposed strips are rendered and read back. If only some points and triangles were edited, only the
+    * rectangles the edited triangles covered before and after the edits are rendered and read back
     */ 
 	class GPUCalculationEngine {
    
@@ -51,6 +58,18 @@ namespace hdsim {
           */
 		   virtual void calculateEngine(const AbstractModel *model);
       
+         /**
+          * Calculate positions for the given model, when only the given points and triangles were edited since the last calculation. If anything
+          * else changed, the whole model is calculated
+          *
+          * This function is not thread safe
+          *
+          * @param model Calculate picture for engine position
+          * @param editedPoints Indexes of the edited points
+          * @param editedTriangles Indexes of the edited triangles
+          */
+         virtual void calculateEdits(const AbstractModel *model, const std::vector<int> &editedPoints, const std::vector<int> &editedTriangles);
+      
       	/**
           * Initialization
           *
@@ -76,6 +95,23 @@ namespace hdsim {
             return renderedDepth_[y*width_ + x];
          }
       
+         /**
+          * Copy all previously calculated values
+          *
+          * @param values (OUT) Values, stored so that [x][y] corresponds to [y * width + x]
+          */
+         virtual void readValues(float *values) const;
+      
+         /**
+          * Previously calculated values, without copying them
+          *
+          * @return Values, stored so that [x][y] corresponds to [y * width + x]
+          */
+         const float *getValues() const
+         {
+            return renderedDepth_;
+         }
+      
          /**
           * Should we load shader from bundle
           *
@@ -105,6 +141,46 @@ namespace hdsim {
           * @return Was conversion success
           */
       virtual bool getPathToShaderFileAdopt(const GPUGeometryModel *model, std::string *path) const;
+      
+         /**
+          * Set cache of the calculated frames. Frames found in the cache are not recalculated, and calculated frames are added to it
+          *
+          * @param cache Cache to use, or 0 to always calculate. Caller retains ownership. By default, FrameCache::getSharedCache() is used
+          */
+         virtual void setFrameCache(FrameCache *cache)
+         {
+            frameCache_ = cache;
+         }
+      
+         /**
+          * Get cache of the calculated frames
+          *
+          * @return Cache, or 0 if there is none
+          */
+         virtual FrameCache *getFrameCache() const
+         {
+            return frameCache_;
+         }
+      
+         /**
+          * Get number of times values were shifted because rendered area moved by whole moxels
+          *
+          * @return Number of shifts
+          */
+         virtual long getNumShifts() const
+         {
+            return numShifts_;
+         }
+      
+         /**
+          * Get number of calculations that rendered only the regions of the edited triangles
+          *
+          * @return Number of edit updates
+          */
+         virtual long getNumEditUpdates() const
+         {
+            return numEditUpdates_;
+         }
 
    	private:
                
@@ -131,6 +207,92 @@ namespace hdsim {
           */
          void calculate(const GPUGeometryModel *model);
       
+         /**
+          * Copy frame from the frame cache into the rendered depth buffer
+          *
+          * @param model Model we are calculating
+          * @param key Key of the frame
+          *
+          * @return Was frame found in the cache
+          */
+         bool readFromFrameCache(const GPUGeometryModel *model, const FrameCacheKey &key);
+      
+         /**
+          * What the rendered depth buffer was calculated from
+          */
+         struct RenderState {
+            unsigned long long geometryFingerprint, shaderFingerprint;
+            double timeSlice;
+            int sizeX, sizeY;
+            double minX, maxX, minY, maxY, minZ, maxZ;
+         };
+      
+         /**
+          * Get state the model would be rendered from
+          *
+          * @param model Model we are calculating
+          *
+          * @return Render state
+          */
+         RenderState getRenderState(const GPUGeometryModel *model) const;
+      
+         /**
+          * Find is the new state the one values were rendered from, with the rendered area moved by whole moxels in X and Y, and by how many
+          *
+          * @param state New state
+          * @param shiftX (OUT) Moxels the rendered area moved in X direction
+          * @param shiftY (OUT) Moxels the rendered area moved in Y direction
+          *
+          * @return Could values be shifted to the new state
+          */
+         bool getShift(const RenderState &state, int *shiftX, int *shiftY) const;
+      
+         /**
+          * Shift values so that moxel (x, y) gets the value of moxel (x + shiftX, y + shiftY), and add strips that have no values to the regions
+          *
+          * @param shiftX Moxels to shift in X direction
+          * @param shiftY Moxels to shift in Y direction
+          */
+         void shift(int shiftX, int shiftY);
+      
+         /**
+          * Render the regions of the model and read them back into the rendered depth buffer. Rest of the buffer is kept
+          *
+          * @param model Model we are calculating
+          *
+          * @return Was rendering successful
+          */
+         bool render(const GPUGeometryModel *model);
+      
+         /**
+          * Render the regions of the model, unless the frame is found in the cache, and remember the state values were calculated from
+          *
+          * @param model Model we are calculating
+          * @param state State the model is rendered from
+          */
+         void calculateRegions(const GPUGeometryModel *model, const RenderState &state);
+      
+         /**
+          * Get moxels that the triangle could cover in the rendered area of the last calculation
+          *
+          * @param model Model we are calculating
+          * @param index Index of the triangle
+          * @param bounds (OUT) Bounds of the triangle, possibly empty
+          */
+         void getTriangleBounds(const GPUGeometryModel *model, int index, TileRange *bounds) const;
+      
+         /**
+          * Find bounds of all triangles
+          *
+          * @param model Model we are calculating
+          */
+         void updateTriangleBounds(const GPUGeometryModel *model);
+      
+         /**
+          * Max number of regions rendered for the edits. With more regions than that, one rectangle around all of them is rendered instead
+          */
+         static const int MAX_EDIT_REGIONS = 16;
+      
          /**
           * IDs of the current render buffer and frame buffer objects used
           */
@@ -165,6 +327,38 @@ namespace hdsim {
           * Timeslice value
           */
 	      double timeSlice_;
+      
+         /**
+          * Cache of the calculated frames, or 0
+          */
+         FrameCache *frameCache_;
+      
+         /**
+          * State values were rendered from, and is it valid
+          */
+         RenderState renderState_;
+         bool renderStateValid_;
+      
+         /**
+          * Regions of the board rendered by the next calculation
+          */
+         std::vector<TileRange> regions_;
+      
+         /**
+          * Bounds of the triangles in the last calculation, so that the rectangles edited triangles covered before the edits are known
+          */
+         std::vector<TileRange> triangleBounds_;
+      
+         /**
+          * Flags of the edited points and triangles affected by the edits, used by calculateEdits()
+          */
+         std::vector<unsigned char> pointEdited_;
+         std::vector<int> affectedTriangles_;
+      
+         /**
+          * Statistics
+          */
+         long numShifts_, numEditUpdates_;
 	};
    
 }
@@ -18,11 +18,18 @@
 
 #include <string>
 #include <fstream>
+#include <cstring>
 
 #include "GPUGeometryModel.h"
 #include "Collada.h"
 #include "SimpleDesignByContract.h"
 #include "GPUCalculationEngine.h"
+#include "FramePublisher.h"
+#include "TiledDepthEngine.h"
+#include "UpsampledDepthEngine.h"
+#include "SparseFrame.h"
+#include "PreciseDelay.h"
+#include "Hash.h"
 
 using namespace hdsim;
 using namespace std;
@@ -38,7 +45,10 @@ GPUGeometryModel::GPUGeometryModel() : sizeX_(0), sizeY_(0), boundMinX_(0), boun
 													boundMinY_(0), boundMaxY_(0), boundMinZ_(0), boundMaxZ_(0),
 												   renderedAreaMinX_(0), renderedAreaMinY_(0), renderedAreaMaxX_(0), 
 													renderedAreaMaxY_(0), renderedAreaMinZ_(0), renderedAreaMaxZ_(0), 
-													calculationEngine_(0), changedSinceLastRecalc_(true)
+													calculationEngine_(0), tiledEngine_(0), upsampledEngine_(0), refinementBudget_(0), calculationDeadline_(0),
+                                          regionOfInterest_(0), sparseFrame_(0), sparseFrameValid_(false), editsTracked_(false), changedSinceLastRecalc_(true),
+                                          animationCache_(0), framePublisher_(0), geometryFingerprint_(0), shaderFingerprint_(0), 
+                                          geometryFingerprintValid_(false), shaderFingerprintValid_(false)
 {
    calculationEngine_ = new GPUCalculationEngine();
 }
@@ -50,7 +60,10 @@ GPUGeometryModel::GPUGeometryModel(int sizeX, int sizeY) : sizeX_(sizeX), sizeY_
                                                            renderedAreaMinX_(0), renderedAreaMinY_(0),
                                                            renderedAreaMaxX_(0), renderedAreaMaxY_(0), 
 																			  renderedAreaMinZ_(0), renderedAreaMaxZ_(0), 
-																			  calculationEngine_(0), changedSinceLastRecalc_(true)
+																			  calculationEngine_(0), tiledEngine_(0), upsampledEngine_(0), refinementBudget_(0), calculationDeadline_(0),
+                                          regionOfInterest_(0), sparseFrame_(0), sparseFrameValid_(false), editsTracked_(false), changedSinceLastRecalc_(true),
+                                          animationCache_(0), framePublisher_(0), geometryFingerprint_(0), shaderFingerprint_(0), 
+                                          geometryFingerprintValid_(false), shaderFingerprintValid_(false)
 {
    calculationEngine_ = new GPUCalculationEngine();
 }
@@ -62,7 +75,10 @@ GPUGeometryModel::GPUGeometryModel(const GPUGeometryModel &rhs) : sizeX_(0), siz
 																						renderedAreaMinX_(0), renderedAreaMinY_(0),
 																						renderedAreaMaxX_(0), renderedAreaMaxY_(0), 
 																						renderedAreaMinZ_(0), renderedAreaMaxZ_(0), 
-																						calculationEngine_(0), changedSinceLastRecalc_(true)
+																						calculationEngine_(0), tiledEngine_(0), upsampledEngine_(0), refinementBudget_(0), calculationDeadline_(0),
+                                          regionOfInterest_(0), sparseFrame_(0), sparseFrameValid_(false), editsTracked_(false), changedSinceLastRecalc_(true),
+                                          animationCache_(0), framePublisher_(0), geometryFingerprint_(0), shaderFingerprint_(0), 
+                                          geometryFingerprintValid_(false), shaderFingerprintValid_(false)
 {
 	copyFrom(rhs);
 }
@@ -79,12 +95,18 @@ GPUGeometryModel & GPUGeometryModel::operator=(const GPUGeometryModel &rhs)
 GPUGeometryModel::~GPUGeometryModel() 
 {
    delete calculationEngine_;
+   delete tiledEngine_;
+   delete upsampledEngine_;
+   delete regionOfInterest_;
+   delete sparseFrame_;
 }
       
 void GPUGeometryModel::initializeToCleanState() 
 {
    sizeX_ = sizeY_ = 0;
    changedSinceLastRecalc_ = true;
+   shaderFingerprintValid_ = false;
+   animationCache_ = 0;
 	renderedAreaMinX_ = renderedAreaMinY_ = renderedAreaMaxX_ = renderedAreaMaxY_ = renderedAreaMinZ_ = renderedAreaMaxZ_ = 0;
    clearGeometry();
 }
@@ -93,6 +115,8 @@ void GPUGeometryModel::clearGeometry()
 {
 	points_.clear();
    triangles_.clear();
+   geometryFingerprintValid_ = false;
+   editsTracked_ = false;
    
    boundMinX_ = boundMinY_ = boundMaxX_ = boundMaxY_ = 0;
 }
@@ -100,6 +124,7 @@ void GPUGeometryModel::clearGeometry()
 void GPUGeometryModel::copyFrom(const GPUGeometryModel &rhs) 
 {
    changedSinceLastRecalc_ = true;   
+   editsTracked_ = false;
    
    sizeX_ = rhs.getSizeX();
    sizeY_ = rhs.getSizeY();
@@ -115,9 +140,30 @@ void GPUGeometryModel::copyFrom(const GPUGeometryModel &rhs)
 
    setRenderedArea(rhs.getRenderedAreaMinX(), rhs.getRenderedAreaMinY(), rhs.getRenderedAreaMinZ(), rhs.getRenderedAreaMaxX(), rhs.getRenderedAreaMaxY(), rhs.getRenderedAreaMaxZ());
    calculationEngine_ = new GPUCalculationEngine();
+   calculationEngine_->setFrameCache(rhs.getFrameCache());
    
    points_ = rhs.points_;
    triangles_ = rhs.triangles_;
+   
+   // Engines are set before the shader, so that copying the model doesn't log that they are not used again
+   pathToShaderSource_.clear();
+   
+   setLazyTileEvaluation(rhs.getLazyTileEvaluation());
+   setUpsamplingFactor(rhs.getUpsamplingFactor());
+   setRefinementBudget(rhs.getRefinementBudget());
+   setSparseFrames(rhs.getSparseFrames());
+   
+   pathToShaderSource_ = rhs.pathToShaderSource_;
+   pathTo1DTexture_ = rhs.pathTo1DTexture_;
+   fileName_ = rhs.fileName_;
+   
+   geometryFingerprintValid_ = shaderFingerprintValid_ = false;
+   animationCache_ = rhs.animationCache_;
+   
+   if (rhs.regionOfInterest_)
+      setRefinementRegionOfInterest(*rhs.regionOfInterest_);
+   else
+      clearRefinementRegionOfInterest();
 }
      
 AbstractModel *GPUGeometryModel::cloneOrphan() const 
@@ -134,12 +180,107 @@ bool GPUGeometryModel::isModelCalculated() const
 void GPUGeometryModel::setNeedsRecalc()
 {
    changedSinceLastRecalc_ = true;
+   editsTracked_ = false;
 }
 
 void GPUGeometryModel::forceModelCalculation() const
 {
-   calculationEngine_->calculateEngine(this);
+   cachedFrame_ = FrameHandle();
+   
+   // Precalculated frame is as good as calculated one, as long as it was calculated from the same model
+   if (animationCache_  &&  animationCache_->isOpen()  &&  animationCache_->getKey() == getAnimationCacheKey())
+   {
+      int index = animationCache_->findFrame(getTimeSlice());
+      if (index >= 0)
+         cachedFrame_ = animationCache_->getFrame(index);
+   }
+   
+   bool upsampled = !cachedFrame_.isValid()  &&  isUpsamplingActive();
+   bool lazy = !cachedFrame_.isValid()  &&  isLazyTileEvaluationActive();
+   
+   // Upsampled board is calculated at once, or refined progressively until the deadline. Lazy tiles are calculated only when they are read. If
+   // only geometry was edited since the last calculation, other tiles stay valid, and the GL engine renders only the regions of the edits
+   bool progressive = upsampled  &&  refinementBudget_ > 0;
+   long long deadline = calculationDeadline_ ? calculationDeadline_ : getMonotonicTimeInMicroSeconds() + refinementBudget_;
+   
+   calculationDeadline_ = 0;
+   
+   if (progressive  &&  !changedSinceLastRecalc_  &&  !upsampledEngine_->isRefinementComplete())
+      upsampledEngine_->continueRefinement(deadline);
+   else if (progressive)
+      upsampledEngine_->calculateProgressive(*this, deadline, regionOfInterest_);
+   else if (upsampled)
+      upsampledEngine_->calculate(*this);
+   else if (lazy  &&  editsTracked_)
+      tiledEngine_->updateEdits(*this, editedPoints_, editedTriangles_);
+   else if (lazy)
+      tiledEngine_->update(*this);
+   else if (!cachedFrame_.isValid()  &&  editsTracked_)
+      calculationEngine_->calculateEdits(this, editedPoints_, editedTriangles_);
+   else if (!cachedFrame_.isValid())
+      calculationEngine_->calculateEngine(this);
+   
    changedSinceLastRecalc_ = false;
+   
+   editedPoints_.clear();
+   editedTriangles_.clear();
+   editsTracked_ = !upsampled  &&  !cachedFrame_.isValid();
+   
+   // Lazy calculation is published and stored only if the whole board is valid already. Reading it here would calculate every tile and defeat the
+   // lazy evaluation
+   bool complete = !lazy  ||  tiledEngine_->getNumValidTiles() == tiledEngine_->getNumTilesX() * tiledEngine_->getNumTilesY();
+   FrameHandle frame;
+   
+   if (framePublisher_  &&  complete)
+   {
+      // Frames from the cache are immutable already, calculated ones are copied out of the engine before it calculates the next one
+      if (cachedFrame_.isValid())
+      {
+         frame = cachedFrame_;
+      }
+      else
+      {
+         frame = framePublisher_->acquireBuffer(getSizeX(), getSizeY(), getTimeSlice());
+         readCalculatedValues(frame->getMutableValues());
+      }
+      
+      framePublisher_->publish(frame);
+   }
+   
+   sparseFrameValid_ = false;
+   
+   if (sparseFrame_  &&  complete)
+   {
+      // Sparse frame is built straight from the calculated board, without copying it first
+      const float *values = frame.isValid() ? frame->getValues() : getCalculatedValues();
+      sparseFrame_->setFromValues(values, getSizeX(), getSizeY(), getTimeSlice());
+      
+      sparseFrameValid_ = true;
+   }
+}
+
+void GPUGeometryModel::readCalculatedValues(float *values) const
+{
+   if (cachedFrame_.isValid())
+      memcpy(values, cachedFrame_->getValues(), getSizeX() * getSizeY() * sizeof(float));
+   else if (isUpsamplingActive())
+      upsampledEngine_->readValues(values);
+   else if (isLazyTileEvaluationActive())
+      tiledEngine_->readValues(values);
+   else
+      calculationEngine_->readValues(values);
+}
+
+const float *GPUGeometryModel::getCalculatedValues() const
+{
+   if (cachedFrame_.isValid())
+      return cachedFrame_->getValues();
+   else if (isUpsamplingActive())
+      return upsampledEngine_->getValues();
+   else if (isLazyTileEvaluationActive())
+      return tiledEngine_->getValues();
+   else
+      return calculationEngine_->getValues();
 }
 
 double GPUGeometryModel::getAt(int x, int y) const
@@ -149,10 +290,215 @@ double GPUGeometryModel::getAt(int x, int y) const
       forceModelCalculation();
    }
    
+   if (cachedFrame_.isValid())
+      return cachedFrame_->getAt(x, y);
+   
+   if (isUpsamplingActive())
+      return upsampledEngine_->getAt(x, y);
+   
+   if (isLazyTileEvaluationActive())
+      return tiledEngine_->getAt(x, y);
+   
    double value = calculationEngine_->getAt(x, y);
    return value;
 }
 
+void GPUGeometryModel::readRegion(const TileRange &range, float *values) const
+{
+   PRECONDITION(range.beginX >= 0  &&  range.endX <= getSizeX()  &&  range.beginY >= 0  &&  range.endY <= getSizeY());
+   
+   if (!isModelCalculated())
+      forceModelCalculation();
+   
+   if (!cachedFrame_.isValid()  &&  isLazyTileEvaluationActive())
+   {
+      tiledEngine_->readRegion(range, values);
+      return;
+   }
+   
+   int width = range.endX - range.beginX;
+   
+   for (int y = range.beginY; y < range.endY; y++)
+      for (int x = range.beginX; x < range.endX; x++)
+         values[(y - range.beginY) * width + x - range.beginX] = getAt(x, y);
+}
+
+void GPUGeometryModel::calculateRegion(const TileRange &range) const
+{
+   PRECONDITION(range.beginX >= 0  &&  range.endX <= getSizeX()  &&  range.beginY >= 0  &&  range.endY <= getSizeY());
+   
+   if (!isModelCalculated())
+      forceModelCalculation();
+   
+   if (!cachedFrame_.isValid()  &&  isLazyTileEvaluationActive())
+      tiledEngine_->calculateRegion(range);
+}
+
+bool GPUGeometryModel::setLazyTileEvaluation(bool lazy)
+{
+   if (lazy != getLazyTileEvaluation())
+   {
+      delete tiledEngine_;
+      tiledEngine_ = lazy ? new TiledDepthEngine() : 0;
+      
+      changedSinceLastRecalc_ = true;
+      editsTracked_ = false;
+   }
+   
+   if (lazy  &&  !pathToShaderSource_.empty())
+      LOG("Lazy tile evaluation is not used for the model with the shader");
+   
+   return !lazy  ||  isLazyTileEvaluationActive();
+}
+
+void GPUGeometryModel::setSparseFrames(bool sparse)
+{
+   if (sparse == getSparseFrames())
+      return;
+   
+   delete sparseFrame_;
+   sparseFrame_ = sparse ? new SparseFrame() : 0;
+   
+   sparseFrameValid_ = false;
+   changedSinceLastRecalc_ = true;
+}
+
+bool GPUGeometryModel::setUpsamplingFactor(int factor)
+{
+   PRECONDITION(factor >= 1);
+   
+   if (factor != getUpsamplingFactor())
+   {
+      delete upsampledEngine_;
+      upsampledEngine_ = factor > 1 ? new UpsampledDepthEngine(factor) : 0;
+      
+      changedSinceLastRecalc_ = true;
+      editsTracked_ = false;
+   }
+   
+   if (factor > 1  &&  !pathToShaderSource_.empty())
+      LOG("Upsampling is not used for the model with the shader");
+   
+   return factor == 1  ||  isUpsamplingActive();
+}
+
+void GPUGeometryModel::setPathToShaderSource(const char *path)
+{
+   pathToShaderSource_ = path;
+   shaderFingerprintValid_ = false;
+   
+   if (!pathToShaderSource_.empty()  &&  (tiledEngine_  ||  upsampledEngine_))
+      LOG("Lazy tile evaluation and upsampling are not used for the model with the shader");
+}
+
+int GPUGeometryModel::getUpsamplingFactor() const
+{
+   return upsampledEngine_ ? upsampledEngine_->getFactor() : 1;
+}
+
+void GPUGeometryModel::setRefinementBudget(int budgetInMicroSeconds)
+{
+   PRECONDITION(budgetInMicroSeconds >= 0);
+   
+   refinementBudget_ = budgetInMicroSeconds;
+   changedSinceLastRecalc_ = true;
+}
+
+void GPUGeometryModel::setCalculationDeadline(long long deadlineInMicroSeconds) const
+{
+   calculationDeadline_ = deadlineInMicroSeconds;
+}
+
+void GPUGeometryModel::setRefinementRegionOfInterest(const TileRange &range)
+{
+   if (!regionOfInterest_)
+      regionOfInterest_ = new TileRange();
+   
+   *regionOfInterest_ = range;
+   changedSinceLastRecalc_ = true;
+}
+
+void GPUGeometryModel::clearRefinementRegionOfInterest()
+{
+   delete regionOfInterest_;
+   regionOfInterest_ = 0;
+   changedSinceLastRecalc_ = true;
+}
+
+void GPUGeometryModel::setFrameCache(FrameCache *cache)
+{
+   PRECONDITION(calculationEngine_);
+   
+   calculationEngine_->setFrameCache(cache);
+   changedSinceLastRecalc_ = true;
+}
+
+FrameCache *GPUGeometryModel::getFrameCache() const
+{
+   PRECONDITION(calculationEngine_);
+   return calculationEngine_->getFrameCache();
+}
+
+unsigned long long GPUGeometryModel::getGeometryFingerprint() const
+{
+   if (geometryFingerprintValid_)
+      return geometryFingerprint_;
+   
+   int numPoints = getNumPoints(), numTriangles = getNumTriangles();
+   
+   unsigned long long hash = fnv1aHash(&numPoints, sizeof(numPoints));
+   hash = fnv1aHash(&numTriangles, sizeof(numTriangles), hash);
+   
+   for (int i = 0; i < numPoints; i++)
+   {
+      double coordinates[3] = {points_[i].getX(), points_[i].getY(), points_[i].getZ()};
+      hash = fnv1aHash(coordinates, sizeof(coordinates), hash);
+   }
+   
+   for (int i = 0; i < numTriangles; i++)
+   {
+      int indexes[3] = {triangles_[i].getIndex1(), triangles_[i].getIndex2(), triangles_[i].getIndex3()};
+      hash = fnv1aHash(indexes, sizeof(indexes), hash);
+   }
+   
+   geometryFingerprint_ = hash;
+   geometryFingerprintValid_ = true;
+   
+   return geometryFingerprint_;
+}
+
+unsigned long long GPUGeometryModel::getShaderFingerprint() const
+{
+   if (shaderFingerprintValid_)
+      return shaderFingerprint_;
+   
+   if (!hashFile(pathToShaderSource_, &shaderFingerprint_))
+      shaderFingerprint_ = fnv1aHash(pathToShaderSource_.c_str(), pathToShaderSource_.size());
+   
+   shaderFingerprintValid_ = true;
+   
+   return shaderFingerprint_;
+}
+
+AnimationCacheKey GPUGeometryModel::getAnimationCacheKey() const
+{
+   AnimationCacheKey key;
+   
+   key.geometryHash = getGeometryFingerprint();
+   key.shaderHash = getShaderFingerprint();
+   key.sizeX = getSizeX();
+   key.sizeY = getSizeY();
+   
+   key.renderedArea[0] = getRenderedAreaMinX();
+   key.renderedArea[1] = getRenderedAreaMinY();
+   key.renderedArea[2] = getRenderedAreaMinZ();
+   key.renderedArea[3] = getRenderedAreaMaxX();
+   key.renderedArea[4] = getRenderedAreaMaxY();
+   key.renderedArea[5] = getRenderedAreaMaxZ();
+   
+   return key;
+}
+
 bool GPUGeometryModel::readFromFile(const std::string &fileName) 
 {
    changedSinceLastRecalc_ = true;
@@ -27,6 +27,8 @@
 #include "TriangleByPointIndex.h"
 #include "Point.h"
 #include "SimpleDesignByContract.h"
+#include "AnimationCache.h"
+#include "Frame.h"
 
 namespace hdsim {
      
@@ -37,6 +39,12 @@ namespace hdsim {
    
    // Forward declaration to resolve circular dependency
    class GPUCalculationEngine;
+   class FrameCache;
+   class FramePublisher;
+   class TiledDepthEngine;
+   class UpsampledDepthEngine;
+   class SparseFrame;
+   struct TileRange;
 
    /**
     * GPU based checkboard model used for remembering rod position at the particular moment in time. It is fed 3D geometry (points, triangles) and then will calculate 
@@ -100,6 +108,7 @@ namespace hdsim {
       virtual void setSizeX(int sizeX) 
       {
 		   changedSinceLastRecalc_ = true;         
+         editsTracked_ = false;
          sizeX_ = sizeX;
       }
 
@@ -111,6 +120,7 @@ namespace hdsim {
       virtual void setSizeY(int sizeY) 
       {
 		   changedSinceLastRecalc_ = true;	         
+         editsTracked_ = false;
          sizeY_ = sizeY;
       }
       
@@ -162,6 +172,7 @@ namespace hdsim {
       virtual void addPoint(const Point &point) 
       {
 		   changedSinceLastRecalc_ = true;
+         geometryFingerprintValid_ = false;
          
          points_.push_back(point);
          
@@ -207,7 +218,10 @@ namespace hdsim {
          CHECK(index >= 0  &&  index < getNumPoints(), "Index out of bound");
          
          changedSinceLastRecalc_ = true;
+         geometryFingerprintValid_ = false;
       	points_[index] = point;
+         
+         recordEdit(&editedPoints_, index);
       }
 
       /**
@@ -218,6 +232,7 @@ namespace hdsim {
       virtual void addTriangle(const TriangleByPointIndexes &triangle) 
       {
 		   changedSinceLastRecalc_ = true;         
+         geometryFingerprintValid_ = false;
          triangles_.push_back(triangle);
       }
       
@@ -252,9 +267,12 @@ namespace hdsim {
       virtual void replaceTriangleAt(int index, const TriangleByPointIndexes &triangle) 
       {
 		   changedSinceLastRecalc_ = true;
+         geometryFingerprintValid_ = false;
          
-         CHECK(index >= 0  &&  index < getNumPoints(), "Index out of bound");
+         CHECK(index >= 0  &&  index < getNumTriangles(), "Index out of bound");
       	triangles_[index] = triangle;
+         
+         recordEdit(&editedTriangles_, index);
       }
       
       /**
@@ -388,6 +406,7 @@ namespace hdsim {
 									   !areEqual(minZ, getRenderedAreaMinZ())  ||  !areEqual(maxZ, getRenderedAreaMaxZ());
          
          changedSinceLastRecalc_ = changedSinceLastRecalc_  ||  boundsChanged;
+         editsTracked_ = editsTracked_  &&  !boundsChanged;
          
 			// It is quite possible that if test would take more time due to the possible pipeline stall then all assignments, but we 
          // should measure before we optimize
@@ -430,14 +449,11 @@ namespace hdsim {
       }
       
       /**
-       * Set the path to the shader source
+       * Set the path to the shader source. Lazy tile evaluation and upsampling are not used while the shader is set, as their engines don't run it
        *
        * @param path Path to the source
        */
-      virtual void setPathToShaderSource(const char *path)
-      {
-         pathToShaderSource_ = path;
-      }
+      virtual void setPathToShaderSource(const char *path);
       
       /**
        * Get the path to 1D texture
@@ -459,8 +475,289 @@ namespace hdsim {
          pathTo1DTexture_ = path;
       }
       
+      /**
+       * Get fingerprint of the geometry (points and triangles). Fingerprint is calculated only after geometry changes
+       *
+       * @return Hash of the geometry
+       */
+      virtual unsigned long long getGeometryFingerprint() const;
+      
+      /**
+       * Get fingerprint of the shader source. If shader file couldn't be read, path to it is used instead
+       *
+       * @return Hash of the shader source
+       */
+      virtual unsigned long long getShaderFingerprint() const;
+      
+      /**
+       * Get key under which calculated frames of this model could be cached
+       *
+       * @return Key of the model
+       */
+      virtual AnimationCacheKey getAnimationCacheKey() const;
+      
+      /**
+       * Set precalculated animation to use instead of the calculation engine. Cache is used only for the timeslices it contains, and only while its key
+       * matches the model
+       *
+       * @param cache Cache to use, or 0 to always calculate. Caller retains ownership and cache must outlive the model
+       */
+      virtual void setAnimationCache(const AnimationCache *cache)
+      {
+         changedSinceLastRecalc_ = true;
+         animationCache_ = cache;
+      }
+      
+      /**
+       * Get precalculated animation used by this model
+       *
+       * @return Cache, or 0 if there is none
+       */
+      virtual const AnimationCache *getAnimationCache() const
+      {
+         return animationCache_;
+      }
+      
+      /**
+       * Set cache of the calculated frames used by the calculation engine (see GPUCalculationEngine::setFrameCache())
+       *
+       * @param cache Cache to use, or 0 to always calculate. Caller retains ownership
+       */
+      virtual void setFrameCache(FrameCache *cache);
+      
+      /**
+       * Get cache of the calculated frames used by the calculation engine
+       *
+       * @return Cache, or 0 if there is none
+       */
+      virtual FrameCache *getFrameCache() const;
+      
+      /**
+       * Set publisher to which every calculated frame is published, so that other threads could read frames without touching the model. Publisher is
+       * not copied with the model, as clones calculate frames out of order.
+       *
+       * With lazy tile evaluation, frame is published only if every tile of the board is valid already, as publishing would otherwise calculate the
+       * whole board. Callers that need those frames read the board with readRegion() and publish it themselves
+       *
+       * @param publisher Publisher to use, or 0 not to publish. Caller retains ownership
+       */
+      virtual void setFramePublisher(FramePublisher *publisher)
+      {
+         framePublisher_ = publisher;
+      }
+      
+      /**
+       * Get publisher to which every calculated frame is published
+       *
+       * @return Publisher, or 0 if there is none
+       */
+      virtual FramePublisher *getFramePublisher() const
+      {
+         return framePublisher_;
+      }
+      
+      /**
+       * Set lazy tile evaluation. In this mode calculation only invalidates tiles of the board, and getAt() and readRegion() calculate just the tiles
+       * they touch (see TiledDepthEngine). Tiles are calculated on the CPU, which doesn't run the shader, so models with the shader set are still 
+       * calculated the usual way, without the triangle binning of the tiled engine. Upsampling takes precedence over
+       * lazy tile evaluation
+       *
+       * @param lazy Use lazy tile evaluation
+       * @return false if lazy tile evaluation is set, but not used as the model has the shader or upsampling set
+       */
+      virtual bool setLazyTileEvaluation(bool lazy);
+      
+      /**
+       * Is lazy tile evaluation set
+       *
+       * @return Is lazy tile evaluation set
+       */
+      virtual bool getLazyTileEvaluation() const
+      {
+         return tiledEngine_ != 0;
+      }
+      
+      /**
+       * Get engine used for the lazy tile evaluation, for its statistics
+       *
+       * @return Engine, or 0 if lazy tile evaluation is not set
+       */
+      virtual const TiledDepthEngine *getTiledDepthEngine() const
+      {
+         return tiledEngine_;
+      }
+      
+      /**
+       * Set upsampling. In this mode board is calculated at 1/factor of its resolution and upsampled, and only tiles with discontinuities are 
+       * calculated at the full resolution (see UpsampledDepthEngine). Like lazy tile evaluation, it is used only for models without the shader,
+       * and takes precedence over it. Progressive refinement is used only with upsampling, so it is lost with the shader too
+       *
+       * @param factor Ratio of the full and coarse resolution, or 1 to calculate every moxel
+       * @return false if upsampling is set, but not used as the model has the shader set
+       */
+      virtual bool setUpsamplingFactor(int factor);
+      
+      /**
+       * Get upsampling factor
+       *
+       * @return Ratio of the full and coarse resolution, or 1 if upsampling is not set
+       */
+      virtual int getUpsamplingFactor() const;
+      
+      /**
+       * Get engine used for the upsampling, for its statistics
+       *
+       * @return Engine, or 0 if upsampling is not set
+       */
+      virtual const UpsampledDepthEngine *getUpsampledDepthEngine() const
+      {
+         return upsampledEngine_;
+      }
+      
+      /**
+       * Set progressive refinement of the upsampled board. With the budget set, calculation interpolates the whole board from the coarse one, and then
+       * calculates tiles at the full resolution in the order of their priority until the budget runs out (see UpsampledDepthEngine::calculateProgressive()).
+       * Calculating the model again without changing it continues the refinement. Used only with upsampling
+       *
+       * @param budgetInMicroSeconds Time the calculation could take, or 0 to always calculate the board completely
+       */
+      virtual void setRefinementBudget(int budgetInMicroSeconds);
+      
+      /**
+       * Get budget of the progressive refinement
+       *
+       * @return Time the calculation could take, or 0 if progressive refinement is not set
+       */
+      virtual int getRefinementBudget() const
+      {
+         return refinementBudget_;
+      }
+      
+      /**
+       * Set deadline of the next calculation, in place of the refinement budget. Used for the next calculation only, and only if refinement budget is
+       * set, so that the caller knowing when the frame is due (FrameScheduler) could use all the time until then
+       *
+       * @param deadlineInMicroSeconds Deadline, from getMonotonicTimeInMicroSeconds()
+       */
+      virtual void setCalculationDeadline(long long deadlineInMicroSeconds) const;
+      
+      /**
+       * Set region of the board refined before all others in the progressive refinement
+       *
+       * @param range Moxels of the region
+       */
+      virtual void setRefinementRegionOfInterest(const TileRange &range);
+      
+      /**
+       * Clear region of interest, so that tiles are refined in the order of their estimated error only
+       */
+      virtual void clearRefinementRegionOfInterest();
+      
+      /**
+       * Set sparse frames. In this mode every calculation also stores the board as the SparseFrame, so that decimation and drawing could visit only 
+       * the tiles covered by geometry. With lazy tile evaluation, frame is stored only if every tile of the board is valid already, as storing it 
+       * would otherwise calculate the whole board
+       *
+       * @param sparse Store calculated boards as sparse frames
+       */
+      virtual void setSparseFrames(bool sparse);
+      
+      /**
+       * Are sparse frames set
+       *
+       * @return Are sparse frames set
+       */
+      virtual bool getSparseFrames() const
+      {
+         return sparseFrame_ != 0;
+      }
+      
+      /**
+       * Get sparse frame stored by the last calculation
+       *
+       * @return Frame, or 0 if sparse frames are not set or the last calculation didn't store it
+       */
+      virtual const SparseFrame *getSparseFrame() const
+      {
+         return sparseFrameValid_ ? sparseFrame_ : 0;
+      }
+      
+      /**
+       * Read values of the region. With lazy tile evaluation, only tiles overlapping the region are calculated
+       *
+       * @param range Region to read
+       * @param values (OUT) Values, stored so that [x][y] of the region corresponds to [(y - beginY) * (endX - beginX) + x - beginX]
+       */
+      virtual void readRegion(const TileRange &range, float *values) const;
+      
+      /**
+       * Calculate the region without reading it, so that getAt() of its moxels doesn't calculate anything and could be called concurrently. With lazy
+       * tile evaluation, tiles overlapping the region are calculated in parallel
+       *
+       * @param range Region to calculate
+       */
+      virtual void calculateRegion(const TileRange &range) const;
+      
    private:
       
+      /**
+       * Max number of edits tracked between two calculations. With more edits than that, whole board is calculated again
+       */
+      static const int MAX_TRACKED_EDITS = 4096;
+      
+      /**
+       * Record index of the replaced point or triangle, so that only the moxels it covers are calculated again
+       *
+       * @param edits Edits to add the index to
+       * @param index Index of the point or triangle
+       */
+      void recordEdit(std::vector<int> *edits, int index)
+      {
+         if (!editsTracked_)
+            return;
+         
+         if (editedPoints_.size() + editedTriangles_.size() >= MAX_TRACKED_EDITS)
+         {
+            editsTracked_ = false;
+            editedPoints_.clear();
+            editedTriangles_.clear();
+            return;
+         }
+         
+         edits->push_back(index);
+      }
+      
+      /**
+       * Read the whole board of the last calculation
+       *
+       * @param values (OUT) Values, stored so that [x][y] corresponds to [y * getSizeX() + x]
+       */
+      void readCalculatedValues(float *values) const;
+      
+      /**
+       * The whole board of the last calculation, without copying it. Lazily evaluated boards are complete
+       * only once all of their tiles are valid.
+       *
+       * @return Values, stored so that [x][y] corresponds to [y * getSizeX() + x]
+       */
+      const float *getCalculatedValues() const;
+      
+      /**
+       * Is lazy tile evaluation used for the current state of the model
+       */
+      bool isLazyTileEvaluationActive() const
+      {
+         return tiledEngine_  &&  !upsampledEngine_  &&  pathToShaderSource_.empty();
+      }
+      
+      /**
+       * Is upsampling used for the current state of the model
+       */
+      bool isUpsamplingActive() const
+      {
+         return upsampledEngine_  &&  pathToShaderSource_.empty();
+      }
+      
       /**
        * Bounds of the view frustum
        */
@@ -476,6 +773,40 @@ namespace hdsim {
        */
       GPUCalculationEngine *calculationEngine_;
       
+      /**
+       * Engine used for the lazy tile evaluation, or 0
+       */
+      TiledDepthEngine *tiledEngine_;
+      
+      /**
+       * Engine used for the upsampling, or 0
+       */
+      UpsampledDepthEngine *upsampledEngine_;
+      
+      /**
+       * Budget of the progressive refinement, or 0, and the deadline of the next calculation, or 0
+       */
+      int refinementBudget_;
+      mutable long long calculationDeadline_;
+      
+      /**
+       * Region refined first in the progressive refinement, or 0
+       */
+      TileRange *regionOfInterest_;
+      
+      /**
+       * Board of the last calculation stored as the sparse frame, or 0 if sparse frames are not set, and was it stored by the last calculation
+       */
+      SparseFrame *sparseFrame_;
+      mutable bool sparseFrameValid_;
+      
+      /**
+       * Indexes of the points and triangles replaced since the last calculation, and are they complete. They are complete only if the last 
+       * calculation was done by the tiled or the GL engine, and nothing but geometry changed since it
+       */
+      mutable std::vector<int> editedPoints_, editedTriangles_;
+      mutable bool editsTracked_;
+      
       /**
        * Did we change after last recalc. Note that this variable is not considered part of the const of the object because it is related to the
        * caching, not to the model state (model state for cached and non-cached object is considered the same)
@@ -497,6 +828,27 @@ namespace hdsim {
        */
       std::string fileName_;
       
+      /**
+       * Precalculated animation, or 0
+       */
+      const AnimationCache *animationCache_;
+      
+      /**
+       * Frame read from the animation cache in the last calculation. Invalid if last calculation was done by the calculation engine
+       */
+      mutable FrameHandle cachedFrame_;
+      
+      /**
+       * Publisher of the calculated frames, or 0
+       */
+      FramePublisher *framePublisher_;
+      
+      /**
+       * Cached fingerprints, with flags telling are they still valid. Like changedSinceLastRecalc_, they are not part of the model state
+       */
+      mutable unsigned long long geometryFingerprint_, shaderFingerprint_;
+      mutable bool geometryFingerprintValid_, shaderFingerprintValid_;
+      
       /**
        * Copy value from rhs to this object
        *
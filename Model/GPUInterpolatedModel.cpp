@@ -21,14 +21,22 @@
 #include <string>
 #include <sstream>
 #include <cmath>
+#include <cstring>
 
 #include "MathHelper.h"
 #include "GPUInterpolatedModel.h"
+#include "SparseFrame.h"
 #include "SimpleDesignByContract.h"
+#include "ThreadPool.h"
 
 using namespace hdsim;
 using namespace std;
 
+/**
+ * Number of rows of the decimated grid processed by the single task. Decimated rows are large (they cover many GPU rows), so few per task is enough
+ */
+static const int DECIMATION_ROWS_PER_TASK = 4;
+
 GPUInterpolatedModel::GPUInterpolatedModel() : model_(), timeSlice_(0), optimizeDrawing_(false), 
 															  optimizeDrawingThreshold_(0), optimizedModelSizeX_(0), optimizedModelSizeY_(0), decimatedModel_(0)
 {
@@ -124,7 +132,7 @@ double GPUInterpolatedModel::getAt(int x, int y) const
       CHECK(x < optimizedModelSizeX_, "X coordinate too large");
       CHECK(y < optimizedModelSizeY_, "Y coordinate too large");
             
-      return decimatedModel_[y * optimizedModelSizeY_ + x];
+      return decimatedModel_[y * optimizedModelSizeX_ + x];
    }
    else
    {
@@ -174,8 +182,12 @@ void GPUInterpolatedModel::forceModelCalculation() const
       optimizedModelSizeX_ = getModelSizeForOptimizedDrawingX();
       optimizedModelSizeY_ = getModelSizeForOptimizedDrawingY();
       
+      // Sparse frame visits only the tiles covered by geometry
+      const SparseFrame *sparseFrame = model_.getSparseFrame();
+      
       delete [] decimatedModel_;
-      decimatedModel_ = getDecimatedModelAdopt(&model_, optimizedModelSizeX_, optimizedModelSizeY_);
+      decimatedModel_ = getDecimatedModelAdopt(sparseFrame ? static_cast<const AbstractModel *>(sparseFrame) : &model_, optimizedModelSizeX_, 
+                                               optimizedModelSizeY_);
    }
 }
 
@@ -197,6 +209,63 @@ int GPUInterpolatedModel::getModelSizeForOptimizedDrawingY() const
    return floor(correctionFactor * model_.getSizeY());
 }
 
+/**
+ * Decimates block of the rows of the decimated grid. Every decimated row is owned by exactly one tile, so tiles could run in parallel
+ */
+class DecimationBody : public TileRangeBody {
+   
+public:
+   
+   DecimationBody(const AbstractModel *m, int xSize, int ySize, double *result) : m_(m), xSize_(xSize), ySize_(ySize), result_(result)
+   {
+      // How many gpu pixels are mapped to the single decimated pixel. In general, there is reminder on the right and bottom edge 
+      xGPUPixelsInDecimatedPixel_ = m->getSizeX() / xSize;
+      rightEdgePixelsInDecimatedPixel_ = xGPUPixelsInDecimatedPixel_ + m->getSizeX() % xSize;
+      
+      yGPUPixelsInDecimatedPixel_ = m->getSizeY() / ySize;
+      bottomEdgePixelsInDecimatedPixel_ = yGPUPixelsInDecimatedPixel_ + m->getSizeY() % ySize;
+   }
+   
+   virtual void processTile(const TileRange &range) const
+   {
+      const int gpuSizeX = m_->getSizeX();
+      
+      for (int posY = range.beginY; posY < range.endY; posY++)
+      {
+         double *scanLine = result_ + posY * xSize_;
+         
+         int gpuPixelsInRow = posY < ySize_ - 1 ? yGPUPixelsInDecimatedPixel_ : bottomEdgePixelsInDecimatedPixel_;
+         int firstGPURow = posY * yGPUPixelsInDecimatedPixel_;
+         
+         // Sum values in all GPU pixels mapped to this decimated row
+         for (int indexY = firstGPURow; indexY < firstGPURow + gpuPixelsInRow; indexY++)
+            for (int indexX = 0; indexX < gpuSizeX; indexX++)
+            {
+               int posX = indexX / xGPUPixelsInDecimatedPixel_;
+               posX = posX < xSize_ ? posX : xSize_ - 1;
+               
+               scanLine[posX] += m_->getAt(indexX, indexY);
+            }
+         
+         // And divide with the number of GPU pixels in each decimated pixel. Edge pixels are larger
+         for (int posX = 0; posX < xSize_; posX++)
+         {
+            int gpuPixelsInColumn = posX < xSize_ - 1 ? xGPUPixelsInDecimatedPixel_ : rightEdgePixelsInDecimatedPixel_;
+            scanLine[posX] /= gpuPixelsInColumn * gpuPixelsInRow;
+         }
+      }
+   }
+   
+private:
+   
+   const AbstractModel *m_;
+   int xSize_, ySize_;
+   double *result_;
+   
+   int xGPUPixelsInDecimatedPixel_, rightEdgePixelsInDecimatedPixel_;
+   int yGPUPixelsInDecimatedPixel_, bottomEdgePixelsInDecimatedPixel_;
+};
+
 double *GPUInterpolatedModel::getDecimatedModelAdopt(const AbstractModel *m, int xSize, int ySize)
 {
    // We would assume fourth quadrant in comments (x grows to right, y goes down)
@@ -209,72 +278,40 @@ double *GPUInterpolatedModel::getDecimatedModelAdopt(const AbstractModel *m, int
    
    const int gpuSizeX = m->getSizeX();
    const int gpuSizeY = m->getSizeY();
-   const int numMoxels = gpuSizeX * gpuSizeY;
    
    CHECK(gpuSizeX >= xSize  &&  gpuSizeY >= ySize, "Decimated grid can't be larger then original grid");
    
-   // How many gpu pixels are mapped to the single decimated pixel
-   int xGPUPixelsInDecimatedPixel = gpuSizeX / xSize;
-   
-   // In general, there is reminder on the right edge 
-   int rightEdgePixelsInDecimatedPixel = xGPUPixelsInDecimatedPixel + m->getSizeX() % xSize;
-   
-   // Same for Y
-   int yGPUPixelsInDecimatedPixel = m->getSizeY() / ySize;
-   int bottomEdgePixelsInDecimatedPixel = yGPUPixelsInDecimatedPixel + m->getSizeY() % ySize;
-   
-   int normalQuadMoxels = xGPUPixelsInDecimatedPixel * yGPUPixelsInDecimatedPixel;
-   
    // Zero-init result
-   double *result = new double[numMoxels];
+   double *result = new double[xSize * ySize];
    CHECK(result, "Memory allocation failure");
    
-   memset(result, 0, numMoxels * sizeof(double));
+   memset(result, 0, xSize * ySize * sizeof(double));
    
-   // Sum values in all decimated points
-   for (int indexY = 0; indexY < gpuSizeY; indexY++)
-      for (int indexX = 0; indexX < gpuSizeX; indexX++)
-      {
-         int posX = indexX / xGPUPixelsInDecimatedPixel;
-         posX = posX < xSize ? posX : xSize - 1;
-         
-         int posY = indexY / yGPUPixelsInDecimatedPixel;
-         posY = posY < ySize ? posY : ySize - 1;
-         
-         result[posY * ySize + posX] += m->getAt(indexX, indexY);
-      }
+   // Sparse frames visit only their occupied tiles
+   const SparseFrame *sparseFrame = dynamic_cast<const SparseFrame*>(m);
    
-   // Fix evenly sized decimated areas
-   for (int indexY = 0; indexY < ySize - 1; indexY++)
+   if (sparseFrame)
    {
-      int startOfScanLine = indexY * xSize;
-      
-      for (int indexX = 0; indexX < xSize - 1; indexX++)
-      {
-         result[startOfScanLine + indexX] /= normalQuadMoxels;
-      }      
+      sparseFrame->decimate(xSize, ySize, result);
+      return result;
    }
    
-   // Size of the quad on the right edge
-   int gpuPixelsInDecimatedPixelOnRightEdge = rightEdgePixelsInDecimatedPixel * yGPUPixelsInDecimatedPixel;
+   // Model could calculate itself lazily on the first access, which is not safe to do from multiple threads. Make sure that happens here, for every
+   // moxel decimation reads - lazy geometry model calculates only the tiles that are read
+   const GPUGeometryModel *geometryModel = dynamic_cast<const GPUGeometryModel*>(m);
    
-   // Right edge
-   for (int indexY = 0; indexY < ySize - 1; indexY++)
+   if (geometryModel)
    {
-      result[(indexY + 1) * xSize - 1] /= gpuPixelsInDecimatedPixelOnRightEdge;
+      TileRange board = {0, gpuSizeX, 0, gpuSizeY};
+      geometryModel->calculateRegion(board);
    }
-   
-   int gpuPixelsInDecimatedPixelOnBottomEdge = xGPUPixelsInDecimatedPixel * bottomEdgePixelsInDecimatedPixel;
-   
-   // Bottom edge
-   for (int indexX = 0; indexX < xSize - 1; indexX++)
+   else
    {
-      result[(ySize - 1) * xSize + indexX] /= gpuPixelsInDecimatedPixelOnBottomEdge;
+      m->getAt(0, 0);
    }
    
-   // Bottom right corner
-   int gpuPixelsInDecimatedPixelInLowerRightQuad = rightEdgePixelsInDecimatedPixel * bottomEdgePixelsInDecimatedPixel;
-   result[xSize * ySize - 1] /= gpuPixelsInDecimatedPixelInLowerRightQuad;
+   // Rows of the decimated grid are independent, so split them between the threads of the shared pool
+   parallelFor2D(ThreadPool::getSharedPool(), xSize, ySize, xSize, DECIMATION_ROWS_PER_TASK, DecimationBody(m, xSize, ySize, result));
    
    return result;
 }
@@ -320,3 +357,15 @@ bool GPUInterpolatedModel::readFromFile(const std::string &fileName)
    // Next line is model, so just read it
    return model_.readFromFile(getFileNameInSameDirAsOriginalFile(fileName, modelName));
 }
+
+double GPUInterpolatedModel::getNextTimeSlice(double timeSlice, double interframeDistance, bool loop)
+{
+   double newTimeSlice = timeSlice + interframeDistance;
+   
+   if (loop)
+   {
+      return newTimeSlice < MAX_TIME_SLICE ? newTimeSlice : (newTimeSlice - MAX_TIME_SLICE) + MIN_TIME_SLICE;
+   }
+   
+   return newTimeSlice <= MAX_TIME_SLICE ? newTimeSlice : MAX_TIME_SLICE;
+}
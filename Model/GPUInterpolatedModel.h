@@ -88,14 +88,29 @@ namespace hdsim {
        * Get model that is reduced on xSize, ySize dimensions. It would apply box filter on all the cells in the model, with the rightmost and bottom part holding 
        * any "extra" cells if m->getSizeX() is not exactly divisible with xSize (and respective for ySize
        *
+       * Rows of the decimated model are calculated in parallel on the shared ThreadPool, so m->getAt() must be safe to call concurrently once model is calculated.
+       * GPUGeometryModel is calculated completely (GPUGeometryModel::calculateRegion()) before that, even with lazy tile evaluation
+       *
        * @param m Model to use
        * @param xSize X size of the decimated model
        * @param ySize Y size of the decimated model       
        * 
-       * @return Pointer to the 1D array of doubles holding decimated size, stored so that [x][y] corresponds to [y * ySize + x]. Caller is responsible for invoking delete [] on this pointer
+       * @return Pointer to the 1D array of doubles holding decimated size, stored so that [x][y] corresponds to [y * xSize + x]. Caller is responsible for invoking delete [] on this pointer
        */
       static double *getDecimatedModelAdopt(const AbstractModel *m, int xSize, int ySize);
       
+      /**
+       * Get timeslice of the next frame of animation. If animation loops, we continue from the beginning at the same place as if this was circular tape (helps 
+       * with avoiding discontinuity at the moment of jump), otherwise we stop at MAX_TIME_SLICE
+       *
+       * @param timeSlice Current timeslice
+       * @param interframeDistance Distance between two frames of animation
+       * @param loop Should animation loop
+       *
+       * @return Timeslice of the next frame
+       */
+      static double getNextTimeSlice(double timeSlice, double interframeDistance, bool loop);
+      
       /**
        * Set current value of timeslice. This is opportunity to do internal caching, if subclass wants to do it
        *
@@ -222,7 +237,58 @@ namespace hdsim {
       {
          model_.setRenderedArea(minX, minY, minZ, maxX, maxY, maxZ);
       }
+
+      /**
+       * Set precalculated animation to use for the underlying geometry model (see GPUGeometryModel::setAnimationCache())
+       *
+       * @param cache Cache to use, or 0 to always calculate. Caller retains ownership
+       */
+      virtual void setAnimationCache(const AnimationCache *cache)
+      {
+         model_.setAnimationCache(cache);
+      }
+
+      /**
+       * Set publisher to which every calculated frame of the underlying geometry model is published (see GPUGeometryModel::setFramePublisher())
+       *
+       * @param publisher Publisher to use, or 0 not to publish. Caller retains ownership
+       */
+      virtual void setFramePublisher(FramePublisher *publisher)
+      {
+         model_.setFramePublisher(publisher);
+      }
+
+      /**
+       * Get key under which calculated frames of this model could be cached
+       *
+       * @return Key of the model
+       */
+      virtual AnimationCacheKey getAnimationCacheKey() const
+      {
+         return model_.getAnimationCacheKey();
+      }
+
+      /**
+       * Get underlying geometry model
+       *
+       * @return Geometry model
+       */
+      virtual GPUGeometryModel *getGeometryModel()
+      {
+         return &model_;
+      }
       
+      /**
+       * Get sparse frame stored by the last calculation of the geometry model (see GPUGeometryModel::setSparseFrames()). Board decimated for the 
+       * optimized drawing is calculated from it
+       *
+       * @return Frame, or 0 if there is none
+       */
+      virtual const SparseFrame *getSparseFrame() const
+      {
+         return model_.getSparseFrame();
+      }
+
       /**
        * Read model from file. Format of the file is:
        *
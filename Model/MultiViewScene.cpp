@@ -0,0 +1,212 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include "MultiViewScene.h"
+#include "GPUGeometryModel.h"
+#include "SimpleDesignByContract.h"
+
+using namespace hdsim;
+using namespace std;
+
+OrthographicView hdsim::makeRoomBoardView(RoomBoard board, const double roomMin[3], const double roomMax[3], int sizeX, int sizeY)
+{
+   // Direction in which board looks into the room and its up axis. Walls have Z up
+   static const double AXES[6][2][3] = {
+      {{0, 0, -1}, {0, 1, 0}},
+      {{0, 0, 1}, {0, 1, 0}},
+      {{1, 0, 0}, {0, 0, 1}},
+      {{-1, 0, 0}, {0, 0, 1}},
+      {{0, 1, 0}, {0, 0, 1}},
+      {{0, -1, 0}, {0, 0, 1}}
+   };
+   
+   PRECONDITION(board >= ROOM_CEILING  &&  board <= ROOM_WALL_MAX_Y);
+   
+   return makeOrthographicView(AXES[board][0], AXES[board][1], roomMin, roomMax, sizeX, sizeY);
+}
+
+namespace hdsim {
+   
+   /**
+    * Projects the geometry to the views. Tile is a range of views
+    */
+   class ProjectViewsBody : public TileRangeBody {
+      
+   public:
+      
+      ProjectViewsBody(MultiViewScene *scene) : scene_(scene)
+      {
+      }
+      
+      virtual void processTile(const TileRange &range) const
+      {
+         for (int i = range.beginX; i < range.endX; i++)
+         {
+            MultiViewScene::ViewState *state = scene_->views_[i];
+            state->projection.project(scene_->geometry_, state->view);
+         }
+      }
+      
+   private:
+      
+      MultiViewScene *scene_;
+   };
+   
+   /**
+    * Rasterizes band of rows of the views. Tile is a range of views and a range of rows, which could be past the end of the smaller views
+    */
+   class RasterizeViewsBody : public TileRangeBody {
+      
+   public:
+      
+      RasterizeViewsBody(MultiViewScene *scene) : scene_(scene)
+      {
+      }
+      
+      virtual void processTile(const TileRange &range) const
+      {
+         for (int i = range.beginX; i < range.endX; i++)
+         {
+            MultiViewScene::ViewState *state = scene_->views_[i];
+            
+            TileRange rows;
+            rows.beginX = 0;
+            rows.endX = state->view.sizeX;
+            rows.beginY = range.beginY;
+            rows.endY = min(range.endY, state->view.sizeY);
+            
+            if (rows.beginY >= rows.endY  ||  !rows.endX)
+               continue;
+            
+            clearDepth(rows, &state->depth[0], state->view.sizeX);
+            rasterizeDepth(state->projection, 0, 0, rows, &state->depth[0], state->view.sizeX);
+         }
+      }
+      
+   private:
+      
+      MultiViewScene *scene_;
+   };
+   
+} // namespace
+
+MultiViewScene::MultiViewScene(ThreadPool *pool) : pool_(pool ? pool : ThreadPool::getSharedPool()), geometryFingerprint_(0), 
+                                                   geometryFingerprintValid_(false), numGeometryUploads_(0)
+{
+}
+
+MultiViewScene::~MultiViewScene()
+{
+   removeAllViews();
+}
+
+int MultiViewScene::addView(const OrthographicView &view)
+{
+   PRECONDITION(view.sizeX >= 0  &&  view.sizeY >= 0);
+   
+   ViewState *state = new ViewState();
+   state->view = view;
+   state->depth.assign(view.sizeX * view.sizeY, 1.0f);
+   
+   views_.push_back(state);
+   
+   return views_.size() - 1;
+}
+
+void MultiViewScene::setView(int index, const OrthographicView &view)
+{
+   PRECONDITION(index >= 0  &&  index < getNumViews()  &&  view.sizeX >= 0  &&  view.sizeY >= 0);
+   
+   views_[index]->view = view;
+   views_[index]->depth.assign(view.sizeX * view.sizeY, 1.0f);
+}
+
+const OrthographicView &MultiViewScene::getView(int index) const
+{
+   PRECONDITION(index >= 0  &&  index < getNumViews());
+   return views_[index]->view;
+}
+
+void MultiViewScene::removeAllViews()
+{
+   for (int i = 0; i < views_.size(); i++)
+      delete views_[i];
+   
+   views_.clear();
+}
+
+void MultiViewScene::setGeometry(const GPUGeometryModel &model)
+{
+   unsigned long long fingerprint = model.getGeometryFingerprint();
+   
+   if (geometryFingerprintValid_  &&  fingerprint == geometryFingerprint_)
+      return;
+   
+   geometry_.setFromModel(model);
+   geometryFingerprint_ = fingerprint;
+   geometryFingerprintValid_ = true;
+   numGeometryUploads_++;
+}
+
+void MultiViewScene::calculate()
+{
+   if (views_.empty())
+      return;
+   
+   int maxSizeY = 0;
+   for (int i = 0; i < views_.size(); i++)
+      maxSizeY = max(maxSizeY, views_[i]->view.sizeY);
+   
+   parallelFor2D(pool_, getNumViews(), 1, 1, 1, ProjectViewsBody(this));
+   
+   // Views are independent, so bands of all views are rasterized in the same pass
+   if (maxSizeY)
+      parallelFor2D(pool_, getNumViews(), maxSizeY, 1, ROWS_PER_TASK, RasterizeViewsBody(this));
+}
+
+double MultiViewScene::getAt(int index, int x, int y) const
+{
+   PRECONDITION(index >= 0  &&  index < getNumViews());
+   
+   const ViewState *state = views_[index];
+   PRECONDITION(x >= 0  &&  x < state->view.sizeX  &&  y >= 0  &&  y < state->view.sizeY);
+   
+   return state->depth[y * state->view.sizeX + x];
+}
+
+const float *MultiViewScene::getValues(int index) const
+{
+   PRECONDITION(index >= 0  &&  index < getNumViews());
+   
+   const ViewState *state = views_[index];
+   return state->depth.empty() ? 0 : &state->depth[0];
+}
+
+FrameHandle MultiViewScene::createFrame(int index, double timeSlice) const
+{
+   PRECONDITION(index >= 0  &&  index < getNumViews());
+   
+   const ViewState *state = views_[index];
+   
+   FrameHandle frame = Frame::create(state->view.sizeX, state->view.sizeY, timeSlice);
+   copy(state->depth.begin(), state->depth.end(), frame->getMutableValues());
+   
+   return frame;
+}
@@ -0,0 +1,233 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MULTI_VIEW_SCENE_H_
+#define MULTI_VIEW_SCENE_H_
+
+#include <vector>
+
+#include "Frame.h"
+#include "SoftwareRasterizer.h"
+
+namespace hdsim {
+   
+   class GPUGeometryModel;
+   
+   /**
+    * Boards of the room, named by where they are mounted
+    */
+   enum RoomBoard {
+      ROOM_CEILING = 0,
+      ROOM_FLOOR = 1,
+      ROOM_WALL_MIN_X = 2,
+      ROOM_WALL_MAX_X = 3,
+      ROOM_WALL_MIN_Y = 4,
+      ROOM_WALL_MAX_Y = 5
+   };
+   
+   /**
+    * Make view of the room board. Board looks into the room, and its rendered area is the whole room. Ceiling has the same view as the single board model
+    *
+    * @param board Board to make view for
+    * @param roomMin Lower corner of the room
+    * @param roomMax Upper corner of the room
+    * @param sizeX Size of the board in X direction
+    * @param sizeY Size of the board in Y direction
+    *
+    * @return View of the board
+    */
+   OrthographicView makeRoomBoardView(RoomBoard board, const double roomMin[3], const double roomMax[3], int sizeX, int sizeY);
+   
+   /**
+    * Calculates depth for several boards that see the same geometry from different directions, like floor, walls and ceiling of the room. Geometry is
+    * copied from the model once (and again only when it changes), every view projects it with a single transform, and all views are rasterized in one 
+    * parallel pass, in bands of rows. Depth matches what GPUCalculationEngine would calculate with the null shader
+    */
+   class MultiViewScene {
+      
+   public:
+      
+      /**
+       * Number of rows rasterized by a single task
+       */
+      static const int ROWS_PER_TASK = 32;
+      
+      /**
+       * Constructor
+       *
+       * @param pool Pool to use, or 0 for the shared pool
+       */
+      MultiViewScene(ThreadPool *pool = 0);
+      
+      /**
+       * Destructor
+       */
+      virtual ~MultiViewScene();
+      
+      /**
+       * Add view
+       *
+       * @param view View to add
+       *
+       * @return Index of the view
+       */
+      virtual int addView(const OrthographicView &view);
+      
+      /**
+       * Replace view
+       *
+       * @param index Index of the view
+       * @param view New view
+       */
+      virtual void setView(int index, const OrthographicView &view);
+      
+      /**
+       * Get view
+       *
+       * @param index Index of the view
+       *
+       * @return View
+       */
+      virtual const OrthographicView &getView(int index) const;
+      
+      /**
+       * Get number of views
+       *
+       * @return Number of views
+       */
+      virtual int getNumViews() const
+      {
+         return views_.size();
+      }
+      
+      /**
+       * Remove all views
+       */
+      virtual void removeAllViews();
+      
+      /**
+       * Use geometry of the model. Geometry is copied only if it changed since the last call
+       *
+       * @param model Model to use
+       */
+      virtual void setGeometry(const GPUGeometryModel &model);
+      
+      /**
+       * Get geometry, so that it could be built or changed directly
+       *
+       * @return Geometry of the scene
+       */
+      virtual SceneGeometry &getGeometry()
+      {
+         geometryFingerprintValid_ = false;
+         return geometry_;
+      }
+      
+      /**
+       * Calculate depth of all views
+       */
+      virtual void calculate();
+      
+      /**
+       * Get value calculated for the view
+       *
+       * @param index Index of the view
+       * @param x X position
+       * @param y Y position
+       *
+       * @return Depth at that position
+       */
+      virtual double getAt(int index, int x, int y) const;
+      
+      /**
+       * Get all values calculated for the view
+       *
+       * @param index Index of the view
+       *
+       * @return Values, stored so that [x][y] corresponds to [y * sizeX + x], or 0 if view is empty
+       */
+      virtual const float *getValues(int index) const;
+      
+      /**
+       * Copy values calculated for the view to the new frame
+       *
+       * @param index Index of the view
+       * @param timeSlice Timeslice of the frame
+       *
+       * @return Frame
+       */
+      virtual FrameHandle createFrame(int index, double timeSlice) const;
+      
+      /**
+       * Get number of times geometry was copied from the model
+       *
+       * @return Number of geometry uploads
+       */
+      virtual long getNumGeometryUploads() const
+      {
+         return numGeometryUploads_;
+      }
+      
+   private:
+      
+      // copying is not supported
+      MultiViewScene(const MultiViewScene &rhs);
+      MultiViewScene &operator=(const MultiViewScene &rhs);
+      
+      friend class ProjectViewsBody;
+      friend class RasterizeViewsBody;
+      
+      /**
+       * View with its projection and the depth buffer
+       */
+      struct ViewState {
+         OrthographicView view;
+         ProjectedGeometry projection;
+         std::vector<float> depth;
+      };
+      
+      /**
+       * Pool used for the calculation
+       */
+      ThreadPool *pool_;
+      
+      /**
+       * Views
+       */
+      std::vector<ViewState *> views_;
+      
+      /**
+       * Geometry shared by all views
+       */
+      SceneGeometry geometry_;
+      
+      /**
+       * Fingerprint of the model geometry was copied from, and is it still valid
+       */
+      unsigned long long geometryFingerprint_;
+      bool geometryFingerprintValid_;
+      
+      /**
+       * Number of times geometry was copied from the model
+       */
+      long numGeometryUploads_;
+   };
+   
+} // namespace
+
+#endif
@@ -0,0 +1,576 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "GPUGeometryModel.h"
+#include "OutOfCoreFrameStore.h"
+#include "SimpleDesignByContract.h"
+#include "SoftwareRasterizer.h"
+
+using namespace hdsim;
+using namespace std;
+
+/**
+ * Magic at the start of every store file
+ */
+static const char FRAME_STORE_MAGIC[8] = {'H', 'D', 'S', 'I', 'M', 'O', 'O', 'C'};
+
+/**
+ * Version of the store file format
+ */
+static const int FRAME_STORE_VERSION = 1;
+
+struct OutOfCoreFrameStore::Header {
+   char magic[8];
+   int version;
+   int sizeX, sizeY, tileSize;
+   long long tileStride;
+   long long dataOffset;
+};
+
+namespace hdsim {
+   
+   /**
+    * Calculates tiles of the store. Tile range is the range of positions in Z-order
+    */
+   class CalculateStoreTilesBody : public TileRangeBody {
+      
+   public:
+      
+      CalculateStoreTilesBody(OutOfCoreFrameStore *store, const ProjectedGeometry &projection, const TriangleBins &bins) : store_(store),
+                                                                                                                          projection_(projection),
+                                                                                                                          bins_(bins)
+      {
+      }
+      
+      virtual void processTile(const TileRange &range) const
+      {
+         const int tileSize = store_->tileSize_;
+         
+         for (int i = range.beginX; i < range.endX; i++)
+         {
+            int tile = store_->zOrder_[i];
+            int tileX = tile % store_->numTilesX_, tileY = tile / store_->numTilesX_;
+            
+            float *values = store_->lockTile(tileX, tileY, true);
+            TileRange tileRange = store_->getTileRange(tileX, tileY);
+            
+            // Rasterizer works in the board coordinates, so depth buffer is moved to where the board origin would be
+            float *depth = values - ((long)tileRange.beginY * tileSize + tileRange.beginX);
+            
+            clearDepth(tileRange, depth, tileSize);
+            rasterizeBinnedDepth(projection_, bins_, tile, depth, tileSize);
+            
+            store_->unlockTile(tileX, tileY);
+         }
+      }
+   
+   private:
+      
+      OutOfCoreFrameStore *store_;
+      const ProjectedGeometry &projection_;
+      const TriangleBins &bins_;
+   };
+   
+} // namespace
+
+/**
+ * Spread bits of the value so that there is a zero bit between every two bits
+ */
+static unsigned long long spreadBits(unsigned int value)
+{
+   unsigned long long result = value;
+   
+   result = (result | (result << 16)) & 0x0000FFFF0000FFFFULL;
+   result = (result | (result << 8)) & 0x00FF00FF00FF00FFULL;
+   result = (result | (result << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+   result = (result | (result << 2)) & 0x3333333333333333ULL;
+   result = (result | (result << 1)) & 0x5555555555555555ULL;
+   
+   return result;
+}
+
+/**
+ * Orders tiles by their Morton code
+ */
+class MortonOrder {
+   
+public:
+   
+   MortonOrder(int numTilesX) : numTilesX_(numTilesX)
+   {
+   }
+   
+   bool operator()(int lhs, int rhs) const
+   {
+      return getCode(lhs) < getCode(rhs);
+   }
+
+private:
+   
+   unsigned long long getCode(int tile) const
+   {
+      return spreadBits(tile % numTilesX_) | (spreadBits(tile / numTilesX_) << 1);
+   }
+   
+   int numTilesX_;
+};
+
+/**
+ * Round value up to the multiple of the page size
+ */
+static long long roundUpToPage(long long value)
+{
+   long long pageSize = sysconf(_SC_PAGESIZE);
+   return (value + pageSize - 1) / pageSize * pageSize;
+}
+
+TileConsumer::~TileConsumer()
+{
+}
+
+OutOfCoreFrameStore::OutOfCoreFrameStore(int cacheSize) : fd_(-1), writable_(false), sizeX_(0), sizeY_(0), tileSize_(0), numTilesX_(0), numTilesY_(0),
+                                                          tileStride_(0), dataOffset_(0), useCounter_(0), numHits_(0), numMisses_(0),
+                                                          numEvictions_(0), numWriteBacks_(0), numPrefetches_(0)
+{
+   PRECONDITION(cacheSize > 0);
+   
+   CacheSlot empty;
+   empty.tile = -1;
+   empty.values = 0;
+   empty.lockCount = 0;
+   empty.dirty = false;
+   empty.prefetched = false;
+   empty.lastUse = 0;
+   
+   slots_.assign(cacheSize, empty);
+   
+   pthread_mutex_init(&mutex_, 0);
+   pthread_cond_init(&tileUnlocked_, 0);
+}
+
+OutOfCoreFrameStore::~OutOfCoreFrameStore()
+{
+   close();
+   
+   pthread_cond_destroy(&tileUnlocked_);
+   pthread_mutex_destroy(&mutex_);
+}
+
+void OutOfCoreFrameStore::setLayout(int sizeX, int sizeY, int tileSize)
+{
+   sizeX_ = sizeX;
+   sizeY_ = sizeY;
+   tileSize_ = tileSize;
+   numTilesX_ = (sizeX + tileSize - 1) / tileSize;
+   numTilesY_ = (sizeY + tileSize - 1) / tileSize;
+   
+   const int numTiles = numTilesX_ * numTilesY_;
+   
+   zOrder_.resize(numTiles);
+   for (int i = 0; i < numTiles; i++)
+      zOrder_[i] = i;
+   
+   sort(zOrder_.begin(), zOrder_.end(), MortonOrder(numTilesX_));
+   
+   filePosition_.resize(numTiles);
+   for (int i = 0; i < numTiles; i++)
+      filePosition_[zOrder_[i]] = i;
+   
+   tileSlot_.assign(numTiles, -1);
+}
+
+bool OutOfCoreFrameStore::create(const string &fileName, int sizeX, int sizeY, int tileSize)
+{
+   PRECONDITION(sizeX > 0  &&  sizeY > 0  &&  tileSize > 0);
+   
+   close();
+   
+   int fd = ::open(fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+   if (fd == -1)
+      return false;
+   
+   Header header;
+   memset(&header, 0, sizeof(header));
+   memcpy(header.magic, FRAME_STORE_MAGIC, sizeof(header.magic));
+   header.version = FRAME_STORE_VERSION;
+   header.sizeX = sizeX;
+   header.sizeY = sizeY;
+   header.tileSize = tileSize;
+   header.tileStride = roundUpToPage((long long)tileSize * tileSize * sizeof(float));
+   header.dataOffset = roundUpToPage(sizeof(header));
+   
+   long long numTiles = (long long)((sizeX + tileSize - 1) / tileSize) * ((sizeY + tileSize - 1) / tileSize);
+   
+   // Tiles are never written here, so the file stays sparse
+   bool success = write(fd, &header, sizeof(header)) == sizeof(header)  &&  ftruncate(fd, header.dataOffset + numTiles * header.tileStride) == 0;
+   
+   if (!success)
+   {
+      ::close(fd);
+      unlink(fileName.c_str());
+      return false;
+   }
+   
+   setLayout(sizeX, sizeY, tileSize);
+   tileStride_ = header.tileStride;
+   dataOffset_ = header.dataOffset;
+   fd_ = fd;
+   writable_ = true;
+   
+   return true;
+}
+
+bool OutOfCoreFrameStore::open(const string &fileName, bool writable)
+{
+   close();
+   
+   int fd = ::open(fileName.c_str(), writable ? O_RDWR : O_RDONLY);
+   if (fd == -1)
+      return false;
+   
+   Header header;
+   struct stat fileStat;
+   
+   bool valid = read(fd, &header, sizeof(header)) == sizeof(header)  &&  !fstat(fd, &fileStat);
+   
+   // Validate everything we would later rely on
+   valid = valid  &&  !memcmp(header.magic, FRAME_STORE_MAGIC, sizeof(header.magic))  &&  header.version == FRAME_STORE_VERSION  &&
+           header.sizeX > 0  &&  header.sizeY > 0  &&  header.tileSize > 0  &&
+           header.tileStride >= (long long)header.tileSize * header.tileSize * sizeof(float)  &&  header.tileStride == roundUpToPage(header.tileStride)  &&
+           header.dataOffset >= sizeof(header)  &&  header.dataOffset == roundUpToPage(header.dataOffset);
+   
+   long long numTiles = valid ? (long long)((header.sizeX + header.tileSize - 1) / header.tileSize) *
+                                ((header.sizeY + header.tileSize - 1) / header.tileSize) : 0;
+   
+   valid = valid  &&  header.dataOffset + numTiles * header.tileStride <= fileStat.st_size;
+   
+   if (!valid)
+   {
+      LOG("Invalid frame store file");
+      ::close(fd);
+      return false;
+   }
+   
+   setLayout(header.sizeX, header.sizeY, header.tileSize);
+   tileStride_ = header.tileStride;
+   dataOffset_ = header.dataOffset;
+   fd_ = fd;
+   writable_ = writable;
+   
+   return true;
+}
+
+bool OutOfCoreFrameStore::writeBack(CacheSlot *slot, bool synchronous)
+{
+   if (!slot->dirty)
+      return true;
+   
+   // Asynchronous write back only schedules the write, so that eviction doesn't wait for the disk
+   bool success = msync(slot->values, tileStride_, synchronous ? MS_SYNC : MS_ASYNC) == 0;
+   
+   slot->dirty = false;
+   numWriteBacks_++;
+   
+   return success;
+}
+
+bool OutOfCoreFrameStore::flush()
+{
+   if (!isOpen())
+      return true;
+   
+   pthread_mutex_lock(&mutex_);
+   
+   bool success = true;
+   for (int i = 0; i < slots_.size(); i++)
+      if (slots_[i].tile != -1)
+         success = writeBack(&slots_[i], true)  &&  success;
+   
+   pthread_mutex_unlock(&mutex_);
+   
+   return success;
+}
+
+void OutOfCoreFrameStore::close()
+{
+   if (!isOpen())
+      return;
+   
+   flush();
+   
+   for (int i = 0; i < slots_.size(); i++)
+   {
+      CacheSlot &slot = slots_[i];
+      if (slot.tile == -1)
+         continue;
+      
+      CHECK(slot.lockCount == 0, "Frame store closed while tile is locked");
+      
+      munmap(slot.values, tileStride_);
+      slot.tile = -1;
+      slot.values = 0;
+   }
+   
+   ::close(fd_);
+   fd_ = -1;
+   
+   zOrder_.clear();
+   filePosition_.clear();
+   tileSlot_.clear();
+}
+
+TileRange OutOfCoreFrameStore::getTileRange(int tileX, int tileY) const
+{
+   TileRange range;
+   
+   range.beginX = tileX * tileSize_;
+   range.beginY = tileY * tileSize_;
+   range.endX = range.beginX + tileSize_ < sizeX_ ? range.beginX + tileSize_ : sizeX_;
+   range.endY = range.beginY + tileSize_ < sizeY_ ? range.beginY + tileSize_ : sizeY_;
+   
+   return range;
+}
+
+int OutOfCoreFrameStore::findFreeSlot()
+{
+   int best = -1;
+   
+   for (int i = 0; i < slots_.size(); i++)
+   {
+      if (slots_[i].tile == -1)
+         return i;
+      
+      if (slots_[i].lockCount != 0)
+         continue;
+      
+      // Least recently used, but tiles prefetched for the upcoming reads are kept as long as possible
+      if (best == -1  ||  slots_[i].prefetched < slots_[best].prefetched  ||
+          (slots_[i].prefetched == slots_[best].prefetched  &&  slots_[i].lastUse < slots_[best].lastUse))
+         best = i;
+   }
+   
+   if (best == -1)
+      return -1;
+   
+   // Evict least recently used tile
+   CacheSlot &slot = slots_[best];
+   
+   writeBack(&slot, false);
+   munmap(slot.values, tileStride_);
+   
+   tileSlot_[slot.tile] = -1;
+   slot.tile = -1;
+   slot.values = 0;
+   numEvictions_++;
+   
+   return best;
+}
+
+bool OutOfCoreFrameStore::mapTile(int slot, int tile)
+{
+   int protection = writable_ ? PROT_READ | PROT_WRITE : PROT_READ;
+   void *values = mmap(0, tileStride_, protection, MAP_SHARED, fd_, dataOffset_ + filePosition_[tile] * tileStride_);
+   
+   if (values == MAP_FAILED)
+      return false;
+   
+   slots_[slot].tile = tile;
+   slots_[slot].values = static_cast<float *>(values);
+   slots_[slot].lockCount = 0;
+   slots_[slot].dirty = false;
+   slots_[slot].prefetched = false;
+   slots_[slot].lastUse = ++useCounter_;
+   tileSlot_[tile] = slot;
+   
+   return true;
+}
+
+float *OutOfCoreFrameStore::lockTile(int tileX, int tileY, bool write)
+{
+   PRECONDITION(isOpen());
+   PRECONDITION(tileX >= 0  &&  tileX < numTilesX_  &&  tileY >= 0  &&  tileY < numTilesY_);
+   PRECONDITION(!write  ||  writable_);
+   
+   const int tile = tileY * numTilesX_ + tileX;
+   
+   pthread_mutex_lock(&mutex_);
+   
+   if (tileSlot_[tile] != -1)
+      numHits_++;
+   else
+      numMisses_++;
+   
+   // Tile could be mapped by another thread while we wait for a free slot
+   while (tileSlot_[tile] == -1)
+   {
+      int slot = findFreeSlot();
+      
+      if (slot == -1)
+         pthread_cond_wait(&tileUnlocked_, &mutex_);
+      else
+         CHECK(mapTile(slot, tile), "Can't map tile of the frame store");
+   }
+   
+   CacheSlot &slot = slots_[tileSlot_[tile]];
+   slot.lockCount++;
+   slot.dirty = slot.dirty  ||  write;
+   slot.prefetched = false;
+   slot.lastUse = ++useCounter_;
+   
+   float *values = slot.values;
+   
+   pthread_mutex_unlock(&mutex_);
+   
+   return values;
+}
+
+void OutOfCoreFrameStore::unlockTile(int tileX, int tileY)
+{
+   PRECONDITION(tileX >= 0  &&  tileX < numTilesX_  &&  tileY >= 0  &&  tileY < numTilesY_);
+   
+   pthread_mutex_lock(&mutex_);
+   
+   int slot = tileSlot_[tileY * numTilesX_ + tileX];
+   CHECK(slot != -1  &&  slots_[slot].lockCount > 0, "Tile of the frame store is not locked");
+   
+   if (--slots_[slot].lockCount == 0)
+      pthread_cond_signal(&tileUnlocked_);
+   
+   pthread_mutex_unlock(&mutex_);
+}
+
+void OutOfCoreFrameStore::prefetchTile(int tileX, int tileY)
+{
+   PRECONDITION(isOpen());
+   PRECONDITION(tileX >= 0  &&  tileX < numTilesX_  &&  tileY >= 0  &&  tileY < numTilesY_);
+   
+   const int tile = tileY * numTilesX_ + tileX;
+   
+   pthread_mutex_lock(&mutex_);
+   
+   if (tileSlot_[tile] == -1)
+   {
+      // Prefetching never waits, it is only a hint
+      int slot = findFreeSlot();
+      
+      if (slot != -1  &&  mapTile(slot, tile))
+      {
+         madvise(slots_[slot].values, tileStride_, MADV_WILLNEED);
+         slots_[slot].prefetched = true;
+         numPrefetches_++;
+      }
+   }
+   
+   pthread_mutex_unlock(&mutex_);
+}
+
+void OutOfCoreFrameStore::streamTiles(TileConsumer *consumer, int prefetchDistance)
+{
+   PRECONDITION(consumer);
+   PRECONDITION(prefetchDistance >= 0);
+   
+   const int numTiles = zOrder_.size();
+   
+   // Prefetched tiles must not evict each other before they are consumed
+   if (prefetchDistance >= slots_.size())
+      prefetchDistance = slots_.size() - 1;
+   
+   for (int i = 0; i < prefetchDistance  &&  i < numTiles; i++)
+      prefetchTile(zOrder_[i] % numTilesX_, zOrder_[i] / numTilesX_);
+   
+   for (int i = 0; i < numTiles; i++)
+   {
+      if (prefetchDistance > 0  &&  i + prefetchDistance < numTiles)
+         prefetchTile(zOrder_[i + prefetchDistance] % numTilesX_, zOrder_[i + prefetchDistance] / numTilesX_);
+      
+      int tileX = zOrder_[i] % numTilesX_, tileY = zOrder_[i] / numTilesX_;
+      
+      const float *values = lockTile(tileX, tileY, false);
+      consumer->consumeTile(tileX, tileY, getTileRange(tileX, tileY), values, tileSize_);
+      unlockTile(tileX, tileY);
+   }
+}
+
+void OutOfCoreFrameStore::calculate(const GPUGeometryModel &model, ThreadPool *pool)
+{
+   PRECONDITION(isOpen()  &&  writable_);
+   PRECONDITION(model.getSizeX() == sizeX_  &&  model.getSizeY() == sizeY_);
+   
+   if (!pool)
+      pool = ThreadPool::getSharedPool();
+   
+   SceneGeometry scene;
+   scene.setFromModel(model);
+   
+   ProjectedGeometry projection;
+   projection.project(scene, getModelView(model));
+   
+   TriangleBins bins;
+   bins.bin(projection, tileSize_, pool);
+   
+   // In Z-order, so that tiles are written to the file mostly sequentially
+   parallelFor2D(pool, zOrder_.size(), 1, 1, 1, CalculateStoreTilesBody(this, projection, bins));
+}
+
+double OutOfCoreFrameStore::getAt(int x, int y)
+{
+   PRECONDITION(x >= 0  &&  x < sizeX_  &&  y >= 0  &&  y < sizeY_);
+   
+   int tileX = x / tileSize_, tileY = y / tileSize_;
+   
+   const float *values = lockTile(tileX, tileY, false);
+   double value = values[(y - tileY * tileSize_) * tileSize_ + x - tileX * tileSize_];
+   unlockTile(tileX, tileY);
+   
+   return value;
+}
+
+void OutOfCoreFrameStore::readRegion(const TileRange &range, float *values)
+{
+   PRECONDITION(range.beginX >= 0  &&  range.endX <= sizeX_  &&  range.beginY >= 0  &&  range.endY <= sizeY_);
+   PRECONDITION(values);
+   
+   if (range.beginX >= range.endX  ||  range.beginY >= range.endY)
+      return;
+   
+   const int regionSizeX = range.endX - range.beginX;
+   
+   for (int tileY = range.beginY / tileSize_; tileY <= (range.endY - 1) / tileSize_; tileY++)
+      for (int tileX = range.beginX / tileSize_; tileX <= (range.endX - 1) / tileSize_; tileX++)
+      {
+         TileRange tileRange = getTileRange(tileX, tileY);
+         int beginX = max(tileRange.beginX, range.beginX), endX = min(tileRange.endX, range.endX);
+         int beginY = max(tileRange.beginY, range.beginY), endY = min(tileRange.endY, range.endY);
+         
+         const float *tile = lockTile(tileX, tileY, false);
+         
+         for (int y = beginY; y < endY; y++)
+            memcpy(values + (y - range.beginY) * regionSizeX + beginX - range.beginX,
+                   tile + (y - tileRange.beginY) * tileSize_ + beginX - tileRange.beginX, (endX - beginX) * sizeof(float));
+         
+         unlockTile(tileX, tileY);
+      }
+}
@@ -0,0 +1,475 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OUT_OF_CORE_FRAME_STORE_H_
+#define OUT_OF_CORE_FRAME_STORE_H_
+
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+
+#include "ThreadPool.h"
+
+namespace hdsim {
+   
+   class GPUGeometryModel;
+   
+   /**
+    * Receives tiles streamed from the OutOfCoreFrameStore
+    */
+   class TileConsumer {
+      
+   public:
+      
+      /**
+       * Destructor
+       */
+      virtual ~TileConsumer();
+      
+      /**
+       * Consume the tile. Values are valid only during the call
+       *
+       * @param tileX Index of the tile in X direction
+       * @param tileY Index of the tile in Y direction
+       * @param range Moxels of the board covered by the tile
+       * @param values Values of the tile, so that moxel [x][y] of the board is at [(y - range.beginY) * stride + x - range.beginX]
+       * @param stride Distance between rows of the tile
+       */
+      virtual void consumeTile(int tileX, int tileY, const TileRange &range, const float *values, int stride) = 0;
+   };
+   
+   /**
+    * Frame of the board bigger than the memory, stored in the file split into square tiles. Tiles are stored in Z-order (Morton order) of their
+    * positions, so tiles close on the board are close in the file, and streaming the frame in Z-order reads the file sequentially.
+    *
+    * Tiles are accessed through the explicit cache of memory mapped tiles: lockTile() maps the tile (evicting the least recently used tile that is
+    * not locked) and keeps it mapped until unlockTile(). Modified tiles are written back when they are evicted and on flush(). Only the tiles in
+    * the cache are mapped, so address space and resident memory are bounded by the cache size, not by the size of the board.
+    *
+    * Locking and unlocking of tiles is thread safe, so tiles could be calculated and consumed in parallel. File format is native byte order.
+    */
+   class OutOfCoreFrameStore {
+      
+      friend class CalculateStoreTilesBody;
+   
+   public:
+      
+      /**
+       * Default size of the tile, in moxels. Tile of floats is then 256 KB
+       */
+      static const int DEFAULT_TILE_SIZE = 256;
+      
+      /**
+       * Default number of tiles in the cache
+       */
+      static const int DEFAULT_CACHE_SIZE = 256;
+      
+      /**
+       * Default number of tiles prefetched ahead of the tile being streamed
+       */
+      static const int DEFAULT_PREFETCH_DISTANCE = 8;
+      
+      /**
+       * Constructor
+       *
+       * @param cacheSize Max number of tiles mapped at the same time
+       */
+      OutOfCoreFrameStore(int cacheSize = DEFAULT_CACHE_SIZE);
+      
+      /**
+       * Destructor. Writes back modified tiles and closes the file
+       */
+      virtual ~OutOfCoreFrameStore();
+      
+      /**
+       * Create new store file. All values are 0 until written. File is sparse, so disk space is used only for the tiles that are written
+       *
+       * @param fileName File to create. Existing file is overwritten
+       * @param sizeX Size of the board in X direction
+       * @param sizeY Size of the board in Y direction
+       * @param tileSize Size of the tile
+       *
+       * @return Was file created
+       */
+      virtual bool create(const std::string &fileName, int sizeX, int sizeY, int tileSize = DEFAULT_TILE_SIZE);
+      
+      /**
+       * Open existing store file
+       *
+       * @param fileName File to open
+       * @param writable Should tiles be writable
+       *
+       * @return Was file opened and valid
+       */
+      virtual bool open(const std::string &fileName, bool writable = false);
+      
+      /**
+       * Write back all modified tiles and wait until they are on the disk
+       *
+       * @return Were all tiles written
+       */
+      virtual bool flush();
+      
+      /**
+       * Write back modified tiles, unmap all tiles and close the file. No tile may be locked
+       */
+      virtual void close();
+      
+      /**
+       * Is store file opened
+       *
+       * @return Is store opened
+       */
+      virtual bool isOpen() const
+      {
+         return fd_ != -1;
+      }
+      
+      /**
+       * Get size of the board in X direction
+       *
+       * @return Size of the board
+       */
+      virtual int getSizeX() const
+      {
+         return sizeX_;
+      }
+      
+      /**
+       * Get size of the board in Y direction
+       *
+       * @return Size of the board
+       */
+      virtual int getSizeY() const
+      {
+         return sizeY_;
+      }
+      
+      /**
+       * Get size of the tile
+       *
+       * @return Size of the tile
+       */
+      virtual int getTileSize() const
+      {
+         return tileSize_;
+      }
+      
+      /**
+       * Get number of tiles in X direction
+       *
+       * @return Number of tiles
+       */
+      virtual int getNumTilesX() const
+      {
+         return numTilesX_;
+      }
+      
+      /**
+       * Get number of tiles in Y direction
+       *
+       * @return Number of tiles
+       */
+      virtual int getNumTilesY() const
+      {
+         return numTilesY_;
+      }
+      
+      /**
+       * Get max number of tiles mapped at the same time
+       *
+       * @return Size of the cache, in tiles
+       */
+      virtual int getCacheSize() const
+      {
+         return slots_.size();
+      }
+      
+      /**
+       * Get moxels of the board covered by the tile
+       *
+       * @param tileX Index of the tile in X direction
+       * @param tileY Index of the tile in Y direction
+       *
+       * @return Range of the tile
+       */
+      virtual TileRange getTileRange(int tileX, int tileY) const;
+      
+      /**
+       * Get tile at the position in Z-order, which is the order in which tiles are stored in the file
+       *
+       * @param index Position in Z-order, from 0 to getNumTilesX() * getNumTilesY() - 1
+       *
+       * @return Index of the tile, tileY * getNumTilesX() + tileX
+       */
+      virtual int getTileInZOrder(int index) const
+      {
+         return zOrder_[index];
+      }
+      
+      /**
+       * Map the tile, if it is not in the cache, and lock it in the cache. If all tiles in the cache are locked, waits until one is unlocked
+       *
+       * @param tileX Index of the tile in X direction
+       * @param tileY Index of the tile in Y direction
+       * @param write Would tile be modified. Modified tiles are written back to the file. Store must be writable
+       *
+       * @return Values of the tile, getTileSize() x getTileSize() stored by rows. Valid until tile is unlocked
+       */
+      virtual float *lockTile(int tileX, int tileY, bool write);
+      
+      /**
+       * Unlock the tile locked by lockTile(). Tile stays in the cache until it is evicted
+       *
+       * @param tileX Index of the tile in X direction
+       * @param tileY Index of the tile in Y direction
+       */
+      virtual void unlockTile(int tileX, int tileY);
+      
+      /**
+       * Map the tile into the cache, if there is a tile that could be evicted, and ask the OS to start reading it. Doesn't wait for the read
+       *
+       * @param tileX Index of the tile in X direction
+       * @param tileY Index of the tile in Y direction
+       */
+      virtual void prefetchTile(int tileX, int tileY);
+      
+      /**
+       * Pass all tiles to the consumer in Z-order, prefetching the tiles ahead
+       *
+       * @param consumer Consumer of the tiles
+       * @param prefetchDistance Number of tiles to prefetch ahead of the consumed one, or 0 for no prefetching
+       */
+      virtual void streamTiles(TileConsumer *consumer, int prefetchDistance = DEFAULT_PREFETCH_DISTANCE);
+      
+      /**
+       * Calculate depth of the model directly into the tiles, the same way TiledDepthEngine does, without ever holding the whole board in memory. Size
+       * of the model must be the same as the size of the store, and store must be writable
+       *
+       * @param model Model to calculate
+       * @param pool Pool used to calculate tiles in parallel, or 0 for the shared pool
+       */
+      virtual void calculate(const GPUGeometryModel &model, ThreadPool *pool = 0);
+      
+      /**
+       * Get value at the particular location
+       *
+       * @param x X position
+       * @param y Y position
+       *
+       * @return Value at that position
+       */
+      virtual double getAt(int x, int y);
+      
+      /**
+       * Read the region of the board
+       *
+       * @param range Region to read
+       * @param values (OUT) Values, stored so that [x][y] of the region corresponds to [(y - beginY) * (endX - beginX) + x - beginX]
+       */
+      virtual void readRegion(const TileRange &range, float *values);
+      
+      /**
+       * Get number of lockTile() calls that found tile in the cache
+       *
+       * @return Number of cache hits
+       */
+      virtual long getNumHits() const
+      {
+         return numHits_;
+      }
+      
+      /**
+       * Get number of lockTile() calls that had to map the tile
+       *
+       * @return Number of cache misses
+       */
+      virtual long getNumMisses() const
+      {
+         return numMisses_;
+      }
+      
+      /**
+       * Get number of tiles unmapped to make space for other tiles
+       *
+       * @return Number of evictions
+       */
+      virtual long getNumEvictions() const
+      {
+         return numEvictions_;
+      }
+      
+      /**
+       * Get number of modified tiles written back to the file
+       *
+       * @return Number of write backs
+       */
+      virtual long getNumWriteBacks() const
+      {
+         return numWriteBacks_;
+      }
+      
+      /**
+       * Get number of tiles mapped by prefetchTile()
+       *
+       * @return Number of prefetched tiles
+       */
+      virtual long getNumPrefetches() const
+      {
+         return numPrefetches_;
+      }
+   
+   private:
+      
+      // copying is not supported
+      OutOfCoreFrameStore(const OutOfCoreFrameStore &rhs);
+      OutOfCoreFrameStore &operator=(const OutOfCoreFrameStore &rhs);
+      
+      struct Header;
+      
+      /**
+       * Tile mapped in the cache
+       */
+      struct CacheSlot {
+         /**
+          * Index of the tile, or -1 if slot is empty
+          */
+         int tile;
+         
+         /**
+          * Mapped values of the tile
+          */
+         float *values;
+         
+         /**
+          * Number of lockTile() calls not yet unlocked
+          */
+         int lockCount;
+         
+         /**
+          * Was tile modified since it was written back
+          */
+         bool dirty;
+         
+         /**
+          * Was tile mapped by prefetchTile() and not locked since. Such tiles are evicted only if there is no other tile to evict
+          */
+         bool prefetched;
+         
+         /**
+          * When was the tile last used, for the LRU eviction
+          */
+         unsigned long lastUse;
+      };
+      
+      /**
+       * Set sizes and the Z-order of the tiles
+       */
+      void setLayout(int sizeX, int sizeY, int tileSize);
+      
+      /**
+       * Map the file and prepare the cache, after header is read or written
+       *
+       * @return Was file valid
+       */
+      bool openFile(int fd, bool writable);
+      
+      /**
+       * Find slot into which tile could be mapped, evicting its tile. Must be called with mutex held
+       *
+       * @return Index of the slot, or -1 if all slots are locked
+       */
+      int findFreeSlot();
+      
+      /**
+       * Map tile into the slot. Must be called with mutex held
+       *
+       * @return Was tile mapped
+       */
+      bool mapTile(int slot, int tile);
+      
+      /**
+       * Write back the tile of the slot if it is modified. Must be called with mutex held
+       *
+       * @param synchronous Should we wait until the tile is on the disk
+       *
+       * @return Was tile written back
+       */
+      bool writeBack(CacheSlot *slot, bool synchronous);
+      
+      /**
+       * Opened file, or -1
+       */
+      int fd_;
+      
+      /**
+       * Is file writable
+       */
+      bool writable_;
+      
+      /**
+       * Size of the board and tiles
+       */
+      int sizeX_, sizeY_, tileSize_, numTilesX_, numTilesY_;
+      
+      /**
+       * Bytes between starts of the two tiles in the file, and offset of the first tile. Both are multiple of the page size, so tiles could be
+       * mapped independently
+       */
+      long long tileStride_, dataOffset_;
+      
+      /**
+       * Tiles in Z-order, and position of every tile in the file
+       */
+      std::vector<int> zOrder_, filePosition_;
+      
+      /**
+       * Cache slots
+       */
+      std::vector<CacheSlot> slots_;
+      
+      /**
+       * Slot of every tile, or -1 if tile is not mapped
+       */
+      std::vector<int> tileSlot_;
+      
+      /**
+       * Counter used to order slots by their last use
+       */
+      unsigned long useCounter_;
+      
+      /**
+       * Statistics
+       */
+      long numHits_, numMisses_, numEvictions_, numWriteBacks_, numPrefetches_;
+      
+      /**
+       * Guards the cache
+       */
+      pthread_mutex_t mutex_;
+      
+      /**
+       * Signaled when tile is unlocked
+       */
+      pthread_cond_t tileUnlocked_;
+   };
+   
+} // namespace
+
+#endif
@@ -0,0 +1,505 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#include "RayCastEngine.h"
+#include "GPUGeometryModel.h"
+#include "SimpleDesignByContract.h"
+
+using namespace hdsim;
+using namespace std;
+
+/**
+ * Max depth of the traversal stack. Hierarchy is balanced, so this is enough for any model that fits in memory
+ */
+static const int MAX_STACK_SIZE = 64;
+
+/**
+ * Number of floats per triangle in the bounds used during build: minX, minY, maxX, maxY, maxZ
+ */
+static const int NUM_BOUNDS = 5;
+
+/**
+ * Orders triangles by the center along one axis
+ */
+struct CenterLess {
+   
+   CenterLess(const float *center) : center_(center)
+   {
+   }
+   
+   bool operator()(int lhs, int rhs) const
+   {
+      return center_[lhs] < center_[rhs];
+   }
+   
+   const float *center_;
+};
+
+namespace hdsim {
+   
+   /**
+    * Traces range of probes
+    */
+   class ProbeBatchBody : public TileRangeBody {
+      
+   public:
+      
+      ProbeBatchBody(const RayCastEngine *engine, const MoxelProbe *probes, float *values) : engine_(engine), probes_(probes), values_(values)
+      {
+      }
+      
+      virtual void processTile(const TileRange &range) const
+      {
+         const RayCastEngine &e = *engine_;
+         int i = range.beginX;
+         
+         for (; i + 4 <= range.endX; i += 4)
+         {
+            float x[4], y[4], hitZ[4];
+            
+            for (int j = 0; j < 4; j++)
+            {
+               x[j] = (float)(e.originX_ + (probes_[i + j].x + 0.5) * e.moxelSizeX_);
+               y[j] = (float)(e.originY_ + (probes_[i + j].y + 0.5) * e.moxelSizeY_);
+            }
+            
+            e.tracePacket(x, y, hitZ);
+            
+            for (int j = 0; j < 4; j++)
+               values_[i + j] = e.toDepth(hitZ[j]);
+         }
+         
+         for (; i < range.endX; i++)
+            values_[i] = (float)e.getAt(probes_[i].x, probes_[i].y);
+      }
+      
+   private:
+      
+      const RayCastEngine *engine_;
+      const MoxelProbe *probes_;
+      float *values_;
+   };
+   
+   /**
+    * Calculates band of rows of the board, four neighbouring moxels per packet
+    */
+   class BoardRowsBody : public TileRangeBody {
+      
+   public:
+      
+      BoardRowsBody(const RayCastEngine *engine, float *values) : engine_(engine), values_(values)
+      {
+      }
+      
+      virtual void processTile(const TileRange &range) const
+      {
+         const RayCastEngine &e = *engine_;
+         
+         for (int row = range.beginY; row < range.endY; row++)
+         {
+            float y[4];
+            fill(y, y + 4, (float)(e.originY_ + (row + 0.5) * e.moxelSizeY_));
+            
+            float *out = values_ + row * e.sizeX_;
+            int column = range.beginX;
+            
+            for (; column + 4 <= range.endX; column += 4)
+            {
+               float x[4], hitZ[4];
+               
+               for (int j = 0; j < 4; j++)
+                  x[j] = (float)(e.originX_ + (column + j + 0.5) * e.moxelSizeX_);
+               
+               e.tracePacket(x, y, hitZ);
+               
+               for (int j = 0; j < 4; j++)
+                  out[column + j] = e.toDepth(hitZ[j]);
+            }
+            
+            for (; column < range.endX; column++)
+               out[column] = (float)e.getAt(column, row);
+         }
+      }
+      
+   private:
+      
+      const RayCastEngine *engine_;
+      float *values_;
+   };
+   
+} // namespace
+
+RayCastEngine::RayCastEngine(ThreadPool *pool) : pool_(pool ? pool : ThreadPool::getSharedPool()), geometryFingerprint_(0), wasBuilt_(false), sizeX_(0), 
+                                                 sizeY_(0), moxelSizeX_(0), moxelSizeY_(0), originX_(0), originY_(0), topZ_(0), bottomZ_(0), 
+                                                 depthRange_(1), numBuilds_(0)
+{
+}
+
+RayCastEngine::~RayCastEngine()
+{
+}
+
+void RayCastEngine::update(const GPUGeometryModel &model)
+{
+   sizeX_ = model.getSizeX();
+   sizeY_ = model.getSizeY();
+   
+   // Moxel centers, and the planes of GPUCalculationEngine
+   originX_ = model.getRenderedAreaMinX();
+   originY_ = model.getRenderedAreaMinY();
+   moxelSizeX_ = sizeX_ ? (model.getRenderedAreaMaxX() - originX_) / sizeX_ : 0;
+   moxelSizeY_ = sizeY_ ? (model.getRenderedAreaMaxY() - originY_) / sizeY_ : 0;
+   
+   double depthRange = model.getRenderedAreaMaxZ() - model.getRenderedAreaMinZ() + FLOATING_POINTS_LOW_PRECISION_EQUAL_DELTA;
+   
+   topZ_ = (float)(model.getRenderedAreaMaxZ() + FLOATING_POINTS_LOW_PRECISION_EQUAL_DELTA);
+   bottomZ_ = (float)model.getRenderedAreaMinZ();
+   depthRange_ = (float)depthRange;
+   
+   unsigned long long fingerprint = model.getGeometryFingerprint();
+   if (wasBuilt_  &&  fingerprint == geometryFingerprint_)
+      return;
+   
+   int numTriangles = model.getNumTriangles();
+   
+   vector<float> edges(9 * numTriangles), plane(3 * numTriangles), triangleBounds(NUM_BOUNDS * numTriangles);
+   vector<float> centerX(numTriangles), centerY(numTriangles);
+   vector<unsigned char> topLeft(3 * numTriangles);
+   vector<int> order;
+   order.reserve(numTriangles);
+   
+   for (int i = 0; i < numTriangles; i++)
+   {
+      const TriangleByPointIndexes &triangle = model.getTriangle(i);
+      const Point *points[3] = {&model.getPoint(triangle.getIndex1()), &model.getPoint(triangle.getIndex2()), &model.getPoint(triangle.getIndex3())};
+      
+      double x[3], y[3], z[3];
+      for (int j = 0; j < 3; j++)
+      {
+         x[j] = points[j]->getX();
+         y[j] = points[j]->getY();
+         z[j] = points[j]->getZ();
+      }
+      
+      // Triangles seen edge on never cover a moxel
+      double area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+      if (area == 0)
+         continue;
+      
+      if (area < 0)
+      {
+         swap(x[1], x[2]);
+         swap(y[1], y[2]);
+         swap(z[1], z[2]);
+         area = -area;
+      }
+      
+      for (int j = 0; j < 3; j++)
+      {
+         int next = (j + 1) % 3;
+         double a = y[j] - y[next], b = x[next] - x[j];
+         
+         edges[9 * i + j] = (float)a;
+         edges[9 * i + 3 + j] = (float)b;
+         edges[9 * i + 6 + j] = (float)(-a * x[j] - b * y[j]);
+         topLeft[3 * i + j] = a > 0  ||  (a == 0  &&  b < 0);
+      }
+      
+      double p = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+      double q = ((x[1] - x[0]) * (z[2] - z[0]) - (x[2] - x[0]) * (z[1] - z[0])) / area;
+      
+      plane[3 * i] = (float)p;
+      plane[3 * i + 1] = (float)q;
+      plane[3 * i + 2] = (float)(z[0] - p * x[0] - q * y[0]);
+      
+      float *bounds = &triangleBounds[NUM_BOUNDS * i];
+      bounds[0] = (float)min(x[0], min(x[1], x[2]));
+      bounds[1] = (float)min(y[0], min(y[1], y[2]));
+      bounds[2] = (float)max(x[0], max(x[1], x[2]));
+      bounds[3] = (float)max(y[0], max(y[1], y[2]));
+      bounds[4] = (float)max(z[0], max(z[1], z[2]));
+      
+      centerX[i] = (bounds[0] + bounds[2]) / 2;
+      centerY[i] = (bounds[1] + bounds[3]) / 2;
+      
+      order.push_back(i);
+   }
+   
+   nodes_.clear();
+   
+   if (!order.empty())
+   {
+      nodes_.reserve(2 * order.size() / MAX_LEAF_SIZE + 1);
+      build(0, order.size(), &order, centerX, centerY, triangleBounds);
+   }
+   
+   // Store triangles in the leaf order, so that every leaf reads consecutive memory
+   int numUsed = order.size();
+   
+   edgeA_.resize(3 * numUsed);
+   edgeB_.resize(3 * numUsed);
+   edgeC_.resize(3 * numUsed);
+   topLeft_.resize(3 * numUsed);
+   planeP_.resize(numUsed);
+   planeQ_.resize(numUsed);
+   planeR_.resize(numUsed);
+   
+   for (int i = 0; i < numUsed; i++)
+   {
+      int source = order[i];
+      
+      for (int j = 0; j < 3; j++)
+      {
+         edgeA_[3 * i + j] = edges[9 * source + j];
+         edgeB_[3 * i + j] = edges[9 * source + 3 + j];
+         edgeC_[3 * i + j] = edges[9 * source + 6 + j];
+         topLeft_[3 * i + j] = topLeft[3 * source + j];
+      }
+      
+      planeP_[i] = plane[3 * source];
+      planeQ_[i] = plane[3 * source + 1];
+      planeR_[i] = plane[3 * source + 2];
+   }
+   
+   geometryFingerprint_ = fingerprint;
+   wasBuilt_ = true;
+   numBuilds_++;
+}
+
+int RayCastEngine::build(int begin, int end, vector<int> *order, const vector<float> &centerX, const vector<float> &centerY, 
+                         const vector<float> &triangleBounds)
+{
+   int index = nodes_.size();
+   nodes_.push_back(Node());
+   
+   Node node;
+   node.minX = node.minY = HUGE_VALF;
+   node.maxX = node.maxY = node.maxZ = -HUGE_VALF;
+   
+   float minCenterX = HUGE_VALF, maxCenterX = -HUGE_VALF, minCenterY = HUGE_VALF, maxCenterY = -HUGE_VALF;
+   
+   for (int i = begin; i < end; i++)
+   {
+      int triangle = (*order)[i];
+      const float *bounds = &triangleBounds[NUM_BOUNDS * triangle];
+      
+      node.minX = min(node.minX, bounds[0]);
+      node.minY = min(node.minY, bounds[1]);
+      node.maxX = max(node.maxX, bounds[2]);
+      node.maxY = max(node.maxY, bounds[3]);
+      node.maxZ = max(node.maxZ, bounds[4]);
+      
+      minCenterX = min(minCenterX, centerX[triangle]);
+      maxCenterX = max(maxCenterX, centerX[triangle]);
+      minCenterY = min(minCenterY, centerY[triangle]);
+      maxCenterY = max(maxCenterY, centerY[triangle]);
+   }
+   
+   if (end - begin <= MAX_LEAF_SIZE)
+   {
+      node.first = begin;
+      node.count = end - begin;
+      nodes_[index] = node;
+      
+      return index;
+   }
+   
+   // Median split along the longer extent of the centers
+   int middle = (begin + end) / 2;
+   const vector<float> &center = maxCenterX - minCenterX >= maxCenterY - minCenterY ? centerX : centerY;
+   nth_element(order->begin() + begin, order->begin() + middle, order->begin() + end, CenterLess(&center[0]));
+   
+   build(begin, middle, order, centerX, centerY, triangleBounds);
+   
+   node.first = build(middle, end, order, centerX, centerY, triangleBounds);
+   node.count = 0;
+   nodes_[index] = node;
+   
+   return index;
+}
+
+float RayCastEngine::trace(float x, float y) const
+{
+   float nearestZ = -HUGE_VALF;
+   
+   if (nodes_.empty())
+      return nearestZ;
+   
+   int stack[MAX_STACK_SIZE];
+   int stackSize = 0;
+   stack[stackSize++] = 0;
+   
+   while (stackSize)
+   {
+      int index = stack[--stackSize];
+      const Node &node = nodes_[index];
+      
+      if (x < node.minX  ||  x > node.maxX  ||  y < node.minY  ||  y > node.maxY  ||  node.maxZ <= nearestZ)
+         continue;
+      
+      if (node.count)
+      {
+         for (int i = node.first; i < node.first + node.count; i++)
+         {
+            bool inside = true;
+            
+            for (int j = 3 * i; j < 3 * i + 3; j++)
+            {
+               float edge = edgeA_[j] * x + edgeB_[j] * y + edgeC_[j];
+               inside = inside  &&  (edge > 0  ||  (edge == 0  &&  topLeft_[j]));
+            }
+            
+            float z = planeP_[i] * x + planeQ_[i] * y + planeR_[i];
+            
+            if (inside  &&  z <= topZ_  &&  z > bottomZ_  &&  z > nearestZ)
+               nearestZ = z;
+         }
+         
+         continue;
+      }
+      
+      CHECK(stackSize + 2 <= MAX_STACK_SIZE, "Hierarchy is too deep");
+      
+      // Child that could be closer is visited first
+      int first = index + 1, second = node.first;
+      if (nodes_[first].maxZ < nodes_[second].maxZ)
+         swap(first, second);
+      
+      stack[stackSize++] = second;
+      stack[stackSize++] = first;
+   }
+   
+   return nearestZ;
+}
+
+void RayCastEngine::tracePacket(const float *x, const float *y, float *hitZ) const
+{
+#ifdef __SSE__
+   __m128 nearestZ = _mm_set1_ps(-HUGE_VALF);
+   
+   if (nodes_.empty())
+   {
+      _mm_storeu_ps(hitZ, nearestZ);
+      return;
+   }
+   
+   const __m128 rayX = _mm_loadu_ps(x), rayY = _mm_loadu_ps(y);
+   const __m128 topZ = _mm_set1_ps(topZ_), bottomZ = _mm_set1_ps(bottomZ_), zero = _mm_setzero_ps();
+   
+   int stack[MAX_STACK_SIZE];
+   int stackSize = 0;
+   stack[stackSize++] = 0;
+   
+   while (stackSize)
+   {
+      int index = stack[--stackSize];
+      const Node &node = nodes_[index];
+      
+      // Node is visited if any ray of the packet could hit it closer than its nearest hit so far
+      __m128 active = _mm_and_ps(_mm_cmpge_ps(rayX, _mm_set1_ps(node.minX)), _mm_cmple_ps(rayX, _mm_set1_ps(node.maxX)));
+      active = _mm_and_ps(active, _mm_and_ps(_mm_cmpge_ps(rayY, _mm_set1_ps(node.minY)), _mm_cmple_ps(rayY, _mm_set1_ps(node.maxY))));
+      active = _mm_and_ps(active, _mm_cmpgt_ps(_mm_set1_ps(node.maxZ), nearestZ));
+      
+      if (!_mm_movemask_ps(active))
+         continue;
+      
+      if (node.count)
+      {
+         for (int i = node.first; i < node.first + node.count; i++)
+         {
+            __m128 inside = active;
+            
+            for (int j = 3 * i; j < 3 * i + 3; j++)
+            {
+               __m128 edge = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(edgeA_[j]), rayX), _mm_mul_ps(_mm_set1_ps(edgeB_[j]), rayY)), 
+                                        _mm_set1_ps(edgeC_[j]));
+               __m128 covered = topLeft_[j] ? _mm_cmpge_ps(edge, zero) : _mm_cmpgt_ps(edge, zero);
+               inside = _mm_and_ps(inside, covered);
+            }
+            
+            __m128 z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planeP_[i]), rayX), _mm_mul_ps(_mm_set1_ps(planeQ_[i]), rayY)), 
+                                  _mm_set1_ps(planeR_[i]));
+            
+            __m128 hit = _mm_and_ps(inside, _mm_and_ps(_mm_cmple_ps(z, topZ), _mm_cmpgt_ps(z, bottomZ)));
+            hit = _mm_and_ps(hit, _mm_cmpgt_ps(z, nearestZ));
+            
+            nearestZ = _mm_or_ps(_mm_and_ps(hit, z), _mm_andnot_ps(hit, nearestZ));
+         }
+         
+         continue;
+      }
+      
+      CHECK(stackSize + 2 <= MAX_STACK_SIZE, "Hierarchy is too deep");
+      
+      int first = index + 1, second = node.first;
+      if (nodes_[first].maxZ < nodes_[second].maxZ)
+         swap(first, second);
+      
+      stack[stackSize++] = second;
+      stack[stackSize++] = first;
+   }
+   
+   _mm_storeu_ps(hitZ, nearestZ);
+#else
+   for (int i = 0; i < 4; i++)
+      hitZ[i] = trace(x[i], y[i]);
+#endif
+}
+
+float RayCastEngine::toDepth(float hitZ) const
+{
+   if (hitZ == -HUGE_VALF)
+      return 1;
+   
+   return (topZ_ - hitZ) / depthRange_;
+}
+
+double RayCastEngine::getAt(int x, int y) const
+{
+   PRECONDITION(x >= 0  &&  x < sizeX_  &&  y >= 0  &&  y < sizeY_);
+   
+   return toDepth(trace((float)(originX_ + (x + 0.5) * moxelSizeX_), (float)(originY_ + (y + 0.5) * moxelSizeY_)));
+}
+
+void RayCastEngine::getValues(const MoxelProbe *probes, int numProbes, float *values) const
+{
+   PRECONDITION(numProbes >= 0);
+   
+   if (!numProbes)
+      return;
+   
+   for (int i = 0; i < numProbes; i++)
+      CHECK(probes[i].x >= 0  &&  probes[i].x < sizeX_  &&  probes[i].y >= 0  &&  probes[i].y < sizeY_, "Probe outside of the board");
+   
+   parallelFor2D(pool_, numProbes, 1, PROBES_PER_TASK, 1, ProbeBatchBody(this, probes, values));
+}
+
+void RayCastEngine::calculateBoard(float *values) const
+{
+   if (!sizeX_  ||  !sizeY_)
+      return;
+   
+   parallelFor2D(pool_, sizeX_, sizeY_, sizeX_, ROWS_PER_TASK, BoardRowsBody(this, values));
+}
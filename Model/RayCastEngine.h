@@ -0,0 +1,243 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RAY_CAST_ENGINE_H_
+#define RAY_CAST_ENGINE_H_
+
+#include <vector>
+
+#include "ThreadPool.h"
+
+namespace hdsim {
+   
+   class GPUGeometryModel;
+   
+   /**
+    * Moxel whose depth is queried
+    */
+   struct MoxelProbe {
+      int x, y;
+   };
+   
+   /**
+    * Calculates depth of the individual moxels by casting one vertical ray per moxel, for the control loops that need only few moxels (safety sensors, 
+    * calibration points) and can't wait for the whole board. Rays are intersected with the bounding volume hierarchy of the model triangles, built in 
+    * the XY plane and bounded by max Z, so that subtrees which can't be closer than the hit already found are skipped. Hierarchy is built again only 
+    * when geometry of the model changes; rendered area and size of the board could change freely.
+    *
+    * Batches are traced in packets of four rays (using SSE where available) and split between the threads of the pool. Values match 
+    * GPUCalculationEngine with the null shader, so the whole board could be calculated for comparison with the raster path
+    */
+   class RayCastEngine {
+      
+   public:
+      
+      /**
+       * Max number of triangles in the leaf of the hierarchy
+       */
+      static const int MAX_LEAF_SIZE = 4;
+      
+      /**
+       * Number of probes traced by a single task
+       */
+      static const int PROBES_PER_TASK = 256;
+      
+      /**
+       * Number of board rows calculated by a single task
+       */
+      static const int ROWS_PER_TASK = 16;
+      
+      /**
+       * Constructor
+       *
+       * @param pool Pool to use, or 0 for the shared pool
+       */
+      RayCastEngine(ThreadPool *pool = 0);
+      
+      /**
+       * Destructor
+       */
+      virtual ~RayCastEngine();
+      
+      /**
+       * Use the model for the following queries. Hierarchy is built only if geometry changed since the last call
+       *
+       * @param model Model to use
+       */
+      virtual void update(const GPUGeometryModel &model);
+      
+      /**
+       * Get depth of the single moxel
+       *
+       * @param x X position
+       * @param y Y position
+       *
+       * @return Depth at that position
+       */
+      virtual double getAt(int x, int y) const;
+      
+      /**
+       * Get depth of many moxels. Probes close to each other should be next to each other, as they are traced in packets
+       *
+       * @param probes Moxels to query
+       * @param numProbes Number of moxels
+       * @param values (OUT) Depth of every moxel
+       */
+      virtual void getValues(const MoxelProbe *probes, int numProbes, float *values) const;
+      
+      /**
+       * Calculate the whole board
+       *
+       * @param values (OUT) Values, stored so that [x][y] corresponds to [y * sizeX + x]
+       */
+      virtual void calculateBoard(float *values) const;
+      
+      /**
+       * Get number of times hierarchy was built
+       *
+       * @return Number of builds
+       */
+      virtual long getNumBuilds() const
+      {
+         return numBuilds_;
+      }
+      
+      /**
+       * Get number of nodes in the hierarchy
+       *
+       * @return Number of nodes
+       */
+      virtual int getNumNodes() const
+      {
+         return nodes_.size();
+      }
+      
+      /**
+       * Get size of the board in X direction
+       *
+       * @return Size in X direction
+       */
+      virtual int getSizeX() const
+      {
+         return sizeX_;
+      }
+      
+      /**
+       * Get size of the board in Y direction
+       *
+       * @return Size in Y direction
+       */
+      virtual int getSizeY() const
+      {
+         return sizeY_;
+      }
+      
+   private:
+      
+      // copying is not supported
+      RayCastEngine(const RayCastEngine &rhs);
+      RayCastEngine &operator=(const RayCastEngine &rhs);
+      
+      friend class ProbeBatchBody;
+      friend class BoardRowsBody;
+      
+      /**
+       * Node of the hierarchy. Bounds are in XY, plus max Z of all triangles below. Inner node has its first child right after it and the second one
+       * at the index given by first; leaf has count triangles starting at first
+       */
+      struct Node {
+         float minX, minY, maxX, maxY, maxZ;
+         int first, count;
+      };
+      
+      /**
+       * Build hierarchy over the triangles [begin, end) of the order
+       *
+       * @return Index of the node
+       */
+      int build(int begin, int end, std::vector<int> *order, const std::vector<float> &centerX, const std::vector<float> &centerY, 
+                const std::vector<float> &triangleBounds);
+      
+      /**
+       * Trace single ray at the XY position
+       *
+       * @return Z of the nearest visible hit, or -infinity if there is none
+       */
+      float trace(float x, float y) const;
+      
+      /**
+       * Trace four rays at once
+       *
+       * @param x X positions of the rays
+       * @param y Y positions of the rays
+       * @param hitZ (OUT) Z of the nearest visible hits, or -infinity if there is none
+       */
+      void tracePacket(const float *x, const float *y, float *hitZ) const;
+      
+      /**
+       * Convert hit to the depth
+       */
+      float toDepth(float hitZ) const;
+      
+      /**
+       * Pool used for the batches
+       */
+      ThreadPool *pool_;
+      
+      /**
+       * Hierarchy
+       */
+      std::vector<Node> nodes_;
+      
+      /**
+       * Triangles in the leaf order, as edge functions A * x + B * y + C (positive inside, three per triangle) and plane z = P * x + Q * y + R
+       */
+      std::vector<float> edgeA_, edgeB_, edgeC_;
+      std::vector<float> planeP_, planeQ_, planeR_;
+      
+      /**
+       * Is edge top or left, so that the point exactly on it is inside. Three per triangle
+       */
+      std::vector<unsigned char> topLeft_;
+      
+      /**
+       * Fingerprint of the geometry hierarchy was built for, and was it built at all
+       */
+      unsigned long long geometryFingerprint_;
+      bool wasBuilt_;
+      
+      /**
+       * Board size and the transformation from the moxel to the XY position of its center
+       */
+      int sizeX_, sizeY_;
+      double moxelSizeX_, moxelSizeY_, originX_, originY_;
+      
+      /**
+       * Visible Z range, hits outside of it are clipped as by the near and far planes
+       */
+      float topZ_, bottomZ_, depthRange_;
+      
+      /**
+       * Number of builds
+       */
+      long numBuilds_;
+   };
+   
+} // namespace
+
+#endif
@@ -0,0 +1,655 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "SoftwareRasterizer.h"
+#include "GPUGeometryModel.h"
+#include "MathHelper.h"
+#include "SimpleDesignByContract.h"
+
+using namespace hdsim;
+using namespace std;
+
+namespace hdsim {
+   
+   /**
+    * Calculates bounds and min depth of the triangles. Tile range is the range of triangle indexes
+    */
+   class TriangleBoundsBody : public TileRangeBody {
+      
+   public:
+      
+      TriangleBoundsBody(TriangleBins *bins) : bins_(bins)
+      {
+      }
+      
+      virtual void processTile(const TileRange &range) const
+      {
+         for (int i = range.beginX; i < range.endX; i++)
+         {
+            TileRange bounds;
+            bins_->geometry_->getTriangleBounds(i, &bounds, &bins_->minDepth_[i]);
+            
+            bins_->beginX_[i] = bounds.beginX;
+            bins_->endX_[i] = bounds.endX;
+            bins_->beginY_[i] = bounds.beginY;
+            bins_->endY_[i] = bounds.endY;
+         }
+      }
+      
+   private:
+      
+      TriangleBins *bins_;
+   };
+   
+   /**
+    * Orders triangles by their min depth
+    */
+   class NearerTriangle {
+      
+   public:
+      
+      NearerTriangle(const float *minDepth) : minDepth_(minDepth)
+      {
+      }
+      
+      bool operator()(int lhs, int rhs) const
+      {
+         return minDepth_[lhs] < minDepth_[rhs];
+      }
+      
+   private:
+      
+      const float *minDepth_;
+   };
+   
+   /**
+    * Sorts triangles into the tiles, one row of tiles at a time. Every row scans all triangles, so that rows are independent and triangles stay in 
+    * order before they are sorted by depth
+    */
+   class BinTileRowsBody : public TileRangeBody {
+      
+   public:
+      
+      BinTileRowsBody(TriangleBins *bins) : bins_(bins)
+      {
+      }
+      
+      virtual void processTile(const TileRange &range) const
+      {
+         int tileSize = bins_->tileSize_, numTilesX = bins_->numTilesX_;
+         int numTriangles = bins_->minDepth_.size();
+         
+         for (int tileY = range.beginY; tileY < range.endY; tileY++)
+         {
+            vector<int> *row = &bins_->tileTriangles_[tileY * numTilesX];
+            int rowBegin = tileY * tileSize, rowEnd = rowBegin + tileSize;
+            
+            for (int tileX = 0; tileX < numTilesX; tileX++)
+               row[tileX].clear();
+            
+            for (int i = 0; i < numTriangles; i++)
+            {
+               if (bins_->beginY_[i] >= rowEnd  ||  bins_->endY_[i] <= rowBegin  ||  bins_->beginX_[i] >= bins_->endX_[i])
+                  continue;
+               
+               for (int tileX = bins_->beginX_[i] / tileSize; tileX <= (bins_->endX_[i] - 1) / tileSize; tileX++)
+                  row[tileX].push_back(i);
+            }
+            
+            for (int tileX = 0; tileX < numTilesX; tileX++)
+               stable_sort(row[tileX].begin(), row[tileX].end(), NearerTriangle(&bins_->minDepth_[0]));
+         }
+      }
+      
+   private:
+      
+      TriangleBins *bins_;
+   };
+   
+} // namespace
+
+OrthographicView hdsim::getModelView(const GPUGeometryModel &model)
+{
+   OrthographicView view;
+   
+   view.right[0] = 1;
+   view.right[1] = view.right[2] = 0;
+   
+   view.up[1] = 1;
+   view.up[0] = view.up[2] = 0;
+   
+   view.direction[2] = -1;
+   view.direction[0] = view.direction[1] = 0;
+   
+   view.minX = model.getRenderedAreaMinX();
+   view.minY = model.getRenderedAreaMinY();
+   view.minZ = model.getRenderedAreaMinZ();
+   view.maxX = model.getRenderedAreaMaxX();
+   view.maxY = model.getRenderedAreaMaxY();
+   view.maxZ = model.getRenderedAreaMaxZ();
+   
+   view.sizeX = model.getSizeX();
+   view.sizeY = model.getSizeY();
+   
+   return view;
+}
+
+bool hdsim::hasRenderedArea(const OrthographicView &view)
+{
+   return view.maxX > view.minX  &&  view.maxY > view.minY  &&  view.maxZ >= view.minZ;
+}
+
+OrthographicView hdsim::makeOrthographicView(const double direction[3], const double up[3], const double boxMin[3], const double boxMax[3], int sizeX, int sizeY)
+{
+   PRECONDITION(sizeX >= 0  &&  sizeY >= 0);
+   CHECK(areEqualInLowPrecision(direction[0] * up[0] + direction[1] * up[1] + direction[2] * up[2], 0), "Up axis must be orthogonal to the direction");
+   
+   OrthographicView view;
+   
+   for (int i = 0; i < 3; i++)
+   {
+      view.direction[i] = direction[i];
+      view.up[i] = up[i];
+   }
+   
+   view.right[0] = direction[1] * up[2] - direction[2] * up[1];
+   view.right[1] = direction[2] * up[0] - direction[0] * up[2];
+   view.right[2] = direction[0] * up[1] - direction[1] * up[0];
+   
+   view.minX = view.minY = view.minZ = HUGE_VAL;
+   view.maxX = view.maxY = view.maxZ = -HUGE_VAL;
+   
+   // Rendered area is the bounding box of the projected corners
+   for (int corner = 0; corner < 8; corner++)
+   {
+      double point[3] = {corner & 1 ? boxMax[0] : boxMin[0], corner & 2 ? boxMax[1] : boxMin[1], corner & 4 ? boxMax[2] : boxMin[2]};
+      
+      double x = 0, y = 0, z = 0;
+      for (int i = 0; i < 3; i++)
+      {
+         x += view.right[i] * point[i];
+         y += view.up[i] * point[i];
+         z -= view.direction[i] * point[i];
+      }
+      
+      view.minX = min(view.minX, x);
+      view.minY = min(view.minY, y);
+      view.minZ = min(view.minZ, z);
+      view.maxX = max(view.maxX, x);
+      view.maxY = max(view.maxY, y);
+      view.maxZ = max(view.maxZ, z);
+   }
+   
+   view.sizeX = sizeX;
+   view.sizeY = sizeY;
+   
+   return view;
+}
+
+SceneGeometry::SceneGeometry()
+{
+}
+
+SceneGeometry::~SceneGeometry()
+{
+}
+
+void SceneGeometry::setFromModel(const GPUGeometryModel &model)
+{
+   clear();
+   
+   int numPoints = model.getNumPoints();
+   
+   x_.reserve(numPoints);
+   y_.reserve(numPoints);
+   z_.reserve(numPoints);
+   
+   for (int i = 0; i < numPoints; i++)
+   {
+      const Point &point = model.getPoint(i);
+      addPoint(point.getX(), point.getY(), point.getZ());
+   }
+   
+   indexes_.reserve(3 * model.getNumTriangles());
+   
+   for (int i = 0; i < model.getNumTriangles(); i++)
+   {
+      const TriangleByPointIndexes &triangle = model.getTriangle(i);
+      addTriangle(triangle.getIndex1(), triangle.getIndex2(), triangle.getIndex3());
+   }
+}
+
+void SceneGeometry::clear()
+{
+   x_.clear();
+   y_.clear();
+   z_.clear();
+   indexes_.clear();
+}
+
+void SceneGeometry::addPoint(double x, double y, double z)
+{
+   x_.push_back(x);
+   y_.push_back(y);
+   z_.push_back(z);
+}
+
+void SceneGeometry::setPoint(int index, double x, double y, double z)
+{
+   PRECONDITION(index >= 0  &&  index < getNumPoints());
+   
+   x_[index] = x;
+   y_[index] = y;
+   z_[index] = z;
+}
+
+void SceneGeometry::addTriangle(int index1, int index2, int index3)
+{
+   indexes_.push_back(index1);
+   indexes_.push_back(index2);
+   indexes_.push_back(index3);
+}
+
+void SceneGeometry::setTriangle(int index, int index1, int index2, int index3)
+{
+   PRECONDITION(index >= 0  &&  index < getNumTriangles());
+   
+   indexes_[3 * index] = index1;
+   indexes_[3 * index + 1] = index2;
+   indexes_[3 * index + 2] = index3;
+}
+
+ProjectedGeometry::ProjectedGeometry() : scene_(0)
+{
+   memset(&view_, 0, sizeof(view_));
+   memset(transform_, 0, sizeof(transform_));
+}
+
+ProjectedGeometry::~ProjectedGeometry()
+{
+}
+
+void ProjectedGeometry::project(const SceneGeometry &scene, const OrthographicView &view)
+{
+   PRECONDITION(view.sizeX >= 0  &&  view.sizeY >= 0  &&  view.maxX > view.minX  &&  view.maxY > view.minY  &&  view.maxZ >= view.minZ);
+   
+   scene_ = &scene;
+   view_ = view;
+   
+   // Same planes as GPUCalculationEngine, depth is 0 on the top of the rendered area
+   double scaleX = view.sizeX / (view.maxX - view.minX);
+   double scaleY = view.sizeY / (view.maxY - view.minY);
+   double depthRange = view.maxZ - view.minZ + FLOATING_POINTS_LOW_PRECISION_EQUAL_DELTA;
+   
+   for (int i = 0; i < 3; i++)
+   {
+      transform_[0][i] = view.right[i] * scaleX;
+      transform_[1][i] = view.up[i] * scaleY;
+      transform_[2][i] = view.direction[i] / depthRange;
+   }
+   
+   transform_[0][3] = -view.minX * scaleX;
+   transform_[1][3] = -view.minY * scaleY;
+   transform_[2][3] = (view.maxZ + FLOATING_POINTS_LOW_PRECISION_EQUAL_DELTA) / depthRange;
+   
+   int numPoints = scene.getNumPoints();
+   
+   x_.resize(numPoints);
+   y_.resize(numPoints);
+   depth_.resize(numPoints);
+   
+   const double *sceneX = scene.getX(), *sceneY = scene.getY(), *sceneZ = scene.getZ();
+   double *out[3] = {getX() ? &x_[0] : 0, getY() ? &y_[0] : 0, getDepth() ? &depth_[0] : 0};
+   
+   for (int axis = 0; axis < 3; axis++)
+   {
+      const double *t = transform_[axis];
+      double *result = out[axis];
+      
+      for (int i = 0; i < numPoints; i++)
+         result[i] = t[0] * sceneX[i] + t[1] * sceneY[i] + t[2] * sceneZ[i] + t[3];
+   }
+}
+
+void ProjectedGeometry::reprojectPoint(int index)
+{
+   PRECONDITION(scene_  &&  index >= 0  &&  index < scene_->getNumPoints()  &&  index < (int)x_.size());
+   
+   double point[3] = {scene_->getX()[index], scene_->getY()[index], scene_->getZ()[index]};
+   double *out[3] = {&x_[index], &y_[index], &depth_[index]};
+   
+   for (int axis = 0; axis < 3; axis++)
+      *out[axis] = transform_[axis][0] * point[0] + transform_[axis][1] * point[1] + transform_[axis][2] * point[2] + transform_[axis][3];
+}
+
+/**
+ * Convert the range of moxel centers [minCenter, maxCenter] to the range of moxels clipped to [0, size)
+ */
+static void getCoveredMoxels(double minCenter, double maxCenter, int size, int *begin, int *end)
+{
+   // Clamp first, so that far away geometry doesn't overflow int
+   double first = ceil(max(minCenter - 0.5, -1.0));
+   double last = floor(min(maxCenter - 0.5, (double)size));
+   
+   *begin = max((int)first, 0);
+   *end = min((int)last + 1, size);
+   
+   if (*end < *begin)
+      *end = *begin;
+}
+
+void ProjectedGeometry::getTriangleBounds(int index, TileRange *bounds, float *minDepth) const
+{
+   PRECONDITION(scene_  &&  index >= 0  &&  index < getNumTriangles());
+   
+   const int *indexes = getIndexes() + 3 * index;
+   
+   double minX = x_[indexes[0]], maxX = minX;
+   double minY = y_[indexes[0]], maxY = minY;
+   double depth = depth_[indexes[0]];
+   
+   for (int i = 1; i < 3; i++)
+   {
+      minX = min(minX, x_[indexes[i]]);
+      maxX = max(maxX, x_[indexes[i]]);
+      minY = min(minY, y_[indexes[i]]);
+      maxY = max(maxY, y_[indexes[i]]);
+      depth = min(depth, depth_[indexes[i]]);
+   }
+   
+   getCoveredMoxels(minX, maxX, view_.sizeX, &bounds->beginX, &bounds->endX);
+   getCoveredMoxels(minY, maxY, view_.sizeY, &bounds->beginY, &bounds->endY);
+   
+   if (minDepth)
+      *minDepth = (float)depth;
+}
+
+TriangleBins::TriangleBins() : geometry_(0), sizeX_(0), sizeY_(0), tileSize_(1), numTilesX_(0), numTilesY_(0)
+{
+}
+
+TriangleBins::~TriangleBins()
+{
+}
+
+void TriangleBins::bin(const ProjectedGeometry &geometry, int tileSize, ThreadPool *pool)
+{
+   PRECONDITION(tileSize > 0);
+   
+   if (!pool)
+      pool = ThreadPool::getSharedPool();
+   
+   geometry_ = &geometry;
+   sizeX_ = geometry.getView().sizeX;
+   sizeY_ = geometry.getView().sizeY;
+   tileSize_ = tileSize;
+   numTilesX_ = (sizeX_ + tileSize - 1) / tileSize;
+   numTilesY_ = (sizeY_ + tileSize - 1) / tileSize;
+   
+   int numTriangles = geometry.getNumTriangles();
+   
+   beginX_.resize(numTriangles);
+   endX_.resize(numTriangles);
+   beginY_.resize(numTriangles);
+   endY_.resize(numTriangles);
+   minDepth_.resize(numTriangles);
+   
+   // Lists of the tiles keep their capacity between frames
+   tileTriangles_.resize(numTilesX_ * numTilesY_);
+   
+   if (numTriangles)
+      parallelFor2D(pool, numTriangles, 1, TRIANGLES_PER_TASK, 1, TriangleBoundsBody(this));
+   
+   if (numTilesX_  &&  numTilesY_)
+      parallelFor2D(pool, 1, numTilesY_, 1, 1, BinTileRowsBody(this));
+}
+
+TileRange TriangleBins::getTileRange(int tile) const
+{
+   PRECONDITION(tile >= 0  &&  tile < numTilesX_ * numTilesY_);
+   
+   TileRange range;
+   
+   range.beginX = (tile % numTilesX_) * tileSize_;
+   range.beginY = (tile / numTilesX_) * tileSize_;
+   range.endX = min(range.beginX + tileSize_, sizeX_);
+   range.endY = min(range.beginY + tileSize_, sizeY_);
+   
+   return range;
+}
+
+void hdsim::clearDepth(const TileRange &range, float *depth, int stride)
+{
+   for (int y = range.beginY; y < range.endY; y++)
+      fill(depth + y * stride + range.beginX, depth + y * stride + range.endX, 1.0f);
+}
+
+/**
+ * Rasterize one triangle into the rectangle
+ */
+static void rasterizeTriangle(const ProjectedGeometry &geometry, int index, const TileRange &range, float *depth, int stride)
+{
+   TileRange bounds;
+   geometry.getTriangleBounds(index, &bounds);
+   
+   int beginX = max(bounds.beginX, range.beginX), endX = min(bounds.endX, range.endX);
+   int beginY = max(bounds.beginY, range.beginY), endY = min(bounds.endY, range.endY);
+   
+   if (beginX >= endX  ||  beginY >= endY)
+      return;
+   
+   const int *indexes = geometry.getIndexes() + 3 * index;
+   const double *projectedX = geometry.getX(), *projectedY = geometry.getY(), *projectedDepth = geometry.getDepth();
+   
+   double x[3], y[3], d[3];
+   for (int i = 0; i < 3; i++)
+   {
+      x[i] = projectedX[indexes[i]];
+      y[i] = projectedY[indexes[i]];
+      d[i] = projectedDepth[indexes[i]];
+   }
+   
+   double area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+   if (area == 0)
+      return;
+   
+   // Both orientations are drawn, as there is no culling. Make triangle counterclockwise
+   if (area < 0)
+   {
+      swap(x[1], x[2]);
+      swap(y[1], y[2]);
+      swap(d[1], d[2]);
+      area = -area;
+   }
+   
+   // Depth is a plane over the triangle
+   double depthDX = ((d[1] - d[0]) * (y[2] - y[0]) - (d[2] - d[0]) * (y[1] - y[0])) / area;
+   double depthDY = ((x[1] - x[0]) * (d[2] - d[0]) - (x[2] - x[0]) * (d[1] - d[0])) / area;
+   
+   // Edge function of the edge from a to b is A * (px - xa) + B * (py - ya), positive inside. Top left rule decides centers exactly on the edge
+   double edgeA[3], edgeB[3];
+   bool topLeft[3];
+   
+   for (int i = 0; i < 3; i++)
+   {
+      int next = (i + 1) % 3;
+      
+      edgeA[i] = y[i] - y[next];
+      edgeB[i] = x[next] - x[i];
+      topLeft[i] = edgeA[i] > 0  ||  (edgeA[i] == 0  &&  edgeB[i] < 0);
+   }
+   
+   for (int row = beginY; row < endY; row++)
+   {
+      double centerY = row + 0.5;
+      double left = beginX, right = endX - 1;
+      
+      // Intersect the row with all three edges to get the span
+      for (int i = 0; i < 3; i++)
+      {
+         int next = (i + 1) % 3;
+         
+         if (edgeA[i] == 0)
+         {
+            double k = edgeB[i] * (centerY - y[i]);
+            if (k < 0  ||  (k == 0  &&  !topLeft[i]))
+               right = left - 1;
+            
+            continue;
+         }
+         
+         // Crossing is calculated from the lower end of the edge, so that both triangles sharing the edge get exactly the same value and there
+         // are no cracks between them
+         int lower = y[i] < y[next] ? i : next, upper = lower == i ? next : i;
+         double crossing = x[lower] + (centerY - y[lower]) * (x[upper] - x[lower]) / (y[upper] - y[lower]);
+         
+         double limit = max(min(crossing - 0.5, right + 1), left - 1);
+         
+         if (edgeA[i] > 0)
+         {
+            double first = ceil(limit);
+            if (first == limit  &&  !topLeft[i])
+               first++;
+            
+            left = max(left, first);
+         }
+         else
+         {
+            double last = floor(limit);
+            if (last == limit  &&  !topLeft[i])
+               last--;
+            
+            right = min(right, last);
+         }
+      }
+      
+      if (left > right)
+         continue;
+      
+      int first = (int)left;
+      int count = (int)right - first + 1;
+      float *out = depth + row * stride + first;
+      
+      float depthStart = (float)(d[0] + depthDX * (first + 0.5 - x[0]) + depthDY * (centerY - y[0]));
+      float depthStep = (float)depthDX;
+      
+      // Branch free, so that compiler could vectorize it. Depth outside of [0, 1] is clipped, as by the near and far planes
+      for (int i = 0; i < count; i++)
+      {
+         float value = depthStart + depthStep * i;
+         float old = out[i];
+         out[i] = value >= 0  &&  value < old ? value : old;
+      }
+   }
+}
+
+void hdsim::rasterizeDepth(const ProjectedGeometry &geometry, const int *triangles, int numTriangles, const TileRange &range, float *depth, int stride)
+{
+   PRECONDITION(range.beginX >= 0  &&  range.endX <= geometry.getSizeX()  &&  range.beginY >= 0  &&  range.endY <= geometry.getSizeY());
+   
+   if (!triangles)
+   {
+      for (int i = 0; i < geometry.getNumTriangles(); i++)
+         rasterizeTriangle(geometry, i, range, depth, stride);
+   }
+   else
+   {
+      for (int i = 0; i < numTriangles; i++)
+         rasterizeTriangle(geometry, triangles[i], range, depth, stride);
+   }
+}
+
+int hdsim::rasterizeBinnedDepth(const ProjectedGeometry &geometry, const TriangleBins &bins, int tile, float *depth, int stride)
+{
+   TileRange range = bins.getTileRange(tile);
+   
+   int numBlocksX = (range.endX - range.beginX + DEPTH_BOUND_BLOCK_SIZE - 1) / DEPTH_BOUND_BLOCK_SIZE;
+   int numBlocksY = (range.endY - range.beginY + DEPTH_BOUND_BLOCK_SIZE - 1) / DEPTH_BOUND_BLOCK_SIZE;
+   
+   // Max depth of every block. Tile may already have depth in it, so it is read from the buffer
+   vector<float> blockMaxDepth(numBlocksX * numBlocksY, 0.0f);
+   
+   for (int y = range.beginY; y < range.endY; y++)
+      for (int x = range.beginX; x < range.endX; x++)
+      {
+         float &blockMax = blockMaxDepth[((y - range.beginY) / DEPTH_BOUND_BLOCK_SIZE) * numBlocksX + (x - range.beginX) / DEPTH_BOUND_BLOCK_SIZE];
+         blockMax = max(blockMax, depth[y * stride + x]);
+      }
+   
+   float tileMaxDepth = *max_element(blockMaxDepth.begin(), blockMaxDepth.end());
+   
+   const int *triangles = bins.getTriangles(tile);
+   const float *minDepth = bins.getMinDepth();
+   const int *boundsBeginX = bins.getBeginX(), *boundsEndX = bins.getEndX(), *boundsBeginY = bins.getBeginY(), *boundsEndY = bins.getEndY();
+   
+   int numTriangles = bins.getNumTriangles(tile);
+   int numSkipped = 0;
+   
+   for (int i = 0; i < numTriangles; i++)
+   {
+      int triangle = triangles[i];
+      
+      // Triangles are sorted, so all the rest are behind the tile too
+      if (minDepth[triangle] >= tileMaxDepth)
+      {
+         numSkipped += numTriangles - i;
+         break;
+      }
+      
+      int beginX = max(boundsBeginX[triangle], range.beginX), endX = min(boundsEndX[triangle], range.endX);
+      int beginY = max(boundsBeginY[triangle], range.beginY), endY = min(boundsEndY[triangle], range.endY);
+      
+      int firstBlockX = (beginX - range.beginX) / DEPTH_BOUND_BLOCK_SIZE, lastBlockX = (endX - 1 - range.beginX) / DEPTH_BOUND_BLOCK_SIZE;
+      int firstBlockY = (beginY - range.beginY) / DEPTH_BOUND_BLOCK_SIZE, lastBlockY = (endY - 1 - range.beginY) / DEPTH_BOUND_BLOCK_SIZE;
+      
+      float boundsMaxDepth = 0;
+      for (int blockY = firstBlockY; blockY <= lastBlockY; blockY++)
+         for (int blockX = firstBlockX; blockX <= lastBlockX; blockX++)
+            boundsMaxDepth = max(boundsMaxDepth, blockMaxDepth[blockY * numBlocksX + blockX]);
+      
+      if (minDepth[triangle] >= boundsMaxDepth)
+      {
+         numSkipped++;
+         continue;
+      }
+      
+      rasterizeTriangle(geometry, triangle, range, depth, stride);
+      
+      // Only blocks the triangle overlaps could get nearer
+      for (int blockY = firstBlockY; blockY <= lastBlockY; blockY++)
+         for (int blockX = firstBlockX; blockX <= lastBlockX; blockX++)
+         {
+            int blockBeginX = range.beginX + blockX * DEPTH_BOUND_BLOCK_SIZE, blockEndX = min(blockBeginX + DEPTH_BOUND_BLOCK_SIZE, range.endX);
+            int blockBeginY = range.beginY + blockY * DEPTH_BOUND_BLOCK_SIZE, blockEndY = min(blockBeginY + DEPTH_BOUND_BLOCK_SIZE, range.endY);
+            
+            float blockMax = 0;
+            for (int y = blockBeginY; y < blockEndY; y++)
+               blockMax = max(blockMax, *max_element(depth + y * stride + blockBeginX, depth + y * stride + blockEndX));
+            
+            blockMaxDepth[blockY * numBlocksX + blockX] = blockMax;
+         }
+      
+      tileMaxDepth = *max_element(blockMaxDepth.begin(), blockMaxDepth.end());
+   }
+   
+   return numSkipped;
+}
@@ -0,0 +1,559 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SOFTWARE_RASTERIZER_H_
+#define SOFTWARE_RASTERIZER_H_
+
+#include <vector>
+
+#include "ThreadPool.h"
+
+namespace hdsim {
+   
+   class GPUGeometryModel;
+   
+   /**
+    * Orthographic view of the board. Board lies in the plane of the right and up axes and looks along the direction axis. In view coordinates, x is the 
+    * position along the right axis, y along the up axis and z is the height towards the board (opposite to the direction). Axes must be orthonormal, with
+    * right = direction x up
+    */
+   struct OrthographicView {
+      /**
+       * Axes of the view
+       */
+      double right[3], up[3], direction[3];
+      
+      /**
+       * Rendered area, in view coordinates
+       */
+      double minX, minY, minZ, maxX, maxY, maxZ;
+      
+      /**
+       * Size of the board
+       */
+      int sizeX, sizeY;
+   };
+   
+   /**
+    * Get view that GPUCalculationEngine uses for the model: looking down the -Z axis, with the rendered area of the model
+    *
+    * @param model Model to use
+    *
+    * @return View of the model
+    */
+   OrthographicView getModelView(const GPUGeometryModel &model);
+   
+   /**
+    * Does the view have the rendered area that could be projected. Model without the rendered area set has the empty board
+    *
+    * @param view View to check
+    *
+    * @return Is rendered area of the view not empty
+    */
+   bool hasRenderedArea(const OrthographicView &view);
+   
+   /**
+    * Make view that looks along the given direction at the box, so that the rendered area is exactly the box as seen from that direction
+    *
+    * @param direction Direction in which board looks
+    * @param up Up axis of the board. Must be orthogonal to the direction
+    * @param boxMin Lower corner of the box
+    * @param boxMax Upper corner of the box
+    * @param sizeX Size of the board in X direction
+    * @param sizeY Size of the board in Y direction
+    *
+    * @return View
+    */
+   OrthographicView makeOrthographicView(const double direction[3], const double up[3], const double boxMin[3], const double boxMax[3], int sizeX, int sizeY);
+   
+   /**
+    * Geometry in flat arrays, so that it could be projected to any number of views without touching the model
+    */
+   class SceneGeometry {
+      
+   public:
+      
+      /**
+       * Constructor
+       */
+      SceneGeometry();
+      
+      /**
+       * Destructor
+       */
+      virtual ~SceneGeometry();
+      
+      /**
+       * Replace geometry with the geometry of the model
+       *
+       * @param model Model to use
+       */
+      virtual void setFromModel(const GPUGeometryModel &model);
+      
+      /**
+       * Remove all geometry
+       */
+      virtual void clear();
+      
+      /**
+       * Add point
+       *
+       * @param x X coordinate
+       * @param y Y coordinate
+       * @param z Z coordinate
+       */
+      virtual void addPoint(double x, double y, double z);
+      
+      /**
+       * Replace point
+       *
+       * @param index Index of the point
+       * @param x X coordinate
+       * @param y Y coordinate
+       * @param z Z coordinate
+       */
+      virtual void setPoint(int index, double x, double y, double z);
+      
+      /**
+       * Add triangle
+       *
+       * @param index1 Index of the first point
+       * @param index2 Index of the second point
+       * @param index3 Index of the third point
+       */
+      virtual void addTriangle(int index1, int index2, int index3);
+      
+      /**
+       * Replace triangle
+       *
+       * @param index Index of the triangle
+       * @param index1 Index of the first point
+       * @param index2 Index of the second point
+       * @param index3 Index of the third point
+       */
+      virtual void setTriangle(int index, int index1, int index2, int index3);
+      
+      /**
+       * Get number of points
+       *
+       * @return Number of points
+       */
+      virtual int getNumPoints() const
+      {
+         return x_.size();
+      }
+      
+      /**
+       * Get number of triangles
+       *
+       * @return Number of triangles
+       */
+      virtual int getNumTriangles() const
+      {
+         return indexes_.size() / 3;
+      }
+      
+      /**
+       * Get coordinates of the points
+       *
+       * @return Coordinates, or 0 if there are no points
+       */
+      virtual const double *getX() const
+      {
+         return x_.empty() ? 0 : &x_[0];
+      }
+      
+      virtual const double *getY() const
+      {
+         return y_.empty() ? 0 : &y_[0];
+      }
+      
+      virtual const double *getZ() const
+      {
+         return z_.empty() ? 0 : &z_[0];
+      }
+      
+      /**
+       * Get point indexes of the triangles, three per triangle
+       *
+       * @return Indexes, or 0 if there are no triangles
+       */
+      virtual const int *getIndexes() const
+      {
+         return indexes_.empty() ? 0 : &indexes_[0];
+      }
+      
+   private:
+      
+      /**
+       * Coordinates of the points
+       */
+      std::vector<double> x_, y_, z_;
+      
+      /**
+       * Point indexes of the triangles
+       */
+      std::vector<int> indexes_;
+   };
+   
+   /**
+    * Geometry projected to the board. Coordinates are in moxels, so that moxel (x, y) covers [x, x + 1) x [y, y + 1) and is sampled in its center. Depth is
+    * the value depth buffer of the GPUCalculationEngine would get (before the fragment shader), 0 on the board and 1 at the far end of the rendered area
+    */
+   class ProjectedGeometry {
+      
+   public:
+      
+      /**
+       * Constructor
+       */
+      ProjectedGeometry();
+      
+      /**
+       * Destructor
+       */
+      virtual ~ProjectedGeometry();
+      
+      /**
+       * Project geometry. Scene must not change while projection is used
+       *
+       * @param scene Geometry to project
+       * @param view View to project to
+       */
+      virtual void project(const SceneGeometry &scene, const OrthographicView &view);
+      
+      /**
+       * Project single point again, after it was changed in the scene
+       *
+       * @param index Index of the point
+       */
+      virtual void reprojectPoint(int index);
+      
+      /**
+       * Get bounding rectangle of the moxels that triangle could cover
+       *
+       * @param index Index of the triangle
+       * @param bounds (OUT) Bounds, clipped to the board. Empty if triangle is outside of the board
+       * @param minDepth (OUT) Min depth of the triangle, or 0 if not needed
+       */
+      virtual void getTriangleBounds(int index, TileRange *bounds, float *minDepth = 0) const;
+      
+      /**
+       * Get size of the board in X direction
+       *
+       * @return Size in X direction
+       */
+      virtual int getSizeX() const
+      {
+         return view_.sizeX;
+      }
+      
+      /**
+       * Get size of the board in Y direction
+       *
+       * @return Size in Y direction
+       */
+      virtual int getSizeY() const
+      {
+         return view_.sizeY;
+      }
+      
+      /**
+       * Get view used for the projection
+       *
+       * @return View
+       */
+      virtual const OrthographicView &getView() const
+      {
+         return view_;
+      }
+      
+      /**
+       * Get number of triangles
+       *
+       * @return Number of triangles
+       */
+      virtual int getNumTriangles() const
+      {
+         return scene_ ? scene_->getNumTriangles() : 0;
+      }
+      
+      /**
+       * Get projected points
+       *
+       * @return Projected X, Y and depth of the points
+       */
+      virtual const double *getX() const
+      {
+         return x_.empty() ? 0 : &x_[0];
+      }
+      
+      virtual const double *getY() const
+      {
+         return y_.empty() ? 0 : &y_[0];
+      }
+      
+      virtual const double *getDepth() const
+      {
+         return depth_.empty() ? 0 : &depth_[0];
+      }
+      
+      /**
+       * Get point indexes of the triangles, three per triangle
+       *
+       * @return Indexes
+       */
+      virtual const int *getIndexes() const
+      {
+         return scene_ ? scene_->getIndexes() : 0;
+      }
+      
+   private:
+      
+      // copying is not supported
+      ProjectedGeometry(const ProjectedGeometry &rhs);
+      ProjectedGeometry &operator=(const ProjectedGeometry &rhs);
+      
+      /**
+       * Scene that was projected
+       */
+      const SceneGeometry *scene_;
+      
+      /**
+       * View used
+       */
+      OrthographicView view_;
+      
+      /**
+       * Projection, as x = dot(scale * axis, point) + offset, for x, y and depth
+       */
+      double transform_[3][4];
+      
+      /**
+       * Projected points
+       */
+      std::vector<double> x_, y_, depth_;
+   };
+   
+   /**
+    * Triangles of the projected geometry, sorted into the tiles of the board they could cover. Bounds and min depth of all triangles are kept in flat 
+    * arrays, and triangles of every tile are sorted by min depth, so that near triangles are rasterized first
+    */
+   class TriangleBins {
+      
+   public:
+      
+      /**
+       * Number of triangles for which bounds are calculated in a single task
+       */
+      static const int TRIANGLES_PER_TASK = 4096;
+      
+      /**
+       * Constructor
+       */
+      TriangleBins();
+      
+      /**
+       * Destructor
+       */
+      virtual ~TriangleBins();
+      
+      /**
+       * Sort triangles of the projected geometry into the tiles, in parallel
+       *
+       * @param geometry Projected geometry. Bins are valid until it changes
+       * @param tileSize Size of the tile
+       * @param pool Pool to use, or 0 for the shared pool
+       */
+      virtual void bin(const ProjectedGeometry &geometry, int tileSize, ThreadPool *pool = 0);
+      
+      /**
+       * Get range of the moxels covered by the tile
+       *
+       * @param tile Index of the tile
+       *
+       * @return Range of the tile
+       */
+      virtual TileRange getTileRange(int tile) const;
+      
+      /**
+       * Get number of triangles that could cover the tile
+       *
+       * @param tile Index of the tile
+       *
+       * @return Number of triangles in the tile
+       */
+      virtual int getNumTriangles(int tile) const
+      {
+         return tileTriangles_[tile].size();
+      }
+      
+      /**
+       * Get triangles that could cover the tile, sorted by min depth
+       *
+       * @param tile Index of the tile
+       *
+       * @return Indexes of the triangles
+       */
+      virtual const int *getTriangles(int tile) const
+      {
+         return tileTriangles_[tile].empty() ? 0 : &tileTriangles_[tile][0];
+      }
+      
+      /**
+       * Get bounds of the triangles, clipped to the board. Triangle covers moxels [beginX, endX) x [beginY, endY)
+       *
+       * @return Bounds, one per triangle
+       */
+      virtual const int *getBeginX() const
+      {
+         return beginX_.empty() ? 0 : &beginX_[0];
+      }
+      
+      virtual const int *getEndX() const
+      {
+         return endX_.empty() ? 0 : &endX_[0];
+      }
+      
+      virtual const int *getBeginY() const
+      {
+         return beginY_.empty() ? 0 : &beginY_[0];
+      }
+      
+      virtual const int *getEndY() const
+      {
+         return endY_.empty() ? 0 : &endY_[0];
+      }
+      
+      /**
+       * Get min depth of the triangles
+       *
+       * @return Min depth, one per triangle
+       */
+      virtual const float *getMinDepth() const
+      {
+         return minDepth_.empty() ? 0 : &minDepth_[0];
+      }
+      
+      /**
+       * Get size of the tile
+       *
+       * @return Size of the tile
+       */
+      virtual int getTileSize() const
+      {
+         return tileSize_;
+      }
+      
+      /**
+       * Get number of tiles in X direction
+       *
+       * @return Number of tiles in X direction
+       */
+      virtual int getNumTilesX() const
+      {
+         return numTilesX_;
+      }
+      
+      /**
+       * Get number of tiles in Y direction
+       *
+       * @return Number of tiles in Y direction
+       */
+      virtual int getNumTilesY() const
+      {
+         return numTilesY_;
+      }
+      
+   private:
+      
+      // copying is not supported
+      TriangleBins(const TriangleBins &rhs);
+      TriangleBins &operator=(const TriangleBins &rhs);
+      
+      friend class TriangleBoundsBody;
+      friend class BinTileRowsBody;
+      
+      /**
+       * Geometry that is binned
+       */
+      const ProjectedGeometry *geometry_;
+      
+      /**
+       * Size of the board and tiles
+       */
+      int sizeX_, sizeY_, tileSize_, numTilesX_, numTilesY_;
+      
+      /**
+       * Bounds and min depth of the triangles
+       */
+      std::vector<int> beginX_, endX_, beginY_, endY_;
+      std::vector<float> minDepth_;
+      
+      /**
+       * Triangles of every tile
+       */
+      std::vector<std::vector<int> > tileTriangles_;
+   };
+   
+   /**
+    * Set depth of the rectangle to 1 (infinity)
+    *
+    * @param range Rectangle to clear
+    * @param depth Depth buffer of the board
+    * @param stride Distance between rows of the depth buffer
+    */
+   void clearDepth(const TileRange &range, float *depth, int stride);
+   
+   /**
+    * Rasterize triangles into the rectangle of the depth buffer, the same way GPUCalculationEngine does: moxel is covered if its center is inside the 
+    * triangle, depth is interpolated linearly, values outside of [0, 1] are clipped and the smaller depth wins. Moxels outside of the rectangle are not 
+    * touched, so different rectangles could be rasterized in parallel
+    *
+    * @param geometry Projected geometry
+    * @param triangles Indexes of the triangles to rasterize, or 0 for all
+    * @param numTriangles Number of indexes, ignored if triangles is 0
+    * @param range Rectangle to rasterize into
+    * @param depth Depth buffer of the board
+    * @param stride Distance between rows of the depth buffer
+    */
+   void rasterizeDepth(const ProjectedGeometry &geometry, const int *triangles, int numTriangles, const TileRange &range, float *depth, int stride);
+   
+   /**
+    * Size of the blocks for which depth bound is kept while tile is rasterized by rasterizeBinnedDepth()
+    */
+   static const int DEPTH_BOUND_BLOCK_SIZE = 8;
+   
+   /**
+    * Rasterize triangles of the tile into the depth buffer, like rasterizeDepth(). Max depth of the tile and of its blocks is kept while triangles are 
+    * rasterized, and triangles whose min depth is behind the max depth of all blocks they overlap are skipped. As triangles are sorted by min depth, 
+    * all triangles after the first one behind the whole tile are skipped at once
+    *
+    * @param geometry Projected geometry
+    * @param bins Bins of the geometry
+    * @param tile Index of the tile
+    * @param depth Depth buffer of the board
+    * @param stride Distance between rows of the depth buffer
+    *
+    * @return Number of triangles skipped
+    */
+   int rasterizeBinnedDepth(const ProjectedGeometry &geometry, const TriangleBins &bins, int tile, float *depth, int stride);
+   
+} // namespace
+
+#endif
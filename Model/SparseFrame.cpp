@@ -0,0 +1,434 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "SparseFrame.h"
+#include "SimpleDesignByContract.h"
+
+using namespace hdsim;
+using namespace std;
+
+const double SparseFrame::BACKGROUND_VALUE;
+
+/**
+ * Header of the encoded frame. Occupancy bitmap and tiles follow it
+ */
+struct EncodedSparseFrameHeader {
+   int32_t sizeX, sizeY, tileSize, numOccupiedTiles;
+   double timeSlice;
+};
+
+/**
+ * Append bytes to the encoded frame
+ */
+static void append(vector<char> *out, const void *data, size_t size)
+{
+   const char *bytes = static_cast<const char *>(data);
+   out->insert(out->end(), bytes, bytes + size);
+}
+
+SparseFrame::SparseFrame(int tileSize) : sizeX_(0), sizeY_(0), tileSize_(tileSize), numTilesX_(0), numTilesY_(0), timeSlice_(0), numStoredTiles_(0)
+{
+   PRECONDITION(tileSize > 0);
+}
+
+SparseFrame::~SparseFrame()
+{
+}
+
+void SparseFrame::reset(int sizeX, int sizeY, double timeSlice)
+{
+   PRECONDITION(sizeX >= 0  &&  sizeY >= 0);
+   
+   sizeX_ = sizeX;
+   sizeY_ = sizeY;
+   timeSlice_ = timeSlice;
+   numTilesX_ = (sizeX + tileSize_ - 1) / tileSize_;
+   numTilesY_ = (sizeY + tileSize_ - 1) / tileSize_;
+   
+   int numTiles = numTilesX_ * numTilesY_;
+   
+   occupancy_.assign((numTiles + 31) / 32, 0);
+   tileSlots_.assign(numTiles, -1);
+   tiles_.clear();
+   storage_.clear();
+   numStoredTiles_ = 0;
+}
+
+TileRange SparseFrame::getTileRange(int tile) const
+{
+   TileRange range;
+   
+   range.beginX = (tile % numTilesX_) * tileSize_;
+   range.beginY = (tile / numTilesX_) * tileSize_;
+   range.endX = min(range.beginX + tileSize_, sizeX_);
+   range.endY = min(range.beginY + tileSize_, sizeY_);
+   
+   return range;
+}
+
+void SparseFrame::addTile(int tile, const float *values, int stride, float value)
+{
+   StoredTile stored;
+   stored.tile = tile;
+   stored.offset = -1;
+   stored.value = value;
+   
+   if (values)
+   {
+      TileRange range = getTileRange(tile);
+      int width = range.endX - range.beginX;
+      
+      stored.offset = storage_.size();
+      
+      for (int y = range.beginY; y < range.endY; y++, values += stride)
+         storage_.insert(storage_.end(), values, values + width);
+      
+      numStoredTiles_++;
+   }
+   
+   occupancy_[tile / 32] |= 1u << (tile % 32);
+   tileSlots_[tile] = tiles_.size();
+   tiles_.push_back(stored);
+}
+
+void SparseFrame::setFromValues(const float *values, int sizeX, int sizeY, double timeSlice)
+{
+   reset(sizeX, sizeY, timeSlice);
+   
+   const float background = (float)BACKGROUND_VALUE;
+   
+   for (int tile = 0; tile < numTilesX_ * numTilesY_; tile++)
+   {
+      TileRange range = getTileRange(tile);
+      int width = range.endX - range.beginX;
+      
+      // Scanning stops at the first differing moxel, and stored tiles are copied straight from the board
+      const float *origin = values + range.beginY * sizeX + range.beginX;
+      float first = *origin;
+      bool constant = true;
+      
+      for (int y = range.beginY; y < range.endY  &&  constant; y++)
+      {
+         const float *row = values + y * sizeX + range.beginX;
+         
+         for (int x = 0; x < width  &&  constant; x++)
+            constant = row[x] == first;
+      }
+      
+      if (!constant)
+         addTile(tile, origin, sizeX, 0);
+      else if (first != background)
+         addTile(tile, 0, 0, first);
+   }
+}
+
+void SparseFrame::setFromModel(const AbstractModel *model, double timeSlice)
+{
+   PRECONDITION(model);
+   
+   int sizeX = model->getSizeX(), sizeY = model->getSizeY();
+   vector<float> values(sizeX * sizeY);
+   
+   for (int y = 0; y < sizeY; y++)
+      for (int x = 0; x < sizeX; x++)
+         values[y * sizeX + x] = model->getAt(x, y);
+   
+   setFromValues(values.empty() ? 0 : &values[0], sizeX, sizeY, timeSlice);
+}
+
+double SparseFrame::getAt(int x, int y) const
+{
+   int slot = tileSlots_[(y / tileSize_) * numTilesX_ + x / tileSize_];
+   
+   if (slot < 0)
+      return BACKGROUND_VALUE;
+   
+   const StoredTile &stored = tiles_[slot];
+   
+   if (stored.offset < 0)
+      return stored.value;
+   
+   TileRange range = getTileRange(stored.tile);
+   return storage_[stored.offset + (y - range.beginY) * (range.endX - range.beginX) + x - range.beginX];
+}
+
+AbstractModel *SparseFrame::cloneOrphan() const
+{
+   SparseFrame *clone = new SparseFrame(tileSize_);
+   
+   clone->sizeX_ = sizeX_;
+   clone->sizeY_ = sizeY_;
+   clone->numTilesX_ = numTilesX_;
+   clone->numTilesY_ = numTilesY_;
+   clone->timeSlice_ = timeSlice_;
+   clone->occupancy_ = occupancy_;
+   clone->tileSlots_ = tileSlots_;
+   clone->tiles_ = tiles_;
+   clone->storage_ = storage_;
+   clone->numStoredTiles_ = numStoredTiles_;
+   
+   return clone;
+}
+
+SparseTile SparseFrame::getOccupiedTile(int index) const
+{
+   PRECONDITION(index >= 0  &&  index < getNumOccupiedTiles());
+   
+   const StoredTile &stored = tiles_[index];
+   
+   SparseTile tile;
+   tile.tileX = stored.tile % numTilesX_;
+   tile.tileY = stored.tile / numTilesX_;
+   tile.range = getTileRange(stored.tile);
+   tile.values = stored.offset < 0 ? 0 : &storage_[stored.offset];
+   tile.value = stored.value;
+   
+   return tile;
+}
+
+size_t SparseFrame::getMemoryUsage() const
+{
+   return sizeof(*this) + occupancy_.capacity() * sizeof(uint32_t) + tileSlots_.capacity() * sizeof(int) + tiles_.capacity() * sizeof(StoredTile) + 
+          storage_.capacity() * sizeof(float);
+}
+
+void SparseFrame::readValues(float *values) const
+{
+   fill(values, values + sizeX_ * sizeY_, (float)BACKGROUND_VALUE);
+   
+   for (int i = 0; i < tiles_.size(); i++)
+   {
+      SparseTile tile = getOccupiedTile(i);
+      int width = tile.range.endX - tile.range.beginX;
+      
+      for (int y = tile.range.beginY; y < tile.range.endY; y++)
+      {
+         float *out = values + y * sizeX_ + tile.range.beginX;
+         
+         if (tile.values)
+            copy(tile.values + (y - tile.range.beginY) * width, tile.values + (y - tile.range.beginY + 1) * width, out);
+         else
+            fill(out, out + width, tile.value);
+      }
+   }
+}
+
+void SparseFrame::decimate(int xSize, int ySize, double *result) const
+{
+   CHECK(sizeX_ >= xSize  &&  sizeY_ >= ySize  &&  xSize > 0  &&  ySize > 0, "Decimated grid can't be larger then original grid");
+   
+   // Same mapping as GPUInterpolatedModel: remainder goes to the decimated pixels on the right and bottom edge
+   int xPixelsInDecimatedPixel = sizeX_ / xSize, rightEdgePixelsInDecimatedPixel = xPixelsInDecimatedPixel + sizeX_ % xSize;
+   int yPixelsInDecimatedPixel = sizeY_ / ySize, bottomEdgePixelsInDecimatedPixel = yPixelsInDecimatedPixel + sizeY_ % ySize;
+   
+   // Sum how much occupied moxels differ from the background. Background moxels add nothing, so they are never visited
+   fill(result, result + xSize * ySize, 0.0);
+   
+   for (int i = 0; i < tiles_.size(); i++)
+   {
+      SparseTile tile = getOccupiedTile(i);
+      int width = tile.range.endX - tile.range.beginX;
+      
+      for (int y = tile.range.beginY; y < tile.range.endY; y++)
+      {
+         int posY = y / yPixelsInDecimatedPixel;
+         posY = posY < ySize ? posY : ySize - 1;
+         
+         double *scanLine = result + posY * xSize;
+         const float *row = tile.values ? tile.values + (y - tile.range.beginY) * width : 0;
+         
+         for (int x = tile.range.beginX; x < tile.range.endX; x++)
+         {
+            int posX = x / xPixelsInDecimatedPixel;
+            posX = posX < xSize ? posX : xSize - 1;
+            
+            scanLine[posX] += (row ? row[x - tile.range.beginX] : tile.value) - BACKGROUND_VALUE;
+         }
+      }
+   }
+   
+   for (int posY = 0; posY < ySize; posY++)
+   {
+      int pixelsInRow = posY < ySize - 1 ? yPixelsInDecimatedPixel : bottomEdgePixelsInDecimatedPixel;
+      
+      for (int posX = 0; posX < xSize; posX++)
+      {
+         int pixelsInColumn = posX < xSize - 1 ? xPixelsInDecimatedPixel : rightEdgePixelsInDecimatedPixel;
+         result[posY * xSize + posX] = BACKGROUND_VALUE + result[posY * xSize + posX] / (pixelsInColumn * pixelsInRow);
+      }
+   }
+}
+
+bool SparseFrame::isTileEqual(int tile, const SparseFrame &other) const
+{
+   int slot = tileSlots_[tile], otherSlot = other.tileSlots_[tile];
+   
+   if (slot < 0  ||  otherSlot < 0)
+      return slot < 0  &&  otherSlot < 0;
+   
+   const StoredTile &stored = tiles_[slot], &otherStored = other.tiles_[otherSlot];
+   
+   // Tiles are collapsed whenever they are constant, so constant tile never equals stored one
+   if (stored.offset < 0  ||  otherStored.offset < 0)
+      return stored.offset < 0  &&  otherStored.offset < 0  &&  stored.value == otherStored.value;
+   
+   TileRange range = getTileRange(tile);
+   int size = (range.endX - range.beginX) * (range.endY - range.beginY);
+   
+   return !memcmp(&storage_[stored.offset], &other.storage_[otherStored.offset], size * sizeof(float));
+}
+
+void SparseFrame::getChangedTiles(const SparseFrame &previous, vector<int> *tiles) const
+{
+   PRECONDITION(previous.sizeX_ == sizeX_  &&  previous.sizeY_ == sizeY_  &&  previous.tileSize_ == tileSize_);
+   
+   tiles->clear();
+   
+   // Words with no tile occupied in either frame skip 32 tiles at once
+   for (int word = 0; word < occupancy_.size(); word++)
+   {
+      uint32_t bits = occupancy_[word] | previous.occupancy_[word];
+      
+      for (int bit = 0; bits; bit++, bits >>= 1)
+      {
+         int tile = word * 32 + bit;
+         
+         if ((bits & 1)  &&  !isTileEqual(tile, previous))
+            tiles->push_back(tile);
+      }
+   }
+}
+
+void SparseFrame::encode(vector<char> *out) const
+{
+   out->clear();
+   
+   EncodedSparseFrameHeader header;
+   header.sizeX = sizeX_;
+   header.sizeY = sizeY_;
+   header.tileSize = tileSize_;
+   header.numOccupiedTiles = tiles_.size();
+   header.timeSlice = timeSlice_;
+   
+   append(out, &header, sizeof(header));
+   
+   if (!occupancy_.empty())
+      append(out, &occupancy_[0], occupancy_.size() * sizeof(uint32_t));
+   
+   for (int i = 0; i < tiles_.size(); i++)
+   {
+      SparseTile tile = getOccupiedTile(i);
+      char stored = tile.values != 0;
+      
+      append(out, &stored, sizeof(stored));
+      
+      if (stored)
+         append(out, tile.values, (tile.range.endX - tile.range.beginX) * (tile.range.endY - tile.range.beginY) * sizeof(float));
+      else
+         append(out, &tile.value, sizeof(tile.value));
+   }
+}
+
+bool SparseFrame::decode(const char *data, size_t size)
+{
+   EncodedSparseFrameHeader header;
+   
+   if (size < sizeof(header))
+      return false;
+   
+   memcpy(&header, data, sizeof(header));
+   
+   if (header.sizeX < 0  ||  header.sizeY < 0  ||  header.tileSize <= 0  ||  header.numOccupiedTiles < 0)
+      return false;
+   
+   // Decode into the new frame, so that this one is unchanged if data is not valid
+   SparseFrame decoded(header.tileSize);
+   decoded.reset(header.sizeX, header.sizeY, header.timeSlice);
+   
+   size_t position = sizeof(header);
+   size_t bitmapSize = decoded.occupancy_.size() * sizeof(uint32_t);
+   
+   if (size - position < bitmapSize)
+      return false;
+   
+   vector<uint32_t> occupancy(decoded.occupancy_.size());
+   if (bitmapSize)
+      memcpy(&occupancy[0], data + position, bitmapSize);
+   
+   position += bitmapSize;
+   
+   int tile = 0;
+   for (int i = 0; i < header.numOccupiedTiles; i++, tile++)
+   {
+      // Next occupied tile from the bitmap
+      while (tile < decoded.tileSlots_.size()  &&  !((occupancy[tile / 32] >> (tile % 32)) & 1))
+         tile++;
+      
+      if (tile == decoded.tileSlots_.size()  ||  size - position < sizeof(char))
+         return false;
+      
+      char stored = data[position++];
+      
+      if (stored)
+      {
+         TileRange range = decoded.getTileRange(tile);
+         size_t tileSize = (range.endX - range.beginX) * (range.endY - range.beginY) * sizeof(float);
+         
+         if (size - position < tileSize)
+            return false;
+         
+         vector<float> values(tileSize / sizeof(float));
+         memcpy(&values[0], data + position, tileSize);
+         position += tileSize;
+         
+         decoded.addTile(tile, &values[0], range.endX - range.beginX, 0);
+      }
+      else
+      {
+         float value;
+         
+         if (size - position < sizeof(value))
+            return false;
+         
+         memcpy(&value, data + position, sizeof(value));
+         position += sizeof(value);
+         
+         decoded.addTile(tile, 0, 0, value);
+      }
+   }
+   
+   if (decoded.occupancy_ != occupancy)
+      return false;
+   
+   sizeX_ = decoded.sizeX_;
+   sizeY_ = decoded.sizeY_;
+   tileSize_ = decoded.tileSize_;
+   numTilesX_ = decoded.numTilesX_;
+   numTilesY_ = decoded.numTilesY_;
+   timeSlice_ = decoded.timeSlice_;
+   occupancy_.swap(decoded.occupancy_);
+   tileSlots_.swap(decoded.tileSlots_);
+   tiles_.swap(decoded.tiles_);
+   storage_.swap(decoded.storage_);
+   numStoredTiles_ = decoded.numStoredTiles_;
+   
+   return true;
+}
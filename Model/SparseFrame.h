@@ -0,0 +1,356 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPARSE_FRAME_H_
+#define SPARSE_FRAME_H_
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include "AbstractModel.h"
+#include "ThreadPool.h"
+
+static const char *const SPARSE_FRAME_MODEL_NAME = "SparseFrame";
+
+namespace hdsim {
+   
+   /**
+    * Occupied tile of the sparse frame
+    */
+   struct SparseTile {
+      /**
+       * Index of the tile
+       */
+      int tileX, tileY;
+      
+      /**
+       * Moxels covered by the tile
+       */
+      TileRange range;
+      
+      /**
+       * Values of the tile, stored so that [x][y] of the tile corresponds to [(y - beginY) * (endX - beginX) + x - beginX], or 0 if all moxels of 
+       * the tile have the same value
+       */
+      const float *values;
+      
+      /**
+       * Value of all moxels, if tile is constant
+       */
+      float value;
+   };
+   
+   /**
+    * Board stored as tiles, where only tiles that are not entirely at the background (depth 1, where no geometry is) are stored. Tiles whose moxels
+    * all have the same value are stored as that value only. Which tiles are occupied is kept in a bitmap.
+    *
+    * Memory, decimation, bulk reads and encoding all scale with the area covered by geometry, not with the area of the board, so this suits scenes
+    * where most of the board is empty. GPUGeometryModel stores its calculated board as the sparse frame if GPUGeometryModel::setSparseFrames() is set,
+    * and the drawing code then decimates and draws that frame in place of the board.
+    */
+   class SparseFrame : public AbstractModel {
+      
+   public:
+      
+      /**
+       * Default size of the tile, in moxels
+       */
+      static const int DEFAULT_TILE_SIZE = 16;
+      
+      /**
+       * Value of the moxels that are not stored
+       */
+      static const double BACKGROUND_VALUE = 1;
+      
+      /**
+       * Constructor. Frame is empty until it is set
+       *
+       * @param tileSize Size of the tile
+       */
+      explicit SparseFrame(int tileSize = DEFAULT_TILE_SIZE);
+      
+      /**
+       * Destructor
+       */
+      virtual ~SparseFrame();
+      
+      /**
+       * Set frame from the values of the board
+       *
+       * @param values Values, stored so that [x][y] corresponds to [y * sizeX + x]
+       * @param sizeX Size of the board in X direction
+       * @param sizeY Size of the board in Y direction
+       * @param timeSlice Timeslice at which values were calculated
+       */
+      virtual void setFromValues(const float *values, int sizeX, int sizeY, double timeSlice = 0);
+      
+      /**
+       * Set frame from the model. Model would be calculated if it isn't already
+       *
+       * @param model Model to use
+       * @param timeSlice Timeslice at which model is calculated
+       */
+      virtual void setFromModel(const AbstractModel *model, double timeSlice = 0);
+      
+      // Overriden methods
+      virtual const char *getModelName() const
+      {
+         return SPARSE_FRAME_MODEL_NAME;
+      }
+      
+      virtual double getAt(int x, int y) const;
+      
+      virtual int getSizeX() const
+      {
+         return sizeX_;
+      }
+      
+      virtual int getSizeY() const
+      {
+         return sizeY_;
+      }
+      
+      virtual AbstractModel *cloneOrphan() const;
+      
+      /**
+       * Frames are not read from the files
+       *
+       * @return false
+       */
+      virtual bool readFromFile(const std::string &fileName)
+      {
+         return false;
+      }
+      
+      virtual const char *getFileName() const
+      {
+         return "";
+      }
+      
+      /**
+       * Get timeslice at which frame was calculated
+       *
+       * @return Timeslice of the frame
+       */
+      virtual double getTimeSlice() const
+      {
+         return timeSlice_;
+      }
+      
+      /**
+       * Get size of the tile
+       *
+       * @return Size of the tile
+       */
+      virtual int getTileSize() const
+      {
+         return tileSize_;
+      }
+      
+      /**
+       * Get number of tiles in X direction
+       *
+       * @return Number of tiles in X direction
+       */
+      virtual int getNumTilesX() const
+      {
+         return numTilesX_;
+      }
+      
+      /**
+       * Get number of tiles in Y direction
+       *
+       * @return Number of tiles in Y direction
+       */
+      virtual int getNumTilesY() const
+      {
+         return numTilesY_;
+      }
+      
+      /**
+       * Is tile occupied, meaning that some of its moxels are not at the background
+       *
+       * @param tileX Index of the tile in X direction
+       * @param tileY Index of the tile in Y direction
+       *
+       * @return Is tile occupied
+       */
+      virtual bool isTileOccupied(int tileX, int tileY) const
+      {
+         int tile = tileY * numTilesX_ + tileX;
+         return (occupancy_[tile / 32] >> (tile % 32)) & 1;
+      }
+      
+      /**
+       * Get number of occupied tiles
+       *
+       * @return Number of occupied tiles
+       */
+      virtual int getNumOccupiedTiles() const
+      {
+         return tiles_.size();
+      }
+      
+      /**
+       * Get number of occupied tiles whose values are stored, because they are not constant
+       *
+       * @return Number of stored tiles
+       */
+      virtual int getNumStoredTiles() const
+      {
+         return numStoredTiles_;
+      }
+      
+      /**
+       * Get occupied tile. Tiles are ordered by rows
+       *
+       * @param index Index of the tile, smaller than getNumOccupiedTiles()
+       *
+       * @return Tile
+       */
+      virtual SparseTile getOccupiedTile(int index) const;
+      
+      /**
+       * Get memory used by the frame
+       *
+       * @return Memory used, in bytes
+       */
+      virtual size_t getMemoryUsage() const;
+      
+      /**
+       * Read all values of the board. Background is filled first, and then only the occupied tiles are written
+       *
+       * @param values (OUT) Values, stored so that [x][y] corresponds to [y * sizeX + x]
+       */
+      virtual void readValues(float *values) const;
+      
+      /**
+       * Decimate the board to the smaller grid, the same way GPUInterpolatedModel::getDecimatedModelAdopt() does, visiting only occupied tiles
+       *
+       * @param xSize X size of the decimated grid
+       * @param ySize Y size of the decimated grid
+       * @param result (OUT) Decimated grid, stored so that [x][y] corresponds to [y * xSize + x]
+       */
+      virtual void decimate(int xSize, int ySize, double *result) const;
+      
+      /**
+       * Get tiles whose values differ from the previous frame of the same size and tile size. Only tiles occupied in either frame are compared
+       *
+       * @param previous Previous frame
+       * @param tiles (OUT) Indexes of the changed tiles, as tileY * getNumTilesX() + tileX
+       */
+      virtual void getChangedTiles(const SparseFrame &previous, std::vector<int> *tiles) const;
+      
+      /**
+       * Encode frame in the compact form: header, occupancy bitmap and occupied tiles
+       *
+       * @param out (OUT) Encoded frame. Previous content is replaced
+       */
+      virtual void encode(std::vector<char> *out) const;
+      
+      /**
+       * Set frame from the encoded form
+       *
+       * @param data Encoded frame
+       * @param size Size of the encoded frame
+       *
+       * @return Was frame decoded. If not, frame is unchanged
+       */
+      virtual bool decode(const char *data, size_t size);
+      
+   private:
+      
+      // copying is not supported
+      SparseFrame(const SparseFrame &rhs);
+      SparseFrame &operator=(const SparseFrame &rhs);
+      
+      /**
+       * Occupied tile, with the offset of its values in the storage, or -1 if it is constant
+       */
+      struct StoredTile {
+         int tile;
+         int offset;
+         float value;
+      };
+      
+      /**
+       * Reset to the empty board of the given size
+       */
+      void reset(int sizeX, int sizeY, double timeSlice);
+      
+      /**
+       * Add occupied tile
+       *
+       * @param tile Index of the tile
+       * @param values Values of the tile, or 0 if the whole tile has the same value
+       * @param stride Distance between the rows of values
+       * @param value Value of the whole tile, if there are no values
+       */
+      void addTile(int tile, const float *values, int stride, float value);
+      
+      /**
+       * Get range of the moxels covered by the tile
+       */
+      TileRange getTileRange(int tile) const;
+      
+      /**
+       * Do two frames have the same values in the tile
+       */
+      bool isTileEqual(int tile, const SparseFrame &other) const;
+      
+      /**
+       * Size of the board, tile and number of tiles
+       */
+      int sizeX_, sizeY_, tileSize_, numTilesX_, numTilesY_;
+      
+      /**
+       * Timeslice of the frame
+       */
+      double timeSlice_;
+      
+      /**
+       * Bit for every tile, set if tile is occupied
+       */
+      std::vector<uint32_t> occupancy_;
+      
+      /**
+       * Index in tiles_ for every tile, or -1 if tile is at the background
+       */
+      std::vector<int> tileSlots_;
+      
+      /**
+       * Occupied tiles, ordered by rows
+       */
+      std::vector<StoredTile> tiles_;
+      
+      /**
+       * Values of the tiles that are not constant
+       */
+      std::vector<float> storage_;
+      
+      /**
+       * Number of tiles that are not constant
+       */
+      int numStoredTiles_;
+   };
+   
+} // namespace
+
+#endif
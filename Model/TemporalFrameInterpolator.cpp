@@ -0,0 +1,333 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TemporalFrameInterpolator.h"
+#include "GPUInterpolatedModel.h"
+#include "MathHelper.h"
+#include "SimpleDesignByContract.h"
+
+using namespace hdsim;
+using namespace std;
+
+/**
+ * Number of values interpolated by one task of the pool
+ */
+static const int CHUNK_SIZE = 64 * 1024;
+
+namespace hdsim {
+   
+   /**
+    * Interpolates chunks of the frame linearly. Tile range is the range of values
+    */
+   class InterpolateLinearBody : public TileRangeBody {
+      
+   public:
+      
+      InterpolateLinearBody(const float *first, const float *second, float weight, float *values) : first_(first), second_(second), weight_(weight),
+                                                                                                    values_(values)
+      {
+      }
+      
+      virtual void processTile(const TileRange &range) const
+      {
+         TemporalFrameInterpolator::interpolateLinear(first_ + range.beginX, second_ + range.beginX, weight_, range.endX - range.beginX,
+                                                      values_ + range.beginX);
+      }
+   
+   private:
+      
+      const float *first_, *second_;
+      float weight_;
+      float *values_;
+   };
+   
+   /**
+    * Interpolates chunks of the frame with the cubic polynomial. Tile range is the range of values
+    */
+   class InterpolateCubicBody : public TileRangeBody {
+      
+   public:
+      
+      InterpolateCubicBody(const float *previous, const float *first, const float *second, const float *next, const float weights[4], float *values) :
+                           previous_(previous), first_(first), second_(second), next_(next), weights_(weights), values_(values)
+      {
+      }
+      
+      virtual void processTile(const TileRange &range) const
+      {
+         TemporalFrameInterpolator::interpolateCubic(previous_ + range.beginX, first_ + range.beginX, second_ + range.beginX, next_ + range.beginX, weights_,
+                                                     range.endX - range.beginX, values_ + range.beginX);
+      }
+   
+   private:
+      
+      const float *previous_, *first_, *second_, *next_;
+      const float *weights_;
+      float *values_;
+   };
+   
+} // namespace
+
+TemporalFrameInterpolator::TemporalFrameInterpolator(const GPUInterpolatedModel &model, int keyFrameInterval, TemporalInterpolation interpolation, int depth,
+                                                     ThreadPool *pool) : prefetcher_(model, depth), pool_(pool ? pool : ThreadPool::getSharedPool()),
+                                                                         keyFrameInterval_(keyFrameInterval), interpolation_(interpolation), easing_(0),
+                                                                         interframeDistance_(0), loop_(true), numKeyFramesToSkip_(0), phase_(0),
+                                                                         timeSlice_(0), wasSeeked_(false), numKeyFrames_(0), numInterpolatedFrames_(0)
+{
+   PRECONDITION(keyFrameInterval >= 1);
+}
+
+TemporalFrameInterpolator::~TemporalFrameInterpolator()
+{
+   
+}
+
+double TemporalFrameInterpolator::getSlowInSlowOutPosition(double timeSlice)
+{
+   if (timeSlice < 0.2)
+      return timeSlice / 2.0;
+   
+   if (timeSlice < 0.9)
+      return timeSlice - 0.1;
+   
+   return 0.8 + (timeSlice - 0.9) / 3.0;
+}
+
+void TemporalFrameInterpolator::interpolateLinear(const float *first, const float *second, float weight, int numValues, float *values)
+{
+   // Branch free, so that compiler could vectorize it
+   for (int i = 0; i < numValues; i++)
+      values[i] = first[i] + (second[i] - first[i]) * weight;
+}
+
+void TemporalFrameInterpolator::getCubicWeights(double previousPosition, double firstPosition, double secondPosition, double nextPosition, double position,
+                                                float weights[4])
+{
+   double length = secondPosition - firstPosition;
+   double s = length > 0 ? (position - firstPosition) / length : 0;
+   
+   // Tangents are differences of the neighbouring key frames, scaled to the length of the interval
+   double firstTangentScale = secondPosition > previousPosition ? length / (secondPosition - previousPosition) : 0;
+   double secondTangentScale = nextPosition > firstPosition ? length / (nextPosition - firstPosition) : 0;
+   
+   s = s < 0 ? 0 : (s > 1 ? 1 : s);
+   
+   double s2 = s * s, s3 = s2 * s;
+   double h00 = 2 * s3 - 3 * s2 + 1, h10 = s3 - 2 * s2 + s, h01 = -2 * s3 + 3 * s2, h11 = s3 - s2;
+   
+   weights[0] = (float)(-h10 * firstTangentScale);
+   weights[1] = (float)(h00 - h11 * secondTangentScale);
+   weights[2] = (float)(h01 + h10 * firstTangentScale);
+   weights[3] = (float)(h11 * secondTangentScale);
+}
+
+void TemporalFrameInterpolator::interpolateCubic(const float *previous, const float *first, const float *second, const float *next, const float weights[4],
+                                                 int numValues, float *values)
+{
+   const float weightPrevious = weights[0], weightFirst = weights[1], weightSecond = weights[2], weightNext = weights[3];
+   
+   // Branch free, so that compiler could vectorize it. Conditionals are min and max
+   for (int i = 0; i < numValues; i++)
+   {
+      float value = weightPrevious * previous[i] + weightFirst * first[i] + weightSecond * second[i] + weightNext * next[i];
+      float low = first[i] < second[i] ? first[i] : second[i];
+      float high = first[i] < second[i] ? second[i] : first[i];
+      
+      value = value < low ? low : value;
+      values[i] = value > high ? high : value;
+   }
+}
+
+void TemporalFrameInterpolator::setAnimation(double interframeDistance, bool loop)
+{
+   if (areEqual(interframeDistance, interframeDistance_)  &&  loop == loop_)
+      return;
+   
+   interframeDistance_ = interframeDistance;
+   loop_ = loop;
+   
+   // Key frames are spaced by the interframe distance, so all of them have to be recalculated
+   if (wasSeeked_)
+      seek(timeSlice_);
+}
+
+void TemporalFrameInterpolator::seek(double currentTimeSlice)
+{
+   wasSeeked_ = true;
+   timeSlice_ = currentTimeSlice;
+   phase_ = 0;
+   
+   keyFrames_.clear();
+   previousKeyFrame_ = FrameHandle();
+   numKeyFramesToSkip_ = 0;
+   
+   // First key frame is the one at the current timeslice, so that frames following it could be interpolated
+   double keyFrameDistance = interframeDistance_ * keyFrameInterval_;
+   
+   prefetcher_.setAnimation(keyFrameDistance, loop_);
+   prefetcher_.seek(currentTimeSlice - keyFrameDistance);
+}
+
+void TemporalFrameInterpolator::setModel(const GPUInterpolatedModel &model)
+{
+   prefetcher_.setModel(model);
+   
+   if (wasSeeked_)
+      seek(timeSlice_);
+}
+
+FrameHandle TemporalFrameInterpolator::popFrame()
+{
+   CHECK(wasSeeked_, "Interpolator must be seeked before frames are popped");
+   
+   advance();
+   fetchKeyFrames();
+   
+   FrameHandle frame;
+   
+   if (phase_ == 0)
+   {
+      frame = keyFrames_.front();
+      numKeyFrames_++;
+   }
+   else
+   {
+      frame = publisher_.acquireBuffer(keyFrames_.front()->getSizeX(), keyFrames_.front()->getSizeY(), timeSlice_);
+      interpolateFrame(frame.get());
+      numInterpolatedFrames_++;
+   }
+   
+   publisher_.publish(frame);
+   return frame;
+}
+
+void TemporalFrameInterpolator::skipFrames(int numFrames)
+{
+   for (int i = 0; i < numFrames  &&  wasSeeked_; i++)
+      advance();
+   
+   // Key frames we moved past are dropped in the prefetcher right away, so that it starts calculating the ones we need
+   if (numKeyFramesToSkip_ > 0)
+   {
+      prefetcher_.skipFrames(numKeyFramesToSkip_);
+      numKeyFramesToSkip_ = 0;
+   }
+}
+
+void TemporalFrameInterpolator::advance()
+{
+   timeSlice_ = GPUInterpolatedModel::getNextTimeSlice(timeSlice_, interframeDistance_, loop_);
+   
+   if (++phase_ < keyFrameInterval_)
+      return;
+   
+   phase_ = 0;
+   
+   if (keyFrames_.empty())
+   {
+      // Key frame was never popped from the prefetcher, and it never will be
+      previousKeyFrame_ = FrameHandle();
+      numKeyFramesToSkip_++;
+      return;
+   }
+   
+   previousKeyFrame_ = keyFrames_.front();
+   keyFrames_.pop_front();
+}
+
+void TemporalFrameInterpolator::fetchKeyFrames()
+{
+   if (numKeyFramesToSkip_ > 0)
+   {
+      prefetcher_.skipFrames(numKeyFramesToSkip_);
+      numKeyFramesToSkip_ = 0;
+   }
+   
+   // Key frame alone is produced as it is, interpolated frames need key frames after it too
+   int numNeeded = 1;
+   
+   if (phase_ > 0)
+      numNeeded = interpolation_ == TEMPORAL_INTERPOLATION_CUBIC ? 3 : 2;
+   
+   while (keyFrames_.size() < numNeeded)
+      keyFrames_.push_back(prefetcher_.popFrame());
+}
+
+double TemporalFrameInterpolator::getPosition(double timeSlice) const
+{
+   return easing_ ? easing_(timeSlice) : timeSlice;
+}
+
+void TemporalFrameInterpolator::interpolateFrame(Frame *frame) const
+{
+   const Frame *first = keyFrames_[0].get();
+   const Frame *second = keyFrames_[1].get();
+   const int numValues = frame->getSizeX() * frame->getSizeY();
+   
+   const double firstTimeSlice = first->getTimeSlice(), secondTimeSlice = second->getTimeSlice();
+   
+   // Across the loop point (and at the end of the animation that doesn't loop) timeslices don't grow, so frames are interpolated uniformly there
+   const bool uniform = !(firstTimeSlice < secondTimeSlice  &&  firstTimeSlice <= timeSlice_  &&  timeSlice_ <= secondTimeSlice);
+   
+   if (interpolation_ == TEMPORAL_INTERPOLATION_LINEAR)
+   {
+      double weight = (double)phase_ / keyFrameInterval_;
+      
+      if (!uniform)
+      {
+         double firstPosition = getPosition(firstTimeSlice), secondPosition = getPosition(secondTimeSlice);
+         
+         if (secondPosition > firstPosition)
+            weight = (getPosition(timeSlice_) - firstPosition) / (secondPosition - firstPosition);
+      }
+      
+      weight = weight < 0 ? 0 : (weight > 1 ? 1 : weight);
+      
+      parallelFor2D(pool_, numValues, 1, CHUNK_SIZE, 1, InterpolateLinearBody(first->getValues(), second->getValues(), (float)weight,
+                                                                              frame->getMutableValues()));
+      return;
+   }
+   
+   // Key frame before the first one is not known right after seek, the first one is used instead
+   const Frame *previous = previousKeyFrame_.isValid() ? previousKeyFrame_.get() : first;
+   const Frame *next = keyFrames_[2].get();
+   
+   const double previousTimeSlice = previous->getTimeSlice(), nextTimeSlice = next->getTimeSlice();
+   
+   // Positions of the key frames and of the frame. Duplicated key frames (at the start, and at the end of the animation) get the same position
+   double previousPosition = previous == first ? 0 : -1;
+   double firstPosition = 0, secondPosition = 1;
+   double nextPosition = nextTimeSlice == secondTimeSlice ? 1 : 2;
+   double position = (double)phase_ / keyFrameInterval_;
+   
+   if (!uniform  &&  previousTimeSlice <= firstTimeSlice  &&  secondTimeSlice <= nextTimeSlice)
+   {
+      previousPosition = getPosition(previousTimeSlice);
+      firstPosition = getPosition(firstTimeSlice);
+      secondPosition = getPosition(secondTimeSlice);
+      nextPosition = getPosition(nextTimeSlice);
+      
+      position = secondPosition > firstPosition ? getPosition(timeSlice_) : firstPosition + position * (secondPosition - firstPosition);
+   }
+   
+   float weights[4];
+   getCubicWeights(previousPosition, firstPosition, secondPosition, nextPosition, position, weights);
+   
+   parallelFor2D(pool_, numValues, 1, CHUNK_SIZE, 1, InterpolateCubicBody(previous->getValues(), first->getValues(), second->getValues(), next->getValues(),
+                                                                          weights, frame->getMutableValues()));
+}
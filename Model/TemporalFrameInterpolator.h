@@ -0,0 +1,357 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPORAL_FRAME_INTERPOLATOR_H_
+#define TEMPORAL_FRAME_INTERPOLATOR_H_
+
+#include <deque>
+
+#include "FramePrefetcher.h"
+#include "FramePublisher.h"
+#include "ThreadPool.h"
+
+namespace hdsim {
+   
+   class GPUInterpolatedModel;
+   
+   /**
+    * How frames between two key frames are interpolated
+    */
+   enum TemporalInterpolation {
+      /**
+       * Linear interpolation between the two key frames around the frame
+       */
+      TEMPORAL_INTERPOLATION_LINEAR = 0,
+      
+      /**
+       * Cubic (Hermite) interpolation through the four key frames around the frame, with tangents from the neighbouring key frames. Result is clamped to
+       * the values of the two key frames around the frame, so moxels never overshoot at the steps
+       */
+      TEMPORAL_INTERPOLATION_CUBIC = 1
+   };
+   
+   /**
+    * Maps timeslice to the position in the animation, the same way as the shader of the model does. Interpolation is then linear (or cubic) in that
+    * position instead of in the timeslice
+    */
+   typedef double (*TimeSliceEasing)(double timeSlice);
+   
+   /**
+    * Actuators want new frames at a higher rate than big boards could be calculated at. Interpolator calculates only every keyFrameInterval-th frame of the
+    * animation (key frames) and produces frames in between by interpolating every moxel between the key frames around them.
+    *
+    * Key frames are calculated ahead by the FramePrefetcher, so the consumer normally never waits for them. Interpolated frames are written into buffers
+    * recycled by the FramePublisher, and every produced frame (key or interpolated) is published to it, so other readers could get the latest frame.
+    *
+    * Interface is the same as the one of the FramePrefetcher, so it could be used by the FrameScheduler in its place (FrameScheduler::setInterpolator()).
+    * Interpolator is meant to be used from a single consumer thread.
+    */
+   class TemporalFrameInterpolator {
+      
+   public:
+      
+      /**
+       * Default number of frames per key frame
+       */
+      static const int DEFAULT_KEY_FRAME_INTERVAL = 4;
+      
+      /**
+       * Default number of key frames kept requested ahead
+       */
+      static const int DEFAULT_DEPTH = 3;
+      
+      /**
+       * Constructor. Doesn't request anything until seek() is called
+       *
+       * @param model Model to calculate. Key frames are calculated on its clone
+       * @param keyFrameInterval Number of frames per key frame. 1 calculates every frame
+       * @param interpolation How frames between key frames are interpolated
+       * @param depth Number of key frames to keep requested ahead
+       * @param pool Pool used to interpolate big frames in parallel, or 0 for the shared pool
+       */
+      TemporalFrameInterpolator(const GPUInterpolatedModel &model, int keyFrameInterval = DEFAULT_KEY_FRAME_INTERVAL,
+                                TemporalInterpolation interpolation = TEMPORAL_INTERPOLATION_LINEAR, int depth = DEFAULT_DEPTH, ThreadPool *pool = 0);
+      
+      /**
+       * Destructor. Cancels all pending requests
+       */
+      virtual ~TemporalFrameInterpolator();
+      
+      /**
+       * Position on the slow in slow out curve of ModelFiles/SlowInSlowOut.fs. Depth calculated with that shader is linear in this position, so linear
+       * interpolation with this easing gives exact frames
+       *
+       * @param timeSlice Timeslice, in [0, 1]
+       *
+       * @return Position on the curve
+       */
+      static double getSlowInSlowOutPosition(double timeSlice);
+      
+      /**
+       * Interpolate linearly between two frames
+       *
+       * @param first Values of the first frame
+       * @param second Values of the second frame
+       * @param weight Weight of the second frame
+       * @param numValues Number of values
+       * @param values (OUT) Interpolated values
+       */
+      static void interpolateLinear(const float *first, const float *second, float weight, int numValues, float *values);
+      
+      /**
+       * Get weights of the four key frames for the cubic interpolation. Polynomial is Hermite on [firstPosition, secondPosition], with tangents
+       * estimated from the neighbouring key frames (Catmull-Rom for uniformly spaced key frames), so values that are linear in the position are
+       * interpolated exactly
+       *
+       * @param previousPosition Position of the key frame before the first one. Same as firstPosition if it is not known
+       * @param firstPosition Position of the first key frame
+       * @param secondPosition Position of the second key frame
+       * @param nextPosition Position of the key frame after the second one. Same as secondPosition if it is not known
+       * @param position Position of the interpolated frame
+       * @param weights (OUT) Weights of the four key frames
+       */
+      static void getCubicWeights(double previousPosition, double firstPosition, double secondPosition, double nextPosition, double position,
+                                  float weights[4]);
+      
+      /**
+       * Interpolate between two frames with the cubic polynomial. Result is weights[0] * previous + weights[1] * first + weights[2] * second +
+       * weights[3] * next, clamped to the values of first and second
+       *
+       * @param previous Values of the frame before the first one
+       * @param first Values of the first frame
+       * @param second Values of the second frame
+       * @param next Values of the frame after the second one
+       * @param weights Weights of the four frames
+       * @param numValues Number of values
+       * @param values (OUT) Interpolated values
+       */
+      static void interpolateCubic(const float *previous, const float *first, const float *second, const float *next, const float weights[4], int numValues,
+                                   float *values);
+      
+      /**
+       * Set mapping of timeslice to the position in the animation, as done by the shader of the model
+       *
+       * @param easing Easing to use, or 0 to interpolate in the timeslice
+       */
+      virtual void setEasing(TimeSliceEasing easing)
+      {
+         easing_ = easing;
+      }
+      
+      /**
+       * Set animation parameters. If they differ from the current ones, key frames are recalculated from the last produced frame
+       *
+       * @param interframeDistance Distance between two produced frames of animation
+       * @param loop Should animation loop
+       */
+      virtual void setAnimation(double interframeDistance, bool loop);
+      
+      /**
+       * Drop key frames and request new ones, so that the next produced frame is the one following currentTimeSlice. Key frame is calculated at
+       * currentTimeSlice too, so the first frames have to wait for it
+       *
+       * @param currentTimeSlice Timeslice of the current frame
+       */
+      virtual void seek(double currentTimeSlice);
+      
+      /**
+       * Replace model (geometry, rendered area, drawing optimization), recalculating key frames
+       *
+       * @param model New model. Key frames are calculated on its clone
+       */
+      virtual void setModel(const GPUInterpolatedModel &model);
+      
+      /**
+       * Produce next frame and publish it. Waits for the key frames it is interpolated from if they are not calculated yet
+       *
+       * PRECONDITION: seek() must be called before first frame is produced
+       *
+       * @return Next frame of the animation
+       */
+      virtual FrameHandle popFrame();
+      
+      /**
+       * Skip next numFrames frames. Key frames that are no longer needed are dropped without waiting for them
+       *
+       * @param numFrames Number of frames to skip
+       */
+      virtual void skipFrames(int numFrames);
+      
+      /**
+       * Get publisher to which produced frames are published, and whose buffers are used for the interpolated frames
+       *
+       * @return Publisher of the produced frames
+       */
+      virtual FramePublisher *getFramePublisher()
+      {
+         return &publisher_;
+      }
+      
+      /**
+       * Get number of frames per key frame
+       *
+       * @return Key frame interval
+       */
+      virtual int getKeyFrameInterval() const
+      {
+         return keyFrameInterval_;
+      }
+      
+      /**
+       * Get how frames between key frames are interpolated
+       *
+       * @return Interpolation
+       */
+      virtual TemporalInterpolation getInterpolation() const
+      {
+         return interpolation_;
+      }
+      
+      /**
+       * Get number of produced frames that were key frames
+       *
+       * @return Number of key frames
+       */
+      virtual long getNumKeyFrames() const
+      {
+         return numKeyFrames_;
+      }
+      
+      /**
+       * Get number of produced frames that were interpolated
+       *
+       * @return Number of interpolated frames
+       */
+      virtual long getNumInterpolatedFrames() const
+      {
+         return numInterpolatedFrames_;
+      }
+      
+      /**
+       * Get prefetcher calculating the key frames, for its hit and miss accounting
+       *
+       * @return Prefetcher of the key frames
+       */
+      virtual const FramePrefetcher &getKeyFramePrefetcher() const
+      {
+         return prefetcher_;
+      }
+   
+   private:
+      
+      // copying is not supported
+      TemporalFrameInterpolator(const TemporalFrameInterpolator &rhs);
+      TemporalFrameInterpolator &operator=(const TemporalFrameInterpolator &rhs);
+      
+      /**
+       * Move to the next frame slot, dropping key frame if we moved past it
+       */
+      void advance();
+      
+      /**
+       * Pop key frames from the prefetcher until all key frames needed for the current frame are there
+       */
+      void fetchKeyFrames();
+      
+      /**
+       * Get position of the timeslice in the animation
+       */
+      double getPosition(double timeSlice) const;
+      
+      /**
+       * Interpolate current frame from the key frames
+       *
+       * @param frame (OUT) Frame to write to
+       */
+      void interpolateFrame(Frame *frame) const;
+      
+      /**
+       * Prefetcher calculating key frames
+       */
+      FramePrefetcher prefetcher_;
+      
+      /**
+       * Publisher of the produced frames, and the pool of their buffers
+       */
+      FramePublisher publisher_;
+      
+      /**
+       * Pool used for interpolation
+       */
+      ThreadPool *pool_;
+      
+      /**
+       * Number of frames per key frame
+       */
+      int keyFrameInterval_;
+      
+      /**
+       * How frames between key frames are interpolated
+       */
+      TemporalInterpolation interpolation_;
+      
+      /**
+       * Mapping of timeslice to the position in the animation, or 0
+       */
+      TimeSliceEasing easing_;
+      
+      /**
+       * Animation parameters
+       */
+      double interframeDistance_;
+      bool loop_;
+      
+      /**
+       * Key frame before the current one. Invalid if it is not known, in which case the current one is used
+       */
+      FrameHandle previousKeyFrame_;
+      
+      /**
+       * Current key frame (at or before the current frame), and the key frames after it. Filled on demand by fetchKeyFrames()
+       */
+      std::deque<FrameHandle> keyFrames_;
+      
+      /**
+       * Number of key frames that have to be skipped in the prefetcher before the next one is popped
+       */
+      int numKeyFramesToSkip_;
+      
+      /**
+       * Position of the current frame after the current key frame, from 0 to keyFrameInterval - 1
+       */
+      int phase_;
+      
+      /**
+       * Timeslice of the current frame
+       */
+      double timeSlice_;
+      
+      /**
+       * Was seek() called
+       */
+      bool wasSeeked_;
+      
+      /**
+       * Accounting
+       */
+      long numKeyFrames_, numInterpolatedFrames_;
+   };
+   
+} // namespace
+
+#endif
@@ -0,0 +1,450 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "TiledDepthEngine.h"
+#include "GPUGeometryModel.h"
+#include "SimpleDesignByContract.h"
+
+using namespace hdsim;
+using namespace std;
+
+namespace hdsim {
+   
+   /**
+    * Calculates pending tiles. Tile range is the range of indexes into the pending tiles
+    */
+   class CalculateTilesBody : public TileRangeBody {
+      
+   public:
+      
+      CalculateTilesBody(TiledDepthEngine *engine) : engine_(engine)
+      {
+      }
+      
+      virtual void processTile(const TileRange &range) const
+      {
+         for (int i = range.beginX; i < range.endX; i++)
+            engine_->calculateTile(engine_->pendingTiles_[i]);
+      }
+      
+   private:
+      
+      TiledDepthEngine *engine_;
+   };
+   
+} // namespace
+
+/**
+ * Find is the new view the old one moved by whole moxels in X and Y, and by how many
+ *
+ * @param oldView Old view
+ * @param newView New view
+ * @param shiftX (OUT) Moxels the view moved in X direction
+ * @param shiftY (OUT) Moxels the view moved in Y direction
+ *
+ * @return Is view only moved by whole moxels
+ */
+static bool getViewShift(const OrthographicView &oldView, const OrthographicView &newView, int *shiftX, int *shiftY)
+{
+   // Tolerance in moxels
+   const double DELTA = 1e-6;
+   
+   if (memcmp(oldView.right, newView.right, sizeof(oldView.right))  ||  memcmp(oldView.up, newView.up, sizeof(oldView.up))  ||  
+       memcmp(oldView.direction, newView.direction, sizeof(oldView.direction))  ||  oldView.sizeX != newView.sizeX  ||  
+       oldView.sizeY != newView.sizeY  ||  oldView.minZ != newView.minZ  ||  oldView.maxZ != newView.maxZ)
+      return false;
+   
+   double moxelX = (oldView.maxX - oldView.minX) / oldView.sizeX, moxelY = (oldView.maxY - oldView.minY) / oldView.sizeY;
+   
+   if (fabs((newView.maxX - newView.minX) / newView.sizeX - moxelX) > DELTA * moxelX  ||  
+       fabs((newView.maxY - newView.minY) / newView.sizeY - moxelY) > DELTA * moxelY)
+      return false;
+   
+   double x = (newView.minX - oldView.minX) / moxelX, y = (newView.minY - oldView.minY) / moxelY;
+   double roundedX = floor(x + 0.5), roundedY = floor(y + 0.5);
+   
+   if (fabs(x - roundedX) > DELTA  ||  fabs(y - roundedY) > DELTA)
+      return false;
+   
+   *shiftX = (int)roundedX;
+   *shiftY = (int)roundedY;
+   
+   return true;
+}
+
+TiledDepthEngine::TiledDepthEngine(int tileSize, ThreadPool *pool) : tileSize_(tileSize), pool_(pool ? pool : ThreadPool::getSharedPool()), sizeX_(0), 
+                                                                     sizeY_(0), numTilesX_(0), numTilesY_(0), binsValid_(false), geometryFingerprint_(0), 
+                                                                     geometryFingerprintValid_(false), emptyView_(false), numValidTiles_(0), 
+                                                                     numTileCalculations_(0), numGeometryUploads_(0), numIncrementalUpdates_(0), 
+                                                                     numShifts_(0), numSkippedTriangles_(0)
+{
+   PRECONDITION(tileSize > 0);
+}
+
+TiledDepthEngine::~TiledDepthEngine()
+{
+}
+
+void TiledDepthEngine::update(const GPUGeometryModel &model)
+{
+   unsigned long long fingerprint = model.getGeometryFingerprint();
+   bool keepValues = geometryFingerprintValid_  &&  fingerprint == geometryFingerprint_;
+   
+   if (!keepValues)
+   {
+      scene_.setFromModel(model);
+      geometryFingerprint_ = fingerprint;
+      geometryFingerprintValid_ = true;
+      numGeometryUploads_++;
+   }
+   
+   if (model.getSizeX() != sizeX_  ||  model.getSizeY() != sizeY_)
+   {
+      keepValues = false;
+
+      sizeX_ = model.getSizeX();
+      sizeY_ = model.getSizeY();
+      numTilesX_ = (sizeX_ + tileSize_ - 1) / tileSize_;
+      numTilesY_ = (sizeY_ + tileSize_ - 1) / tileSize_;
+      
+      depth_.resize(sizeX_ * sizeY_);
+      tileValid_.resize(numTilesX_ * numTilesY_);
+   }
+   
+   if (!sizeX_  ||  !sizeY_)
+   {
+      invalidate();
+      return;
+   }
+   
+   OrthographicView view = getModelView(model);
+   
+   // Nothing is rendered without the rendered area, so the whole board is valid and empty
+   if (!hasRenderedArea(view))
+   {
+      fill(depth_.begin(), depth_.end(), 1.0f);
+      fill(tileValid_.begin(), tileValid_.end(), 1);
+      numValidTiles_ = tileValid_.size();
+      emptyView_ = true;
+      return;
+   }
+   
+   int shiftX = 0, shiftY = 0;
+   
+   keepValues = keepValues  &&  !emptyView_  &&  getViewShift(projection_.getView(), view, &shiftX, &shiftY);
+   emptyView_ = false;
+   
+   // Nothing changed
+   if (keepValues  &&  !shiftX  &&  !shiftY)
+      return;
+   
+   projection_.project(scene_, view);
+   binsValid_ = false;
+   
+   if (keepValues)
+      shift(shiftX, shiftY);
+   else
+      invalidate();
+}
+
+void TiledDepthEngine::shift(int shiftX, int shiftY)
+{
+   if (!shiftX  &&  !shiftY)
+      return;
+   
+   if (abs(shiftX) >= sizeX_  ||  abs(shiftY) >= sizeY_)
+   {
+      invalidate();
+      return;
+   }
+   
+   int width = sizeX_ - abs(shiftX);
+   int destinationX = max(-shiftX, 0), sourceX = max(shiftX, 0);
+   
+   // Rows are moved in the order that doesn't overwrite rows still to be moved
+   if (shiftY >= 0)
+   {
+      for (int y = 0; y < sizeY_ - shiftY; y++)
+         memmove(&depth_[y * sizeX_ + destinationX], &depth_[(y + shiftY) * sizeX_ + sourceX], width * sizeof(float));
+   }
+   else
+   {
+      for (int y = sizeY_ - 1; y >= -shiftY; y--)
+         memmove(&depth_[y * sizeX_ + destinationX], &depth_[(y + shiftY) * sizeX_ + sourceX], width * sizeof(float));
+   }
+   
+   shiftedTileValid_.assign(tileValid_.size(), 0);
+   numValidTiles_ = 0;
+   
+   for (int tile = 0; tile < tileValid_.size(); tile++)
+   {
+      TileRange range = getTileRange(tile);
+      TileRange source = {range.beginX + shiftX, range.endX + shiftX, range.beginY + shiftY, range.endY + shiftY};
+      
+      if (source.beginX < 0  ||  source.endX > sizeX_  ||  source.beginY < 0  ||  source.endY > sizeY_)
+         continue;
+      
+      bool valid = true;
+      
+      for (int tileY = source.beginY / tileSize_; valid  &&  tileY <= (source.endY - 1) / tileSize_; tileY++)
+         for (int tileX = source.beginX / tileSize_; valid  &&  tileX <= (source.endX - 1) / tileSize_; tileX++)
+            valid = tileValid_[tileY * numTilesX_ + tileX] != 0;
+      
+      if (valid)
+      {
+         shiftedTileValid_[tile] = 1;
+         numValidTiles_++;
+      }
+   }
+   
+   tileValid_.swap(shiftedTileValid_);
+   numShifts_++;
+}
+
+void TiledDepthEngine::updateEdits(const GPUGeometryModel &model, const vector<int> &editedPoints, const vector<int> &editedTriangles)
+{
+   int oldNumPoints = scene_.getNumPoints(), oldNumTriangles = scene_.getNumTriangles();
+   int numPoints = model.getNumPoints(), numTriangles = model.getNumTriangles();
+   
+   if (!geometryFingerprintValid_  ||  emptyView_  ||  !sizeX_  ||  !sizeY_  ||  model.getSizeX() != sizeX_  ||  model.getSizeY() != sizeY_  ||  
+       numPoints < oldNumPoints  ||  numTriangles < oldNumTriangles)
+   {
+      update(model);
+      return;
+   }
+   
+   OrthographicView view = getModelView(model);
+   if (memcmp(&view, &projection_.getView(), sizeof(view)))
+   {
+      update(model);
+      return;
+   }
+   
+   // Triangles using the edited points, or edited themselves. Replaced triangles are found through their old points here
+   pointEdited_.assign(numPoints, 0);
+   for (int i = 0; i < editedPoints.size(); i++)
+      pointEdited_[editedPoints[i]] = 1;
+   
+   affectedTriangles_.clear();
+   const int *indexes = scene_.getIndexes();
+   
+   for (int i = 0; i < oldNumTriangles; i++)
+      if (pointEdited_[indexes[3 * i]]  ||  pointEdited_[indexes[3 * i + 1]]  ||  pointEdited_[indexes[3 * i + 2]])
+         affectedTriangles_.push_back(i);
+   
+   for (int i = 0; i < editedTriangles.size(); i++)
+      if (editedTriangles[i] < oldNumTriangles)
+         affectedTriangles_.push_back(editedTriangles[i]);
+   
+   // Old footprints
+   for (int i = 0; i < affectedTriangles_.size(); i++)
+      invalidateTriangle(affectedTriangles_[i]);
+   
+   for (int i = 0; i < editedPoints.size(); i++)
+   {
+      if (editedPoints[i] >= oldNumPoints)
+         continue;
+      
+      const Point &point = model.getPoint(editedPoints[i]);
+      scene_.setPoint(editedPoints[i], point.getX(), point.getY(), point.getZ());
+   }
+   
+   for (int i = oldNumPoints; i < numPoints; i++)
+   {
+      const Point &point = model.getPoint(i);
+      scene_.addPoint(point.getX(), point.getY(), point.getZ());
+   }
+   
+   for (int i = 0; i < editedTriangles.size(); i++)
+   {
+      if (editedTriangles[i] >= oldNumTriangles)
+         continue;
+      
+      const TriangleByPointIndexes &triangle = model.getTriangle(editedTriangles[i]);
+      scene_.setTriangle(editedTriangles[i], triangle.getIndex1(), triangle.getIndex2(), triangle.getIndex3());
+   }
+   
+   for (int i = oldNumTriangles; i < numTriangles; i++)
+   {
+      const TriangleByPointIndexes &triangle = model.getTriangle(i);
+      scene_.addTriangle(triangle.getIndex1(), triangle.getIndex2(), triangle.getIndex3());
+      affectedTriangles_.push_back(i);
+   }
+   
+   // Projection has to be resized for the new points, otherwise only the edited ones are projected
+   if (numPoints != oldNumPoints)
+   {
+      projection_.project(scene_, view);
+   }
+   else
+   {
+      for (int i = 0; i < editedPoints.size(); i++)
+         projection_.reprojectPoint(editedPoints[i]);
+   }
+   
+   binsValid_ = false;
+   
+   // New footprints
+   for (int i = 0; i < affectedTriangles_.size(); i++)
+      invalidateTriangle(affectedTriangles_[i]);
+   
+   geometryFingerprint_ = model.getGeometryFingerprint();
+   numIncrementalUpdates_++;
+}
+
+void TiledDepthEngine::invalidateTriangle(int index)
+{
+   TileRange bounds;
+   projection_.getTriangleBounds(index, &bounds);
+   
+   invalidateRegion(bounds);
+}
+
+void TiledDepthEngine::invalidate()
+{
+   fill(tileValid_.begin(), tileValid_.end(), 0);
+   numValidTiles_ = 0;
+}
+
+void TiledDepthEngine::invalidateRegion(const TileRange &range)
+{
+   PRECONDITION(range.beginX >= 0  &&  range.endX <= sizeX_  &&  range.beginY >= 0  &&  range.endY <= sizeY_);
+   
+   if (range.beginX >= range.endX  ||  range.beginY >= range.endY)
+      return;
+   
+   for (int tileY = range.beginY / tileSize_; tileY <= (range.endY - 1) / tileSize_; tileY++)
+      for (int tileX = range.beginX / tileSize_; tileX <= (range.endX - 1) / tileSize_; tileX++)
+      {
+         unsigned char &valid = tileValid_[tileY * numTilesX_ + tileX];
+         
+         if (valid)
+         {
+            valid = 0;
+            numValidTiles_--;
+         }
+      }
+}
+
+TileRange TiledDepthEngine::getTileRange(int tile) const
+{
+   TileRange range;
+   
+   range.beginX = (tile % numTilesX_) * tileSize_;
+   range.beginY = (tile / numTilesX_) * tileSize_;
+   range.endX = min(range.beginX + tileSize_, sizeX_);
+   range.endY = min(range.beginY + tileSize_, sizeY_);
+   
+   return range;
+}
+
+void TiledDepthEngine::prepareBins()
+{
+   if (binsValid_)
+      return;
+   
+   bins_.bin(projection_, tileSize_, pool_);
+   binsValid_ = true;
+}
+
+void TiledDepthEngine::calculateTile(int tile)
+{
+   TileRange range = getTileRange(tile);
+   
+   clearDepth(range, &depth_[0], sizeX_);
+   
+   long numSkipped = rasterizeBinnedDepth(projection_, bins_, tile, &depth_[0], sizeX_);
+   __sync_fetch_and_add(&numSkippedTriangles_, numSkipped);
+}
+
+int TiledDepthEngine::getNumTileTriangles(int tileX, int tileY)
+{
+   PRECONDITION(tileX >= 0  &&  tileX < numTilesX_  &&  tileY >= 0  &&  tileY < numTilesY_);
+   
+   prepareBins();
+   return bins_.getNumTriangles(tileY * numTilesX_ + tileX);
+}
+
+double TiledDepthEngine::getAt(int x, int y)
+{
+   PRECONDITION(x >= 0  &&  x < sizeX_  &&  y >= 0  &&  y < sizeY_);
+   
+   int tile = (y / tileSize_) * numTilesX_ + x / tileSize_;
+   
+   if (!tileValid_[tile])
+   {
+      prepareBins();
+      calculateTile(tile);
+      tileValid_[tile] = 1;
+      numValidTiles_++;
+      numTileCalculations_++;
+   }
+   
+   return depth_[y * sizeX_ + x];
+}
+
+void TiledDepthEngine::calculateRegion(const TileRange &range)
+{
+   PRECONDITION(range.beginX >= 0  &&  range.endX <= sizeX_  &&  range.beginY >= 0  &&  range.endY <= sizeY_);
+   
+   if (range.beginX >= range.endX  ||  range.beginY >= range.endY)
+      return;
+   
+   pendingTiles_.clear();
+   
+   for (int tileY = range.beginY / tileSize_; tileY <= (range.endY - 1) / tileSize_; tileY++)
+      for (int tileX = range.beginX / tileSize_; tileX <= (range.endX - 1) / tileSize_; tileX++)
+         if (!tileValid_[tileY * numTilesX_ + tileX])
+            pendingTiles_.push_back(tileY * numTilesX_ + tileX);
+   
+   if (pendingTiles_.empty())
+      return;
+   
+   prepareBins();
+   parallelFor2D(pool_, pendingTiles_.size(), 1, 1, 1, CalculateTilesBody(this));
+   
+   for (int i = 0; i < pendingTiles_.size(); i++)
+      tileValid_[pendingTiles_[i]] = 1;
+   
+   numValidTiles_ += pendingTiles_.size();
+   numTileCalculations_ += pendingTiles_.size();
+}
+
+void TiledDepthEngine::readRegion(const TileRange &range, float *values)
+{
+   calculateRegion(range);
+   
+   int width = range.endX - range.beginX;
+   
+   for (int y = range.beginY; y < range.endY; y++)
+   {
+      const float *row = &depth_[0] + y * sizeX_;
+      copy(row + range.beginX, row + range.endX, values + (y - range.beginY) * width);
+   }
+}
+
+void TiledDepthEngine::readValues(float *values)
+{
+   TileRange board = {0, sizeX_, 0, sizeY_};
+   readRegion(board, values);
+}
@@ -0,0 +1,368 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILED_DEPTH_ENGINE_H_
+#define TILED_DEPTH_ENGINE_H_
+
+#include <vector>
+
+#include "SoftwareRasterizer.h"
+
+namespace hdsim {
+   
+   class GPUGeometryModel;
+   
+   /**
+    * Calculates the board lazily, tile by tile. Board is split into fixed tiles, each with a valid bit, and reading the moxel or the region calculates 
+    * only the tiles it touches that are not valid yet. Any change of the model invalidates all tiles. Depth is calculated on the CPU, the same way 
+    * as GPUCalculationEngine does with the null shader
+    */
+   class TiledDepthEngine {
+      
+   public:
+      
+      /**
+       * Default size of the tile, in moxels
+       */
+      static const int DEFAULT_TILE_SIZE = 64;
+      
+      /**
+       * Constructor
+       *
+       * @param tileSize Size of the tile
+       * @param pool Pool used to calculate tiles of the region in parallel, or 0 for the shared pool
+       */
+      TiledDepthEngine(int tileSize = DEFAULT_TILE_SIZE, ThreadPool *pool = 0);
+      
+      /**
+       * Destructor
+       */
+      virtual ~TiledDepthEngine();
+      
+      /**
+       * Use current state of the model. Geometry is copied only if it changed since the last call. If geometry and board size are the same and 
+       * rendered area is only moved by whole moxels, values are shifted with it, and only tiles that are newly exposed are invalidated. Otherwise all
+       * tiles are invalidated
+       *
+       * @param model Model to use
+       */
+      virtual void update(const GPUGeometryModel &model);
+      
+      /**
+       * Apply edits of the model geometry made since the last update, and invalidate only the tiles covered by the affected triangles, at both 
+       * their old and new positions. Points and triangles added at the end of the model are applied too. If the board or view changed since the
+       * last update, or geometry was removed, this is the same as update()
+       *
+       * @param model Model to use
+       * @param editedPoints Indexes of points replaced since the last update
+       * @param editedTriangles Indexes of triangles replaced since the last update
+       */
+      virtual void updateEdits(const GPUGeometryModel &model, const std::vector<int> &editedPoints, const std::vector<int> &editedTriangles);
+      
+      /**
+       * Invalidate all tiles
+       */
+      virtual void invalidate();
+      
+      /**
+       * Invalidate tiles that overlap the region
+       *
+       * @param range Region to invalidate
+       */
+      virtual void invalidateRegion(const TileRange &range);
+      
+      /**
+       * Get value at the particular location, calculating its tile if needed
+       *
+       * @param x X position
+       * @param y Y position
+       *
+       * @return Depth at that position
+       */
+      virtual double getAt(int x, int y);
+      
+      /**
+       * Calculate tiles overlapping the region that are not valid, in parallel
+       *
+       * @param range Region to calculate
+       */
+      virtual void calculateRegion(const TileRange &range);
+      
+      /**
+       * Read the region, calculating its tiles if needed
+       *
+       * @param range Region to read
+       * @param values (OUT) Values, stored so that [x][y] of the region corresponds to [(y - beginY) * (endX - beginX) + x - beginX]
+       */
+      virtual void readRegion(const TileRange &range, float *values);
+      
+      /**
+       * Read the whole board, calculating all tiles that are not valid
+       *
+       * @param values (OUT) Values, stored so that [x][y] corresponds to [y * sizeX + x]
+       */
+      virtual void readValues(float *values);
+      
+      /**
+       * Calculated values, without copying them or calculating missing tiles. Values of tiles that are not
+       * valid are undefined.
+       *
+       * @return Values, stored so that [x][y] corresponds to [y * sizeX + x]
+       */
+      const float *getValues() const
+      {
+         return depth_.empty() ? 0 : &depth_[0];
+      }
+      
+      /**
+       * Is tile valid
+       *
+       * @param tileX Index of the tile in X direction
+       * @param tileY Index of the tile in Y direction
+       *
+       * @return Is tile calculated since the last invalidation
+       */
+      virtual bool isTileValid(int tileX, int tileY) const
+      {
+         return tileValid_[tileY * numTilesX_ + tileX] != 0;
+      }
+      
+      /**
+       * Get size of the tile
+       *
+       * @return Size of the tile
+       */
+      virtual int getTileSize() const
+      {
+         return tileSize_;
+      }
+      
+      /**
+       * Get number of tiles in X direction
+       *
+       * @return Number of tiles
+       */
+      virtual int getNumTilesX() const
+      {
+         return numTilesX_;
+      }
+      
+      /**
+       * Get number of tiles in Y direction
+       *
+       * @return Number of tiles
+       */
+      virtual int getNumTilesY() const
+      {
+         return numTilesY_;
+      }
+      
+      /**
+       * Get number of valid (resident) tiles
+       *
+       * @return Number of valid tiles
+       */
+      virtual int getNumValidTiles() const
+      {
+         return numValidTiles_;
+      }
+      
+      /**
+       * Get number of tile calculations since the engine was created
+       *
+       * @return Number of tile calculations
+       */
+      virtual long getNumTileCalculations() const
+      {
+         return numTileCalculations_;
+      }
+      
+      /**
+       * Get number of times geometry was copied from the model
+       *
+       * @return Number of geometry uploads
+       */
+      virtual long getNumGeometryUploads() const
+      {
+         return numGeometryUploads_;
+      }
+      
+      /**
+       * Get number of times edits were applied without copying the whole geometry
+       *
+       * @return Number of incremental updates
+       */
+      virtual long getNumIncrementalUpdates() const
+      {
+         return numIncrementalUpdates_;
+      }
+      
+      /**
+       * Get number of times values were shifted because rendered area moved by whole moxels
+       *
+       * @return Number of shifts
+       */
+      virtual long getNumShifts() const
+      {
+         return numShifts_;
+      }
+      
+      /**
+       * Get number of triangles that were skipped because they were behind the depth already in the tile
+       *
+       * @return Number of skipped triangles
+       */
+      virtual long getNumSkippedTriangles() const
+      {
+         return numSkippedTriangles_;
+      }
+      
+      /**
+       * Get number of triangles binned to the tile, for the load balancing diagnostics. Bins the geometry if needed
+       *
+       * @param tileX Index of the tile in X direction
+       * @param tileY Index of the tile in Y direction
+       *
+       * @return Number of triangles that could cover the tile
+       */
+      virtual int getNumTileTriangles(int tileX, int tileY);
+      
+      /**
+       * Get size of the board in X direction
+       *
+       * @return Size in X direction
+       */
+      virtual int getSizeX() const
+      {
+         return sizeX_;
+      }
+      
+      /**
+       * Get size of the board in Y direction
+       *
+       * @return Size in Y direction
+       */
+      virtual int getSizeY() const
+      {
+         return sizeY_;
+      }
+      
+   private:
+      
+      // copying is not supported
+      TiledDepthEngine(const TiledDepthEngine &rhs);
+      TiledDepthEngine &operator=(const TiledDepthEngine &rhs);
+      
+      friend class CalculateTilesBody;
+      
+      /**
+       * Calculate single tile. Doesn't update the valid bits, so that it could be called in parallel
+       *
+       * @param tile Index of the tile
+       */
+      void calculateTile(int tile);
+      
+      /**
+       * Get range of the moxels covered by the tile
+       */
+      TileRange getTileRange(int tile) const;
+      
+      /**
+       * Bin triangles to the tiles, if projection changed since they were binned
+       */
+      void prepareBins();
+      
+      /**
+       * Shift values so that moxel (x, y) gets the value of moxel (x + shiftX, y + shiftY), and keep valid only tiles all of whose values were valid
+       */
+      void shift(int shiftX, int shiftY);
+      
+      /**
+       * Invalidate tiles covered by the current projection of the triangle
+       */
+      void invalidateTriangle(int index);
+      
+      /**
+       * Size of the tile
+       */
+      int tileSize_;
+      
+      /**
+       * Pool used for the regions
+       */
+      ThreadPool *pool_;
+      
+      /**
+       * Size of the board, and number of tiles
+       */
+      int sizeX_, sizeY_, numTilesX_, numTilesY_;
+      
+      /**
+       * Geometry, and its projection to the board
+       */
+      SceneGeometry scene_;
+      ProjectedGeometry projection_;
+      
+      /**
+       * Triangles of the projection binned to the tiles, and are they up to date with it
+       */
+      TriangleBins bins_;
+      bool binsValid_;
+      
+      /**
+       * Fingerprint of the model geometry was copied from, and is it valid
+       */
+      unsigned long long geometryFingerprint_;
+      bool geometryFingerprintValid_;
+      
+      /**
+       * Was the board empty because the model had no rendered area. Values are then not those of the projection
+       */
+      bool emptyView_;
+      
+      /**
+       * Depth of the board. Only valid tiles have meaningful values
+       */
+      std::vector<float> depth_;
+      
+      /**
+       * Valid bit of every tile
+       */
+      std::vector<unsigned char> tileValid_, shiftedTileValid_;
+      
+      /**
+       * Tiles that are calculated in the current region
+       */
+      std::vector<int> pendingTiles_;
+      
+      /**
+       * Flags of the edited points and triangles affected by the edits, used by updateEdits()
+       */
+      std::vector<unsigned char> pointEdited_;
+      std::vector<int> affectedTriangles_;
+      
+      /**
+       * Statistics
+       */
+      int numValidTiles_;
+      long numTileCalculations_, numGeometryUploads_, numIncrementalUpdates_, numShifts_, numSkippedTriangles_;
+   };
+   
+} // namespace
+
+#endif
@@ -0,0 +1,609 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "UpsampledDepthEngine.h"
+#include "GPUGeometryModel.h"
+#include "PreciseDelay.h"
+#include "SimpleDesignByContract.h"
+
+using namespace hdsim;
+using namespace std;
+
+const double UpsampledDepthEngine::DEFAULT_DISCONTINUITY_THRESHOLD;
+
+/**
+ * Size of the tiles in which coarse board is calculated
+ */
+static const int COARSE_TILE_SIZE = 64;
+
+namespace hdsim {
+   
+   /**
+    * Calculates tiles of the coarse board. Tile range is the range of tile indexes
+    */
+   class CalculateCoarseTilesBody : public TileRangeBody {
+      
+   public:
+      
+      CalculateCoarseTilesBody(UpsampledDepthEngine *engine) : engine_(engine)
+      {
+      }
+      
+      virtual void processTile(const TileRange &range) const
+      {
+         for (int i = range.beginX; i < range.endX; i++)
+            engine_->calculateCoarseTile(i);
+      }
+   
+   private:
+      
+      UpsampledDepthEngine *engine_;
+   };
+   
+   /**
+    * Interpolates tiles of the board from the coarse samples. Tile range is the range of tile indexes
+    */
+   class UpsampleTilesBody : public TileRangeBody {
+      
+   public:
+      
+      UpsampleTilesBody(UpsampledDepthEngine *engine) : engine_(engine)
+      {
+      }
+      
+      virtual void processTile(const TileRange &range) const
+      {
+         for (int i = range.beginX; i < range.endX; i++)
+            engine_->upsampleTile(i);
+      }
+   
+   private:
+      
+      UpsampledDepthEngine *engine_;
+   };
+   
+   /**
+    * Calculates tiles that could not be interpolated at the full resolution. Tile range is the range of indexes into the exact tiles
+    */
+   class CalculateExactTilesBody : public TileRangeBody {
+      
+   public:
+      
+      CalculateExactTilesBody(UpsampledDepthEngine *engine) : engine_(engine)
+      {
+      }
+      
+      virtual void processTile(const TileRange &range) const
+      {
+         for (int i = range.beginX; i < range.endX; i++)
+            engine_->calculateExactTile(engine_->exactTiles_[i]);
+      }
+   
+   private:
+      
+      UpsampledDepthEngine *engine_;
+   };
+   
+   /**
+    * Estimates error of the tiles and interpolates all of them, discontinuities or not. Tile range is the range of tile indexes
+    */
+   class InterpolateAllTilesBody : public TileRangeBody {
+      
+   public:
+      
+      InterpolateAllTilesBody(UpsampledDepthEngine *engine) : engine_(engine)
+      {
+      }
+      
+      virtual void processTile(const TileRange &range) const
+      {
+         for (int i = range.beginX; i < range.endX; i++)
+         {
+            engine_->tileError_[i] = engine_->estimateError(i);
+            engine_->tileExact_[i] = 0;
+            engine_->interpolateTile(i);
+         }
+      }
+   
+   private:
+      
+      UpsampledDepthEngine *engine_;
+   };
+   
+   /**
+    * Calculates tiles at the full resolution in the refinement order until the deadline. Tile range is the range of positions in the refinement order
+    */
+   class RefineTilesBody : public TileRangeBody {
+      
+   public:
+      
+      RefineTilesBody(UpsampledDepthEngine *engine, long long deadlineInMicroSeconds) : engine_(engine), deadlineInMicroSeconds_(deadlineInMicroSeconds)
+      {
+      }
+      
+      virtual void processTile(const TileRange &range) const
+      {
+         for (int i = range.beginX; i < range.endX; i++)
+         {
+            int tile = engine_->refinementOrder_[i];
+            
+            if (engine_->tileExact_[tile])
+               continue;
+            
+            if (getMonotonicTimeInMicroSeconds() >= deadlineInMicroSeconds_)
+               return;
+            
+            engine_->calculateExactTile(tile);
+            engine_->tileExact_[tile] = 1;
+         }
+      }
+   
+   private:
+      
+      UpsampledDepthEngine *engine_;
+      long long deadlineInMicroSeconds_;
+   };
+   
+} // namespace
+
+/**
+ * Orders tiles for the refinement: tiles in the region of interest first, then tiles with the larger estimated error
+ */
+class RefinementPriority {
+   
+public:
+   
+   RefinementPriority(const vector<char> &inRegion, const vector<float> &error) : inRegion_(inRegion), error_(error)
+   {
+   }
+   
+   bool operator()(int lhs, int rhs) const
+   {
+      if (inRegion_[lhs] != inRegion_[rhs])
+         return inRegion_[lhs] > inRegion_[rhs];
+      
+      if (error_[lhs] != error_[rhs])
+         return error_[lhs] > error_[rhs];
+      
+      return lhs < rhs;
+   }
+
+private:
+   
+   const vector<char> &inRegion_;
+   const vector<float> &error_;
+};
+
+/**
+ * Find the two coarse samples the moxel is interpolated from. Coarse sample i is in the center of the moxels [i * factor, (i + 1) * factor)
+ *
+ * @param position Position of the moxel
+ * @param factor Ratio of the full and coarse resolution
+ * @param coarseSize Number of the coarse samples
+ * @param first (OUT) First coarse sample
+ * @param second (OUT) Second coarse sample
+ * @param weight (OUT) Weight of the second sample
+ */
+static void getInterpolation(int position, int factor, int coarseSize, int *first, int *second, float *weight)
+{
+   // Center of the moxel in the coordinates in which coarse samples are at the integers
+   double coarse = (position + 0.5) / factor - 0.5;
+   
+   if (coarseSize < 2)
+   {
+      *first = *second = 0;
+      *weight = 0;
+      return;
+   }
+   
+   // Moxels before the first or past the last sample are extrapolated from the two samples closest to them
+   int index = (int)floor(coarse);
+   index = index < 0 ? 0 : (index > coarseSize - 2 ? coarseSize - 2 : index);
+   
+   *first = index;
+   *second = index + 1;
+   *weight = (float)(coarse - index);
+}
+
+UpsampledDepthEngine::UpsampledDepthEngine(int factor, double discontinuityThreshold, ThreadPool *pool) : factor_(factor),
+                                                                                                       discontinuityThreshold_(discontinuityThreshold),
+                                                                                                       pool_(pool ? pool : ThreadPool::getSharedPool()),
+                                                                                                       sizeX_(0), sizeY_(0), coarseSizeX_(0),
+                                                                                                       coarseSizeY_(0), numTilesX_(0), numTilesY_(0),
+                                                                                                       projected_(false), fullResolutionFraction_(0)
+{
+   PRECONDITION(factor >= 2);
+   PRECONDITION(discontinuityThreshold >= 0);
+   
+   resetProgressiveStatistics();
+}
+
+UpsampledDepthEngine::~UpsampledDepthEngine()
+{
+   
+}
+
+void UpsampledDepthEngine::setSize(int sizeX, int sizeY)
+{
+   sizeX_ = sizeX;
+   sizeY_ = sizeY;
+   coarseSizeX_ = (sizeX + factor_ - 1) / factor_;
+   coarseSizeY_ = (sizeY + factor_ - 1) / factor_;
+   numTilesX_ = (sizeX + TILE_SIZE - 1) / TILE_SIZE;
+   numTilesY_ = (sizeY + TILE_SIZE - 1) / TILE_SIZE;
+   
+   coarse_.resize(coarseSizeX_ * coarseSizeY_);
+   depth_.resize(sizeX * sizeY);
+   tileExact_.assign(numTilesX_ * numTilesY_, 0);
+   tileError_.assign(numTilesX_ * numTilesY_, 0);
+   
+   firstColumn_.resize(sizeX);
+   secondColumn_.resize(sizeX);
+   columnWeight_.resize(sizeX);
+   
+   for (int x = 0; x < sizeX; x++)
+      getInterpolation(x, factor_, coarseSizeX_, &firstColumn_[x], &secondColumn_[x], &columnWeight_[x]);
+   
+   firstRow_.resize(sizeY);
+   secondRow_.resize(sizeY);
+   rowWeight_.resize(sizeY);
+   
+   for (int y = 0; y < sizeY; y++)
+      getInterpolation(y, factor_, coarseSizeY_, &firstRow_[y], &secondRow_[y], &rowWeight_[y]);
+}
+
+TileRange UpsampledDepthEngine::getTileRange(int tile) const
+{
+   TileRange range;
+   
+   range.beginX = (tile % numTilesX_) * TILE_SIZE;
+   range.beginY = (tile / numTilesX_) * TILE_SIZE;
+   range.endX = range.beginX + TILE_SIZE < sizeX_ ? range.beginX + TILE_SIZE : sizeX_;
+   range.endY = range.beginY + TILE_SIZE < sizeY_ ? range.beginY + TILE_SIZE : sizeY_;
+   
+   return range;
+}
+
+void UpsampledDepthEngine::calculate(const GPUGeometryModel &model)
+{
+   if (model.getSizeX() != sizeX_  ||  model.getSizeY() != sizeY_)
+      setSize(model.getSizeX(), model.getSizeY());
+   
+   exactTiles_.clear();
+   refinementOrder_.clear();
+   projected_ = false;
+   
+   if (!sizeX_  ||  !sizeY_)
+      return;
+   
+   if (!hasRenderedArea(getModelView(model)))
+   {
+      calculateEmptyBoard();
+      return;
+   }
+   
+   calculateCoarseBoard(model);
+   parallelFor2D(pool_, numTilesX_ * numTilesY_, 1, 1, 1, UpsampleTilesBody(this));
+   
+   updateExactTiles();
+   
+   // Full resolution geometry is needed only if there are tiles with discontinuities
+   if (exactTiles_.empty())
+      return;
+   
+   projection_.project(scene_, view_);
+   bins_.bin(projection_, TILE_SIZE, pool_);
+   projected_ = true;
+   
+   parallelFor2D(pool_, exactTiles_.size(), 1, 1, 1, CalculateExactTilesBody(this));
+}
+
+void UpsampledDepthEngine::calculateProgressive(const GPUGeometryModel &model, long long deadlineInMicroSeconds, const TileRange *regionOfInterest)
+{
+   if (model.getSizeX() != sizeX_  ||  model.getSizeY() != sizeY_)
+      setSize(model.getSizeX(), model.getSizeY());
+   
+   exactTiles_.clear();
+   refinementOrder_.clear();
+   projected_ = false;
+   
+   if (!sizeX_  ||  !sizeY_)
+      return;
+   
+   if (!hasRenderedArea(getModelView(model)))
+   {
+      calculateEmptyBoard();
+      accountFrame(true);
+      return;
+   }
+   
+   // Whole board is available at the coarse resolution first, whatever happens with the deadline
+   calculateCoarseBoard(model);
+   parallelFor2D(pool_, numTilesX_ * numTilesY_, 1, 1, 1, InterpolateAllTilesBody(this));
+   
+   vector<char> inRegion(numTilesX_ * numTilesY_, 0);
+   
+   for (int i = 0; i < inRegion.size()  &&  regionOfInterest; i++)
+   {
+      TileRange range = getTileRange(i);
+      
+      inRegion[i] = range.beginX < regionOfInterest->endX  &&  regionOfInterest->beginX < range.endX  &&
+                    range.beginY < regionOfInterest->endY  &&  regionOfInterest->beginY < range.endY;
+   }
+   
+   refinementOrder_.resize(numTilesX_ * numTilesY_);
+   
+   for (int i = 0; i < refinementOrder_.size(); i++)
+      refinementOrder_[i] = i;
+   
+   sort(refinementOrder_.begin(), refinementOrder_.end(), RefinementPriority(inRegion, tileError_));
+   
+   refine(deadlineInMicroSeconds);
+   accountFrame(true);
+}
+
+void UpsampledDepthEngine::continueRefinement(long long deadlineInMicroSeconds)
+{
+   if (refinementOrder_.empty())
+      return;
+   
+   refine(deadlineInMicroSeconds);
+   accountFrame(false);
+}
+
+void UpsampledDepthEngine::refine(long long deadlineInMicroSeconds)
+{
+   // Full resolution geometry is prepared only if there is time to refine anything
+   if (!projected_  &&  getMonotonicTimeInMicroSeconds() < deadlineInMicroSeconds)
+   {
+      projection_.project(scene_, view_);
+      bins_.bin(projection_, TILE_SIZE, pool_);
+      projected_ = true;
+   }
+   
+   if (projected_  &&  !isRefinementComplete())
+      parallelFor2D(pool_, refinementOrder_.size(), 1, 1, 1, RefineTilesBody(this, deadlineInMicroSeconds));
+   
+   updateExactTiles();
+}
+
+void UpsampledDepthEngine::accountFrame(bool newFrame)
+{
+   // Continued refinement replaces what its frame was accounted with, so every frame counts once, with the fraction it was refined to in the end
+   if (newFrame  ||  !frameAccounted_)
+   {
+      previousMinFraction_ = statistics_.minFullResolutionFraction;
+      statistics_.numFrames++;
+   }
+   else
+   {
+      statistics_.meanFullResolutionFraction -= accountedFraction_;
+      
+      if (accountedComplete_)
+         statistics_.numCompleteFrames--;
+   }
+   
+   frameAccounted_ = true;
+   accountedFraction_ = fullResolutionFraction_;
+   accountedComplete_ = isRefinementComplete();
+   
+   if (accountedComplete_)
+      statistics_.numCompleteFrames++;
+   
+   statistics_.meanFullResolutionFraction += accountedFraction_;
+   statistics_.minFullResolutionFraction = statistics_.numFrames == 1  ||  accountedFraction_ < previousMinFraction_ ? accountedFraction_ : 
+                                                                                                                      previousMinFraction_;
+}
+
+void UpsampledDepthEngine::calculateCoarseBoard(const GPUGeometryModel &model)
+{
+   scene_.setFromModel(model);
+   
+   // Coarse board covers whole coarse moxels, so it could reach past the rendered area
+   view_ = getModelView(model);
+   OrthographicView coarseView = view_;
+   
+   coarseView.maxX = view_.minX + (view_.maxX - view_.minX) * coarseSizeX_ * factor_ / sizeX_;
+   coarseView.maxY = view_.minY + (view_.maxY - view_.minY) * coarseSizeY_ * factor_ / sizeY_;
+   coarseView.sizeX = coarseSizeX_;
+   coarseView.sizeY = coarseSizeY_;
+   
+   coarseProjection_.project(scene_, coarseView);
+   coarseBins_.bin(coarseProjection_, COARSE_TILE_SIZE, pool_);
+   parallelFor2D(pool_, coarseBins_.getNumTilesX() * coarseBins_.getNumTilesY(), 1, 1, 1, CalculateCoarseTilesBody(this));
+}
+
+void UpsampledDepthEngine::calculateEmptyBoard()
+{
+   // Nothing is rendered without the rendered area, and the empty board is exact
+   fill(depth_.begin(), depth_.end(), 1.0f);
+   fill(tileExact_.begin(), tileExact_.end(), 1);
+   
+   updateExactTiles();
+}
+
+void UpsampledDepthEngine::calculateCoarseTile(int tile)
+{
+   clearDepth(coarseBins_.getTileRange(tile), &coarse_[0], coarseSizeX_);
+   rasterizeBinnedDepth(coarseProjection_, coarseBins_, tile, &coarse_[0], coarseSizeX_);
+}
+
+bool UpsampledDepthEngine::hasDiscontinuity(int tile) const
+{
+   TileRange range = getTileRange(tile);
+   
+   // Coarse samples the tile is interpolated from
+   const int beginColumn = firstColumn_[range.beginX], endColumn = secondColumn_[range.endX - 1] + 1;
+   const int beginRow = firstRow_[range.beginY], endRow = secondRow_[range.endY - 1] + 1;
+   const float threshold = discontinuityThreshold_;
+   
+   for (int row = beginRow; row < endRow; row++)
+   {
+      const float *samples = &coarse_[row * coarseSizeX_];
+      
+      for (int column = beginColumn; column < endColumn; column++)
+      {
+         bool stepX = column + 1 < endColumn  &&  fabs(samples[column + 1] - samples[column]) > threshold;
+         bool stepY = row + 1 < endRow  &&  fabs(samples[column + coarseSizeX_] - samples[column]) > threshold;
+         
+         if (stepX  ||  stepY)
+            return true;
+      }
+   }
+   
+   return false;
+}
+
+float UpsampledDepthEngine::estimateError(int tile) const
+{
+   TileRange range = getTileRange(tile);
+   
+   // Coarse samples the tile is interpolated from, and one more on every side for the second differences
+   const int beginColumn = firstColumn_[range.beginX] > 0 ? firstColumn_[range.beginX] - 1 : 0;
+   const int endColumn = secondColumn_[range.endX - 1] + 2 < coarseSizeX_ ? secondColumn_[range.endX - 1] + 2 : coarseSizeX_;
+   const int beginRow = firstRow_[range.beginY] > 0 ? firstRow_[range.beginY] - 1 : 0;
+   const int endRow = secondRow_[range.endY - 1] + 2 < coarseSizeY_ ? secondRow_[range.endY - 1] + 2 : coarseSizeY_;
+   
+   float error = 0;
+   
+   for (int row = beginRow; row < endRow; row++)
+   {
+      const float *samples = &coarse_[row * coarseSizeX_];
+      
+      for (int column = beginColumn; column < endColumn; column++)
+      {
+         float differenceX = column > beginColumn  &&  column + 1 < endColumn ? fabs(samples[column - 1] - 2 * samples[column] + samples[column + 1]) : 0;
+         float differenceY = row > beginRow  &&  row + 1 < endRow ? fabs(samples[column - coarseSizeX_] - 2 * samples[column] + samples[column + coarseSizeX_]) : 0;
+         
+         error = differenceX > error ? differenceX : error;
+         error = differenceY > error ? differenceY : error;
+      }
+   }
+   
+   return error;
+}
+
+bool UpsampledDepthEngine::upsampleTile(int tile)
+{
+   if (hasDiscontinuity(tile))
+   {
+      tileExact_[tile] = 1;
+      return false;
+   }
+   
+   tileExact_[tile] = 0;
+   interpolateTile(tile);
+   
+   return true;
+}
+
+void UpsampledDepthEngine::interpolateTile(int tile)
+{
+   TileRange range = getTileRange(tile);
+   
+   // Coarse samples the tile is interpolated from
+   const int beginRow = firstRow_[range.beginY], endRow = secondRow_[range.endY - 1] + 1;
+   
+   // Coarse rows are interpolated to the full resolution in X first, and then rows of the tile are interpolated between them
+   float interpolated[(TILE_SIZE / 2 + 2) * TILE_SIZE];
+   const int width = range.endX - range.beginX;
+   
+   for (int row = beginRow; row < endRow; row++)
+   {
+      const float *samples = &coarse_[row * coarseSizeX_];
+      float *out = interpolated + (row - beginRow) * TILE_SIZE;
+      
+      for (int x = 0; x < width; x++)
+      {
+         int column = range.beginX + x;
+         float first = samples[firstColumn_[column]];
+         
+         out[x] = first + (samples[secondColumn_[column]] - first) * columnWeight_[column];
+      }
+   }
+   
+   for (int y = range.beginY; y < range.endY; y++)
+   {
+      const float *first = interpolated + (firstRow_[y] - beginRow) * TILE_SIZE;
+      const float *second = interpolated + (secondRow_[y] - beginRow) * TILE_SIZE;
+      const float weight = rowWeight_[y];
+      float *out = &depth_[y * sizeX_ + range.beginX];
+      
+      // Branch free, so that compiler could vectorize it. Most of the moxels are written here
+      for (int x = 0; x < width; x++)
+         out[x] = first[x] + (second[x] - first[x]) * weight;
+   }
+}
+
+void UpsampledDepthEngine::calculateExactTile(int tile)
+{
+   clearDepth(getTileRange(tile), &depth_[0], sizeX_);
+   rasterizeBinnedDepth(projection_, bins_, tile, &depth_[0], sizeX_);
+}
+
+void UpsampledDepthEngine::updateExactTiles()
+{
+   long numExactMoxels = 0;
+   
+   exactTiles_.clear();
+   
+   for (int i = 0; i < tileExact_.size(); i++)
+   {
+      if (tileExact_[i])
+      {
+         TileRange range = getTileRange(i);
+         
+         exactTiles_.push_back(i);
+         numExactMoxels += (range.endX - range.beginX) * (range.endY - range.beginY);
+      }
+   }
+   
+   fullResolutionFraction_ = (double)numExactMoxels / ((double)sizeX_ * sizeY_);
+}
+
+void UpsampledDepthEngine::readValues(float *values) const
+{
+   PRECONDITION(values);
+   
+   if (!depth_.empty())
+      memcpy(values, &depth_[0], depth_.size() * sizeof(float));
+}
+
+ProgressiveRefinementStatistics UpsampledDepthEngine::getProgressiveStatistics() const
+{
+   ProgressiveRefinementStatistics statistics = statistics_;
+   
+   if (statistics.numFrames > 0)
+      statistics.meanFullResolutionFraction /= statistics.numFrames;
+   
+   return statistics;
+}
+
+void UpsampledDepthEngine::resetProgressiveStatistics()
+{
+   statistics_.numFrames = 0;
+   statistics_.numCompleteFrames = 0;
+   statistics_.meanFullResolutionFraction = statistics_.minFullResolutionFraction = 0;
+   
+   frameAccounted_ = accountedComplete_ = false;
+   accountedFraction_ = previousMinFraction_ = 0;
+}
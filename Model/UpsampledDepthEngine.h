@@ -0,0 +1,454 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UPSAMPLED_DEPTH_ENGINE_H_
+#define UPSAMPLED_DEPTH_ENGINE_H_
+
+#include <vector>
+
+#include "SoftwareRasterizer.h"
+
+namespace hdsim {
+   
+   class GPUGeometryModel;
+   
+   /**
+    * Accounting of the progressive calculations of the UpsampledDepthEngine
+    */
+   struct ProgressiveRefinementStatistics {
+      /**
+       * Number of progressively calculated frames. Continued refinement of the frame doesn't count as another frame
+       */
+      long numFrames;
+      
+      /**
+       * Number of frames whose whole board was at the full resolution by the end of their refinement
+       */
+      long numCompleteFrames;
+      
+      /**
+       * Mean and min fraction of the moxels of the frame that were at the full resolution by the end of its refinement
+       */
+      double meanFullResolutionFraction, minFullResolutionFraction;
+   };
+   
+   /**
+    * Calculates the board at 1/factor of its resolution and upsamples it to the full resolution. Smooth surfaces don't need every moxel calculated,
+    * so board is split into tiles, and tiles whose coarse samples are close to each other are interpolated bilinearly. Tiles where two neighbouring
+    * coarse samples differ by more than the discontinuity threshold (edges of the objects, steps) are calculated at the full resolution instead.
+    * Depth is calculated on the CPU, the same way as GPUCalculationEngine does with the null shader.
+    *
+    * Progressive calculation (calculateProgressive()) interpolates every tile first, so that the whole board is available early, and then refines tiles
+    * to the full resolution in the order of their priority until the deadline. Tiles in the region of interest come first, and then tiles with the
+    * largest estimated error.
+    */
+   class UpsampledDepthEngine {
+      
+      friend class CalculateCoarseTilesBody;
+      friend class UpsampleTilesBody;
+      friend class CalculateExactTilesBody;
+      friend class InterpolateAllTilesBody;
+      friend class RefineTilesBody;
+   
+   public:
+      
+      /**
+       * Default ratio of the full and coarse resolution
+       */
+      static const int DEFAULT_FACTOR = 4;
+      
+      /**
+       * Default max depth difference of the neighbouring coarse samples for the region between them to be interpolated
+       */
+      static const double DEFAULT_DISCONTINUITY_THRESHOLD = 0.02;
+      
+      /**
+       * Size of the tile that is either interpolated or calculated at the full resolution, in moxels
+       */
+      static const int TILE_SIZE = 32;
+      
+      /**
+       * Constructor
+       *
+       * @param factor Ratio of the full and coarse resolution. Must be at least 2
+       * @param discontinuityThreshold Max depth difference of the neighbouring coarse samples for the region between them to be interpolated
+       * @param pool Pool used to calculate tiles in parallel, or 0 for the shared pool
+       */
+      UpsampledDepthEngine(int factor = DEFAULT_FACTOR, double discontinuityThreshold = DEFAULT_DISCONTINUITY_THRESHOLD, ThreadPool *pool = 0);
+      
+      /**
+       * Destructor
+       */
+      virtual ~UpsampledDepthEngine();
+      
+      /**
+       * Calculate the board of the model
+       *
+       * @param model Model to calculate
+       */
+      virtual void calculate(const GPUGeometryModel &model);
+      
+      /**
+       * Calculate the board of the model progressively: interpolate all tiles from the coarse board, and then calculate tiles at the full resolution in
+       * the order of their priority until the deadline. Tiles being calculated at the deadline are finished, so calculation could end a tile later
+       *
+       * @param model Model to calculate
+       * @param deadlineInMicroSeconds Time after which no new tile is refined, from getMonotonicTimeInMicroSeconds()
+       * @param regionOfInterest Moxels whose tiles are refined before all others, or 0
+       */
+      virtual void calculateProgressive(const GPUGeometryModel &model, long long deadlineInMicroSeconds, const TileRange *regionOfInterest = 0);
+      
+      /**
+       * Continue refining the board of the last progressive calculation, with the same geometry and priorities. Statistics of that frame are updated,
+       * instead of accounting another frame
+       *
+       * @param deadlineInMicroSeconds Time after which no new tile is refined, from getMonotonicTimeInMicroSeconds()
+       */
+      virtual void continueRefinement(long long deadlineInMicroSeconds);
+      
+      /**
+       * Is every tile of the board calculated at the full resolution
+       *
+       * @return Is refinement complete
+       */
+      virtual bool isRefinementComplete() const
+      {
+         return exactTiles_.size() == tileExact_.size();
+      }
+      
+      /**
+       * Get fraction of the moxels that were calculated at the full resolution in the last calculation
+       *
+       * @return Fraction of the board at the full resolution, in [0, 1]
+       */
+      virtual double getFullResolutionFraction() const
+      {
+         return fullResolutionFraction_;
+      }
+      
+      /**
+       * Get tile at the position in the refinement order of the last progressive calculation
+       *
+       * @param index Position in the refinement order, from 0 to getNumTilesX() * getNumTilesY() - 1
+       *
+       * @return Index of the tile, tileY * getNumTilesX() + tileX
+       */
+      virtual int getTileInRefinementOrder(int index) const
+      {
+         return refinementOrder_[index];
+      }
+      
+      /**
+       * Get estimated interpolation error of the tile in the last progressive calculation. It is the max second difference of the coarse samples
+       * around the tile: interpolation is exact for the linear depth, and steps give second difference as big as the step
+       *
+       * @param tileX Index of the tile in X direction
+       * @param tileY Index of the tile in Y direction
+       *
+       * @return Estimated error
+       */
+      virtual double getEstimatedError(int tileX, int tileY) const
+      {
+         return tileError_[tileY * numTilesX_ + tileX];
+      }
+      
+      /**
+       * Get accounting of the progressive calculations collected since the last reset
+       *
+       * @return Statistics of the progressive calculations
+       */
+      virtual ProgressiveRefinementStatistics getProgressiveStatistics() const;
+      
+      /**
+       * Reset accounting of the progressive calculations
+       */
+      virtual void resetProgressiveStatistics();
+      
+      /**
+       * Get value at the particular location
+       *
+       * @param x X position
+       * @param y Y position
+       *
+       * @return Depth at that position
+       */
+      virtual double getAt(int x, int y) const
+      {
+         return depth_[y * sizeX_ + x];
+      }
+      
+      /**
+       * Read the whole board
+       *
+       * @param values (OUT) Values, stored so that [x][y] corresponds to [y * sizeX + x]
+       */
+      virtual void readValues(float *values) const;
+      
+      /**
+       * The whole board, without copying it
+       *
+       * @return Values, stored so that [x][y] corresponds to [y * sizeX + x]
+       */
+      const float *getValues() const
+      {
+         return depth_.empty() ? 0 : &depth_[0];
+      }
+      
+      /**
+       * Get ratio of the full and coarse resolution
+       *
+       * @return Upsampling factor
+       */
+      virtual int getFactor() const
+      {
+         return factor_;
+      }
+      
+      /**
+       * Get max depth difference of the neighbouring coarse samples for the region between them to be interpolated
+       *
+       * @return Discontinuity threshold
+       */
+      virtual double getDiscontinuityThreshold() const
+      {
+         return discontinuityThreshold_;
+      }
+      
+      /**
+       * Get size of the board in X direction
+       *
+       * @return Size of the board
+       */
+      virtual int getSizeX() const
+      {
+         return sizeX_;
+      }
+      
+      /**
+       * Get size of the board in Y direction
+       *
+       * @return Size of the board
+       */
+      virtual int getSizeY() const
+      {
+         return sizeY_;
+      }
+      
+      /**
+       * Get number of tiles in X direction
+       *
+       * @return Number of tiles
+       */
+      virtual int getNumTilesX() const
+      {
+         return numTilesX_;
+      }
+      
+      /**
+       * Get number of tiles in Y direction
+       *
+       * @return Number of tiles
+       */
+      virtual int getNumTilesY() const
+      {
+         return numTilesY_;
+      }
+      
+      /**
+       * Was tile calculated at the full resolution in the last calculation
+       *
+       * @param tileX Index of the tile in X direction
+       * @param tileY Index of the tile in Y direction
+       *
+       * @return Was tile calculated at the full resolution, as opposed to interpolated
+       */
+      virtual bool isTileExact(int tileX, int tileY) const
+      {
+         return tileExact_[tileY * numTilesX_ + tileX] != 0;
+      }
+      
+      /**
+       * Get number of tiles calculated at the full resolution in the last calculation
+       *
+       * @return Number of exact tiles
+       */
+      virtual int getNumExactTiles() const
+      {
+         return exactTiles_.size();
+      }
+   
+   private:
+      
+      // copying is not supported
+      UpsampledDepthEngine(const UpsampledDepthEngine &rhs);
+      UpsampledDepthEngine &operator=(const UpsampledDepthEngine &rhs);
+      
+      /**
+       * Set sizes and the coarse samples every moxel is interpolated from
+       */
+      void setSize(int sizeX, int sizeY);
+      
+      /**
+       * Get moxels covered by the tile
+       */
+      TileRange getTileRange(int tile) const;
+      
+      /**
+       * Take geometry of the model and calculate the coarse board
+       */
+      void calculateCoarseBoard(const GPUGeometryModel &model);
+      
+      /**
+       * Set the whole board to the empty one (all 1), calculated at the full resolution. Used for models without the rendered area
+       */
+      void calculateEmptyBoard();
+      
+      /**
+       * Calculate coarse samples of the tile of the coarse board
+       */
+      void calculateCoarseTile(int tile);
+      
+      /**
+       * Are there neighbouring coarse samples around the tile that differ by more than the discontinuity threshold
+       */
+      bool hasDiscontinuity(int tile) const;
+      
+      /**
+       * Estimate interpolation error of the tile, see getEstimatedError()
+       */
+      float estimateError(int tile) const;
+      
+      /**
+       * Interpolate the tile from the coarse samples
+       */
+      void interpolateTile(int tile);
+      
+      /**
+       * Interpolate the tile from the coarse samples, unless there is a discontinuity in them
+       *
+       * @return Was tile interpolated
+       */
+      bool upsampleTile(int tile);
+      
+      /**
+       * Calculate the tile at the full resolution
+       */
+      void calculateExactTile(int tile);
+      
+      /**
+       * Collect tiles calculated at the full resolution, and the fraction of the board they cover
+       */
+      void updateExactTiles();
+      
+      /**
+       * Refine tiles of the last progressive calculation in the order of their priority until the deadline
+       */
+      void refine(long long deadlineInMicroSeconds);
+      
+      /**
+       * Account the current fraction at the full resolution in the statistics, as the new frame or as the update of the last accounted one
+       */
+      void accountFrame(bool newFrame);
+      
+      /**
+       * Ratio of the full and coarse resolution
+       */
+      int factor_;
+      
+      /**
+       * Max depth difference of the neighbouring coarse samples for the region between them to be interpolated
+       */
+      double discontinuityThreshold_;
+      
+      /**
+       * Pool used for the calculation
+       */
+      ThreadPool *pool_;
+      
+      /**
+       * Size of the board, of the coarse board, and number of tiles
+       */
+      int sizeX_, sizeY_, coarseSizeX_, coarseSizeY_, numTilesX_, numTilesY_;
+      
+      /**
+       * Geometry of the model
+       */
+      SceneGeometry scene_;
+      
+      /**
+       * View of the full board
+       */
+      OrthographicView view_;
+      
+      /**
+       * Geometry projected to the coarse and to the full board, and its bins
+       */
+      ProjectedGeometry coarseProjection_, projection_;
+      TriangleBins coarseBins_, bins_;
+      
+      /**
+       * Is geometry projected to the full board for the last calculation
+       */
+      bool projected_;
+      
+      /**
+       * Coarse samples, and the full board
+       */
+      std::vector<float> coarse_, depth_;
+      
+      /**
+       * For every column (row) of the board, the two coarse columns (rows) it is interpolated from, and the weight of the second one
+       */
+      std::vector<int> firstColumn_, secondColumn_, firstRow_, secondRow_;
+      std::vector<float> columnWeight_, rowWeight_;
+      
+      /**
+       * Was tile calculated at the full resolution, and all such tiles
+       */
+      std::vector<char> tileExact_;
+      std::vector<int> exactTiles_;
+      
+      /**
+       * Fraction of the moxels calculated at the full resolution
+       */
+      double fullResolutionFraction_;
+      
+      /**
+       * Estimated error of every tile, and tiles in the order in which they are refined, in the last progressive calculation
+       */
+      std::vector<float> tileError_;
+      std::vector<int> refinementOrder_;
+      
+      /**
+       * Accounting of the progressive calculations. Mean is kept as sum until getProgressiveStatistics()
+       */
+      ProgressiveRefinementStatistics statistics_;
+      
+      /**
+       * Is the last progressive calculation accounted in the statistics, fraction at the full resolution and completeness it was accounted with, and 
+       * min fraction of the frames before it
+       */
+      bool frameAccounted_;
+      double accountedFraction_;
+      bool accountedComplete_;
+      double previousMinFraction_;
+   };
+   
+} // namespace
+
+#endif
@@ -0,0 +1,132 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Precalculates whole animation of the model into the animation cache. Usage:
+ *
+ * HoloSimPrecompute modelFile cacheDirectory interframeDistance [--float | --quantized | --delta]
+ *
+ * Cache is written into cacheDirectory under the name derived from the model (see AnimationCache::getCacheFileName()), so HoloSim and HoloSimReplay
+ * could find it there.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <sys/stat.h>
+
+#include "AnimationCache.h"
+#include "GPUInterpolatedModel.h"
+#include "Statistics.h"
+
+using namespace hdsim;
+using namespace std;
+
+/**
+ * Print usage of the tool
+ *
+ * @param name Name of the executable
+ */
+static void printUsage(const char *name)
+{
+   fprintf(stderr, "Usage: %s modelFile cacheDirectory interframeDistance [--float | --quantized | --delta]\n", name);
+}
+
+int main(int argc, char **argv)
+{
+   if (argc < 4  ||  argc > 5)
+   {
+      printUsage(argv[0]);
+      return 1;
+   }
+   
+   string modelFile = argv[1];
+   string cacheDirectory = argv[2];
+   double interframeDistance = atof(argv[3]);
+   AnimationCacheEncoding encoding = ANIMATION_CACHE_QUANTIZED_DELTA;
+   
+   if (argc == 5)
+   {
+      if (!strcmp(argv[4], "--float"))
+      {
+         encoding = ANIMATION_CACHE_FLOAT;
+      }
+      else if (!strcmp(argv[4], "--quantized"))
+      {
+         encoding = ANIMATION_CACHE_QUANTIZED;
+      }
+      else if (!strcmp(argv[4], "--delta"))
+      {
+         encoding = ANIMATION_CACHE_QUANTIZED_DELTA;
+      }
+      else
+      {
+         printUsage(argv[0]);
+         return 1;
+      }
+   }
+   
+   if (interframeDistance <= 0)
+   {
+      fprintf(stderr, "Interframe distance must be positive\n");
+      return 1;
+   }
+   
+   GPUInterpolatedModel model;
+   if (!model.readFromFile(modelFile))
+   {
+      fprintf(stderr, "Can't read model file %s\n", modelFile.c_str());
+      return 1;
+   }
+   
+   string cacheFile = AnimationCache::getCacheFileName(cacheDirectory, model.getAnimationCacheKey());
+   
+   Statistics buildStatistics;
+   buildStatistics.startTimer();
+   
+   bool success = AnimationCache::build(cacheFile, model.getGeometryModel(), interframeDistance, encoding);
+   
+   buildStatistics.stopTimer();
+   
+   if (!success)
+   {
+      fprintf(stderr, "Can't write animation cache %s\n", cacheFile.c_str());
+      return 1;
+   }
+   
+   AnimationCache cache;
+   if (!cache.open(cacheFile))
+   {
+      fprintf(stderr, "Can't open animation cache %s\n", cacheFile.c_str());
+      return 1;
+   }
+   
+   struct stat fileStat;
+   long fileSize = stat(cacheFile.c_str(), &fileStat) ? 0 : (long)fileStat.st_size;
+   
+   long rawSize = (long)cache.getNumFrames() * model.getGeometryModel()->getSizeX() * model.getGeometryModel()->getSizeY() * sizeof(float);
+   
+   printf("Cache: %s\n", cacheFile.c_str());
+   printf("Frames: %d\n", cache.getNumFrames());
+   printf("Size: %ld bytes (%.1lf%% of the float frames)\n", fileSize, rawSize > 0 ? 100.0 * fileSize / rawSize : 0.0);
+   printf("Build time: %lf s\n", buildStatistics.getElapsedTimeInMicroSeconds() / 1000000.0);
+   
+   return 0;
+}
@@ -0,0 +1,108 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Example reader of the shared memory frame bus, written against the C API only. Usage:
+ *
+ * HoloSimBusReader [busName] [numFrames]
+ *
+ * Attaches to the bus published by HoloSim (see the "publishFrameBus" preference), reads frames in place and reports how many frames were read, missed
+ * or torn, and the publication latency.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "SharedFrameBusC.h"
+
+int main(int argc, char **argv)
+{
+   const char *busName = argc > 1 ? argv[1] : "/HoloSimFrames";
+   long numFramesToRead = argc > 2 ? atol(argv[2]) : 1000;
+   
+   HdsimFrameBusReader *reader = hdsimFrameBusOpen(busName);
+   if (!reader)
+   {
+      fprintf(stderr, "Can't attach to frame bus %s\n", busName);
+      return 1;
+   }
+   
+   int sizeX, sizeY;
+   hdsimFrameBusGetSize(reader, &sizeX, &sizeY);
+   printf("Attached to %s, frames are %dx%d\n", busName, sizeX, sizeY);
+   
+   uint64_t lastSequence = hdsimFrameBusGetLatestSequence(reader);
+   long numRead = 0, numMissed = 0, numTorn = 0;
+   int64_t totalLatency = 0, maxLatency = 0;
+   
+   while (numRead < numFramesToRead)
+   {
+      uint64_t sequence;
+      
+      if (!hdsimFrameBusWaitForFrame(reader, lastSequence, 5000000, &sequence))
+      {
+         fprintf(stderr, "No frames for 5 seconds\n");
+         break;
+      }
+      
+      HdsimFrameBusFrame frame;
+      if (!hdsimFrameBusBeginRead(reader, sequence, &frame))
+      {
+         numTorn++;
+         continue;
+      }
+      
+      int64_t latency = hdsimFrameBusGetTimeInMicroSeconds() - frame.publishTimeInMicroSeconds;
+      
+      // Read the frame in place. Real consumer would drive actuators here
+      double sum = 0;
+      for (int i = 0; i < sizeX * sizeY; i++)
+         sum += frame.values[i];
+      
+      if (!hdsimFrameBusEndRead(reader, &frame))
+      {
+         numTorn++;
+         continue;
+      }
+      
+      if (lastSequence != 0  &&  sequence > lastSequence + 1)
+         numMissed += sequence - lastSequence - 1;
+      
+      lastSequence = sequence;
+      numRead++;
+      totalLatency += latency;
+      maxLatency = latency > maxLatency ? latency : maxLatency;
+      
+      if (numRead % 100 == 0)
+         printf("Frame %llu, timeslice %lf, mean depth %lf\n", (unsigned long long)sequence, frame.timeSlice, sizeX * sizeY > 0 ? sum / (sizeX * sizeY) : 0.0);
+   }
+   
+   printf("Frames read: %ld\n", numRead);
+   printf("Frames missed: %ld\n", numMissed);
+   printf("Torn reads retried: %ld\n", numTorn);
+   
+   if (numRead > 0)
+   {
+      printf("Mean latency: %lf us\n", (double)totalLatency / numRead);
+      printf("Max latency: %lld us\n", (long long)maxLatency);
+   }
+   
+   hdsimFrameBusClose(reader);
+   
+   return 0;
+}
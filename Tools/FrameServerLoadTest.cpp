@@ -0,0 +1,227 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Load test of the frame server. Usage:
+ *
+ * HoloSimFrameServerLoadTest [--tcp] [--clients n] [--frames n] [--size x y] [--rate fps] [--tiles] [--block] [--queue n]
+ *
+ * Starts the frame server with a stand-in producer that publishes synthetic frames (a bump moving over a flat board, so that only part of the board
+ * changes between frames), connects the given number of subscribers over the Unix domain (default) or TCP socket and reports throughput, latency and
+ * dropped frames. Rate 0 publishes as fast as possible.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "FrameServer.h"
+#include "PreciseDelay.h"
+
+using namespace hdsim;
+using namespace std;
+
+/**
+ * State of the single subscriber
+ */
+struct LoadTestClient {
+   FrameClient client;
+   uint64_t lastSequence;
+   long numMessages, numMissed;
+   long long numBytes, totalLatency, maxLatency;
+};
+
+static void *clientThread(void *argument)
+{
+   LoadTestClient *state = static_cast<LoadTestClient *>(argument);
+   FrameServerMessageHeader header;
+   
+   while (state->client.readMessage(&header))
+   {
+      long long latency = getMonotonicTimeInMicroSeconds() - header.publishTimeInMicroSeconds;
+      
+      if (state->lastSequence != 0  &&  header.sequence > state->lastSequence + 1)
+         state->numMissed += header.sequence - state->lastSequence - 1;
+      
+      state->lastSequence = header.sequence;
+      state->numMessages++;
+      state->numBytes += sizeof(header) + header.payloadSize;
+      state->totalLatency += latency;
+      if (latency > state->maxLatency)
+         state->maxLatency = latency;
+   }
+   
+   return NULL;
+}
+
+/**
+ * Fill frame with the bump centered at the given position
+ */
+static void fillFrame(Frame *frame, int centerX, int centerY)
+{
+   const int radius = 8;
+   float *values = frame->getMutableValues();
+   int sizeX = frame->getSizeX(), sizeY = frame->getSizeY();
+   
+   for (int y = 0; y < sizeY; y++)
+      for (int x = 0; x < sizeX; x++)
+      {
+         int distance = abs(x - centerX) + abs(y - centerY);
+         values[y * sizeX + x] = distance < radius ? 1.0f - distance / (float)radius : 0.0f;
+      }
+}
+
+int main(int argc, char **argv)
+{
+   bool useTCP = false, tiles = false;
+   int numClients = 4, sizeX = 256, sizeY = 256, queueSize = FrameServer::DEFAULT_QUEUE_SIZE;
+   long numFrames = 1000;
+   double rate = 0;
+   FrameServerOverflowPolicy policy = FRAME_SERVER_DROP_OLDEST;
+   
+   for (int i = 1; i < argc; i++)
+   {
+      if (!strcmp(argv[i], "--tcp"))
+         useTCP = true;
+      else if (!strcmp(argv[i], "--tiles"))
+         tiles = true;
+      else if (!strcmp(argv[i], "--block"))
+         policy = FRAME_SERVER_BLOCK;
+      else if (!strcmp(argv[i], "--clients")  &&  i + 1 < argc)
+         numClients = atoi(argv[++i]);
+      else if (!strcmp(argv[i], "--frames")  &&  i + 1 < argc)
+         numFrames = atol(argv[++i]);
+      else if (!strcmp(argv[i], "--rate")  &&  i + 1 < argc)
+         rate = atof(argv[++i]);
+      else if (!strcmp(argv[i], "--queue")  &&  i + 1 < argc)
+         queueSize = atoi(argv[++i]);
+      else if (!strcmp(argv[i], "--size")  &&  i + 2 < argc)
+      {
+         sizeX = atoi(argv[++i]);
+         sizeY = atoi(argv[++i]);
+      }
+      else
+      {
+         fprintf(stderr, "Usage: %s [--tcp] [--clients n] [--frames n] [--size x y] [--rate fps] [--tiles] [--block] [--queue n]\n", argv[0]);
+         return 1;
+      }
+   }
+   
+   if (numClients < 1  ||  sizeX < 1  ||  sizeY < 1  ||  queueSize < 1)
+   {
+      fprintf(stderr, "Invalid arguments\n");
+      return 1;
+   }
+   
+   char path[64];
+   snprintf(path, sizeof(path), "/tmp/HoloSimLoadTest%d", (int)getpid());
+   
+   FrameServer server(policy, queueSize);
+   if (useTCP ? !server.startTCP(0) : !server.startUnix(path))
+   {
+      fprintf(stderr, "Can't start frame server\n");
+      return 1;
+   }
+   
+   FrameServerSubscription subscription = tiles ? FRAME_SERVER_SUBSCRIBE_DIRTY_TILES : FRAME_SERVER_SUBSCRIBE_FULL_FRAMES;
+   vector<LoadTestClient *> clients;
+   vector<pthread_t> threads(numClients);
+   
+   for (int i = 0; i < numClients; i++)
+   {
+      LoadTestClient *state = new LoadTestClient();
+      state->lastSequence = 0;
+      state->numMessages = state->numMissed = 0;
+      state->numBytes = state->totalLatency = state->maxLatency = 0;
+      
+      if (useTCP ? !state->client.connectTCP(server.getPort(), subscription) : !state->client.connectUnix(path, subscription))
+      {
+         fprintf(stderr, "Can't connect client %d\n", i);
+         return 1;
+      }
+      
+      clients.push_back(state);
+   }
+   
+   while (server.getNumSubscribers() < numClients)
+      usleep(1000);
+   
+   for (int i = 0; i < numClients; i++)
+      pthread_create(&threads[i], NULL, clientThread, clients[i]);
+   
+   printf("Publishing %ld frames of %dx%d to %d %s subscribers over %s socket\n", numFrames, sizeX, sizeY, numClients, tiles ? "dirty tiles" : "full frame",
+          useTCP ? "TCP" : "Unix domain");
+   
+   long long periodInMicroSeconds = rate > 0 ? (long long)(1000000 / rate) : 0;
+   long long startTime = getMonotonicTimeInMicroSeconds();
+   
+   for (long i = 0; i < numFrames; i++)
+   {
+      FrameHandle frame = Frame::create(sizeX, sizeY, i);
+      fillFrame(frame.get(), i % sizeX, sizeY / 2 + (int)(sizeY / 4 * sin(i * 0.05)));
+      
+      if (periodInMicroSeconds)
+         waitUntil(startTime + i * periodInMicroSeconds);
+      
+      server.publish(frame);
+   }
+   
+   long long publishTime = getMonotonicTimeInMicroSeconds() - startTime;
+   
+   // Let subscribers drain their queues, then disconnect them
+   for (int i = 0; i < 1000  &&  server.getNumFramesSent() + server.getNumFramesDropped() < numFrames * numClients; i++)
+      usleep(1000);
+   
+   long long totalTime = getMonotonicTimeInMicroSeconds() - startTime;
+   server.stop();
+   
+   long totalMessages = 0, totalMissed = 0;
+   long long totalBytes = 0, totalLatency = 0, maxLatency = 0;
+   
+   for (int i = 0; i < numClients; i++)
+   {
+      pthread_join(threads[i], NULL);
+      
+      totalMessages += clients[i]->numMessages;
+      totalMissed += clients[i]->numMissed;
+      totalBytes += clients[i]->numBytes;
+      totalLatency += clients[i]->totalLatency;
+      maxLatency = max(maxLatency, clients[i]->maxLatency);
+      
+      delete clients[i];
+   }
+   
+   printf("Producer rate: %lf frames/s\n", numFrames * 1000000.0 / max(publishTime, 1LL));
+   printf("Messages received: %ld (%lf per client per second)\n", totalMessages, totalMessages * 1000000.0 / numClients / max(totalTime, 1LL));
+   printf("Throughput: %lf MB/s\n", totalBytes / (double)max(totalTime, 1LL));
+   printf("Frames dropped: %ld (%ld missed by clients)\n", server.getNumFramesDropped(), totalMissed);
+   
+   if (totalMessages > 0)
+   {
+      printf("Mean latency: %lf us\n", (double)totalLatency / totalMessages);
+      printf("Max latency: %lld us\n", maxLatency);
+   }
+   
+   return 0;
+}
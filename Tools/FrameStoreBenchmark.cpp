@@ -0,0 +1,221 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Throughput of the out-of-core frame store. Usage:
+ *
+ * HoloSimFrameStoreBenchmark storeFile [--size x y] [--tile n] [--cache n] [--triangles n] [--prefetch n] [--keep]
+ *
+ * Calculates the board with random triangles directly into the store file, then reopens the file and reads all tiles twice: streamed in Z-order 
+ * with prefetching (as consumers read the store), and in random order without it. Reports the throughput of every step. To get numbers for the 
+ * installations bigger than RAM, the board must be bigger than RAM too, otherwise reads are served from the OS file cache. Store file is removed 
+ * at the end unless --keep is given.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <unistd.h>
+
+#include "GPUGeometryModel.h"
+#include "OutOfCoreFrameStore.h"
+#include "PreciseDelay.h"
+
+using namespace hdsim;
+using namespace std;
+
+/**
+ * Sums all values, so that reading can't be optimized away
+ */
+class ChecksumTileConsumer : public TileConsumer {
+   
+public:
+   
+   ChecksumTileConsumer() : sum(0)
+   {
+   }
+   
+   virtual void consumeTile(int tileX, int tileY, const TileRange &range, const float *values, int stride)
+   {
+      for (int y = range.beginY; y < range.endY; y++)
+         for (int x = range.beginX; x < range.endX; x++)
+            sum += values[(y - range.beginY) * stride + x - range.beginX];
+   }
+   
+   double sum;
+};
+
+/**
+ * Add random small triangles all over the rendered area
+ */
+static void addRandomTriangles(GPUGeometryModel *model, int numTriangles)
+{
+   srand(1);
+   
+   for (int i = 0; i < numTriangles; i++)
+   {
+      double x = 2.0 * rand() / RAND_MAX - 1, y = 2.0 * rand() / RAND_MAX - 1, z = 2.0 * rand() / RAND_MAX - 1;
+      int first = model->getNumPoints();
+      
+      model->addPoint(createPoint(x, y, z));
+      model->addPoint(createPoint(x + 0.02, y, z + 0.01));
+      model->addPoint(createPoint(x, y + 0.02, z - 0.01));
+      
+      model->addTriangle(createTriangle(first, first + 1, first + 2));
+   }
+}
+
+/**
+ * Print throughput of the step
+ */
+static void printThroughput(const char *step, long long bytes, long long timeInMicroSeconds)
+{
+   printf("%s: %.2lf s, %.1lf MB/s\n", step, timeInMicroSeconds / 1000000.0, bytes / (double)max(timeInMicroSeconds, 1LL));
+}
+
+int main(int argc, char **argv)
+{
+   int sizeX = 20000, sizeY = 20000, tileSize = OutOfCoreFrameStore::DEFAULT_TILE_SIZE, cacheSize = OutOfCoreFrameStore::DEFAULT_CACHE_SIZE;
+   int numTriangles = 100000, prefetchDistance = OutOfCoreFrameStore::DEFAULT_PREFETCH_DISTANCE;
+   bool keep = false;
+   const char *fileName = 0;
+   
+   for (int i = 1; i < argc; i++)
+   {
+      if (!strcmp(argv[i], "--keep"))
+         keep = true;
+      else if (!strcmp(argv[i], "--tile")  &&  i + 1 < argc)
+         tileSize = atoi(argv[++i]);
+      else if (!strcmp(argv[i], "--cache")  &&  i + 1 < argc)
+         cacheSize = atoi(argv[++i]);
+      else if (!strcmp(argv[i], "--triangles")  &&  i + 1 < argc)
+         numTriangles = atoi(argv[++i]);
+      else if (!strcmp(argv[i], "--prefetch")  &&  i + 1 < argc)
+         prefetchDistance = atoi(argv[++i]);
+      else if (!strcmp(argv[i], "--size")  &&  i + 2 < argc)
+      {
+         sizeX = atoi(argv[++i]);
+         sizeY = atoi(argv[++i]);
+      }
+      else if (argv[i][0] != '-'  &&  !fileName)
+         fileName = argv[i];
+      else
+      {
+         fileName = 0;
+         break;
+      }
+   }
+   
+   if (!fileName)
+   {
+      fprintf(stderr, "Usage: %s storeFile [--size x y] [--tile n] [--cache n] [--triangles n] [--prefetch n] [--keep]\n", argv[0]);
+      return 1;
+   }
+   
+   if (sizeX < 1  ||  sizeY < 1  ||  tileSize < 1  ||  cacheSize < 1  ||  numTriangles < 0  ||  prefetchDistance < 0)
+   {
+      fprintf(stderr, "Invalid arguments\n");
+      return 1;
+   }
+   
+   GPUGeometryModel model(sizeX, sizeY);
+   model.setRenderedArea(-1, -1, -1, 1, 1, 1);
+   addRandomTriangles(&model, numTriangles);
+   
+   const long long boardBytes = (long long)sizeX * sizeY * sizeof(float);
+   
+   printf("Board %dx%d (%.1lf MB), %d triangles, tile %d, cache %d tiles (%.1lf MB)\n", sizeX, sizeY, boardBytes / 1048576.0, numTriangles, tileSize,
+          cacheSize, (double)cacheSize * tileSize * tileSize * sizeof(float) / 1048576.0);
+   
+   OutOfCoreFrameStore store(cacheSize);
+   if (!store.create(fileName, sizeX, sizeY, tileSize))
+   {
+      fprintf(stderr, "Can't create store file %s\n", fileName);
+      return 1;
+   }
+   
+   long long startTime = getMonotonicTimeInMicroSeconds();
+   store.calculate(model);
+   long long calculateTime = getMonotonicTimeInMicroSeconds() - startTime;
+   
+   startTime = getMonotonicTimeInMicroSeconds();
+   store.flush();
+   long long flushTime = getMonotonicTimeInMicroSeconds() - startTime;
+   
+   printThroughput("Calculate", boardBytes, calculateTime);
+   printThroughput("Flush", boardBytes, flushTime);
+   printThroughput("Calculate and flush", boardBytes, calculateTime + flushTime);
+   
+   store.close();
+   
+   if (!store.open(fileName))
+   {
+      fprintf(stderr, "Can't open store file %s\n", fileName);
+      return 1;
+   }
+   
+   ChecksumTileConsumer consumer;
+   long numHits = store.getNumHits(), numMisses = store.getNumMisses(), numEvictions = store.getNumEvictions();
+   
+   startTime = getMonotonicTimeInMicroSeconds();
+   store.streamTiles(&consumer, prefetchDistance);
+   printThroughput("Stream in Z-order", boardBytes, getMonotonicTimeInMicroSeconds() - startTime);
+   
+   printf("Cache hits %ld, misses %ld, prefetches %ld, evictions %ld\n", store.getNumHits() - numHits, store.getNumMisses() - numMisses, 
+          store.getNumPrefetches(), store.getNumEvictions() - numEvictions);
+   
+   // Same tiles, in random order and without prefetching. Store is reopened so that nothing is left in the cache
+   store.close();
+   store.open(fileName);
+   
+   numHits = store.getNumHits();
+   numMisses = store.getNumMisses();
+   
+   vector<int> tiles(store.getNumTilesX() * store.getNumTilesY());
+   for (int i = 0; i < tiles.size(); i++)
+      tiles[i] = i;
+   
+   random_shuffle(tiles.begin(), tiles.end());
+   
+   ChecksumTileConsumer randomConsumer;
+   
+   startTime = getMonotonicTimeInMicroSeconds();
+   for (int i = 0; i < tiles.size(); i++)
+   {
+      int tileX = tiles[i] % store.getNumTilesX(), tileY = tiles[i] / store.getNumTilesX();
+      
+      const float *values = store.lockTile(tileX, tileY, false);
+      randomConsumer.consumeTile(tileX, tileY, store.getTileRange(tileX, tileY), values, tileSize);
+      store.unlockTile(tileX, tileY);
+   }
+   
+   printThroughput("Random tile order", boardBytes, getMonotonicTimeInMicroSeconds() - startTime);
+   printf("Cache hits %ld, misses %ld\n", store.getNumHits() - numHits, store.getNumMisses() - numMisses);
+   
+   printf("Checksums %lf, %lf\n", consumer.sum, randomConsumer.sum);
+   
+   store.close();
+   
+   if (!keep)
+      unlink(fileName);
+   
+   return 0;
+}
@@ -0,0 +1,202 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Headless replay of the session recorded by HoloSim. Usage:
+ *
+ * HoloSimReplay sessionFile [--model modelFile] [--realtime] [--csv timingsFile] [--cache cacheDirectory] [--draw]
+ *
+ * Session is replayed against the model, and per-frame calculation timings are reported. If cache directory is given and it contains animation cache
+ * for the model (see HoloSimPrecompute), frames are read from the cache. With --draw, every frame is also drawn by OpenGLDrawingCode into the offscreen
+ * frame buffer, and drawing timings are reported too. Otherwise replay is headless.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <OpenGL/gl.h>
+#include <OpenGL/OpenGL.h>
+
+#include "AnimationCache.h"
+#include "SessionPlayer.h"
+#include "GPUInterpolatedModel.h"
+#include "OGLUtils.h"
+#include "OpenGLDrawingCode.h"
+
+using namespace hdsim;
+using namespace std;
+
+/**
+ * Size of the offscreen frame buffer frames are drawn to
+ */
+static const int DRAWING_WIDTH = 1024;
+static const int DRAWING_HEIGHT = 768;
+
+/**
+ * Print usage of the tool
+ *
+ * @param name Name of the executable
+ */
+static void printUsage(const char *name)
+{
+   fprintf(stderr, "Usage: %s sessionFile [--model modelFile] [--realtime] [--csv timingsFile] [--cache cacheDirectory] [--draw]\n", name);
+}
+
+int main(int argc, char **argv)
+{
+   if (argc < 2)
+   {
+      printUsage(argv[0]);
+      return 1;
+   }
+   
+   string sessionFile = argv[1];
+   string modelFile;
+   string csvFile;
+   string cacheDirectory;
+   bool realTime = false;
+   bool draw = false;
+   
+   for (int i = 2; i < argc; i++)
+   {
+      if (!strcmp(argv[i], "--realtime"))
+      {
+         realTime = true;
+      }
+      else if (!strcmp(argv[i], "--draw"))
+      {
+         draw = true;
+      }
+      else if (!strcmp(argv[i], "--model")  &&  i + 1 < argc)
+      {
+         modelFile = argv[++i];
+      }
+      else if (!strcmp(argv[i], "--csv")  &&  i + 1 < argc)
+      {
+         csvFile = argv[++i];
+      }
+      else if (!strcmp(argv[i], "--cache")  &&  i + 1 < argc)
+      {
+         cacheDirectory = argv[++i];
+      }
+      else
+      {
+         printUsage(argv[0]);
+         return 1;
+      }
+   }
+   
+   SessionPlayer player;
+   if (!player.readFromFile(sessionFile))
+   {
+      fprintf(stderr, "Can't read session file %s\n", sessionFile.c_str());
+      return 1;
+   }
+   
+   if (modelFile.empty())
+      modelFile = player.getModelFileName();
+   
+   GPUInterpolatedModel model;
+   if (!model.readFromFile(modelFile))
+   {
+      fprintf(stderr, "Can't read model file %s\n", modelFile.c_str());
+      return 1;
+   }
+   
+   AnimationCache cache;
+   if (!cacheDirectory.empty())
+   {
+      string cacheFile = AnimationCache::getCacheFileName(cacheDirectory, model.getAnimationCacheKey());
+      
+      if (cache.open(cacheFile))
+         model.setAnimationCache(&cache);
+      else
+         fprintf(stderr, "No animation cache %s, frames would be calculated\n", cacheFile.c_str());
+   }
+   
+   // Drawing goes to the frame buffer of its own offscreen context, which stays current during the replay. Calculation engine switches to its own
+   // context and back
+   OpenGLDrawingCode *drawer = 0;
+   CGLContextObj drawingContext = 0;
+   GLuint frameBufferID = 0, colorBufferID = 0, depthBufferID = 0;
+   
+   if (draw)
+   {
+      if (!initOpenGLOffScreenRender(DRAWING_WIDTH, DRAWING_HEIGHT, &drawingContext, &frameBufferID, &colorBufferID, &depthBufferID))
+      {
+         fprintf(stderr, "Can't create offscreen OpenGL context for drawing\n");
+         return 1;
+      }
+      
+      glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, frameBufferID);
+      
+      drawer = new OpenGLDrawingCode();
+      drawer->setBounds(DRAWING_WIDTH, DRAWING_HEIGHT);
+      drawer->setAspectRatio(DRAWING_WIDTH / (double)DRAWING_HEIGHT);
+   }
+   
+   player.setRealTime(realTime);
+   player.play(&model, drawer);
+   
+   if (drawer)
+   {
+      delete drawer;
+      destroyOpenGLOffScreenRender(drawingContext, frameBufferID, colorBufferID, depthBufferID);
+   }
+   
+   const vector<ReplayedFrameTiming> &timings = player.getFrameTimings();
+   
+   double totalMicroSeconds = 0;
+   double minMicroSeconds = 0;
+   double maxMicroSeconds = 0;
+   double totalDrawingMicroSeconds = 0;
+   long totalMoxels = 0;
+   
+   for (int i = 0; i < timings.size(); i++)
+   {
+      double frameTime = timings[i].calculationTimeInMicroSeconds;
+      
+      totalMicroSeconds += frameTime;
+      totalDrawingMicroSeconds += timings[i].drawingTimeInMicroSeconds;
+      totalMoxels += timings[i].numMoxels;
+      minMicroSeconds = (i == 0  ||  frameTime < minMicroSeconds) ? frameTime : minMicroSeconds;
+      maxMicroSeconds = (i == 0  ||  frameTime > maxMicroSeconds) ? frameTime : maxMicroSeconds;
+   }
+   
+   printf("Frames: %d\n", (int)timings.size());
+   
+   if (!timings.empty())
+   {
+      printf("Mean frame calculation: %lf us\n", totalMicroSeconds/timings.size());
+      printf("Min frame calculation: %lf us\n", minMicroSeconds);
+      printf("Max frame calculation: %lf us\n", maxMicroSeconds);
+      printf("Moxels per second: %lf\n", totalMoxels/(totalMicroSeconds/1000000.0));
+      
+      if (draw)
+         printf("Mean frame drawing: %lf us\n", totalDrawingMicroSeconds/timings.size());
+   }
+   
+   if (!csvFile.empty()  &&  !player.writeFrameTimingsToCSVFile(csvFile.c_str()))
+   {
+      fprintf(stderr, "Can't write timings to %s\n", csvFile.c_str());
+      return 1;
+   }
+   
+   return 0;
+}
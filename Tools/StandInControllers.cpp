@@ -0,0 +1,138 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Local stand-in for the controller boards. Usage:
+ *
+ * HoloSimStandInControllers regionMapFile [--range min max] [--seconds n]
+ *
+ * Starts a stand-in controller for every region of the map (see ControllerPartitioner::readRegionMap()), on the port of its address, and reports 
+ * received, invalid and complete frames and packet latency every second.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "ControllerPartitioner.h"
+#include "PreciseDelay.h"
+
+using namespace hdsim;
+using namespace std;
+
+/**
+ * Transport that is never used, needed only to read the map
+ */
+class NullTransport : public ControllerTransport {
+   
+public:
+   
+   virtual bool send(const ControllerRegion &region, const void *packet, size_t size)
+   {
+      return false;
+   }
+};
+
+int main(int argc, char **argv)
+{
+   if (argc < 2)
+   {
+      fprintf(stderr, "Usage: %s regionMapFile [--range min max] [--seconds n]\n", argv[0]);
+      return 1;
+   }
+   
+   double minValue = 0, maxValue = 1;
+   int seconds = 0;
+   
+   for (int i = 2; i < argc; i++)
+   {
+      if (!strcmp(argv[i], "--range")  &&  i + 2 < argc)
+      {
+         minValue = atof(argv[++i]);
+         maxValue = atof(argv[++i]);
+      }
+      else if (!strcmp(argv[i], "--seconds")  &&  i + 1 < argc)
+      {
+         seconds = atoi(argv[++i]);
+      }
+      else
+      {
+         fprintf(stderr, "Usage: %s regionMapFile [--range min max] [--seconds n]\n", argv[0]);
+         return 1;
+      }
+   }
+   
+   if (maxValue <= minValue)
+   {
+      fprintf(stderr, "Invalid range\n");
+      return 1;
+   }
+   
+   NullTransport transport;
+   ControllerPartitioner map(&transport, minValue, maxValue);
+   
+   if (!map.readRegionMap(argv[1]))
+   {
+      fprintf(stderr, "Can't read region map %s\n", argv[1]);
+      return 1;
+   }
+   
+   vector<StandInController *> controllers;
+   
+   for (int i = 0; i < map.getRegions().size(); i++)
+   {
+      const ControllerRegion &region = map.getRegions()[i];
+      string::size_type colon = region.address.rfind(':');
+      int port = colon == string::npos ? 0 : atoi(region.address.c_str() + colon + 1);
+      
+      StandInController *controller = new StandInController(region, minValue, maxValue);
+      if (!port  ||  !controller->start(port))
+      {
+         fprintf(stderr, "Can't start controller %d on %s\n", region.controllerId, region.address.c_str());
+         return 1;
+      }
+      
+      printf("Controller %d: %dx%d at (%d, %d), %d bits, listening on %s\n", region.controllerId, region.sizeX, region.sizeY, region.x, region.y, 
+             region.bitsPerValue, controller->getAddress().c_str());
+      
+      controllers.push_back(controller);
+   }
+   
+   for (int second = 1; !seconds  ||  second <= seconds; second++)
+   {
+      sleep(1);
+      
+      for (int i = 0; i < controllers.size(); i++)
+      {
+         StandInController *controller = controllers[i];
+         
+         printf("Controller %d: %ld frames, %ld packets, %ld invalid, latency mean %.1lf us, max %lld us\n", map.getRegions()[i].controllerId, 
+                controller->getNumFrames(), controller->getNumPackets(), controller->getNumInvalidPackets(), controller->getMeanLatencyInMicroSeconds(),
+                controller->getMaxLatencyInMicroSeconds());
+      }
+   }
+   
+   for (int i = 0; i < controllers.size(); i++)
+      delete controllers[i];
+   
+   return 0;
+}
@@ -0,0 +1,311 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "ControllerPartitioner.h"
+#include "ControllerPartitionerTest.h"
+
+using namespace hdsim;
+using namespace std;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ControllerPartitionerTest);
+
+ControllerPartitionerTest::ControllerPartitionerTest()
+{
+   
+}
+
+ControllerPartitionerTest::~ControllerPartitionerTest()
+{
+   
+}
+
+void ControllerPartitionerTest::setUp()
+{
+   
+}
+
+void ControllerPartitionerTest::tearDown()
+{
+   
+}
+
+/**
+ * Create region
+ */
+static ControllerRegion makeRegion(int controllerId, int x, int y, int sizeX, int sizeY, int bitsPerValue, const string &address = "")
+{
+   ControllerRegion region;
+   region.controllerId = controllerId;
+   region.x = x;
+   region.y = y;
+   region.sizeX = sizeX;
+   region.sizeY = sizeY;
+   region.bitsPerValue = bitsPerValue;
+   region.address = address;
+   
+   return region;
+}
+
+/**
+ * Create board with values in [0, 1]
+ */
+static vector<float> makeBoard(int sizeX, int sizeY, int frame)
+{
+   vector<float> board(sizeX * sizeY);
+   
+   for (int i = 0; i < board.size(); i++)
+      board[i] = ((i * 7 + frame * 13) % 101) / 100.0f;
+   
+   return board;
+}
+
+/**
+ * Transport that keeps sent packets in memory
+ */
+class RecordingTransport : public ControllerTransport {
+   
+public:
+   
+   RecordingTransport()
+   {
+      pthread_mutex_init(&mutex_, NULL);
+   }
+   
+   virtual ~RecordingTransport()
+   {
+      pthread_mutex_destroy(&mutex_);
+   }
+   
+   virtual bool send(const ControllerRegion &region, const void *packet, size_t size)
+   {
+      const unsigned char *bytes = static_cast<const unsigned char *>(packet);
+      
+      pthread_mutex_lock(&mutex_);
+      packets[region.controllerId].push_back(vector<unsigned char>(bytes, bytes + size));
+      pthread_mutex_unlock(&mutex_);
+      
+      return true;
+   }
+   
+   map<int, vector<vector<unsigned char> > > packets;
+   
+private:
+   
+   pthread_mutex_t mutex_;
+};
+
+void ControllerPartitionerTest::testPackValues()
+{
+   const int numValues = 9;
+   float values[numValues] = {0, 1, 0.5f, 0.25f, 0.123f, 0.999f, -1, 2, 0.75f};
+   
+   for (int bits = 12; bits <= 16; bits += 4)
+   {
+      uint16_t scratch[numValues];
+      unsigned char packed[32];
+      float unpacked[numValues];
+      
+      CPPUNIT_ASSERT_MESSAGE("Wrong packed size", ControllerPartitioner::getPackedSize(numValues, bits) == (bits == 12 ? 14 : 18));
+      
+      ControllerPartitioner::packValues(values, numValues, bits, 0, 1, scratch, packed);
+      ControllerPartitioner::unpackValues(packed, numValues, bits, 0, 1, unpacked);
+      
+      float step = 1.0f / ((1 << bits) - 1);
+      
+      for (int i = 0; i < numValues; i++)
+      {
+         float expected = values[i] < 0 ? 0 : (values[i] > 1 ? 1 : values[i]);
+         CPPUNIT_ASSERT_MESSAGE("Value not preserved", fabs(unpacked[i] - expected) <= step / 2 + 1e-6);
+      }
+   }
+}
+
+void ControllerPartitionerTest::testWireByteOrder()
+{
+   // Codes are 0, 0xFFFF and 0x4000
+   float values[3] = {0, 1, 0.25f};
+   uint16_t scratch[3];
+   unsigned char packed[6];
+   
+   ControllerPartitioner::packValues(values, 3, 16, 0, 1, scratch, packed);
+   CPPUNIT_ASSERT_MESSAGE("16 bit values not big endian", packed[0] == 0  &&  packed[1] == 0  &&  packed[2] == 0xFF  &&  packed[3] == 0xFF  &&
+                          packed[4] == 0x40  &&  packed[5] == 0x00);
+   
+   ControllerPacketHeader header;
+   memset(&header, 0, sizeof(header));
+   header.magic = CONTROLLER_PACKET_MAGIC;
+   header.controllerId = 0x0102;
+   header.sendTimeInMicroSeconds = 0x0102030405060708LL;
+   header.checksum = 0xA1B2C3D4u;
+   
+   unsigned char wire[sizeof(ControllerPacketHeader)];
+   ControllerPartitioner::writeHeader(header, wire);
+   
+   CPPUNIT_ASSERT_MESSAGE("Magic not big endian", memcmp(wire, "HDCP", 4) == 0);
+   CPPUNIT_ASSERT_MESSAGE("Controller id not big endian", wire[4] == 1  &&  wire[5] == 2);
+   CPPUNIT_ASSERT_MESSAGE("Send time not big endian", wire[24] == 1  &&  wire[31] == 8);
+   CPPUNIT_ASSERT_MESSAGE("Checksum not last", wire[36] == 0xA1  &&  wire[39] == 0xD4);
+   
+   ControllerPacketHeader read;
+   ControllerPartitioner::readHeader(wire, &read);
+   
+   CPPUNIT_ASSERT_MESSAGE("Header not preserved", read.magic == header.magic  &&  read.controllerId == header.controllerId  &&
+                          read.sendTimeInMicroSeconds == header.sendTimeInMicroSeconds  &&  read.checksum == header.checksum);
+}
+
+void ControllerPartitionerTest::testPartition()
+{
+   const int sizeX = 40, sizeY = 30;
+   
+   RecordingTransport transport;
+   
+   // Small packets, so that regions are split in many of them
+   ControllerPartitioner partitioner(&transport, 0, 1, sizeof(ControllerPacketHeader) + 48);
+   partitioner.addRegion(makeRegion(1, 0, 0, 25, 30, 12));
+   partitioner.addRegion(makeRegion(2, 25, 0, 15, 10, 16));
+   partitioner.addRegion(makeRegion(3, 25, 10, 15, 20, 12));
+   
+   vector<float> board = makeBoard(sizeX, sizeY, 0);
+   CPPUNIT_ASSERT_MESSAGE("Partition failed", partitioner.partition(&board[0], sizeX, sizeY));
+   
+   vector<int> timesSent(sizeX * sizeY, 0);
+   long numPackets = 0;
+   
+   for (int i = 0; i < partitioner.getRegions().size(); i++)
+   {
+      const ControllerRegion &region = partitioner.getRegions()[i];
+      const vector<vector<unsigned char> > &packets = transport.packets[region.controllerId];
+      
+      for (int j = 0; j < packets.size(); j++)
+      {
+         ControllerPacketHeader header;
+         ControllerPartitioner::readHeader(&packets[j][0], &header);
+         
+         CPPUNIT_ASSERT_MESSAGE("Packet too large", packets[j].size() <= sizeof(ControllerPacketHeader) + 48);
+         CPPUNIT_ASSERT_MESSAGE("Wrong header", header.magic == CONTROLLER_PACKET_MAGIC  &&  header.controllerId == region.controllerId  &&  
+                                header.bitsPerValue == region.bitsPerValue  &&  header.numPackets == packets.size()  &&  header.frameSequence == 1);
+         
+         vector<float> values(header.sizeX * header.sizeY);
+         ControllerPartitioner::unpackValues(&packets[j][sizeof(header)], values.size(), header.bitsPerValue, 0, 1, &values[0]);
+         
+         for (int y = 0; y < header.sizeY; y++)
+            for (int x = 0; x < header.sizeX; x++)
+            {
+               int index = (region.y + header.y + y) * sizeX + region.x + header.x + x;
+               
+               CPPUNIT_ASSERT_MESSAGE("Wrong value", fabs(values[y * header.sizeX + x] - board[index]) < 1.0 / 4095);
+               timesSent[index]++;
+            }
+      }
+      
+      numPackets += packets.size();
+   }
+   
+   for (int i = 0; i < timesSent.size(); i++)
+      CPPUNIT_ASSERT_MESSAGE("Moxel not sent exactly once", timesSent[i] == 1);
+   
+   CPPUNIT_ASSERT_MESSAGE("Wrong statistics", partitioner.getNumPacketsSent() == numPackets  &&  partitioner.getNumSendFailures() == 0);
+}
+
+void ControllerPartitionerTest::testRegionOutsideFrame()
+{
+   RecordingTransport transport;
+   ControllerPartitioner partitioner(&transport);
+   partitioner.addRegion(makeRegion(1, 0, 0, 10, 10, 12));
+   partitioner.addRegion(makeRegion(2, 10, 0, 10, 10, 12));
+   
+   vector<float> board = makeBoard(15, 10, 0);
+   CPPUNIT_ASSERT_MESSAGE("Region outside of frame not reported", !partitioner.partition(&board[0], 15, 10));
+   CPPUNIT_ASSERT_MESSAGE("Region inside of frame not sent", transport.packets[1].size() == 1  &&  transport.packets[2].empty());
+}
+
+void ControllerPartitionerTest::testReadRegionMap()
+{
+   char fileName[] = "/tmp/HoloSimRegionMapXXXXXX";
+   int fd = mkstemp(fileName);
+   CPPUNIT_ASSERT_MESSAGE("Can't create temporary file", fd != -1);
+   
+   const char *map = "# id x y sizeX sizeY bits address\n"
+                     "1 0 0 64 32 12 10.0.0.1:9000\n"
+                     "\n"
+                     "2 64 0 64 32 16 10.0.0.2:9000\n";
+   write(fd, map, strlen(map));
+   close(fd);
+   
+   RecordingTransport transport;
+   ControllerPartitioner partitioner(&transport);
+   bool read = partitioner.readRegionMap(fileName);
+   unlink(fileName);
+   
+   CPPUNIT_ASSERT_MESSAGE("Map not read", read  &&  partitioner.getRegions().size() == 2);
+   
+   const ControllerRegion &region = partitioner.getRegions()[1];
+   CPPUNIT_ASSERT_MESSAGE("Wrong region", region.controllerId == 2  &&  region.x == 64  &&  region.y == 0  &&  region.sizeX == 64  &&  region.sizeY == 32  &&
+                          region.bitsPerValue == 16  &&  region.address == "10.0.0.2:9000");
+   
+   CPPUNIT_ASSERT_MESSAGE("Missing map read", !partitioner.readRegionMap("/tmp/HoloSimNoSuchRegionMap"));
+}
+
+void ControllerPartitionerTest::testStandInControllers()
+{
+   const int sizeX = 64, sizeY = 32, numFrames = 3;
+   
+   StandInController left(makeRegion(1, 0, 0, 32, 32, 12));
+   StandInController right(makeRegion(2, 32, 0, 32, 32, 16));
+   CPPUNIT_ASSERT_MESSAGE("Can't start controllers", left.start()  &&  right.start());
+   
+   UDPControllerTransport transport;
+   ControllerPartitioner partitioner(&transport);
+   partitioner.addRegion(makeRegion(1, 0, 0, 32, 32, 12, left.getAddress()));
+   partitioner.addRegion(makeRegion(2, 32, 0, 32, 32, 16, right.getAddress()));
+   
+   vector<float> board;
+   for (int i = 0; i < numFrames; i++)
+   {
+      board = makeBoard(sizeX, sizeY, i);
+      CPPUNIT_ASSERT_MESSAGE("Partition failed", partitioner.partition(&board[0], sizeX, sizeY));
+      
+      // Wait for every frame, so that loopback never drops packets
+      CPPUNIT_ASSERT_MESSAGE("Frames not received", left.waitForFrames(i + 1, 5000000)  &&  right.waitForFrames(i + 1, 5000000));
+   }
+   
+   CPPUNIT_ASSERT_MESSAGE("Invalid packets", left.getNumInvalidPackets() == 0  &&  right.getNumInvalidPackets() == 0);
+   CPPUNIT_ASSERT_MESSAGE("Packets lost", left.getNumPackets() + right.getNumPackets() == partitioner.getNumPacketsSent());
+   CPPUNIT_ASSERT_MESSAGE("No latency", left.getMaxLatencyInMicroSeconds() >= left.getMeanLatencyInMicroSeconds());
+   
+   vector<float> leftBoard = left.getBoard();
+   vector<float> rightBoard = right.getBoard();
+   
+   for (int y = 0; y < sizeY; y++)
+      for (int x = 0; x < 32; x++)
+      {
+         CPPUNIT_ASSERT_MESSAGE("Wrong left board", fabs(leftBoard[y * 32 + x] - board[y * sizeX + x]) < 1.0 / 4095);
+         CPPUNIT_ASSERT_MESSAGE("Wrong right board", fabs(rightBoard[y * 32 + x] - board[y * sizeX + 32 + x]) < 1.0 / 65535);
+      }
+}
@@ -0,0 +1,97 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONTROLLER_PARTITIONER_TEST_H_
+#define CONTROLLER_PARTITIONER_TEST_H_
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace hdsim {
+   
+   class ControllerPartitionerTest : public CppUnit::TestFixture  {
+      CPPUNIT_TEST_SUITE(ControllerPartitionerTest);
+         CPPUNIT_TEST(testPackValues);
+         CPPUNIT_TEST(testWireByteOrder);
+         CPPUNIT_TEST(testPartition);
+         CPPUNIT_TEST(testRegionOutsideFrame);
+         CPPUNIT_TEST(testReadRegionMap);
+         CPPUNIT_TEST(testStandInControllers);
+      CPPUNIT_TEST_SUITE_END();
+      
+   public:
+      
+      /**
+       * Constructor
+       */
+      ControllerPartitionerTest();
+      
+      /**
+       * Destructor
+       */
+      virtual ~ControllerPartitionerTest();
+      
+      /**
+       * Prepare test for running
+       */
+      void setUp();
+      
+      /**
+       * Cleanup after test
+       */
+      void tearDown();
+      
+      /**
+       * Test round trip of the 12 and 16 bit wire formats
+       */
+      void testPackValues();
+      
+      /**
+       * Test that header and values are big endian on the wire, whatever the byte order of the host
+       */
+      void testWireByteOrder();
+      
+      /**
+       * Test that every controller receives exactly its region, split in packets
+       */
+      void testPartition();
+      
+      /**
+       * Test that region outside of the frame is reported
+       */
+      void testRegionOutsideFrame();
+      
+      /**
+       * Test reading of the region map
+       */
+      void testReadRegionMap();
+      
+      /**
+       * Test sending over UDP to the stand-in controllers
+       */
+      void testStandInControllers();
+      
+   private:
+      // define
+      ControllerPartitionerTest(const ControllerPartitionerTest &rhs);   
+      ControllerPartitionerTest & operator=(const ControllerPartitionerTest &rhs);   
+   };
+   
+}
+
+#endif
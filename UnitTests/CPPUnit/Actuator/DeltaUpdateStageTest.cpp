@@ -0,0 +1,208 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <cmath>
+#include <vector>
+
+#include "DeltaUpdateStage.h"
+#include "Frame.h"
+#include "DeltaUpdateStageTest.h"
+
+using namespace hdsim;
+using namespace std;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(DeltaUpdateStageTest);
+
+DeltaUpdateStageTest::DeltaUpdateStageTest()
+{
+   
+}
+
+DeltaUpdateStageTest::~DeltaUpdateStageTest()
+{
+   
+}
+
+void DeltaUpdateStageTest::setUp()
+{
+   
+}
+
+void DeltaUpdateStageTest::tearDown()
+{
+   
+}
+
+void DeltaUpdateStageTest::testFirstFrameUpdatesAll()
+{
+   vector<float> board(10 * 6, 0.5f);
+   DeltaUpdateStage stage(0.01, 10, 4);
+   
+   CPPUNIT_ASSERT_MESSAGE("First frame must update every actuator", stage.process(&board[0], 10, 6) == 60);
+   CPPUNIT_ASSERT_MESSAGE("Same frame must not update anything", stage.process(&board[0], 10, 6) == 0);
+   
+   // Changed size means different board
+   vector<float> larger(12 * 6, 0.5f);
+   CPPUNIT_ASSERT_MESSAGE("New size must update every actuator", stage.process(&larger[0], 12, 6) == 72);
+   
+   stage.reset();
+   CPPUNIT_ASSERT_MESSAGE("Reset must update every actuator", stage.process(&larger[0], 12, 6) == 72);
+}
+
+void DeltaUpdateStageTest::testSmallChangesSuppressed()
+{
+   vector<float> board(8 * 8, 0.0f);
+   DeltaUpdateStage stage(0.01, 10, 4);
+   stage.process(&board[0], 8, 8);
+   
+   board[3] = 0.005f;
+   board[20] = 0.5f;
+   board[63] = -0.02f;
+   
+   CPPUNIT_ASSERT_MESSAGE("Wrong number of updates", stage.process(&board[0], 8, 8) == 2);
+   
+   const vector<ActuatorUpdate> &updates = stage.getUpdates();
+   CPPUNIT_ASSERT_MESSAGE("Wrong updates", updates[0].index == 20  &&  updates[0].value == 0.5f  &&  updates[1].index == 63  &&  updates[1].value == -0.02f);
+   CPPUNIT_ASSERT_MESSAGE("Suppressed change committed", stage.getCommittedState()[3] == 0.0f);
+   CPPUNIT_ASSERT_MESSAGE("Change not committed", stage.getCommittedState()[20] == 0.5f);
+}
+
+void DeltaUpdateStageTest::testGroupedByTiles()
+{
+   const int sizeX = 10, sizeY = 6;
+   vector<float> board(sizeX * sizeY, 0.0f);
+   DeltaUpdateStage stage(0.01, 10, 4);
+   stage.process(&board[0], sizeX, sizeY);
+   
+   // Change every moxel, so that every tile has the batch
+   for (int i = 0; i < sizeX * sizeY; i++)
+      board[i] = 1;
+   
+   stage.process(&board[0], sizeX, sizeY);
+   
+   const vector<ActuatorUpdate> &updates = stage.getUpdates();
+   const vector<ActuatorUpdateBatch> &batches = stage.getBatches();
+   CPPUNIT_ASSERT_MESSAGE("Wrong number of batches", batches.size() == 6);
+   
+   int numUpdates = 0;
+   for (int i = 0; i < batches.size(); i++)
+   {
+      const ActuatorUpdateBatch &batch = batches[i];
+      CPPUNIT_ASSERT_MESSAGE("Wrong tile", batch.tileX == (i % 3) * 4  &&  batch.tileY == (i / 3) * 4);
+      CPPUNIT_ASSERT_MESSAGE("Batches not consecutive", batch.firstUpdate == numUpdates);
+      
+      for (int j = batch.firstUpdate; j < batch.firstUpdate + batch.numUpdates; j++)
+      {
+         int x = updates[j].index % sizeX, y = updates[j].index / sizeX;
+         
+         CPPUNIT_ASSERT_MESSAGE("Update outside of tile", x >= batch.tileX  &&  x < batch.tileX + 4  &&  y >= batch.tileY  &&  y < batch.tileY + 4);
+         CPPUNIT_ASSERT_MESSAGE("Updates not sorted", j == batch.firstUpdate  ||  updates[j].index > updates[j - 1].index);
+      }
+      
+      numUpdates += batch.numUpdates;
+   }
+   
+   CPPUNIT_ASSERT_MESSAGE("Wrong number of updates", numUpdates == sizeX * sizeY  &&  updates.size() == numUpdates);
+}
+
+void DeltaUpdateStageTest::testDriftFlushed()
+{
+   vector<float> board(4 * 4, 0.0f);
+   DeltaUpdateStage stage(0.01, 5, 4);
+   stage.process(&board[0], 4, 4);
+   
+   // Slow drift, every frame moves less than epsilon
+   int flushedAt = -1;
+   for (int i = 1; i <= 10  &&  flushedAt < 0; i++)
+   {
+      board[5] = 0.001f * i;
+      
+      if (stage.process(&board[0], 4, 4))
+         flushedAt = i;
+   }
+   
+   CPPUNIT_ASSERT_MESSAGE("Drift not flushed in time", flushedAt == 5);
+   CPPUNIT_ASSERT_MESSAGE("Wrong flushed value", stage.getUpdates().size() == 1  &&  stage.getUpdates()[0].index == 5  &&  stage.getUpdates()[0].value == board[5]);
+   CPPUNIT_ASSERT_MESSAGE("Drift update not counted", stage.getNumDriftUpdates() == 1);
+   
+   // Difference that disappears on its own is not sent
+   board[6] = 0.001f;
+   stage.process(&board[0], 4, 4);
+   board[6] = 0.0f;
+   
+   for (int i = 0; i < 10; i++)
+      CPPUNIT_ASSERT_MESSAGE("Transient difference sent", stage.process(&board[0], 4, 4) == 0);
+}
+
+/**
+ * Sink that counts received updates
+ */
+class CountingUpdateSink : public ActuatorUpdateSink {
+   
+public:
+   
+   CountingUpdateSink() : numCalls(0), numUpdates(0)
+   {
+   }
+   
+   virtual void updatesReady(const vector<ActuatorUpdate> &updates, const vector<ActuatorUpdateBatch> &batches, const DeltaUpdateStage &stage)
+   {
+      numCalls++;
+      numUpdates += updates.size();
+   }
+   
+   int numCalls;
+   int numUpdates;
+};
+
+void DeltaUpdateStageTest::testSinkAndStatistics()
+{
+   FrameHandle frame = Frame::create(10, 10, 0);
+   for (int i = 0; i < 100; i++)
+      frame->getMutableValues()[i] = 0;
+   
+   CountingUpdateSink sink;
+   DeltaUpdateStage stage(0.01, 10, 4);
+   stage.addSink(&sink);
+   
+   CPPUNIT_ASSERT_MESSAGE("Frame not processed", stage.processModel(frame.get()) == 100);
+   
+   // Every frame moves 10% of the board
+   for (int i = 1; i <= 4; i++)
+   {
+      for (int j = 0; j < 10; j++)
+         frame->getMutableValues()[j * 10 + i] = i;
+      
+      ScheduledFrameTiming timing;
+      stage.frameReady(frame.get(), timing);
+   }
+   
+   // Unchanged frame doesn't reach the sink
+   stage.processModel(frame.get());
+   
+   CPPUNIT_ASSERT_MESSAGE("Wrong sink calls", sink.numCalls == 5  &&  sink.numUpdates == 140);
+   CPPUNIT_ASSERT_MESSAGE("Wrong number of frames", stage.getNumFrames() == 6  &&  stage.getNumUpdates() == 140);
+   CPPUNIT_ASSERT_MESSAGE("Wrong update ratio", fabs(stage.getUpdateRatio() - 0.4 / 5) < 1e-9);
+   
+   stage.removeSink(&sink);
+   frame->getMutableValues()[0] = 1;
+   stage.processModel(frame.get());
+   CPPUNIT_ASSERT_MESSAGE("Removed sink called", sink.numCalls == 5);
+}
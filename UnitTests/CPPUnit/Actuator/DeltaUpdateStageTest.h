@@ -0,0 +1,91 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DELTA_UPDATE_STAGE_TEST_H_
+#define DELTA_UPDATE_STAGE_TEST_H_
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace hdsim {
+   
+   class DeltaUpdateStageTest : public CppUnit::TestFixture  {
+      CPPUNIT_TEST_SUITE(DeltaUpdateStageTest);
+         CPPUNIT_TEST(testFirstFrameUpdatesAll);
+         CPPUNIT_TEST(testSmallChangesSuppressed);
+         CPPUNIT_TEST(testGroupedByTiles);
+         CPPUNIT_TEST(testDriftFlushed);
+         CPPUNIT_TEST(testSinkAndStatistics);
+      CPPUNIT_TEST_SUITE_END();
+      
+   public:
+      
+      /**
+       * Constructor
+       */
+      DeltaUpdateStageTest();
+      
+      /**
+       * Destructor
+       */
+      virtual ~DeltaUpdateStageTest();
+      
+      /**
+       * Prepare test for running
+       */
+      void setUp();
+      
+      /**
+       * Cleanup after test
+       */
+      void tearDown();
+      
+      /**
+       * Test that the first frame updates every actuator
+       */
+      void testFirstFrameUpdatesAll();
+      
+      /**
+       * Test that only changes larger than epsilon are sent
+       */
+      void testSmallChangesSuppressed();
+      
+      /**
+       * Test that updates are grouped by tiles and sorted within the tile
+       */
+      void testGroupedByTiles();
+      
+      /**
+       * Test that persistent sub-epsilon difference is sent eventually
+       */
+      void testDriftFlushed();
+      
+      /**
+       * Test that sinks receive updates and that update rate is reported
+       */
+      void testSinkAndStatistics();
+      
+   private:
+      // define
+      DeltaUpdateStageTest(const DeltaUpdateStageTest &rhs);   
+      DeltaUpdateStageTest & operator=(const DeltaUpdateStageTest &rhs);   
+   };
+   
+}
+
+#endif
@@ -0,0 +1,195 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <cmath>
+#include <vector>
+
+#include "PowerBudgetScheduler.h"
+#include "PowerBudgetSchedulerTest.h"
+
+using namespace hdsim;
+using namespace std;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(PowerBudgetSchedulerTest);
+
+/**
+ * Board size used by the tests
+ */
+static const int SIZE_X = 8;
+static const int SIZE_Y = 4;
+
+/**
+ * Make update of the rod
+ */
+static ActuatorUpdate makeUpdate(int index, float value)
+{
+   ActuatorUpdate update;
+   update.index = index;
+   update.value = value;
+   
+   return update;
+}
+
+PowerBudgetSchedulerTest::PowerBudgetSchedulerTest()
+{
+   
+}
+
+PowerBudgetSchedulerTest::~PowerBudgetSchedulerTest()
+{
+   
+}
+
+void PowerBudgetSchedulerTest::setUp()
+{
+   
+}
+
+void PowerBudgetSchedulerTest::tearDown()
+{
+   
+}
+
+void PowerBudgetSchedulerTest::testBudgetRespected()
+{
+   PowerBudgetScheduler scheduler(SIZE_X, SIZE_Y, 5);
+   
+   vector<ActuatorUpdate> updates;
+   vector<float> board(SIZE_X * SIZE_Y);
+   
+   for (int i = 0; i < SIZE_X * SIZE_Y; i++)
+   {
+      board[i] = 0.01f * (i + 1);
+      updates.push_back(makeUpdate(i, board[i]));
+   }
+   
+   scheduler.submit(&updates[0], updates.size());
+   CPPUNIT_ASSERT_MESSAGE("Wrong number of pending moves", scheduler.getNumPendingMoves() == SIZE_X * SIZE_Y);
+   
+   vector<ActuatorUpdate> wave;
+   int numMoved = 0;
+   
+   while (scheduler.issueWave(&wave))
+   {
+      CPPUNIT_ASSERT_MESSAGE("Budget exceeded", wave.size() <= 5);
+      numMoved += wave.size();
+   }
+   
+   CPPUNIT_ASSERT_MESSAGE("Not all rods moved", numMoved == SIZE_X * SIZE_Y);
+   CPPUNIT_ASSERT_MESSAGE("Wrong number of waves", scheduler.getNumWaves() == (SIZE_X * SIZE_Y + 4) / 5);
+   CPPUNIT_ASSERT_MESSAGE("Board not realized", scheduler.getPositions() == board);
+}
+
+void PowerBudgetSchedulerTest::testLargestErrorFirst()
+{
+   PowerBudgetScheduler scheduler(SIZE_X, SIZE_Y, 2, MOVE_LARGEST_ERROR_FIRST);
+   
+   vector<ActuatorUpdate> updates;
+   updates.push_back(makeUpdate(0, 0.1f));
+   updates.push_back(makeUpdate(1, -0.9f));
+   updates.push_back(makeUpdate(2, 0.5f));
+   updates.push_back(makeUpdate(3, 0.7f));
+   scheduler.submit(&updates[0], updates.size());
+   
+   vector<ActuatorUpdate> wave;
+   
+   CPPUNIT_ASSERT_MESSAGE("No wave", scheduler.issueWave(&wave));
+   CPPUNIT_ASSERT_MESSAGE("Wrong first wave", wave.size() == 2  &&  wave[0].index == 1  &&  wave[1].index == 3);
+   
+   CPPUNIT_ASSERT_MESSAGE("No wave", scheduler.issueWave(&wave));
+   CPPUNIT_ASSERT_MESSAGE("Wrong second wave", wave.size() == 2  &&  wave[0].index == 2  &&  wave[1].index == 0);
+   
+   CPPUNIT_ASSERT_MESSAGE("Extra wave", !scheduler.issueWave(&wave));
+}
+
+void PowerBudgetSchedulerTest::testOldestFirst()
+{
+   PowerBudgetScheduler scheduler(SIZE_X, SIZE_Y, 2, MOVE_OLDEST_FIRST);
+   
+   ActuatorUpdate first[] = {makeUpdate(4, 0.1f), makeUpdate(5, 0.2f)};
+   ActuatorUpdate second[] = {makeUpdate(6, 0.9f), makeUpdate(7, 0.8f)};
+   scheduler.submit(first, 2);
+   scheduler.submit(second, 2);
+   
+   vector<ActuatorUpdate> wave;
+   
+   CPPUNIT_ASSERT_MESSAGE("No wave", scheduler.issueWave(&wave));
+   CPPUNIT_ASSERT_MESSAGE("Wrong first wave", wave.size() == 2  &&  wave[0].index == 4  &&  wave[1].index == 5);
+   
+   CPPUNIT_ASSERT_MESSAGE("No wave", scheduler.issueWave(&wave));
+   CPPUNIT_ASSERT_MESSAGE("Wrong second wave", wave.size() == 2  &&  wave[0].index == 6  &&  wave[1].index == 7);
+}
+
+void PowerBudgetSchedulerTest::testSupersededMove()
+{
+   PowerBudgetScheduler scheduler(SIZE_X, SIZE_Y, 1, MOVE_OLDEST_FIRST);
+   
+   ActuatorUpdate first[] = {makeUpdate(0, 0.5f), makeUpdate(1, 0.5f)};
+   ActuatorUpdate second[] = {makeUpdate(0, 0.25f)};
+   scheduler.submit(first, 2);
+   scheduler.submit(second, 1);
+   
+   CPPUNIT_ASSERT_MESSAGE("Superseded move still pending", scheduler.getNumPendingMoves() == 2);
+   
+   vector<ActuatorUpdate> wave;
+   
+   // Rod 0 was commanded again, so it lost its place in the queue
+   CPPUNIT_ASSERT_MESSAGE("No wave", scheduler.issueWave(&wave));
+   CPPUNIT_ASSERT_MESSAGE("Wrong first wave", wave.size() == 1  &&  wave[0].index == 1);
+   
+   CPPUNIT_ASSERT_MESSAGE("No wave", scheduler.issueWave(&wave));
+   CPPUNIT_ASSERT_MESSAGE("Wrong second wave", wave.size() == 1  &&  wave[0].index == 0  &&  wave[0].value == 0.25f);
+   
+   CPPUNIT_ASSERT_MESSAGE("Extra wave", !scheduler.issueWave(&wave));
+   CPPUNIT_ASSERT_MESSAGE("Wrong number of converged frames", scheduler.getConvergence().size() == 2);
+   CPPUNIT_ASSERT_MESSAGE("Wrong moves of the second frame", scheduler.getConvergence()[1].numMoves == 1);
+}
+
+void PowerBudgetSchedulerTest::testConvergenceTime()
+{
+   const double maxVelocity = 0.5;
+   const double maxAcceleration = 5.0;
+   
+   PowerBudgetScheduler scheduler(SIZE_X, SIZE_Y, 2, MOVE_LARGEST_ERROR_FIRST, maxVelocity, maxAcceleration);
+   
+   // Frame needs two waves, first one is limited by the longest move
+   ActuatorUpdate first[] = {makeUpdate(0, 0.5f), makeUpdate(1, 0.25f), makeUpdate(2, 0.1f)};
+   scheduler.submit(first, 3);
+   
+   // Frame that moves nothing converges at once
+   scheduler.submit(0, 0);
+   
+   CPPUNIT_ASSERT_MESSAGE("Wrong number of waves", scheduler.runUntil(10) == 2);
+   CPPUNIT_ASSERT_MESSAGE("Time not advanced", scheduler.getTime() == 10);
+   
+   const deque<FrameConvergence> &convergence = scheduler.getConvergence();
+   CPPUNIT_ASSERT_MESSAGE("Wrong number of converged frames", convergence.size() == 2);
+   
+   double expected = RodKinematicsSimulator::getMoveTime(0.5, maxVelocity, maxAcceleration) + 
+                     RodKinematicsSimulator::getMoveTime(0.1, maxVelocity, maxAcceleration);
+   
+   CPPUNIT_ASSERT_MESSAGE("Wrong convergence time", fabs(convergence[0].convergedTime - convergence[0].submitTime - expected) < 1e-6);
+   CPPUNIT_ASSERT_MESSAGE("Wrong moves of the first frame", convergence[0].numMoves == 3);
+   CPPUNIT_ASSERT_MESSAGE("Empty frame not converged at once", convergence[1].convergedTime == convergence[1].submitTime);
+   CPPUNIT_ASSERT_MESSAGE("Wrong max convergence time", fabs(scheduler.getMaxConvergenceTime() - expected) < 1e-6);
+   
+   // Move of 0.5 at 0.5 per second, with 0.1 s to accelerate and 0.1 s to stop
+   CPPUNIT_ASSERT_MESSAGE("Wrong move time", fabs(RodKinematicsSimulator::getMoveTime(0.5, maxVelocity, maxAcceleration) - 1.1) < 1e-9);
+}
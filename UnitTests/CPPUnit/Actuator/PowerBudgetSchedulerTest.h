@@ -0,0 +1,91 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef POWER_BUDGET_SCHEDULER_TEST_H_
+#define POWER_BUDGET_SCHEDULER_TEST_H_
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace hdsim {
+   
+   class PowerBudgetSchedulerTest : public CppUnit::TestFixture  {
+      CPPUNIT_TEST_SUITE(PowerBudgetSchedulerTest);
+         CPPUNIT_TEST(testBudgetRespected);
+         CPPUNIT_TEST(testLargestErrorFirst);
+         CPPUNIT_TEST(testOldestFirst);
+         CPPUNIT_TEST(testSupersededMove);
+         CPPUNIT_TEST(testConvergenceTime);
+      CPPUNIT_TEST_SUITE_END();
+      
+   public:
+      
+      /**
+       * Constructor
+       */
+      PowerBudgetSchedulerTest();
+      
+      /**
+       * Destructor
+       */
+      virtual ~PowerBudgetSchedulerTest();
+      
+      /**
+       * Prepare test for running
+       */
+      void setUp();
+      
+      /**
+       * Cleanup after test
+       */
+      void tearDown();
+      
+      /**
+       * Test that no wave moves more rods than the budget allows
+       */
+      void testBudgetRespected();
+      
+      /**
+       * Test that rods farthest from their targets move first
+       */
+      void testLargestErrorFirst();
+      
+      /**
+       * Test that rods move in the order in which they were commanded
+       */
+      void testOldestFirst();
+      
+      /**
+       * Test that newer command replaces the pending move of the rod
+       */
+      void testSupersededMove();
+      
+      /**
+       * Test that convergence time of the frame matches the waves that realized it
+       */
+      void testConvergenceTime();
+      
+   private:
+      // define
+      PowerBudgetSchedulerTest(const PowerBudgetSchedulerTest &rhs);   
+      PowerBudgetSchedulerTest & operator=(const PowerBudgetSchedulerTest &rhs);   
+   };
+   
+}
+
+#endif
@@ -0,0 +1,271 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "RodKinematicsSimulator.h"
+#include "ThreadPool.h"
+#include "RodKinematicsSimulatorTest.h"
+
+using namespace hdsim;
+using namespace std;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(RodKinematicsSimulatorTest);
+
+/**
+ * Time step used by the tests
+ */
+static const double TIME_STEP = 0.001;
+
+/**
+ * Board size used by the tests. Width is not multiple of four, so both vector and scalar code are used
+ */
+static const int SIZE_X = 7;
+static const int SIZE_Y = 3;
+
+RodKinematicsSimulatorTest::RodKinematicsSimulatorTest()
+{
+   
+}
+
+RodKinematicsSimulatorTest::~RodKinematicsSimulatorTest()
+{
+   
+}
+
+void RodKinematicsSimulatorTest::setUp()
+{
+   
+}
+
+void RodKinematicsSimulatorTest::tearDown()
+{
+   
+}
+
+/**
+ * Step simulator until it settles
+ *
+ * @return Number of steps, or -1 if it didn't settle in maxSteps
+ */
+static long stepUntilSettled(RodKinematicsSimulator *simulator, long maxSteps)
+{
+   for (long i = 1; i <= maxSteps; i++)
+   {
+      simulator->step(TIME_STEP);
+      
+      if (simulator->isSettled())
+         return i;
+   }
+   
+   return -1;
+}
+
+void RodKinematicsSimulatorTest::testReachesTarget()
+{
+   ThreadPool pool(2);
+   RodKinematicsSimulator simulator(SIZE_X, SIZE_Y, 1.0, 10.0, &pool);
+   
+   CPPUNIT_ASSERT_MESSAGE("New simulator must be settled", simulator.isSettled());
+   
+   vector<float> board(SIZE_X * SIZE_Y, 1.0f);
+   simulator.command(&board[0]);
+   CPPUNIT_ASSERT_MESSAGE("Commanded simulator must not be settled", !simulator.isSettled());
+   
+   // Accelerate for 0.1s, move at full speed for 0.9s, and decelerate for 0.1s
+   long numSteps = stepUntilSettled(&simulator, 2000);
+   CPPUNIT_ASSERT_MESSAGE("Settled in wrong time", numSteps * TIME_STEP >= 1.05  &&  numSteps * TIME_STEP <= 1.15);
+   CPPUNIT_ASSERT_MESSAGE("Wrong measured steps", simulator.getStepsToSettle() == numSteps);
+   
+   for (int i = 0; i < SIZE_X * SIZE_Y; i++)
+      CPPUNIT_ASSERT_MESSAGE("Rod not at target", simulator.getActual()[i] == 1.0f  &&  simulator.getVelocities()[i] == 0.0f);
+   
+   CPPUNIT_ASSERT_MESSAGE("Error left", simulator.getMaxError() == 0);
+}
+
+void RodKinematicsSimulatorTest::testLimitsRespected()
+{
+   const double maxVelocity = 0.5, maxAcceleration = 4.0;
+   
+   RodKinematicsSimulator simulator(SIZE_X, SIZE_Y, maxVelocity, maxAcceleration);
+   
+   // Rods move in both directions, far and near
+   vector<float> board(SIZE_X * SIZE_Y);
+   for (int i = 0; i < board.size(); i++)
+      board[i] = (i % 2 ? 1 : -1) * 0.05f * i;
+   
+   simulator.command(&board[0]);
+   
+   vector<float> previousVelocity(board.size(), 0.0f);
+   for (int step = 0; step < 3000  &&  !simulator.isSettled(); step++)
+   {
+      simulator.step(TIME_STEP);
+      
+      for (int i = 0; i < board.size(); i++)
+      {
+         float velocity = simulator.getVelocities()[i];
+         
+         CPPUNIT_ASSERT_MESSAGE("Too fast", fabs(velocity) <= maxVelocity * 1.0001);
+         
+         // Stopping at the target is the only allowed jump
+         if (velocity != 0)
+            CPPUNIT_ASSERT_MESSAGE("Too much acceleration", fabs(velocity - previousVelocity[i]) <= maxAcceleration * TIME_STEP * 1.0001);
+         
+         previousVelocity[i] = velocity;
+      }
+   }
+   
+   CPPUNIT_ASSERT_MESSAGE("Not settled", simulator.isSettled());
+   
+   for (int i = 0; i < board.size(); i++)
+      CPPUNIT_ASSERT_MESSAGE("Rod not at target", simulator.getActual()[i] == board[i]);
+}
+
+void RodKinematicsSimulatorTest::testPerRodLimits()
+{
+   RodKinematicsSimulator simulator(SIZE_X, SIZE_Y, 1.0, 100.0);
+   simulator.setLimits(5, 0.25, 100.0);
+   
+   vector<float> board(SIZE_X * SIZE_Y, 1.0f);
+   simulator.command(&board[0]);
+   
+   for (int i = 0; i < 500; i++)
+      simulator.step(TIME_STEP);
+   
+   CPPUNIT_ASSERT_MESSAGE("Slow rod too fast", simulator.getActual()[5] <= 0.125f);
+   CPPUNIT_ASSERT_MESSAGE("Fast rod too slow", simulator.getActual()[4] >= 0.45f  &&  simulator.getActual()[6] >= 0.45f);
+   CPPUNIT_ASSERT_MESSAGE("Slow rod must be the largest error", fabs(simulator.getMaxError() - (1 - simulator.getActual()[5])) < 1e-6);
+}
+
+void RodKinematicsSimulatorTest::testSettleEstimate()
+{
+   RodKinematicsSimulator simulator(SIZE_X, SIZE_Y, 0.5, 2.0);
+   
+   vector<float> board(SIZE_X * SIZE_Y);
+   for (int i = 0; i < board.size(); i++)
+      board[i] = 0.1f * (i % 5);
+   
+   simulator.command(&board[0]);
+   for (int i = 0; i < 200; i++)
+      simulator.step(TIME_STEP);
+   
+   // Reverse while rods are moving
+   for (int i = 0; i < board.size(); i++)
+      board[i] = -board[i];
+   
+   simulator.command(&board[0]);
+   
+   double estimate = simulator.estimateTimeUntilSettled();
+   long numSteps = stepUntilSettled(&simulator, 10000);
+   
+   CPPUNIT_ASSERT_MESSAGE("Not settled", numSteps > 0);
+   CPPUNIT_ASSERT_MESSAGE("Estimate is not the upper bound", numSteps * TIME_STEP <= estimate + 2 * TIME_STEP);
+   CPPUNIT_ASSERT_MESSAGE("Estimate too pessimistic", numSteps * TIME_STEP >= estimate * 0.5);
+   CPPUNIT_ASSERT_MESSAGE("Settled simulator needs no frames", simulator.estimateFramesUntilSettled(1.0 / 60) == 0);
+}
+
+void RodKinematicsSimulatorTest::testFromDeltaUpdates()
+{
+   DeltaUpdateStage stage(0.01, 10, 4);
+   RodKinematicsSimulator simulator(SIZE_X, SIZE_Y);
+   stage.addSink(&simulator);
+   
+   vector<float> board(SIZE_X * SIZE_Y, 0.0f);
+   stage.process(&board[0], SIZE_X, SIZE_Y);
+   
+   board[3] = 0.25f;
+   board[17] = -0.5f;
+   stage.process(&board[0], SIZE_X, SIZE_Y);
+   
+   CPPUNIT_ASSERT_MESSAGE("Commanded board not updated", simulator.getCommanded() == board);
+   CPPUNIT_ASSERT_MESSAGE("Wrong estimate", simulator.estimateFramesUntilSettled(1.0 / 60) > 1);
+   CPPUNIT_ASSERT_MESSAGE("Not settled", stepUntilSettled(&simulator, 10000) > 0);
+   CPPUNIT_ASSERT_MESSAGE("Actual board differs", simulator.getActual() == board);
+}
+
+void RodKinematicsSimulatorTest::testOvershoot()
+{
+   const double maxVelocity = 1.0, maxAcceleration = 10.0;
+   
+   RodKinematicsSimulator simulator(SIZE_X, SIZE_Y, maxVelocity, maxAcceleration);
+   
+   // Get rods to the full speed, far from the target
+   vector<float> board(SIZE_X * SIZE_Y, 10.0f);
+   simulator.command(&board[0]);
+   
+   for (int step = 0; step < 200; step++)
+      simulator.step(TIME_STEP);
+   
+   CPPUNIT_ASSERT_MESSAGE("Rods not at the full speed", fabs(simulator.getVelocities()[0] - maxVelocity) < 1e-5);
+   
+   // Target just ahead, that could be reached only by stopping in one step
+   const float start = simulator.getActual()[0];
+   const float target = start + 0.001f;
+   
+   fill(board.begin(), board.end(), target);
+   simulator.command(&board[0]);
+   
+   vector<float> previousVelocity = simulator.getVelocities();
+   float maxPosition = start;
+   long numSteps = 0;
+   
+   for (; numSteps < 3000  &&  !simulator.isSettled(); numSteps++)
+   {
+      simulator.step(TIME_STEP);
+      
+      for (int i = 0; i < board.size(); i++)
+      {
+         float velocity = simulator.getVelocities()[i];
+         
+         // Rod stops at the target only from the speed it could lose in one step
+         double maxChange = (velocity != 0 ? 1 : 2) * maxAcceleration * TIME_STEP * 1.0001;
+         CPPUNIT_ASSERT_MESSAGE("Too much acceleration", fabs(velocity - previousVelocity[i]) <= maxChange);
+         
+         previousVelocity[i] = velocity;
+      }
+      
+      maxPosition = max(maxPosition, simulator.getActual()[0]);
+   }
+   
+   // Stopping from the full speed takes v * v / (2 * a)
+   CPPUNIT_ASSERT_MESSAGE("Rods didn't overshoot", maxPosition - target > 0.9 * maxVelocity * maxVelocity / (2 * maxAcceleration));
+   CPPUNIT_ASSERT_MESSAGE("Not settled", simulator.isSettled());
+   
+   for (int i = 0; i < board.size(); i++)
+      CPPUNIT_ASSERT_MESSAGE("Rod not at target", simulator.getActual()[i] == target  &&  simulator.getVelocities()[i] == 0);
+   
+   // With the step longer than v / a rods could stop within the step, so they are put at the target they crossed
+   fill(board.begin(), board.end(), 10.0f);
+   simulator.command(&board[0]);
+   
+   for (int step = 0; step < 200; step++)
+      simulator.step(TIME_STEP);
+   
+   fill(board.begin(), board.end(), simulator.getActual()[0] + 0.001f);
+   simulator.command(&board[0]);
+   simulator.step(2 * maxVelocity / maxAcceleration);
+   
+   CPPUNIT_ASSERT_MESSAGE("Rods not stopped in the long step", simulator.isSettled());
+   
+   for (int i = 0; i < board.size(); i++)
+      CPPUNIT_ASSERT_MESSAGE("Rod not at target after the long step", simulator.getActual()[i] == board[i]  &&  simulator.getVelocities()[i] == 0);
+}
@@ -0,0 +1,97 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ROD_KINEMATICS_SIMULATOR_TEST_H_
+#define ROD_KINEMATICS_SIMULATOR_TEST_H_
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace hdsim {
+   
+   class RodKinematicsSimulatorTest : public CppUnit::TestFixture  {
+      CPPUNIT_TEST_SUITE(RodKinematicsSimulatorTest);
+         CPPUNIT_TEST(testReachesTarget);
+         CPPUNIT_TEST(testLimitsRespected);
+         CPPUNIT_TEST(testPerRodLimits);
+         CPPUNIT_TEST(testSettleEstimate);
+         CPPUNIT_TEST(testFromDeltaUpdates);
+         CPPUNIT_TEST(testOvershoot);
+      CPPUNIT_TEST_SUITE_END();
+      
+   public:
+      
+      /**
+       * Constructor
+       */
+      RodKinematicsSimulatorTest();
+      
+      /**
+       * Destructor
+       */
+      virtual ~RodKinematicsSimulatorTest();
+      
+      /**
+       * Prepare test for running
+       */
+      void setUp();
+      
+      /**
+       * Cleanup after test
+       */
+      void tearDown();
+      
+      /**
+       * Test that rod reaches its target in time predicted by its limits
+       */
+      void testReachesTarget();
+      
+      /**
+       * Test that velocity and acceleration never exceed the limits
+       */
+      void testLimitsRespected();
+      
+      /**
+       * Test that every rod moves with its own limits
+       */
+      void testPerRodLimits();
+      
+      /**
+       * Test that estimated settle time bounds the measured one
+       */
+      void testSettleEstimate();
+      
+      /**
+       * Test that simulator follows updates of the DeltaUpdateStage
+       */
+      void testFromDeltaUpdates();
+      
+      /**
+       * Test that rod too fast to stop at the target overshoots it, and that rod which could stop within the step is put at the target
+       */
+      void testOvershoot();
+      
+   private:
+      // define
+      RodKinematicsSimulatorTest(const RodKinematicsSimulatorTest &rhs);   
+      RodKinematicsSimulatorTest & operator=(const RodKinematicsSimulatorTest &rhs);   
+   };
+   
+}
+
+#endif
@@ -0,0 +1,166 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "FrameScheduler.h"
+#include "FramePrefetcher.h"
+#include "TemporalFrameInterpolator.h"
+#include "GPUInterpolatedModel.h"
+#include "MathHelper.h"
+#include "FrameSchedulerTest.h"
+
+using namespace hdsim;
+using namespace std;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(FrameSchedulerTest);
+
+FrameSchedulerTest::FrameSchedulerTest()
+{
+   
+}
+
+FrameSchedulerTest::~FrameSchedulerTest()
+{
+   
+}
+
+void FrameSchedulerTest::setUp()
+{
+   
+}
+
+void FrameSchedulerTest::tearDown()
+{
+   
+}
+
+/**
+ * Sink that counts received frames
+ */
+class CountingFrameSink : public FrameSink {
+   
+public:
+   
+   CountingFrameSink() : numFrames_(0), lastTimeSlice_(-1)
+   {
+   }
+   
+   virtual void frameReady(const AbstractModel *frame, const ScheduledFrameTiming &timing)
+   {
+      numFrames_++;
+      lastTimeSlice_ = timing.timeSlice;
+   }
+   
+   int numFrames_;
+   double lastTimeSlice_;
+};
+
+void FrameSchedulerTest::testRunFrames()
+{
+   static const long NUM_FRAMES = 5;
+   
+   GPUInterpolatedModel model;
+   CPPUNIT_ASSERT_MESSAGE("Reading from file failed", model.readFromFile("singleQuad.GPUHoloSim"));
+   model.setTimeSlice(GPUInterpolatedModel::MIN_TIME_SLICE);
+   
+   CountingFrameSink sink;
+   
+   FrameScheduler scheduler(&model, 100);
+   scheduler.setInterframeDistance(0.1);
+   scheduler.setLoopAnimation(false);
+   scheduler.addSink(&sink);
+   scheduler.runFrames(NUM_FRAMES);
+   
+   FrameSchedulerStatistics statistics = scheduler.getStatistics();
+   
+   CPPUNIT_ASSERT_MESSAGE("Sink didn't receive all presented frames", sink.numFrames_ == statistics.numFrames);
+   CPPUNIT_ASSERT_MESSAGE("Frame slots not accounted", statistics.numFrames + statistics.numSkippedFrames == NUM_FRAMES);
+   CPPUNIT_ASSERT_MESSAGE("Timeslice not advanced for every slot", areEqual(model.getTimeSlice(), NUM_FRAMES * 0.1));
+   CPPUNIT_ASSERT_MESSAGE("Misses not consistent with slack", statistics.numDeadlineMisses == 0  ||  statistics.minSlackInMicroSeconds < 0);
+}
+
+void FrameSchedulerTest::testThreadStartStop()
+{
+   GPUInterpolatedModel model;
+   CPPUNIT_ASSERT_MESSAGE("Reading from file failed", model.readFromFile("singleQuad.GPUHoloSim"));
+   
+   FrameScheduler scheduler(&model, 100);
+   scheduler.setInterframeDistance(0.01);
+   
+   CPPUNIT_ASSERT_MESSAGE("Scheduler didn't start", scheduler.start());
+   CPPUNIT_ASSERT_MESSAGE("Scheduler not running", scheduler.isRunning());
+   
+   hybridWaitDelay(50000);
+   
+   scheduler.stop();
+   CPPUNIT_ASSERT_MESSAGE("Scheduler still running", !scheduler.isRunning());
+   CPPUNIT_ASSERT_MESSAGE("No frames produced", scheduler.getStatistics().numFrames > 0);
+}
+
+void FrameSchedulerTest::testPrefetchedFrames()
+{
+   static const long NUM_FRAMES = 5;
+   
+   GPUInterpolatedModel model;
+   CPPUNIT_ASSERT_MESSAGE("Reading from file failed", model.readFromFile("singleQuad.GPUHoloSim"));
+   model.setTimeSlice(GPUInterpolatedModel::MIN_TIME_SLICE);
+   
+   FramePrefetcher prefetcher(model, 2);
+   CountingFrameSink sink;
+   
+   FrameScheduler scheduler(&model, 50);
+   scheduler.setInterframeDistance(0.1);
+   scheduler.setLoopAnimation(false);
+   scheduler.setPrefetcher(&prefetcher);
+   scheduler.addSink(&sink);
+   scheduler.runFrames(NUM_FRAMES);
+   
+   FrameSchedulerStatistics statistics = scheduler.getStatistics();
+   
+   CPPUNIT_ASSERT_MESSAGE("Sink didn't receive all presented frames", sink.numFrames_ == statistics.numFrames);
+   CPPUNIT_ASSERT_MESSAGE("Timeslice of the model not kept in sync", areEqual(model.getTimeSlice(), NUM_FRAMES * 0.1));
+   CPPUNIT_ASSERT_MESSAGE("Presented frame not prefetched", statistics.numSkippedFrames > 0  ||  areEqual(sink.lastTimeSlice_, NUM_FRAMES * 0.1));
+}
+
+void FrameSchedulerTest::testInterpolatedFrames()
+{
+   static const long NUM_FRAMES = 8;
+   
+   GPUInterpolatedModel model;
+   CPPUNIT_ASSERT_MESSAGE("Reading from file failed", model.readFromFile("singleQuad.GPUHoloSim"));
+   model.setTimeSlice(GPUInterpolatedModel::MIN_TIME_SLICE);
+   
+   TemporalFrameInterpolator interpolator(model, 4);
+   CountingFrameSink sink;
+   
+   FrameScheduler scheduler(&model, 50);
+   scheduler.setInterframeDistance(0.05);
+   scheduler.setLoopAnimation(false);
+   scheduler.setInterpolator(&interpolator);
+   scheduler.addSink(&sink);
+   scheduler.runFrames(NUM_FRAMES);
+   
+   FrameSchedulerStatistics statistics = scheduler.getStatistics();
+   
+   CPPUNIT_ASSERT_MESSAGE("Sink didn't receive all presented frames", sink.numFrames_ == statistics.numFrames);
+   CPPUNIT_ASSERT_MESSAGE("Timeslice of the model not kept in sync", areEqual(model.getTimeSlice(), NUM_FRAMES * 0.05));
+   CPPUNIT_ASSERT_MESSAGE("Presented frame not interpolated", statistics.numSkippedFrames > 0  ||  areEqual(sink.lastTimeSlice_, NUM_FRAMES * 0.05));
+   CPPUNIT_ASSERT_MESSAGE("Frames not produced by the interpolator", 
+                          interpolator.getNumKeyFrames() + interpolator.getNumInterpolatedFrames() == statistics.numFrames);
+}
@@ -0,0 +1,85 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_SCHEDULER_TEST_H_
+#define FRAME_SCHEDULER_TEST_H_
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace hdsim {
+   
+   class FrameSchedulerTest : public CppUnit::TestFixture  {
+      CPPUNIT_TEST_SUITE(FrameSchedulerTest);
+         CPPUNIT_TEST(testRunFrames);
+         CPPUNIT_TEST(testThreadStartStop);
+         CPPUNIT_TEST(testPrefetchedFrames);
+         CPPUNIT_TEST(testInterpolatedFrames);
+      CPPUNIT_TEST_SUITE_END();
+      
+   public:
+      
+      /**
+       * Constructor
+       */
+      FrameSchedulerTest();
+      
+      /**
+       * Destructor
+       */
+      virtual ~FrameSchedulerTest();
+      
+      /**
+       * Prepare test for running
+       */
+      void setUp();
+      
+      /**
+       * Cleanup after test
+       */
+      void tearDown();
+      
+      /**
+       * Test that frames are produced, handed to sinks and accounted
+       */
+      void testRunFrames();
+      
+      /**
+       * Test that scheduler could be started and stopped on its own thread
+       */
+      void testThreadStartStop();
+      
+      /**
+       * Test that scheduler presents frames calculated by the prefetcher
+       */
+      void testPrefetchedFrames();
+      
+      /**
+       * Test that scheduler presents frames produced by the interpolator, calculating only the key frames
+       */
+      void testInterpolatedFrames();
+      
+   private:
+      // define
+      FrameSchedulerTest(const FrameSchedulerTest &rhs);   
+      FrameSchedulerTest & operator=(const FrameSchedulerTest &rhs);   
+   };
+   
+}
+
+#endif
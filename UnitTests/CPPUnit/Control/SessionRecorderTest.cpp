@@ -0,0 +1,178 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "SessionRecorder.h"
+#include "SessionRecorderTest.h"
+
+using namespace hdsim;
+using namespace std;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SessionRecorderTest);
+
+SessionRecorderTest::SessionRecorderTest()
+{
+   
+}
+
+SessionRecorderTest::~SessionRecorderTest()
+{
+   
+}
+
+void SessionRecorderTest::setUp()
+{
+   
+}
+
+void SessionRecorderTest::tearDown()
+{
+   
+}
+
+/**
+ * Get name of the temporary file used for recording
+ *
+ * @return Name of the temporary file
+ */
+static string getTemporarySessionFileName()
+{
+   char fileName[] = "/tmp/HoloSimSessionTestXXXXXX";
+   int fd = mkstemp(fileName);
+   
+   if (fd != -1)
+      close(fd);
+   
+   return fileName;
+}
+
+void SessionRecorderTest::testRoundTrip()
+{
+   string fileName = getTemporarySessionFileName();
+   
+   SessionRecorder recorder;
+   CPPUNIT_ASSERT_MESSAGE("Can't open session file", recorder.open(fileName, "model.hdsim"));
+   
+   recorder.recordTimeSlice(0.25);
+   recorder.recordRotationAngles(10, 20, 30);
+   recorder.recordOptimizeDrawing(true);
+   recorder.recordMoxelThreshold(4096);
+   recorder.recordRenderedArea(-1, -2, -3, 1, 2, 3);
+   recorder.recordFrame();
+   recorder.close();
+   
+   string modelFileName;
+   vector<SessionEvent> events;
+   CPPUNIT_ASSERT_MESSAGE("Can't read session file", readSessionFile(fileName, &modelFileName, &events));
+   unlink(fileName.c_str());
+   
+   CPPUNIT_ASSERT_MESSAGE("Model file name not preserved", modelFileName == "model.hdsim");
+   CPPUNIT_ASSERT_MESSAGE("Wrong number of events", events.size() == 6);
+   
+   CPPUNIT_ASSERT_MESSAGE("Wrong timeslice event", events[0].type == SESSION_EVENT_TIME_SLICE  &&  events[0].values[0] == 0.25);
+   CPPUNIT_ASSERT_MESSAGE("Wrong rotation event", events[1].type == SESSION_EVENT_ROTATION_ANGLES  &&  events[1].values[2] == 30);
+   CPPUNIT_ASSERT_MESSAGE("Wrong optimize event", events[2].type == SESSION_EVENT_OPTIMIZE_DRAWING  &&  events[2].values[0] == 1);
+   CPPUNIT_ASSERT_MESSAGE("Wrong threshold event", events[3].type == SESSION_EVENT_MOXEL_THRESHOLD  &&  events[3].values[0] == 4096);
+   CPPUNIT_ASSERT_MESSAGE("Wrong area event", events[4].type == SESSION_EVENT_RENDERED_AREA  &&  events[4].values[0] == -1  &&  events[4].values[5] == 3);
+   CPPUNIT_ASSERT_MESSAGE("Wrong frame event", events[5].type == SESSION_EVENT_FRAME);
+   
+   for (size_t i = 1; i < events.size(); i++)
+      CPPUNIT_ASSERT_MESSAGE("Event times are not monotonic", events[i].timeInMicroSeconds >= events[i - 1].timeInMicroSeconds);
+}
+
+void SessionRecorderTest::testUnchangedValuesNotRecorded()
+{
+   string fileName = getTemporarySessionFileName();
+   
+   SessionRecorder recorder;
+   CPPUNIT_ASSERT_MESSAGE("Can't open session file", recorder.open(fileName, "model.hdsim"));
+   
+   // Every frame records all parameters, but only changes should end up in the file. Frames are always recorded
+   for (int i = 0; i < 10; i++)
+   {
+      recorder.recordTimeSlice(i < 5 ? 0 : 0.5);
+      recorder.recordFOV(45);
+      recorder.recordFrame();
+   }
+   
+   recorder.close();
+   CPPUNIT_ASSERT_MESSAGE("Wrong number of recorded events", recorder.getNumRecordedEvents() == 2 + 1 + 10);
+   
+   string modelFileName;
+   vector<SessionEvent> events;
+   CPPUNIT_ASSERT_MESSAGE("Can't read session file", readSessionFile(fileName, &modelFileName, &events));
+   unlink(fileName.c_str());
+   
+   CPPUNIT_ASSERT_MESSAGE("Wrong number of events in file", events.size() == 13);
+}
+
+void SessionRecorderTest::testLittleEndianFormat()
+{
+   string fileName = getTemporarySessionFileName();
+   
+   // Threshold of 4096 recorded 16 us after the start, and timeslice of 0.25 (0x3FD0000000000000) recorded 1 us after it
+   const unsigned char records[] = {SESSION_EVENT_MOXEL_THRESHOLD, 0x10, 0, 0, 0, 0, 0x10, 0, 0,
+                                    SESSION_EVENT_TIME_SLICE, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xD0, 0x3F};
+   
+   FILE *file = fopen(fileName.c_str(), "wb");
+   CPPUNIT_ASSERT_MESSAGE("Can't create session file", file);
+   
+   fprintf(file, "%s\n%d\n%s\n", SESSION_FILE_MAGIC, SESSION_FILE_VERSION, "model.hdsim");
+   fwrite(records, 1, sizeof(records), file);
+   fclose(file);
+   
+   string modelFileName;
+   vector<SessionEvent> events;
+   CPPUNIT_ASSERT_MESSAGE("Can't read session file", readSessionFile(fileName, &modelFileName, &events));
+   
+   CPPUNIT_ASSERT_MESSAGE("Wrong number of events", events.size() == 2);
+   CPPUNIT_ASSERT_MESSAGE("Wrong threshold event", events[0].type == SESSION_EVENT_MOXEL_THRESHOLD  &&  events[0].values[0] == 4096  &&
+                                                   events[0].timeInMicroSeconds == 16);
+   CPPUNIT_ASSERT_MESSAGE("Wrong timeslice event", events[1].type == SESSION_EVENT_TIME_SLICE  &&  events[1].values[0] == 0.25  &&
+                                                   events[1].timeInMicroSeconds == 17);
+   
+   // Recorder writes the same bytes
+   SessionRecorder recorder;
+   CPPUNIT_ASSERT_MESSAGE("Can't open session file", recorder.open(fileName, "model.hdsim"));
+   
+   recorder.recordMoxelThreshold(4096);
+   recorder.recordTimeSlice(0.25);
+   recorder.close();
+   
+   vector<unsigned char> contents(1024);
+   file = fopen(fileName.c_str(), "rb");
+   CPPUNIT_ASSERT_MESSAGE("Can't open recorded file", file);
+   
+   contents.resize(fread(&contents[0], 1, contents.size(), file));
+   fclose(file);
+   unlink(fileName.c_str());
+   
+   CPPUNIT_ASSERT_MESSAGE("Wrong size of the recorded file", contents.size() > sizeof(records));
+   
+   const unsigned char *recorded = &contents[contents.size() - sizeof(records)];
+   
+   // Time deltas depend on when the values were recorded
+   CPPUNIT_ASSERT_MESSAGE("Threshold not little endian", recorded[0] == records[0]  &&  !memcmp(recorded + 5, records + 5, 4));
+   CPPUNIT_ASSERT_MESSAGE("Timeslice not little endian", recorded[9] == records[9]  &&  !memcmp(recorded + 14, records + 14, 8));
+}
@@ -0,0 +1,79 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SESSION_RECORDER_TEST_H_
+#define SESSION_RECORDER_TEST_H_
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace hdsim {
+   
+   class SessionRecorderTest : public CppUnit::TestFixture  {
+      CPPUNIT_TEST_SUITE(SessionRecorderTest);
+         CPPUNIT_TEST(testRoundTrip);
+         CPPUNIT_TEST(testUnchangedValuesNotRecorded);
+         CPPUNIT_TEST(testLittleEndianFormat);
+      CPPUNIT_TEST_SUITE_END();
+      
+   public:
+      
+      /**
+       * Constructor
+       */
+      SessionRecorderTest();
+      
+      /**
+       * Destructor
+       */
+      virtual ~SessionRecorderTest();
+      
+      /**
+       * Prepare test for running
+       */
+      void setUp();
+      
+      /**
+       * Cleanup after test
+       */
+      void tearDown();
+      
+      /**
+       * Test that recorded session could be read back
+       */
+      void testRoundTrip();
+      
+      /**
+       * Test that values that didn't change are not recorded
+       */
+      void testUnchangedValuesNotRecorded();
+      
+      /**
+       * Test that numbers are stored in little endian byte order, whatever the architecture
+       */
+      void testLittleEndianFormat();
+      
+   private:
+      // define
+      SessionRecorderTest(const SessionRecorderTest &rhs);   
+      SessionRecorderTest & operator=(const SessionRecorderTest &rhs);   
+   };
+   
+}
+
+#endif
@@ -0,0 +1,260 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <cstdio>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "FrameServer.h"
+#include "FrameServerTest.h"
+
+using namespace hdsim;
+using namespace std;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(FrameServerTest);
+
+FrameServerTest::FrameServerTest()
+{
+   
+}
+
+FrameServerTest::~FrameServerTest()
+{
+   
+}
+
+void FrameServerTest::setUp()
+{
+   
+}
+
+void FrameServerTest::tearDown()
+{
+   
+}
+
+/**
+ * Get path of the socket used by the test
+ *
+ * @return Path of the socket
+ */
+static string getTestSocketPath()
+{
+   char path[64];
+   snprintf(path, sizeof(path), "/tmp/HoloSimFrameServer%d", (int)getpid());
+   
+   return path;
+}
+
+/**
+ * Create frame whose every cell has the same value
+ */
+static FrameHandle createFrame(int sizeX, int sizeY, float value)
+{
+   FrameHandle frame = Frame::create(sizeX, sizeY, value);
+   
+   for (int i = 0; i < sizeX * sizeY; i++)
+      frame->getMutableValues()[i] = value;
+   
+   return frame;
+}
+
+/**
+ * Wait until server sees the given number of subscribers, and then a bit more so that their subscriptions arrive
+ *
+ * @return Did server see the subscribers in time
+ */
+static bool waitForSubscribers(const FrameServer &server, int numSubscribers)
+{
+   for (int i = 0; i < 1000  &&  server.getNumSubscribers() != numSubscribers; i++)
+      usleep(1000);
+   
+   usleep(50000);
+   return server.getNumSubscribers() == numSubscribers;
+}
+
+void FrameServerTest::testFullFrames()
+{
+   FrameServer server;
+   CPPUNIT_ASSERT_MESSAGE("Can't start server", server.startUnix(getTestSocketPath()));
+   
+   FrameClient client;
+   CPPUNIT_ASSERT_MESSAGE("Can't connect", client.connectUnix(getTestSocketPath(), FRAME_SERVER_SUBSCRIBE_FULL_FRAMES));
+   CPPUNIT_ASSERT_MESSAGE("Subscriber not seen", waitForSubscribers(server, 1));
+   
+   FrameHandle frame = Frame::create(3, 2, 0.5);
+   for (int i = 0; i < 6; i++)
+      frame->getMutableValues()[i] = i;
+   
+   server.publish(frame);
+   
+   FrameServerMessageHeader header;
+   CPPUNIT_ASSERT_MESSAGE("No message", client.readMessage(&header));
+   CPPUNIT_ASSERT_MESSAGE("Wrong header", header.type == FRAME_SERVER_FULL_FRAME  &&  header.sequence == 1  &&  header.sizeX == 3  &&  header.sizeY == 2  &&
+                          header.timeSlice == 0.5);
+   
+   for (int i = 0; i < 6; i++)
+      CPPUNIT_ASSERT_MESSAGE("Wrong value", client.getBoard()[i] == i);
+   
+   server.stop();
+   CPPUNIT_ASSERT_MESSAGE("Socket left behind", access(getTestSocketPath().c_str(), F_OK) != 0);
+}
+
+void FrameServerTest::testDirtyTiles()
+{
+   const int size = 3 * FrameServer::TILE_SIZE;
+   
+   FrameServer server;
+   CPPUNIT_ASSERT_MESSAGE("Can't start server", server.startTCP(0));
+   CPPUNIT_ASSERT_MESSAGE("No port", server.getPort() > 0);
+   
+   FrameClient client;
+   CPPUNIT_ASSERT_MESSAGE("Can't connect", client.connectTCP(server.getPort(), FRAME_SERVER_SUBSCRIBE_DIRTY_TILES));
+   CPPUNIT_ASSERT_MESSAGE("Subscriber not seen", waitForSubscribers(server, 1));
+   
+   FrameHandle first = createFrame(size, size, 1);
+   FrameHandle second = createFrame(size, size, 1);
+   second->getMutableValues()[(FrameServer::TILE_SIZE + 1) * size + 2 * FrameServer::TILE_SIZE] = 7;
+   
+   server.publish(first);
+   server.publish(second);
+   
+   FrameServerMessageHeader header;
+   CPPUNIT_ASSERT_MESSAGE("No first message", client.readMessage(&header));
+   CPPUNIT_ASSERT_MESSAGE("First message must be full frame", header.type == FRAME_SERVER_FULL_FRAME);
+   
+   CPPUNIT_ASSERT_MESSAGE("No second message", client.readMessage(&header));
+   CPPUNIT_ASSERT_MESSAGE("Second message must be single tile", header.type == FRAME_SERVER_DIRTY_TILES  &&  header.numTiles == 1);
+   CPPUNIT_ASSERT_MESSAGE("Tile too large", header.payloadSize == sizeof(FrameServerTileHeader) + FrameServer::TILE_SIZE * FrameServer::TILE_SIZE * sizeof(float));
+   
+   for (int i = 0; i < size * size; i++)
+      CPPUNIT_ASSERT_MESSAGE("Wrong board", client.getBoard()[i] == second->getValues()[i]);
+}
+
+void FrameServerTest::testDropOldest()
+{
+   // Frames large enough to fill the socket buffers
+   const int size = 512;
+   const int numFrames = 32;
+   
+   FrameServer server(FRAME_SERVER_DROP_OLDEST, 2);
+   CPPUNIT_ASSERT_MESSAGE("Can't start server", server.startUnix(getTestSocketPath()));
+   
+   FrameClient client;
+   CPPUNIT_ASSERT_MESSAGE("Can't connect", client.connectUnix(getTestSocketPath(), FRAME_SERVER_SUBSCRIBE_FULL_FRAMES));
+   CPPUNIT_ASSERT_MESSAGE("Subscriber not seen", waitForSubscribers(server, 1));
+   
+   // Client doesn't read, so producer must never block
+   for (int i = 1; i <= numFrames; i++)
+      server.publish(createFrame(size, size, i));
+   
+   CPPUNIT_ASSERT_MESSAGE("No frame dropped", server.getNumFramesDropped() > 0);
+   
+   FrameServerMessageHeader header;
+   uint64_t lastSequence = 0;
+   int numReceived = 0;
+   
+   while (lastSequence != numFrames)
+   {
+      CPPUNIT_ASSERT_MESSAGE("No message", client.readMessage(&header));
+      CPPUNIT_ASSERT_MESSAGE("Out of order", header.sequence > lastSequence);
+      CPPUNIT_ASSERT_MESSAGE("Wrong frame", client.getBoard()[0] == header.sequence);
+      
+      lastSequence = header.sequence;
+      numReceived++;
+   }
+   
+   CPPUNIT_ASSERT_MESSAGE("Dropped frames received", numReceived + server.getNumFramesDropped() == numFrames);
+}
+
+/**
+ * Reads messages until all frames are received
+ */
+struct SlowReader {
+   FrameClient *client;
+   int numFrames;
+   bool inOrder;
+};
+
+static void *slowReaderThread(void *argument)
+{
+   SlowReader *reader = static_cast<SlowReader *>(argument);
+   reader->inOrder = true;
+   
+   FrameServerMessageHeader header;
+   for (int i = 1; i <= reader->numFrames; i++)
+   {
+      if (!reader->client->readMessage(&header)  ||  header.sequence != (uint64_t)i  ||  reader->client->getBoard()[0] != i)
+      {
+         reader->inOrder = false;
+         break;
+      }
+      
+      if (i % 4 == 0)
+         usleep(1000);
+   }
+   
+   return NULL;
+}
+
+void FrameServerTest::testBlock()
+{
+   const int size = 256;
+   
+   FrameServer server(FRAME_SERVER_BLOCK, 2);
+   CPPUNIT_ASSERT_MESSAGE("Can't start server", server.startUnix(getTestSocketPath()));
+   
+   FrameClient client;
+   CPPUNIT_ASSERT_MESSAGE("Can't connect", client.connectUnix(getTestSocketPath(), FRAME_SERVER_SUBSCRIBE_FULL_FRAMES));
+   CPPUNIT_ASSERT_MESSAGE("Subscriber not seen", waitForSubscribers(server, 1));
+   
+   SlowReader reader;
+   reader.client = &client;
+   reader.numFrames = 64;
+   
+   pthread_t thread;
+   pthread_create(&thread, NULL, slowReaderThread, &reader);
+   
+   for (int i = 1; i <= reader.numFrames; i++)
+      server.publish(createFrame(size, size, i));
+   
+   pthread_join(thread, NULL);
+   
+   CPPUNIT_ASSERT_MESSAGE("Frame lost or out of order", reader.inOrder);
+   CPPUNIT_ASSERT_MESSAGE("Frame dropped", server.getNumFramesDropped() == 0);
+}
+
+void FrameServerTest::testDisconnect()
+{
+   FrameServer server(FRAME_SERVER_BLOCK, 1);
+   CPPUNIT_ASSERT_MESSAGE("Can't start server", server.startUnix(getTestSocketPath()));
+   
+   FrameClient client;
+   CPPUNIT_ASSERT_MESSAGE("Can't connect", client.connectUnix(getTestSocketPath(), FRAME_SERVER_SUBSCRIBE_FULL_FRAMES));
+   CPPUNIT_ASSERT_MESSAGE("Subscriber not seen", waitForSubscribers(server, 1));
+   
+   client.close();
+   CPPUNIT_ASSERT_MESSAGE("Subscriber not removed", waitForSubscribers(server, 0));
+   
+   // Nobody to block on
+   for (int i = 0; i < 8; i++)
+      server.publish(createFrame(64, 64, i));
+}
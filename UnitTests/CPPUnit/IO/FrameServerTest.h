@@ -0,0 +1,91 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_SERVER_TEST_H_
+#define FRAME_SERVER_TEST_H_
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace hdsim {
+   
+   class FrameServerTest : public CppUnit::TestFixture  {
+      CPPUNIT_TEST_SUITE(FrameServerTest);
+         CPPUNIT_TEST(testFullFrames);
+         CPPUNIT_TEST(testDirtyTiles);
+         CPPUNIT_TEST(testDropOldest);
+         CPPUNIT_TEST(testBlock);
+         CPPUNIT_TEST(testDisconnect);
+      CPPUNIT_TEST_SUITE_END();
+      
+   public:
+      
+      /**
+       * Constructor
+       */
+      FrameServerTest();
+      
+      /**
+       * Destructor
+       */
+      virtual ~FrameServerTest();
+      
+      /**
+       * Prepare test for running
+       */
+      void setUp();
+      
+      /**
+       * Cleanup after test
+       */
+      void tearDown();
+      
+      /**
+       * Test that subscriber on the Unix domain socket receives full frames
+       */
+      void testFullFrames();
+      
+      /**
+       * Test that subscriber on the TCP socket receives only changed tiles
+       */
+      void testDirtyTiles();
+      
+      /**
+       * Test that slow subscriber loses the oldest frames instead of slowing down the producer
+       */
+      void testDropOldest();
+      
+      /**
+       * Test that blocking policy delivers every frame
+       */
+      void testBlock();
+      
+      /**
+       * Test that disconnected subscriber is removed
+       */
+      void testDisconnect();
+      
+   private:
+      // define
+      FrameServerTest(const FrameServerTest &rhs);   
+      FrameServerTest & operator=(const FrameServerTest &rhs);   
+   };
+   
+}
+
+#endif
@@ -0,0 +1,208 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <cstdio>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "PreciseDelay.h"
+#include "SharedFrameBus.h"
+#include "SharedFrameBusTest.h"
+
+using namespace hdsim;
+using namespace std;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SharedFrameBusTest);
+
+SharedFrameBusTest::SharedFrameBusTest()
+{
+   
+}
+
+SharedFrameBusTest::~SharedFrameBusTest()
+{
+   
+}
+
+void SharedFrameBusTest::setUp()
+{
+   
+}
+
+void SharedFrameBusTest::tearDown()
+{
+   
+}
+
+/**
+ * Get name of the bus used by the test. Names are short, as OS X limits names of the shared memory to 31 characters
+ *
+ * @return Name of the bus
+ */
+static string getTestBusName()
+{
+   char name[32];
+   snprintf(name, sizeof(name), "/HDSimTest%d", (int)getpid());
+   
+   return name;
+}
+
+void SharedFrameBusTest::testPublishAndRead()
+{
+   SharedFrameBus bus;
+   CPPUNIT_ASSERT_MESSAGE("Can't create bus", bus.create(getTestBusName(), 3, 2));
+   
+   HdsimFrameBusReader *reader = hdsimFrameBusOpen(getTestBusName().c_str());
+   CPPUNIT_ASSERT_MESSAGE("Can't attach to bus", reader);
+   
+   int sizeX, sizeY;
+   hdsimFrameBusGetSize(reader, &sizeX, &sizeY);
+   CPPUNIT_ASSERT_MESSAGE("Wrong size", sizeX == 3  &&  sizeY == 2);
+   CPPUNIT_ASSERT_MESSAGE("Frame available before publishing", hdsimFrameBusGetLatestSequence(reader) == 0);
+   
+   for (int i = 1; i <= 10; i++)
+   {
+      float values[6];
+      for (int j = 0; j < 6; j++)
+         values[j] = i * 10 + j;
+      
+      bus.publishFrame(values, i * 0.1);
+      
+      uint64_t sequence = hdsimFrameBusGetLatestSequence(reader);
+      CPPUNIT_ASSERT_MESSAGE("Wrong sequence", sequence == i);
+      
+      HdsimFrameBusFrame frame;
+      CPPUNIT_ASSERT_MESSAGE("Can't read frame", hdsimFrameBusBeginRead(reader, sequence, &frame));
+      CPPUNIT_ASSERT_MESSAGE("Wrong timeslice", frame.timeSlice == i * 0.1);
+      
+      for (int j = 0; j < 6; j++)
+         CPPUNIT_ASSERT_MESSAGE("Wrong value", frame.values[j] == values[j]);
+      
+      CPPUNIT_ASSERT_MESSAGE("Consistent read reported as torn", hdsimFrameBusEndRead(reader, &frame));
+   }
+   
+   float copy[6];
+   HdsimFrameBusFrame frame;
+   CPPUNIT_ASSERT_MESSAGE("Can't copy latest frame", hdsimFrameBusReadLatest(reader, copy, &frame, 1000));
+   CPPUNIT_ASSERT_MESSAGE("Wrong latest frame", frame.sequence == 10  &&  copy[5] == 105);
+   
+   hdsimFrameBusClose(reader);
+}
+
+void SharedFrameBusTest::testOverwrittenFrameDetected()
+{
+   SharedFrameBus bus;
+   CPPUNIT_ASSERT_MESSAGE("Can't create bus", bus.create(getTestBusName(), 4, 4, 2));
+   
+   SharedFrameBusReader reader;
+   CPPUNIT_ASSERT_MESSAGE("Can't attach to bus", reader.open(getTestBusName()));
+   
+   float values[16] = {0};
+   bus.publishFrame(values, 0);
+   
+   HdsimFrameBusFrame frame;
+   CPPUNIT_ASSERT_MESSAGE("Can't read frame", reader.beginRead(1, &frame));
+   
+   // With two slots, third frame reuses the slot we are reading
+   bus.publishFrame(values, 0.1);
+   bus.publishFrame(values, 0.2);
+   
+   CPPUNIT_ASSERT_MESSAGE("Overwritten frame not detected", !reader.endRead(&frame));
+   CPPUNIT_ASSERT_MESSAGE("Overwritten frame could be read", !reader.beginRead(1, &frame));
+   
+   // Frame being written can't be read
+   bus.beginFrame(0.3);
+   CPPUNIT_ASSERT_MESSAGE("Frame being written could be read", !reader.beginRead(4, &frame));
+   bus.commitFrame();
+   CPPUNIT_ASSERT_MESSAGE("Committed frame can't be read", reader.beginRead(4, &frame)  &&  reader.endRead(&frame));
+}
+
+void SharedFrameBusTest::testWaitForFrame()
+{
+   SharedFrameBus bus;
+   CPPUNIT_ASSERT_MESSAGE("Can't create bus", bus.create(getTestBusName(), 1, 1));
+   
+   SharedFrameBusReader reader;
+   CPPUNIT_ASSERT_MESSAGE("Can't attach to bus", reader.open(getTestBusName()));
+   
+   uint64_t sequence;
+   CPPUNIT_ASSERT_MESSAGE("Frame found on empty bus", !reader.waitForFrame(0, 1000, &sequence));
+   
+   float value = 1;
+   bus.publishFrame(&value, 0);
+   
+   CPPUNIT_ASSERT_MESSAGE("Published frame not found", reader.waitForFrame(0, 1000, &sequence)  &&  sequence == 1);
+   CPPUNIT_ASSERT_MESSAGE("Already seen frame returned", !reader.waitForFrame(1, 1000, &sequence));
+}
+
+void SharedFrameBusTest::testCrashedProducer()
+{
+   SharedFrameBus bus;
+   CPPUNIT_ASSERT_MESSAGE("Can't create bus", bus.create(getTestBusName(), 2, 2, 2));
+   
+   float values[4] = {1, 2, 3, 4};
+   bus.publishFrame(values, 0);
+   
+   // Lock the slot of the latest frame the way producer does it while writing, and never unlock it
+   int fd = shm_open(getTestBusName().c_str(), O_RDWR, 0);
+   CPPUNIT_ASSERT_MESSAGE("Can't open shared memory", fd >= 0);
+   
+   HdsimFrameBusHeader header;
+   CPPUNIT_ASSERT_MESSAGE("Can't read header", pread(fd, &header, sizeof(header), 0) == sizeof(header));
+   
+   size_t size = header.firstSlotOffset + header.numSlots * header.slotStride;
+   char *data = static_cast<char *>(mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+   close(fd);
+   CPPUNIT_ASSERT_MESSAGE("Can't map shared memory", data != MAP_FAILED);
+   
+   HdsimFrameBusSlot *slot = reinterpret_cast<HdsimFrameBusSlot *>(data + header.firstSlotOffset);
+   slot->seqlock++;
+   
+   SharedFrameBusReader reader;
+   CPPUNIT_ASSERT_MESSAGE("Can't attach to bus", reader.open(getTestBusName()));
+   
+   float copy[4];
+   HdsimFrameBusFrame frame;
+   long long start = getMonotonicTimeInMicroSeconds();
+   
+   CPPUNIT_ASSERT_MESSAGE("Frame copied from the locked slot", !reader.readLatest(copy, &frame, 1000));
+   CPPUNIT_ASSERT_MESSAGE("Timeout not respected", getMonotonicTimeInMicroSeconds() - start < 500000);
+   
+   slot->seqlock++;
+   CPPUNIT_ASSERT_MESSAGE("Can't copy unlocked frame", reader.readLatest(copy, &frame, 1000)  &&  copy[3] == 4);
+   
+   munmap(data, size);
+}
+
+void SharedFrameBusTest::testMissingBus()
+{
+   CPPUNIT_ASSERT_MESSAGE("Attached to missing bus", !hdsimFrameBusOpen("/HDSimNoSuchBus"));
+   
+   // Once producer is gone, new readers can't attach
+   {
+      SharedFrameBus bus;
+      CPPUNIT_ASSERT_MESSAGE("Can't create bus", bus.create(getTestBusName(), 1, 1));
+   }
+   
+   SharedFrameBusReader reader;
+   CPPUNIT_ASSERT_MESSAGE("Attached to removed bus", !reader.open(getTestBusName()));
+}
@@ -0,0 +1,91 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SHARED_FRAME_BUS_TEST_H_
+#define SHARED_FRAME_BUS_TEST_H_
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace hdsim {
+   
+   class SharedFrameBusTest : public CppUnit::TestFixture  {
+      CPPUNIT_TEST_SUITE(SharedFrameBusTest);
+         CPPUNIT_TEST(testPublishAndRead);
+         CPPUNIT_TEST(testOverwrittenFrameDetected);
+         CPPUNIT_TEST(testWaitForFrame);
+         CPPUNIT_TEST(testCrashedProducer);
+         CPPUNIT_TEST(testMissingBus);
+      CPPUNIT_TEST_SUITE_END();
+      
+   public:
+      
+      /**
+       * Constructor
+       */
+      SharedFrameBusTest();
+      
+      /**
+       * Destructor
+       */
+      virtual ~SharedFrameBusTest();
+      
+      /**
+       * Prepare test for running
+       */
+      void setUp();
+      
+      /**
+       * Cleanup after test
+       */
+      void tearDown();
+      
+      /**
+       * Test that published frames are read in place through the C API
+       */
+      void testPublishAndRead();
+      
+      /**
+       * Test that reader detects frame overwritten while it was reading it
+       */
+      void testOverwrittenFrameDetected();
+      
+      /**
+       * Test waiting for the new frame
+       */
+      void testWaitForFrame();
+      
+      /**
+       * Test that copying the latest frame gives up on the slot left locked by the crashed producer
+       */
+      void testCrashedProducer();
+      
+      /**
+       * Test that attaching to the missing bus fails
+       */
+      void testMissingBus();
+      
+   private:
+      // define
+      SharedFrameBusTest(const SharedFrameBusTest &rhs);   
+      SharedFrameBusTest & operator=(const SharedFrameBusTest &rhs);   
+   };
+   
+}
+
+#endif
@@ -0,0 +1,198 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include <unistd.h>
+
+#include "AnimationCache.h"
+#include "GPUInterpolatedModel.h"
+#include "MathHelper.h"
+#include "AnimationCacheTest.h"
+
+using namespace hdsim;
+using namespace std;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(AnimationCacheTest);
+
+AnimationCacheTest::AnimationCacheTest()
+{
+   
+}
+
+AnimationCacheTest::~AnimationCacheTest()
+{
+   
+}
+
+void AnimationCacheTest::setUp()
+{
+   
+}
+
+void AnimationCacheTest::tearDown()
+{
+   
+}
+
+/**
+ * Get name of the temporary file for the cache
+ *
+ * @return Name of the temporary file
+ */
+static string getTemporaryCacheFileName()
+{
+   char fileName[] = "/tmp/HoloSimAnimationCacheTestXXXXXX";
+   int fd = mkstemp(fileName);
+   
+   if (fd != -1)
+      close(fd);
+   
+   return fileName;
+}
+
+void AnimationCacheTest::testRoundTrip()
+{
+   AnimationCacheEncoding encodings[] = {ANIMATION_CACHE_FLOAT, ANIMATION_CACHE_QUANTIZED, ANIMATION_CACHE_QUANTIZED_DELTA};
+   
+   for (int e = 0; e < 3; e++)
+   {
+      GPUInterpolatedModel model;
+      CPPUNIT_ASSERT_MESSAGE("Reading from file failed", model.readFromFile("singleQuad.GPUHoloSim"));
+      
+      GPUGeometryModel *geometryModel = model.getGeometryModel();
+      string fileName = getTemporaryCacheFileName();
+      
+      CPPUNIT_ASSERT_MESSAGE("Can't build cache", AnimationCache::build(fileName, geometryModel, 0.1, encodings[e]));
+      
+      AnimationCache cache;
+      bool opened = cache.open(fileName);
+      unlink(fileName.c_str());
+      
+      CPPUNIT_ASSERT_MESSAGE("Can't open cache", opened);
+      CPPUNIT_ASSERT_MESSAGE("Wrong encoding", cache.getEncoding() == encodings[e]);
+      CPPUNIT_ASSERT_MESSAGE("Wrong key", cache.getKey() == geometryModel->getAnimationCacheKey());
+      CPPUNIT_ASSERT_MESSAGE("Wrong number of frames", cache.getNumFrames() == 11);
+      
+      double tolerance = encodings[e] == ANIMATION_CACHE_FLOAT ? 0 : 1.0 / 65535;
+      
+      // Read frames out of order too, so that delta decoding has to restart from the key frame
+      int order[] = {0, 1, 2, 10, 5, 6, 3};
+      
+      for (int i = 0; i < sizeof(order) / sizeof(order[0]); i++)
+      {
+         int index = order[i];
+         
+         geometryModel->setTimeSlice(cache.getTimeSlice(index));
+         geometryModel->forceModelCalculation();
+         
+         FrameHandle frame = cache.getFrame(index);
+         
+         for (int y = 0; y < geometryModel->getSizeY(); y++)
+            for (int x = 0; x < geometryModel->getSizeX(); x++)
+            {
+               double expected = geometryModel->getAt(x, y);
+               
+               CPPUNIT_ASSERT_MESSAGE("Frame differs from the calculated one", fabs(frame->getAt(x, y) - expected) <= tolerance);
+               CPPUNIT_ASSERT_MESSAGE("Value differs from the calculated one", fabs(cache.getAt(index, x, y) - expected) <= tolerance);
+            }
+      }
+   }
+}
+
+void AnimationCacheTest::testFindFrame()
+{
+   GPUInterpolatedModel model;
+   CPPUNIT_ASSERT_MESSAGE("Reading from file failed", model.readFromFile("singleQuad.GPUHoloSim"));
+   
+   string fileName = getTemporaryCacheFileName();
+   CPPUNIT_ASSERT_MESSAGE("Can't build cache", AnimationCache::build(fileName, model.getGeometryModel(), 0.3, ANIMATION_CACHE_QUANTIZED));
+   
+   AnimationCache cache;
+   bool opened = cache.open(fileName);
+   unlink(fileName.c_str());
+   
+   CPPUNIT_ASSERT_MESSAGE("Can't open cache", opened);
+   
+   // 0, 0.3, 0.6, 0.9 and the end of the animation
+   CPPUNIT_ASSERT_MESSAGE("Wrong number of frames", cache.getNumFrames() == 5);
+   CPPUNIT_ASSERT_MESSAGE("End of animation not cached", areEqual(cache.getTimeSlice(4), GPUInterpolatedModel::MAX_TIME_SLICE));
+   
+   CPPUNIT_ASSERT_MESSAGE("Exact timeslice not found", cache.findFrame(0.6) == 2);
+   CPPUNIT_ASSERT_MESSAGE("Found timeslice that is not cached", cache.findFrame(0.5) == -1);
+   
+   cache.setMaxTimeSliceError(0.15);
+   CPPUNIT_ASSERT_MESSAGE("Closest timeslice not found", cache.findFrame(0.5) == 2);
+   CPPUNIT_ASSERT_MESSAGE("Closest timeslice not found at the end", cache.findFrame(0.98) == 4);
+}
+
+void AnimationCacheTest::testModelUsesCache()
+{
+   GPUInterpolatedModel model;
+   CPPUNIT_ASSERT_MESSAGE("Reading from file failed", model.readFromFile("singleQuad.GPUHoloSim"));
+   
+   GPUGeometryModel *geometryModel = model.getGeometryModel();
+   string fileName = getTemporaryCacheFileName();
+   CPPUNIT_ASSERT_MESSAGE("Can't build cache", AnimationCache::build(fileName, geometryModel, 0.5, ANIMATION_CACHE_FLOAT));
+   
+   AnimationCache cache;
+   bool opened = cache.open(fileName);
+   unlink(fileName.c_str());
+   
+   CPPUNIT_ASSERT_MESSAGE("Can't open cache", opened);
+   
+   geometryModel->setTimeSlice(0.5);
+   geometryModel->forceModelCalculation();
+   double calculated = geometryModel->getAt(0, 0);
+   
+   geometryModel->setAnimationCache(&cache);
+   geometryModel->setTimeSlice(0.5);
+   CPPUNIT_ASSERT_MESSAGE("Cached value differs from the calculated one", geometryModel->getAt(0, 0) == calculated);
+   
+   // Changing the model must make the cache stale
+   AnimationCacheKey key = geometryModel->getAnimationCacheKey();
+   geometryModel->setRenderedArea(key.renderedArea[0] - 1, key.renderedArea[1], key.renderedArea[2], key.renderedArea[3], key.renderedArea[4], key.renderedArea[5]);
+   CPPUNIT_ASSERT_MESSAGE("Key didn't change with the model", geometryModel->getAnimationCacheKey() != cache.getKey());
+   
+   Point point = geometryModel->getPoint(0);
+   unsigned long long geometryFingerprint = geometryModel->getGeometryFingerprint();
+   point.setZ(point.getZ() + 1);
+   geometryModel->replacePointAt(0, point);
+   CPPUNIT_ASSERT_MESSAGE("Geometry fingerprint didn't change", geometryModel->getGeometryFingerprint() != geometryFingerprint);
+}
+
+void AnimationCacheTest::testInvalidFile()
+{
+   string fileName = getTemporaryCacheFileName();
+   
+   FILE *file = fopen(fileName.c_str(), "wb");
+   fputs("This is not an animation cache, but it is long enough to be mistaken for the header of one if magic is not checked", file);
+   fclose(file);
+   
+   AnimationCache cache;
+   bool opened = cache.open(fileName);
+   unlink(fileName.c_str());
+   
+   CPPUNIT_ASSERT_MESSAGE("Invalid file opened", !opened);
+   CPPUNIT_ASSERT_MESSAGE("Invalid file left open", !cache.isOpen());
+   CPPUNIT_ASSERT_MESSAGE("Missing file opened", !cache.open(fileName));
+}
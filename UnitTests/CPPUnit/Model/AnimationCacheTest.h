@@ -0,0 +1,85 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ANIMATION_CACHE_TEST_H_
+#define ANIMATION_CACHE_TEST_H_
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace hdsim {
+   
+   class AnimationCacheTest : public CppUnit::TestFixture  {
+      CPPUNIT_TEST_SUITE(AnimationCacheTest);
+         CPPUNIT_TEST(testRoundTrip);
+         CPPUNIT_TEST(testFindFrame);
+         CPPUNIT_TEST(testModelUsesCache);
+         CPPUNIT_TEST(testInvalidFile);
+      CPPUNIT_TEST_SUITE_END();
+      
+   public:
+      
+      /**
+       * Constructor
+       */
+      AnimationCacheTest();
+      
+      /**
+       * Destructor
+       */
+      virtual ~AnimationCacheTest();
+      
+      /**
+       * Prepare test for running
+       */
+      void setUp();
+      
+      /**
+       * Cleanup after test
+       */
+      void tearDown();
+      
+      /**
+       * Test that frames read from the cache match calculated frames, for all encodings
+       */
+      void testRoundTrip();
+      
+      /**
+       * Test finding of the frames by timeslice
+       */
+      void testFindFrame();
+      
+      /**
+       * Test that model reads frames from the cache only while key matches
+       */
+      void testModelUsesCache();
+      
+      /**
+       * Test that invalid cache file is rejected
+       */
+      void testInvalidFile();
+      
+   private:
+      // define
+      AnimationCacheTest(const AnimationCacheTest &rhs);   
+      AnimationCacheTest & operator=(const AnimationCacheTest &rhs);   
+   };
+   
+}
+
+#endif
@@ -0,0 +1,98 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "AsyncFrameCalculator.h"
+#include "GPUInterpolatedModel.h"
+#include "MathHelper.h"
+#include "AsyncFrameCalculatorTest.h"
+
+using namespace hdsim;
+using namespace std;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(AsyncFrameCalculatorTest);
+
+AsyncFrameCalculatorTest::AsyncFrameCalculatorTest()
+{
+   
+}
+
+AsyncFrameCalculatorTest::~AsyncFrameCalculatorTest()
+{
+   
+}
+
+void AsyncFrameCalculatorTest::setUp()
+{
+   
+}
+
+void AsyncFrameCalculatorTest::tearDown()
+{
+   
+}
+
+void AsyncFrameCalculatorTest::testRequestFrame()
+{
+   GPUInterpolatedModel model;
+   CPPUNIT_ASSERT_MESSAGE("Reading from file failed", model.readFromFile("singleQuad.GPUHoloSim"));
+   
+   AsyncFrameCalculator calculator(model);
+   
+   FrameFuture first = calculator.requestFrame(0.25);
+   FrameFuture second = calculator.requestFrame(0.75);
+   
+   FrameHandle frame = second.get();
+   CPPUNIT_ASSERT_MESSAGE("Frame not calculated", frame.isValid());
+   CPPUNIT_ASSERT_MESSAGE("Wrong timeslice", areEqual(frame->getTimeSlice(), 0.75));
+   CPPUNIT_ASSERT_MESSAGE("Wrong size", frame->getSizeX() == model.getSizeX()  &&  frame->getSizeY() == model.getSizeY());
+   
+   // Requests are calculated in order
+   CPPUNIT_ASSERT_MESSAGE("Earlier request not finished", first.isReady()  &&  areEqual(first.get()->getTimeSlice(), 0.25));
+   CPPUNIT_ASSERT_MESSAGE("Caller's model should not be touched", !model.isModelCalculated());
+}
+
+void AsyncFrameCalculatorTest::testCancelPendingRequests()
+{
+   static const int NUM_REQUESTS = 10;
+   
+   GPUInterpolatedModel model;
+   CPPUNIT_ASSERT_MESSAGE("Reading from file failed", model.readFromFile("singleQuad.GPUHoloSim"));
+   
+   AsyncFrameCalculator calculator(model);
+   
+   FrameFuture futures[NUM_REQUESTS];
+   for (int i = 0; i < NUM_REQUESTS; i++)
+      futures[i] = calculator.requestFrame(i / (double)NUM_REQUESTS);
+   
+   int numCancelled = calculator.cancelPendingRequests();
+   FrameFuture latest = calculator.requestFrame(GPUInterpolatedModel::MAX_TIME_SLICE);
+   
+   CPPUNIT_ASSERT_MESSAGE("Latest request not calculated", latest.get().isValid());
+   
+   int numCalculated = 0;
+   for (int i = 0; i < NUM_REQUESTS; i++)
+   {
+      CPPUNIT_ASSERT_MESSAGE("Request neither calculated nor cancelled", futures[i].isReady());
+      if (!futures[i].isCancelled())
+         numCalculated++;
+   }
+   
+   CPPUNIT_ASSERT_MESSAGE("Cancelled requests were calculated", numCalculated == NUM_REQUESTS - numCancelled);
+}
@@ -0,0 +1,73 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ASYNC_FRAME_CALCULATOR_TEST_H_
+#define ASYNC_FRAME_CALCULATOR_TEST_H_
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace hdsim {
+   
+   class AsyncFrameCalculatorTest : public CppUnit::TestFixture  {
+      CPPUNIT_TEST_SUITE(AsyncFrameCalculatorTest);
+         CPPUNIT_TEST(testRequestFrame);
+         CPPUNIT_TEST(testCancelPendingRequests);
+      CPPUNIT_TEST_SUITE_END();
+      
+   public:
+      
+      /**
+       * Constructor
+       */
+      AsyncFrameCalculatorTest();
+      
+      /**
+       * Destructor
+       */
+      virtual ~AsyncFrameCalculatorTest();
+      
+      /**
+       * Prepare test for running
+       */
+      void setUp();
+      
+      /**
+       * Cleanup after test
+       */
+      void tearDown();
+      
+      /**
+       * Test that requested frame is calculated at the requested timeslice
+       */
+      void testRequestFrame();
+      
+      /**
+       * Test that cancelled requests are not calculated
+       */
+      void testCancelPendingRequests();
+      
+   private:
+      // define
+      AsyncFrameCalculatorTest(const AsyncFrameCalculatorTest &rhs);   
+      AsyncFrameCalculatorTest & operator=(const AsyncFrameCalculatorTest &rhs);   
+   };
+   
+}
+
+#endif
@@ -0,0 +1,159 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "FrameCache.h"
+#include "FrameCacheTest.h"
+
+using namespace hdsim;
+using namespace std;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(FrameCacheTest);
+
+FrameCacheTest::FrameCacheTest()
+{
+   
+}
+
+FrameCacheTest::~FrameCacheTest()
+{
+   
+}
+
+void FrameCacheTest::setUp()
+{
+   
+}
+
+void FrameCacheTest::tearDown()
+{
+   
+}
+
+/**
+ * Get key of the scene used in tests
+ *
+ * @param geometryHash Hash of the geometry, so that different scenes could be created
+ *
+ * @return Key of the scene
+ */
+static AnimationCacheKey getSceneKey(unsigned long long geometryHash)
+{
+   AnimationCacheKey key;
+   
+   key.geometryHash = geometryHash;
+   key.shaderHash = 1;
+   key.sizeX = key.sizeY = 4;
+   
+   for (int i = 0; i < 6; i++)
+      key.renderedArea[i] = i;
+   
+   return key;
+}
+
+/**
+ * Get size of the cached 4x4 frame
+ */
+static size_t getFrameBytes()
+{
+   return sizeof(Frame) + 16 * sizeof(float);
+}
+
+void FrameCacheTest::testHitAndMiss()
+{
+   FrameCache cache;
+   
+   FrameCacheKey key = cache.makeKey(getSceneKey(1), 0.5);
+   CPPUNIT_ASSERT_MESSAGE("Found frame in empty cache", !cache.find(key).isValid());
+   
+   FrameHandle frame = Frame::create(4, 4, 0.5);
+   cache.insert(key, frame);
+   
+   FrameHandle found = cache.find(key);
+   CPPUNIT_ASSERT_MESSAGE("Cached frame not found", found.isValid()  &&  found.get() == frame.get());
+   CPPUNIT_ASSERT_MESSAGE("Different scene found", !cache.find(cache.makeKey(getSceneKey(2), 0.5)).isValid());
+   CPPUNIT_ASSERT_MESSAGE("Different timeslice found", !cache.find(cache.makeKey(getSceneKey(1), 0.6)).isValid());
+   
+   CPPUNIT_ASSERT_MESSAGE("Wrong number of hits", cache.getNumHits() == 1);
+   CPPUNIT_ASSERT_MESSAGE("Wrong number of misses", cache.getNumMisses() == 3);
+   CPPUNIT_ASSERT_MESSAGE("Wrong size", cache.getNumFrames() == 1  &&  cache.getNumBytes() == getFrameBytes());
+   
+   cache.resetStatistics();
+   CPPUNIT_ASSERT_MESSAGE("Statistics not reset", cache.getNumHits() == 0  &&  cache.getNumMisses() == 0);
+   
+   cache.clear();
+   CPPUNIT_ASSERT_MESSAGE("Cache not cleared", cache.getNumFrames() == 0  &&  cache.getNumBytes() == 0  &&  !cache.find(key).isValid());
+}
+
+void FrameCacheTest::testLeastRecentlyUsedEvicted()
+{
+   FrameCache cache(3 * getFrameBytes());
+   
+   for (int i = 0; i < 3; i++)
+      cache.insert(cache.makeKey(getSceneKey(1), i * 0.1), Frame::create(4, 4, i * 0.1));
+   
+   // Touch the oldest frame, so that the second one becomes least recently used
+   CPPUNIT_ASSERT_MESSAGE("Frame not found", cache.find(cache.makeKey(getSceneKey(1), 0)).isValid());
+   
+   cache.insert(cache.makeKey(getSceneKey(1), 0.3), Frame::create(4, 4, 0.3));
+   
+   CPPUNIT_ASSERT_MESSAGE("Wrong number of frames", cache.getNumFrames() == 3);
+   CPPUNIT_ASSERT_MESSAGE("Wrong number of evictions", cache.getNumEvictions() == 1);
+   CPPUNIT_ASSERT_MESSAGE("Least recently used frame not evicted", !cache.find(cache.makeKey(getSceneKey(1), 0.1)).isValid());
+   CPPUNIT_ASSERT_MESSAGE("Recently used frame evicted", cache.find(cache.makeKey(getSceneKey(1), 0)).isValid());
+   CPPUNIT_ASSERT_MESSAGE("New frame evicted", cache.find(cache.makeKey(getSceneKey(1), 0.3)).isValid());
+}
+
+void FrameCacheTest::testByteBudget()
+{
+   FrameCache cache(5 * getFrameBytes());
+   
+   for (int i = 0; i < 20; i++)
+   {
+      cache.insert(cache.makeKey(getSceneKey(i), 0), Frame::create(4, 4, 0));
+      CPPUNIT_ASSERT_MESSAGE("Over the budget", cache.getNumBytes() <= cache.getByteBudget());
+   }
+   
+   CPPUNIT_ASSERT_MESSAGE("Budget not used", cache.getNumFrames() == 5);
+   
+   // Replacing the frame must not count it twice
+   cache.insert(cache.makeKey(getSceneKey(19), 0), Frame::create(4, 4, 0));
+   CPPUNIT_ASSERT_MESSAGE("Replaced frame counted twice", cache.getNumFrames() == 5  &&  cache.getNumBytes() == 5 * getFrameBytes());
+   
+   cache.insert(cache.makeKey(getSceneKey(100), 0), Frame::create(100, 100, 0));
+   CPPUNIT_ASSERT_MESSAGE("Frame larger then the budget cached", !cache.find(cache.makeKey(getSceneKey(100), 0)).isValid());
+   
+   cache.setByteBudget(2 * getFrameBytes());
+   CPPUNIT_ASSERT_MESSAGE("Lowering budget didn't evict", cache.getNumFrames() == 2  &&  cache.getNumBytes() <= cache.getByteBudget());
+}
+
+void FrameCacheTest::testTimeSliceQuantization()
+{
+   FrameCache cache;
+   
+   cache.insert(cache.makeKey(getSceneKey(1), 0.3), Frame::create(4, 4, 0.3));
+   
+   CPPUNIT_ASSERT_MESSAGE("Same timeslice with floating point error not found", cache.find(cache.makeKey(getSceneKey(1), 0.1 + 0.2)).isValid());
+   
+   FrameCache coarseCache(FrameCache::DEFAULT_BYTE_BUDGET, 0.1);
+   coarseCache.insert(coarseCache.makeKey(getSceneKey(1), 0.3), Frame::create(4, 4, 0.3));
+   
+   CPPUNIT_ASSERT_MESSAGE("Timeslice within quantum not found", coarseCache.find(coarseCache.makeKey(getSceneKey(1), 0.32)).isValid());
+   CPPUNIT_ASSERT_MESSAGE("Timeslice outside of quantum found", !coarseCache.find(coarseCache.makeKey(getSceneKey(1), 0.4)).isValid());
+}
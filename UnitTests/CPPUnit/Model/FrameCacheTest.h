@@ -0,0 +1,85 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_CACHE_TEST_H_
+#define FRAME_CACHE_TEST_H_
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace hdsim {
+   
+   class FrameCacheTest : public CppUnit::TestFixture  {
+      CPPUNIT_TEST_SUITE(FrameCacheTest);
+         CPPUNIT_TEST(testHitAndMiss);
+         CPPUNIT_TEST(testLeastRecentlyUsedEvicted);
+         CPPUNIT_TEST(testByteBudget);
+         CPPUNIT_TEST(testTimeSliceQuantization);
+      CPPUNIT_TEST_SUITE_END();
+      
+   public:
+      
+      /**
+       * Constructor
+       */
+      FrameCacheTest();
+      
+      /**
+       * Destructor
+       */
+      virtual ~FrameCacheTest();
+      
+      /**
+       * Prepare test for running
+       */
+      void setUp();
+      
+      /**
+       * Cleanup after test
+       */
+      void tearDown();
+      
+      /**
+       * Test that cached frame is found and statistics are counted
+       */
+      void testHitAndMiss();
+      
+      /**
+       * Test that least recently used frame is evicted when over the budget
+       */
+      void testLeastRecentlyUsedEvicted();
+      
+      /**
+       * Test that cache never goes over the budget
+       */
+      void testByteBudget();
+      
+      /**
+       * Test that timeslices differing by floating point error share the frame
+       */
+      void testTimeSliceQuantization();
+      
+   private:
+      // define
+      FrameCacheTest(const FrameCacheTest &rhs);   
+      FrameCacheTest & operator=(const FrameCacheTest &rhs);   
+   };
+   
+}
+
+#endif
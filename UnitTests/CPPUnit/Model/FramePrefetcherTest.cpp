@@ -0,0 +1,105 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "FramePrefetcher.h"
+#include "GPUInterpolatedModel.h"
+#include "MathHelper.h"
+#include "FramePrefetcherTest.h"
+
+using namespace hdsim;
+using namespace std;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(FramePrefetcherTest);
+
+FramePrefetcherTest::FramePrefetcherTest()
+{
+   
+}
+
+FramePrefetcherTest::~FramePrefetcherTest()
+{
+   
+}
+
+void FramePrefetcherTest::setUp()
+{
+   
+}
+
+void FramePrefetcherTest::tearDown()
+{
+   
+}
+
+void FramePrefetcherTest::testFramesFollowAnimation()
+{
+   GPUInterpolatedModel model;
+   CPPUNIT_ASSERT_MESSAGE("Reading from file failed", model.readFromFile("singleQuad.GPUHoloSim"));
+   
+   FramePrefetcher prefetcher(model, 3);
+   prefetcher.setAnimation(0.1, true);
+   prefetcher.seek(0);
+   
+   for (int i = 1; i <= 5; i++)
+   {
+      FrameHandle frame = prefetcher.popFrame();
+      CPPUNIT_ASSERT_MESSAGE("Frame not calculated", frame.isValid());
+      CPPUNIT_ASSERT_MESSAGE("Frame out of order", areEqual(frame->getTimeSlice(), i * 0.1));
+   }
+   
+   CPPUNIT_ASSERT_MESSAGE("Not all pops accounted", prefetcher.getNumHits() + prefetcher.getNumMisses() == 5);
+}
+
+void FramePrefetcherTest::testSeekInvalidates()
+{
+   GPUInterpolatedModel model;
+   CPPUNIT_ASSERT_MESSAGE("Reading from file failed", model.readFromFile("singleQuad.GPUHoloSim"));
+   
+   FramePrefetcher prefetcher(model, 3);
+   prefetcher.setAnimation(0.1, true);
+   prefetcher.seek(0);
+   prefetcher.popFrame();
+   
+   prefetcher.seek(0.5);
+   CPPUNIT_ASSERT_MESSAGE("Seek didn't invalidate queue", prefetcher.getNumInvalidations() == 1);
+   CPPUNIT_ASSERT_MESSAGE("Frame after seek is wrong", areEqual(prefetcher.popFrame()->getTimeSlice(), 0.6));
+   
+   prefetcher.skipFrames(2);
+   CPPUNIT_ASSERT_MESSAGE("Frame after skip is wrong", areEqual(prefetcher.popFrame()->getTimeSlice(), 0.9));
+}
+
+void FramePrefetcherTest::testAnimationEnd()
+{
+   GPUInterpolatedModel model;
+   CPPUNIT_ASSERT_MESSAGE("Reading from file failed", model.readFromFile("singleQuad.GPUHoloSim"));
+   
+   FramePrefetcher prefetcher(model, 4);
+   prefetcher.setAnimation(0.5, false);
+   prefetcher.seek(0);
+   
+   CPPUNIT_ASSERT_MESSAGE("Wrong first frame", areEqual(prefetcher.popFrame()->getTimeSlice(), 0.5));
+   
+   for (int i = 0; i < 5; i++)
+      CPPUNIT_ASSERT_MESSAGE("Animation didn't stop at the end", areEqual(prefetcher.popFrame()->getTimeSlice(), GPUInterpolatedModel::MAX_TIME_SLICE));
+   
+   // Skipping shared requests at the end must not cancel frames that are still queued
+   prefetcher.skipFrames(2);
+   CPPUNIT_ASSERT_MESSAGE("Frame lost after skip", prefetcher.popFrame().isValid());
+}
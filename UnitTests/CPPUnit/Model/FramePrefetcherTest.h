@@ -0,0 +1,79 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_PREFETCHER_TEST_H_
+#define FRAME_PREFETCHER_TEST_H_
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace hdsim {
+   
+   class FramePrefetcherTest : public CppUnit::TestFixture  {
+      CPPUNIT_TEST_SUITE(FramePrefetcherTest);
+         CPPUNIT_TEST(testFramesFollowAnimation);
+         CPPUNIT_TEST(testSeekInvalidates);
+         CPPUNIT_TEST(testAnimationEnd);
+      CPPUNIT_TEST_SUITE_END();
+      
+   public:
+      
+      /**
+       * Constructor
+       */
+      FramePrefetcherTest();
+      
+      /**
+       * Destructor
+       */
+      virtual ~FramePrefetcherTest();
+      
+      /**
+       * Prepare test for running
+       */
+      void setUp();
+      
+      /**
+       * Cleanup after test
+       */
+      void tearDown();
+      
+      /**
+       * Test that popped frames follow the animation
+       */
+      void testFramesFollowAnimation();
+      
+      /**
+       * Test that seek invalidates queued frames
+       */
+      void testSeekInvalidates();
+      
+      /**
+       * Test that animation that doesn't loop stays at the end
+       */
+      void testAnimationEnd();
+      
+   private:
+      // define
+      FramePrefetcherTest(const FramePrefetcherTest &rhs);   
+      FramePrefetcherTest & operator=(const FramePrefetcherTest &rhs);   
+   };
+   
+}
+
+#endif
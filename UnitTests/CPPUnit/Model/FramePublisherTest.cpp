@@ -0,0 +1,155 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <pthread.h>
+
+#include "FramePublisher.h"
+#include "FramePublisherTest.h"
+
+using namespace hdsim;
+using namespace std;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(FramePublisherTest);
+
+FramePublisherTest::FramePublisherTest()
+{
+   
+}
+
+FramePublisherTest::~FramePublisherTest()
+{
+   
+}
+
+void FramePublisherTest::setUp()
+{
+   
+}
+
+void FramePublisherTest::tearDown()
+{
+   
+}
+
+void FramePublisherTest::testPublishAndRead()
+{
+   FramePublisher publisher;
+   CPPUNIT_ASSERT_MESSAGE("Frame available before publishing", !publisher.getLatestFrame().isValid());
+   
+   for (int i = 0; i < 10; i++)
+   {
+      FrameHandle frame = publisher.acquireBuffer(4, 4, i * 0.1);
+      publisher.publish(frame);
+      
+      CPPUNIT_ASSERT_MESSAGE("Latest frame not returned", publisher.getLatestFrame().get() == frame.get());
+      CPPUNIT_ASSERT_MESSAGE("Wrong version", publisher.getVersion() == i + 1);
+   }
+}
+
+void FramePublisherTest::testBufferRecycling()
+{
+   FramePublisher publisher;
+   
+   FrameHandle held = publisher.acquireBuffer(4, 4, 0);
+   publisher.publish(held);
+   
+   // Push the held frame out of the published slots
+   for (int i = 1; i <= FramePublisher::NUM_SLOTS; i++)
+      publisher.publish(publisher.acquireBuffer(4, 4, i));
+   
+   // Reader still holds the frame, so it must not be handed out for writing
+   for (int i = 0; i < FramePublisher::MAX_NUM_BUFFERS; i++)
+   {
+      FrameHandle buffer = publisher.acquireBuffer(4, 4, 0);
+      CPPUNIT_ASSERT_MESSAGE("Frame held by the reader recycled", buffer.get() != held.get());
+      CPPUNIT_ASSERT_MESSAGE("Buffer is shared", buffer.getRefCount() <= 2);
+      publisher.publish(buffer);
+   }
+   
+   CPPUNIT_ASSERT_MESSAGE("Buffers not recycled", publisher.getNumRecycledBuffers() > 0);
+   
+   FrameHandle buffer = publisher.acquireBuffer(4, 4, 0.5);
+   CPPUNIT_ASSERT_MESSAGE("Timeslice of the recycled frame not set", buffer->getTimeSlice() == 0.5);
+}
+
+/**
+ * Shared state of the concurrent test
+ */
+struct ConcurrentTestState {
+   FramePublisher *publisher;
+   volatile bool done;
+   volatile bool tornFrameSeen;
+};
+
+static const int TEST_FRAME_SIZE = 64;
+
+/**
+ * Reader thread, checks that all values in the frame are the same
+ */
+static void *readFrames(void *argument)
+{
+   ConcurrentTestState *state = static_cast<ConcurrentTestState *>(argument);
+   
+   while (!state->done)
+   {
+      FrameHandle frame = state->publisher->getLatestFrame();
+      if (!frame.isValid())
+         continue;
+      
+      const float *values = frame->getValues();
+      for (int i = 0; i < TEST_FRAME_SIZE * TEST_FRAME_SIZE; i++)
+         if (values[i] != values[0]  ||  values[i] != (float)frame->getTimeSlice())
+            state->tornFrameSeen = true;
+   }
+   
+   return 0;
+}
+
+void FramePublisherTest::testConcurrentReaders()
+{
+   static const int NUM_READERS = 4;
+   
+   FramePublisher publisher;
+   ConcurrentTestState state = {&publisher, false, false};
+   
+   pthread_t readers[NUM_READERS];
+   for (int i = 0; i < NUM_READERS; i++)
+      pthread_create(&readers[i], 0, readFrames, &state);
+   
+   for (int version = 1; version <= 2000; version++)
+   {
+      FrameHandle frame = publisher.acquireBuffer(TEST_FRAME_SIZE, TEST_FRAME_SIZE, version);
+      float *values = frame->getMutableValues();
+      
+      for (int i = 0; i < TEST_FRAME_SIZE * TEST_FRAME_SIZE; i++)
+         values[i] = version;
+      
+      publisher.publish(frame);
+   }
+   
+   state.done = true;
+   
+   for (int i = 0; i < NUM_READERS; i++)
+      pthread_join(readers[i], 0);
+   
+   CPPUNIT_ASSERT_MESSAGE("Reader saw torn frame", !state.tornFrameSeen);
+   CPPUNIT_ASSERT_MESSAGE("Not all frames published", publisher.getVersion() == 2000);
+   CPPUNIT_ASSERT_MESSAGE("Buffers not recycled", publisher.getNumRecycledBuffers() > 0);
+}
@@ -0,0 +1,79 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_PUBLISHER_TEST_H_
+#define FRAME_PUBLISHER_TEST_H_
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace hdsim {
+   
+   class FramePublisherTest : public CppUnit::TestFixture  {
+      CPPUNIT_TEST_SUITE(FramePublisherTest);
+         CPPUNIT_TEST(testPublishAndRead);
+         CPPUNIT_TEST(testBufferRecycling);
+         CPPUNIT_TEST(testConcurrentReaders);
+      CPPUNIT_TEST_SUITE_END();
+      
+   public:
+      
+      /**
+       * Constructor
+       */
+      FramePublisherTest();
+      
+      /**
+       * Destructor
+       */
+      virtual ~FramePublisherTest();
+      
+      /**
+       * Prepare test for running
+       */
+      void setUp();
+      
+      /**
+       * Cleanup after test
+       */
+      void tearDown();
+      
+      /**
+       * Test that readers get the latest published frame
+       */
+      void testPublishAndRead();
+      
+      /**
+       * Test that buffers are recycled only when nobody references them
+       */
+      void testBufferRecycling();
+      
+      /**
+       * Test that concurrent readers never see torn frames
+       */
+      void testConcurrentReaders();
+      
+   private:
+      // define
+      FramePublisherTest(const FramePublisherTest &rhs);   
+      FramePublisherTest & operator=(const FramePublisherTest &rhs);   
+   };
+   
+}
+
+#endif
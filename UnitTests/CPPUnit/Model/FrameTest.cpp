@@ -0,0 +1,97 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <cstring>
+
+#include "CheckBoard.h"
+#include "Frame.h"
+#include "MathHelper.h"
+#include "FrameTest.h"
+
+using namespace hdsim;
+using namespace std;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(FrameTest);
+
+FrameTest::FrameTest()
+{
+   
+}
+
+FrameTest::~FrameTest()
+{
+   
+}
+
+void FrameTest::setUp()
+{
+   
+}
+
+void FrameTest::tearDown()
+{
+   
+}
+
+void FrameTest::testCreateFromModel()
+{
+   CheckBoard checkBoard(3, 2);
+   checkBoard.setAt(2, 1, 0.5);
+   
+   FrameHandle frame = Frame::createFromModel(&checkBoard, 0.25);
+   
+   CPPUNIT_ASSERT_MESSAGE("Frame not created", frame.isValid());
+   CPPUNIT_ASSERT_MESSAGE("Wrong frame size", frame->getSizeX() == 3  &&  frame->getSizeY() == 2);
+   CPPUNIT_ASSERT_MESSAGE("Wrong timeslice", areEqual(frame->getTimeSlice(), 0.25));
+   CPPUNIT_ASSERT_MESSAGE("Wrong value", areEqual(frame->getAt(2, 1), 0.5));
+   CPPUNIT_ASSERT_MESSAGE("Wrong value layout", areEqual(frame->getValues()[1 * 3 + 2], 0.5));
+   CPPUNIT_ASSERT_MESSAGE("Wrong value", areEqual(frame->getAt(0, 0), 0));
+}
+
+void FrameTest::testHandleRefCount()
+{
+   FrameHandle frame = Frame::create(2, 2, 0);
+   CPPUNIT_ASSERT_MESSAGE("New frame should have single reference", frame.getRefCount() == 1);
+   
+   {
+      FrameHandle copy = frame;
+      CPPUNIT_ASSERT_MESSAGE("Copy doesn't share frame", copy.get() == frame.get());
+      CPPUNIT_ASSERT_MESSAGE("Copy not counted", frame.getRefCount() == 2);
+   }
+   
+   CPPUNIT_ASSERT_MESSAGE("Destroyed copy not counted", frame.getRefCount() == 1);
+   
+   FrameHandle empty;
+   CPPUNIT_ASSERT_MESSAGE("Empty handle should be invalid", !empty.isValid()  &&  empty.getRefCount() == 0);
+}
+
+void FrameTest::testClone()
+{
+   FrameHandle frame = Frame::create(2, 2, 0);
+   frame->getMutableValues()[0] = 1;
+   
+   AbstractModel *clone = frame->cloneOrphan();
+   frame->getMutableValues()[0] = 2;
+   
+   CPPUNIT_ASSERT_MESSAGE("Aliasing happened", areEqual(clone->getAt(0, 0), 1));
+   CPPUNIT_ASSERT_MESSAGE("Wrong model name", !strcmp(clone->getModelName(), FRAME_MODEL_NAME));
+   
+   delete clone;
+}
@@ -0,0 +1,79 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_TEST_H_
+#define FRAME_TEST_H_
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace hdsim {
+   
+   class FrameTest : public CppUnit::TestFixture  {
+      CPPUNIT_TEST_SUITE(FrameTest);
+         CPPUNIT_TEST(testCreateFromModel);
+         CPPUNIT_TEST(testHandleRefCount);
+         CPPUNIT_TEST(testClone);
+      CPPUNIT_TEST_SUITE_END();
+      
+   public:
+      
+      /**
+       * Constructor
+       */
+      FrameTest();
+      
+      /**
+       * Destructor
+       */
+      virtual ~FrameTest();
+      
+      /**
+       * Prepare test for running
+       */
+      void setUp();
+      
+      /**
+       * Cleanup after test
+       */
+      void tearDown();
+      
+      /**
+       * Test that frame is correct snapshot of the model
+       */
+      void testCreateFromModel();
+      
+      /**
+       * Test that handles share the frame and count references
+       */
+      void testHandleRefCount();
+      
+      /**
+       * Test that clone of the frame is deep copy
+       */
+      void testClone();
+      
+   private:
+      // define
+      FrameTest(const FrameTest &rhs);   
+      FrameTest & operator=(const FrameTest &rhs);   
+   };
+   
+}
+
+#endif
@@ -304,4 +304,9 @@ void GPUInterpolatedModelTest::testNoShiftsAfterDecimation()
       }
 }
 
-
+void GPUInterpolatedModelTest::testNextTimeSlice()
+{
+   CPPUNIT_ASSERT_MESSAGE("Timeslice not advanced", areEqual(GPUInterpolatedModel::getNextTimeSlice(0.25, 0.5, false), 0.75));
+   CPPUNIT_ASSERT_MESSAGE("Timeslice not stopped at the end", areEqual(GPUInterpolatedModel::getNextTimeSlice(0.75, 0.5, false), GPUInterpolatedModel::MAX_TIME_SLICE));
+   CPPUNIT_ASSERT_MESSAGE("Timeslice not looped", areEqual(GPUInterpolatedModel::getNextTimeSlice(0.75, 0.5, true), 0.25));
+}
@@ -39,6 +39,7 @@ namespace hdsim {
          CPPUNIT_TEST(testDecimation);
          CPPUNIT_TEST(testNoShiftsAfterDecimation);      
          CPPUNIT_TEST(testIdentityDecimation);
+         CPPUNIT_TEST(testNextTimeSlice);
       CPPUNIT_TEST_SUITE_END();
       
    public:
@@ -128,6 +129,11 @@ namespace hdsim {
        */
    	void testIdentityDecimation();
       
+      /**
+       * Test that animation advances, loops and stops at the end correctly
+       */
+      void testNextTimeSlice();
+      
    private:
       
       // define
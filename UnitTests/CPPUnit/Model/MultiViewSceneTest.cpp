@@ -0,0 +1,204 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <sstream>
+
+#include "GPUGeometryModel.h"
+#include "MultiViewScene.h"
+#include "TestGeometry.h"
+#include "MultiViewSceneTest.h"
+
+using namespace hdsim;
+using namespace std;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(MultiViewSceneTest);
+
+/**
+ * Depth of the empty moxel
+ */
+static const double Z_INFINITY = 1;
+
+MultiViewSceneTest::MultiViewSceneTest()
+{
+   
+}
+
+MultiViewSceneTest::~MultiViewSceneTest()
+{
+   
+}
+
+void MultiViewSceneTest::setUp()
+{
+   
+}
+
+void MultiViewSceneTest::tearDown()
+{
+   
+}
+
+void MultiViewSceneTest::testMatchesSingleBoard()
+{
+   const int SIZE_X = 32;
+   const int SIZE_Y = 24;
+   
+   // Same setup as in GPUGeometryModelTest::testQuadCoveringWholeArea(), quad is in the middle of the rendered area
+   const double Z_BUFFER_VALUE = 0.5;
+   
+   GPUGeometryModel model(SIZE_X, SIZE_Y);
+   model.setRenderedArea(-0.5, -0.5, -0.5, 0.5, 0.5, 0.5);
+   addQuad(&model, -1, 1, 0);
+   
+   MultiViewScene scene;
+   scene.addView(getModelView(model));
+   scene.setGeometry(model);
+   scene.calculate();
+   
+   for (int y = 0; y < SIZE_Y; y++)
+      for (int x = 0; x < SIZE_X; x++)
+      {
+         stringstream message;
+         message << "Error at the coordinates X = " << x << " Y = " << y << " got " << scene.getAt(0, x, y);
+         
+         CPPUNIT_ASSERT_MESSAGE(message.str().c_str(), areEqualInLowPrecision(scene.getAt(0, x, y), Z_BUFFER_VALUE));
+      }
+}
+
+void MultiViewSceneTest::testPartialCoverage()
+{
+   const int SIZE = 8;
+   
+   // One unit is one moxel, so triangle covers moxels whose centers satisfy x + y < SIZE. Centers on the hypotenuse are on its right edge and are not covered
+   GPUGeometryModel model(SIZE, SIZE);
+   model.setRenderedArea(0, 0, -1, SIZE, SIZE, 1);
+   
+   model.addPoint(createPoint(0, 0, 0));
+   model.addPoint(createPoint(SIZE, 0, 0));
+   model.addPoint(createPoint(0, SIZE, 0));
+   model.addTriangle(createTriangle(0, 1, 2));
+   
+   MultiViewScene scene;
+   scene.addView(getModelView(model));
+   scene.setGeometry(model);
+   scene.calculate();
+   
+   for (int y = 0; y < SIZE; y++)
+      for (int x = 0; x < SIZE; x++)
+      {
+         stringstream message;
+         message << "Error at the coordinates X = " << x << " Y = " << y << " got " << scene.getAt(0, x, y);
+         
+         double expected = x + y + 1 < SIZE ? 0.5 : Z_INFINITY;
+         CPPUNIT_ASSERT_MESSAGE(message.str().c_str(), areEqualInLowPrecision(scene.getAt(0, x, y), expected));
+      }
+}
+
+void MultiViewSceneTest::testNearestWins()
+{
+   const int SIZE = 16;
+   
+   // Higher quad is closer to the board
+   const double NEAR_VALUE = 0.25;
+   
+   for (int order = 0; order < 2; order++)
+   {
+      GPUGeometryModel model(SIZE, SIZE);
+      model.setRenderedArea(-1, -1, -1, 1, 1, 1);
+      
+      addQuad(&model, -2, 2, order ? 0.5 : -0.5);
+      addQuad(&model, -2, 2, order ? -0.5 : 0.5);
+      
+      MultiViewScene scene;
+      scene.addView(getModelView(model));
+      scene.setGeometry(model);
+      scene.calculate();
+      
+      for (int y = 0; y < SIZE; y++)
+         for (int x = 0; x < SIZE; x++)
+            CPPUNIT_ASSERT_MESSAGE("Nearest quad didn't win", areEqualInLowPrecision(scene.getAt(0, x, y), NEAR_VALUE));
+   }
+}
+
+void MultiViewSceneTest::testRoomBoards()
+{
+   const int SIZE = 16;
+   
+   // Box fills the middle half of the room, so every board sees its face at quarter of the room depth
+   const double FACE_VALUE = 0.25;
+   
+   GPUGeometryModel model;
+   
+   for (int i = 0; i < 8; i++)
+      model.addPoint(createPoint(i & 1 ? 0.75 : 0.25, i & 2 ? 0.75 : 0.25, i & 4 ? 0.75 : 0.25));
+   
+   // Two triangles per face, faces are given by the fixed axis bit and its value
+   for (int axis = 1; axis <= 4; axis *= 2)
+      for (int side = 0; side < 2; side++)
+      {
+         int other1 = axis == 1 ? 2 : 1;
+         int other2 = axis == 4 ? 2 : 4;
+         int base = side ? axis : 0;
+         
+         model.addTriangle(createTriangle(base, base + other1, base + other1 + other2));
+         model.addTriangle(createTriangle(base, base + other2, base + other1 + other2));
+      }
+   
+   const double roomMin[3] = {0, 0, 0};
+   const double roomMax[3] = {1, 1, 1};
+   
+   MultiViewScene scene;
+   
+   for (int board = ROOM_CEILING; board <= ROOM_WALL_MAX_Y; board++)
+      scene.addView(makeRoomBoardView((RoomBoard)board, roomMin, roomMax, SIZE, SIZE));
+   
+   scene.setGeometry(model);
+   scene.calculate();
+   
+   for (int board = ROOM_CEILING; board <= ROOM_WALL_MAX_Y; board++)
+   {
+      stringstream message;
+      message << "Board " << board << " got " << scene.getAt(board, SIZE / 2, SIZE / 2) << " in the middle";
+      
+      CPPUNIT_ASSERT_MESSAGE(message.str().c_str(), areEqualInLowPrecision(scene.getAt(board, SIZE / 2, SIZE / 2), FACE_VALUE));
+      CPPUNIT_ASSERT_MESSAGE("Box seen in the corner", areEqualInLowPrecision(scene.getAt(board, 0, SIZE - 1), Z_INFINITY));
+      
+      FrameHandle frame = scene.createFrame(board, 0);
+      CPPUNIT_ASSERT_MESSAGE("Frame differs from the view", frame->getAt(SIZE / 2, SIZE / 2) == scene.getAt(board, SIZE / 2, SIZE / 2));
+   }
+}
+
+void MultiViewSceneTest::testGeometryUploadedOnce()
+{
+   GPUGeometryModel model(4, 4);
+   model.setRenderedArea(-1, -1, -1, 1, 1, 1);
+   addQuad(&model, -2, 2, 0);
+   
+   MultiViewScene scene;
+   scene.addView(getModelView(model));
+   
+   scene.setGeometry(model);
+   scene.setGeometry(model);
+   CPPUNIT_ASSERT_MESSAGE("Unchanged geometry uploaded again", scene.getNumGeometryUploads() == 1);
+   
+   model.replacePointAt(0, createPoint(-2, -2, 0.5));
+   scene.setGeometry(model);
+   CPPUNIT_ASSERT_MESSAGE("Changed geometry not uploaded", scene.getNumGeometryUploads() == 2);
+}
@@ -0,0 +1,91 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MULTI_VIEW_SCENE_TEST_H_
+#define MULTI_VIEW_SCENE_TEST_H_
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace hdsim {
+   
+   class MultiViewSceneTest : public CppUnit::TestFixture  {
+      CPPUNIT_TEST_SUITE(MultiViewSceneTest);
+         CPPUNIT_TEST(testMatchesSingleBoard);
+         CPPUNIT_TEST(testPartialCoverage);
+         CPPUNIT_TEST(testNearestWins);
+         CPPUNIT_TEST(testRoomBoards);
+         CPPUNIT_TEST(testGeometryUploadedOnce);
+      CPPUNIT_TEST_SUITE_END();
+      
+   public:
+      
+      /**
+       * Constructor
+       */
+      MultiViewSceneTest();
+      
+      /**
+       * Destructor
+       */
+      virtual ~MultiViewSceneTest();
+      
+      /**
+       * Prepare test for running
+       */
+      void setUp();
+      
+      /**
+       * Cleanup after test
+       */
+      void tearDown();
+      
+      /**
+       * Test that view of the model matches what calculation engine calculates for the quad covering the whole area
+       */
+      void testMatchesSingleBoard();
+      
+      /**
+       * Test that only moxels whose centers are inside of the triangle are covered
+       */
+      void testPartialCoverage();
+      
+      /**
+       * Test that the nearest triangle wins regardless of the drawing order
+       */
+      void testNearestWins();
+      
+      /**
+       * Test that every board of the room sees the box in the middle of the room
+       */
+      void testRoomBoards();
+      
+      /**
+       * Test that geometry is copied from the model only when it changes
+       */
+      void testGeometryUploadedOnce();
+      
+   private:
+      // define
+      MultiViewSceneTest(const MultiViewSceneTest &rhs);   
+      MultiViewSceneTest & operator=(const MultiViewSceneTest &rhs);   
+   };
+   
+}
+
+#endif
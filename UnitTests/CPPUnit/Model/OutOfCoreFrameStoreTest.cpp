@@ -0,0 +1,281 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <cmath>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "GPUGeometryModel.h"
+#include "OutOfCoreFrameStore.h"
+#include "TestGeometry.h"
+#include "OutOfCoreFrameStoreTest.h"
+#include "TiledDepthEngine.h"
+
+using namespace hdsim;
+using namespace std;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(OutOfCoreFrameStoreTest);
+
+/**
+ * Board size used by the tests. Neither dimension is multiple of the tile size, so partial tiles are used
+ */
+static const int SIZE_X = 61;
+static const int SIZE_Y = 47;
+
+/**
+ * Tile size used by the tests
+ */
+static const int TILE_SIZE = 16;
+
+/**
+ * Get name of the temporary file for the store
+ *
+ * @return Name of the temporary file
+ */
+static string getTemporaryStoreFileName()
+{
+   char fileName[] = "/tmp/HoloSimFrameStoreTestXXXXXX";
+   int fd = mkstemp(fileName);
+   
+   if (fd != -1)
+      close(fd);
+   
+   return fileName;
+}
+
+/**
+ * Value written to the moxel by the tests
+ */
+static float getTestValue(int x, int y)
+{
+   return (y * SIZE_X + x) / (float)(SIZE_X * SIZE_Y);
+}
+
+/**
+ * Write test values to all tiles of the store
+ */
+static void writeTestValues(OutOfCoreFrameStore *store)
+{
+   for (int tileY = 0; tileY < store->getNumTilesY(); tileY++)
+      for (int tileX = 0; tileX < store->getNumTilesX(); tileX++)
+      {
+         TileRange range = store->getTileRange(tileX, tileY);
+         float *values = store->lockTile(tileX, tileY, true);
+         
+         for (int y = range.beginY; y < range.endY; y++)
+            for (int x = range.beginX; x < range.endX; x++)
+               values[(y - range.beginY) * TILE_SIZE + x - range.beginX] = getTestValue(x, y);
+         
+         store->unlockTile(tileX, tileY);
+      }
+}
+
+/**
+ * Records tiles streamed from the store
+ */
+class RecordingTileConsumer : public TileConsumer {
+   
+public:
+   
+   RecordingTileConsumer() : numWrongValues(0)
+   {
+   }
+   
+   virtual void consumeTile(int tileX, int tileY, const TileRange &range, const float *values, int stride)
+   {
+      tiles.push_back(tileY * ((SIZE_X + TILE_SIZE - 1) / TILE_SIZE) + tileX);
+      
+      for (int y = range.beginY; y < range.endY; y++)
+         for (int x = range.beginX; x < range.endX; x++)
+            if (values[(y - range.beginY) * stride + x - range.beginX] != getTestValue(x, y))
+               numWrongValues++;
+   }
+   
+   vector<int> tiles;
+   int numWrongValues;
+};
+
+OutOfCoreFrameStoreTest::OutOfCoreFrameStoreTest()
+{
+   
+}
+
+OutOfCoreFrameStoreTest::~OutOfCoreFrameStoreTest()
+{
+   
+}
+
+void OutOfCoreFrameStoreTest::setUp()
+{
+   
+}
+
+void OutOfCoreFrameStoreTest::tearDown()
+{
+   
+}
+
+void OutOfCoreFrameStoreTest::testZOrder()
+{
+   string fileName = getTemporaryStoreFileName();
+   
+   OutOfCoreFrameStore store;
+   bool created = store.create(fileName, SIZE_X, SIZE_Y, TILE_SIZE);
+   unlink(fileName.c_str());
+   
+   CPPUNIT_ASSERT_MESSAGE("Can't create store", created);
+   CPPUNIT_ASSERT_MESSAGE("Wrong number of tiles", store.getNumTilesX() == 4  &&  store.getNumTilesY() == 3);
+   
+   TileRange last = store.getTileRange(3, 2);
+   CPPUNIT_ASSERT_MESSAGE("Wrong range of the partial tile", last.beginX == 48  &&  last.endX == SIZE_X  &&  last.beginY == 32  &&  last.endY == SIZE_Y);
+   
+   const int numTiles = store.getNumTilesX() * store.getNumTilesY();
+   set<int> tiles;
+   
+   for (int i = 0; i < numTiles; i++)
+      tiles.insert(store.getTileInZOrder(i));
+   
+   CPPUNIT_ASSERT_MESSAGE("Not every tile is in Z-order exactly once", tiles.size() == numTiles  &&  *tiles.begin() == 0  &&  *tiles.rbegin() == numTiles - 1);
+   
+   // First four tiles are the top left 2 x 2 block
+   int expected[] = {0, 1, 4, 5, 2, 3, 6, 7};
+   for (int i = 0; i < 8; i++)
+      CPPUNIT_ASSERT_MESSAGE("Tiles are not in Z-order", store.getTileInZOrder(i) == expected[i]);
+}
+
+void OutOfCoreFrameStoreTest::testWriteAndReopen()
+{
+   string fileName = getTemporaryStoreFileName();
+   
+   OutOfCoreFrameStore store;
+   CPPUNIT_ASSERT_MESSAGE("Can't create store", store.create(fileName, SIZE_X, SIZE_Y, TILE_SIZE));
+   
+   writeTestValues(&store);
+   store.close();
+   
+   bool opened = store.open(fileName);
+   unlink(fileName.c_str());
+   
+   CPPUNIT_ASSERT_MESSAGE("Can't open store", opened);
+   CPPUNIT_ASSERT_MESSAGE("Wrong size after reopening", store.getSizeX() == SIZE_X  &&  store.getSizeY() == SIZE_Y  &&  store.getTileSize() == TILE_SIZE);
+   
+   for (int y = 0; y < SIZE_Y; y++)
+      for (int x = 0; x < SIZE_X; x++)
+         CPPUNIT_ASSERT_MESSAGE("Wrong value after reopening", store.getAt(x, y) == getTestValue(x, y));
+   
+   // Region crosses the tile boundaries in both directions
+   TileRange region = {10, 37, 5, 40};
+   int width = region.endX - region.beginX;
+   
+   vector<float> values(width * (region.endY - region.beginY));
+   store.readRegion(region, &values[0]);
+   
+   for (int y = region.beginY; y < region.endY; y++)
+      for (int x = region.beginX; x < region.endX; x++)
+         CPPUNIT_ASSERT_MESSAGE("Wrong value in the region", values[(y - region.beginY) * width + x - region.beginX] == getTestValue(x, y));
+}
+
+void OutOfCoreFrameStoreTest::testEvictionAndWriteBack()
+{
+   string fileName = getTemporaryStoreFileName();
+   
+   // Cache much smaller than the board
+   OutOfCoreFrameStore store(2);
+   CPPUNIT_ASSERT_MESSAGE("Can't create store", store.create(fileName, SIZE_X, SIZE_Y, TILE_SIZE));
+   
+   writeTestValues(&store);
+   
+   const int numTiles = store.getNumTilesX() * store.getNumTilesY();
+   
+   CPPUNIT_ASSERT_MESSAGE("Wrong number of misses", store.getNumMisses() == numTiles  &&  store.getNumHits() == 0);
+   CPPUNIT_ASSERT_MESSAGE("Wrong number of evictions", store.getNumEvictions() == numTiles - 2);
+   CPPUNIT_ASSERT_MESSAGE("Evicted tiles not written back", store.getNumWriteBacks() == numTiles - 2);
+   
+   // Tiles that were evicted are mapped again, with their values
+   bool valuesKept = store.getAt(0, 0) == getTestValue(0, 0)  &&  store.getAt(SIZE_X - 1, SIZE_Y - 1) == getTestValue(SIZE_X - 1, SIZE_Y - 1);
+   CPPUNIT_ASSERT_MESSAGE("Values of the evicted tile lost", valuesKept);
+   
+   CPPUNIT_ASSERT_MESSAGE("Can't flush store", store.flush());
+   CPPUNIT_ASSERT_MESSAGE("Modified tiles not written back on flush", store.getNumWriteBacks() == numTiles);
+   
+   unlink(fileName.c_str());
+}
+
+void OutOfCoreFrameStoreTest::testCalculateMatchesTiledEngine()
+{
+   GPUGeometryModel model(SIZE_X, SIZE_Y);
+   model.setRenderedArea(-1, -1, -1, 1, 1, 1);
+   addWavySurface(&model);
+   
+   string fileName = getTemporaryStoreFileName();
+   
+   OutOfCoreFrameStore store(3);
+   bool created = store.create(fileName, SIZE_X, SIZE_Y, TILE_SIZE);
+   unlink(fileName.c_str());
+   
+   CPPUNIT_ASSERT_MESSAGE("Can't create store", created);
+   
+   store.calculate(model);
+   
+   TiledDepthEngine engine(TILE_SIZE);
+   engine.update(model);
+   
+   vector<float> tiled(SIZE_X * SIZE_Y);
+   engine.readValues(&tiled[0]);
+   
+   for (int y = 0; y < SIZE_Y; y++)
+      for (int x = 0; x < SIZE_X; x++)
+         CPPUNIT_ASSERT_MESSAGE("Wrong depth in the store", fabs(store.getAt(x, y) - tiled[y * SIZE_X + x]) < 1e-5);
+}
+
+void OutOfCoreFrameStoreTest::testStreamTiles()
+{
+   string fileName = getTemporaryStoreFileName();
+   
+   OutOfCoreFrameStore store(4);
+   CPPUNIT_ASSERT_MESSAGE("Can't create store", store.create(fileName, SIZE_X, SIZE_Y, TILE_SIZE));
+   
+   writeTestValues(&store);
+   store.close();
+   
+   bool opened = store.open(fileName);
+   unlink(fileName.c_str());
+   
+   CPPUNIT_ASSERT_MESSAGE("Can't open store", opened);
+   
+   long numHits = store.getNumHits();
+   
+   RecordingTileConsumer consumer;
+   store.streamTiles(&consumer, 2);
+   
+   const int numTiles = store.getNumTilesX() * store.getNumTilesY();
+   
+   CPPUNIT_ASSERT_MESSAGE("Wrong number of tiles streamed", consumer.tiles.size() == numTiles);
+   CPPUNIT_ASSERT_MESSAGE("Wrong values streamed", consumer.numWrongValues == 0);
+   
+   for (int i = 0; i < numTiles; i++)
+      CPPUNIT_ASSERT_MESSAGE("Tiles not streamed in Z-order", consumer.tiles[i] == store.getTileInZOrder(i));
+   
+   // Every tile was prefetched before it was consumed
+   CPPUNIT_ASSERT_MESSAGE("Tiles not prefetched", store.getNumPrefetches() == numTiles  &&  store.getNumHits() - numHits == numTiles);
+}
@@ -0,0 +1,91 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OUT_OF_CORE_FRAME_STORE_TEST_H_
+#define OUT_OF_CORE_FRAME_STORE_TEST_H_
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace hdsim {
+   
+   class OutOfCoreFrameStoreTest : public CppUnit::TestFixture  {
+      CPPUNIT_TEST_SUITE(OutOfCoreFrameStoreTest);
+         CPPUNIT_TEST(testZOrder);
+         CPPUNIT_TEST(testWriteAndReopen);
+         CPPUNIT_TEST(testEvictionAndWriteBack);
+         CPPUNIT_TEST(testCalculateMatchesTiledEngine);
+         CPPUNIT_TEST(testStreamTiles);
+      CPPUNIT_TEST_SUITE_END();
+      
+   public:
+      
+      /**
+       * Constructor
+       */
+      OutOfCoreFrameStoreTest();
+      
+      /**
+       * Destructor
+       */
+      virtual ~OutOfCoreFrameStoreTest();
+      
+      /**
+       * Prepare test for running
+       */
+      void setUp();
+      
+      /**
+       * Cleanup after test
+       */
+      void tearDown();
+      
+      /**
+       * Test that every tile is stored exactly once, in Z-order
+       */
+      void testZOrder();
+      
+      /**
+       * Test that written tiles are read back after the store is reopened
+       */
+      void testWriteAndReopen();
+      
+      /**
+       * Test that tiles evicted from the cache are written back and mapped again when needed
+       */
+      void testEvictionAndWriteBack();
+      
+      /**
+       * Test that depth calculated into the store is the same as depth of the TiledDepthEngine
+       */
+      void testCalculateMatchesTiledEngine();
+      
+      /**
+       * Test that streaming passes every tile once, in Z-order, with prefetching
+       */
+      void testStreamTiles();
+      
+   private:
+      // define
+      OutOfCoreFrameStoreTest(const OutOfCoreFrameStoreTest &rhs);   
+      OutOfCoreFrameStoreTest & operator=(const OutOfCoreFrameStoreTest &rhs);   
+   };
+   
+}
+
+#endif
@@ -0,0 +1,171 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <cmath>
+#include <sstream>
+#include <vector>
+
+#include "GPUGeometryModel.h"
+#include "RayCastEngine.h"
+#include "SoftwareRasterizer.h"
+#include "TestGeometry.h"
+#include "RayCastEngineTest.h"
+
+using namespace hdsim;
+using namespace std;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(RayCastEngineTest);
+
+/**
+ * Board size used by the tests. Width is not multiple of four, so both packets and single rays are used
+ */
+static const int SIZE_X = 61;
+static const int SIZE_Y = 47;
+
+RayCastEngineTest::RayCastEngineTest()
+{
+   
+}
+
+RayCastEngineTest::~RayCastEngineTest()
+{
+   
+}
+
+void RayCastEngineTest::setUp()
+{
+   
+}
+
+void RayCastEngineTest::tearDown()
+{
+   
+}
+
+void RayCastEngineTest::testPointQueries()
+{
+   GPUGeometryModel model(SIZE_X, SIZE_Y);
+   model.setRenderedArea(-1, -1, -1, 1, 1, 1);
+   
+   // Quad covers the middle half of the board, in the middle of the rendered area
+   addQuad(&model, -0.5, 0.5, 0);
+   
+   RayCastEngine engine;
+   engine.update(model);
+   
+   CPPUNIT_ASSERT_MESSAGE("Wrong depth in the middle", areEqualInLowPrecision(engine.getAt(SIZE_X / 2, SIZE_Y / 2), 0.5));
+   CPPUNIT_ASSERT_MESSAGE("Wrong depth in the corner", engine.getAt(0, 0) == 1);
+   CPPUNIT_ASSERT_MESSAGE("Wrong depth at the edge", engine.getAt(SIZE_X - 1, SIZE_Y / 2) == 1);
+}
+
+void RayCastEngineTest::testMatchesRaster()
+{
+   GPUGeometryModel model(SIZE_X, SIZE_Y);
+   model.setRenderedArea(-1, -1, -1, 1, 1, 1);
+   addWavySurface(&model);
+   addQuad(&model, -0.3, 0.1, 0.6);
+   
+   RayCastEngine engine;
+   engine.update(model);
+   
+   vector<float> rayCast(SIZE_X * SIZE_Y);
+   engine.calculateBoard(&rayCast[0]);
+   
+   SceneGeometry scene;
+   scene.setFromModel(model);
+   
+   ProjectedGeometry projection;
+   projection.project(scene, getModelView(model));
+   
+   TileRange board = {0, SIZE_X, 0, SIZE_Y};
+   vector<float> raster(SIZE_X * SIZE_Y);
+   clearDepth(board, &raster[0], SIZE_X);
+   rasterizeDepth(projection, 0, 0, board, &raster[0], SIZE_X);
+   
+   for (int i = 0; i < SIZE_X * SIZE_Y; i++)
+   {
+      stringstream message;
+      message << "Error at the coordinates X = " << i % SIZE_X << " Y = " << i / SIZE_X << " got " << rayCast[i] << " instead of " << raster[i];
+      
+      CPPUNIT_ASSERT_MESSAGE(message.str().c_str(), fabs(rayCast[i] - raster[i]) < 1e-5);
+   }
+}
+
+void RayCastEngineTest::testBatchMatchesPointQueries()
+{
+   GPUGeometryModel model(SIZE_X, SIZE_Y);
+   model.setRenderedArea(-1, -1, -1, 1, 1, 1);
+   addWavySurface(&model);
+   addQuad(&model, -0.3, 0.1, 0.6);
+   
+   RayCastEngine engine;
+   engine.update(model);
+   
+   vector<MoxelProbe> probes;
+   for (int i = 0; i < 1001; i++)
+   {
+      MoxelProbe probe = {(i * 7) % SIZE_X, (i * 13) % SIZE_Y};
+      probes.push_back(probe);
+   }
+   
+   vector<float> values(probes.size());
+   engine.getValues(&probes[0], probes.size(), &values[0]);
+   
+   for (int i = 0; i < probes.size(); i++)
+      CPPUNIT_ASSERT_MESSAGE("Batch differs from the single query", values[i] == (float)engine.getAt(probes[i].x, probes[i].y));
+}
+
+void RayCastEngineTest::testClipping()
+{
+   GPUGeometryModel model(SIZE_X, SIZE_Y);
+   model.setRenderedArea(-1, -1, -1, 1, 1, 1);
+   
+   // Quad above the rendered area is clipped, so the lower one is seen. Quad below the rendered area is never seen
+   addQuad(&model, -2, 2, 1.5);
+   addQuad(&model, -2, 0, 0.5);
+   addQuad(&model, -2, 2, -1.5);
+   
+   RayCastEngine engine;
+   engine.update(model);
+   
+   CPPUNIT_ASSERT_MESSAGE("Wrong depth under the lower quad", areEqualInLowPrecision(engine.getAt(0, 0), 0.25));
+   CPPUNIT_ASSERT_MESSAGE("Clipped geometry seen", engine.getAt(SIZE_X - 1, SIZE_Y - 1) == 1);
+}
+
+void RayCastEngineTest::testRebuildOnlyOnChange()
+{
+   GPUGeometryModel model(SIZE_X, SIZE_Y);
+   model.setRenderedArea(-1, -1, -1, 1, 1, 1);
+   addWavySurface(&model);
+   addQuad(&model, -0.3, 0.1, 0.6);
+   
+   RayCastEngine engine;
+   engine.update(model);
+   CPPUNIT_ASSERT_MESSAGE("Hierarchy is empty", engine.getNumNodes() > 1);
+   
+   // Rendered area is not part of the hierarchy
+   model.setRenderedArea(-0.5, -0.5, -1, 0.5, 0.5, 1);
+   engine.update(model);
+   CPPUNIT_ASSERT_MESSAGE("Hierarchy built again for the same geometry", engine.getNumBuilds() == 1);
+   
+   model.replacePointAt(0, createPoint(-0.8, -0.8, 0.9));
+   engine.update(model);
+   CPPUNIT_ASSERT_MESSAGE("Hierarchy not built for the changed geometry", engine.getNumBuilds() == 2);
+}
@@ -0,0 +1,91 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RAY_CAST_ENGINE_TEST_H_
+#define RAY_CAST_ENGINE_TEST_H_
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace hdsim {
+   
+   class RayCastEngineTest : public CppUnit::TestFixture  {
+      CPPUNIT_TEST_SUITE(RayCastEngineTest);
+         CPPUNIT_TEST(testPointQueries);
+         CPPUNIT_TEST(testMatchesRaster);
+         CPPUNIT_TEST(testBatchMatchesPointQueries);
+         CPPUNIT_TEST(testClipping);
+         CPPUNIT_TEST(testRebuildOnlyOnChange);
+      CPPUNIT_TEST_SUITE_END();
+      
+   public:
+      
+      /**
+       * Constructor
+       */
+      RayCastEngineTest();
+      
+      /**
+       * Destructor
+       */
+      virtual ~RayCastEngineTest();
+      
+      /**
+       * Prepare test for running
+       */
+      void setUp();
+      
+      /**
+       * Cleanup after test
+       */
+      void tearDown();
+      
+      /**
+       * Test depth of the single moxels of the quad in the middle of the rendered area
+       */
+      void testPointQueries();
+      
+      /**
+       * Test that the whole board matches the software rasterizer
+       */
+      void testMatchesRaster();
+      
+      /**
+       * Test that batch of probes returns the same values as single queries
+       */
+      void testBatchMatchesPointQueries();
+      
+      /**
+       * Test that geometry outside of the rendered area in Z is clipped
+       */
+      void testClipping();
+      
+      /**
+       * Test that hierarchy is built again only when geometry changes
+       */
+      void testRebuildOnlyOnChange();
+      
+   private:
+      // define
+      RayCastEngineTest(const RayCastEngineTest &rhs);   
+      RayCastEngineTest & operator=(const RayCastEngineTest &rhs);   
+   };
+   
+}
+
+#endif
@@ -0,0 +1,242 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <cmath>
+#include <vector>
+
+#include "Frame.h"
+#include "GPUInterpolatedModel.h"
+#include "SparseFrame.h"
+#include "SparseFrameTest.h"
+#include "TestGeometry.h"
+
+using namespace hdsim;
+using namespace std;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SparseFrameTest);
+
+/**
+ * Board size used by the tests. Neither dimension is multiple of the tile size, so partial tiles are used
+ */
+static const int SIZE_X = 70;
+static const int SIZE_Y = 50;
+
+/**
+ * Tile size used by the tests
+ */
+static const int TILE_SIZE = 16;
+
+/**
+ * Make board at the background, with a bump in tile (1, 1) and constant value in tile (3, 2)
+ */
+static vector<float> makeBoard()
+{
+   vector<float> values(SIZE_X * SIZE_Y, 1.0f);
+   
+   for (int y = 16; y < 32; y++)
+      for (int x = 16; x < 32; x++)
+         values[y * SIZE_X + x] = 0.5f + 0.01f * ((x * 7 + y * 3) % 11);
+   
+   for (int y = 32; y < 48; y++)
+      for (int x = 48; x < 64; x++)
+         values[y * SIZE_X + x] = 0.25f;
+   
+   return values;
+}
+
+SparseFrameTest::SparseFrameTest()
+{
+   
+}
+
+SparseFrameTest::~SparseFrameTest()
+{
+   
+}
+
+void SparseFrameTest::setUp()
+{
+   
+}
+
+void SparseFrameTest::tearDown()
+{
+   
+}
+
+void SparseFrameTest::testOccupancy()
+{
+   vector<float> values = makeBoard();
+   
+   SparseFrame frame(TILE_SIZE);
+   frame.setFromValues(&values[0], SIZE_X, SIZE_Y, 0.5);
+   
+   CPPUNIT_ASSERT_MESSAGE("Wrong number of tiles", frame.getNumTilesX() == 5  &&  frame.getNumTilesY() == 4);
+   CPPUNIT_ASSERT_MESSAGE("Wrong occupied tiles", frame.getNumOccupiedTiles() == 2  &&  frame.isTileOccupied(1, 1)  &&  frame.isTileOccupied(3, 2)  &&  
+                                                  !frame.isTileOccupied(0, 0)  &&  !frame.isTileOccupied(4, 3));
+   CPPUNIT_ASSERT_MESSAGE("Constant tile not collapsed", frame.getNumStoredTiles() == 1  &&  !frame.getOccupiedTile(1).values);
+   
+   for (int y = 0; y < SIZE_Y; y++)
+      for (int x = 0; x < SIZE_X; x++)
+         CPPUNIT_ASSERT_MESSAGE("Wrong value", frame.getAt(x, y) == values[y * SIZE_X + x]);
+   
+   CPPUNIT_ASSERT_MESSAGE("Wrong timeslice", frame.getTimeSlice() == 0.5);
+   CPPUNIT_ASSERT_MESSAGE("Frame takes more memory than the dense one", frame.getMemoryUsage() < values.size() * sizeof(float));
+}
+
+void SparseFrameTest::testReadValues()
+{
+   vector<float> values = makeBoard();
+   
+   SparseFrame frame(TILE_SIZE);
+   frame.setFromValues(&values[0], SIZE_X, SIZE_Y);
+   
+   vector<float> read(SIZE_X * SIZE_Y, 0.0f);
+   frame.readValues(&read[0]);
+   
+   CPPUNIT_ASSERT_MESSAGE("Read values differ", read == values);
+}
+
+void SparseFrameTest::testDecimation()
+{
+   vector<float> values = makeBoard();
+   
+   SparseFrame frame(TILE_SIZE);
+   frame.setFromValues(&values[0], SIZE_X, SIZE_Y);
+   
+   FrameHandle dense = Frame::create(SIZE_X, SIZE_Y, 0);
+   copy(values.begin(), values.end(), dense->getMutableValues());
+   
+   // Sizes that don't divide the board, so edge pixels are larger
+   const int X_SIZE = 13, Y_SIZE = 9;
+   
+   double *expected = GPUInterpolatedModel::getDecimatedModelAdopt(dense.get(), X_SIZE, Y_SIZE);
+   double *decimated = GPUInterpolatedModel::getDecimatedModelAdopt(&frame, X_SIZE, Y_SIZE);
+   
+   for (int i = 0; i < X_SIZE * Y_SIZE; i++)
+      CPPUNIT_ASSERT_MESSAGE("Decimated value differs", fabs(decimated[i] - expected[i]) < 1e-9);
+   
+   delete [] expected;
+   delete [] decimated;
+}
+
+void SparseFrameTest::testChangedTiles()
+{
+   vector<float> values = makeBoard();
+   
+   SparseFrame previous(TILE_SIZE);
+   previous.setFromValues(&values[0], SIZE_X, SIZE_Y);
+   
+   // Change the constant tile, clear the bump and add moxel in the corner tile
+   for (int y = 32; y < 48; y++)
+      for (int x = 48; x < 64; x++)
+         values[y * SIZE_X + x] = 0.3f;
+   
+   for (int y = 16; y < 32; y++)
+      for (int x = 16; x < 32; x++)
+         values[y * SIZE_X + x] = 1.0f;
+   
+   values[SIZE_Y * SIZE_X - 1] = 0;
+   
+   SparseFrame frame(TILE_SIZE);
+   frame.setFromValues(&values[0], SIZE_X, SIZE_Y);
+   
+   vector<int> changed;
+   frame.getChangedTiles(previous, &changed);
+   
+   CPPUNIT_ASSERT_MESSAGE("Wrong number of changed tiles", changed.size() == 3);
+   CPPUNIT_ASSERT_MESSAGE("Wrong changed tiles", changed[0] == 1 * 5 + 1  &&  changed[1] == 2 * 5 + 3  &&  changed[2] == 3 * 5 + 4);
+   
+   frame.getChangedTiles(frame, &changed);
+   CPPUNIT_ASSERT_MESSAGE("Frame differs from itself", changed.empty());
+}
+
+void SparseFrameTest::testEncodeDecode()
+{
+   vector<float> values = makeBoard();
+   
+   SparseFrame frame(TILE_SIZE);
+   frame.setFromValues(&values[0], SIZE_X, SIZE_Y, 0.75);
+   
+   vector<char> encoded;
+   frame.encode(&encoded);
+   
+   CPPUNIT_ASSERT_MESSAGE("Encoded frame is larger than the dense one", encoded.size() < values.size() * sizeof(float));
+   
+   SparseFrame decoded;
+   CPPUNIT_ASSERT_MESSAGE("Frame not decoded", decoded.decode(&encoded[0], encoded.size()));
+   CPPUNIT_ASSERT_MESSAGE("Wrong frame decoded", decoded.getTileSize() == TILE_SIZE  &&  decoded.getTimeSlice() == 0.75  &&  
+                                                 decoded.getNumOccupiedTiles() == frame.getNumOccupiedTiles());
+   
+   vector<float> read(SIZE_X * SIZE_Y);
+   decoded.readValues(&read[0]);
+   CPPUNIT_ASSERT_MESSAGE("Decoded values differ", read == values);
+   
+   CPPUNIT_ASSERT_MESSAGE("Truncated frame decoded", !decoded.decode(&encoded[0], encoded.size() - 1));
+   CPPUNIT_ASSERT_MESSAGE("Frame changed by the failed decoding", decoded.getNumOccupiedTiles() == frame.getNumOccupiedTiles());
+}
+
+void SparseFrameTest::testModelSparseFrame()
+{
+   GPUInterpolatedModel model;
+   GPUGeometryModel *geometryModel = model.getGeometryModel();
+   
+   geometryModel->setSizeX(SIZE_X);
+   geometryModel->setSizeY(SIZE_Y);
+   geometryModel->setRenderedArea(-1, -1, -1, 1, 1, 1);
+   addQuad(geometryModel, -0.3, 0.3, 0.5);
+   
+   // Lazy board is stored only once every tile is valid
+   geometryModel->setLazyTileEvaluation(true);
+   geometryModel->setSparseFrames(true);
+   
+   model.forceModelCalculation();
+   CPPUNIT_ASSERT_MESSAGE("Incomplete board stored", !model.getSparseFrame());
+   
+   TileRange board = {0, SIZE_X, 0, SIZE_Y};
+   geometryModel->calculateRegion(board);
+   
+   // Decimated board is calculated from the stored frame
+   model.setOptimizeDrawing(true);
+   model.setMoxelThreshold(SIZE_X * SIZE_Y / 16);
+   model.forceModelCalculation();
+   
+   const SparseFrame *frame = model.getSparseFrame();
+   
+   CPPUNIT_ASSERT_MESSAGE("Board not stored", frame);
+   CPPUNIT_ASSERT_MESSAGE("Background stored", frame->getNumOccupiedTiles() < frame->getNumTilesX() * frame->getNumTilesY());
+   
+   for (int y = 0; y < SIZE_Y; y++)
+      for (int x = 0; x < SIZE_X; x++)
+         CPPUNIT_ASSERT_MESSAGE("Wrong stored value", frame->getAt(x, y) == geometryModel->getAt(x, y));
+   
+   CPPUNIT_ASSERT_MESSAGE("Drawing not optimized", model.isDrawingOptimizationActive());
+   double *expected = GPUInterpolatedModel::getDecimatedModelAdopt(geometryModel, model.getSizeX(), model.getSizeY());
+   
+   for (int y = 0; y < model.getSizeY(); y++)
+      for (int x = 0; x < model.getSizeX(); x++)
+         CPPUNIT_ASSERT_MESSAGE("Wrong decimated value", fabs(model.getAt(x, y) - expected[y * model.getSizeX() + x]) < 1e-9);
+   
+   delete [] expected;
+   
+   geometryModel->setSparseFrames(false);
+   model.forceModelCalculation();
+   CPPUNIT_ASSERT_MESSAGE("Board stored without sparse frames", !model.getSparseFrame());
+}
@@ -0,0 +1,97 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPARSE_FRAME_TEST_H_
+#define SPARSE_FRAME_TEST_H_
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace hdsim {
+   
+   class SparseFrameTest : public CppUnit::TestFixture  {
+      CPPUNIT_TEST_SUITE(SparseFrameTest);
+         CPPUNIT_TEST(testOccupancy);
+         CPPUNIT_TEST(testReadValues);
+         CPPUNIT_TEST(testDecimation);
+         CPPUNIT_TEST(testChangedTiles);
+         CPPUNIT_TEST(testEncodeDecode);
+         CPPUNIT_TEST(testModelSparseFrame);
+      CPPUNIT_TEST_SUITE_END();
+      
+   public:
+      
+      /**
+       * Constructor
+       */
+      SparseFrameTest();
+      
+      /**
+       * Destructor
+       */
+      virtual ~SparseFrameTest();
+      
+      /**
+       * Prepare test for running
+       */
+      void setUp();
+      
+      /**
+       * Cleanup after test
+       */
+      void tearDown();
+      
+      /**
+       * Test that only tiles off the background are stored, and constant tiles are collapsed
+       */
+      void testOccupancy();
+      
+      /**
+       * Test reading of all values
+       */
+      void testReadValues();
+      
+      /**
+       * Test that decimation matches decimation of the dense frame
+       */
+      void testDecimation();
+      
+      /**
+       * Test finding of the changed tiles
+       */
+      void testChangedTiles();
+      
+      /**
+       * Test that decoded frame is the same as encoded one
+       */
+      void testEncodeDecode();
+      
+      /**
+       * Test that model stores calculated board as the sparse frame, and decimates it
+       */
+      void testModelSparseFrame();
+      
+   private:
+      // define
+      SparseFrameTest(const SparseFrameTest &rhs);   
+      SparseFrameTest & operator=(const SparseFrameTest &rhs);   
+   };
+   
+}
+
+#endif
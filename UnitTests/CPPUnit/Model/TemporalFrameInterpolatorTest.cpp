@@ -0,0 +1,151 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <cmath>
+
+#include "TemporalFrameInterpolator.h"
+#include "GPUInterpolatedModel.h"
+#include "MathHelper.h"
+#include "TemporalFrameInterpolatorTest.h"
+
+using namespace hdsim;
+using namespace std;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TemporalFrameInterpolatorTest);
+
+TemporalFrameInterpolatorTest::TemporalFrameInterpolatorTest()
+{
+   
+}
+
+TemporalFrameInterpolatorTest::~TemporalFrameInterpolatorTest()
+{
+   
+}
+
+void TemporalFrameInterpolatorTest::setUp()
+{
+   
+}
+
+void TemporalFrameInterpolatorTest::tearDown()
+{
+   
+}
+
+void TemporalFrameInterpolatorTest::testLinearInterpolation()
+{
+   const int NUM_VALUES = 37;
+   float first[NUM_VALUES], second[NUM_VALUES], values[NUM_VALUES];
+   
+   for (int i = 0; i < NUM_VALUES; i++)
+   {
+      first[i] = i / (float)NUM_VALUES;
+      second[i] = 1 - first[i];
+   }
+   
+   TemporalFrameInterpolator::interpolateLinear(first, second, 0.25f, NUM_VALUES, values);
+   
+   for (int i = 0; i < NUM_VALUES; i++)
+      CPPUNIT_ASSERT_MESSAGE("Wrong interpolated value", fabs(values[i] - (0.75 * first[i] + 0.25 * second[i])) < 1e-6);
+}
+
+void TemporalFrameInterpolatorTest::testCubicInterpolation()
+{
+   const int NUM_VALUES = 3;
+   
+   // Key frames are not uniformly spaced, as they are with easing
+   const double positions[4] = {0.1, 0.25, 0.3, 0.6};
+   float frames[4][NUM_VALUES], values[NUM_VALUES], weights[4];
+   
+   // Moxels moving linearly in the position, and one that steps between the first and the second key frame
+   for (int i = 0; i < 4; i++)
+   {
+      frames[i][0] = 0.2 + positions[i];
+      frames[i][1] = 0.9 - 0.5 * positions[i];
+      frames[i][2] = i < 2 ? 0.2 : 0.8;
+   }
+   
+   TemporalFrameInterpolator::getCubicWeights(positions[0], positions[1], positions[2], positions[3], 0.28, weights);
+   TemporalFrameInterpolator::interpolateCubic(frames[0], frames[1], frames[2], frames[3], weights, NUM_VALUES, values);
+   
+   CPPUNIT_ASSERT_MESSAGE("Weights don't sum to 1", fabs(weights[0] + weights[1] + weights[2] + weights[3] - 1) < 1e-6);
+   CPPUNIT_ASSERT_MESSAGE("Linear motion not reproduced", fabs(values[0] - (0.2 + 0.28)) < 1e-5);
+   CPPUNIT_ASSERT_MESSAGE("Linear motion not reproduced", fabs(values[1] - (0.9 - 0.5 * 0.28)) < 1e-5);
+   CPPUNIT_ASSERT_MESSAGE("Step overshoots", values[2] >= 0.2  &&  values[2] <= 0.8);
+   
+   // Unknown neighbouring key frames are the same as the first and the second one
+   TemporalFrameInterpolator::getCubicWeights(0, 0, 1, 1, 0.5, weights);
+   TemporalFrameInterpolator::interpolateCubic(frames[1], frames[1], frames[2], frames[2], weights, NUM_VALUES, values);
+   
+   CPPUNIT_ASSERT_MESSAGE("Wrong value without neighbours", fabs(values[0] - 0.5 * (frames[1][0] + frames[2][0])) < 1e-5);
+}
+
+void TemporalFrameInterpolatorTest::testFramesFollowAnimation()
+{
+   GPUInterpolatedModel model;
+   CPPUNIT_ASSERT_MESSAGE("Reading from file failed", model.readFromFile("singleQuad.GPUHoloSim"));
+   
+   TemporalFrameInterpolator interpolator(model, 4);
+   interpolator.setAnimation(0.05, true);
+   interpolator.seek(0);
+   
+   FrameHandle frames[10];
+   
+   for (int i = 0; i < 10; i++)
+   {
+      frames[i] = interpolator.popFrame();
+      CPPUNIT_ASSERT_MESSAGE("Frame not produced", frames[i].isValid());
+      CPPUNIT_ASSERT_MESSAGE("Frame out of order", areEqual(frames[i]->getTimeSlice(), (i + 1) * 0.05));
+   }
+   
+   // Frames 4 and 8 are key frames, and key frames at 0, 0.2, 0.4 and 0.6 were calculated
+   CPPUNIT_ASSERT_MESSAGE("Wrong number of key frames", interpolator.getNumKeyFrames() == 2);
+   CPPUNIT_ASSERT_MESSAGE("Wrong number of interpolated frames", interpolator.getNumInterpolatedFrames() == 8);
+   CPPUNIT_ASSERT_MESSAGE("Wrong number of calculated frames", interpolator.getKeyFramePrefetcher().getNumHits() + 
+                          interpolator.getKeyFramePrefetcher().getNumMisses() == 4);
+   CPPUNIT_ASSERT_MESSAGE("Frames not published", interpolator.getFramePublisher()->getVersion() == 10);
+   
+   // Shader doesn't move anything, so interpolated frames are the same as the key frames
+   for (int y = 0; y < model.getSizeY(); y++)
+      for (int x = 0; x < model.getSizeX(); x++)
+         CPPUNIT_ASSERT_MESSAGE("Interpolated frame is wrong", fabs(frames[0]->getAt(x, y) - frames[3]->getAt(x, y)) < 1e-6);
+}
+
+void TemporalFrameInterpolatorTest::testSkipFrames()
+{
+   GPUInterpolatedModel model;
+   CPPUNIT_ASSERT_MESSAGE("Reading from file failed", model.readFromFile("singleQuad.GPUHoloSim"));
+   
+   TemporalFrameInterpolator interpolator(model, 4, TEMPORAL_INTERPOLATION_CUBIC);
+   interpolator.setAnimation(0.05, true);
+   interpolator.seek(0);
+   interpolator.popFrame();
+   
+   // Over the key frame at 0.2, to the frame after the key frame at 0.4
+   interpolator.skipFrames(8);
+   CPPUNIT_ASSERT_MESSAGE("Frame after skip is wrong", areEqual(interpolator.popFrame()->getTimeSlice(), 0.5));
+   
+   for (int i = 0; i < 2; i++)
+      interpolator.popFrame();
+   
+   CPPUNIT_ASSERT_MESSAGE("Key frames out of sync after skip", interpolator.getNumKeyFrames() == 1);
+   CPPUNIT_ASSERT_MESSAGE("Key frame is wrong", areEqual(interpolator.getFramePublisher()->getLatestFrame()->getTimeSlice(), 0.6));
+}
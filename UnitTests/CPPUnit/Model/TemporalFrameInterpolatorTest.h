@@ -0,0 +1,85 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPORAL_FRAME_INTERPOLATOR_TEST_H_
+#define TEMPORAL_FRAME_INTERPOLATOR_TEST_H_
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace hdsim {
+   
+   class TemporalFrameInterpolatorTest : public CppUnit::TestFixture  {
+      CPPUNIT_TEST_SUITE(TemporalFrameInterpolatorTest);
+         CPPUNIT_TEST(testLinearInterpolation);
+         CPPUNIT_TEST(testCubicInterpolation);
+         CPPUNIT_TEST(testFramesFollowAnimation);
+         CPPUNIT_TEST(testSkipFrames);
+      CPPUNIT_TEST_SUITE_END();
+      
+   public:
+      
+      /**
+       * Constructor
+       */
+      TemporalFrameInterpolatorTest();
+      
+      /**
+       * Destructor
+       */
+      virtual ~TemporalFrameInterpolatorTest();
+      
+      /**
+       * Prepare test for running
+       */
+      void setUp();
+      
+      /**
+       * Cleanup after test
+       */
+      void tearDown();
+      
+      /**
+       * Test that linear interpolation is between the two frames
+       */
+      void testLinearInterpolation();
+      
+      /**
+       * Test that cubic interpolation reproduces motion linear in the position, and doesn't overshoot at the steps
+       */
+      void testCubicInterpolation();
+      
+      /**
+       * Test that produced frames follow the animation, and that only key frames are calculated
+       */
+      void testFramesFollowAnimation();
+      
+      /**
+       * Test that skipping frames keeps the animation in sync with the key frames
+       */
+      void testSkipFrames();
+      
+   private:
+      // define
+      TemporalFrameInterpolatorTest(const TemporalFrameInterpolatorTest &rhs);   
+      TemporalFrameInterpolatorTest & operator=(const TemporalFrameInterpolatorTest &rhs);   
+   };
+   
+}
+
+#endif
@@ -0,0 +1,55 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+
+#include "TestGeometry.h"
+
+using namespace hdsim;
+using namespace std;
+
+void hdsim::addQuad(GPUGeometryModel *model, double minXY, double maxXY, double z)
+{
+   int first = model->getNumPoints();
+   
+   model->addPoint(createPoint(minXY, minXY, z));
+   model->addPoint(createPoint(minXY, maxXY, z));
+   model->addPoint(createPoint(maxXY, minXY, z));
+   model->addPoint(createPoint(maxXY, maxXY, z));
+   
+   model->addTriangle(createTriangle(first, first + 1, first + 3));
+   model->addTriangle(createTriangle(first, first + 2, first + 3));
+}
+
+void hdsim::addWavySurface(GPUGeometryModel *model)
+{
+   const int GRID = 20;
+   
+   for (int y = 0; y <= GRID; y++)
+      for (int x = 0; x <= GRID; x++)
+         model->addPoint(createPoint(-0.8 + 1.6 * x / GRID, -0.8 + 1.6 * y / GRID, 0.4 * sin(x * 0.7) * cos(y * 0.4)));
+   
+   for (int y = 0; y < GRID; y++)
+      for (int x = 0; x < GRID; x++)
+      {
+         int corner = y * (GRID + 1) + x;
+         
+         model->addTriangle(createTriangle(corner, corner + 1, corner + GRID + 2));
+         model->addTriangle(createTriangle(corner, corner + GRID + 2, corner + GRID + 1));
+      }
+}
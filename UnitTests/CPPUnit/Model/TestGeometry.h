@@ -0,0 +1,45 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEST_GEOMETRY_H_
+#define TEST_GEOMETRY_H_
+
+#include "GPUGeometryModel.h"
+
+namespace hdsim {
+   
+   /**
+    * Add quad at the given height, covering [minXY, maxXY] in both X and Y
+    *
+    * @param model Model to add to
+    * @param minXY Min X and Y of the quad
+    * @param maxXY Max X and Y of the quad
+    * @param z Height of the quad
+    */
+   void addQuad(GPUGeometryModel *model, double minXY, double maxXY, double z);
+   
+   /**
+    * Add wavy height field over [-0.8, 0.8] in X and Y
+    *
+    * @param model Model to add to
+    */
+   void addWavySurface(GPUGeometryModel *model);
+   
+}
+
+#endif
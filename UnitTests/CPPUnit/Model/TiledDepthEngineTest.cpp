@@ -0,0 +1,528 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <vector>
+
+#include "GPUGeometryModel.h"
+#include "GPUInterpolatedModel.h"
+#include "FramePublisher.h"
+#include "SoftwareRasterizer.h"
+#include "ThreadPool.h"
+#include "TiledDepthEngine.h"
+#include "TestGeometry.h"
+#include "TiledDepthEngineTest.h"
+
+using namespace hdsim;
+using namespace std;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TiledDepthEngineTest);
+
+/**
+ * Board size used by the tests. Neither dimension is multiple of the tile size, so partial tiles are used
+ */
+static const int SIZE_X = 61;
+static const int SIZE_Y = 47;
+
+/**
+ * Tile size used by the tests
+ */
+static const int TILE_SIZE = 16;
+
+/**
+ * Rasterize whole board of the model at once. Depth is stepped along the span in float, so tiles may differ from it in the last bits
+ */
+static vector<float> rasterizeBoard(const GPUGeometryModel &model)
+{
+   SceneGeometry scene;
+   scene.setFromModel(model);
+   
+   ProjectedGeometry projection;
+   projection.project(scene, getModelView(model));
+   
+   TileRange board = {0, model.getSizeX(), 0, model.getSizeY()};
+   vector<float> raster(model.getSizeX() * model.getSizeY());
+   clearDepth(board, &raster[0], model.getSizeX());
+   rasterizeDepth(projection, 0, 0, board, &raster[0], model.getSizeX());
+   
+   return raster;
+}
+
+TiledDepthEngineTest::TiledDepthEngineTest()
+{
+   
+}
+
+TiledDepthEngineTest::~TiledDepthEngineTest()
+{
+   
+}
+
+void TiledDepthEngineTest::setUp()
+{
+   
+}
+
+void TiledDepthEngineTest::tearDown()
+{
+   
+}
+
+void TiledDepthEngineTest::testOnlyTouchedTilesCalculated()
+{
+   GPUGeometryModel model(SIZE_X, SIZE_Y);
+   model.setRenderedArea(-1, -1, -1, 1, 1, 1);
+   addWavySurface(&model);
+   
+   TiledDepthEngine engine(TILE_SIZE);
+   engine.update(model);
+   
+   CPPUNIT_ASSERT_MESSAGE("Wrong number of tiles", engine.getNumTilesX() == 4  &&  engine.getNumTilesY() == 3);
+   CPPUNIT_ASSERT_MESSAGE("Tiles calculated before any read", engine.getNumValidTiles() == 0);
+   
+   engine.getAt(SIZE_X - 1, SIZE_Y - 1);
+   engine.getAt(SIZE_X - 2, SIZE_Y - 3);
+   
+   CPPUNIT_ASSERT_MESSAGE("Wrong tile calculated", engine.isTileValid(3, 2)  &&  engine.getNumValidTiles() == 1);
+   CPPUNIT_ASSERT_MESSAGE("Tile calculated more than once", engine.getNumTileCalculations() == 1);
+}
+
+void TiledDepthEngineTest::testMatchesFullBoard()
+{
+   GPUGeometryModel model(SIZE_X, SIZE_Y);
+   model.setRenderedArea(-1, -1, -1, 1, 1, 1);
+   addWavySurface(&model);
+   
+   TiledDepthEngine engine(TILE_SIZE);
+   engine.update(model);
+   
+   vector<float> tiled(SIZE_X * SIZE_Y);
+   engine.readValues(&tiled[0]);
+   
+   vector<float> raster = rasterizeBoard(model);
+   
+   for (int i = 0; i < SIZE_X * SIZE_Y; i++)
+   {
+      stringstream message;
+      message << "Error at the coordinates X = " << i % SIZE_X << " Y = " << i / SIZE_X << " got " << tiled[i] << " instead of " << raster[i];
+      
+      CPPUNIT_ASSERT_MESSAGE(message.str().c_str(), fabs(tiled[i] - raster[i]) < 1e-5);
+   }
+   
+   CPPUNIT_ASSERT_MESSAGE("Not all tiles calculated", engine.getNumValidTiles() == engine.getNumTilesX() * engine.getNumTilesY());
+}
+
+void TiledDepthEngineTest::testRegionRead()
+{
+   GPUGeometryModel model(SIZE_X, SIZE_Y);
+   model.setRenderedArea(-1, -1, -1, 1, 1, 1);
+   addWavySurface(&model);
+   
+   TiledDepthEngine engine(TILE_SIZE);
+   engine.update(model);
+   
+   // Region crosses the tile boundaries in both directions
+   TileRange region = {10, 37, 5, 20};
+   int width = region.endX - region.beginX;
+   
+   vector<float> values(width * (region.endY - region.beginY));
+   engine.readRegion(region, &values[0]);
+   
+   CPPUNIT_ASSERT_MESSAGE("Wrong number of tiles calculated", engine.getNumValidTiles() == 6);
+   
+   vector<float> raster = rasterizeBoard(model);
+   
+   for (int y = region.beginY; y < region.endY; y++)
+      for (int x = region.beginX; x < region.endX; x++)
+         CPPUNIT_ASSERT_MESSAGE("Wrong value in the region", fabs(values[(y - region.beginY) * width + x - region.beginX] - raster[y * SIZE_X + x]) < 1e-5);
+}
+
+void TiledDepthEngineTest::testInvalidatedOnChange()
+{
+   GPUGeometryModel model(SIZE_X, SIZE_Y);
+   model.setRenderedArea(-1, -1, -1, 1, 1, 1);
+   addWavySurface(&model);
+   
+   TiledDepthEngine engine(TILE_SIZE);
+   engine.update(model);
+   
+   vector<float> values(SIZE_X * SIZE_Y);
+   engine.readValues(&values[0]);
+   
+   TileRange region = {20, 40, 20, 40};
+   engine.invalidateRegion(region);
+   CPPUNIT_ASSERT_MESSAGE("Wrong tiles invalidated", !engine.isTileValid(1, 1)  &&  !engine.isTileValid(2, 2)  &&  engine.isTileValid(0, 0)  &&  
+                                                     engine.getNumValidTiles() == 8);
+   
+   model.replacePointAt(0, createPoint(-0.8, -0.8, 0.9));
+   engine.update(model);
+   CPPUNIT_ASSERT_MESSAGE("Tiles valid after the change", engine.getNumValidTiles() == 0);
+   CPPUNIT_ASSERT_MESSAGE("Geometry not uploaded", engine.getNumGeometryUploads() == 2);
+   
+   vector<float> raster = rasterizeBoard(model);
+   CPPUNIT_ASSERT_MESSAGE("Wrong value after the change", fabs(engine.getAt(0, 0) - raster[0]) < 1e-5);
+}
+
+void TiledDepthEngineTest::testModelLazyEvaluation()
+{
+   GPUGeometryModel model(SIZE_X, SIZE_Y);
+   model.setRenderedArea(-1, -1, -1, 1, 1, 1);
+   addWavySurface(&model);
+   
+   model.setLazyTileEvaluation(true);
+   const TiledDepthEngine *engine = model.getTiledDepthEngine();
+   
+   vector<float> raster = rasterizeBoard(model);
+   CPPUNIT_ASSERT_MESSAGE("Wrong value", fabs(model.getAt(SIZE_X / 2, SIZE_Y / 2) - raster[SIZE_Y / 2 * SIZE_X + SIZE_X / 2]) < 1e-5);
+   CPPUNIT_ASSERT_MESSAGE("Whole board calculated for single value", engine->getNumValidTiles() == 1);
+   
+   TileRange region = {0, 8, 0, 8};
+   vector<float> values(8 * 8);
+   model.readRegion(region, &values[0]);
+   CPPUNIT_ASSERT_MESSAGE("Wrong value in the region", fabs(values[7 * 8 + 7] - raster[7 * SIZE_X + 7]) < 1e-5);
+   
+   model.setRenderedArea(-0.5, -0.5, -1, 0.5, 0.5, 1);
+   raster = rasterizeBoard(model);
+   CPPUNIT_ASSERT_MESSAGE("Wrong value after the change", fabs(model.getAt(0, 0) - raster[0]) < 1e-5);
+   CPPUNIT_ASSERT_MESSAGE("Geometry uploaded again", engine->getNumGeometryUploads() == 1);
+   
+   GPUGeometryModel copy(model);
+   CPPUNIT_ASSERT_MESSAGE("Lazy evaluation not copied", copy.getLazyTileEvaluation());
+   
+   // Tiles are calculated on the CPU, which doesn't run the shader
+   copy.setPathToShaderSource("SlowInSlowOut.fs");
+   CPPUNIT_ASSERT_MESSAGE("Lazy evaluation used with the shader", !copy.setLazyTileEvaluation(true));
+   CPPUNIT_ASSERT_MESSAGE("Disabling lazy evaluation failed", copy.setLazyTileEvaluation(false));
+}
+
+void TiledDepthEngineTest::testLazyModelDecimation()
+{
+   GPUGeometryModel model(SIZE_X, SIZE_Y);
+   model.setRenderedArea(-1, -1, -1, 1, 1, 1);
+   addWavySurface(&model);
+   
+   model.setLazyTileEvaluation(true);
+   const TiledDepthEngine *engine = model.getTiledDepthEngine();
+   
+   // Decimated moxel (0, 0) covers 3 x 3 moxels of the board
+   double *decimated = GPUInterpolatedModel::getDecimatedModelAdopt(&model, 20, 15);
+   
+   CPPUNIT_ASSERT_MESSAGE("Not all tiles calculated before decimation", engine->getNumValidTiles() == engine->getNumTilesX() * engine->getNumTilesY());
+   CPPUNIT_ASSERT_MESSAGE("Tile calculated more than once", engine->getNumTileCalculations() == engine->getNumValidTiles());
+   
+   vector<float> raster = rasterizeBoard(model);
+   double sum = 0;
+   
+   for (int y = 0; y < 3; y++)
+      for (int x = 0; x < 3; x++)
+         sum += raster[y * SIZE_X + x];
+   
+   CPPUNIT_ASSERT_MESSAGE("Wrong decimated value", fabs(decimated[0] - sum / 9) < 1e-5);
+   
+   delete [] decimated;
+}
+
+void TiledDepthEngineTest::testLazyModelPublishing()
+{
+   // Board has to span several of the model's tiles
+   const int sizeX = 3 * TiledDepthEngine::DEFAULT_TILE_SIZE, sizeY = 2 * TiledDepthEngine::DEFAULT_TILE_SIZE;
+   
+   GPUGeometryModel model(sizeX, sizeY);
+   model.setRenderedArea(-1, -1, -1, 1, 1, 1);
+   addWavySurface(&model);
+   
+   FramePublisher publisher;
+   model.setFramePublisher(&publisher);
+   model.setLazyTileEvaluation(true);
+   
+   const TiledDepthEngine *engine = model.getTiledDepthEngine();
+   
+   model.getAt(0, 0);
+   CPPUNIT_ASSERT_MESSAGE("Whole board calculated for publishing", engine->getNumValidTiles() == 1);
+   CPPUNIT_ASSERT_MESSAGE("Incomplete board published", !publisher.getLatestFrame().isValid());
+   
+   // Once every tile is valid, calculation is published without calculating any tile again
+   const int numTiles = engine->getNumTilesX() * engine->getNumTilesY();
+   TileRange board = {0, sizeX, 0, sizeY};
+   
+   model.calculateRegion(board);
+   model.forceModelCalculation();
+   
+   CPPUNIT_ASSERT_MESSAGE("Tiles calculated again", engine->getNumTileCalculations() == numTiles);
+   CPPUNIT_ASSERT_MESSAGE("Complete board not published", publisher.getLatestFrame().isValid());
+   CPPUNIT_ASSERT_MESSAGE("Wrong published value", publisher.getLatestFrame()->getAt(sizeX - 1, sizeY - 1) == model.getAt(sizeX - 1, sizeY - 1));
+}
+
+void TiledDepthEngineTest::testIncrementalEdits()
+{
+   GPUGeometryModel model(SIZE_X, SIZE_Y);
+   model.setRenderedArea(-1, -1, -1, 1, 1, 1);
+   addWavySurface(&model);
+   
+   TiledDepthEngine engine(TILE_SIZE);
+   engine.update(model);
+   
+   vector<float> values(SIZE_X * SIZE_Y);
+   engine.readValues(&values[0]);
+   
+   // Lift the corner point, and move triangle from the opposite corner next to it
+   vector<int> editedPoints, editedTriangles;
+   
+   model.replacePointAt(0, createPoint(-0.8, -0.8, 0.9));
+   editedPoints.push_back(0);
+   
+   model.replaceTriangleAt(model.getNumTriangles() - 1, createTriangle(0, 1, 22));
+   editedTriangles.push_back(model.getNumTriangles() - 1);
+   
+   engine.updateEdits(model, editedPoints, editedTriangles);
+   
+   CPPUNIT_ASSERT_MESSAGE("Geometry copied again", engine.getNumGeometryUploads() == 1  &&  engine.getNumIncrementalUpdates() == 1);
+   CPPUNIT_ASSERT_MESSAGE("Unaffected tile invalidated", engine.isTileValid(3, 0)  &&  engine.isTileValid(0, 2)  &&  engine.isTileValid(1, 1));
+   CPPUNIT_ASSERT_MESSAGE("Affected tile not invalidated", !engine.isTileValid(0, 0)  &&  !engine.isTileValid(3, 2));
+   
+   engine.readValues(&values[0]);
+   vector<float> raster = rasterizeBoard(model);
+   
+   for (int i = 0; i < SIZE_X * SIZE_Y; i++)
+   {
+      stringstream message;
+      message << "Error at the coordinates X = " << i % SIZE_X << " Y = " << i / SIZE_X << " got " << values[i] << " instead of " << raster[i];
+      
+      CPPUNIT_ASSERT_MESSAGE(message.str().c_str(), fabs(values[i] - raster[i]) < 1e-5);
+   }
+}
+
+void TiledDepthEngineTest::testModelIncrementalEdits()
+{
+   GPUGeometryModel model(SIZE_X, SIZE_Y);
+   model.setRenderedArea(-1, -1, -1, 1, 1, 1);
+   addWavySurface(&model);
+   model.setLazyTileEvaluation(true);
+   
+   const TiledDepthEngine *engine = model.getTiledDepthEngine();
+   
+   TileRange board = {0, SIZE_X, 0, SIZE_Y};
+   vector<float> values(SIZE_X * SIZE_Y);
+   model.readRegion(board, &values[0]);
+   
+   int numTiles = engine->getNumTilesX() * engine->getNumTilesY();
+   CPPUNIT_ASSERT_MESSAGE("Not all tiles calculated", engine->getNumTileCalculations() == numTiles);
+   
+   model.replacePointAt(0, createPoint(-0.8, -0.8, 0.9));
+   model.readRegion(board, &values[0]);
+   
+   CPPUNIT_ASSERT_MESSAGE("Edit not applied incrementally", engine->getNumIncrementalUpdates() == 1  &&  engine->getNumGeometryUploads() == 1);
+   CPPUNIT_ASSERT_MESSAGE("Too many tiles calculated", engine->getNumTileCalculations() == numTiles + 1);
+   
+   vector<float> raster = rasterizeBoard(model);
+   for (int i = 0; i < SIZE_X * SIZE_Y; i++)
+      CPPUNIT_ASSERT_MESSAGE("Wrong value after the edit", fabs(values[i] - raster[i]) < 1e-5);
+   
+   // Change of the rendered area calculates the whole board again
+   model.setRenderedArea(-0.5, -0.5, -1, 0.5, 0.5, 1);
+   model.replacePointAt(1, createPoint(-0.72, -0.8, 0.9));
+   model.readRegion(board, &values[0]);
+   
+   CPPUNIT_ASSERT_MESSAGE("Edit applied incrementally after the change of view", engine->getNumIncrementalUpdates() == 1);
+   CPPUNIT_ASSERT_MESSAGE("Whole board not calculated", engine->getNumTileCalculations() == 2 * numTiles + 1);
+}
+
+void TiledDepthEngineTest::testPanByWholeMoxels()
+{
+   GPUGeometryModel model(SIZE_X, SIZE_Y);
+   model.setRenderedArea(-1, -1, -1, 1, 1, 1);
+   addWavySurface(&model);
+   
+   TiledDepthEngine engine(TILE_SIZE);
+   engine.update(model);
+   
+   vector<float> values(SIZE_X * SIZE_Y);
+   engine.readValues(&values[0]);
+   
+   int numTiles = engine.getNumTilesX() * engine.getNumTilesY();
+   
+   // Move by 5 moxels right and 3 down, and then back
+   double moxelX = 2.0 / SIZE_X, moxelY = 2.0 / SIZE_Y;
+   
+   for (int i = 0; i < 2; i++)
+   {
+      int shiftX = i ? 0 : 5, shiftY = i ? 0 : -3;
+      
+      model.setRenderedArea(-1 + shiftX * moxelX, -1 + shiftY * moxelY, -1, 1 + shiftX * moxelX, 1 + shiftY * moxelY, 1);
+      engine.update(model);
+      engine.readValues(&values[0]);
+      
+      vector<float> raster = rasterizeBoard(model);
+      for (int j = 0; j < SIZE_X * SIZE_Y; j++)
+      {
+         stringstream message;
+         message << "Error at the coordinates X = " << j % SIZE_X << " Y = " << j / SIZE_X << " got " << values[j] << " instead of " << raster[j];
+         
+         CPPUNIT_ASSERT_MESSAGE(message.str().c_str(), fabs(values[j] - raster[j]) < 1e-5);
+      }
+   }
+   
+   CPPUNIT_ASSERT_MESSAGE("Values not shifted", engine.getNumShifts() == 2  &&  engine.getNumGeometryUploads() == 1);
+   
+   // Both shifts keep 3 of 4 tiles in X and 2 of 3 in Y
+   CPPUNIT_ASSERT_MESSAGE("Wrong number of tiles calculated", engine.getNumTileCalculations() == numTiles + 2 * (numTiles - 6));
+}
+
+void TiledDepthEngineTest::testPanByPartOfMoxel()
+{
+   GPUGeometryModel model(SIZE_X, SIZE_Y);
+   model.setRenderedArea(-1, -1, -1, 1, 1, 1);
+   addWavySurface(&model);
+   
+   TiledDepthEngine engine(TILE_SIZE);
+   engine.update(model);
+   
+   vector<float> values(SIZE_X * SIZE_Y);
+   engine.readValues(&values[0]);
+   
+   model.setRenderedArea(-1 + 0.5 / SIZE_X, -1, -1, 1 + 0.5 / SIZE_X, 1, 1);
+   engine.update(model);
+   
+   CPPUNIT_ASSERT_MESSAGE("Tiles kept after the move by part of the moxel", engine.getNumValidTiles() == 0  &&  engine.getNumShifts() == 0);
+}
+
+void TiledDepthEngineTest::testTileTriangleCounts()
+{
+   GPUGeometryModel model(SIZE_X, SIZE_Y);
+   model.setRenderedArea(-1, -1, -1, 1, 1, 1);
+   addWavySurface(&model);
+   
+   TiledDepthEngine engine(TILE_SIZE);
+   engine.update(model);
+   
+   SceneGeometry scene;
+   scene.setFromModel(model);
+   
+   ProjectedGeometry projection;
+   projection.project(scene, getModelView(model));
+   
+   for (int tileY = 0; tileY < engine.getNumTilesY(); tileY++)
+      for (int tileX = 0; tileX < engine.getNumTilesX(); tileX++)
+      {
+         TileRange tile = {tileX * TILE_SIZE, min((tileX + 1) * TILE_SIZE, SIZE_X), tileY * TILE_SIZE, min((tileY + 1) * TILE_SIZE, SIZE_Y)};
+         int count = 0;
+         
+         for (int i = 0; i < projection.getNumTriangles(); i++)
+         {
+            TileRange bounds;
+            projection.getTriangleBounds(i, &bounds);
+            
+            if (bounds.beginX < tile.endX  &&  bounds.endX > tile.beginX  &&  bounds.beginY < tile.endY  &&  bounds.endY > tile.beginY)
+               count++;
+         }
+         
+         CPPUNIT_ASSERT_MESSAGE("Wrong number of triangles in the tile", engine.getNumTileTriangles(tileX, tileY) == count);
+      }
+}
+
+void TiledDepthEngineTest::testHiddenTrianglesSkipped()
+{
+   GPUGeometryModel model(SIZE_X, SIZE_Y);
+   model.setRenderedArea(-1, -1, -1, 1, 1, 1);
+   
+   // Stack of quads under the top one, which covers the whole board
+   for (int i = 0; i < 10; i++)
+      addQuad(&model, -0.9, 0.9, -0.5 + 0.05 * i);
+   
+   addQuad(&model, -2, 2, 0.5);
+   
+   TiledDepthEngine engine(TILE_SIZE);
+   engine.update(model);
+   
+   vector<float> values(SIZE_X * SIZE_Y);
+   engine.readValues(&values[0]);
+   
+   for (int i = 0; i < SIZE_X * SIZE_Y; i++)
+      CPPUNIT_ASSERT_MESSAGE("Wrong value", areEqualInLowPrecision(values[i], 0.25));
+   
+   // Top quad is rasterized first in every tile, and all quads under it are skipped
+   int numTiles = engine.getNumTilesX() * engine.getNumTilesY();
+   CPPUNIT_ASSERT_MESSAGE("Hidden triangles not skipped", engine.getNumSkippedTriangles() >= numTiles * 10);
+}
+
+void TiledDepthEngineTest::testNoCracksBetweenTriangles()
+{
+   // Grid vertices are on the moxel corners (up to the rounding), so the diagonals of the grid go through the moxel centers
+   const int SIZE = 100;
+   const int GRID = 22;
+   
+   GPUGeometryModel model(SIZE, SIZE);
+   model.setRenderedArea(-1, -1, -1, 1, 1, 1);
+   
+   for (int y = 0; y <= GRID; y++)
+      for (int x = 0; x <= GRID; x++)
+         model.addPoint(createPoint(-1.1 + 0.1 * x, -1.1 + 0.1 * y, 0.02 * x - 0.015 * y));
+   
+   for (int y = 0; y < GRID; y++)
+      for (int x = 0; x < GRID; x++)
+      {
+         int corner = y * (GRID + 1) + x;
+         
+         model.addTriangle(createTriangle(corner, corner + 1, corner + GRID + 2));
+         model.addTriangle(createTriangle(corner, corner + GRID + 2, corner + GRID + 1));
+      }
+   
+   vector<float> raster = rasterizeBoard(model);
+   
+   for (int i = 0; i < SIZE * SIZE; i++)
+   {
+      stringstream message;
+      message << "Crack at the coordinates X = " << i % SIZE << " Y = " << i / SIZE;
+      
+      CPPUNIT_ASSERT_MESSAGE(message.str().c_str(), raster[i] < 1);
+   }
+}
+
+void TiledDepthEngineTest::testWithoutRenderedArea()
+{
+   GPUGeometryModel model(SIZE_X, SIZE_Y);
+   addWavySurface(&model);
+   
+   TiledDepthEngine engine(TILE_SIZE);
+   engine.update(model);
+   
+   CPPUNIT_ASSERT_MESSAGE("Empty board not valid", engine.getNumValidTiles() == engine.getNumTilesX() * engine.getNumTilesY());
+   
+   for (int y = 0; y < SIZE_Y; y++)
+      for (int x = 0; x < SIZE_X; x++)
+         CPPUNIT_ASSERT_MESSAGE("Board not empty", engine.getAt(x, y) == 1);
+   
+   // Empty values are not shifted or kept once the rendered area is set
+   model.setRenderedArea(-1, -1, -1, 1, 1, 1);
+   engine.update(model);
+   CPPUNIT_ASSERT_MESSAGE("Tiles valid after the rendered area was set", engine.getNumValidTiles() == 0);
+   
+   vector<float> raster = rasterizeBoard(model);
+   CPPUNIT_ASSERT_MESSAGE("Wrong value", fabs(engine.getAt(SIZE_X / 2, SIZE_Y / 2) - raster[SIZE_Y / 2 * SIZE_X + SIZE_X / 2]) < 1e-5);
+   
+   // Lazy model is calculated the same way
+   GPUGeometryModel lazyModel(SIZE_X, SIZE_Y);
+   addWavySurface(&lazyModel);
+   lazyModel.setLazyTileEvaluation(true);
+   
+   CPPUNIT_ASSERT_MESSAGE("Lazy board not empty", lazyModel.getAt(0, 0) == 1  &&  lazyModel.getAt(SIZE_X - 1, SIZE_Y - 1) == 1);
+}
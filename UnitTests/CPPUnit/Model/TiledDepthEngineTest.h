@@ -0,0 +1,151 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILED_DEPTH_ENGINE_TEST_H_
+#define TILED_DEPTH_ENGINE_TEST_H_
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace hdsim {
+   
+   class TiledDepthEngineTest : public CppUnit::TestFixture  {
+      CPPUNIT_TEST_SUITE(TiledDepthEngineTest);
+         CPPUNIT_TEST(testOnlyTouchedTilesCalculated);
+         CPPUNIT_TEST(testMatchesFullBoard);
+         CPPUNIT_TEST(testRegionRead);
+         CPPUNIT_TEST(testInvalidatedOnChange);
+         CPPUNIT_TEST(testModelLazyEvaluation);
+         CPPUNIT_TEST(testLazyModelDecimation);
+         CPPUNIT_TEST(testLazyModelPublishing);
+         CPPUNIT_TEST(testIncrementalEdits);
+         CPPUNIT_TEST(testModelIncrementalEdits);
+         CPPUNIT_TEST(testPanByWholeMoxels);
+         CPPUNIT_TEST(testPanByPartOfMoxel);
+         CPPUNIT_TEST(testTileTriangleCounts);
+         CPPUNIT_TEST(testHiddenTrianglesSkipped);
+         CPPUNIT_TEST(testNoCracksBetweenTriangles);
+         CPPUNIT_TEST(testWithoutRenderedArea);
+      CPPUNIT_TEST_SUITE_END();
+      
+   public:
+      
+      /**
+       * Constructor
+       */
+      TiledDepthEngineTest();
+      
+      /**
+       * Destructor
+       */
+      virtual ~TiledDepthEngineTest();
+      
+      /**
+       * Prepare test for running
+       */
+      void setUp();
+      
+      /**
+       * Cleanup after test
+       */
+      void tearDown();
+      
+      /**
+       * Test that only tiles touched by the read are calculated
+       */
+      void testOnlyTouchedTilesCalculated();
+      
+      /**
+       * Test that tiled calculation matches rasterization of the whole board
+       */
+      void testMatchesFullBoard();
+      
+      /**
+       * Test reading of the region
+       */
+      void testRegionRead();
+      
+      /**
+       * Test that tiles are invalidated when the model changes
+       */
+      void testInvalidatedOnChange();
+      
+      /**
+       * Test lazy tile evaluation of the model
+       */
+      void testModelLazyEvaluation();
+      
+      /**
+       * Test that decimation of the lazy model calculates every tile before reading the model from the pool threads
+       */
+      void testLazyModelDecimation();
+      
+      /**
+       * Test that publishing the calculated frame doesn't calculate the whole board of the lazy model
+       */
+      void testLazyModelPublishing();
+      
+      /**
+       * Test that edits invalidate only tiles covered by the affected triangles
+       */
+      void testIncrementalEdits();
+      
+      /**
+       * Test that model applies edits made since the last calculation incrementally
+       */
+      void testModelIncrementalEdits();
+      
+      /**
+       * Test that values are shifted when rendered area moves by whole moxels
+       */
+      void testPanByWholeMoxels();
+      
+      /**
+       * Test that all tiles are invalidated when rendered area moves by part of the moxel
+       */
+      void testPanByPartOfMoxel();
+      
+      /**
+       * Test that triangles are binned to the tiles their bounds overlap
+       */
+      void testTileTriangleCounts();
+      
+      /**
+       * Test that triangles behind the depth already in the tile are skipped
+       */
+      void testHiddenTrianglesSkipped();
+      
+      /**
+       * Test that moxel centers exactly on the edge shared by two triangles are covered by one of them
+       */
+      void testNoCracksBetweenTriangles();
+      
+      /**
+       * Test that the board of the model without the rendered area is empty
+       */
+      void testWithoutRenderedArea();
+      
+   private:
+      // define
+      TiledDepthEngineTest(const TiledDepthEngineTest &rhs);   
+      TiledDepthEngineTest & operator=(const TiledDepthEngineTest &rhs);   
+   };
+   
+}
+
+#endif
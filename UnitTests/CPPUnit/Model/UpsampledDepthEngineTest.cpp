@@ -0,0 +1,370 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <cmath>
+#include <vector>
+
+#include "GPUGeometryModel.h"
+#include "PreciseDelay.h"
+#include "TiledDepthEngine.h"
+#include "UpsampledDepthEngine.h"
+#include "TestGeometry.h"
+#include "UpsampledDepthEngineTest.h"
+
+using namespace hdsim;
+using namespace std;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(UpsampledDepthEngineTest);
+
+/**
+ * Board size used by the tests. Neither dimension is multiple of the tile size or of the upsampling factor
+ */
+static const int SIZE_X = 203;
+static const int SIZE_Y = 150;
+
+/**
+ * Budget that is long enough for any of the test boards to be refined completely
+ */
+static const long long LONG_BUDGET = 60000000;
+
+/**
+ * Add smooth height field that covers the whole rendered area and more
+ */
+static void addSmoothSurface(GPUGeometryModel *model)
+{
+   const int GRID = 40;
+   
+   for (int y = 0; y <= GRID; y++)
+      for (int x = 0; x <= GRID; x++)
+      {
+         double pointX = -1.2 + 2.4 * x / GRID, pointY = -1.2 + 2.4 * y / GRID;
+         model->addPoint(createPoint(pointX, pointY, 0.3 * sin(pointX * 1.5) * cos(pointY * 1.2)));
+      }
+   
+   for (int y = 0; y < GRID; y++)
+      for (int x = 0; x < GRID; x++)
+      {
+         int corner = y * (GRID + 1) + x;
+         
+         model->addTriangle(createTriangle(corner, corner + 1, corner + GRID + 2));
+         model->addTriangle(createTriangle(corner, corner + GRID + 2, corner + GRID + 1));
+      }
+}
+
+/**
+ * Calculate every moxel of the board, in the same tiles as the upsampled engine does
+ */
+static vector<float> calculateExactBoard(const GPUGeometryModel &model)
+{
+   TiledDepthEngine engine(UpsampledDepthEngine::TILE_SIZE);
+   engine.update(model);
+   
+   vector<float> exact(model.getSizeX() * model.getSizeY());
+   engine.readValues(&exact[0]);
+   
+   return exact;
+}
+
+/**
+ * Get max difference of the upsampled and exact board
+ */
+static double getMaxError(const UpsampledDepthEngine &engine, const vector<float> &exact)
+{
+   double maxError = 0;
+   
+   for (int y = 0; y < engine.getSizeY(); y++)
+      for (int x = 0; x < engine.getSizeX(); x++)
+         maxError = max(maxError, fabs(engine.getAt(x, y) - exact[y * engine.getSizeX() + x]));
+   
+   return maxError;
+}
+
+UpsampledDepthEngineTest::UpsampledDepthEngineTest()
+{
+   
+}
+
+UpsampledDepthEngineTest::~UpsampledDepthEngineTest()
+{
+   
+}
+
+void UpsampledDepthEngineTest::setUp()
+{
+   
+}
+
+void UpsampledDepthEngineTest::tearDown()
+{
+   
+}
+
+void UpsampledDepthEngineTest::testSmoothSceneInterpolated()
+{
+   GPUGeometryModel model(SIZE_X, SIZE_Y);
+   model.setRenderedArea(-1, -1, -1, 1, 1, 1);
+   addSmoothSurface(&model);
+   
+   UpsampledDepthEngine engine(4);
+   engine.calculate(model);
+   
+   CPPUNIT_ASSERT_MESSAGE("Wrong number of tiles", engine.getNumTilesX() == 7  &&  engine.getNumTilesY() == 5);
+   CPPUNIT_ASSERT_MESSAGE("Smooth surface calculated at the full resolution", engine.getNumExactTiles() == 0);
+   
+   double maxError = getMaxError(engine, calculateExactBoard(model));
+   CPPUNIT_ASSERT_MESSAGE("Interpolation error too large", maxError < 0.001);
+}
+
+void UpsampledDepthEngineTest::testStepsCalculatedExactly()
+{
+   GPUGeometryModel model(SIZE_X, SIZE_Y);
+   model.setRenderedArea(-1, -1, -1, 1, 1, 1);
+   addQuad(&model, -0.6, 0.2, 0.3);
+   addQuad(&model, -0.1, 0.7, -0.2);
+   
+   UpsampledDepthEngine engine(4);
+   engine.calculate(model);
+   
+   const int numTiles = engine.getNumTilesX() * engine.getNumTilesY();
+   CPPUNIT_ASSERT_MESSAGE("Wrong number of exact tiles", engine.getNumExactTiles() > 0  &&  engine.getNumExactTiles() < numTiles);
+   
+   // Tiles far from the edges of the quads are interpolated
+   CPPUNIT_ASSERT_MESSAGE("Background calculated at the full resolution", !engine.isTileExact(0, 0)  &&  !engine.isTileExact(6, 0));
+   
+   // Flat regions are interpolated exactly, and everything else is calculated
+   double maxError = getMaxError(engine, calculateExactBoard(model));
+   CPPUNIT_ASSERT_MESSAGE("Error at the step", maxError < 1e-5);
+}
+
+void UpsampledDepthEngineTest::testModelUpsampling()
+{
+   GPUGeometryModel model(SIZE_X, SIZE_Y);
+   model.setRenderedArea(-1, -1, -1, 1, 1, 1);
+   addSmoothSurface(&model);
+   addQuad(&model, -0.6, 0.2, 0.5);
+   
+   // Upsampling takes precedence over the lazy tile evaluation
+   model.setLazyTileEvaluation(true);
+   CPPUNIT_ASSERT_MESSAGE("Upsampling not used", model.setUpsamplingFactor(3));
+   
+   CPPUNIT_ASSERT_MESSAGE("Upsampling not set", model.getUpsamplingFactor() == 3  &&  model.getUpsampledDepthEngine());
+   CPPUNIT_ASSERT_MESSAGE("Lazy evaluation used with upsampling", !model.setLazyTileEvaluation(true));
+   
+   UpsampledDepthEngine engine(3);
+   engine.calculate(model);
+   
+   for (int y = 0; y < SIZE_Y; y++)
+      for (int x = 0; x < SIZE_X; x++)
+         CPPUNIT_ASSERT_MESSAGE("Model is not upsampled", model.getAt(x, y) == engine.getAt(x, y));
+   
+   CPPUNIT_ASSERT_MESSAGE("Lazy tiles calculated", model.getTiledDepthEngine()->getNumTileCalculations() == 0);
+   CPPUNIT_ASSERT_MESSAGE("Steps not calculated exactly", model.getUpsampledDepthEngine()->getNumExactTiles() > 0);
+   
+   // Without upsampling, every moxel is calculated again
+   model.setUpsamplingFactor(1);
+   CPPUNIT_ASSERT_MESSAGE("Upsampling not removed", model.getUpsamplingFactor() == 1  &&  !model.getUpsampledDepthEngine());
+   
+   vector<float> exact = calculateExactBoard(model);
+   
+   for (int y = 0; y < SIZE_Y; y++)
+      for (int x = 0; x < SIZE_X; x++)
+         CPPUNIT_ASSERT_MESSAGE("Model is still upsampled", fabs(model.getAt(x, y) - exact[y * SIZE_X + x]) < 1e-5);
+   
+   // Coarse board is calculated on the CPU, which doesn't run the shader
+   model.setPathToShaderSource("SlowInSlowOut.fs");
+   CPPUNIT_ASSERT_MESSAGE("Upsampling used with the shader", !model.setUpsamplingFactor(3));
+}
+
+void UpsampledDepthEngineTest::testProgressiveRefinement()
+{
+   GPUGeometryModel model(SIZE_X, SIZE_Y);
+   model.setRenderedArea(-1, -1, -1, 1, 1, 1);
+   addSmoothSurface(&model);
+   addQuad(&model, -0.6, 0.2, 0.5);
+   
+   UpsampledDepthEngine engine(4);
+   engine.calculateProgressive(model, getMonotonicTimeInMicroSeconds() + LONG_BUDGET);
+   
+   CPPUNIT_ASSERT_MESSAGE("Refinement not complete", engine.isRefinementComplete());
+   CPPUNIT_ASSERT_MESSAGE("Wrong full resolution fraction", engine.getFullResolutionFraction() == 1);
+   CPPUNIT_ASSERT_MESSAGE("Wrong number of exact tiles", engine.getNumExactTiles() == engine.getNumTilesX() * engine.getNumTilesY());
+   
+   double maxError = getMaxError(engine, calculateExactBoard(model));
+   CPPUNIT_ASSERT_MESSAGE("Refined board differs from the exact one", maxError < 1e-5);
+   
+   ProgressiveRefinementStatistics statistics = engine.getProgressiveStatistics();
+   CPPUNIT_ASSERT_MESSAGE("Wrong statistics", statistics.numFrames == 1  &&  statistics.numCompleteFrames == 1  &&
+                          statistics.meanFullResolutionFraction == 1  &&  statistics.minFullResolutionFraction == 1);
+   
+   // Plain calculation doesn't refine smooth tiles
+   engine.calculate(model);
+   CPPUNIT_ASSERT_MESSAGE("Smooth tiles refined", !engine.isRefinementComplete()  &&  engine.getFullResolutionFraction() < 1);
+}
+
+void UpsampledDepthEngineTest::testProgressiveDeadline()
+{
+   GPUGeometryModel model(SIZE_X, SIZE_Y);
+   model.setRenderedArea(-1, -1, -1, 1, 1, 1);
+   addSmoothSurface(&model);
+   
+   // With the deadline already passed, the whole board is still interpolated
+   UpsampledDepthEngine engine(4);
+   engine.calculateProgressive(model, 0);
+   
+   CPPUNIT_ASSERT_MESSAGE("Tiles refined after the deadline", engine.getNumExactTiles() == 0  &&  engine.getFullResolutionFraction() == 0);
+   CPPUNIT_ASSERT_MESSAGE("Refinement complete", !engine.isRefinementComplete());
+   
+   vector<float> exact = calculateExactBoard(model);
+   CPPUNIT_ASSERT_MESSAGE("Interpolation error too large", getMaxError(engine, exact) < 0.001);
+   
+   engine.continueRefinement(getMonotonicTimeInMicroSeconds() + LONG_BUDGET);
+   
+   CPPUNIT_ASSERT_MESSAGE("Refinement not continued", engine.isRefinementComplete()  &&  engine.getFullResolutionFraction() == 1);
+   CPPUNIT_ASSERT_MESSAGE("Refined board differs from the exact one", getMaxError(engine, exact) < 1e-5);
+   
+   // Continued refinement updates statistics of its frame
+   ProgressiveRefinementStatistics statistics = engine.getProgressiveStatistics();
+   CPPUNIT_ASSERT_MESSAGE("Wrong statistics", statistics.numFrames == 1  &&  statistics.numCompleteFrames == 1  &&
+                          statistics.meanFullResolutionFraction == 1  &&  statistics.minFullResolutionFraction == 1);
+   
+   engine.calculateProgressive(model, 0);
+   
+   statistics = engine.getProgressiveStatistics();
+   CPPUNIT_ASSERT_MESSAGE("Wrong statistics of the new frame", statistics.numFrames == 2  &&  statistics.numCompleteFrames == 1  &&
+                          statistics.meanFullResolutionFraction == 0.5  &&  statistics.minFullResolutionFraction == 0);
+   
+   engine.resetProgressiveStatistics();
+   CPPUNIT_ASSERT_MESSAGE("Statistics not reset", engine.getProgressiveStatistics().numFrames == 0);
+}
+
+void UpsampledDepthEngineTest::testRefinementOrder()
+{
+   GPUGeometryModel model(SIZE_X, SIZE_Y);
+   model.setRenderedArea(-1, -1, -1, 1, 1, 1);
+   addQuad(&model, -0.6, 0.2, 0.3);
+   addQuad(&model, -0.1, 0.7, -0.2);
+   
+   UpsampledDepthEngine engine(4);
+   engine.calculate(model);
+   
+   const int numTilesX = engine.getNumTilesX(), numTiles = numTilesX * engine.getNumTilesY();
+   vector<bool> stepTiles(numTiles);
+   
+   for (int i = 0; i < numTiles; i++)
+      stepTiles[i] = engine.isTileExact(i % numTilesX, i / numTilesX);
+   
+   // Tiles with steps have error as big as the step, so they are refined before the flat ones
+   engine.calculateProgressive(model, 0);
+   
+   CPPUNIT_ASSERT_MESSAGE("Error of the flat tile", engine.getEstimatedError(0, 0) == 0);
+   
+   for (int i = 0; i < numTiles; i++)
+   {
+      int tile = engine.getTileInRefinementOrder(i);
+      double error = engine.getEstimatedError(tile % numTilesX, tile / numTilesX);
+      
+      CPPUNIT_ASSERT_MESSAGE("Error of the tile with step", !stepTiles[tile]  ||  error > 0.3);
+      
+      if (i > 0)
+      {
+         int previous = engine.getTileInRefinementOrder(i - 1);
+         CPPUNIT_ASSERT_MESSAGE("Tiles not ordered by error", engine.getEstimatedError(previous % numTilesX, previous / numTilesX) >= error);
+      }
+   }
+   
+   const int first = engine.getTileInRefinementOrder(0);
+   const double maxError = engine.getEstimatedError(first % numTilesX, first / numTilesX);
+   
+   // Region of interest is refined first, even if it is flat
+   TileRange region;
+   region.beginX = 200;
+   region.endX = SIZE_X;
+   region.beginY = 140;
+   region.endY = SIZE_Y;
+   
+   engine.calculateProgressive(model, 0, &region);
+   CPPUNIT_ASSERT_MESSAGE("Region of interest not refined first", engine.getTileInRefinementOrder(0) == numTiles - 1);
+   
+   int second = engine.getTileInRefinementOrder(1);
+   CPPUNIT_ASSERT_MESSAGE("Tile with the largest error not refined after the region",
+                          engine.getEstimatedError(second % numTilesX, second / numTilesX) == maxError);
+}
+
+void UpsampledDepthEngineTest::testModelProgressiveRefinement()
+{
+   GPUGeometryModel model(SIZE_X, SIZE_Y);
+   model.setRenderedArea(-1, -1, -1, 1, 1, 1);
+   addSmoothSurface(&model);
+   addQuad(&model, -0.6, 0.2, 0.5);
+   
+   model.setUpsamplingFactor(4);
+   model.setRefinementBudget(LONG_BUDGET);
+   
+   CPPUNIT_ASSERT_MESSAGE("Refinement budget not set", model.getRefinementBudget() == LONG_BUDGET);
+   
+   // Deadline of the calculation takes precedence over the budget
+   model.setCalculationDeadline(1);
+   model.getAt(0, 0);
+   
+   const UpsampledDepthEngine *engine = model.getUpsampledDepthEngine();
+   CPPUNIT_ASSERT_MESSAGE("Tiles refined after the deadline", engine->getFullResolutionFraction() == 0);
+   
+   // Calculating unchanged model again continues the refinement, within the budget
+   model.forceModelCalculation();
+   CPPUNIT_ASSERT_MESSAGE("Refinement not continued", engine->isRefinementComplete());
+   CPPUNIT_ASSERT_MESSAGE("Wrong statistics", engine->getProgressiveStatistics().numFrames == 1);
+   
+   vector<float> exact = calculateExactBoard(model);
+   
+   for (int y = 0; y < SIZE_Y; y++)
+      for (int x = 0; x < SIZE_X; x++)
+         CPPUNIT_ASSERT_MESSAGE("Model is not refined", fabs(model.getAt(x, y) - exact[y * SIZE_X + x]) < 1e-5);
+   
+   // Copies keep the budget
+   GPUGeometryModel copy(model);
+   CPPUNIT_ASSERT_MESSAGE("Refinement budget not copied", copy.getRefinementBudget() == LONG_BUDGET);
+}
+
+void UpsampledDepthEngineTest::testWithoutRenderedArea()
+{
+   GPUGeometryModel model(SIZE_X, SIZE_Y);
+   addSmoothSurface(&model);
+   
+   UpsampledDepthEngine engine(4);
+   engine.calculate(model);
+   
+   CPPUNIT_ASSERT_MESSAGE("Empty board not exact", engine.isRefinementComplete()  &&  engine.getFullResolutionFraction() == 1);
+   
+   for (int y = 0; y < SIZE_Y; y++)
+      for (int x = 0; x < SIZE_X; x++)
+         CPPUNIT_ASSERT_MESSAGE("Board not empty", engine.getAt(x, y) == 1);
+   
+   engine.calculateProgressive(model, 0);
+   CPPUNIT_ASSERT_MESSAGE("Empty board not complete", engine.isRefinementComplete()  &&  engine.getAt(SIZE_X / 2, SIZE_Y / 2) == 1);
+   CPPUNIT_ASSERT_MESSAGE("Wrong statistics", engine.getProgressiveStatistics().numFrames == 1  &&  
+                                              engine.getProgressiveStatistics().numCompleteFrames == 1);
+   
+   // Board is calculated once the rendered area is set
+   model.setRenderedArea(-1, -1, -1, 1, 1, 1);
+   engine.calculate(model);
+   
+   double maxError = getMaxError(engine, calculateExactBoard(model));
+   CPPUNIT_ASSERT_MESSAGE("Wrong board after the rendered area was set", maxError < 0.001);
+}
@@ -0,0 +1,109 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UPSAMPLED_DEPTH_ENGINE_TEST_H_
+#define UPSAMPLED_DEPTH_ENGINE_TEST_H_
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace hdsim {
+   
+   class UpsampledDepthEngineTest : public CppUnit::TestFixture  {
+      CPPUNIT_TEST_SUITE(UpsampledDepthEngineTest);
+         CPPUNIT_TEST(testSmoothSceneInterpolated);
+         CPPUNIT_TEST(testStepsCalculatedExactly);
+         CPPUNIT_TEST(testModelUpsampling);
+         CPPUNIT_TEST(testProgressiveRefinement);
+         CPPUNIT_TEST(testProgressiveDeadline);
+         CPPUNIT_TEST(testRefinementOrder);
+         CPPUNIT_TEST(testModelProgressiveRefinement);
+         CPPUNIT_TEST(testWithoutRenderedArea);
+      CPPUNIT_TEST_SUITE_END();
+      
+   public:
+      
+      /**
+       * Constructor
+       */
+      UpsampledDepthEngineTest();
+      
+      /**
+       * Destructor
+       */
+      virtual ~UpsampledDepthEngineTest();
+      
+      /**
+       * Prepare test for running
+       */
+      void setUp();
+      
+      /**
+       * Cleanup after test
+       */
+      void tearDown();
+      
+      /**
+       * Test that smooth surface is interpolated everywhere, with small error
+       */
+      void testSmoothSceneInterpolated();
+      
+      /**
+       * Test that tiles with steps are calculated at the full resolution, so flat regions with steps have no error
+       */
+      void testStepsCalculatedExactly();
+      
+      /**
+       * Test upsampling set on the model
+       */
+      void testModelUpsampling();
+      
+      /**
+       * Test that progressive calculation with enough time refines the whole board
+       */
+      void testProgressiveRefinement();
+      
+      /**
+       * Test that progressive calculation past its deadline leaves board interpolated, and that refinement could be continued
+       */
+      void testProgressiveDeadline();
+      
+      /**
+       * Test that tiles are refined in the region of interest first, and then in the order of their estimated error
+       */
+      void testRefinementOrder();
+      
+      /**
+       * Test progressive refinement set on the model
+       */
+      void testModelProgressiveRefinement();
+      
+      /**
+       * Test that the board of the model without the rendered area is empty
+       */
+      void testWithoutRenderedArea();
+      
+   private:
+      // define
+      UpsampledDepthEngineTest(const UpsampledDepthEngineTest &rhs);   
+      UpsampledDepthEngineTest & operator=(const UpsampledDepthEngineTest &rhs);   
+   };
+   
+}
+
+#endif
@@ -0,0 +1,99 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <pthread.h>
+#include "Future.h"
+#include "PreciseDelay.h"
+#include "FutureTest.h"
+
+using namespace hdsim;
+using namespace std;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(FutureTest);
+
+FutureTest::FutureTest()
+{
+   
+}
+
+FutureTest::~FutureTest()
+{
+   
+}
+
+void FutureTest::setUp()
+{
+   
+}
+
+void FutureTest::tearDown()
+{
+   
+}
+
+/**
+ * Sets value of the future after short delay
+ *
+ * @param future Future<int> to set
+ */
+static void *setValueLater(void *future)
+{
+   hybridWaitDelay(10000);
+   static_cast<Future<int> *>(future)->setValue(42);
+   
+   return 0;
+}
+
+void FutureTest::testValueAcrossThreads()
+{
+   Future<int> future = Future<int>::create();
+   Future<int> producerCopy = future;
+   
+   pthread_t thread;
+   CPPUNIT_ASSERT_MESSAGE("Can't start thread", !pthread_create(&thread, 0, setValueLater, &producerCopy));
+   
+   CPPUNIT_ASSERT_MESSAGE("Value not received", future.get() == 42);
+   CPPUNIT_ASSERT_MESSAGE("Future not ready after get", future.isReady());
+   
+   pthread_join(thread, 0);
+}
+
+void FutureTest::testCancel()
+{
+   Future<int> future = Future<int>::create();
+   
+   CPPUNIT_ASSERT_MESSAGE("Cancel failed", future.cancel());
+   CPPUNIT_ASSERT_MESSAGE("Future not cancelled", future.isCancelled()  &&  future.isReady());
+   CPPUNIT_ASSERT_MESSAGE("Cancelled future accepted value", !future.setValue(1));
+   CPPUNIT_ASSERT_MESSAGE("Cancelled future returned value", future.get() == 0);
+   
+   Future<int> finished = Future<int>::create();
+   finished.setValue(1);
+   CPPUNIT_ASSERT_MESSAGE("Finished future was cancelled", !finished.cancel()  &&  finished.get() == 1);
+}
+
+void FutureTest::testInvalidFuture()
+{
+   Future<int> future;
+   
+   CPPUNIT_ASSERT_MESSAGE("Default future should be invalid", !future.isValid());
+   CPPUNIT_ASSERT_MESSAGE("Invalid future should not be ready", !future.isReady());
+   CPPUNIT_ASSERT_MESSAGE("Invalid future should not block", future.get() == 0);
+}
@@ -0,0 +1,79 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FUTURE_TEST_H_
+#define FUTURE_TEST_H_
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace hdsim {
+   
+   class FutureTest : public CppUnit::TestFixture  {
+      CPPUNIT_TEST_SUITE(FutureTest);
+         CPPUNIT_TEST(testValueAcrossThreads);
+         CPPUNIT_TEST(testCancel);
+         CPPUNIT_TEST(testInvalidFuture);
+      CPPUNIT_TEST_SUITE_END();
+      
+   public:
+      
+      /**
+       * Constructor
+       */
+      FutureTest();
+      
+      /**
+       * Destructor
+       */
+      virtual ~FutureTest();
+      
+      /**
+       * Prepare test for running
+       */
+      void setUp();
+      
+      /**
+       * Cleanup after test
+       */
+      void tearDown();
+      
+      /**
+       * Test that value set on one thread is received on the other
+       */
+      void testValueAcrossThreads();
+      
+      /**
+       * Test that cancelled future doesn't accept value
+       */
+      void testCancel();
+      
+      /**
+       * Test that future not associated with operation behaves sanely
+       */
+      void testInvalidFuture();
+      
+   private:
+      // define
+      FutureTest(const FutureTest &rhs);   
+      FutureTest & operator=(const FutureTest &rhs);   
+   };
+   
+}
+
+#endif
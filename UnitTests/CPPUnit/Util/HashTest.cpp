@@ -0,0 +1,91 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <cstdio>
+#include <cstring>
+
+#include <unistd.h>
+
+#include "Hash.h"
+#include "HashTest.h"
+
+using namespace hdsim;
+using namespace std;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(HashTest);
+
+HashTest::HashTest()
+{
+   
+}
+
+HashTest::~HashTest()
+{
+   
+}
+
+void HashTest::setUp()
+{
+   
+}
+
+void HashTest::tearDown()
+{
+   
+}
+
+void HashTest::testKnownValues()
+{
+   CPPUNIT_ASSERT_MESSAGE("Wrong hash of empty data", fnv1aHash("", 0) == 0xcbf29ce484222325ULL);
+   CPPUNIT_ASSERT_MESSAGE("Wrong hash of single character", fnv1aHash("a", 1) == 0xaf63dc4c8601ec8cULL);
+   CPPUNIT_ASSERT_MESSAGE("Wrong hash of string", fnv1aHash("foobar", 6) == 0x85944171f73967e8ULL);
+}
+
+void HashTest::testIncrementalHash()
+{
+   const char *data = "HoloSim moxel board";
+   size_t size = strlen(data);
+   
+   unsigned long long partial = fnv1aHash(data, 7);
+   partial = fnv1aHash(data + 7, size - 7, partial);
+   
+   CPPUNIT_ASSERT_MESSAGE("Incremental hash differs from the hash of the whole data", partial == fnv1aHash(data, size));
+   CPPUNIT_ASSERT_MESSAGE("Different data with the same hash", fnv1aHash(data, size) != fnv1aHash(data, size - 1));
+}
+
+void HashTest::testHashFile()
+{
+   char fileName[] = "/tmp/HoloSimHashTestXXXXXX";
+   int fd = mkstemp(fileName);
+   CPPUNIT_ASSERT_MESSAGE("Can't create temporary file", fd != -1);
+   close(fd);
+   
+   FILE *file = fopen(fileName, "wb");
+   fputs("foobar", file);
+   fclose(file);
+   
+   unsigned long long hash = 0;
+   bool success = hashFile(fileName, &hash);
+   unlink(fileName);
+   
+   CPPUNIT_ASSERT_MESSAGE("Can't hash file", success);
+   CPPUNIT_ASSERT_MESSAGE("Hash of file differs from the hash of its content", hash == fnv1aHash("foobar", 6));
+   CPPUNIT_ASSERT_MESSAGE("Missing file hashed", !hashFile(fileName, &hash));
+}
@@ -0,0 +1,79 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HASH_TEST_H_
+#define HASH_TEST_H_
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace hdsim {
+   
+   class HashTest : public CppUnit::TestFixture  {
+      CPPUNIT_TEST_SUITE(HashTest);
+         CPPUNIT_TEST(testKnownValues);
+         CPPUNIT_TEST(testIncrementalHash);
+         CPPUNIT_TEST(testHashFile);
+      CPPUNIT_TEST_SUITE_END();
+      
+   public:
+      
+      /**
+       * Constructor
+       */
+      HashTest();
+      
+      /**
+       * Destructor
+       */
+      virtual ~HashTest();
+      
+      /**
+       * Prepare test for running
+       */
+      void setUp();
+      
+      /**
+       * Cleanup after test
+       */
+      void tearDown();
+      
+      /**
+       * Test hash against published FNV-1a values
+       */
+      void testKnownValues();
+      
+      /**
+       * Test that hash calculated in parts is the same as hash of the whole data
+       */
+      void testIncrementalHash();
+      
+      /**
+       * Test hashing of the file content
+       */
+      void testHashFile();
+      
+   private:
+      // define
+      HashTest(const HashTest &rhs);   
+      HashTest & operator=(const HashTest &rhs);   
+   };
+   
+}
+
+#endif
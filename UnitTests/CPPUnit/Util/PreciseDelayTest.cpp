@@ -0,0 +1,81 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "PreciseDelay.h"
+#include "PreciseDelayTest.h"
+
+using namespace hdsim;
+using namespace std;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(PreciseDelayTest);
+
+PreciseDelayTest::PreciseDelayTest()
+{
+   
+}
+
+PreciseDelayTest::~PreciseDelayTest()
+{
+   
+}
+
+void PreciseDelayTest::setUp()
+{
+   
+}
+
+void PreciseDelayTest::tearDown()
+{
+   
+}
+
+void PreciseDelayTest::testMonotonicClock()
+{
+   long long previous = getMonotonicTimeInMicroSeconds();
+   
+   for (int i = 0; i < 1000; i++)
+   {
+      long long now = getMonotonicTimeInMicroSeconds();
+      CPPUNIT_ASSERT_MESSAGE("Monotonic clock went backwards", now >= previous);
+      previous = now;
+   }
+}
+
+void PreciseDelayTest::testHybridWait()
+{
+   static const long WAIT_IN_MICROSECONDS = 10000;
+   
+   long long start = getMonotonicTimeInMicroSeconds();
+   hybridWaitDelay(WAIT_IN_MICROSECONDS);
+   long long elapsed = getMonotonicTimeInMicroSeconds() - start;
+   
+   CPPUNIT_ASSERT_MESSAGE("Hybrid wait returned too early", elapsed >= WAIT_IN_MICROSECONDS);
+}
+
+void PreciseDelayTest::testWaitUntilPassedDeadline()
+{
+   static const long MAX_OVERHEAD_IN_MICROSECONDS = 1000;
+   
+   long long start = getMonotonicTimeInMicroSeconds();
+   waitUntil(start - 1000000);
+   long long elapsed = getMonotonicTimeInMicroSeconds() - start;
+   
+   CPPUNIT_ASSERT_MESSAGE("Waiting for the passed deadline took too long", elapsed < MAX_OVERHEAD_IN_MICROSECONDS);
+}
@@ -0,0 +1,79 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PRECISE_DELAY_TEST_H_
+#define PRECISE_DELAY_TEST_H_
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace hdsim {
+   
+   class PreciseDelayTest : public CppUnit::TestFixture  {
+      CPPUNIT_TEST_SUITE(PreciseDelayTest);
+         CPPUNIT_TEST(testMonotonicClock);
+         CPPUNIT_TEST(testHybridWait);
+         CPPUNIT_TEST(testWaitUntilPassedDeadline);
+      CPPUNIT_TEST_SUITE_END();
+      
+   public:
+      
+      /**
+       * Constructor
+       */
+      PreciseDelayTest();
+      
+      /**
+       * Destructor
+       */
+      virtual ~PreciseDelayTest();
+      
+      /**
+       * Prepare test for running
+       */
+      void setUp();
+      
+      /**
+       * Cleanup after test
+       */
+      void tearDown();
+      
+      /**
+       * Test that monotonic clock doesn't go backwards
+       */
+      void testMonotonicClock();
+      
+      /**
+       * Test that hybrid wait waits at least requested time
+       */
+      void testHybridWait();
+      
+      /**
+       * Test that waiting for the deadline that has passed returns immediately
+       */
+      void testWaitUntilPassedDeadline();
+      
+   private:
+      // define
+      PreciseDelayTest(const PreciseDelayTest &rhs);   
+      PreciseDelayTest & operator=(const PreciseDelayTest &rhs);   
+   };
+   
+}
+
+#endif
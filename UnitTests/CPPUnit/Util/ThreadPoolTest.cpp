@@ -0,0 +1,163 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <vector>
+#include "ThreadPool.h"
+#include "ThreadPoolTest.h"
+
+using namespace hdsim;
+using namespace std;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ThreadPoolTest);
+
+ThreadPoolTest::ThreadPoolTest()
+{
+   
+}
+
+ThreadPoolTest::~ThreadPoolTest()
+{
+   
+}
+
+void ThreadPoolTest::setUp()
+{
+   
+}
+
+void ThreadPoolTest::tearDown()
+{
+   
+}
+
+/**
+ * Counts how many times every cell of the grid was visited
+ */
+class CountingBody : public TileRangeBody {
+   
+public:
+   
+   CountingBody(int sizeX, int sizeY) : sizeX_(sizeX), counts_(sizeX * sizeY, 0)
+   {
+   }
+   
+   virtual void processTile(const TileRange &range) const
+   {
+      for (int y = range.beginY; y < range.endY; y++)
+         for (int x = range.beginX; x < range.endX; x++)
+            counts_[y * sizeX_ + x]++;
+   }
+   
+   int sizeX_;
+   mutable vector<int> counts_;
+};
+
+/**
+ * Task that forks more tasks and waits on them
+ */
+class ForkingTask : public Task {
+   
+public:
+   
+   ForkingTask(ThreadPool *pool, int depth, volatile long *counter) : pool_(pool), depth_(depth), counter_(counter)
+   {
+   }
+   
+   virtual void run()
+   {
+      __sync_fetch_and_add(counter_, 1);
+      
+      if (depth_ == 0)
+         return;
+      
+      ForkingTask left(pool_, depth_ - 1, counter_);
+      ForkingTask right(pool_, depth_ - 1, counter_);
+      
+      TaskGroup group(pool_);
+      group.spawn(&left);
+      group.spawn(&right);
+      group.wait();
+   }
+   
+private:
+   
+   ThreadPool *pool_;
+   int depth_;
+   volatile long *counter_;
+};
+
+void ThreadPoolTest::testParallelFor2D()
+{
+   static const int SIZE_X = 101;
+   static const int SIZE_Y = 77;
+   
+   ThreadPool pool(4);
+   CountingBody body(SIZE_X, SIZE_Y);
+   
+   parallelFor2D(&pool, SIZE_X, SIZE_Y, 16, 8, body);
+   
+   for (int i = 0; i < SIZE_X * SIZE_Y; i++)
+      CPPUNIT_ASSERT_MESSAGE("Cell not processed exactly once", body.counts_[i] == 1);
+}
+
+void ThreadPoolTest::testNestedGroups()
+{
+   static const int DEPTH = 8;
+   
+   // Fewer threads than nested levels, so this would deadlock if waiting threads didn't help
+   ThreadPool pool(2);
+   volatile long counter = 0;
+   
+   ForkingTask root(&pool, DEPTH, &counter);
+   
+   TaskGroup group(&pool);
+   group.spawn(&root);
+   group.wait();
+   
+   CPPUNIT_ASSERT_MESSAGE("Not all nested tasks were executed", counter == (1 << (DEPTH + 1)) - 1);
+   
+   // Tasks executed while their parent waits are accounted, but their time is already in the parent's time
+   double numExecutedTasks = 0;
+   for (int i = 0; i < pool.getNumThreads(); i++)
+      numExecutedTasks += pool.getThreadStatistics(i).getAggregateStatistics();
+   
+   CPPUNIT_ASSERT_MESSAGE("Too many tasks accounted", numExecutedTasks <= counter);
+}
+
+void ThreadPoolTest::testStatistics()
+{
+   static const int SIZE = 64;
+   
+   ThreadPool pool(2, THREAD_AFFINITY_ONE_THREAD_PER_CORE);
+   CountingBody body(SIZE, SIZE);
+   
+   parallelFor2D(&pool, SIZE, SIZE, 1, 1, body);
+   
+   double numExecutedTasks = 0;
+   for (int i = 0; i < pool.getNumThreads(); i++)
+      numExecutedTasks += pool.getThreadStatistics(i).getAggregateStatistics();
+   
+   // Calling thread helps too, and its tasks are not accounted
+   CPPUNIT_ASSERT_MESSAGE("Too many tasks accounted", numExecutedTasks <= SIZE * SIZE);
+   CPPUNIT_ASSERT_MESSAGE("Utilization not tracked", pool.getUtilizationStatistics().getElapsedTimeInMicroSeconds() > 0);
+   
+   pool.resetStatistics();
+   CPPUNIT_ASSERT_MESSAGE("Statistics not reset", pool.getThreadStatistics(0).getAggregateStatistics() == 0);
+}
@@ -0,0 +1,79 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef THREAD_POOL_TEST_H_
+#define THREAD_POOL_TEST_H_
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace hdsim {
+   
+   class ThreadPoolTest : public CppUnit::TestFixture  {
+      CPPUNIT_TEST_SUITE(ThreadPoolTest);
+         CPPUNIT_TEST(testParallelFor2D);
+         CPPUNIT_TEST(testNestedGroups);
+         CPPUNIT_TEST(testStatistics);
+      CPPUNIT_TEST_SUITE_END();
+      
+   public:
+      
+      /**
+       * Constructor
+       */
+      ThreadPoolTest();
+      
+      /**
+       * Destructor
+       */
+      virtual ~ThreadPoolTest();
+      
+      /**
+       * Prepare test for running
+       */
+      void setUp();
+      
+      /**
+       * Cleanup after test
+       */
+      void tearDown();
+      
+      /**
+       * Test that every cell of the grid is processed exactly once
+       */
+      void testParallelFor2D();
+      
+      /**
+       * Test that waiting on the group from inside of the task doesn't deadlock
+       */
+      void testNestedGroups();
+      
+      /**
+       * Test that executed tasks are accounted in the statistics
+       */
+      void testStatistics();
+      
+   private:
+      // define
+      ThreadPoolTest(const ThreadPoolTest &rhs);   
+      ThreadPoolTest & operator=(const ThreadPoolTest &rhs);   
+   };
+   
+}
+
+#endif
@@ -0,0 +1,269 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FUTURE_H_
+#define FUTURE_H_
+
+#include <pthread.h>
+
+namespace hdsim {
+   
+   /**
+    * Result of the asynchronous operation that would be available in the future. Future is a handle - copies share the same result, and result lives as long
+    * as any handle to it does. Producer sets value with setValue(), consumer waits for it with get(). Consumer could cancel the operation before the value is
+    * set, in which case producer is expected to skip the work (setValue() would return false).
+    *
+    * T must be default constructible and copyable.
+    */
+   template <class T> class Future {
+      
+   public:
+      
+      /**
+       * Create invalid future, that is not associated with any operation
+       */
+      Future() : state_(0)
+      {
+      }
+      
+      /**
+       * Create future for the new operation
+       *
+       * @return Valid future whose value is not yet set
+       */
+      static Future create()
+      {
+         Future future;
+         future.state_ = new State();
+         
+         return future;
+      }
+      
+      /**
+       * Copy constructor. Copy shares result with rhs
+       *
+       * @param rhs Future to share
+       */
+      Future(const Future &rhs) : state_(rhs.state_)
+      {
+         retain();
+      }
+      
+      /**
+       * Operator =. Result is shared with rhs
+       *
+       * @param rhs Future to share
+       */
+      Future &operator=(const Future &rhs)
+      {
+         if (rhs.state_ != state_)
+         {
+            release();
+            state_ = rhs.state_;
+            retain();
+         }
+         
+         return *this;
+      }
+      
+      /**
+       * Destructor
+       */
+      ~Future()
+      {
+         release();
+      }
+      
+      /**
+       * Is future associated with the operation
+       *
+       * @return Is future valid
+       */
+      bool isValid() const
+      {
+         return state_ != 0;
+      }
+      
+      /**
+       * Do two futures share the same operation
+       *
+       * @param rhs Future to compare with
+       *
+       * @return Are futures copies of each other
+       */
+      bool operator==(const Future &rhs) const
+      {
+         return state_ == rhs.state_;
+      }
+      
+      /**
+       * Is operation finished, either with value or by cancellation. Doesn't block
+       *
+       * @return Is operation finished
+       */
+      bool isReady() const
+      {
+         if (!state_)
+            return false;
+         
+         pthread_mutex_lock(&state_->mutex);
+         bool ready = state_->hasValue  ||  state_->cancelled;
+         pthread_mutex_unlock(&state_->mutex);
+         
+         return ready;
+      }
+      
+      /**
+       * Was operation cancelled
+       *
+       * @return Was operation cancelled
+       */
+      bool isCancelled() const
+      {
+         if (!state_)
+            return false;
+         
+         pthread_mutex_lock(&state_->mutex);
+         bool cancelled = state_->cancelled;
+         pthread_mutex_unlock(&state_->mutex);
+         
+         return cancelled;
+      }
+      
+      /**
+       * Wait until operation is finished and get its value
+       *
+       * @return Value of the operation, or default constructed T if operation was cancelled or future is invalid
+       */
+      T get() const
+      {
+         if (!state_)
+            return T();
+         
+         pthread_mutex_lock(&state_->mutex);
+         
+         while (!state_->hasValue  &&  !state_->cancelled)
+            pthread_cond_wait(&state_->finished, &state_->mutex);
+         
+         T value = state_->hasValue ? state_->value : T();
+         
+         pthread_mutex_unlock(&state_->mutex);
+         
+         return value;
+      }
+      
+      /**
+       * Cancel operation. Does nothing if value is already set
+       *
+       * @return Was operation cancelled by this call
+       */
+      bool cancel()
+      {
+         if (!state_)
+            return false;
+         
+         pthread_mutex_lock(&state_->mutex);
+         
+         bool cancelled = !state_->hasValue  &&  !state_->cancelled;
+         if (cancelled)
+         {
+            state_->cancelled = true;
+            pthread_cond_broadcast(&state_->finished);
+         }
+         
+         pthread_mutex_unlock(&state_->mutex);
+         
+         return cancelled;
+      }
+      
+      /**
+       * Set value of the operation and wake up everyone waiting for it. Called by the producer
+       *
+       * @param value Value of the operation
+       *
+       * @return Was value set. It is not set if operation was cancelled or value was already set
+       */
+      bool setValue(const T &value)
+      {
+         if (!state_)
+            return false;
+         
+         pthread_mutex_lock(&state_->mutex);
+         
+         bool set = !state_->hasValue  &&  !state_->cancelled;
+         if (set)
+         {
+            state_->value = value;
+            state_->hasValue = true;
+            pthread_cond_broadcast(&state_->finished);
+         }
+         
+         pthread_mutex_unlock(&state_->mutex);
+         
+         return set;
+      }
+      
+   private:
+      
+      /**
+       * Result shared between all copies of the future
+       */
+      struct State {
+         State() : refCount(1), hasValue(false), cancelled(false)
+         {
+            pthread_mutex_init(&mutex, 0);
+            pthread_cond_init(&finished, 0);
+         }
+         
+         ~State()
+         {
+            pthread_cond_destroy(&finished);
+            pthread_mutex_destroy(&mutex);
+         }
+         
+         pthread_mutex_t mutex;
+         pthread_cond_t finished;
+         volatile long refCount;
+         bool hasValue;
+         bool cancelled;
+         T value;
+      };
+      
+      void retain()
+      {
+         if (state_)
+            __sync_fetch_and_add(&state_->refCount, 1);
+      }
+      
+      void release()
+      {
+         if (state_  &&  __sync_sub_and_fetch(&state_->refCount, 1) == 0)
+            delete state_;
+         
+         state_ = 0;
+      }
+      
+      /**
+       * Shared result, or 0 for invalid future
+       */
+      State *state_;
+   };
+   
+} // namespace
+
+#endif
@@ -0,0 +1,65 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+
+#include "Hash.h"
+
+using namespace hdsim;
+using namespace std;
+
+/**
+ * FNV-1a prime for 64 bits
+ */
+static const unsigned long long FNV_PRIME = 1099511628211ULL;
+
+unsigned long long hdsim::fnv1aHash(const void *data, size_t size, unsigned long long seed)
+{
+   const unsigned char *bytes = static_cast<const unsigned char *>(data);
+   unsigned long long hash = seed;
+   
+   for (size_t i = 0; i < size; i++)
+   {
+      hash ^= bytes[i];
+      hash *= FNV_PRIME;
+   }
+   
+   return hash;
+}
+
+bool hdsim::hashFile(const std::string &fileName, unsigned long long *hash)
+{
+   FILE *file = fopen(fileName.c_str(), "rb");
+   if (!file)
+      return false;
+   
+   unsigned long long result = FNV_OFFSET_BASIS;
+   unsigned char buffer[4096];
+   size_t numRead;
+   
+   while ((numRead = fread(buffer, 1, sizeof(buffer), file)) > 0)
+      result = fnv1aHash(buffer, numRead, result);
+   
+   bool success = !ferror(file);
+   fclose(file);
+   
+   if (success)
+      *hash = result;
+   
+   return success;
+}
@@ -0,0 +1,56 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HASH_H_
+#define HASH_H_
+
+#include <cstddef>
+#include <string>
+
+namespace hdsim {
+   
+   /**
+    * Starting value of the FNV-1a hash
+    */
+   static const unsigned long long FNV_OFFSET_BASIS = 14695981039346656037ULL;
+   
+   /**
+    * Calculate 64 bit FNV-1a hash of the data. Hash is not cryptographic, it is used to detect changes (e.g. to invalidate caches). Hash could be calculated 
+    * incrementally by passing result of the previous call as the seed
+    *
+    * @param data Data to hash
+    * @param size Size of the data in bytes
+    * @param seed Value to start from
+    *
+    * @return Hash of the data
+    */
+   unsigned long long fnv1aHash(const void *data, size_t size, unsigned long long seed = FNV_OFFSET_BASIS);
+   
+   /**
+    * Calculate FNV-1a hash of the file content
+    *
+    * @param fileName File to hash
+    * @param hash (OUT) Hash of the file content
+    *
+    * @return Was file read
+    */
+   bool hashFile(const std::string &fileName, unsigned long long *hash);
+   
+} // namespace
+
+#endif
@@ -18,6 +18,11 @@
 
 #include <sys/time.h> 
 #include <unistd.h> 
+#include <time.h>
+
+#ifdef __APPLE__
+#include <mach/mach_time.h>
+#endif
 
 #include "PreciseDelay.h"
 
@@ -43,4 +48,51 @@ void hdsim::busyWaitDelay(long microsecondsToWait)
          return;
       }
    }
-}
\ No newline at end of file
+}
+
+long long hdsim::getMonotonicTimeInMicroSeconds()
+{
+#ifdef __APPLE__
+   static mach_timebase_info_data_t timebase = {0, 0};
+   
+   if (timebase.denom == 0)
+      mach_timebase_info(&timebase);
+   
+   // Timebase converts to nanoseconds, so ticks are divided by 1000 to get microseconds. Divide first so that we don't overflow on the long uptime
+   unsigned long long microSeconds = mach_absolute_time() / 1000 * timebase.numer / timebase.denom;
+   return (long long)microSeconds;
+#else
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   
+   return (long long)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+#endif
+}
+
+void hdsim::waitUntil(long long deadlineInMicroSeconds, long spinThresholdInMicroSeconds)
+{
+   long long remaining = deadlineInMicroSeconds - getMonotonicTimeInMicroSeconds();
+   
+   // Sleep while we are far from the deadline. We could be woken up early by signal, so loop until we are within spin threshold
+   while (remaining > spinThresholdInMicroSeconds)
+   {
+      long long toSleep = remaining - spinThresholdInMicroSeconds;
+      
+      struct timespec sleepTime;
+      sleepTime.tv_sec = (time_t)(toSleep / 1000000);
+      sleepTime.tv_nsec = (long)(toSleep % 1000000) * 1000;
+      
+      nanosleep(&sleepTime, 0);
+      
+      remaining = deadlineInMicroSeconds - getMonotonicTimeInMicroSeconds();
+   }
+   
+   // And spin for the rest
+   while (getMonotonicTimeInMicroSeconds() < deadlineInMicroSeconds)
+      ;
+}
+
+void hdsim::hybridWaitDelay(long microsecondsToWait, long spinThresholdInMicroSeconds)
+{
+   waitUntil(getMonotonicTimeInMicroSeconds() + microsecondsToWait, spinThresholdInMicroSeconds);
+}
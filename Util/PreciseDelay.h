@@ -33,6 +33,37 @@ namespace hdsim {
     * @param microsecondsToWait Wait in microseconds. 
     */
    void busyWaitDelay(long microsecondsToWait);
+   
+   /**
+    * Default part of the wait (in microseconds) that hybridWaitDelay() and waitUntil() spend spinning instead of sleeping. OS wakeup latency is normally well 
+    * below this value, so sleeping up to this point and spinning the rest keeps precision of the busy wait while giving CPU back to the system
+    */
+   static const long DEFAULT_SPIN_THRESHOLD_IN_MICROSECONDS = 2000;
+   
+   /**
+    * Get current value of the monotonic clock. Unlike gettimeofday(), this clock is not affected by the changes in the wall clock time, so it is safe to use 
+    * it for deadlines
+    *
+    * @return Time in microseconds since some unspecified starting point
+    */
+   long long getMonotonicTimeInMicroSeconds();
+   
+   /**
+    * Wait until the monotonic clock reaches deadline. Most of the wait is spent sleeping, with only last spinThresholdInMicroSeconds spent in busy wait, 
+    * so this is as precise as busyWaitDelay() without keeping CPU at 100% for the whole wait. Returns immediately if deadline has already passed
+    *
+    * @param deadlineInMicroSeconds Deadline, as returned by getMonotonicTimeInMicroSeconds()
+    * @param spinThresholdInMicroSeconds How much before the deadline we should stop sleeping and start spinning
+    */
+   void waitUntil(long long deadlineInMicroSeconds, long spinThresholdInMicroSeconds = DEFAULT_SPIN_THRESHOLD_IN_MICROSECONDS);
+   
+   /**
+    * Hybrid sleep-then-spin delay. Replacement for the busyWaitDelay() when waits are long compared to the OS wakeup latency
+    *
+    * @param microsecondsToWait Wait in microseconds
+    * @param spinThresholdInMicroSeconds How much of the wait at the end should be spent spinning
+    */
+   void hybridWaitDelay(long microsecondsToWait, long spinThresholdInMicroSeconds = DEFAULT_SPIN_THRESHOLD_IN_MICROSECONDS);
 }
 
 #endif
@@ -0,0 +1,520 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <deque>
+#include <algorithm>
+
+#include <sched.h>
+#include <unistd.h>
+
+#ifdef __APPLE__
+#include <mach/mach.h>
+#include <mach/thread_policy.h>
+#endif
+
+#include "ThreadPool.h"
+#include "SimpleDesignByContract.h"
+
+using namespace hdsim;
+using namespace std;
+
+struct ThreadPool::Worker {
+   /**
+    * Pool to which worker belongs
+    */
+   ThreadPool *pool;
+   
+   /**
+    * Index of the worker in the pool
+    */
+   int index;
+   
+   /**
+    * Thread of the worker
+    */
+   pthread_t thread;
+   
+   /**
+    * Guards queue and statistics
+    */
+   pthread_mutex_t mutex;
+   
+   /**
+    * Queue of the worker. Owner works on the back, thieves steal from the front
+    */
+   deque<QueuedTask> tasks;
+   
+   /**
+    * Time spent executing tasks and number of executed tasks
+    */
+   Statistics busyStatistics;
+   
+   /**
+    * Number of tasks the worker is executing. More than one while a task helps with the queued work in TaskGroup::wait(), and only the outermost
+    * task is timed
+    */
+   int executionDepth;
+   
+   /**
+    * Number of tasks this worker stole from others
+    */
+   long numStolenTasks;
+};
+
+Task::~Task()
+{
+}
+
+TileRangeBody::~TileRangeBody()
+{
+}
+
+TaskGroup::TaskGroup(ThreadPool *pool) : pool_(pool), numPendingTasks_(0)
+{
+   PRECONDITION(pool);
+   
+   pthread_mutex_init(&mutex_, 0);
+   pthread_cond_init(&finished_, 0);
+}
+
+TaskGroup::~TaskGroup()
+{
+   wait();
+   
+   pthread_cond_destroy(&finished_);
+   pthread_mutex_destroy(&mutex_);
+}
+
+void TaskGroup::spawn(Task *task)
+{
+   PRECONDITION(task);
+   
+   __sync_fetch_and_add(&numPendingTasks_, 1);
+   pool_->submit(task, this);
+}
+
+void TaskGroup::wait()
+{
+   // Help with the work while our tasks are not finished. Tasks we execute don't have to be ours, that is fine as we would otherwise sit idle
+   while (__sync_fetch_and_add(&numPendingTasks_, 0) > 0)
+   {
+      if (!pool_->runPendingTask())
+         break;
+   }
+   
+   // Nothing left to take, so the rest of our tasks is being executed by others. Sleep until the last of them is finished
+   pthread_mutex_lock(&mutex_);
+   
+   while (__sync_fetch_and_add(&numPendingTasks_, 0) > 0)
+      pthread_cond_wait(&finished_, &mutex_);
+   
+   pthread_mutex_unlock(&mutex_);
+}
+
+static pthread_once_t sharedPoolOnce = PTHREAD_ONCE_INIT;
+static ThreadPool *sharedPool = 0;
+
+static void createSharedPool()
+{
+   sharedPool = new ThreadPool();
+}
+
+ThreadPool *ThreadPool::getSharedPool()
+{
+   pthread_once(&sharedPoolOnce, createSharedPool);
+   return sharedPool;
+}
+
+int ThreadPool::getNumCores()
+{
+   long numCores = sysconf(_SC_NPROCESSORS_ONLN);
+   return numCores > 0 ? (int)numCores : 1;
+}
+
+ThreadPool::ThreadPool(int numThreads, ThreadAffinity affinity) : affinity_(affinity), numQueuedTasks_(0), nextQueue_(0), shutdown_(false)
+{
+   PRECONDITION(numThreads >= 0);
+   
+   if (numThreads == 0)
+      numThreads = getNumCores();
+   
+   pthread_mutex_init(&mutex_, 0);
+   pthread_cond_init(&workAvailable_, 0);
+   pthread_key_create(&workerKey_, 0);
+   
+   wallClockStatistics_.startTimer();
+   
+   // All workers have to exist before any of them starts stealing
+   for (int i = 0; i < numThreads; i++)
+   {
+      Worker *worker = new Worker();
+      worker->pool = this;
+      worker->index = i;
+      worker->executionDepth = 0;
+      worker->numStolenTasks = 0;
+      pthread_mutex_init(&worker->mutex, 0);
+      
+      workers_.push_back(worker);
+   }
+   
+   for (int i = 0; i < numThreads; i++)
+   {
+      if (pthread_create(&workers_[i]->thread, 0, threadMain, workers_[i]))
+      {
+         FAIL("Unable to start thread pool thread");
+      }
+   }
+}
+
+ThreadPool::~ThreadPool()
+{
+   pthread_mutex_lock(&mutex_);
+   shutdown_ = true;
+   pthread_cond_broadcast(&workAvailable_);
+   pthread_mutex_unlock(&mutex_);
+   
+   for (int i = 0; i < workers_.size(); i++)
+      pthread_join(workers_[i]->thread, 0);
+   
+   for (int i = 0; i < workers_.size(); i++)
+   {
+      pthread_mutex_destroy(&workers_[i]->mutex);
+      delete workers_[i];
+   }
+   
+   pthread_key_delete(workerKey_);
+   pthread_cond_destroy(&workAvailable_);
+   pthread_mutex_destroy(&mutex_);
+}
+
+void ThreadPool::submit(Task *task, TaskGroup *group)
+{
+   QueuedTask queuedTask;
+   queuedTask.task = task;
+   queuedTask.group = group;
+   
+   // Tasks spawned from the pool thread stay local, others are spread round robin
+   Worker *worker = static_cast<Worker *>(pthread_getspecific(workerKey_));
+   if (!worker)
+      worker = workers_[__sync_fetch_and_add(&nextQueue_, 1) % workers_.size()];
+   
+   pthread_mutex_lock(&worker->mutex);
+   worker->tasks.push_back(queuedTask);
+   pthread_mutex_unlock(&worker->mutex);
+   
+   pthread_mutex_lock(&mutex_);
+   __sync_fetch_and_add(&numQueuedTasks_, 1);
+   pthread_cond_signal(&workAvailable_);
+   pthread_mutex_unlock(&mutex_);
+}
+
+bool ThreadPool::takeTask(Worker *worker, QueuedTask *task)
+{
+   // Own queue first, newest task first
+   if (worker)
+   {
+      pthread_mutex_lock(&worker->mutex);
+      
+      bool found = !worker->tasks.empty();
+      if (found)
+      {
+         *task = worker->tasks.back();
+         worker->tasks.pop_back();
+      }
+      
+      pthread_mutex_unlock(&worker->mutex);
+      
+      if (found)
+      {
+         __sync_fetch_and_sub(&numQueuedTasks_, 1);
+         return true;
+      }
+   }
+   
+   // Then steal the oldest task from someone else, starting from our neighbour so that thieves don't all go for the same victim
+   int numWorkers = (int)workers_.size();
+   int start = worker ? worker->index + 1 : 0;
+   
+   for (int i = 0; i < numWorkers; i++)
+   {
+      Worker *victim = workers_[(start + i) % numWorkers];
+      if (victim == worker)
+         continue;
+      
+      pthread_mutex_lock(&victim->mutex);
+      
+      bool found = !victim->tasks.empty();
+      if (found)
+      {
+         *task = victim->tasks.front();
+         victim->tasks.pop_front();
+      }
+      
+      pthread_mutex_unlock(&victim->mutex);
+      
+      if (found)
+      {
+         __sync_fetch_and_sub(&numQueuedTasks_, 1);
+         
+         if (worker)
+         {
+            pthread_mutex_lock(&worker->mutex);
+            worker->numStolenTasks++;
+            pthread_mutex_unlock(&worker->mutex);
+         }
+         
+         return true;
+      }
+   }
+   
+   return false;
+}
+
+void ThreadPool::execute(Worker *worker, const QueuedTask &task)
+{
+   if (worker)
+   {
+      pthread_mutex_lock(&worker->mutex);
+      
+      if (worker->executionDepth++ == 0)
+         worker->busyStatistics.startTimer();
+      
+      pthread_mutex_unlock(&worker->mutex);
+   }
+   
+   task.task->run();
+   
+   if (worker)
+   {
+      pthread_mutex_lock(&worker->mutex);
+      
+      if (--worker->executionDepth == 0)
+         worker->busyStatistics.stopTimer();
+      
+      worker->busyStatistics.addAggregateStatistics(1);
+      pthread_mutex_unlock(&worker->mutex);
+   }
+   
+   // Group could be destroyed as soon as the waiter sees zero, so it is decremented under the lock of the group and not touched after unlocking
+   TaskGroup *group = task.group;
+   
+   pthread_mutex_lock(&group->mutex_);
+   
+   if (__sync_sub_and_fetch(&group->numPendingTasks_, 1) == 0)
+      pthread_cond_broadcast(&group->finished_);
+   
+   pthread_mutex_unlock(&group->mutex_);
+}
+
+bool ThreadPool::runPendingTask()
+{
+   Worker *worker = static_cast<Worker *>(pthread_getspecific(workerKey_));
+   
+   QueuedTask task;
+   if (!takeTask(worker, &task))
+      return false;
+   
+   execute(worker, task);
+   return true;
+}
+
+void *ThreadPool::threadMain(void *worker)
+{
+   Worker *self = static_cast<Worker *>(worker);
+   self->pool->workerLoop(self);
+   
+   return 0;
+}
+
+void ThreadPool::workerLoop(Worker *worker)
+{
+   pthread_setspecific(workerKey_, worker);
+   applyAffinity(worker->index);
+   
+   while (true)
+   {
+      QueuedTask task;
+      if (takeTask(worker, &task))
+      {
+         execute(worker, task);
+         continue;
+      }
+      
+      // Nothing to do, sleep until something is queued. Queued tasks are always drained before shutdown
+      pthread_mutex_lock(&mutex_);
+      
+      while (!shutdown_  &&  __sync_fetch_and_add(&numQueuedTasks_, 0) <= 0)
+         pthread_cond_wait(&workAvailable_, &mutex_);
+      
+      bool shouldExit = shutdown_  &&  __sync_fetch_and_add(&numQueuedTasks_, 0) <= 0;
+      
+      pthread_mutex_unlock(&mutex_);
+      
+      if (shouldExit)
+         return;
+   }
+}
+
+void ThreadPool::applyAffinity(int threadIndex)
+{
+   if (affinity_ == THREAD_AFFINITY_NONE)
+      return;
+   
+   int core = threadIndex % getNumCores();
+   
+#ifdef __APPLE__
+   // OS X doesn't support binding to the core. Different affinity tags are a hint to the scheduler to keep threads on different cores
+   thread_affinity_policy_data_t policy = { core + 1 };
+   
+   if (thread_policy_set(pthread_mach_thread_np(pthread_self()), THREAD_AFFINITY_POLICY, (thread_policy_t)&policy, THREAD_AFFINITY_POLICY_COUNT) != KERN_SUCCESS)
+      LOG("Unable to set thread affinity");
+#elif defined(__linux__)
+   cpu_set_t cpuSet;
+   CPU_ZERO(&cpuSet);
+   CPU_SET(core, &cpuSet);
+   
+   if (pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet))
+      LOG("Unable to set thread affinity");
+#endif
+}
+
+Statistics ThreadPool::getThreadStatistics(int threadIndex) const
+{
+   PRECONDITION(threadIndex >= 0  &&  threadIndex < getNumThreads());
+   
+   Worker *worker = workers_[threadIndex];
+   
+   pthread_mutex_lock(&worker->mutex);
+   Statistics statistics = worker->busyStatistics;
+   pthread_mutex_unlock(&worker->mutex);
+   
+   return statistics;
+}
+
+Statistics ThreadPool::getUtilizationStatistics() const
+{
+   double busyTimeInMicroSeconds = 0;
+   
+   for (int i = 0; i < getNumThreads(); i++)
+      busyTimeInMicroSeconds += getThreadStatistics(i).getElapsedTimeInMicroSeconds();
+   
+   pthread_mutex_lock(&mutex_);
+   Statistics statistics = wallClockStatistics_;
+   pthread_mutex_unlock(&mutex_);
+   
+   statistics.addAggregateStatistics(busyTimeInMicroSeconds/1000000.0);
+   return statistics;
+}
+
+long ThreadPool::getNumStolenTasks() const
+{
+   long numStolenTasks = 0;
+   
+   for (int i = 0; i < getNumThreads(); i++)
+   {
+      pthread_mutex_lock(&workers_[i]->mutex);
+      numStolenTasks += workers_[i]->numStolenTasks;
+      pthread_mutex_unlock(&workers_[i]->mutex);
+   }
+   
+   return numStolenTasks;
+}
+
+void ThreadPool::resetStatistics()
+{
+   for (int i = 0; i < getNumThreads(); i++)
+   {
+      Worker *worker = workers_[i];
+      
+      pthread_mutex_lock(&worker->mutex);
+      
+      // Thread could be in the middle of the task, keep timer running in that case
+      bool wasBusy = worker->busyStatistics.isTimerRunning();
+      worker->busyStatistics.resetStatistics();
+      if (wasBusy)
+         worker->busyStatistics.startTimer();
+      
+      worker->numStolenTasks = 0;
+      
+      pthread_mutex_unlock(&worker->mutex);
+   }
+   
+   pthread_mutex_lock(&mutex_);
+   wallClockStatistics_.resetStatistics();
+   wallClockStatistics_.startTimer();
+   pthread_mutex_unlock(&mutex_);
+}
+
+/**
+ * Task processing single tile of parallelFor2D()
+ */
+class TileTask : public Task {
+   
+public:
+   
+   TileTask(const TileRange &range, const TileRangeBody *body) : range_(range), body_(body)
+   {
+   }
+   
+   virtual void run()
+   {
+      body_->processTile(range_);
+   }
+   
+private:
+   
+   TileRange range_;
+   const TileRangeBody *body_;
+};
+
+void hdsim::parallelFor2D(ThreadPool *pool, int sizeX, int sizeY, int tileSizeX, int tileSizeY, const TileRangeBody &body)
+{
+   PRECONDITION(pool);
+   PRECONDITION(tileSizeX > 0  &&  tileSizeY > 0);
+   
+   if (sizeX <= 0  ||  sizeY <= 0)
+      return;
+   
+   vector<TileTask> tasks;
+   
+   for (int beginY = 0; beginY < sizeY; beginY += tileSizeY)
+      for (int beginX = 0; beginX < sizeX; beginX += tileSizeX)
+      {
+         TileRange range;
+         range.beginX = beginX;
+         range.endX = min(beginX + tileSizeX, sizeX);
+         range.beginY = beginY;
+         range.endY = min(beginY + tileSizeY, sizeY);
+         
+         tasks.push_back(TileTask(range, &body));
+      }
+   
+   // No point going through the queues for the single tile
+   if (tasks.size() == 1)
+   {
+      tasks[0].run();
+      return;
+   }
+   
+   TaskGroup group(pool);
+   
+   for (int i = 0; i < tasks.size(); i++)
+      group.spawn(&tasks[i]);
+   
+   group.wait();
+}
@@ -0,0 +1,367 @@
+/*
+ * HoloSim, visualization and control of the moxel based environment.
+ *
+ * Copyright (C) 2010 Veljko Krunic
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <vector>
+
+#include <pthread.h>
+
+#include "Statistics.h"
+
+namespace hdsim {
+   
+   class ThreadPool;
+   class TaskGroup;
+   
+   /**
+    * Unit of work executed by the ThreadPool
+    */
+   class Task {
+      
+   public:
+      
+      /**
+       * Destructor
+       */
+      virtual ~Task();
+      
+      /**
+       * Perform the work. Called from one of the pool threads, or from the thread waiting on the TaskGroup
+       */
+      virtual void run() = 0;
+   };
+   
+   /**
+    * Fork-join helper. Tasks are spawned in the group and wait() returns once all of them are finished. Thread that waits is not idle - it executes pending 
+    * tasks of the pool while waiting, so it is safe to wait on a group from inside of another task. Once there is nothing left in the queues, it sleeps
+    * until the tasks being executed by others are finished
+    */
+   class TaskGroup {
+      
+   public:
+      
+      /**
+       * Constructor
+       *
+       * @param pool Pool on which tasks would be executed
+       */
+      TaskGroup(ThreadPool *pool);
+      
+      /**
+       * Destructor. Waits for all the spawned tasks
+       */
+      virtual ~TaskGroup();
+      
+      /**
+       * Spawn task. Task is not owned by the group and must stay alive until wait() returns
+       *
+       * @param task Task to spawn
+       */
+      virtual void spawn(Task *task);
+      
+      /**
+       * Wait until all the spawned tasks are finished
+       */
+      virtual void wait();
+      
+   private:
+      
+      // copying is not supported
+      TaskGroup(const TaskGroup &rhs);
+      TaskGroup &operator=(const TaskGroup &rhs);
+      
+      friend class ThreadPool;
+      
+      /**
+       * Pool we are using
+       */
+      ThreadPool *pool_;
+      
+      /**
+       * Number of spawned tasks that are not finished yet
+       */
+      volatile long numPendingTasks_;
+      
+      /**
+       * Signalled when the last pending task is finished, so that waiting thread doesn't spin once there is nothing left to help with
+       */
+      pthread_mutex_t mutex_;
+      pthread_cond_t finished_;
+   };
+   
+   /**
+    * Placement of the pool threads on the CPU cores
+    */
+   enum ThreadAffinity {
+      /**
+       * Let OS place threads
+       */
+      THREAD_AFFINITY_NONE = 0,
+      
+      /**
+       * Each thread is bound to its own core (round robin if there are more threads than cores). On OS X, this is only a hint to the scheduler
+       */
+      THREAD_AFFINITY_ONE_THREAD_PER_CORE = 1
+   };
+   
+   /**
+    * Work stealing thread pool shared by all the parallel parts of the pipeline, so that they don't start threads of their own.
+    *
+    * Every pool thread has its own task queue. Tasks spawned from a pool thread go to its own queue and are taken from the back (the most recently spawned
+    * first, which is cache friendly for fork-join), while idle threads steal from the front of queues of other threads. Tasks spawned from outside of the pool
+    * are distributed round robin. 
+    *
+    * Pool keeps utilization statistics for each thread: timer of the Statistics runs only while thread executes task and aggregate statistics holds number of 
+    * executed tasks.
+    */
+   class ThreadPool {
+      
+   public:
+      
+      /**
+       * Constructor
+       *
+       * @param numThreads Number of threads to start. If 0, one thread per online CPU core is started
+       * @param affinity Placement of the threads on the cores
+       */
+      ThreadPool(int numThreads = 0, ThreadAffinity affinity = THREAD_AFFINITY_NONE);
+      
+      /**
+       * Destructor. Finishes all queued tasks and stops threads
+       */
+      virtual ~ThreadPool();
+      
+      /**
+       * Get pool shared by the whole application, created on the first use with one thread per core
+       *
+       * @return Shared pool
+       */
+      static ThreadPool *getSharedPool();
+      
+      /**
+       * Get number of online CPU cores
+       *
+       * @return Number of cores, at least 1
+       */
+      static int getNumCores();
+      
+      /**
+       * Get number of threads in the pool
+       *
+       * @return Number of threads
+       */
+      virtual int getNumThreads() const
+      {
+         return (int)workers_.size();
+      }
+      
+      /**
+       * Get utilization statistics of the single thread
+       *
+       * @param threadIndex Index of the thread
+       *
+       * @return Statistics whose elapsed time is the time thread spent executing tasks and aggregate is number of executed tasks
+       */
+      virtual Statistics getThreadStatistics(int threadIndex) const;
+      
+      /**
+       * Get utilization statistics of the whole pool
+       *
+       * @return Statistics whose elapsed time is wall clock time since the last reset and aggregate is total time (in seconds) that all threads spent executing
+       * tasks. Time averaged value is therefore average number of busy threads
+       */
+      virtual Statistics getUtilizationStatistics() const;
+      
+      /**
+       * Get number of tasks stolen from the queues of other threads since the last reset
+       *
+       * @return Number of stolen tasks
+       */
+      virtual long getNumStolenTasks() const;
+      
+      /**
+       * Reset all utilization statistics
+       */
+      virtual void resetStatistics();
+      
+   private:
+      
+      // copying is not supported
+      ThreadPool(const ThreadPool &rhs);
+      ThreadPool &operator=(const ThreadPool &rhs);
+      
+      friend class TaskGroup;
+      
+      /**
+       * Internal state of the single pool thread
+       */
+      struct Worker;
+      
+      /**
+       * Task queued in the pool
+       */
+      struct QueuedTask {
+         Task *task;
+         TaskGroup *group;
+      };
+      
+      /**
+       * Queue task
+       *
+       * @param task Task to queue
+       * @param group Group to which task belongs
+       */
+      void submit(Task *task, TaskGroup *group);
+      
+      /**
+       * Take one queued task and execute it on the calling thread
+       *
+       * @return Was there task to execute
+       */
+      bool runPendingTask();
+      
+      /**
+       * Take task for the worker, first from its own queue and then by stealing
+       *
+       * @param worker Worker that takes task, or 0 if calling thread is not a pool thread
+       * @param task (OUT) Task taken
+       *
+       * @return Was task found
+       */
+      bool takeTask(Worker *worker, QueuedTask *task);
+      
+      /**
+       * Execute task and account it
+       *
+       * @param worker Worker executing task, or 0 if calling thread is not a pool thread
+       * @param task Task to execute
+       */
+      void execute(Worker *worker, const QueuedTask &task);
+      
+      /**
+       * Main loop of the pool thread
+       *
+       * @param worker Worker to run
+       */
+      void workerLoop(Worker *worker);
+      
+      /**
+       * Thread entry point
+       */
+      static void *threadMain(void *worker);
+      
+      /**
+       * Apply affinity to the calling thread
+       *
+       * @param threadIndex Index of the thread in the pool
+       */
+      void applyAffinity(int threadIndex);
+      
+      /**
+       * Pool threads
+       */
+      std::vector<Worker *> workers_;
+      
+      /**
+       * Affinity of the threads
+       */
+      ThreadAffinity affinity_;
+      
+      /**
+       * Guards sleeping of the idle threads and wall clock statistics
+       */
+      mutable pthread_mutex_t mutex_;
+      
+      /**
+       * Signaled when new task is queued or pool is shutting down
+       */
+      pthread_cond_t workAvailable_;
+      
+      /**
+       * Number of tasks in all queues
+       */
+      volatile long numQueuedTasks_;
+      
+      /**
+       * Next queue for tasks submitted from outside of the pool
+       */
+      volatile long nextQueue_;
+      
+      /**
+       * Is pool shutting down
+       */
+      bool shutdown_;
+      
+      /**
+       * Wall clock time since the last reset of statistics
+       */
+      Statistics wallClockStatistics_;
+      
+      /**
+       * Key of the thread specific Worker pointer, used to find out is calling thread a pool thread
+       */
+      pthread_key_t workerKey_;
+   };
+   
+   /**
+    * Rectangular range of the 2D grid, [beginX, endX) x [beginY, endY)
+    */
+   struct TileRange {
+      int beginX, endX;
+      int beginY, endY;
+   };
+   
+   /**
+    * Body of the parallelFor2D(). It would be called concurrently for the different tiles, so it must not modify shared state except for the part of the
+    * output that belongs to the tile
+    */
+   class TileRangeBody {
+      
+   public:
+      
+      /**
+       * Destructor
+       */
+      virtual ~TileRangeBody();
+      
+      /**
+       * Process single tile
+       *
+       * @param range Tile to process
+       */
+      virtual void processTile(const TileRange &range) const = 0;
+   };
+   
+   /**
+    * Split sizeX x sizeY grid in the tiles of tileSizeX x tileSizeY (edge tiles are smaller) and process them in parallel. Returns when all tiles are processed.
+    * If there is only one tile, it is processed on the calling thread
+    *
+    * @param pool Pool to use
+    * @param sizeX Size of the grid in X direction
+    * @param sizeY Size of the grid in Y direction
+    * @param tileSizeX Size of the tile in X direction
+    * @param tileSizeY Size of the tile in Y direction
+    * @param body Body to invoke for every tile
+    */
+   void parallelFor2D(ThreadPool *pool, int sizeX, int sizeY, int tileSizeX, int tileSizeY, const TileRangeBody &body);
+   
+} // namespace
+
+#endif